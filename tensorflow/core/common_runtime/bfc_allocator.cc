@@ -17,12 +17,14 @@ limitations under the License.
 
 #include <atomic>
 
+#include "absl/memory/memory.h"
 #include "absl/strings/string_view.h"
 #include "tensorflow/core/common_runtime/allocator_retry.h"
 #include "tensorflow/core/lib/core/bits.h"
 #include "tensorflow/core/lib/strings/numbers.h"
 #include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/cpu_info.h"
 #include "tensorflow/core/platform/file_system.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/mutex.h"
@@ -171,6 +173,20 @@ bool BFCAllocator::Extend(size_t alignment, size_t rounded_bytes) {
     region_manager_.AddAllocationRegion(mem_addr, bytes_received);
   }
 
+  if (thread_cache_shards_ != nullptr) {
+    const int num_maps =
+        num_thread_cache_region_maps_.load(std::memory_order_relaxed);
+    if (num_maps < kMaxThreadCacheRegionMaps) {
+      thread_cache_region_maps_[num_maps] =
+          absl::make_unique<ThreadCacheRegionMap>(mem_addr, bytes_received);
+      num_thread_cache_region_maps_.store(num_maps + 1,
+                                          std::memory_order_release);
+    } else {
+      VLOG(1) << "Thread-local cache of " << Name()
+              << " does not cover the region at " << mem_addr;
+    }
+  }
+
   // Create one large chunk for the whole memory space that will
   // be chunked later.
   ChunkHandle h = AllocateChunk();
@@ -234,8 +250,8 @@ void* BFCAllocator::AllocateRawInternalWithRetry(
   if (allocation_attr.freed_by_func != nullptr) {
     freed_by_count = (*allocation_attr.freed_by_func)();
   }
-  void* r =
-      AllocateRawInternal(unused_alignment, num_bytes, false, freed_by_count);
+  void* r = AllocateRawInternalWithCacheFlush(unused_alignment, num_bytes,
+                                              false, freed_by_count);
   if (r != nullptr) {
     return r;
   } else {
@@ -246,7 +262,7 @@ void* BFCAllocator::AllocateRawInternalWithRetry(
           if (allocation_attr.freed_by_func != nullptr) {
             freed_by_count = (*allocation_attr.freed_by_func)();
           }
-          return AllocateRawInternal(a, nb, v, freed_by_count);
+          return AllocateRawInternalWithCacheFlush(a, nb, v, freed_by_count);
         },
         kMaxMillisToWait, unused_alignment, num_bytes);
     return r;
@@ -256,6 +272,14 @@ void* BFCAllocator::AllocateRawInternalWithRetry(
 void* BFCAllocator::AllocateRaw(size_t unused_alignment, size_t num_bytes,
                                 const AllocationAttributes& allocation_attr) {
   VLOG(3) << "AllocateRaw " << Name() << "  " << num_bytes;
+  if (thread_cache_shards_ != nullptr && num_bytes > 0 &&
+      num_bytes <= kMaxThreadCachedBytes) {
+    void* ptr = AllocateFromThreadLocalCache(RoundedBytes(num_bytes));
+    if (ptr != nullptr) {
+      VLOG(3) << "AllocateRaw " << Name() << "  " << num_bytes << " " << ptr;
+      return ptr;
+    }
+  }
   void* result = [&] {
     if (!allocation_attr.retry_on_failure) {
       // Return immediately upon the first failure if this is for allocating an
@@ -265,8 +289,8 @@ void* BFCAllocator::AllocateRaw(size_t unused_alignment, size_t num_bytes,
       if (allocation_attr.freed_by_func != nullptr) {
         freed_by_count = (*allocation_attr.freed_by_func)();
       }
-      void* res = AllocateRawInternal(unused_alignment, num_bytes,
-                                      dump_log_on_failure, freed_by_count);
+      void* res = AllocateRawInternalWithCacheFlush(
+          unused_alignment, num_bytes, dump_log_on_failure, freed_by_count);
       if (res == nullptr) {
         static std::atomic<int32> log_counter{0};
         int32 counter_value = log_counter.load(std::memory_order_relaxed);
@@ -291,6 +315,30 @@ void* BFCAllocator::AllocateRaw(size_t unused_alignment, size_t num_bytes,
   return result;
 }
 
+void* BFCAllocator::AllocateRawInternalWithCacheFlush(
+    size_t unused_alignment, size_t num_bytes, bool dump_log_on_failure,
+    uint64 freed_before_count) {
+  if (thread_cache_shards_ == nullptr) {
+    return AllocateRawInternal(unused_alignment, num_bytes,
+                               dump_log_on_failure, freed_before_count);
+  }
+  void* ptr = AllocateRawInternal(unused_alignment, num_bytes,
+                                  /*dump_log_on_failure=*/false,
+                                  freed_before_count);
+  if (ptr == nullptr) {
+    // Idle chunks held by the thread-local cache may be what is missing to
+    // form a large enough free chunk.
+    FlushThreadLocalCache();
+    ptr = AllocateRawInternal(unused_alignment, num_bytes, dump_log_on_failure,
+                              freed_before_count);
+  }
+  if (ptr != nullptr) {
+    UpdateThreadCachePeak(
+        thread_cached_bytes_in_use_.load(std::memory_order_relaxed));
+  }
+  return ptr;
+}
+
 // static
 size_t BFCAllocator::RoundedBytes(size_t bytes) {
   size_t rounded_bytes =
@@ -580,6 +628,10 @@ void* BFCAllocator::FindChunkPtr(BinNum bin_num, size_t rounded_bytes,
             std::max(stats_.peak_bytes_in_use, stats_.bytes_in_use);
         stats_.largest_alloc_size =
             std::max<std::size_t>(stats_.largest_alloc_size, chunk->size);
+        if (thread_cache_shards_ != nullptr) {
+          uncached_bytes_in_use_.store(stats_.bytes_in_use,
+                                       std::memory_order_relaxed);
+        }
 
 #ifdef TENSORFLOW_MEM_DEBUG
         if (ShouldRecordOpName()) {
@@ -653,6 +705,12 @@ void BFCAllocator::SplitChunk(BFCAllocator::ChunkHandle h, size_t num_bytes) {
 }
 
 void BFCAllocator::DeallocateRaw(void* ptr) {
+  if (thread_cache_shards_ != nullptr && ptr != nullptr &&
+      DeallocateToThreadLocalCache(ptr)) {
+    VLOG(3) << "DeallocateRaw " << Name() << " " << ptr
+            << " to thread-local cache";
+    return;
+  }
   VLOG(3) << "DeallocateRaw " << Name() << " "
           << (ptr ? RequestedSize(ptr) : 0);
   DeallocateRawInternal(ptr);
@@ -777,6 +835,10 @@ void BFCAllocator::MarkFree(BFCAllocator::ChunkHandle h) {
 
   // Updates the stats.
   stats_.bytes_in_use -= c->size;
+  if (thread_cache_shards_ != nullptr) {
+    uncached_bytes_in_use_.store(stats_.bytes_in_use,
+                                 std::memory_order_relaxed);
+  }
 
 #ifdef TENSORFLOW_MEM_DEBUG
   if (ShouldRecordOpName()) {
@@ -1107,33 +1169,64 @@ void BFCAllocator::MaybeWriteMemoryMap() {
 }
 
 MemoryDump BFCAllocator::RecordMemoryMap() {
+  if (thread_cache_shards_ == nullptr) {
+    mutex_lock l(lock_);
+    return RecordMemoryMapInternal();
+  }
+  // Hold every shard, in order and before lock_, so that the chunks they
+  // cache can be recorded as free.
+  std::vector<mutex_lock> shard_locks;
+  shard_locks.reserve(num_thread_cache_shards_);
+  absl::flat_hash_set<const void*> thread_cached_ptrs;
+  for (int i = 0; i < num_thread_cache_shards_; ++i) {
+    ThreadCacheShard& shard = thread_cache_shards_[i];
+    shard_locks.emplace_back(shard.mu);
+    for (const auto& free_list : shard.free_lists) {
+      thread_cached_ptrs.insert(free_list.begin(), free_list.end());
+    }
+  }
   mutex_lock l(lock_);
-  return RecordMemoryMapInternal();
+  return RecordMemoryMapInternal(&thread_cached_ptrs);
 }
 
-MemoryDump BFCAllocator::RecordMemoryMapInternal() {
+MemoryDump BFCAllocator::RecordMemoryMapInternal(
+    const absl::flat_hash_set<const void*>* thread_cached_ptrs) {
   MemoryDump md;
   md.set_allocator_name(Name());
 
   // Record the general stats
+  const AllocatorStats stats = GetStatsInternal();
   MemAllocatorStats* mas = md.mutable_stats();
-  mas->set_num_allocs(stats_.num_allocs);
-  mas->set_bytes_in_use(stats_.bytes_in_use);
-  mas->set_peak_bytes_in_use(stats_.peak_bytes_in_use);
-  mas->set_largest_alloc_size(stats_.largest_alloc_size);
+  mas->set_num_allocs(stats.num_allocs);
+  mas->set_bytes_in_use(stats.bytes_in_use);
+  mas->set_peak_bytes_in_use(stats.peak_bytes_in_use);
+  mas->set_largest_alloc_size(stats.largest_alloc_size);
 
   // Record summary data for every bin.
-  const std::array<BinDebugInfo, kNumBins> bin_infos = get_bin_debug_info();
+  std::array<BinDebugInfo, kNumBins> bin_infos = get_bin_debug_info();
+  std::array<BinDebugInfo, kNumBins> thread_cached_infos;
+  if (thread_cached_ptrs != nullptr) {
+    // Chunks held by the thread-local cache look in use to the bins.
+    for (const void* ptr : *thread_cached_ptrs) {
+      const Chunk* c = ChunkFromHandle(region_manager_.get_handle(ptr));
+      BinDebugInfo& info = thread_cached_infos[BinNumForSize(c->size)];
+      info.total_bytes_in_use += c->size;
+      info.total_chunks_in_use++;
+    }
+  }
   for (BinNum bin_num = 0; bin_num < kNumBins; bin_num++) {
     Bin* b = BinFromIndex(bin_num);
     const BinDebugInfo& bin_info = bin_infos[bin_num];
+    const BinDebugInfo& thread_cached_info = thread_cached_infos[bin_num];
     DCHECK_EQ(b->free_chunks.size(),
               bin_info.total_chunks_in_bin - bin_info.total_chunks_in_use);
     BinSummary* bs = md.add_bin_summary();
     bs->set_bin(bin_num);
-    bs->set_total_bytes_in_use(bin_info.total_bytes_in_use);
+    bs->set_total_bytes_in_use(bin_info.total_bytes_in_use -
+                               thread_cached_info.total_bytes_in_use);
     bs->set_total_bytes_in_bin(bin_info.total_bytes_in_bin);
-    bs->set_total_chunks_in_use(bin_info.total_chunks_in_use);
+    bs->set_total_chunks_in_use(bin_info.total_chunks_in_use -
+                                thread_cached_info.total_chunks_in_use);
     bs->set_total_chunks_in_bin(bin_info.total_chunks_in_bin);
   }
 
@@ -1143,10 +1236,12 @@ MemoryDump BFCAllocator::RecordMemoryMapInternal() {
     while (h != kInvalidChunkHandle) {
       const Chunk* c = ChunkFromHandle(h);
       MemChunk* mc = md.add_chunk();
-      mc->set_in_use(c->in_use());
+      const bool thread_cached = thread_cached_ptrs != nullptr &&
+                                 thread_cached_ptrs->contains(c->ptr);
+      mc->set_in_use(c->in_use() && !thread_cached);
       mc->set_address(reinterpret_cast<uint64>(c->ptr));
       mc->set_size(c->size);
-      mc->set_requested_size(c->requested_size);
+      mc->set_requested_size(thread_cached ? 0 : c->requested_size);
       mc->set_bin(c->bin_num);
 #ifdef TENSORFLOW_MEM_DEBUG
       mc->set_op_name(c->op_name ? string(c->op_name) : "UNKNOWN");
@@ -1179,7 +1274,23 @@ MemoryDump BFCAllocator::RecordMemoryMapInternal() {
 
 absl::optional<AllocatorStats> BFCAllocator::GetStats() {
   mutex_lock l(lock_);
-  return stats_;
+  return GetStatsInternal();
+}
+
+AllocatorStats BFCAllocator::GetStatsInternal() {
+  AllocatorStats stats = stats_;
+  if (thread_cache_shards_ != nullptr) {
+    for (int i = 0; i < num_thread_cache_shards_; ++i) {
+      stats.num_allocs +=
+          thread_cache_shards_[i].num_allocs.load(std::memory_order_relaxed);
+    }
+    stats.bytes_in_use +=
+        thread_cached_bytes_in_use_.load(std::memory_order_relaxed);
+    stats.peak_bytes_in_use = std::max(
+        {stats.peak_bytes_in_use, stats.bytes_in_use,
+         thread_cache_peak_bytes_in_use_.load(std::memory_order_relaxed)});
+  }
+  return stats;
 }
 
 bool BFCAllocator::ClearStats() {
@@ -1187,9 +1298,203 @@ bool BFCAllocator::ClearStats() {
   stats_.num_allocs = 0;
   stats_.peak_bytes_in_use = stats_.bytes_in_use;
   stats_.largest_alloc_size = 0;
+  if (thread_cache_shards_ != nullptr) {
+    for (int i = 0; i < num_thread_cache_shards_; ++i) {
+      thread_cache_shards_[i].num_allocs.store(0, std::memory_order_relaxed);
+    }
+    thread_cache_peak_bytes_in_use_.store(
+        stats_.bytes_in_use +
+            thread_cached_bytes_in_use_.load(std::memory_order_relaxed),
+        std::memory_order_relaxed);
+  }
   return true;
 }
 
+void BFCAllocator::EnableThreadLocalCache(int num_shards) {
+  mutex_lock l(lock_);
+  CHECK(region_manager_.regions().empty())
+      << "The thread-local cache of " << Name()
+      << " must be enabled before the first allocation";
+  CHECK(timing_counter_ == nullptr)
+      << "The thread-local cache does not support timestamped chunks";
+  CHECK(!garbage_collection_)
+      << "The thread-local cache does not support garbage collection";
+  if (num_shards <= 0) {
+    num_shards = std::max(1, 2 * port::NumSchedulableCPUs());
+  }
+  VLOG(1) << "Enabling thread-local cache with " << num_shards
+          << " shards for " << Name();
+  thread_cache_shards_.reset(new ThreadCacheShard[num_shards]);
+  num_thread_cache_shards_ = num_shards;
+}
+
+BFCAllocator::ThreadCacheShard* BFCAllocator::CurrentThreadCacheShard() {
+  static std::atomic<int> next_thread_index{0};
+  static thread_local const int thread_index =
+      next_thread_index.fetch_add(1, std::memory_order_relaxed);
+  return &thread_cache_shards_[thread_index % num_thread_cache_shards_];
+}
+
+std::atomic<uint8>* BFCAllocator::ThreadCacheEntryFor(const void* ptr) {
+  const char* p = static_cast<const char*>(ptr);
+  const int num_maps =
+      num_thread_cache_region_maps_.load(std::memory_order_acquire);
+  for (int i = 0; i < num_maps; ++i) {
+    const ThreadCacheRegionMap& map = *thread_cache_region_maps_[i];
+    if (p >= map.base && p < map.base + map.memory_size) {
+      return &map.size_classes[(p - map.base) >> kMinAllocationBits];
+    }
+  }
+  return nullptr;
+}
+
+void* BFCAllocator::AllocateFromThreadLocalCache(size_t rounded_bytes) {
+  const int size_class = (rounded_bytes >> kMinAllocationBits) - 1;
+  ThreadCacheShard* shard = CurrentThreadCacheShard();
+  void* ptr;
+  {
+    mutex_lock l(shard->mu);
+    std::vector<void*>& free_list = shard->free_lists[size_class];
+    if (free_list.empty()) {
+      mutex_lock l2(lock_);
+      RefillThreadLocalCache(size_class, &free_list);
+      if (free_list.empty()) return nullptr;
+      shard->cached_bytes += free_list.size() * rounded_bytes;
+    }
+    ptr = free_list.back();
+    free_list.pop_back();
+    shard->cached_bytes -= rounded_bytes;
+    shard->num_allocs.fetch_add(1, std::memory_order_relaxed);
+  }
+  UpdateThreadCachePeak(thread_cached_bytes_in_use_.fetch_add(
+                            rounded_bytes, std::memory_order_relaxed) +
+                        rounded_bytes);
+  return ptr;
+}
+
+bool BFCAllocator::DeallocateToThreadLocalCache(void* ptr) {
+  std::atomic<uint8>* entry = ThreadCacheEntryFor(ptr);
+  if (entry == nullptr) return false;
+  const uint8 tag = entry->load(std::memory_order_relaxed);
+  if (tag == 0) return false;
+  const int size_class = tag - 1;
+  const size_t bytes = ThreadCacheSizeClassBytes(size_class);
+  thread_cached_bytes_in_use_.fetch_sub(bytes, std::memory_order_relaxed);
+
+  ThreadCacheShard* shard = CurrentThreadCacheShard();
+  bool drained = false;
+  {
+    mutex_lock l(shard->mu);
+    std::vector<void*>& free_list = shard->free_lists[size_class];
+    free_list.push_back(ptr);
+    shard->cached_bytes += bytes;
+    const size_t batch_size = ThreadCacheBatchSize(size_class);
+    if (free_list.size() > 2 * batch_size ||
+        shard->cached_bytes > kMaxThreadCacheBytesPerShard) {
+      // Return the oldest chunks, or the whole list if the shard is over
+      // budget.
+      const size_t n = shard->cached_bytes > kMaxThreadCacheBytesPerShard
+                           ? free_list.size()
+                           : batch_size;
+      {
+        mutex_lock l2(lock_);
+        ReturnThreadCachedChunks(absl::MakeConstSpan(free_list.data(), n));
+      }
+      free_list.erase(free_list.begin(), free_list.begin() + n);
+      shard->cached_bytes -= n * bytes;
+      drained = true;
+    }
+  }
+  if (drained) {
+    retry_helper_.NotifyDealloc();
+  }
+  return true;
+}
+
+void BFCAllocator::RefillThreadLocalCache(int size_class,
+                                          std::vector<void*>* free_list) {
+  const size_t rounded_bytes = ThreadCacheSizeClassBytes(size_class);
+  const BinNum bin_num = BinNumForSize(rounded_bytes);
+  const size_t batch_size = ThreadCacheBatchSize(size_class);
+  // Chunks held by the cache are not in use by any client, so they are kept
+  // out of stats_.
+  const int64_t peak_bytes_in_use = stats_.peak_bytes_in_use;
+  for (size_t i = 0; i < batch_size; ++i) {
+    void* ptr = FindChunkPtr(bin_num, rounded_bytes, rounded_bytes, 0);
+    if (ptr == nullptr) {
+      // Only grow the allocator for the first chunk of a batch.
+      if (i > 0 || !Extend(Allocator::kAllocatorAlignment, rounded_bytes)) {
+        break;
+      }
+      ptr = FindChunkPtr(bin_num, rounded_bytes, rounded_bytes, 0);
+      if (ptr == nullptr) break;
+    }
+    const Chunk* c = ChunkFromHandle(region_manager_.get_handle(ptr));
+    stats_.bytes_in_use -= c->size;
+    --stats_.num_allocs;
+    uncached_bytes_in_use_.store(stats_.bytes_in_use,
+                                 std::memory_order_relaxed);
+    std::atomic<uint8>* entry = ThreadCacheEntryFor(ptr);
+    if (c->size != rounded_bytes || entry == nullptr) {
+      // The best fit was too small to split or lies in a region the cache
+      // does not cover; leave it to the regular allocation path.
+      ReturnThreadCachedChunks({ptr});
+      break;
+    }
+    entry->store(size_class + 1, std::memory_order_relaxed);
+    free_list->push_back(ptr);
+  }
+  stats_.peak_bytes_in_use = peak_bytes_in_use;
+}
+
+void BFCAllocator::ReturnThreadCachedChunks(absl::Span<void* const> ptrs) {
+  for (void* ptr : ptrs) {
+    ChunkHandle h = region_manager_.get_handle(ptr);
+    CHECK(h != kInvalidChunkHandle);
+    std::atomic<uint8>* entry = ThreadCacheEntryFor(ptr);
+    if (entry != nullptr) {
+      entry->store(0, std::memory_order_relaxed);
+    }
+    // MarkFree() takes the chunk out of stats_, which never counted it.
+    stats_.bytes_in_use += ChunkFromHandle(h)->size;
+    MarkFree(h);
+    InsertFreeChunkIntoBin(TryToCoalesce(h, /*ignore_freed_at=*/false));
+  }
+}
+
+bool BFCAllocator::FlushThreadLocalCache() {
+  if (thread_cache_shards_ == nullptr) return false;
+  bool flushed = false;
+  for (int i = 0; i < num_thread_cache_shards_; ++i) {
+    ThreadCacheShard& shard = thread_cache_shards_[i];
+    mutex_lock l(shard.mu);
+    if (shard.cached_bytes == 0) continue;
+    mutex_lock l2(lock_);
+    for (auto& free_list : shard.free_lists) {
+      ReturnThreadCachedChunks(free_list);
+      free_list.clear();
+    }
+    shard.cached_bytes = 0;
+    flushed = true;
+  }
+  if (flushed) {
+    retry_helper_.NotifyDealloc();
+  }
+  return flushed;
+}
+
+void BFCAllocator::UpdateThreadCachePeak(int64_t thread_cached_bytes_in_use) {
+  const int64_t bytes_in_use =
+      thread_cached_bytes_in_use +
+      uncached_bytes_in_use_.load(std::memory_order_relaxed);
+  int64_t peak =
+      thread_cache_peak_bytes_in_use_.load(std::memory_order_relaxed);
+  while (bytes_in_use > peak &&
+         !thread_cache_peak_bytes_in_use_.compare_exchange_weak(
+             peak, bytes_in_use, std::memory_order_relaxed)) {
+  }
+}
+
 std::array<BFCAllocator::BinDebugInfo, BFCAllocator::kNumBins>
 BFCAllocator::get_bin_debug_info() {
   std::array<BinDebugInfo, kNumBins> bin_infos;
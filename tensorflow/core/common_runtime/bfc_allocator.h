@@ -17,6 +17,7 @@ limitations under the License.
 #define TENSORFLOW_CORE_COMMON_RUNTIME_BFC_ALLOCATOR_H_
 
 #include <array>
+#include <atomic>
 #include <deque>
 #include <memory>
 #include <string>
@@ -24,6 +25,7 @@ limitations under the License.
 #include <vector>
 
 #include "absl/container/flat_hash_set.h"
+#include "absl/types/span.h"
 #include "tensorflow/core/common_runtime/allocator_retry.h"
 #include "tensorflow/core/common_runtime/shared_counter.h"
 #include "tensorflow/core/framework/allocator.h"
@@ -85,6 +87,24 @@ class BFCAllocator : public Allocator {
 
   MemoryDump RecordMemoryMap();
 
+  // Enables a front-end cache of small free chunks, in the spirit of
+  // tcmalloc's per-thread caches, so that concurrent threads can allocate and
+  // free small buffers without contending on lock_. The cache is striped into
+  // `num_shards` shards (twice the number of schedulable CPUs if <= 0) and
+  // threads are assigned to shards round-robin on first use. Requests of at
+  // most kMaxThreadCachedBytes are served from the calling thread's shard,
+  // which refills from and drains to the bins in batches under lock_.
+  //
+  // Allocations served by the cache report their size class (the rounded
+  // size) from RequestedSize(). Must be called before the first allocation,
+  // and may not be combined with SetTimingCounter() or garbage collection.
+  void EnableThreadLocalCache(int num_shards = 0);
+
+  // Returns all chunks held by the thread-local cache to the bins, e.g. so
+  // that they can be coalesced to satisfy a large request. Returns true if
+  // any chunk was returned.
+  bool FlushThreadLocalCache();
+
  protected:
   // This setting controls when a chunk should be split, if its size exceeds the
   // requested allocation size. It is not expected to be changed after
@@ -104,6 +124,12 @@ class BFCAllocator : public Allocator {
       size_t alignment, size_t num_bytes,
       const AllocationAttributes& allocation_attr);
 
+  // Calls AllocateRawInternal() and, if that fails while the thread-local
+  // cache is enabled, flushes the cache and tries once more.
+  void* AllocateRawInternalWithCacheFlush(size_t alignment, size_t num_bytes,
+                                          bool dump_log_on_failure,
+                                          uint64 freed_before_count);
+
   void DeallocateRawInternal(void* ptr);
 
   // Chunks whose freed_at_count is later than the safe frontier value are kept
@@ -483,7 +509,11 @@ class BFCAllocator : public Allocator {
 
   string RenderOccupancy() TF_EXCLUSIVE_LOCKS_REQUIRED(lock_);
   void DumpMemoryLog(size_t num_bytes) TF_EXCLUSIVE_LOCKS_REQUIRED(lock_);
-  MemoryDump RecordMemoryMapInternal() TF_EXCLUSIVE_LOCKS_REQUIRED(lock_);
+  // If 'thread_cached_ptrs' is not null, the chunks it contains are held by
+  // the thread-local cache and are recorded as free.
+  MemoryDump RecordMemoryMapInternal(
+      const absl::flat_hash_set<const void*>* thread_cached_ptrs = nullptr)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(lock_);
   void MaybeWriteMemoryMap() TF_EXCLUSIVE_LOCKS_REQUIRED(lock_);
 
   ChunkHandle AllocateChunk() TF_EXCLUSIVE_LOCKS_REQUIRED(lock_);
@@ -515,6 +545,87 @@ class BFCAllocator : public Allocator {
   std::array<BinDebugInfo, kNumBins> get_bin_debug_info()
       TF_EXCLUSIVE_LOCKS_REQUIRED(lock_);
 
+  // Returns stats_ combined with the counters of the thread-local cache.
+  AllocatorStats GetStatsInternal() TF_EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // The thread-local cache serves requests of up to kMaxThreadCachedBytes,
+  // with one size class per multiple of kMinAllocationSize.
+  static constexpr size_t kMaxThreadCachedBytes = 32 << 10;
+  static constexpr int kNumThreadCacheSizeClasses =
+      kMaxThreadCachedBytes >> kMinAllocationBits;
+  // Target number of bytes moved between a shard and the bins at once.
+  static constexpr size_t kThreadCacheBatchBytes = 64 << 10;
+  // A shard holding more than this many idle bytes drains to the bins.
+  static constexpr size_t kMaxThreadCacheBytesPerShard = 1 << 20;
+  // The number of SubAllocator regions the thread-local cache can serve.
+  static constexpr int kMaxThreadCacheRegionMaps = 64;
+
+  static size_t ThreadCacheSizeClassBytes(int size_class) {
+    return static_cast<size_t>(size_class + 1) << kMinAllocationBits;
+  }
+  static size_t ThreadCacheBatchSize(int size_class) {
+    const size_t batch_size =
+        kThreadCacheBatchBytes / ThreadCacheSizeClassBytes(size_class);
+    return std::min<size_t>(32, std::max<size_t>(2, batch_size));
+  }
+
+  // One stripe of the thread-local cache. Chunks on the free lists are in
+  // use as far as the bins are concerned, but are not counted in stats_.
+  // Lock order: a shard's mu is always acquired before lock_.
+  struct alignas(64) ThreadCacheShard {
+    mutex mu;
+    // Free chunk pointers, indexed by size class, oldest first.
+    std::array<std::vector<void*>, kNumThreadCacheSizeClasses> free_lists
+        TF_GUARDED_BY(mu);
+    size_t cached_bytes TF_GUARDED_BY(mu) = 0;
+    // Allocations served by this shard since the last ClearStats().
+    std::atomic<int64_t> num_allocs{0};
+  };
+
+  // Maps the chunk addresses of one region obtained from sub_allocator_ to
+  // 1 + the size class of the thread-cached chunk starting there, or to 0 for
+  // chunks that are not managed by the thread-local cache. Entries only
+  // change under lock_ while no client owns the chunk, so DeallocateRaw() can
+  // read them without taking any lock.
+  struct ThreadCacheRegionMap {
+    ThreadCacheRegionMap(void* ptr, size_t memory_size)
+        : base(static_cast<const char*>(ptr)),
+          memory_size(memory_size),
+          size_classes(
+              new std::atomic<uint8>[memory_size >> kMinAllocationBits]()) {}
+
+    const char* const base;
+    const size_t memory_size;
+    std::unique_ptr<std::atomic<uint8>[]> size_classes;
+  };
+
+  ThreadCacheShard* CurrentThreadCacheShard();
+
+  // Returns the ThreadCacheRegionMap entry for 'ptr', or nullptr if 'ptr'
+  // lies outside all regions known to the thread-local cache.
+  std::atomic<uint8>* ThreadCacheEntryFor(const void* ptr);
+
+  // Returns a chunk of exactly 'rounded_bytes' from the calling thread's
+  // shard, or nullptr if none could be obtained.
+  void* AllocateFromThreadLocalCache(size_t rounded_bytes);
+
+  // Puts 'ptr' on the calling thread's shard if it was allocated from the
+  // thread-local cache. Returns false if the caller has to free it instead.
+  bool DeallocateToThreadLocalCache(void* ptr);
+
+  // Moves up to one batch of free chunks of 'size_class' from the bins onto
+  // 'free_list'.
+  void RefillThreadLocalCache(int size_class, std::vector<void*>* free_list)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Returns thread-cached chunks to the bins.
+  void ReturnThreadCachedChunks(absl::Span<void* const> ptrs)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Folds the bytes currently in use by clients into
+  // thread_cache_peak_bytes_in_use_.
+  void UpdateThreadCachePeak(int64_t thread_cached_bytes_in_use);
+
   AllocatorRetry retry_helper_;
 
   // Structures immutable after construction
@@ -603,6 +714,23 @@ class BFCAllocator : public Allocator {
 
   // Stats.
   AllocatorStats stats_ TF_GUARDED_BY(lock_);
+
+  // Thread-local cache state; see EnableThreadLocalCache(). The shards are
+  // null if the cache is disabled.
+  std::unique_ptr<ThreadCacheShard[]> thread_cache_shards_;
+  int num_thread_cache_shards_ = 0;
+  // Only appended to, under lock_. The first num_thread_cache_region_maps_
+  // entries may be read without holding lock_.
+  std::unique_ptr<ThreadCacheRegionMap>
+      thread_cache_region_maps_[kMaxThreadCacheRegionMaps];
+  std::atomic<int> num_thread_cache_region_maps_{0};
+  // Bytes of chunks that were handed out by the thread-local cache and not
+  // returned to it yet.
+  std::atomic<int64_t> thread_cached_bytes_in_use_{0};
+  // Copy of stats_.bytes_in_use that can be read without holding lock_.
+  std::atomic<int64_t> uncached_bytes_in_use_{0};
+  // Peak of the bytes in use by clients, across both allocation paths.
+  std::atomic<int64_t> thread_cache_peak_bytes_in_use_{0};
 #ifdef TENSORFLOW_MEM_DEBUG
   int64 action_counter_ = 0 TF_GUARDED_BY(lock_);
 #define MEM_DEBUG_SIZE_HISTORY_SIZE 4096
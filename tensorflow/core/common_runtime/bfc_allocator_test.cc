@@ -0,0 +1,250 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/bfc_allocator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/pool_allocator.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/blocking_counter.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow/core/protobuf/bfc_memory_map.pb.h"
+
+namespace tensorflow {
+namespace {
+
+SubAllocator* CreateCPUSubAllocator() {
+  return new BasicCPUAllocator(port::kNUMANoAffinity, {}, {});
+}
+
+void CheckStats(Allocator* a, int64_t num_allocs, int64_t bytes_in_use,
+                int64_t peak_bytes_in_use) {
+  absl::optional<AllocatorStats> stats = a->GetStats();
+  ASSERT_TRUE(stats);
+  LOG(INFO) << "Alloc stats: " << std::endl << stats->DebugString();
+  EXPECT_EQ(stats->bytes_in_use, bytes_in_use);
+  EXPECT_EQ(stats->peak_bytes_in_use, peak_bytes_in_use);
+  EXPECT_EQ(stats->num_allocs, num_allocs);
+}
+
+TEST(BFCAllocatorTest, ThreadLocalCacheNoDups) {
+  BFCAllocator a(CreateCPUSubAllocator(), 1 << 30, /*allow_growth=*/true,
+                 "cpu_bfc");
+  a.EnableThreadLocalCache(/*num_shards=*/4);
+  CheckStats(&a, 0, 0, 0);
+
+  std::vector<void*> ptrs;
+  for (int s = 1; s < 1024; s++) {
+    ptrs.push_back(a.AllocateRaw(1, s));
+  }
+  CheckStats(&a, 1023, 654336, 654336);
+
+  std::sort(ptrs.begin(), ptrs.end());
+  for (size_t i = 1; i < ptrs.size(); i++) {
+    ASSERT_NE(ptrs[i], ptrs[i - 1]);
+    size_t req_size = a.RequestedSize(ptrs[i - 1]);
+    ASSERT_GT(req_size, 0);
+    ASSERT_GE(static_cast<char*>(ptrs[i]) - static_cast<char*>(ptrs[i - 1]),
+              req_size);
+  }
+
+  for (size_t i = 0; i < ptrs.size(); i++) {
+    a.DeallocateRaw(ptrs[i]);
+  }
+  CheckStats(&a, 1023, 0, 654336);
+}
+
+TEST(BFCAllocatorTest, ThreadLocalCacheReusesFreedChunks) {
+  BFCAllocator a(CreateCPUSubAllocator(), 1 << 30, /*allow_growth=*/true,
+                 "cpu_bfc");
+  a.EnableThreadLocalCache(/*num_shards=*/1);
+
+  void* p1 = a.AllocateRaw(1, 1000);
+  a.DeallocateRaw(p1);
+  void* p2 = a.AllocateRaw(1, 1000);
+  EXPECT_EQ(p1, p2);
+  EXPECT_EQ(1024, a.AllocatedSize(p2));
+  a.DeallocateRaw(p2);
+  CheckStats(&a, 2, 0, 1024);
+
+  EXPECT_TRUE(a.ClearStats());
+  CheckStats(&a, 0, 0, 0);
+}
+
+TEST(BFCAllocatorTest, ThreadLocalCacheLargeAllocationsBypassCache) {
+  BFCAllocator a(CreateCPUSubAllocator(), 1 << 30, /*allow_growth=*/true,
+                 "cpu_bfc");
+  a.EnableThreadLocalCache(/*num_shards=*/1);
+
+  void* small = a.AllocateRaw(1, 256);
+  void* large = a.AllocateRaw(1, 1 << 16);
+  CheckStats(&a, 2, 256 + (1 << 16), 256 + (1 << 16));
+  a.DeallocateRaw(large);
+  CheckStats(&a, 2, 256, 256 + (1 << 16));
+  a.DeallocateRaw(small);
+  CheckStats(&a, 2, 0, 256 + (1 << 16));
+}
+
+TEST(BFCAllocatorTest, ThreadLocalCacheMemoryMapReportsCachedChunksFree) {
+  BFCAllocator a(CreateCPUSubAllocator(), 1 << 30, /*allow_growth=*/true,
+                 "cpu_bfc");
+  a.EnableThreadLocalCache(/*num_shards=*/1);
+
+  void* in_use = a.AllocateRaw(1, 512);
+  void* freed = a.AllocateRaw(1, 512);
+  a.DeallocateRaw(freed);
+
+  MemoryDump md = a.RecordMemoryMap();
+  EXPECT_EQ(md.stats().num_allocs(), 2);
+  EXPECT_EQ(md.stats().bytes_in_use(), 512);
+  int64_t chunks_in_use = 0;
+  int64_t bytes_in_use = 0;
+  for (const MemChunk& chunk : md.chunk()) {
+    if (chunk.in_use()) {
+      ++chunks_in_use;
+      bytes_in_use += chunk.size();
+      EXPECT_EQ(chunk.address(), reinterpret_cast<uint64>(in_use));
+    }
+  }
+  EXPECT_EQ(chunks_in_use, 1);
+  EXPECT_EQ(bytes_in_use, 512);
+  int64_t summary_bytes_in_use = 0;
+  for (const BinSummary& bin : md.bin_summary()) {
+    summary_bytes_in_use += bin.total_bytes_in_use();
+  }
+  EXPECT_EQ(summary_bytes_in_use, 512);
+
+  a.DeallocateRaw(in_use);
+}
+
+TEST(BFCAllocatorTest, ThreadLocalCacheIsFlushedWhenOutOfMemory) {
+  // A 1MiB allocator whose memory ends up entirely in cached small chunks.
+  BFCAllocator a(CreateCPUSubAllocator(), 1 << 20, /*allow_growth=*/false,
+                 "cpu_bfc");
+  a.EnableThreadLocalCache(/*num_shards=*/1);
+
+  std::vector<void*> ptrs;
+  while (void* p = a.AllocateRaw(1, 4096, AllocationAttributes(
+                                              /*retry_on_failure=*/false,
+                                              /*allocation_will_be_logged=*/
+                                              false, nullptr))) {
+    ptrs.push_back(p);
+  }
+  EXPECT_GT(ptrs.size(), 0);
+  for (void* p : ptrs) {
+    a.DeallocateRaw(p);
+  }
+
+  // Needs the whole region, so only succeeds if the chunks still held by the
+  // cache are returned and coalesced.
+  void* large = a.AllocateRaw(1, 1 << 20);
+  EXPECT_NE(large, nullptr);
+  a.DeallocateRaw(large);
+  EXPECT_FALSE(a.FlushThreadLocalCache());
+}
+
+TEST(BFCAllocatorTest, ThreadLocalCacheMultiThreaded) {
+  BFCAllocator a(CreateCPUSubAllocator(), 1 << 30, /*allow_growth=*/true,
+                 "cpu_bfc");
+  a.EnableThreadLocalCache(/*num_shards=*/4);
+  constexpr int kNumThreads = 8;
+  constexpr int kNumIters = 2000;
+  {
+    thread::ThreadPool pool(Env::Default(), "test", kNumThreads);
+    for (int t = 0; t < kNumThreads; ++t) {
+      pool.Schedule([&a, t]() {
+        std::vector<std::pair<char*, int>> live;
+        for (int i = 0; i < kNumIters; ++i) {
+          const int bytes = 1 + (i * 97 + t * 31) % 20000;
+          char* p = static_cast<char*>(a.AllocateRaw(1, bytes));
+          CHECK(p != nullptr);
+          // Tag the buffer so that overlapping allocations are detected.
+          std::fill(p, p + bytes, static_cast<char>(t));
+          live.emplace_back(p, bytes);
+          if (live.size() > 16) {
+            auto victim = live.begin() + (i % live.size());
+            CHECK(std::all_of(victim->first, victim->first + victim->second,
+                              [t](char c) { return c == t; }));
+            a.DeallocateRaw(victim->first);
+            live.erase(victim);
+          }
+        }
+        for (auto& p : live) {
+          a.DeallocateRaw(p.first);
+        }
+      });
+    }
+  }
+  absl::optional<AllocatorStats> stats = a.GetStats();
+  ASSERT_TRUE(stats);
+  EXPECT_EQ(stats->num_allocs, kNumThreads * kNumIters);
+  EXPECT_EQ(stats->bytes_in_use, 0);
+}
+
+// Each thread repeatedly allocates a few small temporaries and frees them
+// again, as inter-op threads running small kernels do.
+static void BM_SmallAllocationsThreaded(::testing::benchmark::State& state) {
+  const int num_threads = state.range(0);
+  const bool use_thread_local_cache = state.range(1);
+  constexpr int kItersPerThread = 10000;
+  constexpr int kLiveAllocations = 8;
+  BFCAllocator a(CreateCPUSubAllocator(), 1uLL << 32, /*allow_growth=*/true,
+                 "cpu_bfc");
+  if (use_thread_local_cache) {
+    a.EnableThreadLocalCache();
+  }
+  thread::ThreadPool pool(Env::Default(), "test", num_threads);
+
+  for (auto s : state) {
+    BlockingCounter done(num_threads);
+    for (int t = 0; t < num_threads; t++) {
+      pool.Schedule([&a, &done]() {
+        const int sizes[] = {64, 256, 1024, 4000, 512, 16384, 128, 2048};
+        void* ptrs[kLiveAllocations];
+        for (int i = 0; i < kItersPerThread; i++) {
+          for (int j = 0; j < kLiveAllocations; ++j) {
+            ptrs[j] = a.AllocateRaw(1, sizes[(i + j) % kLiveAllocations]);
+          }
+          for (int j = 0; j < kLiveAllocations; ++j) {
+            a.DeallocateRaw(ptrs[j]);
+          }
+        }
+        done.DecrementCount();
+      });
+    }
+    done.Wait();
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                          num_threads * kItersPerThread * kLiveAllocations);
+}
+BENCHMARK(BM_SmallAllocationsThreaded)
+    ->UseRealTime()
+    ->ArgPair(1, false)
+    ->ArgPair(1, true)
+    ->ArgPair(4, false)
+    ->ArgPair(4, true)
+    ->ArgPair(16, false)
+    ->ArgPair(16, true)
+    ->ArgPair(64, false)
+    ->ArgPair(64, true);
+
+}  // namespace
+}  // namespace tensorflow
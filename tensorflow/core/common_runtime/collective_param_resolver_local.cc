@@ -36,6 +36,7 @@ limitations under the License.
 #include "tensorflow/core/platform/types.h"
 #include "tensorflow/core/protobuf/config.pb.h"
 #include "tensorflow/core/util/device_name_utils.h"
+#include "tensorflow/core/util/env_var.h"
 
 namespace tensorflow {
 
@@ -58,13 +59,96 @@ void CollectiveParamResolverLocal::CompleteGroupAsync(
 }
 
 namespace {
+// Groups of at least this many devices reduce tensors of at most
+// MaxHalvingDoublingBytes() bytes by recursive halving-doubling by default.
+int64_t MinHalvingDoublingGroupSize() {
+  static const int64_t group_size = [] {
+    constexpr int64_t kDefaultGroupSize = 16;
+    int64_t group_size;
+    Status s =
+        ReadInt64FromEnvVar("TF_COLLECTIVE_HALVING_DOUBLING_MIN_GROUP_SIZE",
+                            kDefaultGroupSize, &group_size);
+    if (!s.ok()) {
+      LOG(ERROR) << "Invalid TF_COLLECTIVE_HALVING_DOUBLING_MIN_GROUP_SIZE: "
+                 << s;
+      return kDefaultGroupSize;
+    }
+    return group_size;
+  }();
+  return group_size;
+}
+
+int64_t MaxHalvingDoublingBytes() {
+  static const int64_t num_bytes = [] {
+    constexpr int64_t kDefaultNumBytes = 256 << 10;
+    int64_t num_bytes;
+    Status s = ReadInt64FromEnvVar("TF_COLLECTIVE_HALVING_DOUBLING_MAX_BYTES",
+                                   kDefaultNumBytes, &num_bytes);
+    if (!s.ok()) {
+      LOG(ERROR) << "Invalid TF_COLLECTIVE_HALVING_DOUBLING_MAX_BYTES: " << s;
+      return kDefaultNumBytes;
+    }
+    return num_bytes;
+  }();
+  return num_bytes;
+}
+
+bool IsRegistered(const string& collective_name) {
+  CollectiveImplementationInterface* col_impl;
+  return CollectiveRegistry::LookupParamResolverInstance(collective_name,
+                                                         &col_impl)
+      .ok();
+}
+
+// Returns the implementation of an all-reduce that does not use NCCL.
+//
+// A ring takes 2 * (group_size - 1) sequential steps, which dominate for small
+// tensors and large groups, so these are reduced by recursive halving-doubling
+// in 2 * log2(group_size) steps instead. Larger tensors are reduced in two
+// dimensions if the group spans several tasks with several devices each, so
+// that fewer bytes and steps cross task boundaries. The choice also depends
+// on environment variables, so only the group leader makes it, for the first
+// member of an instance; see CompleteInstanceFromInitializedIRec.
+const char* GetReductionName(const CollectiveParams* cp) {
+  const string& hint = cp->instance.impl_details.communication_hint;
+  const CollGroupParams& group = cp->group;
+  const bool can_use_hierarchical = group.num_tasks > 1 &&
+                                    group.same_num_devices_per_task &&
+                                    group.group_size > group.num_tasks;
+  if (hint == "halving_doubling" &&
+      IsRegistered("RecursiveHalvingDoublingReduce")) {
+    return "RecursiveHalvingDoublingReduce";
+  }
+  if (hint == "hierarchical" && can_use_hierarchical &&
+      IsRegistered("HierarchicalReduce")) {
+    return "HierarchicalReduce";
+  }
+  if (hint != "" && hint != "auto") {
+    return "RingReduce";
+  }
+  if (group.device_type != DEVICE_CPU ||
+      group.group_size < MinHalvingDoublingGroupSize()) {
+    return "RingReduce";
+  }
+  const int64_t num_bytes = cp->instance.shape.num_elements() *
+                            DataTypeSize(cp->instance.data_type);
+  if (num_bytes <= MaxHalvingDoublingBytes() &&
+      IsRegistered("RecursiveHalvingDoublingReduce")) {
+    return "RecursiveHalvingDoublingReduce";
+  }
+  if (can_use_hierarchical && IsRegistered("HierarchicalReduce")) {
+    return "HierarchicalReduce";
+  }
+  return "RingReduce";
+}
+
 const char* GetCollectiveName(const CollectiveParams* cp, bool nccl) {
   switch (cp->instance.type) {
     case BROADCAST_COLLECTIVE:
       return nccl ? "NcclBroadcast" : "HierarchicalTreeBroadcast";
 
     case REDUCTION_COLLECTIVE:
-      return nccl ? "NcclReduce" : "RingReduce";
+      return nccl ? "NcclReduce" : GetReductionName(cp);
 
     case GATHER_COLLECTIVE:
       return nccl ? "NcclGather" : "RingGather";
@@ -695,8 +779,21 @@ void CollectiveParamResolverLocal::CompleteInstanceFromInitializedIRec(
         " op."));
     return;
   }
-  // Populate the fields common across task.
-  AssignCollectiveType(cp);
+  // Populate the fields common across task. All members of an instance use
+  // the implementation chosen for its first member, which is recorded in the
+  // instance. Members on other tasks than the group leader receive the choice
+  // of the leader through UpdateInstanceCache.
+  if (cp->instance.impl_details.collective_name.empty()) {
+    AssignCollectiveType(cp);
+    mutex_lock l(ir->mu);
+    string& collective_name =
+        ir->shared->instance.impl_details.collective_name;
+    if (collective_name.empty()) {
+      collective_name = cp->instance.impl_details.collective_name;
+    } else {
+      cp->instance.impl_details.collective_name = collective_name;
+    }
+  }
   SetDefaultRank(device, cp);
 
   CollectiveImplementationInterface* col_impl;
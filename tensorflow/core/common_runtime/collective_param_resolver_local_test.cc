@@ -77,6 +77,11 @@ class CollectiveParamResolverLocalTest : public ::testing::Test {
     EXPECT_EQ(actual_device_order, expected_device_order);
   }
 
+  string AssignCollectiveType(CollectiveParams* cp) {
+    prl_->AssignCollectiveType(cp);
+    return cp->instance.impl_details.collective_name;
+  }
+
   DeviceAttributes GetDeviceAttributes(const string& device_name) {
     Device* device = nullptr;
     TF_CHECK_OK(device_mgr_->LookupDevice(device_name, &device));
@@ -160,6 +165,39 @@ TEST_F(CollectiveParamResolverLocalTest, CompleteDefaultRanking) {
                             });
 }
 
+TEST_F(CollectiveParamResolverLocalTest, AssignReductionImplementation) {
+  core::RefCountPtr<CollectiveParams> cp(new CollectiveParams());
+  cp->instance.type = REDUCTION_COLLECTIVE;
+  cp->instance.data_type = DT_FLOAT;
+  cp->group.device_type = DEVICE_CPU;
+  cp->group.group_size = 64;
+  cp->group.num_tasks = 8;
+  cp->group.same_num_devices_per_task = true;
+
+  // Small tensors in large groups use recursive halving-doubling.
+  cp->instance.shape = TensorShape({1024});
+  EXPECT_EQ(AssignCollectiveType(cp.get()), "RecursiveHalvingDoublingReduce");
+  // Large tensors use the two-dimensional reduction across tasks...
+  cp->instance.shape = TensorShape({1 << 20});
+  EXPECT_EQ(AssignCollectiveType(cp.get()), "HierarchicalReduce");
+  // ... unless each task has a single device.
+  cp->group.num_tasks = 64;
+  EXPECT_EQ(AssignCollectiveType(cp.get()), "RingReduce");
+  // Small groups always use a ring.
+  cp->group.group_size = 4;
+  cp->group.num_tasks = 2;
+  cp->instance.shape = TensorShape({1024});
+  EXPECT_EQ(AssignCollectiveType(cp.get()), "RingReduce");
+  // The communication hint overrides the choice.
+  cp->instance.impl_details.communication_hint = "halving_doubling";
+  EXPECT_EQ(AssignCollectiveType(cp.get()), "RecursiveHalvingDoublingReduce");
+  cp->instance.impl_details.communication_hint = "hierarchical";
+  EXPECT_EQ(AssignCollectiveType(cp.get()), "HierarchicalReduce");
+  cp->group.group_size = 64;
+  cp->instance.impl_details.communication_hint = "ring";
+  EXPECT_EQ(AssignCollectiveType(cp.get()), "RingReduce");
+}
+
 TEST_F(CollectiveParamResolverLocalTest, CompleteParamsReduction1Task) {
   CollectiveParams* cps[NUM_DEVS];
   Status statuses[NUM_DEVS];
@@ -210,6 +210,7 @@ core::RefCountPtr<CollectiveParams> CreateCollectiveParams(
   col_params->group.group_size =
       test_env.num_workers * test_env.num_devices_per_worker;
   col_params->group.num_tasks = test_env.num_workers;
+  col_params->group.same_num_devices_per_task = true;
   col_params->group.device_type = test_env.device_type;
   for (int wi = 0; wi < test_env.num_workers; ++wi) {
     string task_name = strings::StrCat("/job:worker/replica:0/task:", wi);
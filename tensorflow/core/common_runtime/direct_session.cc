@@ -792,6 +792,14 @@ Status DirectSession::RunInternal(
 
     mutex_lock l(executor_lock_);
     run_state.collector->BuildCostModel(&cost_model_manager_, device_to_graph);
+    // Adds the compute times measured by the executors across all the steps
+    // they ran, for the nodes that the collected step stats do not cover.
+    for (const PerPartitionExecutorsAndLib& partition :
+         executors_and_keys->items) {
+      const Graph* graph = partition.graph.get();
+      partition.executor->RecordCostEstimates(
+          *graph, cost_model_manager_.FindOrCreateCostModel(graph));
+    }
 
     // annotate stats onto cost graph.
     CostGraphDef* cost_graph = run_metadata->mutable_cost_graph();
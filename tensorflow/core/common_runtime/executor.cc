@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "tensorflow/core/common_runtime/executor.h"
 
+#include <algorithm>
 #include <atomic>
 #include <memory>
 #include <vector>
@@ -31,7 +32,10 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/propagator_state.h"
 #include "tensorflow/core/common_runtime/renamed_device.h"
 #include "tensorflow/core/common_runtime/simple_propagator_state.h"
+#include "tensorflow/core/common_runtime/static_memory_planner.h"
+#include "tensorflow/core/common_runtime/step_arena_allocator.h"
 #include "tensorflow/core/common_runtime/step_stats_collector.h"
+#include "tensorflow/core/common_runtime/work_stealing_ready_queue.h"
 #include "tensorflow/core/framework/allocator.h"
 #include "tensorflow/core/framework/cancellation.h"
 #include "tensorflow/core/framework/collective.h"
@@ -46,6 +50,7 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor_reference.h"
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/framework/types.pb.h"
+#include "tensorflow/core/graph/costmodel.h"
 #include "tensorflow/core/graph/edgeset.h"
 #include "tensorflow/core/graph/graph.h"
 #include "tensorflow/core/graph/graph_node_util.h"
@@ -58,6 +63,7 @@ limitations under the License.
 #include "tensorflow/core/lib/gtl/manual_constructor.h"
 #include "tensorflow/core/lib/hash/hash.h"
 #include "tensorflow/core/platform/context.h"
+#include "tensorflow/core/platform/cpu_info.h"
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/errors.h"
 #include "tensorflow/core/platform/logging.h"
@@ -72,6 +78,7 @@ limitations under the License.
 #include "tensorflow/core/profiler/lib/scoped_annotation.h"
 #include "tensorflow/core/profiler/lib/traceme_encode.h"
 #include "tensorflow/core/protobuf/error_codes.pb.h"
+#include "tensorflow/core/util/env_var.h"
 #include "tensorflow/core/util/tensor_slice_reader_cache.h"
 
 namespace tensorflow {
@@ -132,22 +139,85 @@ struct KernelTimer {
   }
 };
 
+// In work-stealing mode, the estimated cost (in CPU cycles) of the inexpensive
+// nodes that a thread runs inline from one call to `Process()`. The nodes that
+// become ready beyond it are left for other workers to steal, which also
+// splits long chains of inexpensive nodes.
+static constexpr uint64 kMaxInlineBatchCycles = 64 * 1000;
+
+// Upper bound on the number of workers of a step in work-stealing mode.
+static constexpr int kMaxWorkStealingWorkers = 32;
+
+// The work-stealing worker that the current thread runs as, if any.
+struct CurrentWorker {
+  const void* queue = nullptr;
+  int index = -1;
+  // The estimated cost of the inexpensive nodes that the current call to
+  // `Process()` has run inline so far.
+  uint64 inline_cycles = 0;
+};
+thread_local CurrentWorker current_worker;
+
+// Returns true if the executor should decide which kernels are expensive from
+// their measured cost alone, rather than only demote the kernels that declare
+// themselves expensive. Controlled by the TF_EXECUTOR_USE_MEASURED_KERNEL_COSTS
+// environment variable, and false by default.
+bool MeasuredKernelCostsEnabled() {
+  static const bool enabled = [] {
+    bool enabled = false;
+    Status s = ReadBoolFromEnvVar("TF_EXECUTOR_USE_MEASURED_KERNEL_COSTS",
+                                  /*default_val=*/false, &enabled);
+    if (!s.ok()) {
+      LOG(ERROR) << "Invalid TF_EXECUTOR_USE_MEASURED_KERNEL_COSTS: " << s;
+      return false;
+    }
+    return enabled;
+  }();
+  return enabled;
+}
+
 // TODO(b/152925936): Re-evaluate these constants with current usage patterns.
 typedef gtl::InlinedVector<TensorValue, 4> TensorValueVec;
 typedef gtl::InlinedVector<AllocatorAttributes, 4> AllocatorAttributeVec;
 
 class ExecutorImpl : public Executor {
  public:
-  explicit ExecutorImpl(const LocalExecutorParams& p) : immutable_state_(p) {}
+  // If `work_stealing` is true, the nodes that are not run inline are
+  // scheduled through a WorkStealingReadyQueue rather than with one closure
+  // per node.
+  ExecutorImpl(const LocalExecutorParams& p, bool work_stealing)
+      : immutable_state_(p),
+        num_work_stealing_workers_(
+            work_stealing
+                ? std::min(port::MaxParallelism(), kMaxWorkStealingWorkers)
+                : 0) {}
 
   Status Initialize(const Graph& graph) {
     TF_RETURN_IF_ERROR(immutable_state_.Initialize(graph));
     kernel_stats_.Initialize(immutable_state_.graph_view());
+    Device* device = immutable_state_.params().device;
+    if ((StepArenaAllocatorEnabled() || StaticMemoryPlanEnabled()) &&
+        device->device_type() == DEVICE_CPU) {
+      step_memory_ = absl::make_unique<StepMemoryState>();
+      // Planning relies on every node running exactly once per step.
+      if (StaticMemoryPlanEnabled() &&
+          !immutable_state_.requires_control_flow_support()) {
+        step_memory_->planner = std::make_shared<StaticMemoryPlanner>(
+            device->GetAllocator(AllocatorAttributes()),
+            immutable_state_.graph_view().num_nodes());
+      }
+    }
     return Status::OK();
   }
 
   void RunAsync(const Args& args, DoneCallback done) override;
 
+  void RecordCostEstimates(const Graph& graph,
+                           CostModel* cost_model) const override {
+    kernel_stats_.RecordCostEstimates(immutable_state_.graph_view(), graph,
+                                      cost_model);
+  }
+
  private:
   template <class PropagatorStateType>
   friend class ExecutorState;
@@ -158,41 +228,75 @@ class ExecutorImpl : public Executor {
     KernelStats() = default;
 
     void Initialize(const GraphView& gview) {
+      use_measured_costs_ = MeasuredKernelCostsEnabled();
       is_expensive_.resize(gview.num_nodes());
       cost_estimates_ =
           absl::make_unique<std::atomic_uint_fast64_t[]>(gview.num_nodes());
+      is_measured_ = absl::make_unique<std::atomic<bool>[]>(gview.num_nodes());
       for (int32_t i = 0; i < gview.num_nodes(); ++i) {
         if (gview.node(i)) {
           is_expensive_[i] =
               gview.node(i)->kernel && gview.node(i)->kernel->IsExpensive();
-          cost_estimates_[i] = kInitialCostEstimateCycles;
+          cost_estimates_[i] = is_expensive_[i] ? kInitialCostEstimateCycles
+                                                : kInitialInexpensiveCostCycles;
         }
+        is_measured_[i] = false;
       }
     }
 
     // Returns true iff the given node is considered "expensive". The
     // executor uses this flag to optimize graph execution, for example
-    // by "inlining" inexpensive kernels.
+    // by "inlining" inexpensive kernels. Unless measured costs are enabled,
+    // only the kernels whose IsExpensive() returns true can be expensive.
     bool IsExpensive(const NodeItem& node) const {
-      return is_expensive_[node.node_id] &&
+      return (use_measured_costs_ || is_expensive_[node.node_id]) &&
              (cost_estimates_[node.node_id].load(std::memory_order_relaxed) >
               kOpIsExpensiveThresholdCycles);
     }
 
-    // Returns the value of kernel->IsExpensive().
-    bool HasExpensiveMarker(const NodeItem& node) const {
-      return is_expensive_[node.node_id];
+    // Returns true if the cost of the given node should be measured on its
+    // next execution. Kernels marked expensive are always measured; when
+    // measured costs are enabled, so are the kernels currently deemed
+    // expensive, and a sample of the invocations of the others.
+    bool ShouldMeasure(const NodeItem& node, bool is_expensive) const {
+      if (is_expensive_[node.node_id]) return true;
+      if (!use_measured_costs_) return false;
+      return is_expensive || SampleInexpensiveKernel();
+    }
+
+    // Returns the estimated cost of the given node in CPU cycles.
+    uint64 CostEstimate(const NodeItem& node) const {
+      return cost_estimates_[node.node_id].load(std::memory_order_relaxed);
+    }
+
+    // Returns true if the cost of the next inexpensive kernel run by the
+    // calling thread should be measured. Inexpensive kernels are sampled on
+    // ~1/16 of their invocations, so that the others do not pay for reading
+    // the cycle counter.
+    static bool SampleInexpensiveKernel() {
+      constexpr uint32 kKernelExecutionTrackingInvocationSkipCount = 16;
+      static thread_local uint32 num_invocations = 0;
+      return ++num_invocations % kKernelExecutionTrackingInvocationSkipCount ==
+             0;
     }
 
     // Updates the dynamic cost estimate, which is used to determine whether the
     // given node is expensive. The new cost estimate is a weighted average of
-    // the old cost estimate and the latest cost. We only update cost estimates
-    // for kernels for which IsExpensive() return true.
+    // the old cost estimate and the latest cost. When measured costs are
+    // enabled, the first measurement replaces the initial estimate instead.
     void UpdateCostEstimate(const NodeItem& node, uint64 elapsed_cycles) {
       // N.B. Updates to `cost_estimate` are atomic but unlocked.  Simultaneous
       // updates may result in one or more updates being ignored.  This does not
       // affect correctness but may slow down the update frequency.
       std::atomic_uint_fast64_t& cost_estimate = cost_estimates_[node.node_id];
+      std::atomic<bool>& is_measured = is_measured_[node.node_id];
+      if (!is_measured.load(std::memory_order_relaxed)) {
+        is_measured.store(true, std::memory_order_relaxed);
+        if (use_measured_costs_) {
+          cost_estimate.store(elapsed_cycles, std::memory_order_relaxed);
+          return;
+        }
+      }
       auto prev_estimate = cost_estimate.load(std::memory_order_relaxed);
 
       uint64 new_estimate =
@@ -201,21 +305,65 @@ class ExecutorImpl : public Executor {
       cost_estimate.store(new_estimate, std::memory_order_relaxed);
     }
 
+    // Records the measured cost estimates of the nodes of `graph` in
+    // `cost_model`, in microseconds. Nodes that were never measured are
+    // skipped.
+    void RecordCostEstimates(const GraphView& gview, const Graph& graph,
+                             CostModel* cost_model) const {
+      const double usec_per_cycle =
+          profile_utils::CpuUtils::GetMicroSecPerClock();
+      for (const Node* n : graph.op_nodes()) {
+        const int32_t id = n->id();
+        if (id >= gview.num_nodes() || gview.node(id) == nullptr ||
+            !is_measured_[id].load(std::memory_order_relaxed)) {
+          continue;
+        }
+        cost_model->RecordMeasuredTime(
+            n, Microseconds(static_cast<int64_t>(
+                   cost_estimates_[id].load(std::memory_order_relaxed) *
+                   usec_per_cycle)));
+      }
+    }
+
    private:
     // Initial time (in CPU cycles) we expect an operation to take.  Used to
     // determine whether an operation should be place in a threadpool.
-    // Operations start out "expensive".
+    // Operations marked expensive start out "expensive".
     static constexpr uint64 kInitialCostEstimateCycles = 100 * 1000 * 1000;
+    // Initial cost of the other operations, until they are measured. It stays
+    // below kOpIsExpensiveThresholdCycles, and bounds the number of such nodes
+    // that are run inline in work-stealing mode.
+    static constexpr uint64 kInitialInexpensiveCostCycles = 1000;
     static constexpr uint64 kOpIsExpensiveThresholdCycles = 8000;
     static constexpr uint64 kCostDecay = 10;
 
+    // Whether measured costs alone decide which kernels are expensive.
+    bool use_measured_costs_ = false;
     std::vector<bool> is_expensive_;
-    // std::unique_ptr<std::atomic<bool>[]> is_expensive_;
     std::unique_ptr<std::atomic_uint_fast64_t[]> cost_estimates_;
+    // Whether the cost of each node has been measured at least once.
+    std::unique_ptr<std::atomic<bool>[]> is_measured_;
   };
 
   ImmutableExecutorState immutable_state_;
   KernelStats kernel_stats_;
+  // The number of workers of each step in work-stealing mode, or 0.
+  const int num_work_stealing_workers_;
+
+  // State shared by the steps of this executor when they serve the tensors
+  // that do not escape them from a StepArenaAllocator.
+  struct StepMemoryState {
+    // The size of the first block of the next step arena: the largest amount
+    // of memory reserved by the arena of any previous step, so that in steady
+    // state a step needs a single block.
+    std::atomic<size_t> arena_block_bytes{
+        StepArenaAllocator::kDefaultInitialBlockBytes};
+    // If not null, serves the step-local tensors from a static memory plan,
+    // with the arena as a fallback.
+    std::shared_ptr<StaticMemoryPlanner> planner;
+  };
+  // Null unless step-local tensors are allocated from a step arena.
+  std::unique_ptr<StepMemoryState> step_memory_;
 
   TF_DISALLOW_COPY_AND_ASSIGN(ExecutorImpl);
 };
@@ -274,7 +422,9 @@ class ExecutorState {
  public:
   ExecutorState(const Executor::Args& args,
                 const ImmutableExecutorState& immutable_state_,
-                ExecutorImpl::KernelStats* kernel_stats_);
+                ExecutorImpl::KernelStats* kernel_stats_,
+                ExecutorImpl::StepMemoryState* step_memory,
+                int num_work_stealing_workers);
   ~ExecutorState();
 
   void RunAsync(Executor::DoneCallback done);
@@ -285,6 +435,7 @@ class ExecutorState {
   typedef
       typename PropagatorStateType::TaggedNodeReadyQueue TaggedNodeReadyQueue;
   typedef typename PropagatorStateType::TaggedNodeSeq TaggedNodeSeq;
+  typedef WorkStealingReadyQueue<TaggedNode> ReadyQueue;
 
   struct AsyncState;
 
@@ -326,6 +477,23 @@ class ExecutorState {
   // REQUIRES: `!ready->empty()`.
   void ScheduleReady(TaggedNodeSeq* ready, TaggedNodeReadyQueue* inline_ready);
 
+  // The work-stealing counterpart of the above: expensive nodes, and the
+  // inexpensive nodes beyond a batch of kMaxInlineBatchCycles, are pushed to
+  // `ready_queue_`, and workers are started for them if some are idle.
+  void ScheduleReadyWorkStealing(TaggedNodeSeq* ready,
+                                 TaggedNodeReadyQueue* inline_ready,
+                                 int64_t scheduled_nsec);
+
+  // Runs the nodes of `queue` as worker `worker` until it is empty. The last
+  // node may complete the step and delete `state`, so only `queue` is used
+  // between nodes.
+  static void RunWorker(ExecutorState* state, std::shared_ptr<ReadyQueue> queue,
+                        int worker, int64_t scheduled_nsec);
+
+  // Returns an empty queue for a new step. The deques take a few KiB per
+  // worker, so the queues of completed steps are reused.
+  static std::shared_ptr<ReadyQueue> NewReadyQueue(int num_workers);
+
   // A wrapper for runner_ to keep track of the pending queue length. Op
   // execution should dispatch work using this function instead of using runner_
   // directly.
@@ -369,6 +537,12 @@ class ExecutorState {
   CallFrameInterface* call_frame_;
   const ImmutableExecutorState& immutable_state_;
   ExecutorImpl::KernelStats* const kernel_stats_;
+  ExecutorImpl::StepMemoryState* const step_memory_;
+  // If not null, the arena for tensors that do not escape this step. If
+  // `memory_plan_step_` is also not null, the arena is owned by it and only
+  // serves the allocations outside the memory plan.
+  StepArenaAllocator* step_arena_ = nullptr;
+  StaticMemoryPlanner::Step* memory_plan_step_ = nullptr;
   CancellationManager* cancellation_manager_;
   CoordinationServiceAgent* coordination_service_agent_;
   // If not null, use this device to schedule intra-op operation
@@ -376,6 +550,9 @@ class ExecutorState {
   Executor::Args::Runner runner_;
   bool sync_on_finish_;
   const bool run_all_kernels_inline_;
+  // If not null, the ready nodes that do not run inline are scheduled through
+  // this queue. Shared with the workers, which outlive the step.
+  std::shared_ptr<ReadyQueue> ready_queue_;
 
   PropagatorStateType propagator_;
 
@@ -397,7 +574,8 @@ class ExecutorState {
 template <class PropagatorStateType>
 ExecutorState<PropagatorStateType>::ExecutorState(
     const Executor::Args& args, const ImmutableExecutorState& immutable_state,
-    ExecutorImpl::KernelStats* kernel_stats)
+    ExecutorImpl::KernelStats* kernel_stats,
+    ExecutorImpl::StepMemoryState* step_memory, int num_work_stealing_workers)
     : vlog_(VLOG_IS_ON(1)),
       log_memory_(LogMemory::IsEnabled()),
       step_id_(args.step_id),
@@ -418,6 +596,7 @@ ExecutorState<PropagatorStateType>::ExecutorState(
       call_frame_(args.call_frame),
       immutable_state_(immutable_state),
       kernel_stats_(kernel_stats),
+      step_memory_(step_memory),
       cancellation_manager_(args.cancellation_manager),
       coordination_service_agent_(args.coordination_service_agent),
       runner_(args.runner),
@@ -430,6 +609,18 @@ ExecutorState<PropagatorStateType>::ExecutorState(
     user_device_ = RenamedDevice::NewRenamedDevice(
         device->name(), device, false, false, args.user_intra_op_threadpool);
   }
+  if (num_work_stealing_workers > 0 && !run_all_kernels_inline_) {
+    ready_queue_ = NewReadyQueue(num_work_stealing_workers);
+  }
+  if (step_memory_ != nullptr) {
+    step_arena_ = new StepArenaAllocator(
+        immutable_state_.params().device->GetAllocator(AllocatorAttributes()),
+        step_memory_->arena_block_bytes.load(std::memory_order_relaxed),
+        StepArenaAllocator::kDefaultMaxBytes);
+    if (step_memory_->planner) {
+      memory_plan_step_ = step_memory_->planner->StartStep(step_arena_);
+    }
+  }
 }
 
 template <class PropagatorStateType>
@@ -438,6 +629,38 @@ ExecutorState<PropagatorStateType>::~ExecutorState() {
     device_context_->Unref();
   }
   delete slice_reader_cache_;
+  if (step_arena_) {
+    const StepArenaAllocator::Stats arena_stats = step_arena_->GetArenaStats();
+    const size_t reserved_bytes = arena_stats.bytes_reserved;
+    std::atomic<size_t>& hint = step_memory_->arena_block_bytes;
+    size_t block_bytes = hint.load(std::memory_order_relaxed);
+    while (reserved_bytes > block_bytes &&
+           !hint.compare_exchange_weak(block_bytes, reserved_bytes,
+                                       std::memory_order_relaxed)) {
+    }
+    if (stats_collector_) {
+      StepArenaStats stats;
+      stats.set_num_hits(arena_stats.num_hits);
+      stats.set_num_fallbacks(arena_stats.num_fallbacks);
+      stats.set_bytes_allocated(arena_stats.bytes_allocated);
+      stats.set_bytes_reserved(arena_stats.bytes_reserved);
+      if (memory_plan_step_) {
+        const StaticMemoryPlanner::Step::Stats plan_stats =
+            memory_plan_step_->GetStats();
+        stats.set_num_planned_hits(plan_stats.num_planned_hits);
+        stats.set_planned_bytes(plan_stats.planned_bytes);
+      }
+      stats_collector_->SaveStepArenaStats(
+          immutable_state_.params().device->name(), stats);
+    }
+    // Tensors that are still alive, such as the outputs held by the
+    // propagator, keep the arena blocks alive until they are deallocated.
+    if (memory_plan_step_) {
+      memory_plan_step_->Release();
+    } else {
+      step_arena_->Release();
+    }
+  }
 }
 
 template <class PropagatorStateType>
@@ -577,17 +800,10 @@ Status ExecutorState<PropagatorStateType>::ProcessSync(
         },
         profiler::GetTFTraceMeLevel(is_expensive));
     device->Compute(op_kernel, &ctx);
-  } else if (kernel_stats_->HasExpensiveMarker(item)) {
+  } else if (kernel_stats_->ShouldMeasure(item, is_expensive)) {
     KernelTimer timer;
     device->Compute(op_kernel, &ctx);
-    // For expensive kernels, always update the cost estimate. For inexpensive
-    // kernels, update the cost estimate with ~1/16 probability. This assumes
-    // that the last 4 bits of the CPU cycle count is uniformly distributed.
-    constexpr int kKernelExecutionTrackingInvocationSkipCount = 16;
-    if (is_expensive ||
-        timer.start_cycles % kKernelExecutionTrackingInvocationSkipCount == 0) {
-      kernel_stats_->UpdateCostEstimate(item, timer.ElapsedCycles());
-    }
+    kernel_stats_->UpdateCostEstimate(item, timer.ElapsedCycles());
   } else {
     device->Compute(op_kernel, &ctx);
   }
@@ -690,6 +906,7 @@ void ExecutorState<PropagatorStateType>::Process(TaggedNode tagged_node,
   WithContext wc(context_);
   TaggedNodeSeq ready;
   TaggedNodeReadyQueue inline_ready;
+  current_worker.inline_cycles = 0;
 
   // Parameters passed to OpKernel::Compute.
   TensorValueVec inputs;
@@ -725,6 +942,7 @@ void ExecutorState<PropagatorStateType>::Process(TaggedNode tagged_node,
   params.runner = &runner_;
   params.run_all_kernels_inline = run_all_kernels_inline_;
   params.stats_collector = stats_collector_;
+  params.step_arena_allocator = step_arena_;
   params.inc_num_deferred_ops_function = [this]() {
     mutex_lock lock(num_deferred_ops_mu_);
     num_deferred_ops_++;
@@ -816,6 +1034,11 @@ void ExecutorState<PropagatorStateType>::Process(TaggedNode tagged_node,
       params.output_attr_array = item.output_attrs();
       params.forward_from_array = item.forward_from();
       params.outputs_required_array = item.outputs_required.get();
+      params.outputs_step_local_array = item.outputs_step_local.get();
+      params.temps_step_local = item.is_step_local;
+      if (memory_plan_step_) {
+        params.step_arena_allocator = memory_plan_step_->ForNode(id);
+      }
 
       if (item.kernel_is_async) {
         ProcessAsync(item, params, tagged_node, first_input, stats);
@@ -1181,12 +1404,32 @@ void ExecutorState<PropagatorStateType>::ScheduleReady(
         inline_ready->push_back(tagged_node);
       }
     }
+  } else if (ready_queue_) {
+    ScheduleReadyWorkStealing(ready, inline_ready, scheduled_nsec);
   } else {
     const TaggedNode* curr_expensive_node = nullptr;
     if (inline_ready == nullptr) {
-      // Schedule to run all the ready ops in thread pool.
+      // Schedule to run all the ready ops in thread pool. The inexpensive ones
+      // share a single closure, so that they and their inexpensive successors
+      // run on one thread rather than paying a thread wakeup each.
+      TaggedNodeSeq inexpensive;
       for (auto& tagged_node : *ready) {
-        RunTask([=]() { Process(tagged_node, scheduled_nsec); });
+        const NodeItem& item = *tagged_node.node_item;
+        if (tagged_node.get_is_dead() || !kernel_stats_->IsExpensive(item)) {
+          inexpensive.push_back(tagged_node);
+        } else {
+          RunTask([=]() { Process(tagged_node, scheduled_nsec); });
+        }
+      }
+      if (inexpensive.size() == 1) {
+        RunTask(std::bind(&ExecutorState::Process, this, inexpensive[0],
+                          scheduled_nsec));
+      } else if (!inexpensive.empty()) {
+        RunTask([this, inexpensive = std::move(inexpensive), scheduled_nsec]() {
+          for (auto& tagged_node : inexpensive) {
+            Process(tagged_node, scheduled_nsec);
+          }
+        });
       }
     } else {
       for (auto& tagged_node : *ready) {
@@ -1219,6 +1462,155 @@ void ExecutorState<PropagatorStateType>::ScheduleReady(
   ready->clear();
 }
 
+template <class PropagatorStateType>
+void ExecutorState<PropagatorStateType>::ScheduleReadyWorkStealing(
+    TaggedNodeSeq* ready, TaggedNodeReadyQueue* inline_ready,
+    int64_t scheduled_nsec) {
+  const int worker = current_worker.queue == ready_queue_.get()
+                         ? current_worker.index
+                         : -1;
+  int num_pushed = 0;
+  auto push = [this, worker, scheduled_nsec,
+               &num_pushed](const TaggedNode& tagged_node) {
+    if (ready_queue_->Push(worker, tagged_node)) {
+      ++num_pushed;
+    } else {
+      RunTask(std::bind(&ExecutorState::Process, this, tagged_node,
+                        scheduled_nsec));
+    }
+  };
+  auto start_workers = [this, &num_pushed, scheduled_nsec]() {
+    for (; num_pushed > 0; --num_pushed) {
+      const int new_worker = ready_queue_->StartWorker();
+      if (new_worker < 0) break;
+      RunTask([this, queue = ready_queue_, new_worker, scheduled_nsec]() {
+        RunWorker(this, queue, new_worker, scheduled_nsec);
+      });
+    }
+  };
+
+  if (inline_ready == nullptr) {
+    // Every node but the last one is pushed, so that the step cannot complete
+    // before the workers have been started.
+    for (size_t i = 0; i + 1 < ready->size(); ++i) {
+      push((*ready)[i]);
+    }
+    start_workers();
+    RunTask(std::bind(&ExecutorState::Process, this, ready->back(),
+                      scheduled_nsec));
+    return;
+  }
+
+  // The inline budget of this thread is shared by all the calls made from one
+  // call to `Process()`, so a chain of inexpensive nodes, which becomes ready
+  // one node at a time, is split as well.
+  uint64& inline_cycles = current_worker.inline_cycles;
+  const TaggedNode* curr_expensive_node = nullptr;
+  const TaggedNode* last_deferred_node = nullptr;
+  for (auto& tagged_node : *ready) {
+    const NodeItem& item = *tagged_node.node_item;
+    if (tagged_node.get_is_dead() || !kernel_stats_->IsExpensive(item)) {
+      if (inline_cycles < kMaxInlineBatchCycles) {
+        inline_ready->push_back(tagged_node);
+        if (!tagged_node.get_is_dead()) {
+          inline_cycles += kernel_stats_->CostEstimate(item);
+        }
+      } else {
+        if (last_deferred_node) {
+          push(*last_deferred_node);
+        }
+        last_deferred_node = &tagged_node;
+      }
+    } else {
+      if (curr_expensive_node) {
+        push(*curr_expensive_node);
+      }
+      curr_expensive_node = &tagged_node;
+    }
+  }
+  if (curr_expensive_node) {
+    if (inline_ready->empty()) {
+      inline_ready->push_back(*curr_expensive_node);
+    } else {
+      push(*curr_expensive_node);
+    }
+  }
+  if (last_deferred_node == nullptr) {
+    // `inline_ready` is not empty, so the step cannot complete while this
+    // thread starts the workers.
+    start_workers();
+    return;
+  }
+  if (!inline_ready->empty()) {
+    push(*last_deferred_node);
+    start_workers();
+    return;
+  }
+  // The last deferred node keeps the step alive while the workers are started.
+  // A worker then leaves it at the end of its own queue, where it is popped by
+  // this thread or stolen by another one; any other thread hands it to a new
+  // task.
+  start_workers();
+  if (worker >= 0) {
+    push(*last_deferred_node);
+  } else {
+    RunTask(std::bind(&ExecutorState::Process, this, *last_deferred_node,
+                      scheduled_nsec));
+  }
+}
+
+template <class PropagatorStateType>
+void ExecutorState<PropagatorStateType>::RunWorker(
+    ExecutorState* state, std::shared_ptr<ReadyQueue> queue, int worker,
+    int64_t scheduled_nsec) {
+  const CurrentWorker saved_worker = current_worker;
+  TaggedNode tagged_node;
+  while (worker >= 0) {
+    current_worker.queue = queue.get();
+    current_worker.index = worker;
+    while (queue->Pop(worker, &tagged_node)) {
+      state->Process(tagged_node, scheduled_nsec);
+    }
+    worker = queue->StopWorker(worker);
+  }
+  current_worker = saved_worker;
+}
+
+template <class PropagatorStateType>
+std::shared_ptr<typename ExecutorState<PropagatorStateType>::ReadyQueue>
+ExecutorState<PropagatorStateType>::NewReadyQueue(int num_workers) {
+  // Bounds the number of idle queues kept around.
+  static constexpr int kMaxPooledQueues = 64;
+  struct Pool {
+    mutex mu;
+    std::vector<std::unique_ptr<ReadyQueue>> queues TF_GUARDED_BY(mu);
+  };
+  static Pool* pool = new Pool;
+
+  std::unique_ptr<ReadyQueue> queue;
+  {
+    mutex_lock l(pool->mu);
+    if (!pool->queues.empty()) {
+      queue = std::move(pool->queues.back());
+      pool->queues.pop_back();
+    }
+  }
+  if (queue == nullptr || queue->num_workers() != num_workers) {
+    queue = absl::make_unique<ReadyQueue>(num_workers);
+  }
+  // The last reference is dropped once the step and all its workers are done,
+  // at which point the queue is empty.
+  return std::shared_ptr<ReadyQueue>(queue.release(), [](ReadyQueue* q) {
+    DCHECK(q->Empty());
+    mutex_lock l(pool->mu);
+    if (pool->queues.size() < kMaxPooledQueues) {
+      pool->queues.emplace_back(q);
+    } else {
+      delete q;
+    }
+  });
+}
+
 template <class PropagatorStateType>
 void ExecutorState<PropagatorStateType>::ScheduleFinish() {
   // Checks condition to decide if needs to invoke Finish(). If there are
@@ -1356,20 +1748,25 @@ void ExecutorState<PropagatorStateType>::Finish() {
 
 void ExecutorImpl::RunAsync(const Args& args, DoneCallback done) {
   if (immutable_state_.requires_control_flow_support()) {
-    (new ExecutorState<PropagatorState>(args, immutable_state_, &kernel_stats_))
+    (new ExecutorState<PropagatorState>(args, immutable_state_, &kernel_stats_,
+                                        step_memory_.get(),
+                                        num_work_stealing_workers_))
         ->RunAsync(std::move(done));
   } else {
-    (new ExecutorState<SimplePropagatorState>(args, immutable_state_,
-                                              &kernel_stats_))
+    (new ExecutorState<SimplePropagatorState>(
+         args, immutable_state_, &kernel_stats_, step_memory_.get(),
+         num_work_stealing_workers_))
         ->RunAsync(std::move(done));
   }
 }
 
 }  // namespace
 
-Status NewLocalExecutor(const LocalExecutorParams& params, const Graph& graph,
-                        Executor** executor) {
-  ExecutorImpl* impl = new ExecutorImpl(params);
+namespace {
+
+Status NewExecutorImpl(const LocalExecutorParams& params, const Graph& graph,
+                       bool work_stealing, Executor** executor) {
+  ExecutorImpl* impl = new ExecutorImpl(params, work_stealing);
   const Status s = impl->Initialize(graph);
   if (s.ok()) {
     *executor = impl;
@@ -1379,6 +1776,13 @@ Status NewLocalExecutor(const LocalExecutorParams& params, const Graph& graph,
   return s;
 }
 
+}  // namespace
+
+Status NewLocalExecutor(const LocalExecutorParams& params, const Graph& graph,
+                        Executor** executor) {
+  return NewExecutorImpl(params, graph, /*work_stealing=*/false, executor);
+}
+
 Status CreateNonCachedKernel(Device* device, FunctionLibraryRuntime* flib,
                              const std::shared_ptr<const NodeProperties>& props,
                              int graph_def_version, OpKernel** kernel) {
@@ -1396,20 +1800,31 @@ namespace {
 class DefaultExecutorRegistrar {
  public:
   DefaultExecutorRegistrar() {
-    Factory* factory = new Factory;
+    Factory* factory = new Factory(/*work_stealing=*/false);
     ExecutorFactory::Register("", factory);
     ExecutorFactory::Register("DEFAULT", factory);
+    // Opt-in variant of the default executor that schedules the nodes it does
+    // not run inline through per-worker deques with work stealing.
+    ExecutorFactory::Register("WORK_STEALING",
+                              new Factory(/*work_stealing=*/true));
   }
 
  private:
   class Factory : public ExecutorFactory {
+   public:
+    explicit Factory(bool work_stealing) : work_stealing_(work_stealing) {}
+
     Status NewExecutor(const LocalExecutorParams& params, const Graph& graph,
                        std::unique_ptr<Executor>* out_executor) override {
       Executor* ret = nullptr;
-      TF_RETURN_IF_ERROR(NewLocalExecutor(params, std::move(graph), &ret));
+      TF_RETURN_IF_ERROR(NewExecutorImpl(params, std::move(graph),
+                                         work_stealing_, &ret));
       out_executor->reset(ret);
       return Status::OK();
     }
+
+   private:
+    const bool work_stealing_;
   };
 };
 static DefaultExecutorRegistrar registrar;
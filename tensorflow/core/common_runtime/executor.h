@@ -33,6 +33,7 @@ limitations under the License.
 
 namespace tensorflow {
 
+class CostModel;
 class StepStatsCollector;
 
 // Executor runs a graph computation.
@@ -131,6 +132,12 @@ class Executor {
     n.WaitForNotification();
     return ret;
   }
+
+  // Records in `cost_model` the compute times that this executor measured
+  // for the kernels of `graph`, the graph it was created from, over the steps
+  // it ran. Nodes whose time was not measured are left unchanged.
+  virtual void RecordCostEstimates(const Graph& graph,
+                                   CostModel* cost_model) const {}
 };
 
 // Creates an Executor that computes the given "graph".
@@ -0,0 +1,175 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <stdlib.h>
+
+#include <memory>
+
+#include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/common_runtime/device_factory.h"
+#include "tensorflow/core/common_runtime/executor.h"
+#include "tensorflow/core/common_runtime/executor_factory.h"
+#include "tensorflow/core/common_runtime/process_util.h"
+#include "tensorflow/core/common_runtime/static_memory_planner.h"
+#include "tensorflow/core/common_runtime/step_stats_collector.h"
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/rendezvous.h"
+#include "tensorflow/core/framework/step_stats.pb.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/framework/versions.pb.h"
+#include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/graph/testlib.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/public/session_options.h"
+
+namespace tensorflow {
+namespace {
+
+#define ALICE "/job:j/replica:0/task:0/cpu:0"
+#define BOB "/job:j/replica:0/task:0/device:GPU:0"
+
+constexpr uint64 kIncarnation = 1;
+
+Rendezvous::ParsedKey Key(const string& sender, const string& receiver,
+                          const string& name) {
+  Rendezvous::ParsedKey result;
+  TF_CHECK_OK(Rendezvous::ParseKey(
+      Rendezvous::CreateKey(sender, kIncarnation, receiver, name,
+                            FrameAndIter(0, 0)),
+      &result));
+  return result;
+}
+
+// Runs graphs on the CPU with TF_EXECUTOR_USE_STATIC_MEMORY_PLAN set. The
+// variable is read once per process, so every test of this binary sets it
+// before creating an executor. The graphs take their input from a constant,
+// since a Recv from another device may produce dead tensors and so prevents
+// planning.
+class ExecutorStaticMemoryPlanTest : public ::testing::Test {
+ protected:
+  ExecutorStaticMemoryPlanTest()
+      : device_(DeviceFactory::NewDevice("CPU", {},
+                                         "/job:localhost/replica:0/task:0")) {
+    setenv("TF_EXECUTOR_USE_STATIC_MEMORY_PLAN", "true", /*overwrite=*/1);
+    thread_pool_ = ComputePool(SessionOptions());
+    rendez_ = NewLocalRendezvous();
+  }
+
+  ~ExecutorStaticMemoryPlanTest() override { CHECK(rendez_->Unref()); }
+
+  void Create(std::unique_ptr<const Graph> graph,
+              const string& executor_type = "") {
+    const int version = graph->versions().producer();
+    LocalExecutorParams params;
+    params.device = device_.get();
+    params.create_kernel =
+        [this, version](const std::shared_ptr<const NodeProperties>& props,
+                        OpKernel** kernel) {
+          return CreateNonCachedKernel(device_.get(), nullptr, props, version,
+                                       kernel);
+        };
+    params.delete_kernel = [](OpKernel* kernel) {
+      DeleteNonCachedKernel(kernel);
+    };
+    TF_CHECK_OK(NewExecutor(executor_type, params, *graph, &exec_));
+  }
+
+  // Runs a step that sends `expected` as "b", and returns the arena and plan
+  // usage of the step.
+  StepArenaStats RunStep(const Tensor& expected) {
+    StepStats step_stats;
+    StepStatsCollector step_stats_collector(&step_stats);
+    Executor::Args args;
+    args.rendezvous = rendez_;
+    args.stats_collector = &step_stats_collector;
+    args.runner = [this](std::function<void()> fn) {
+      thread_pool_->Schedule(std::move(fn));
+    };
+    TF_CHECK_OK(exec_->Run(args));
+    Tensor output;
+    bool is_dead = false;
+    TF_CHECK_OK(rendez_->Recv(Key(BOB, ALICE, "b"), Rendezvous::Args(),
+                              &output, &is_dead));
+    test::ExpectTensorEqual<float>(expected, output);
+
+    step_stats_collector.Finalize();
+    for (const DeviceStepStats& dev_stats : step_stats.dev_stats()) {
+      if (dev_stats.device() == device_->name()) {
+        return dev_stats.step_arena_stats();
+      }
+    }
+    return StepArenaStats();
+  }
+
+  thread::ThreadPool* thread_pool_ = nullptr;
+  std::unique_ptr<Device> device_;
+  std::unique_ptr<Executor> exec_;
+  Rendezvous* rendez_ = nullptr;
+};
+
+TEST_F(ExecutorStaticMemoryPlanTest, PlansStepLocalOutputs) {
+  // b <- a; t1 = a + a; t2 = t1 + t1; t3 = t2 + t2. Only two of the outputs
+  // of t1, t2 and t3 are alive at any time.
+  Tensor input = test::AsTensor<float>({1, 2, 3, 4}, {4});
+  auto g = absl::make_unique<Graph>(OpRegistry::Global());
+  auto a = test::graph::Constant(g.get(), input);
+  auto t = a;
+  for (int i = 0; i < 3; ++i) {
+    t = test::graph::Add(g.get(), t, t);
+  }
+  test::graph::Send(g.get(), a, "b", BOB, 1, ALICE);
+  Create(std::move(g));
+
+  for (int i = 0; i < StaticMemoryPlanner::kNumRecordedSteps; ++i) {
+    const StepArenaStats stats = RunStep(input);
+    EXPECT_EQ(stats.num_planned_hits(), 0);
+    EXPECT_EQ(stats.num_hits(), 3);
+  }
+  for (int i = 0; i < 3; ++i) {
+    const StepArenaStats stats = RunStep(input);
+    EXPECT_EQ(stats.num_planned_hits(), 3);
+    EXPECT_EQ(stats.num_hits(), 0);
+    EXPECT_EQ(stats.planned_bytes(), 2 * Allocator::kAllocatorAlignment);
+  }
+}
+
+TEST_F(ExecutorStaticMemoryPlanTest, ParallelBranches) {
+  // b <- a; t_i = a + a; u_i = t_i + t_i for 64 branches, which the
+  // work-stealing executor runs on several threads in varying orders. Every
+  // output comes either from the plan or from the fallback arena.
+  constexpr int kNumBranches = 64;
+  Tensor input = test::AsTensor<float>({1, 2, 3, 4}, {4});
+  auto g = absl::make_unique<Graph>(OpRegistry::Global());
+  auto a = test::graph::Constant(g.get(), input);
+  for (int i = 0; i < kNumBranches; ++i) {
+    auto t = test::graph::Add(g.get(), a, a);
+    test::graph::Add(g.get(), t, t);
+  }
+  test::graph::Send(g.get(), a, "b", BOB, 1, ALICE);
+  Create(std::move(g), "WORK_STEALING");
+
+  int64_t num_planned_hits = 0;
+  for (int i = 0; i < StaticMemoryPlanner::kNumRecordedSteps + 20; ++i) {
+    const StepArenaStats stats = RunStep(input);
+    EXPECT_EQ(stats.num_planned_hits() + stats.num_hits(), 2 * kNumBranches);
+    num_planned_hits += stats.num_planned_hits();
+  }
+  EXPECT_GT(num_planned_hits, 0);
+}
+
+}  // namespace
+}  // namespace tensorflow
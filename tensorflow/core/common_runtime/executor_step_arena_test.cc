@@ -0,0 +1,163 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <stdlib.h>
+
+#include <memory>
+
+#include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/common_runtime/device_factory.h"
+#include "tensorflow/core/common_runtime/executor.h"
+#include "tensorflow/core/common_runtime/executor_factory.h"
+#include "tensorflow/core/common_runtime/process_util.h"
+#include "tensorflow/core/common_runtime/step_stats_collector.h"
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/rendezvous.h"
+#include "tensorflow/core/framework/step_stats.pb.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/framework/versions.pb.h"
+#include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/graph/testlib.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/public/session_options.h"
+
+namespace tensorflow {
+namespace {
+
+#define ALICE "/job:j/replica:0/task:0/cpu:0"
+#define BOB "/job:j/replica:0/task:0/device:GPU:0"
+
+constexpr uint64 kIncarnation = 1;
+
+Rendezvous::ParsedKey Key(const string& sender, const string& receiver,
+                          const string& name) {
+  Rendezvous::ParsedKey result;
+  TF_CHECK_OK(Rendezvous::ParseKey(
+      Rendezvous::CreateKey(sender, kIncarnation, receiver, name,
+                            FrameAndIter(0, 0)),
+      &result));
+  return result;
+}
+
+// Runs graphs on the CPU with TF_EXECUTOR_USE_STEP_ARENA set. The variable is
+// read once per process, so every test of this binary sets it before creating
+// an executor.
+class ExecutorStepArenaTest : public ::testing::Test {
+ protected:
+  ExecutorStepArenaTest()
+      : device_(DeviceFactory::NewDevice("CPU", {},
+                                         "/job:localhost/replica:0/task:0")),
+        step_stats_collector_(&step_stats_) {
+    setenv("TF_EXECUTOR_USE_STEP_ARENA", "true", /*overwrite=*/1);
+    thread_pool_ = ComputePool(SessionOptions());
+    rendez_ = NewLocalRendezvous();
+  }
+
+  ~ExecutorStepArenaTest() override { CHECK(rendez_->Unref()); }
+
+  void Create(std::unique_ptr<const Graph> graph) {
+    const int version = graph->versions().producer();
+    LocalExecutorParams params;
+    params.device = device_.get();
+    params.create_kernel =
+        [this, version](const std::shared_ptr<const NodeProperties>& props,
+                        OpKernel** kernel) {
+          return CreateNonCachedKernel(device_.get(), nullptr, props, version,
+                                       kernel);
+        };
+    params.delete_kernel = [](OpKernel* kernel) {
+      DeleteNonCachedKernel(kernel);
+    };
+    TF_CHECK_OK(NewExecutor("", params, *graph, &exec_));
+  }
+
+  // Runs the executor on `input` sent as "a", and returns the tensor it sends
+  // as "b".
+  Tensor Run(const Tensor& input) {
+    TF_CHECK_OK(rendez_->Send(Key(ALICE, BOB, "a"), Rendezvous::Args(), input,
+                              false));
+    Executor::Args args;
+    args.rendezvous = rendez_;
+    args.stats_collector = &step_stats_collector_;
+    args.runner = [this](std::function<void()> fn) {
+      thread_pool_->Schedule(std::move(fn));
+    };
+    TF_CHECK_OK(exec_->Run(args));
+    Tensor output;
+    bool is_dead = false;
+    TF_CHECK_OK(rendez_->Recv(Key(BOB, ALICE, "b"), Rendezvous::Args(),
+                              &output, &is_dead));
+    return output;
+  }
+
+  // Returns the arena usage reported by the steps run so far.
+  StepArenaStats GetStepArenaStats() {
+    step_stats_collector_.Finalize();
+    for (const DeviceStepStats& dev_stats : step_stats_.dev_stats()) {
+      if (dev_stats.device() == device_->name()) {
+        return dev_stats.step_arena_stats();
+      }
+    }
+    return StepArenaStats();
+  }
+
+  thread::ThreadPool* thread_pool_ = nullptr;
+  std::unique_ptr<Device> device_;
+  std::unique_ptr<Executor> exec_;
+  StepStats step_stats_;
+  StepStatsCollector step_stats_collector_;
+  Rendezvous* rendez_ = nullptr;
+};
+
+TEST_F(ExecutorStepArenaTest, ServesStepLocalOutputsFromArena) {
+  // b <- a; t = a + a; u = t + t. The outputs of t and u never leave the step.
+  auto g = absl::make_unique<Graph>(OpRegistry::Global());
+  auto a = test::graph::Recv(g.get(), "a", "float", ALICE, 1, BOB);
+  auto t = test::graph::Add(g.get(), a, a);
+  test::graph::Add(g.get(), t, t);
+  test::graph::Send(g.get(), a, "b", BOB, 1, ALICE);
+  Create(std::move(g));
+
+  Tensor input = test::AsTensor<float>({1, 2, 3, 4}, {4});
+  test::ExpectTensorEqual<float>(input, Run(input));
+  const StepArenaStats stats = GetStepArenaStats();
+  EXPECT_EQ(stats.num_hits(), 2);
+  EXPECT_EQ(stats.num_fallbacks(), 0);
+  EXPECT_GE(stats.bytes_allocated(), 2 * input.TotalBytes());
+  EXPECT_GE(stats.bytes_reserved(), stats.bytes_allocated());
+}
+
+TEST_F(ExecutorStepArenaTest, SentOutputsBypassArena) {
+  // b <- (a + a) + (a + a). Every output reaches the Send, so none of them
+  // comes from the arena.
+  auto g = absl::make_unique<Graph>(OpRegistry::Global());
+  auto a = test::graph::Recv(g.get(), "a", "float", ALICE, 1, BOB);
+  auto t = test::graph::Add(g.get(), a, a);
+  auto u = test::graph::Add(g.get(), t, t);
+  test::graph::Send(g.get(), u, "b", BOB, 1, ALICE);
+  Create(std::move(g));
+
+  Tensor output = Run(test::AsTensor<float>({1, 2, 3, 4}, {4}));
+  test::ExpectTensorEqual<float>(test::AsTensor<float>({4, 8, 12, 16}, {4}),
+                                 output);
+  const StepArenaStats stats = GetStepArenaStats();
+  EXPECT_EQ(stats.num_hits(), 0);
+  EXPECT_EQ(stats.bytes_allocated(), 0);
+}
+
+}  // namespace
+}  // namespace tensorflow
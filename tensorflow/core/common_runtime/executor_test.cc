@@ -25,6 +25,7 @@ limitations under the License.
 #include "tensorflow/cc/ops/standard_ops.h"
 #include "tensorflow/core/common_runtime/device.h"
 #include "tensorflow/core/common_runtime/device_factory.h"
+#include "tensorflow/core/common_runtime/executor_factory.h"
 #include "tensorflow/core/common_runtime/graph_constructor.h"
 #include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
 #include "tensorflow/core/common_runtime/lower_functional_ops.h"
@@ -37,14 +38,17 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/framework/versions.pb.h"
 #include "tensorflow/core/graph/algorithm.h"
+#include "tensorflow/core/graph/costmodel.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/random/simple_philox.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/profile_utils/cpu_utils.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/platform/test_benchmark.h"
 #include "tensorflow/core/platform/tracing.h"
 #include "tensorflow/core/public/session_options.h"
+#include "tensorflow/core/public/version.h"
 
 namespace tensorflow {
 
@@ -67,7 +71,8 @@ class ExecutorTest : public ::testing::Test {
   }
 
   // Resets executor_ with a new executor based on a graph 'gdef'.
-  void Create(std::unique_ptr<const Graph> graph) {
+  void Create(std::unique_ptr<const Graph> graph,
+              const string& executor_type = "") {
     const int version = graph->versions().producer();
     LocalExecutorParams params;
     params.device = device_.get();
@@ -82,7 +87,9 @@ class ExecutorTest : public ::testing::Test {
     };
     rendez_ = NewLocalRendezvous();
     delete exec_;
-    TF_CHECK_OK(NewLocalExecutor(params, *graph, &exec_));
+    std::unique_ptr<Executor> exec;
+    TF_CHECK_OK(NewExecutor(executor_type, params, *graph, &exec));
+    exec_ = exec.release();
     runner_ = [this](std::function<void()> fn) { thread_pool_->Schedule(fn); };
   }
 
@@ -255,6 +262,23 @@ TEST_F(ExecutorTest, RandomTree) {
   EXPECT_EQ(4096.0, V(out));
 }
 
+TEST_F(ExecutorTest, WorkStealingRandomTree) {
+  auto g = absl::make_unique<Graph>(OpRegistry::Global());
+  BuildTree(4096, g.get());
+  Create(std::move(g), "WORK_STEALING");
+  for (int iters = 0; iters < 4; ++iters) {
+    Rendezvous::Args args;
+    TF_ASSERT_OK(rendez_->Send(Key(ALICE, kIncarnation, BOB, "a"), args,
+                               V(1.0), false));
+    TF_ASSERT_OK(Run(rendez_));
+    Tensor out = V(-1);
+    bool is_dead = false;
+    TF_ASSERT_OK(rendez_->Recv(Key(BOB, kIncarnation, ALICE, "b"), args, &out,
+                               &is_dead));
+    EXPECT_EQ(4096.0, V(out));
+  }
+}
+
 void BuildConcurrentAddAssign(Graph* g) {
   auto one = test::graph::Constant(g, V(1.0));
   // A variable holds one float.
@@ -311,6 +335,24 @@ TEST_F(ExecutorTest, SimpleSwitchLive) {
   EXPECT_FALSE(is_dead);
 }
 
+TEST_F(ExecutorTest, WorkStealingSimpleSwitchDead) {
+  auto g = absl::make_unique<Graph>(OpRegistry::Global());
+  auto in0 = test::graph::Recv(g.get(), "a", "float", ALICE, 1, BOB);
+  auto in1 = test::graph::Constant(g.get(), VB(true));
+  auto tmp = test::graph::Switch(g.get(), in0, in1);
+  test::graph::Send(g.get(), tmp, "c", BOB, 1, ALICE);
+  Create(std::move(g), "WORK_STEALING");
+  Rendezvous::Args args;
+  TF_ASSERT_OK(rendez_->Send(Key(ALICE, kIncarnation, BOB, "a"), args, V(1.0),
+                             false));  // in0 = 1.0
+  TF_ASSERT_OK(Run(rendez_));
+  Tensor out = V(-1);
+  bool is_dead = false;
+  TF_ASSERT_OK(
+      rendez_->Recv(Key(BOB, kIncarnation, ALICE, "c"), args, &out, &is_dead));
+  EXPECT_TRUE(is_dead);
+}
+
 TEST_F(ExecutorTest, SimpleSwitchDead) {
   auto g = absl::make_unique<Graph>(OpRegistry::Global());
   auto in0 = test::graph::Recv(g.get(), "a", "float", ALICE, 1, BOB);
@@ -430,6 +472,70 @@ TEST_F(ExecutorTest, NoInputTensors) {
   TF_ASSERT_OK(Run(rendez_));
 }
 
+TEST_F(ExecutorTest, RecordCostEstimates) {
+  auto g = absl::make_unique<Graph>(OpRegistry::Global());
+  Tensor a(DT_FLOAT, TensorShape({256, 256}));
+  a.flat<float>().setConstant(1.0);
+  auto in = test::graph::Constant(g.get(), a);
+  auto matmul = test::graph::Matmul(g.get(), in, in, false, false);
+  auto copy = absl::make_unique<Graph>(OpRegistry::Global());
+  CopyGraph(*g, copy.get());
+  Create(std::move(copy));
+
+  CostModel cost_model(false);
+  cost_model.InitFromGraph(*g);
+  exec_->RecordCostEstimates(*g, &cost_model);
+  EXPECT_EQ(cost_model.MeasuredTime(matmul), Microseconds(0));
+
+  TF_ASSERT_OK(Run(rendez_));
+  exec_->RecordCostEstimates(*g, &cost_model);
+  EXPECT_GT(cost_model.MeasuredTime(matmul), Microseconds(0));
+}
+
+// Returns the number of closures that the "WORK_STEALING" executor passes to
+// its runner while it runs a chain of `length` no-ops.
+int NumRunnerCallsForChain(int length) {
+  auto g = absl::make_unique<Graph>(OpRegistry::Global());
+  Node* prev = test::graph::NoOp(g.get(), {});
+  for (int i = 1; i < length; ++i) {
+    prev = test::graph::NoOp(g.get(), {prev});
+  }
+  std::unique_ptr<Device> device = DeviceFactory::NewDevice(
+      "CPU", {}, "/job:localhost/replica:0/task:0");
+  const int version = g->versions().producer();
+  LocalExecutorParams params;
+  params.device = device.get();
+  params.create_kernel =
+      [&device, version](const std::shared_ptr<const NodeProperties>& props,
+                         OpKernel** kernel) {
+        return CreateNonCachedKernel(device.get(), nullptr, props, version,
+                                     kernel);
+      };
+  params.delete_kernel = [](OpKernel* kernel) {
+    DeleteNonCachedKernel(kernel);
+  };
+  std::unique_ptr<Executor> exec;
+  TF_CHECK_OK(NewExecutor("WORK_STEALING", params, *g, &exec));
+
+  thread::ThreadPool* thread_pool = ComputePool(SessionOptions());
+  std::atomic<int> num_calls{0};
+  Executor::Args args;
+  args.runner = [thread_pool, &num_calls](std::function<void()> fn) {
+    num_calls.fetch_add(1);
+    thread_pool->Schedule(std::move(fn));
+  };
+  TF_CHECK_OK(exec->Run(args));
+  return num_calls.load();
+}
+
+TEST(WorkStealingExecutorTest, SplitsLongInexpensiveChains) {
+  // A short chain runs inline on the thread that starts it, while a long one
+  // is handed to a new task every time the inline budget is spent.
+  const int single_node_calls = NumRunnerCallsForChain(1);
+  EXPECT_EQ(NumRunnerCallsForChain(8), single_node_calls);
+  EXPECT_GT(NumRunnerCallsForChain(4096), single_node_calls + 4);
+}
+
 // Create a graph that is 'depth' deep. At each level, fan-in and fan-out a
 // maximum of 'width' nodes. All nodes are no-ops and all dependencies are
 // control dependencies.
@@ -511,6 +617,132 @@ BENCHMARK(BM_const_identity)
     ->ArgPair(100, 1)
     ->ArgPair(100, 100);
 
+// Create a graph of 'num_nodes' no-ops in which each node has control
+// dependencies on up to 'fanin' of the 64 nodes that precede it in a random
+// topological order, so that node IDs are unrelated to the dependencies, as in
+// graphs that were rewritten by optimization passes.
+static std::unique_ptr<Graph> LargeRandomGraph(int num_nodes, int fanin) {
+  auto g = absl::make_unique<Graph>(OpRegistry::Global());
+  random::PhiloxRandom philox(1729, 17);
+  random::SimplePhilox rand(&philox);
+  std::vector<Node*> nodes(num_nodes);
+  for (int i = 0; i < num_nodes; ++i) {
+    nodes[i] = test::graph::NoOp(g.get(), {});
+  }
+  std::mt19937 rng(42);
+  std::shuffle(nodes.begin(), nodes.end(), rng);
+  constexpr int kWindow = 64;
+  for (int i = 1; i < num_nodes; ++i) {
+    const int window = std::min(i, kWindow);
+    for (int j = 0; j < fanin; ++j) {
+      g->AddControlEdge(nodes[i - 1 - rand.Uniform(window)], nodes[i]);
+    }
+  }
+  FixupSourceAndSinkEdges(g.get());
+  return g;
+}
+
+// Measures the time to create an executor for a large random graph.
+static void BM_executor_create_large_graph(
+    ::testing::benchmark::State& state) {
+  const int num_nodes = state.range(0);
+  std::unique_ptr<Graph> g = LargeRandomGraph(num_nodes, /*fanin=*/2);
+  std::unique_ptr<Device> device = DeviceFactory::NewDevice(
+      "CPU", {}, "/job:localhost/replica:0/task:0");
+  LocalExecutorParams params;
+  params.device = device.get();
+  params.create_kernel =
+      [&device](const std::shared_ptr<const NodeProperties>& props,
+                OpKernel** kernel) {
+        return CreateNonCachedKernel(device.get(), nullptr, props,
+                                     TF_GRAPH_DEF_VERSION, kernel);
+      };
+  params.delete_kernel = [](OpKernel* kernel) {
+    DeleteNonCachedKernel(kernel);
+  };
+  const uint64 start_cycles = profile_utils::CpuUtils::GetCurrentClockCycle();
+  for (auto s : state) {
+    Executor* executor;
+    TF_CHECK_OK(NewLocalExecutor(params, *g, &executor));
+    delete executor;
+  }
+  const uint64 cycles =
+      profile_utils::CpuUtils::GetCurrentClockCycle() - start_cycles;
+  state.SetLabel(strings::StrCat(
+      "Nodes = ", num_nodes, " cycles/node = ",
+      cycles / (num_nodes * static_cast<int64_t>(state.iterations()))));
+  state.SetItemsProcessed(num_nodes * static_cast<int64_t>(state.iterations()));
+}
+
+BENCHMARK(BM_executor_create_large_graph)->Arg(100000)->Arg(1000000);
+
+// Measures the time to run steps of a large random graph, which is dominated
+// by the propagation of outputs through the graph.
+static void BM_executor_large_graph(::testing::benchmark::State& state) {
+  const int num_nodes = state.range(0);
+  const int fanin = state.range(1);
+  std::unique_ptr<Graph> g = LargeRandomGraph(num_nodes, fanin);
+  test::Benchmark bm("cpu", g.release(), /*old_benchmark_api=*/false);
+  // Graph construction and kernel instantiation are not part of the per-node
+  // cost, so start counting once the executor has been built.
+  const uint64 start_cycles = profile_utils::CpuUtils::GetCurrentClockCycle();
+  bm.Run(state);
+  const uint64 cycles =
+      profile_utils::CpuUtils::GetCurrentClockCycle() - start_cycles;
+  state.SetLabel(strings::StrCat(
+      "Nodes = ", num_nodes, " cycles/node = ",
+      cycles / (num_nodes * static_cast<int64_t>(state.iterations()))));
+  state.SetItemsProcessed(num_nodes * static_cast<int64_t>(state.iterations()));
+}
+
+BENCHMARK(BM_executor_large_graph)
+    ->UseRealTime()
+    ->ArgPair(100000, 1)
+    ->ArgPair(100000, 4)
+    ->ArgPair(1000000, 2);
+
+// Create a graph of 'width' independent chains of 'depth' small matrix
+// multiplications, and run it with the default executor or, if the third
+// argument is 1, with the "WORK_STEALING" executor. The multiplications stay
+// "expensive", so every node is scheduled rather than run inline.
+static void BM_executor_matmul_chains(::testing::benchmark::State& state) {
+  const int width = state.range(0);
+  const int depth = state.range(1);
+  const bool work_stealing = state.range(2);
+
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor m(DT_FLOAT, TensorShape({32, 32}));
+  m.flat<float>().setConstant(1.0f / 32);
+  Node* c = test::graph::Constant(g, m);
+  for (int i = 0; i < width; ++i) {
+    Node* x = c;
+    for (int j = 0; j < depth; ++j) {
+      x = test::graph::Matmul(g, x, c, false, false);
+    }
+  }
+  FixupSourceAndSinkEdges(g);
+  test::Benchmark("cpu", g, /*options=*/nullptr, /*init=*/nullptr,
+                  /*rendez=*/nullptr, work_stealing ? "WORK_STEALING" : "",
+                  /*old_benchmark_api=*/false)
+      .Run(state);
+  state.SetLabel(strings::StrCat("Nodes = ", width * depth));
+  state.SetItemsProcessed(width * depth *
+                          static_cast<int64_t>(state.iterations()));
+}
+
+BENCHMARK(BM_executor_matmul_chains)
+    ->UseRealTime()
+    // Wide graphs
+    ->Args({256, 4, 0})
+    ->Args({256, 4, 1})
+    ->Args({1024, 2, 0})
+    ->Args({1024, 2, 1})
+    // Deep graphs
+    ->Args({4, 256, 0})
+    ->Args({4, 256, 1})
+    ->Args({32, 32, 0})
+    ->Args({32, 32, 1});
+
 static void BM_FeedInputFetchOutput(::testing::benchmark::State& state) {
   Graph* g = new Graph(OpRegistry::Global());
   // z = x + y: x and y are provided as benchmark inputs.  z is the
@@ -26,6 +26,7 @@ limitations under the License.
 #include "tensorflow/core/framework/node_def_util.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/graph/algorithm.h"
 #include "tensorflow/core/graph/edgeset.h"
 #include "tensorflow/core/graph/graph.h"
 #include "tensorflow/core/lib/core/errors.h"
@@ -170,6 +171,9 @@ char* GraphView::InitializeNode(char* ptr, const Node* n) {
     // NOTE: The `input_slot` will be rewritten to the frame-wide offset later
     // in `ExecutorImpl::Initialize()`.
     dst_edge->input_slot = e->dst_input();
+    // NOTE: The `dst_pending_id` is also set later, in
+    // `ImmutableExecutorState::Initialize()`.
+    new (&dst_edge->dst_pending_id) PendingCounts::Handle();
     dst_edge++;
   }
   for (EdgeInfo* edge_info : last_indices) {
@@ -181,6 +185,7 @@ char* GraphView::InitializeNode(char* ptr, const Node* n) {
   for (auto e : n->out_edges()) {
     if (!e->IsControlEdge() || IsSink(e->dst())) continue;
     dst_control_edge->dst_id = e->dst()->id();
+    new (&dst_control_edge->dst_pending_id) PendingCounts::Handle();
     dst_control_edge++;
   }
 
@@ -264,9 +269,21 @@ Status GraphView::Initialize(const Graph* g) {
 
   space_ = new char[total_bytes];  // NodeItem objects are allocated here
   char* ptr = space_;
-  for (const Node* n : g->nodes()) {
+  // Lays the items out in reverse post order rather than in node ID order, so
+  // that a node's item tends to be close to those of its producers and
+  // consumers, and propagation through large graphs mostly touches memory
+  // that is already cached.
+  std::vector<Node*> order;
+  GetReversePostOrder(*g, &order);
+  for (const Node* n : order) {
     ptr = InitializeNode(ptr, n);
   }
+  // Nodes that are unreachable from the source follow, in ID order.
+  for (const Node* n : g->nodes()) {
+    if (node_offsets_[n->id()] == kuint32max) {
+      ptr = InitializeNode(ptr, n);
+    }
+  }
   CHECK_EQ(ptr, space_ + total_bytes);
   return Status::OK();
 }
@@ -19,6 +19,7 @@ limitations under the License.
 #include <memory>
 #include <vector>
 
+#include "tensorflow/core/common_runtime/pending_counts.h"
 #include "tensorflow/core/framework/allocator.h"
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/lib/core/status.h"
@@ -45,12 +46,18 @@ struct EdgeInfo {
   bool is_last : 1;
   // The index of the input that consumes values on this edge.
   int input_slot;
+  // The handle of the destination's pending counts in its frame, cached here
+  // so that propagation does not look it up by `dst_id`. Set by
+  // `ImmutableExecutorState` once the pending counts are laid out.
+  PendingCounts::Handle dst_pending_id;
 };
 
 // Represents a single control edge in a `NodeItem`.
 struct ControlEdgeInfo {
   // The node ID of the destination in the containing `GraphView`.
   int dst_id;
+  // The handle of the destination's pending counts, as in `EdgeInfo`.
+  PendingCounts::Handle dst_pending_id;
 };
 
 // Compact structure representing a graph node and its associated kernel.
@@ -85,6 +92,9 @@ struct NodeItem {
                                     // node's input types.
   bool is_distributed_communication : 1;  // True iff the op is registered to
                                           // use distributed communication.
+  bool is_step_local : 1;  // True iff the kernel is stateless and none of its
+                           // outputs can outlive the step, so that its
+                           // temporaries may be allocated from a step arena.
 
   // The kernel for this node.
   OpKernel* kernel = nullptr;
@@ -111,6 +121,11 @@ struct NodeItem {
   // is true if and only if the ith output is consumed by another node.
   std::unique_ptr<bool[]> outputs_required;
 
+  // If non-null, contains an array of num_outputs bools, where the ith bool
+  // is true if and only if the ith output cannot outlive the step, and may be
+  // allocated from a step arena.
+  std::unique_ptr<bool[]> outputs_step_local;
+
   gtl::MutableArraySlice<EdgeInfo> mutable_output_edges() {
     return gtl::MutableArraySlice<EdgeInfo>(output_edge_base(),
                                             num_output_edges);
@@ -120,6 +135,11 @@ struct NodeItem {
     return gtl::ArraySlice<EdgeInfo>(output_edge_base(), num_output_edges);
   }
 
+  gtl::MutableArraySlice<ControlEdgeInfo> mutable_output_control_edges() {
+    return gtl::MutableArraySlice<ControlEdgeInfo>(output_control_edge_base(),
+                                                   num_output_control_edges);
+  }
+
   gtl::ArraySlice<ControlEdgeInfo> output_control_edges() const {
     return gtl::ArraySlice<const ControlEdgeInfo>(output_control_edge_base(),
                                                   num_output_control_edges);
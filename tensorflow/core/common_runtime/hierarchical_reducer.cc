@@ -0,0 +1,113 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/common_runtime/hierarchical_reducer.h"
+
+#include <string>
+#include <unordered_map>
+
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/logging.h"
+
+namespace tensorflow {
+namespace {
+
+// Returns the largest power of two that is at most `n`.
+int LargestPowerOfTwo(int n) {
+  int p = 1;
+  while (p * 2 <= n) p *= 2;
+  return p;
+}
+
+}  // namespace
+
+Status HierarchicalReducer::InitializeCollectiveParams(
+    CollectiveParams* col_params) {
+  TF_RETURN_IF_ERROR(
+      RecursiveHalvingDoublingReducer::InitializeCollectiveParams(col_params));
+  std::vector<std::vector<int>> task_ranks;
+  return GetTaskRanks(col_params->group, &task_ranks);
+}
+
+Status HierarchicalReducer::GetTaskRanks(
+    const CollGroupParams& group, std::vector<std::vector<int>>* task_ranks) {
+  std::unordered_map<string, int> task_index;
+  task_ranks->clear();
+  for (int rank = 0; rank < group.members.size(); ++rank) {
+    auto it = task_index.emplace(group.members[rank].task, task_ranks->size());
+    if (it.second) {
+      task_ranks->emplace_back();
+    }
+    (*task_ranks)[it.first->second].push_back(rank);
+  }
+  for (const std::vector<int>& ranks : *task_ranks) {
+    if (ranks.size() != task_ranks->front().size()) {
+      return errors::InvalidArgument(
+          "HierarchicalReduce requires the same number of devices on every "
+          "task of collective group ",
+          group.group_key, ", got ", group.ToString());
+    }
+  }
+  return Status::OK();
+}
+
+int HierarchicalReducer::NumBlocks() const {
+  const int num_tasks = col_params_->group.num_tasks;
+  DCHECK_GT(num_tasks, 0);
+  return LargestPowerOfTwo(col_params_->group.group_size / num_tasks) *
+         LargestPowerOfTwo(num_tasks);
+}
+
+Status HierarchicalReducer::ReduceBlocks() {
+  std::vector<std::vector<int>> task_ranks;
+  TF_RETURN_IF_ERROR(GetTaskRanks(col_params_->group, &task_ranks));
+  int task = 0;
+  int local_index = 0;
+  for (int t = 0; t < task_ranks.size(); ++t) {
+    for (int i = 0; i < task_ranks[t].size(); ++i) {
+      if (task_ranks[t][i] == col_params_->default_rank) {
+        task = t;
+        local_index = i;
+      }
+    }
+  }
+  // The devices with the same index on every task hold the same blocks after
+  // the first phase.
+  std::vector<int> peer_ranks;
+  peer_ranks.reserve(task_ranks.size());
+  for (const std::vector<int>& ranks : task_ranks) {
+    peer_ranks.push_back(ranks[local_index]);
+  }
+
+  const int num_blocks = NumBlocks();
+  int local_begin, local_end;
+  TF_RETURN_IF_ERROR(ReduceScatter(task_ranks[task], 0, num_blocks, "local_rs",
+                                   &local_begin, &local_end));
+  if (local_begin < local_end) {
+    int begin, end;
+    TF_RETURN_IF_ERROR(ReduceScatter(peer_ranks, local_begin, local_end,
+                                     "cross_rs", &begin, &end));
+    TF_RETURN_IF_ERROR(Finalize(begin, end));
+    TF_RETURN_IF_ERROR(
+        AllGather(peer_ranks, local_begin, local_end, "cross_ag"));
+  }
+  return AllGather(task_ranks[task], 0, num_blocks, "local_ag");
+}
+
+namespace {
+REGISTER_COLLECTIVE(HierarchicalReduce, HierarchicalReducer);
+}  // namespace
+
+}  // namespace tensorflow
@@ -0,0 +1,55 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_HIERARCHICAL_REDUCER_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_HIERARCHICAL_REDUCER_H_
+
+#include <vector>
+
+#include "tensorflow/core/common_runtime/recursive_halving_doubling_reducer.h"
+#include "tensorflow/core/framework/collective.h"
+
+namespace tensorflow {
+
+// Two-dimensional implementation of collective all-reduce, for groups whose
+// tasks all have the same number of devices.
+//
+// The devices of each task first reduce-scatter the tensor among themselves,
+// so that each device holds the sum over its task of a part of the tensor.
+// The devices that hold the same part on different tasks then all-reduce it,
+// and finally the devices of each task all-gather the parts. Each phase uses
+// recursive halving-doubling. Only 1 / num_devices_per_task of the tensor
+// crosses task boundaries per device, and the number of sequential cross-task
+// steps grows with log2(num_tasks) only.
+class HierarchicalReducer : public RecursiveHalvingDoublingReducer {
+ public:
+  HierarchicalReducer() = default;
+  ~HierarchicalReducer() override = default;
+
+  Status InitializeCollectiveParams(CollectiveParams* col_params) override;
+
+ protected:
+  int NumBlocks() const override;
+  Status ReduceBlocks() override;
+
+ private:
+  // Sets `task_ranks` to the ranks of the members of each task, in the order
+  // in which the tasks first appear among the members.
+  static Status GetTaskRanks(const CollGroupParams& group,
+                             std::vector<std::vector<int>>* task_ranks);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_HIERARCHICAL_REDUCER_H_
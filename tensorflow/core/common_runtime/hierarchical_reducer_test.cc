@@ -0,0 +1,113 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/common_runtime/hierarchical_reducer.h"
+
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/collective_test_util.h"
+#include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/common_runtime/device_mgr.h"
+#include "tensorflow/core/common_runtime/process_util.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/blocking_counter.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/public/version.h"
+
+namespace tensorflow {
+namespace {
+
+std::unique_ptr<OpKernel> GetAdd(DataType dtype, Device* device) {
+  NodeDef node_def;
+  TF_CHECK_OK(NodeDefBuilder("add_node", "Add")
+                  .Attr("T", dtype)
+                  .Input(FakeInput(dtype))
+                  .Input(FakeInput(dtype))
+                  .Finalize(&node_def));
+  Status status;
+  std::unique_ptr<OpKernel> k = CreateOpKernel(
+      DeviceType(device->device_type()), device,
+      device->GetAllocator(AllocatorAttributes()), node_def,
+      TF_GRAPH_DEF_VERSION, &status);
+  TF_CHECK_OK(status);
+  return k;
+}
+
+void RunTest(int num_workers, int num_devices, int tensor_len) {
+  auto test_env = CreateCollectiveTestEnv(num_workers, num_devices, DEVICE_CPU);
+  const int group_size = num_workers * num_devices;
+  std::vector<Tensor> tensors;
+  std::vector<float> expected(tensor_len);
+  for (int rank = 0; rank < group_size; ++rank) {
+    Tensor tensor(DT_FLOAT, TensorShape({tensor_len}));
+    for (int i = 0; i < tensor_len; ++i) {
+      tensor.flat<float>()(i) = rank * 10 + i;
+      expected[i] += rank * 10 + i;
+    }
+    tensors.push_back(tensor);
+  }
+  BlockingCounter counter(group_size);
+  for (int rank = 0; rank < group_size; ++rank) {
+    SchedClosure([&, rank] {
+      auto col_params = CreateCollectiveParams(
+          *test_env, rank, "HierarchicalReduce", REDUCTION_COLLECTIVE,
+          DT_FLOAT, tensors[rank].shape());
+      Device* device = nullptr;
+      TF_CHECK_OK(test_env->device_mgr->LookupDevice(
+          col_params->group.members[rank].device.name(), &device));
+      std::unique_ptr<OpKernel> merge_op = GetAdd(DT_FLOAT, device);
+      col_params->merge_op = merge_op.get();
+      TF_EXPECT_OK(RunCollective(test_env.get(), col_params.get(), device,
+                                 &tensors[rank], &tensors[rank]));
+      counter.DecrementCount();
+    });
+  }
+  counter.Wait();
+  for (int rank = 0; rank < group_size; ++rank) {
+    test::ExpectTensorEqual<float>(test::AsTensor<float>(expected),
+                                   tensors[rank]);
+  }
+}
+
+TEST(HierarchicalReducerTest, Wkr1_Dev4_Len1001) { RunTest(1, 4, 1001); }
+TEST(HierarchicalReducerTest, Wkr2_Dev1_Len1001) { RunTest(2, 1, 1001); }
+TEST(HierarchicalReducerTest, Wkr2_Dev2_Len3) { RunTest(2, 2, 3); }
+TEST(HierarchicalReducerTest, Wkr2_Dev4_Len4095) { RunTest(2, 4, 4095); }
+TEST(HierarchicalReducerTest, Wkr3_Dev3_Len1001) { RunTest(3, 3, 1001); }
+TEST(HierarchicalReducerTest, Wkr4_Dev8_Len9408) { RunTest(4, 8, 9408); }
+TEST(HierarchicalReducerTest, Wkr5_Dev6_Len1045991) { RunTest(5, 6, 1045991); }
+
+TEST(HierarchicalReducerTest, DifferentNumDevicesPerTask) {
+  auto test_env = CreateCollectiveTestEnv(/*num_workers=*/2,
+                                          /*num_devices_per_worker=*/2,
+                                          DEVICE_CPU);
+  auto col_params =
+      CreateCollectiveParams(*test_env, /*rank=*/0, "HierarchicalReduce",
+                             REDUCTION_COLLECTIVE, DT_FLOAT, TensorShape({1}));
+  col_params->group.members.pop_back();
+  col_params->group.group_size = 3;
+  core::RefCountPtr<HierarchicalReducer> reducer(new HierarchicalReducer());
+  EXPECT_TRUE(errors::IsInvalidArgument(
+      reducer->InitializeCollectiveParams(col_params.get())));
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -15,10 +15,15 @@ limitations under the License.
 
 #include "tensorflow/core/common_runtime/immutable_executor_state.h"
 
+#include <algorithm>
+
 #include "absl/memory/memory.h"
+#include "tensorflow/core/common_runtime/static_memory_planner.h"
+#include "tensorflow/core/common_runtime/step_arena_allocator.h"
 #include "tensorflow/core/framework/function.h"
 #include "tensorflow/core/framework/metrics.h"
 #include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/graph/algorithm.h"
 #include "tensorflow/core/graph/edgeset.h"
 #include "tensorflow/core/graph/graph.h"
 #include "tensorflow/core/graph/graph_node_util.h"
@@ -195,6 +200,7 @@ Status ImmutableExecutorState::Initialize(const Graph& graph) {
     item->is_recv_or_switch = IsRecv(n) || IsSwitch(n);
     item->is_next_iteration = IsNextIteration(n);
     item->is_distributed_communication = IsDistributedCommunication(n);
+    item->is_step_local = false;
 
     // Compute the maximum values we'll store for this node in the
     // pending counts data structure, and allocate a handle in
@@ -242,7 +248,7 @@ Status ImmutableExecutorState::Initialize(const Graph& graph) {
   }
 
   // Rewrite each `EdgeInfo::input_slot` member to refer directly to the input
-  // location.
+  // location, and cache the pending count handle of each edge destination.
   for (const Node* n : graph.nodes()) {
     if (IsSink(n)) continue;
     const int id = n->id();
@@ -252,9 +258,17 @@ Status ImmutableExecutorState::Initialize(const Graph& graph) {
       const int dst_id = e.dst_id;
       NodeItem* dst_item = gview_.node(dst_id);
       e.input_slot += dst_item->input_start;
+      e.dst_pending_id = pending_ids_[dst_id];
+    }
+    for (ControlEdgeInfo& e : item->mutable_output_control_edges()) {
+      e.dst_pending_id = pending_ids_[e.dst_id];
     }
   }
 
+  if (StepArenaAllocatorEnabled() || StaticMemoryPlanEnabled()) {
+    InitializeStepLocalOutputs(graph);
+  }
+
   // Initialize PendingCounts only after pending_ids_[node.id] is initialized
   // for all nodes.
   InitializePending(&graph, cf_info);
@@ -281,6 +295,54 @@ bool ExtractScopedAllocatorAttr(const std::vector<int>& sc_attr,
 }
 }  // namespace
 
+void ImmutableExecutorState::InitializeStepLocalOutputs(const Graph& graph) {
+  // `retains_inputs[id]` is true if node `id` may keep one of its inputs alive
+  // beyond the step, either itself or by forwarding the input buffer to an
+  // output that does.
+  std::vector<bool> retains_inputs(graph.num_node_ids(), false);
+  // Start from every root rather than from the source node alone, since the
+  // executor runs graphs whose source edges have not been fixed up.
+  std::vector<Node*> roots;
+  for (Node* n : graph.nodes()) {
+    if (n->in_edges().empty()) roots.push_back(n);
+  }
+  std::vector<Node*> order;
+  DFSFrom(graph, roots, /*enter=*/nullptr,
+          /*leave=*/[&order](Node* n) { order.push_back(n); });
+  // Visit every node after all of its consumers. The only cycles go through
+  // NextIteration and Merge nodes, which always retain their inputs.
+  for (const Node* n : order) {
+    if (IsSink(n)) continue;
+    NodeItem* item = gview_.node(n->id());
+    const bool is_stateful = n->op_def().is_stateful();
+    bool retains = is_stateful || n->IsRetval() || n->IsFunctionCall() ||
+                   n->IsIfNode() || n->IsWhileNode() || n->IsCaseNode() ||
+                   n->IsControlFlow() || IsTransferNode(n) ||
+                   item->is_any_input_ref_typed;
+
+    // Outputs without consumers are dropped at the end of the node, so only
+    // outputs that reach a retaining consumer escape.
+    std::unique_ptr<bool[]> outputs_step_local(new bool[n->num_outputs()]);
+    for (int i = 0; i < n->num_outputs(); ++i) {
+      outputs_step_local[i] = !is_stateful && !IsRefType(n->output_type(i));
+    }
+    for (const Edge* e : n->out_edges()) {
+      if (e->IsControlEdge()) continue;
+      if (retains_inputs[e->dst()->id()]) {
+        outputs_step_local[e->src_output()] = false;
+        retains = true;
+      }
+    }
+    retains_inputs[n->id()] = retains;
+    item->is_step_local = !retains;
+    if (std::any_of(&outputs_step_local[0],
+                    &outputs_step_local[n->num_outputs()],
+                    [](bool b) { return b; })) {
+      item->outputs_step_local = std::move(outputs_step_local);
+    }
+  }
+}
+
 Status ImmutableExecutorState::BuildControlFlowInfo(const Graph* g,
                                                     ControlFlowInfo* cf_info) {
   const int num_nodes = g->num_node_ids();
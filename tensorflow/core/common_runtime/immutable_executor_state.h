@@ -126,6 +126,11 @@ class ImmutableExecutorState {
                                      ControlFlowInfo* cf_info);
   void InitializePending(const Graph* graph, const ControlFlowInfo& cf_info);
 
+  // Determines which outputs and temporaries of each node cannot outlive a
+  // step, and records them in `NodeItem::outputs_step_local` and
+  // `NodeItem::is_step_local`.
+  void InitializeStepLocalOutputs(const Graph& graph);
+
   FrameInfo* EnsureFrameInfo(const string& fname);
 
   // Owned.
@@ -99,12 +99,24 @@ Allocator* ProcessState::GetCPUAllocator(int numa_node) {
         LOG(ERROR) << "GetCPUAllocator: " << status.error_message();
       }
       int64_t cpu_mem_limit = cpu_mem_limit_in_mb * (1LL << 20);
+      bool use_thread_local_cache = false;
+      status = ReadBoolFromEnvVar("TF_CPU_BFC_USE_THREAD_LOCAL_CACHE",
+                                  /*default_val=*/false,
+                                  &use_thread_local_cache);
+      if (!status.ok()) {
+        LOG(ERROR) << "GetCPUAllocator: " << status.error_message();
+      }
       DCHECK(sub_allocator);
-      allocator =
+      BFCAllocator* bfc_allocator =
           new BFCAllocator(sub_allocator, cpu_mem_limit, /*allow_growth=*/true,
                            /*name=*/"bfc_cpu_allocator_for_gpu");
+      if (use_thread_local_cache) {
+        bfc_allocator->EnableThreadLocalCache();
+      }
+      allocator = bfc_allocator;
       VLOG(2) << "Using BFCAllocator with memory limit of "
-              << cpu_mem_limit_in_mb << " MB for ProcessState CPU allocator";
+              << cpu_mem_limit_in_mb << " MB for ProcessState CPU allocator"
+              << (use_thread_local_cache ? " and a thread-local cache" : "");
     } else if (sub_allocator) {
       DCHECK(sub_allocator);
       allocator =
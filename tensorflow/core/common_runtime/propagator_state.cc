@@ -313,7 +313,7 @@ void PropagatorState::DeleteFrame(FrameState* frame, TaggedNodeSeq* ready) {
       for (const EdgeInfo& e : item->output_edges()) {
         const NodeItem& dst_item =
             immutable_state_.graph_view().node_ref(e.dst_id);
-        const auto dst_pending_id = immutable_state_.pending_ids()[e.dst_id];
+        const PendingCounts::Handle dst_pending_id = e.dst_pending_id;
 
         bool dst_dead = true;
         bool dst_ready;
@@ -333,7 +333,7 @@ void PropagatorState::DeleteFrame(FrameState* frame, TaggedNodeSeq* ready) {
       for (const ControlEdgeInfo& e : item->output_control_edges()) {
         const NodeItem& dst_item =
             immutable_state_.graph_view().node_ref(e.dst_id);
-        const auto dst_pending_id = immutable_state_.pending_ids()[e.dst_id];
+        const PendingCounts::Handle dst_pending_id = e.dst_pending_id;
 
         bool dst_dead;
         bool dst_ready;
@@ -413,8 +413,7 @@ int PropagatorState::FrameState::ActivateNodesFastPathInternal(
   Entry* input_tensors = iter_state->input_tensors;
   for (const EdgeInfo& e : item->output_edges()) {
     const int dst_id = e.dst_id;
-    const PendingCounts::Handle dst_pending_id =
-        immutable_state.pending_ids()[dst_id];
+    const PendingCounts::Handle dst_pending_id = e.dst_pending_id;
     const int src_slot = e.output_slot;
 
     const bool increment_dead =
@@ -435,8 +434,7 @@ int PropagatorState::FrameState::ActivateNodesFastPathInternal(
 
   for (const ControlEdgeInfo& e : item->output_control_edges()) {
     const int dst_id = e.dst_id;
-    const PendingCounts::Handle dst_pending_id =
-        immutable_state.pending_ids()[dst_id];
+    const PendingCounts::Handle dst_pending_id = e.dst_pending_id;
     const PendingCounts::AdjustResult adjust_result =
         atomic
             ? iter_state->adjust_for_activation_atomic(dst_pending_id, is_dead)
@@ -471,8 +469,7 @@ int PropagatorState::FrameState::ActivateNodesSlowPath(
   for (const EdgeInfo& e : item->output_edges()) {
     const int dst_id = e.dst_id;
     const NodeItem* dst_item = &gview.node_ref(dst_id);
-    const PendingCounts::Handle dst_pending_id =
-        immutable_state.pending_ids()[dst_id];
+    const PendingCounts::Handle dst_pending_id = e.dst_pending_id;
     const int src_slot = e.output_slot;
 
     bool dst_dead = false;
@@ -533,8 +530,7 @@ int PropagatorState::FrameState::ActivateNodesSlowPath(
   for (const ControlEdgeInfo& e : item->output_control_edges()) {
     const int dst_id = e.dst_id;
     const NodeItem* dst_item = &gview.node_ref(dst_id);
-    const PendingCounts::Handle dst_pending_id =
-        immutable_state.pending_ids()[dst_id];
+    const PendingCounts::Handle dst_pending_id = e.dst_pending_id;
 
     bool dst_dead;
     bool dst_ready;
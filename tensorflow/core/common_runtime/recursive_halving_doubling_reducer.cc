@@ -0,0 +1,346 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/common_runtime/recursive_halving_doubling_reducer.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "tensorflow/core/common_runtime/collective_rma_local.h"
+#include "tensorflow/core/common_runtime/collective_util.h"
+#include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/common_runtime/dma_helper.h"
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/framework/cancellation.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/notification.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/blocking_counter.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/profiler/lib/traceme.h"
+
+namespace tensorflow {
+namespace {
+
+// Returns the largest power of two that is at most `n`.
+int LargestPowerOfTwo(int n) {
+  int p = 1;
+  while (p * 2 <= n) p *= 2;
+  return p;
+}
+
+// Members [0, 2 * num_extra) of a subgroup of size `2^k + num_extra` are
+// paired up, and only the odd member of each pair takes part in the halving
+// and doubling steps. Returns the index among the participating members of
+// the member at `index`, or -1 if it does not participate.
+int VirtualIndex(int index, int num_extra) {
+  if (index < 2 * num_extra) {
+    return index % 2 == 0 ? -1 : index / 2;
+  }
+  return index - num_extra;
+}
+
+// Inverse of VirtualIndex.
+int RealIndex(int virtual_index, int num_extra) {
+  return virtual_index < num_extra ? 2 * virtual_index + 1
+                                   : virtual_index + num_extra;
+}
+
+int IndexOf(const std::vector<int>& ranks, int rank) {
+  auto it = std::find(ranks.begin(), ranks.end(), rank);
+  DCHECK(it != ranks.end()) << "Rank " << rank << " is not in the subgroup";
+  return it - ranks.begin();
+}
+
+}  // namespace
+
+Status RecursiveHalvingDoublingReducer::InitializeCollectiveParams(
+    CollectiveParams* col_params) {
+  // TODO(b/113171733): change CHECKs to return errors.
+  CHECK_EQ(col_params->instance.type, REDUCTION_COLLECTIVE);
+  return Status::OK();
+}
+
+Status RecursiveHalvingDoublingReducer::InitializeCollectiveContext(
+    std::shared_ptr<CollectiveContext> col_ctx) {
+  DCHECK(col_ctx->dev_mgr);
+  col_ctx_ = col_ctx;
+  col_params_ = col_ctx->col_params;
+  return collective_util::InitializeDeviceAndLocality(
+      col_ctx->dev_mgr, col_ctx->device_name, &col_ctx->device,
+      &col_ctx->device_locality);
+}
+
+void RecursiveHalvingDoublingReducer::Run(StatusCallback done) {
+  CHECK(col_ctx_);
+  CHECK(col_params_);
+  // Since this reducer doesn't require non-overlapping collectives, unblock
+  // any collective that is blocked on this instance.
+  col_ctx_->col_exec->UnblockDependencies(*col_params_);
+
+  // Start by copying input to output if they're not already the same, i.e. if
+  // we're not computing in-place on the input tensor.
+  if ((col_ctx_->input != col_ctx_->output) &&
+      (DMAHelper::base(col_ctx_->input) != DMAHelper::base(col_ctx_->output))) {
+    Notification note;
+    Status status;
+    profiler::TraceMe activity("MemCpyAsync", profiler::TraceMeLevel::kInfo);
+    CollectiveRemoteAccessLocal::MemCpyAsync(
+        col_ctx_->op_ctx->op_device_context(),
+        col_ctx_->op_ctx->op_device_context(), col_ctx_->device,
+        col_ctx_->device, col_ctx_->op_ctx->input_alloc_attr(0),
+        col_ctx_->op_ctx->output_alloc_attr(0), col_ctx_->input,
+        col_ctx_->output, 0 /*dev_to_dev_stream_index*/,
+        [&note, &status](const Status& s) {
+          status.Update(s);
+          note.Notify();
+        });
+    note.WaitForNotification();
+    if (!status.ok()) {
+      done(status);
+      return;
+    }
+  }
+
+  const int num_blocks = NumBlocks();
+  AllocatorAttributes attr = col_ctx_->op_ctx->output_alloc_attr(0);
+  ca_.reset(MakeCollectiveAdapter(col_ctx_->output, num_blocks,
+                                  col_ctx_->device->GetAllocator(attr)));
+  block_elts_ = CollectiveAdapter::AlignedChunkElts(
+      DataTypeSize(col_params_->instance.data_type),
+      ca_->Value().NumElements(), num_blocks);
+
+  Status status;
+  if (col_params_->final_op) {
+    Tensor group_size_val = ca_->Scalar(col_params_->group.group_size);
+    if (col_params_->group.device_type != DEVICE_CPU) {
+      group_size_tensor_ = ca_->Scalar(
+          col_ctx_->device->GetAllocator(col_ctx_->op_ctx->input_alloc_attr(0)),
+          AllocationAttributes());
+      Notification note;
+      col_ctx_->op_ctx->op_device_context()->CopyCPUTensorToDevice(
+          &group_size_val, col_ctx_->device, &group_size_tensor_,
+          [&note, &status](const Status& s) {
+            status.Update(s);
+            note.Notify();
+          });
+      note.WaitForNotification();
+    } else {
+      group_size_tensor_ = group_size_val;
+    }
+  }
+  if (status.ok()) {
+    status = ReduceBlocks();
+  }
+  // Recover the output from the adapter.
+  ca_->ConsumeFinalValue(col_ctx_->output);
+  ca_.reset();
+  if (!status.ok()) {
+    StartAbort(status);
+  }
+  done(status);
+}
+
+int RecursiveHalvingDoublingReducer::NumBlocks() const {
+  return LargestPowerOfTwo(col_params_->group.group_size);
+}
+
+Status RecursiveHalvingDoublingReducer::ReduceBlocks() {
+  std::vector<int> ranks(col_params_->group.group_size);
+  for (int i = 0; i < ranks.size(); ++i) {
+    ranks[i] = i;
+  }
+  int begin, end;
+  TF_RETURN_IF_ERROR(ReduceScatter(ranks, 0, NumBlocks(), "rs", &begin, &end));
+  TF_RETURN_IF_ERROR(Finalize(begin, end));
+  return AllGather(ranks, 0, NumBlocks(), "ag");
+}
+
+Status RecursiveHalvingDoublingReducer::ReduceScatter(
+    const std::vector<int>& ranks, int begin, int end, const string& tag,
+    int* owned_begin, int* owned_end) {
+  const int index = IndexOf(ranks, col_params_->default_rank);
+  const int num_participants = LargestPowerOfTwo(ranks.size());
+  const int num_extra = ranks.size() - num_participants;
+  DCHECK_EQ((end - begin) % num_participants, 0);
+  const int blocks_per_participant = (end - begin) / num_participants;
+  *owned_begin = *owned_end = begin;
+
+  const int virtual_index = VirtualIndex(index, num_extra);
+  if (virtual_index < 0) {
+    // Contribute all values to the next member, which reduces them on behalf
+    // of both.
+    Tensor values = Blocks(begin, end);
+    return Exchange(ranks[index + 1], strings::StrCat(tag, ":pre"), &values,
+                    nullptr);
+  }
+  if (index < 2 * num_extra) {
+    TF_RETURN_IF_ERROR(ExchangeAndReduce(ranks[index - 1],
+                                         strings::StrCat(tag, ":pre"),
+                                         nullptr, begin, end));
+  }
+  // Each step keeps the half of the current range selected by one bit of the
+  // virtual index, starting with the most significant one.
+  for (int mask = num_participants / 2; mask > 0; mask /= 2) {
+    const int peer = ranks[RealIndex(virtual_index ^ mask, num_extra)];
+    const int keep_begin =
+        begin + (virtual_index & ~(mask - 1)) * blocks_per_participant;
+    const int send_begin =
+        begin + ((virtual_index ^ mask) & ~(mask - 1)) * blocks_per_participant;
+    const int num_blocks = mask * blocks_per_participant;
+    Tensor send = Blocks(send_begin, send_begin + num_blocks);
+    TF_RETURN_IF_ERROR(ExchangeAndReduce(peer, strings::StrCat(tag, ":", mask),
+                                         &send, keep_begin,
+                                         keep_begin + num_blocks));
+  }
+  *owned_begin = begin + virtual_index * blocks_per_participant;
+  *owned_end = *owned_begin + blocks_per_participant;
+  return Status::OK();
+}
+
+Status RecursiveHalvingDoublingReducer::AllGather(const std::vector<int>& ranks,
+                                                  int begin, int end,
+                                                  const string& tag) {
+  const int index = IndexOf(ranks, col_params_->default_rank);
+  const int num_participants = LargestPowerOfTwo(ranks.size());
+  const int num_extra = ranks.size() - num_participants;
+  DCHECK_EQ((end - begin) % num_participants, 0);
+  const int blocks_per_participant = (end - begin) / num_participants;
+
+  const int virtual_index = VirtualIndex(index, num_extra);
+  if (virtual_index < 0) {
+    Tensor values = Blocks(begin, end);
+    return Exchange(ranks[index + 1], strings::StrCat(tag, ":post"), nullptr,
+                    &values);
+  }
+  // Each step doubles the current range, starting with the least significant
+  // bit of the virtual index.
+  for (int mask = 1; mask < num_participants; mask *= 2) {
+    const int peer = ranks[RealIndex(virtual_index ^ mask, num_extra)];
+    const int send_begin =
+        begin + (virtual_index & ~(mask - 1)) * blocks_per_participant;
+    const int recv_begin =
+        begin + ((virtual_index ^ mask) & ~(mask - 1)) * blocks_per_participant;
+    const int num_blocks = mask * blocks_per_participant;
+    Tensor send = Blocks(send_begin, send_begin + num_blocks);
+    Tensor recv = Blocks(recv_begin, recv_begin + num_blocks);
+    TF_RETURN_IF_ERROR(
+        Exchange(peer, strings::StrCat(tag, ":", mask), &send, &recv));
+  }
+  if (index < 2 * num_extra) {
+    Tensor values = Blocks(begin, end);
+    return Exchange(ranks[index - 1], strings::StrCat(tag, ":post"), &values,
+                    nullptr);
+  }
+  return Status::OK();
+}
+
+Status RecursiveHalvingDoublingReducer::Finalize(int begin, int end) {
+  Tensor values = Blocks(begin, end);
+  if (col_params_->final_op == nullptr || values.NumElements() == 0) {
+    return Status::OK();
+  }
+  return collective_util::ComputeBinOp(
+      col_ctx_->op_ctx, col_ctx_->op_params, col_ctx_->device,
+      col_params_->final_op, &values, &group_size_tensor_);
+}
+
+Tensor RecursiveHalvingDoublingReducer::Blocks(int begin, int end) const {
+  const Tensor& value = ca_->Value();
+  const int64_t num_elements = value.NumElements();
+  const int64_t start = std::min(begin * block_elts_, num_elements);
+  const int64_t limit = std::min(end * block_elts_, num_elements);
+  // As in CollectiveAdapter::ChunkAlias, an empty range is sliced from the
+  // front of the tensor to avoid an illegal offset.
+  return start < limit ? value.Slice(start, limit) : value.Slice(0, 0);
+}
+
+Status RecursiveHalvingDoublingReducer::Exchange(int peer, const string& tag,
+                                                 const Tensor* send,
+                                                 Tensor* recv) {
+  const int rank = col_params_->default_rank;
+  const CollGroupMember& member = col_params_->group.members[peer];
+  BlockingCounter pending((send != nullptr) + (recv != nullptr));
+  mutex mu;
+  Status status;
+  auto done = [this, &mu, &status, &pending](const Status& s) {
+    if (!s.ok()) {
+      StartAbort(s);
+    }
+    {
+      mutex_lock l(mu);
+      status.Update(s);
+    }
+    pending.DecrementCount();
+  };
+  if (send != nullptr) {
+    col_ctx_->col_exec->remote_access()->PostToPeer(
+        member.device.name(), member.task,
+        strings::StrCat(col_ctx_->exec_key, ":", tag, ":", rank, ":", peer),
+        col_ctx_->device, col_ctx_->op_ctx->op_device_context(),
+        col_ctx_->op_ctx->output_alloc_attr(0), send,
+        col_ctx_->device_locality, col_ctx_->op_ctx->cancellation_manager(),
+        done);
+  }
+  if (recv != nullptr) {
+    col_ctx_->col_exec->remote_access()->RecvFromPeer(
+        member.device.name(), member.task, member.is_local,
+        strings::StrCat(col_ctx_->exec_key, ":", tag, ":", peer, ":", rank),
+        col_ctx_->device, col_ctx_->op_ctx->op_device_context(),
+        col_ctx_->op_ctx->output_alloc_attr(0), recv,
+        col_ctx_->device_locality, 0 /*dev_to_dev_stream_index*/,
+        col_ctx_->op_ctx->cancellation_manager(), done);
+  }
+  pending.Wait();
+  return status;
+}
+
+Status RecursiveHalvingDoublingReducer::ExchangeAndReduce(int peer,
+                                                          const string& tag,
+                                                          const Tensor* send,
+                                                          int begin, int end) {
+  Tensor values = Blocks(begin, end);
+  Tensor peer_values(
+      col_ctx_->device->GetAllocator(col_ctx_->op_ctx->output_alloc_attr(0)),
+      values.dtype(), values.shape());
+  TF_RETURN_IF_ERROR(Exchange(peer, tag, send, &peer_values));
+  if (values.NumElements() == 0) {
+    return Status::OK();
+  }
+  return collective_util::ComputeBinOp(
+      col_ctx_->op_ctx, col_ctx_->op_params, col_ctx_->device,
+      col_params_->merge_op, &values, &peer_values);
+}
+
+void RecursiveHalvingDoublingReducer::StartAbort(const Status& s) {
+  // If the collective is being cancelled, all pending sends and receives are
+  // cancelled as well and there is no need to abort.
+  CancellationManager* cancel_mgr = col_ctx_->op_ctx->cancellation_manager();
+  if (cancel_mgr == nullptr ||
+      (!cancel_mgr->IsCancelled() && !cancel_mgr->IsCancelling())) {
+    col_ctx_->col_exec->StartAbort(s);
+  }
+}
+
+namespace {
+REGISTER_COLLECTIVE(RecursiveHalvingDoublingReduce,
+                    RecursiveHalvingDoublingReducer);
+}  // namespace
+
+}  // namespace tensorflow
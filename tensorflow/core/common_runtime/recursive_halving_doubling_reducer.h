@@ -0,0 +1,105 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_RECURSIVE_HALVING_DOUBLING_REDUCER_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_RECURSIVE_HALVING_DOUBLING_REDUCER_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/base_collective_executor.h"
+#include "tensorflow/core/framework/collective.h"
+
+namespace tensorflow {
+class Device;
+
+// Recursive halving-doubling implementation of collective all-reduce.
+//
+// The tensor is reduce-scattered by recursive halving: in step k every
+// member exchanges half of its current range with the member whose rank
+// differs in bit k, and reduces the half it keeps. The reduced ranges are
+// then all-gathered by recursive doubling. This takes 2 * log2(group_size)
+// steps, against 2 * (group_size - 1) for a ring, while sending the same
+// number of bytes, so it is faster for small tensors and large groups. If
+// the group size is not a power of two, the first members reduce their
+// tensors in pairs beforehand and receive the result afterwards.
+class RecursiveHalvingDoublingReducer
+    : public CollectiveImplementationInterface {
+ public:
+  RecursiveHalvingDoublingReducer() = default;
+  ~RecursiveHalvingDoublingReducer() override = default;
+
+  Status InitializeCollectiveParams(CollectiveParams* col_params) override;
+
+  // Initializes members of CollectiveContext not yet initialized, i.e. device
+  // and device_locality.  Also saves the CollectiveContext in this object.
+  Status InitializeCollectiveContext(
+      std::shared_ptr<CollectiveContext> col_ctx) override;
+
+  // Runs the reduction to completion before calling `done`.
+  // Must be called in a blockable thread.
+  void Run(StatusCallback done) override;
+
+ protected:
+  // Returns the number of blocks the tensor is divided into.
+  virtual int NumBlocks() const;
+
+  // Reduces the blocks of the tensor and applies the final op to them.
+  virtual Status ReduceBlocks();
+
+  // Reduce-scatters blocks [begin, end) over the members with the given
+  // ranks, one of which is this member, by recursive halving. Sets
+  // [*owned_begin, *owned_end) to the blocks this member reduced, which is
+  // empty if it only contributed its values. The number of blocks must be a
+  // multiple of the largest power of two that is at most `ranks.size()`.
+  Status ReduceScatter(const std::vector<int>& ranks, int begin, int end,
+                       const string& tag, int* owned_begin, int* owned_end);
+
+  // Inverse of ReduceScatter: all-gathers blocks [begin, end) over the
+  // members with the given ranks by recursive doubling.
+  Status AllGather(const std::vector<int>& ranks, int begin, int end,
+                   const string& tag);
+
+  // Applies the final op to blocks [begin, end).
+  Status Finalize(int begin, int end);
+
+  std::shared_ptr<CollectiveContext> col_ctx_;
+  const CollectiveParams* col_params_ = nullptr;  // Not owned
+
+ private:
+  // Returns the values of blocks [begin, end), which alias the tensor.
+  Tensor Blocks(int begin, int end) const;
+
+  // Sends `send` to and receives `recv` from the member with rank `peer`.
+  // Either may be null.
+  Status Exchange(int peer, const string& tag, const Tensor* send,
+                  Tensor* recv);
+
+  // Sends `send`, which may be null, to the member with rank `peer`, and
+  // reduces its values of blocks [begin, end) into this member's values.
+  Status ExchangeAndReduce(int peer, const string& tag, const Tensor* send,
+                           int begin, int end);
+
+  // Aborts the pending sends and receives of the collective executor.
+  void StartAbort(const Status& s);
+
+  std::unique_ptr<CollectiveAdapter> ca_;
+  int64_t block_elts_ = 0;
+  Tensor group_size_tensor_;
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_RECURSIVE_HALVING_DOUBLING_REDUCER_H_
@@ -0,0 +1,204 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/common_runtime/recursive_halving_doubling_reducer.h"
+
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/collective_test_util.h"
+#include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/common_runtime/device_mgr.h"
+#include "tensorflow/core/common_runtime/process_util.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/blocking_counter.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow/core/public/version.h"
+
+namespace tensorflow {
+namespace {
+
+std::unique_ptr<OpKernel> GetKernel(const string& op, DataType dtype,
+                                    Device* device) {
+  NodeDef node_def;
+  TF_CHECK_OK(NodeDefBuilder(strings::StrCat(op, "_node"), op)
+                  .Attr("T", dtype)
+                  .Input(FakeInput(dtype))
+                  .Input(FakeInput(dtype))
+                  .Finalize(&node_def));
+  Status status;
+  std::unique_ptr<OpKernel> k = CreateOpKernel(
+      DeviceType(device->device_type()), device,
+      device->GetAllocator(AllocatorAttributes()), node_def,
+      TF_GRAPH_DEF_VERSION, &status);
+  TF_CHECK_OK(status);
+  return k;
+}
+
+// Runs the reduction `collective_name` of `tensors`, one per device, and
+// returns the status of each device.
+std::vector<Status> RunReduce(CollectiveTestEnv* test_env,
+                              const string& collective_name,
+                              std::vector<Tensor>* tensors) {
+  const int group_size = tensors->size();
+  std::vector<Status> statuses(group_size);
+  BlockingCounter counter(group_size);
+  for (int rank = 0; rank < group_size; ++rank) {
+    SchedClosure([&, rank] {
+      Tensor* tensor = &(*tensors)[rank];
+      auto col_params =
+          CreateCollectiveParams(*test_env, rank, collective_name,
+                                 REDUCTION_COLLECTIVE, tensor->dtype(),
+                                 tensor->shape());
+      Device* device = nullptr;
+      TF_CHECK_OK(test_env->device_mgr->LookupDevice(
+          col_params->group.members[rank].device.name(), &device));
+      std::unique_ptr<OpKernel> merge_op =
+          GetKernel("Add", tensor->dtype(), device);
+      std::unique_ptr<OpKernel> final_op =
+          GetKernel("Div", tensor->dtype(), device);
+      col_params->merge_op = merge_op.get();
+      col_params->final_op = final_op.get();
+      statuses[rank] =
+          RunCollective(test_env, col_params.get(), device, tensor, tensor);
+      counter.DecrementCount();
+    });
+  }
+  counter.Wait();
+  return statuses;
+}
+
+template <typename T>
+void RunTest(const string& collective_name, int num_workers, int num_devices,
+             int tensor_len) {
+  auto test_env = CreateCollectiveTestEnv(num_workers, num_devices, DEVICE_CPU);
+  const int group_size = num_workers * num_devices;
+  std::vector<Tensor> tensors;
+  std::vector<T> expected(tensor_len);
+  for (int rank = 0; rank < group_size; ++rank) {
+    Tensor tensor(DataTypeToEnum<T>::value, TensorShape({tensor_len}));
+    for (int i = 0; i < tensor_len; ++i) {
+      const T value = static_cast<T>(rank * 10 + i);
+      tensor.flat<T>()(i) = value;
+      expected[i] += value;
+    }
+    tensors.push_back(tensor);
+  }
+  for (int i = 0; i < tensor_len; ++i) {
+    expected[i] /= static_cast<T>(group_size);
+  }
+  for (const Status& status : RunReduce(test_env.get(), collective_name,
+                                        &tensors)) {
+    TF_EXPECT_OK(status);
+  }
+  for (int rank = 0; rank < group_size; ++rank) {
+    test::ExpectTensorEqual<T>(test::AsTensor<T>(expected), tensors[rank]);
+  }
+}
+
+#define DEF_TEST(B, T, W, D, L)                                               \
+  TEST(RecursiveHalvingDoublingReducerTest,                                   \
+       DaTy##B##_Wkr##W##_Dev##D##_Len##L) {                                  \
+    RunTest<T>("RecursiveHalvingDoublingReduce", W, D, L);                    \
+  }
+
+// Single device, power of two and other group sizes, and tensors that are
+// smaller than, as large as and larger than the group.
+DEF_TEST(FLOAT, float, 1, 1, 5)
+DEF_TEST(FLOAT, float, 1, 2, 1)
+DEF_TEST(FLOAT, float, 1, 2, 1001)
+DEF_TEST(FLOAT, float, 1, 3, 2)
+DEF_TEST(FLOAT, float, 1, 3, 1001)
+DEF_TEST(FLOAT, float, 1, 4, 4)
+DEF_TEST(FLOAT, float, 2, 4, 4095)
+DEF_TEST(FLOAT, float, 1, 5, 7)
+DEF_TEST(FLOAT, float, 2, 3, 1001)
+DEF_TEST(FLOAT, float, 2, 8, 9408)
+DEF_TEST(FLOAT, float, 3, 5, 1045991)
+DEF_TEST(DOUBLE, double, 1, 7, 1001)
+DEF_TEST(INT32, int32, 2, 5, 1001)
+DEF_TEST(INT64, int64, 4, 4, 4095)
+
+TEST(RecursiveHalvingDoublingReducerTest, Failure) {
+  auto test_env = CreateCollectiveTestEnv(/*num_workers=*/1,
+                                          /*num_devices_per_worker=*/6,
+                                          DEVICE_CPU);
+  test_env->remote_access->set_fail_after(3);
+  std::vector<Tensor> tensors;
+  for (int rank = 0; rank < 6; ++rank) {
+    tensors.push_back(test::AsTensor<float>({1., 2., 3.}));
+  }
+  int num_failures = 0;
+  for (const Status& status : RunReduce(test_env.get(),
+                                        "RecursiveHalvingDoublingReduce",
+                                        &tensors)) {
+    if (!status.ok()) {
+      EXPECT_NE(status.error_message().find("Deliberate failure"),
+                string::npos);
+      ++num_failures;
+    }
+  }
+  EXPECT_GT(num_failures, 0);
+}
+
+// Reports the algorithm bandwidth of an all-reduce, i.e. the size of the
+// reduced tensor divided by the time the all-reduce takes.
+void BM_Reduce(::testing::benchmark::State& state, const string& name) {
+  const int num_workers = state.range(0);
+  const int num_devices = state.range(1);
+  const int64_t num_elements = state.range(2) / sizeof(float);
+  auto test_env = CreateCollectiveTestEnv(num_workers, num_devices, DEVICE_CPU);
+  std::vector<Tensor> tensors(num_workers * num_devices);
+  for (Tensor& tensor : tensors) {
+    tensor = Tensor(DT_FLOAT, TensorShape({num_elements}));
+    tensor.flat<float>().setConstant(1);
+  }
+  for (auto s : state) {
+    for (const Status& status : RunReduce(test_env.get(), name, &tensors)) {
+      TF_CHECK_OK(status);
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * num_elements * sizeof(float));
+}
+
+void BM_RecursiveHalvingDoublingReduce(::testing::benchmark::State& state) {
+  BM_Reduce(state, "RecursiveHalvingDoublingReduce");
+}
+
+void BM_RingReduce(::testing::benchmark::State& state) {
+  BM_Reduce(state, "RingReduce");
+}
+
+#define BM_REDUCE_ARGS(B)                               \
+  BENCHMARK(B)                                          \
+      ->UseRealTime()                                   \
+      ->ArgNames({"workers", "devices", "bytes"})       \
+      ->Args({1, 16, 4 << 10})                          \
+      ->Args({4, 8, 4 << 10})                           \
+      ->Args({4, 8, 256 << 10})                         \
+      ->Args({4, 8, 4 << 20});
+
+BM_REDUCE_ARGS(BM_RecursiveHalvingDoublingReduce);
+BM_REDUCE_ARGS(BM_RingReduce);
+
+}  // namespace
+}  // namespace tensorflow
@@ -16,6 +16,7 @@ limitations under the License.
 
 #include <stdlib.h>
 
+#include <algorithm>
 #include <atomic>
 #include <functional>
 #include <utility>
@@ -208,20 +209,25 @@ Status RingAlg::InitializeCollectiveParams(CollectiveParams* col_params) {
     TF_RETURN_IF_ERROR(GenerateSubdivsInCollectiveParams(col_params));
   }
 
+  // Each subdivision is pipelined as `num_segments` consecutive subdivisions
+  // that share the ring of its offset.
+  const int num_segments =
+      std::max(col_params->instance.impl_details.pipeline_segments, 1);
+  const int num_subdivs =
+      col_params->instance.impl_details.subdiv_offsets.size() * num_segments;
+
   // Generate a ring permutation for requested offset.
   VLOG(2) << "Setting up perms for col_params " << col_params
           << " subdiv_permutations "
           << &col_params->instance.impl_details.subdiv_permutations;
-  col_params->instance.impl_details.subdiv_permutations.resize(
-      col_params->instance.impl_details.subdiv_offsets.size());
-  col_params->subdiv_rank.resize(
-      col_params->instance.impl_details.subdiv_offsets.size(), -1);
-  for (int sdi = 0;
-       sdi < col_params->instance.impl_details.subdiv_offsets.size(); ++sdi) {
+  col_params->instance.impl_details.subdiv_permutations.resize(num_subdivs);
+  col_params->subdiv_rank.resize(num_subdivs, -1);
+  for (int sdi = 0; sdi < num_subdivs; ++sdi) {
     std::vector<int>& perm =
         col_params->instance.impl_details.subdiv_permutations[sdi];
     DCHECK_EQ(perm.size(), 0);
-    int offset = col_params->instance.impl_details.subdiv_offsets[sdi];
+    int offset =
+        col_params->instance.impl_details.subdiv_offsets[sdi / num_segments];
     // A negative subdivision offset is interpreted as follows:
     //  1. Reverse the local device ordering.
     //  2. Begin the subdivision at abs(offset) in the reversed ordering.
@@ -407,7 +413,8 @@ void RingAlg::DispatchSend(RingField* rf, const StatusCallback& done) {
       col_params_->group.members[send_to_dev_idx].device.name(),
       col_params_->group.members[send_to_dev_idx].task, send_buf_key,
       col_ctx_->device, col_ctx_->op_ctx->op_device_context(),
-      col_ctx_->op_ctx->output_alloc_attr(0), &rf->chunk,
+      col_ctx_->op_ctx->output_alloc_attr(0),
+      rf->use_wire_chunk ? &rf->wire_chunk : &rf->chunk,
       col_ctx_->device_locality, col_ctx_->op_ctx->cancellation_manager(),
       done);
 }
@@ -423,6 +430,9 @@ void RingAlg::DispatchRecv(RingField* rf, const StatusCallback& done) {
   Tensor* dst_tensor = (!rf->second_pass && (col_params_->merge_op != nullptr))
                            ? &rf->tmp_chunk
                            : &rf->chunk;
+  if (rf->use_wire_chunk) {
+    dst_tensor = &rf->wire_chunk;
+  }
   col_ctx_->col_exec->remote_access()->RecvFromPeer(
       col_params_->group.members[rf->recv_dev_idx].device.name(),
       col_params_->group.members[rf->recv_dev_idx].task,
@@ -75,6 +75,11 @@ class RingAlg : public CollectiveImplementationInterface {
     bool is_final = false;  // is the last field in the pass for this rank
     Tensor chunk;           // alias to field values
     Tensor tmp_chunk;
+    // If `use_wire_chunk` is set, values are sent and received in
+    // `wire_chunk` instead of `chunk` and `tmp_chunk`, in a different data
+    // type.
+    bool use_wire_chunk = false;
+    Tensor wire_chunk;
     Status status;
     string DebugString() const;
   };
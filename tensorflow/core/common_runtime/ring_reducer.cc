@@ -16,10 +16,16 @@ limitations under the License.
 
 #include <stdlib.h>
 
+#include <algorithm>
 #include <atomic>
 #include <functional>
+#include <list>
+#include <memory>
 #include <utility>
 
+#include "absl/container/flat_hash_map.h"
+#include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+
 #include "tensorflow/core/common_runtime/collective_rma_local.h"
 #include "tensorflow/core/common_runtime/collective_util.h"
 #include "tensorflow/core/common_runtime/copy_tensor.h"
@@ -30,6 +36,7 @@ limitations under the License.
 #include "tensorflow/core/framework/allocator.h"
 #include "tensorflow/core/framework/device_base.h"
 #include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/resource_mgr.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/lib/core/errors.h"
@@ -40,8 +47,152 @@ limitations under the License.
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/types.h"
 #include "tensorflow/core/profiler/lib/traceme.h"
+#include "tensorflow/core/util/env_var.h"
 
 namespace tensorflow {
+namespace {
+
+// The rounding residuals a device keeps for error feedback are evicted in
+// least recently used order once they take more than this many bytes.
+constexpr int64_t kMaxWireResidualBytes = int64_t{1} << 30;
+
+// The default number of pipeline segments per subdivision. Remote members of
+// a group use the setting of the group leader.
+int DefaultPipelineSegments() {
+  static const int segments = [] {
+    int64_t segments;
+    Status s = ReadInt64FromEnvVar("TF_RING_REDUCE_PIPELINE_SEGMENTS",
+                                   /*default_val=*/1, &segments);
+    if (!s.ok()) {
+      LOG(ERROR) << "Invalid TF_RING_REDUCE_PIPELINE_SEGMENTS: " << s;
+      return 1;
+    }
+    return static_cast<int>(std::max<int64_t>(segments, 1));
+  }();
+  return segments;
+}
+
+// The default data type in which float values are exchanged, or DT_INVALID
+// if they are exchanged as floats. TF_RING_REDUCE_WIRE_DTYPE may be set to
+// "bfloat16" or "half". Remote members of a group use the setting of the
+// group leader.
+DataType DefaultWireDtype() {
+  static const DataType wire_dtype = [] {
+    string name;
+    Status s = ReadStringFromEnvVar("TF_RING_REDUCE_WIRE_DTYPE",
+                                    /*default_val=*/"", &name);
+    if (!s.ok()) {
+      LOG(ERROR) << "Invalid TF_RING_REDUCE_WIRE_DTYPE: " << s;
+      return DT_INVALID;
+    }
+    DataType dtype = DT_INVALID;
+    if (!name.empty() && (!DataTypeFromString(name, &dtype) ||
+                          (dtype != DT_BFLOAT16 && dtype != DT_HALF))) {
+      LOG(WARNING) << "Ignoring TF_RING_REDUCE_WIRE_DTYPE=" << name
+                   << ", which must be bfloat16 or half.";
+      dtype = DT_INVALID;
+    }
+    return dtype;
+  }();
+  return wire_dtype;
+}
+
+// Rounds `chunk` plus `residual` to `wire`, and stores the rounding error in
+// `residual`. If `write_back` is true, also replaces `chunk` by the rounded
+// values, so that the sender and the receivers agree on them.
+template <typename W>
+void EncodeWire(const Eigen::ThreadPoolDevice& d, bool write_back,
+                Tensor* chunk, Tensor* residual, Tensor* wire) {
+  auto x = chunk->flat<float>();
+  auto r = residual->flat<float>();
+  auto w = wire->flat<W>();
+  w.device(d) = (x + r).template cast<W>();
+  r.device(d) = (x + r) - w.template cast<float>();
+  if (write_back) {
+    x.device(d) = w.template cast<float>();
+  }
+}
+
+template <typename W>
+void DecodeWire(const Eigen::ThreadPoolDevice& d, const Tensor& wire,
+                Tensor* out) {
+  out->flat<float>().device(d) = wire.flat<W>().template cast<float>();
+}
+
+}  // namespace
+
+// The rounding errors of the values a device sent in previous executions of
+// ring reductions, by instance and field. They are added to the values it
+// sends next (error feedback), so that rounding errors do not accumulate
+// over steps.
+//
+// Residuals are keyed by group and instance key, which graph mode reuses
+// every step. Callers that allocate a new instance key per call, as eager
+// mode does, get no error feedback, and their residuals are never used
+// again. Residuals are therefore evicted in least recently used order once
+// they take more than `max_bytes`.
+class RingReduceWireResiduals : public ResourceBase {
+ public:
+  struct Residual {
+    explicit Residual(const TensorShape& shape)
+        : shape(shape), value(DT_FLOAT, shape) {
+      value.flat<float>().setZero();
+    }
+
+    const TensorShape shape;
+    mutex mu;
+    Tensor value TF_GUARDED_BY(mu);
+  };
+
+  explicit RingReduceWireResiduals(int64_t max_bytes) : max_bytes_(max_bytes) {}
+
+  string DebugString() const override { return "RingReduceWireResiduals"; }
+
+  // Returns the residual for `key`, which is zero if there is none yet or if
+  // it had a different shape.
+  std::shared_ptr<Residual> Get(const string& key, const TensorShape& shape) {
+    mutex_lock l(mu_);
+    auto it = residuals_.find(key);
+    if (it != residuals_.end()) {
+      if (it->second.residual->shape == shape) {
+        lru_.splice(lru_.begin(), lru_, it->second.lru_position);
+        return it->second.residual;
+      }
+      EraseLocked(it);
+    }
+    auto residual = std::make_shared<Residual>(shape);
+    bytes_ += residual->shape.num_elements() * sizeof(float);
+    lru_.push_front(key);
+    residuals_[key] = {residual, lru_.begin()};
+    while (bytes_ > max_bytes_ && lru_.size() > 1) {
+      EraseLocked(residuals_.find(lru_.back()));
+    }
+    return residual;
+  }
+
+ private:
+  struct Entry {
+    // Shared with the reductions using it, so that it can be evicted while
+    // in use.
+    std::shared_ptr<Residual> residual;
+    // Position of the key in `lru_`.
+    std::list<string>::iterator lru_position;
+  };
+
+  void EraseLocked(absl::flat_hash_map<string, Entry>::iterator it)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    bytes_ -= it->second.residual->shape.num_elements() * sizeof(float);
+    lru_.erase(it->second.lru_position);
+    residuals_.erase(it);
+  }
+
+  const int64_t max_bytes_;
+  mutex mu_;
+  absl::flat_hash_map<string, Entry> residuals_ TF_GUARDED_BY(mu_);
+  // Keys of `residuals_`, most recently used first.
+  std::list<string> lru_ TF_GUARDED_BY(mu_);
+  int64_t bytes_ TF_GUARDED_BY(mu_) = 0;
+};
 
 RingReducer::~RingReducer() { group_size_tensor_ready_.WaitForNotification(); }
 
@@ -49,6 +200,31 @@ Status RingReducer::InitializeCollectiveParams(CollectiveParams* col_params) {
   // TODO(b/113171733): change CHECKs to return errors.
   CHECK_EQ(col_params->instance.type, REDUCTION_COLLECTIVE);
   CHECK_EQ(col_params->instance.impl_details.collective_name, "RingReduce");
+  CollImplDetails& impl_details = col_params->instance.impl_details;
+  if (impl_details.pipeline_segments <= 0) {
+    impl_details.pipeline_segments = DefaultPipelineSegments();
+  }
+  const bool can_convert = col_params->instance.data_type == DT_FLOAT &&
+                           col_params->group.device_type == DEVICE_CPU;
+  if (impl_details.wire_dtype == DT_INVALID && can_convert) {
+    impl_details.wire_dtype = DefaultWireDtype();
+  }
+  // Resolve the default, so that a member that received the settings of the
+  // group leader does not fall back to its own.
+  if (impl_details.wire_dtype == DT_INVALID) {
+    impl_details.wire_dtype = col_params->instance.data_type;
+  }
+  if (impl_details.wire_dtype != DT_INVALID &&
+      impl_details.wire_dtype != col_params->instance.data_type &&
+      !(can_convert && (impl_details.wire_dtype == DT_BFLOAT16 ||
+                        impl_details.wire_dtype == DT_HALF))) {
+    return errors::InvalidArgument(
+        "RingReduce can only exchange float values on CPU as bfloat16 or "
+        "half, got ",
+        DataTypeString(impl_details.wire_dtype), " for ",
+        DataTypeString(col_params->instance.data_type), " on ",
+        col_params->group.device_type.type_string());
+  }
   return RingAlg::InitializeCollectiveParams(col_params);
 }
 
@@ -167,6 +343,46 @@ void RingReducer::InitRingField(RingField* rf, int chunk_idx, int subdiv_idx,
   if (rf->do_recv) {
     rf->tmp_chunk = ca_->TempChunk(rf->sc_idx);
   }
+  if (wire_dtype_ != DT_INVALID && (rf->do_send || rf->do_recv)) {
+    rf->use_wire_chunk = true;
+    rf->wire_chunk =
+        Tensor(col_ctx_->device->GetAllocator(
+                   col_ctx_->op_ctx->output_alloc_attr(0)),
+               wire_dtype_, rf->chunk.shape());
+  }
+}
+
+void RingReducer::EncodeForSend(RingField* rf,
+                                RingReduceWireResiduals* residuals) {
+  // A value received in the second pass is forwarded as received.
+  if (rf->second_pass && rf->do_recv) return;
+  std::shared_ptr<RingReduceWireResiduals::Residual> residual =
+      residuals->Get(strings::StrCat(col_params_->group.group_key, ":",
+                                     col_params_->instance.instance_key, ":",
+                                     rf->sc_idx, ":", rf->second_pass),
+                     rf->chunk.shape());
+  mutex_lock l(residual->mu);
+  // In the second pass this device sends the final value of the chunk, which
+  // it must round the same way as every receiver.
+  const bool write_back = rf->second_pass;
+  const Eigen::ThreadPoolDevice& d = col_ctx_->op_ctx->eigen_cpu_device();
+  if (wire_dtype_ == DT_BFLOAT16) {
+    EncodeWire<bfloat16>(d, write_back, &rf->chunk, &residual->value,
+                         &rf->wire_chunk);
+  } else {
+    EncodeWire<Eigen::half>(d, write_back, &rf->chunk, &residual->value,
+                            &rf->wire_chunk);
+  }
+}
+
+void RingReducer::DecodeAfterRecv(RingField* rf) {
+  Tensor* out = rf->second_pass ? &rf->chunk : &rf->tmp_chunk;
+  const Eigen::ThreadPoolDevice& d = col_ctx_->op_ctx->eigen_cpu_device();
+  if (wire_dtype_ == DT_BFLOAT16) {
+    DecodeWire<bfloat16>(d, rf->wire_chunk, out);
+  } else {
+    DecodeWire<Eigen::half>(d, rf->wire_chunk, out);
+  }
 }
 
 // At the beginning of the algorithm initialize a RingField struct for
@@ -179,6 +395,27 @@ bool RingReducer::RunAsyncParts() {
   // one thread and do not require an explicit mutex.
   rfv_.clear();
   rfv_.resize(group_size_ * num_subdivs_);
+  const DataType wire_dtype = col_params_->instance.impl_details.wire_dtype;
+  core::RefCountPtr<RingReduceWireResiduals> residuals;
+  if (wire_dtype != DT_INVALID &&
+      wire_dtype != col_params_->instance.data_type) {
+    RingReduceWireResiduals* ptr;
+    Status s = col_ctx_->device->resource_manager()
+                   ->LookupOrCreate<RingReduceWireResiduals>(
+                       "ring_reducer", "wire_residuals", &ptr,
+                       [](RingReduceWireResiduals** ptr) {
+                         *ptr = new RingReduceWireResiduals(
+                             kMaxWireResidualBytes);
+                         return Status::OK();
+                       });
+    if (!s.ok()) {
+      mutex_lock l(status_mu_);
+      status_ = s;
+      return false;
+    }
+    residuals.reset(ptr);
+    wire_dtype_ = wire_dtype;
+  }
   PCQueue ready_queue;
   for (int chunk_idx = 0; chunk_idx < group_size_; ++chunk_idx) {
     for (int subdiv_idx = 0; subdiv_idx < num_subdivs_; ++subdiv_idx) {
@@ -252,6 +489,9 @@ bool RingReducer::RunAsyncParts() {
           case RF_RECV:
             CHECK_GT(recv_pending_count, 0);
             --recv_pending_count;
+            if (rf->use_wire_chunk) {
+              DecodeAfterRecv(rf);
+            }
             if (!rf->second_pass) {
               rf->action = RF_REDUCE;
               Status s = collective_util::ComputeBinOp(
@@ -285,6 +525,9 @@ bool RingReducer::RunAsyncParts() {
             break;
           case RF_SEND_READY:
             if (rf->do_send) {
+              if (rf->use_wire_chunk) {
+                EncodeForSend(rf, residuals.get());
+              }
               rf->action = RF_SEND;
               auto send_complete = [this, rf, &ready_queue,
                                     &aborted](Status s) {
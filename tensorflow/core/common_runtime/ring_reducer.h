@@ -26,6 +26,7 @@ limitations under the License.
 
 namespace tensorflow {
 class Device;
+class RingReduceWireResiduals;
 
 // Ring-algorithm implementation of collective all-reduce.
 class RingReducer : public RingAlg {
@@ -49,8 +50,15 @@ class RingReducer : public RingAlg {
   void ContinueAfterInputCopy();
   bool RunAsyncParts();
 
+  // Convert the values of `rf` to and from `wire_dtype_`.
+  void EncodeForSend(RingField* rf, RingReduceWireResiduals* residuals);
+  void DecodeAfterRecv(RingField* rf);
+
   Tensor group_size_tensor_;
   Notification group_size_tensor_ready_;
+  // The data type in which values are exchanged, or DT_INVALID if they are
+  // exchanged in the data type of the reduced tensor.
+  DataType wire_dtype_ = DT_INVALID;
 
   friend class RingReducerTest;
   friend class RingReducerInitParamsTest;
@@ -15,6 +15,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/ring_reducer.h"
 
 #include <algorithm>
+#include <cmath>
 
 #include "absl/memory/memory.h"
 #include "tensorflow/core/common_runtime/base_collective_executor.h"
@@ -34,10 +35,13 @@ limitations under the License.
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/framework/tensor_util.h"
 #include "tensorflow/core/lib/core/notification.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/blocking_counter.h"
 #include "tensorflow/core/platform/refcount.h"
 #include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
 #include "tensorflow/core/platform/unbounded_work_queue.h"
 #include "tensorflow/core/public/session_options.h"
 #include "tensorflow/core/public/version.h"
@@ -91,6 +95,10 @@ class RingReducerTest : public ::testing::Test {
         int rank = wi * num_devices + di;
         instances_.push_back(absl::make_unique<DeviceInstance>(
             rank, num_subdivs, dtype, shape, test_env_.get()));
+        CollImplDetails& impl_details =
+            instances_.back()->col_params_->instance.impl_details;
+        impl_details.pipeline_segments = pipeline_segments_;
+        impl_details.wire_dtype = wire_dtype_;
       }
     }
   }
@@ -148,8 +156,17 @@ class RingReducerTest : public ::testing::Test {
       }
       for (int di = 0; di < static_cast<int>(instances_.size()); ++di) {
         TF_EXPECT_OK(instances_[di]->status_);
-        test::ExpectTensorEqual<T>(test::AsTensor<T>(expected),
-                                   instances_[di]->tensor());
+        if (wire_dtype_ == DT_INVALID) {
+          test::ExpectTensorEqual<T>(test::AsTensor<T>(expected),
+                                     instances_[di]->tensor());
+        } else {
+          // Values are rounded on every hop, but all devices must agree.
+          test::ExpectClose(test::AsTensor<T>(expected),
+                            instances_[di]->tensor(), /*atol=*/0,
+                            /*rtol=*/0.02);
+          test::ExpectTensorEqual<T>(instances_[0]->tensor(),
+                                     instances_[di]->tensor());
+        }
       }
     }
   }
@@ -200,6 +217,8 @@ class RingReducerTest : public ::testing::Test {
 
   std::unique_ptr<CollectiveTestEnv> test_env_;
   std::vector<std::unique_ptr<DeviceInstance>> instances_;
+  int pipeline_segments_ = 1;
+  DataType wire_dtype_ = DT_INVALID;
   mutex mu_;
   int32 reduce_counter_ TF_GUARDED_BY(mu_) = 0;
 };
@@ -220,6 +239,13 @@ class RingReducerInitParamsTest : public ::testing::Test {
     EXPECT_EQ(expected_subdiv_rank, cp->subdiv_rank);
     reducer->group_size_tensor_ready_.Notify();  // To unblock destructor.
   }
+
+  Status InitializeCollectiveParams(CollectiveParams* cp) {
+    core::RefCountPtr<RingReducer> reducer(new RingReducer());
+    Status status = reducer->InitializeCollectiveParams(cp);
+    reducer->group_size_tensor_ready_.Notify();  // To unblock destructor.
+    return status;
+  }
 };
 
 TEST_F(RingReducerInitParamsTest, SpecifiedSubdivs) {
@@ -357,6 +383,35 @@ TEST_F(RingReducerInitParamsTest, AutomaticSubdivUsesDefault) {
   RunSubdivPermsTest(cp.get(), {{0, 1, 2, 3}, {0, 1, 2, 3}}, {0, 0});
 }
 
+TEST_F(RingReducerInitParamsTest, PipelineSegments) {
+  const int kNumDevsPerWorker = 2;
+  const int kNumWorkers = 2;
+  auto test_env =
+      CreateCollectiveTestEnv(kNumWorkers, kNumDevsPerWorker, DEVICE_CPU);
+  auto cp =
+      CreateCollectiveParams(*test_env, /*rank*/ 1, "RingReduce",
+                             REDUCTION_COLLECTIVE, DT_FLOAT, TensorShape({1}));
+
+  // Each subdivision is split into segments that share its ring.
+  cp->default_rank = 1;
+  cp->instance.impl_details.subdiv_offsets = {0, 1};
+  cp->instance.impl_details.pipeline_segments = 2;
+  RunSubdivPermsTest(cp.get(),
+                     {{0, 1, 2, 3}, {0, 1, 2, 3}, {1, 0, 3, 2}, {1, 0, 3, 2}},
+                     {1, 1, 0, 0});
+}
+
+TEST_F(RingReducerInitParamsTest, WireDtypeRequiresFloat) {
+  auto test_env = CreateCollectiveTestEnv(/*num_workers=*/1,
+                                          /*num_devices_per_worker=*/2,
+                                          DEVICE_CPU);
+  auto cp =
+      CreateCollectiveParams(*test_env, /*rank*/ 0, "RingReduce",
+                             REDUCTION_COLLECTIVE, DT_INT32, TensorShape({1}));
+  cp->instance.impl_details.wire_dtype = DT_BFLOAT16;
+  EXPECT_TRUE(errors::IsInvalidArgument(InitializeCollectiveParams(cp.get())));
+}
+
 TEST_F(RingReducerInitParamsTest, AutomaticSubdivDisabled) {
   const int kNumDevsPerWorker = 1;
   const int kNumWorkers = 4;
@@ -430,6 +485,160 @@ DEF_TEST(FLOAT, CPU, 2, 8, 1, 9408, 7)
 DEF_TEST(FLOAT, CPU, 2, 8, 2, 9408, 11)
 #endif
 
+TEST_F(RingReducerTest, PipelineSegments) {
+  pipeline_segments_ = 4;
+  RunTest<float>(DT_FLOAT, DEVICE_CPU, /*num_workers=*/2, /*num_devices=*/4,
+                 /*num_subdivs=*/2, /*tensor_len=*/4095, /*fail_after=*/0);
+}
+
+TEST_F(RingReducerTest, PipelineSegmentsFailure) {
+  pipeline_segments_ = 4;
+  RunTest<float>(DT_FLOAT, DEVICE_CPU, /*num_workers=*/2, /*num_devices=*/4,
+                 /*num_subdivs=*/1, /*tensor_len=*/9408, /*fail_after=*/7);
+}
+
+TEST_F(RingReducerTest, Bfloat16WireDtype) {
+  wire_dtype_ = DT_BFLOAT16;
+  RunTest<float>(DT_FLOAT, DEVICE_CPU, /*num_workers=*/2, /*num_devices=*/2,
+                 /*num_subdivs=*/1, /*tensor_len=*/1001, /*fail_after=*/0);
+}
+
+TEST_F(RingReducerTest, HalfWireDtypeWithPipelineSegments) {
+  wire_dtype_ = DT_HALF;
+  pipeline_segments_ = 2;
+  // Small enough that the partial sums do not overflow half.
+  RunTest<float>(DT_FLOAT, DEVICE_CPU, /*num_workers=*/1, /*num_devices=*/3,
+                 /*num_subdivs=*/1, /*tensor_len=*/201, /*fail_after=*/0);
+}
+
+// Reduces the same values repeatedly with the same instance key. Error
+// feedback adds the rounding error of each send to the next send of the same
+// field, so the rounding errors of the steps cancel instead of accumulating.
+TEST(RingReducerWireTest, ErrorFeedbackCancelsRoundingError) {
+  const int kNumDevices = 4;
+  const int64_t kNumElements = 256;
+  const int kNumSteps = 16;
+  auto test_env = CreateCollectiveTestEnv(/*num_workers=*/1, kNumDevices,
+                                          DEVICE_CPU);
+  std::vector<core::RefCountPtr<CollectiveParams>> col_params;
+  std::vector<Device*> devices(kNumDevices);
+  std::vector<std::unique_ptr<OpKernel>> ops;
+  std::vector<Tensor> inputs;
+  std::vector<double> expected(kNumElements, 0.0);
+  for (int rank = 0; rank < kNumDevices; ++rank) {
+    col_params.push_back(CreateCollectiveParams(
+        *test_env, rank, "RingReduce", REDUCTION_COLLECTIVE, DT_FLOAT,
+        TensorShape({kNumElements})));
+    CollectiveParams* cp = col_params.back().get();
+    cp->instance.impl_details.wire_dtype = DT_BFLOAT16;
+    TF_ASSERT_OK(test_env->device_mgr->LookupDevice(
+        cp->group.members[rank].device.name(), &devices[rank]));
+    ops.push_back(GetAdd(DT_FLOAT, DEVICE_CPU, devices[rank]));
+    cp->merge_op = ops.back().get();
+    // Values that bfloat16 cannot represent exactly.
+    inputs.emplace_back(DT_FLOAT, TensorShape({kNumElements}));
+    for (int64_t i = 0; i < kNumElements; ++i) {
+      const float value = 1.0f + 0.001f * rank + 0.0001f * i;
+      inputs.back().flat<float>()(i) = value;
+      expected[i] += value;
+    }
+  }
+
+  // The sum over all steps of the difference between the result and the
+  // exact sum, after the first step and after the last.
+  std::vector<double> first_step_error(kNumElements);
+  std::vector<double> accumulated_error(kNumElements, 0.0);
+  for (int step = 0; step < kNumSteps; ++step) {
+    std::vector<Tensor> tensors(kNumDevices);
+    BlockingCounter counter(kNumDevices);
+    for (int rank = 0; rank < kNumDevices; ++rank) {
+      tensors[rank] = tensor::DeepCopy(inputs[rank]);
+      SchedClosure([&, rank] {
+        CollectiveParams* cp = col_params[rank].get();
+        cp->instance.impl_details.subdiv_permutations.clear();
+        cp->subdiv_rank.clear();
+        TF_CHECK_OK(RunCollective(test_env.get(), cp, devices[rank],
+                                  &tensors[rank], &tensors[rank]));
+        counter.DecrementCount();
+      });
+    }
+    counter.Wait();
+    for (int64_t i = 0; i < kNumElements; ++i) {
+      accumulated_error[i] += tensors[0].flat<float>()(i) - expected[i];
+    }
+    if (step == 0) {
+      first_step_error = accumulated_error;
+    }
+  }
+
+  double max_first_step_error = 0.0;
+  double max_accumulated_error = 0.0;
+  for (int64_t i = 0; i < kNumElements; ++i) {
+    max_first_step_error =
+        std::max(max_first_step_error, std::abs(first_step_error[i]));
+    max_accumulated_error =
+        std::max(max_accumulated_error, std::abs(accumulated_error[i]));
+  }
+  // Without error feedback every step rounds the same values the same way,
+  // so the accumulated error would be `kNumSteps` times the first.
+  EXPECT_GT(max_first_step_error, 0.0);
+  EXPECT_LT(max_accumulated_error, 2 * max_first_step_error);
+}
+
+// Reports the algorithm bandwidth of an all-reduce, i.e. the size of the
+// reduced tensor divided by the time the all-reduce takes.
+void BM_RingReduce(::testing::benchmark::State& state) {
+  const int num_devices = state.range(0);
+  const int64_t num_elements = state.range(1) / sizeof(float);
+  const DataType wire_dtype = static_cast<DataType>(state.range(2));
+  const int pipeline_segments = state.range(3);
+  auto test_env = CreateCollectiveTestEnv(/*num_workers=*/1, num_devices,
+                                          DEVICE_CPU);
+  std::vector<core::RefCountPtr<CollectiveParams>> col_params;
+  std::vector<Device*> devices(num_devices);
+  std::vector<std::unique_ptr<OpKernel>> ops;
+  std::vector<Tensor> tensors;
+  for (int rank = 0; rank < num_devices; ++rank) {
+    col_params.push_back(CreateCollectiveParams(
+        *test_env, rank, "RingReduce", REDUCTION_COLLECTIVE, DT_FLOAT,
+        TensorShape({num_elements})));
+    CollectiveParams* cp = col_params.back().get();
+    cp->instance.impl_details.wire_dtype = wire_dtype;
+    cp->instance.impl_details.pipeline_segments = pipeline_segments;
+    TF_CHECK_OK(test_env->device_mgr->LookupDevice(
+        cp->group.members[rank].device.name(), &devices[rank]));
+    ops.push_back(GetAdd(DT_FLOAT, DEVICE_CPU, devices[rank]));
+    cp->merge_op = ops.back().get();
+    tensors.emplace_back(DT_FLOAT, TensorShape({num_elements}));
+    tensors.back().flat<float>().setConstant(rank);
+  }
+  for (auto s : state) {
+    BlockingCounter counter(num_devices);
+    for (int rank = 0; rank < num_devices; ++rank) {
+      SchedClosure([&, rank] {
+        CollectiveParams* cp = col_params[rank].get();
+        cp->instance.impl_details.subdiv_permutations.clear();
+        cp->subdiv_rank.clear();
+        TF_CHECK_OK(RunCollective(test_env.get(), cp, devices[rank],
+                                  &tensors[rank], &tensors[rank]));
+        counter.DecrementCount();
+      });
+    }
+    counter.Wait();
+  }
+  state.SetBytesProcessed(state.iterations() * num_elements * sizeof(float));
+}
+BENCHMARK(BM_RingReduce)
+    ->UseRealTime()
+    ->ArgNames({"devices", "bytes", "wire_dtype", "segments"})
+    ->Args({4, 1 << 20, DT_INVALID, 1})
+    ->Args({4, 1 << 24, DT_INVALID, 1})
+    ->Args({4, 1 << 24, DT_INVALID, 4})
+    ->Args({4, 1 << 24, DT_BFLOAT16, 1})
+    ->Args({4, 1 << 24, DT_BFLOAT16, 4})
+    ->Args({8, 1 << 24, DT_BFLOAT16, 4})
+    ->Args({8, 1 << 24, DT_HALF, 4});
+
 #if GOOGLE_CUDA || TENSORFLOW_USE_ROCM
 // GPU tests.  So long as the device names are all in a single tasks we
 // bypass inter-worker routing code and can fake multiple GPUs with a single
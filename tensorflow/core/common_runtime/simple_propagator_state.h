@@ -55,6 +55,7 @@ class SimplePropagatorState {
   struct TaggedNode {
     const NodeItem* node_item;
 
+    TaggedNode() : node_item(nullptr) {}
     explicit TaggedNode(const NodeItem* node_item) : node_item(node_item) {}
 
     const NodeItem& get_node_item() const { return *node_item; }
@@ -0,0 +1,372 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/static_memory_planner.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/util/env_var.h"
+
+namespace tensorflow {
+
+bool StaticMemoryPlanEnabled() {
+  static const bool enabled = [] {
+    bool enabled = false;
+    Status s = ReadBoolFromEnvVar("TF_EXECUTOR_USE_STATIC_MEMORY_PLAN",
+                                  /*default_val=*/false, &enabled);
+    if (!s.ok()) {
+      LOG(ERROR) << "Invalid TF_EXECUTOR_USE_STATIC_MEMORY_PLAN: " << s;
+      return false;
+    }
+    return enabled;
+  }();
+  return enabled;
+}
+
+namespace {
+
+// Every planned allocation starts at a multiple of this alignment.
+constexpr size_t kPlanAlignment = Allocator::kAllocatorAlignment;
+
+size_t RoundUpToPlanAlignment(size_t num_bytes) {
+  return (num_bytes + kPlanAlignment - 1) & ~(kPlanAlignment - 1);
+}
+
+// Returns the index of `offset` in the sorted `segment_offsets`, which must
+// contain it.
+int SegmentAt(const std::vector<size_t>& segment_offsets, size_t offset) {
+  return std::lower_bound(segment_offsets.begin(), segment_offsets.end(),
+                          offset) -
+         segment_offsets.begin();
+}
+
+}  // namespace
+
+constexpr int StaticMemoryPlanner::kNumRecordedSteps;
+
+StaticMemoryPlanner::StaticMemoryPlanner(Allocator* base, int num_nodes)
+    : base_(base), num_nodes_(num_nodes) {}
+
+StaticMemoryPlanner::~StaticMemoryPlanner() {
+  for (char* buffer : free_buffers_) {
+    base_->DeallocateRaw(buffer);
+  }
+}
+
+StaticMemoryPlanner::Step* StaticMemoryPlanner::StartStep(
+    StepArenaAllocator* fallback) {
+  Step::Mode mode = Step::Mode::kDynamic;
+  {
+    mutex_lock l(mu_);
+    if (state_ == State::kRecording &&
+        num_recording_steps_ < kNumRecordedSteps) {
+      ++num_recording_steps_;
+      mode = Step::Mode::kRecording;
+    } else if (state_ == State::kPlanned) {
+      mode = Step::Mode::kPlanned;
+    }
+  }
+  char* buffer = nullptr;
+  if (mode == Step::Mode::kPlanned) {
+    buffer = AcquireBuffer();
+    if (buffer == nullptr) mode = Step::Mode::kDynamic;
+  }
+  return new Step(shared_from_this(), fallback, mode, buffer);
+}
+
+bool StaticMemoryPlanner::HasPlan() {
+  mutex_lock l(mu_);
+  return state_ == State::kPlanned;
+}
+
+size_t StaticMemoryPlanner::PlannedBytes() {
+  mutex_lock l(mu_);
+  return state_ == State::kPlanned ? buffer_bytes_ : 0;
+}
+
+void StaticMemoryPlanner::AddRecording(std::vector<Record> records) {
+  mutex_lock l(mu_);
+  if (state_ != State::kRecording) return;
+  std::sort(records.begin(), records.end(),
+            [](const Record& a, const Record& b) {
+              return std::make_pair(a.node_id, a.ordinal) <
+                     std::make_pair(b.node_id, b.ordinal);
+            });
+  recordings_.push_back(std::move(records));
+  if (recordings_.size() == kNumRecordedSteps) {
+    BuildPlan();
+    recordings_.clear();
+  }
+}
+
+void StaticMemoryPlanner::BuildPlan() {
+  // The plan is only valid if every recorded step made the same allocations.
+  const std::vector<Record>& first = recordings_[0];
+  for (const std::vector<Record>& recording : recordings_) {
+    bool consistent = recording.size() == first.size();
+    for (size_t i = 0; consistent && i < recording.size(); ++i) {
+      consistent = recording[i].node_id == first[i].node_id &&
+                   recording[i].ordinal == first[i].ordinal &&
+                   recording[i].num_bytes == first[i].num_bytes;
+    }
+    if (!consistent) {
+      VLOG(1) << "Not planning step memory: allocations differ across steps";
+      state_ = State::kDisabled;
+      return;
+    }
+  }
+  if (first.empty()) {
+    state_ = State::kDisabled;
+    return;
+  }
+
+  // The lifetime of each allocation covers its lifetimes in all the recorded
+  // steps.
+  const int n = first.size();
+  std::vector<std::pair<int64, int64>> lifetimes(n);
+  for (int i = 0; i < n; ++i) {
+    lifetimes[i] = {first[i].alloc_tick, first[i].free_tick};
+    for (const std::vector<Record>& recording : recordings_) {
+      lifetimes[i].first = std::min(lifetimes[i].first, recording[i].alloc_tick);
+      lifetimes[i].second =
+          std::max(lifetimes[i].second, recording[i].free_tick);
+    }
+  }
+
+  // Place the allocations from the largest to the smallest, each at the lowest
+  // offset that does not overlap an already placed allocation whose lifetime
+  // overlaps its own.
+  std::vector<int> order(n);
+  for (int i = 0; i < n; ++i) order[i] = i;
+  std::stable_sort(order.begin(), order.end(), [&first](int a, int b) {
+    return first[a].num_bytes > first[b].num_bytes;
+  });
+  planned_allocations_.assign(n, PlannedAllocation());
+  std::vector<int> placed;
+  std::vector<std::pair<size_t, size_t>> conflicts;
+  buffer_bytes_ = 0;
+  for (int i : order) {
+    const size_t num_bytes = RoundUpToPlanAlignment(first[i].num_bytes);
+    conflicts.clear();
+    for (int j : placed) {
+      if (lifetimes[i].first <= lifetimes[j].second &&
+          lifetimes[j].first <= lifetimes[i].second) {
+        conflicts.emplace_back(planned_allocations_[j].offset,
+                               planned_allocations_[j].offset +
+                                   planned_allocations_[j].num_bytes);
+      }
+    }
+    std::sort(conflicts.begin(), conflicts.end());
+    size_t offset = 0;
+    for (const auto& conflict : conflicts) {
+      if (offset + num_bytes <= conflict.first) break;
+      offset = std::max(offset, conflict.second);
+    }
+    planned_allocations_[i].offset = offset;
+    planned_allocations_[i].num_bytes = num_bytes;
+    buffer_bytes_ = std::max(buffer_bytes_, offset + num_bytes);
+    placed.push_back(i);
+  }
+
+  // Cut the buffer at every offset where a planned allocation starts or ends,
+  // so that a step can tell which allocations share memory by the segments
+  // they cover, without comparing them with each other.
+  segment_offsets_.clear();
+  for (const PlannedAllocation& planned : planned_allocations_) {
+    segment_offsets_.push_back(planned.offset);
+    segment_offsets_.push_back(planned.offset + planned.num_bytes);
+  }
+  std::sort(segment_offsets_.begin(), segment_offsets_.end());
+  segment_offsets_.erase(
+      std::unique(segment_offsets_.begin(), segment_offsets_.end()),
+      segment_offsets_.end());
+  for (PlannedAllocation& planned : planned_allocations_) {
+    planned.first_segment = SegmentAt(segment_offsets_, planned.offset);
+    planned.end_segment =
+        SegmentAt(segment_offsets_, planned.offset + planned.num_bytes);
+  }
+  // The last offset is the end of the buffer, where no segment starts.
+  segment_offsets_.pop_back();
+
+  node_start_.assign(num_nodes_ + 1, 0);
+  for (const Record& record : first) {
+    ++node_start_[record.node_id + 1];
+  }
+  for (int i = 0; i < num_nodes_; ++i) {
+    node_start_[i + 1] += node_start_[i];
+  }
+  state_ = State::kPlanned;
+  VLOG(1) << "Planned " << n << " step-local allocations in a buffer of "
+          << buffer_bytes_ << " bytes";
+}
+
+char* StaticMemoryPlanner::AcquireBuffer() {
+  size_t buffer_bytes;
+  {
+    mutex_lock l(mu_);
+    if (!free_buffers_.empty()) {
+      char* buffer = free_buffers_.back();
+      free_buffers_.pop_back();
+      return buffer;
+    }
+    buffer_bytes = buffer_bytes_;
+  }
+  return static_cast<char*>(base_->AllocateRaw(
+      kPlanAlignment, buffer_bytes,
+      AllocationAttributes(/*retry_on_failure=*/false,
+                           /*allocation_will_be_logged=*/false, nullptr)));
+}
+
+void StaticMemoryPlanner::ReleaseBuffer(char* buffer) {
+  mutex_lock l(mu_);
+  free_buffers_.push_back(buffer);
+}
+
+StaticMemoryPlanner::Step::Step(std::shared_ptr<StaticMemoryPlanner> planner,
+                                StepArenaAllocator* fallback, Mode mode,
+                                char* buffer)
+    : planner_(std::move(planner)),
+      fallback_(fallback),
+      mode_(mode),
+      buffer_(buffer),
+      node_allocators_(new NodeAllocator[planner_->num_nodes_]) {
+  for (int i = 0; i < planner_->num_nodes_; ++i) {
+    node_allocators_[i].step_ = this;
+    node_allocators_[i].node_id_ = i;
+  }
+  if (mode_ == Mode::kPlanned) {
+    const int num_segments = planner_->segment_offsets_.size();
+    segment_owners_.reset(new std::atomic<int>[num_segments]);
+    for (int i = 0; i < num_segments; ++i) {
+      segment_owners_[i].store(-1, std::memory_order_relaxed);
+    }
+  }
+}
+
+StaticMemoryPlanner::Step::~Step() {
+  if (mode_ == Mode::kRecording) {
+    planner_->AddRecording(std::move(records_));
+  } else if (mode_ == Mode::kPlanned) {
+    planner_->ReleaseBuffer(buffer_);
+  }
+  fallback_->Release();
+}
+
+void* StaticMemoryPlanner::Step::Allocate(
+    int node_id, int ordinal, size_t alignment, size_t num_bytes,
+    const AllocationAttributes& allocation_attr) {
+  if (mode_ == Mode::kPlanned) {
+    char* ptr = AllocatePlanned(node_id, ordinal, alignment, num_bytes);
+    if (ptr != nullptr) {
+      num_refs_.fetch_add(1, std::memory_order_relaxed);
+      num_planned_hits_.fetch_add(1, std::memory_order_relaxed);
+      return ptr;
+    }
+  }
+  void* ptr = fallback_->AllocateRaw(alignment, num_bytes, allocation_attr);
+  if (ptr == nullptr) return nullptr;
+  num_refs_.fetch_add(1, std::memory_order_relaxed);
+  if (mode_ == Mode::kRecording) {
+    mutex_lock l(mu_);
+    live_records_[ptr] = records_.size();
+    records_.push_back({node_id, ordinal, num_bytes, next_tick_++, -1});
+  }
+  return ptr;
+}
+
+char* StaticMemoryPlanner::Step::AllocatePlanned(int node_id, int ordinal,
+                                                 size_t alignment,
+                                                 size_t num_bytes) {
+  const int index = planner_->node_start_[node_id] + ordinal;
+  if (alignment > kPlanAlignment ||
+      index >= planner_->node_start_[node_id + 1]) {
+    return nullptr;
+  }
+  const PlannedAllocation& planned = planner_->planned_allocations_[index];
+  // Empty allocations cover no segment, so they could not be told apart on
+  // deallocation.
+  if (num_bytes > planned.num_bytes || planned.num_bytes == 0) return nullptr;
+  // The plan lets allocations share memory if their recorded lifetimes are
+  // disjoint, but the nodes of this step may run in a different order. Claim
+  // the segments in increasing order, so that of two allocations that share
+  // memory, the one that claims their first common segment gets it.
+  for (int segment = planned.first_segment; segment < planned.end_segment;
+       ++segment) {
+    int owner = -1;
+    if (!segment_owners_[segment].compare_exchange_strong(
+            owner, index, std::memory_order_acquire,
+            std::memory_order_relaxed)) {
+      ReleaseSegments(planned.first_segment, segment);
+      return nullptr;
+    }
+  }
+  return buffer_ + planned.offset;
+}
+
+void StaticMemoryPlanner::Step::ReleaseSegments(int first_segment,
+                                                int end_segment) {
+  for (int segment = first_segment; segment < end_segment; ++segment) {
+    segment_owners_[segment].store(-1, std::memory_order_release);
+  }
+}
+
+void StaticMemoryPlanner::Step::Deallocate(void* ptr) {
+  char* p = static_cast<char*>(ptr);
+  if (mode_ == Mode::kPlanned && p >= buffer_ &&
+      p < buffer_ + planner_->buffer_bytes_) {
+    // The live allocation at this offset owns the segment starting there.
+    const int index =
+        segment_owners_[SegmentAt(planner_->segment_offsets_, p - buffer_)]
+            .load(std::memory_order_relaxed);
+    DCHECK_GE(index, 0);
+    const PlannedAllocation& planned = planner_->planned_allocations_[index];
+    ReleaseSegments(planned.first_segment, planned.end_segment);
+  } else {
+    if (mode_ == Mode::kRecording) {
+      mutex_lock l(mu_);
+      auto it = live_records_.find(ptr);
+      DCHECK(it != live_records_.end());
+      records_[it->second].free_tick = next_tick_++;
+      live_records_.erase(it);
+    }
+    fallback_->DeallocateRaw(ptr);
+  }
+  Unref();
+}
+
+void StaticMemoryPlanner::Step::Unref() {
+  if (num_refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    delete this;
+  }
+}
+
+StaticMemoryPlanner::Step::Stats StaticMemoryPlanner::Step::GetStats() {
+  Stats stats;
+  stats.num_planned_hits = num_planned_hits_.load(std::memory_order_relaxed);
+  if (mode_ == Mode::kPlanned) {
+    stats.planned_bytes = planner_->buffer_bytes_;
+  }
+  return stats;
+}
+
+StepArenaAllocator::Stats StaticMemoryPlanner::Step::GetFallbackStats() {
+  return fallback_->GetArenaStats();
+}
+
+void StaticMemoryPlanner::Step::Release() { Unref(); }
+
+}  // namespace tensorflow
@@ -0,0 +1,226 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_STATIC_MEMORY_PLANNER_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_STATIC_MEMORY_PLANNER_H_
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "tensorflow/core/common_runtime/step_arena_allocator.h"
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+// Returns true if executors should serve the tensors that do not escape a step
+// from a static memory plan. Controlled by the
+// TF_EXECUTOR_USE_STATIC_MEMORY_PLAN environment variable, and false by
+// default.
+bool StaticMemoryPlanEnabled();
+
+// Plans the memory of the step-local tensors of an executor.
+//
+// When every node of a graph runs exactly once per step, the kernel of a node
+// makes the same sequence of allocations on every step as long as the shapes
+// of its tensors do not change. StaticMemoryPlanner records these allocations,
+// identified by node and sequence number, along with their lifetimes over the
+// first few steps. It then assigns each of them a fixed offset in a single
+// buffer, such that allocations with overlapping lifetimes never share memory,
+// using the greedy-by-size strategy of TF Lite's ArenaPlanner.
+//
+// Later steps serve the planned allocations from such a buffer. Allocations
+// that do not match the plan, for instance because a shape changed, or whose
+// memory is still in use because the nodes ran in a different order, fall back
+// to dynamic allocation from a StepArenaAllocator.
+class StaticMemoryPlanner
+    : public std::enable_shared_from_this<StaticMemoryPlanner> {
+ public:
+  class Step;
+
+  // Number of steps that are recorded before a plan is made.
+  static constexpr int kNumRecordedSteps = 3;
+
+  // `base` provides the planned buffers and must outlive this object.
+  // `num_nodes` is the number of nodes of the executor graph.
+  StaticMemoryPlanner(Allocator* base, int num_nodes);
+  ~StaticMemoryPlanner();
+
+  // Returns the allocator for a new step. The step takes ownership of
+  // `fallback`, which serves the allocations that are not part of the plan.
+  Step* StartStep(StepArenaAllocator* fallback);
+
+  // Returns true once a plan has been made.
+  bool HasPlan();
+
+  // Returns the size of the planned buffer, or 0 if there is no plan yet.
+  size_t PlannedBytes();
+
+ private:
+  // An allocation of a recorded step. Ticks count allocation and deallocation
+  // events within the step.
+  struct Record {
+    int node_id;
+    int ordinal;
+    size_t num_bytes;
+    int64 alloc_tick;
+    int64 free_tick;
+  };
+
+  // An allocation of the plan. Its memory covers the segments
+  // [first_segment, end_segment) of the buffer.
+  struct PlannedAllocation {
+    size_t offset;
+    size_t num_bytes;
+    int first_segment;
+    int end_segment;
+  };
+
+  enum class State { kRecording, kPlanned, kDisabled };
+
+  void AddRecording(std::vector<Record> records);
+  void BuildPlan() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  char* AcquireBuffer();
+  void ReleaseBuffer(char* buffer);
+
+  Allocator* const base_;  // Not owned.
+  const int num_nodes_;
+
+  mutex mu_;
+  State state_ TF_GUARDED_BY(mu_) = State::kRecording;
+  // Number of recording steps that were started, and recordings received.
+  int num_recording_steps_ TF_GUARDED_BY(mu_) = 0;
+  std::vector<std::vector<Record>> recordings_ TF_GUARDED_BY(mu_);
+  // Buffers that are not used by a running step.
+  std::vector<char*> free_buffers_ TF_GUARDED_BY(mu_);
+
+  // The plan, immutable once `state_` is kPlanned. The allocations of node
+  // `n` are at indices [node_start_[n], node_start_[n + 1]) of
+  // `planned_allocations_`. The offsets at which planned allocations start or
+  // end cut the buffer into segments; segment `i` starts at
+  // `segment_offsets_[i]`. Two planned allocations share memory iff they
+  // cover a common segment.
+  std::vector<PlannedAllocation> planned_allocations_;
+  std::vector<size_t> segment_offsets_;
+  std::vector<int> node_start_;
+  size_t buffer_bytes_ = 0;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(StaticMemoryPlanner);
+};
+
+// The allocator of one step of an executor using a StaticMemoryPlanner.
+//
+// Like StepArenaAllocator, a Step deletes itself once `Release()` has been
+// called and all of its allocations have been deallocated.
+class StaticMemoryPlanner::Step {
+ public:
+  // Usage counters of a step.
+  struct Stats {
+    // Number of allocations served from the planned buffer.
+    int64 num_planned_hits = 0;
+    // Size of the planned buffer, or 0 if the step did not use a plan.
+    int64 planned_bytes = 0;
+  };
+
+  // Returns the allocator through which the kernel of node `node_id` makes
+  // its step-local allocations. Must be used for a single execution of the
+  // node.
+  Allocator* ForNode(int node_id) { return &node_allocators_[node_id]; }
+
+  // Returns the counters of this step, and those of its fallback arena.
+  Stats GetStats();
+  StepArenaAllocator::Stats GetFallbackStats();
+
+  // Called by the owner once no further allocations will be made.
+  void Release();
+
+ private:
+  friend class StaticMemoryPlanner;
+
+  enum class Mode { kRecording, kPlanned, kDynamic };
+
+  // Identifies the allocations that a node makes by their order.
+  class NodeAllocator : public Allocator {
+   public:
+    std::string Name() override { return "static_memory_plan"; }
+    void* AllocateRaw(size_t alignment, size_t num_bytes) override {
+      return AllocateRaw(alignment, num_bytes, AllocationAttributes());
+    }
+    void* AllocateRaw(size_t alignment, size_t num_bytes,
+                      const AllocationAttributes& allocation_attr) override {
+      return step_->Allocate(node_id_, next_ordinal_.fetch_add(1), alignment,
+                             num_bytes, allocation_attr);
+    }
+    void DeallocateRaw(void* ptr) override { step_->Deallocate(ptr); }
+
+   private:
+    friend class Step;
+    Step* step_ = nullptr;
+    int node_id_ = -1;
+    std::atomic<int> next_ordinal_{0};
+  };
+
+  Step(std::shared_ptr<StaticMemoryPlanner> planner,
+       StepArenaAllocator* fallback, Mode mode, char* buffer);
+  ~Step();
+
+  void* Allocate(int node_id, int ordinal, size_t alignment, size_t num_bytes,
+                 const AllocationAttributes& allocation_attr);
+  void Deallocate(void* ptr);
+
+  // Returns the planned memory for the given allocation if it is available,
+  // and nullptr otherwise.
+  char* AllocatePlanned(int node_id, int ordinal, size_t alignment,
+                        size_t num_bytes);
+  // Makes the segments [first_segment, end_segment) available again.
+  void ReleaseSegments(int first_segment, int end_segment);
+
+  // Drops a reference, and deletes this step if it was the last one.
+  void Unref();
+
+  const std::shared_ptr<StaticMemoryPlanner> planner_;
+  StepArenaAllocator* const fallback_;
+  const Mode mode_;
+  // The planned buffer if `mode_` is kPlanned.
+  char* const buffer_;
+  std::unique_ptr<NodeAllocator[]> node_allocators_;
+
+  // One reference per live allocation, plus one until `Release()`.
+  std::atomic<int64> num_refs_{1};
+  std::atomic<int64> num_planned_hits_{0};
+  // kPlanned: the index of the live planned allocation that covers each
+  // segment of the buffer, or -1.
+  std::unique_ptr<std::atomic<int>[]> segment_owners_;
+
+  mutex mu_;
+  // kRecording: the allocations made so far, and the index of the record of
+  // every live allocation.
+  int64 next_tick_ TF_GUARDED_BY(mu_) = 0;
+  std::vector<Record> records_ TF_GUARDED_BY(mu_);
+  absl::flat_hash_map<const void*, int> live_records_ TF_GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(Step);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_STATIC_MEMORY_PLANNER_H_
@@ -0,0 +1,218 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/static_memory_planner.h"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/blocking_counter.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+constexpr size_t kAlignment = Allocator::kAllocatorAlignment;
+
+StaticMemoryPlanner::Step* StartStep(StaticMemoryPlanner* planner) {
+  return planner->StartStep(new StepArenaAllocator(
+      cpu_allocator(), StepArenaAllocator::kDefaultInitialBlockBytes,
+      StepArenaAllocator::kDefaultMaxBytes));
+}
+
+// Runs a chain of nodes in which node i allocates an output of `sizes[i]`
+// bytes from `allocators(i)`, and each output is freed once the next node has
+// run. Stores the output addresses in `ptrs` if it is not null.
+template <typename AllocatorFn>
+void RunChain(AllocatorFn allocators, const std::vector<size_t>& sizes,
+              std::vector<char*>* ptrs) {
+  char* prev = nullptr;
+  Allocator* prev_allocator = nullptr;
+  if (ptrs) ptrs->clear();
+  for (int i = 0; i < sizes.size(); ++i) {
+    Allocator* a = allocators(i);
+    char* out = static_cast<char*>(a->AllocateRaw(kAlignment, sizes[i]));
+    CHECK(out != nullptr);
+    std::fill(out, out + sizes[i], static_cast<char>(i));
+    if (prev) {
+      CHECK_EQ(prev[0], static_cast<char>(i - 1));
+      prev_allocator->DeallocateRaw(prev);
+    }
+    if (ptrs) ptrs->push_back(out);
+    prev = out;
+    prev_allocator = a;
+  }
+  prev_allocator->DeallocateRaw(prev);
+}
+
+// Runs a chain of nodes as a step of `planner`, and returns the number of
+// planned allocations.
+int64 RunChainStep(StaticMemoryPlanner* planner,
+                   const std::vector<size_t>& sizes,
+                   std::vector<char*>* ptrs = nullptr) {
+  StaticMemoryPlanner::Step* step = StartStep(planner);
+  RunChain([step](int i) { return step->ForNode(i); }, sizes, ptrs);
+  const int64 num_planned_hits = step->GetStats().num_planned_hits;
+  step->Release();
+  return num_planned_hits;
+}
+
+TEST(StaticMemoryPlannerTest, PlansAfterRecordedSteps) {
+  auto planner = std::make_shared<StaticMemoryPlanner>(cpu_allocator(), 3);
+  const std::vector<size_t> sizes = {1000, 2000, 100};
+  for (int i = 0; i < StaticMemoryPlanner::kNumRecordedSteps; ++i) {
+    EXPECT_FALSE(planner->HasPlan());
+    EXPECT_EQ(RunChainStep(planner.get(), sizes), 0);
+  }
+  ASSERT_TRUE(planner->HasPlan());
+  // Only two outputs are live at any time: node 1's output is placed first,
+  // and nodes 0 and 2 share the memory after it.
+  EXPECT_EQ(planner->PlannedBytes(), 2048 + 1024);
+
+  std::vector<char*> ptrs;
+  EXPECT_EQ(RunChainStep(planner.get(), sizes, &ptrs), 3);
+  EXPECT_EQ(ptrs[0], ptrs[2]);
+  EXPECT_EQ(ptrs[1] + 2048, ptrs[0]);
+}
+
+TEST(StaticMemoryPlannerTest, FallsBackWhenShapesChange) {
+  auto planner = std::make_shared<StaticMemoryPlanner>(cpu_allocator(), 3);
+  for (int i = 0; i < StaticMemoryPlanner::kNumRecordedSteps; ++i) {
+    RunChainStep(planner.get(), {1000, 2000, 100});
+  }
+  ASSERT_TRUE(planner->HasPlan());
+  // Smaller allocations still fit in the plan, larger ones do not.
+  EXPECT_EQ(RunChainStep(planner.get(), {500, 4000, 100}), 2);
+}
+
+TEST(StaticMemoryPlannerTest, FallsBackWhenPlannedMemoryIsInUse) {
+  auto planner = std::make_shared<StaticMemoryPlanner>(cpu_allocator(), 3);
+  for (int i = 0; i < StaticMemoryPlanner::kNumRecordedSteps; ++i) {
+    RunChainStep(planner.get(), {1000, 2000, 100});
+  }
+  ASSERT_TRUE(planner->HasPlan());
+
+  // Node 0's output is still alive when node 2 runs, so node 2 cannot use the
+  // memory it shares with it.
+  StaticMemoryPlanner::Step* step = StartStep(planner.get());
+  void* p0 = step->ForNode(0)->AllocateRaw(kAlignment, 1000);
+  void* p1 = step->ForNode(1)->AllocateRaw(kAlignment, 2000);
+  void* p2 = step->ForNode(2)->AllocateRaw(kAlignment, 100);
+  EXPECT_NE(p0, p2);
+  EXPECT_EQ(step->GetStats().num_planned_hits, 2);
+  EXPECT_EQ(step->GetFallbackStats().num_hits, 1);
+  step->ForNode(0)->DeallocateRaw(p0);
+  step->ForNode(1)->DeallocateRaw(p1);
+  step->ForNode(2)->DeallocateRaw(p2);
+  step->Release();
+}
+
+TEST(StaticMemoryPlannerTest, ConcurrentAllocationsDoNotShareMemory) {
+  auto planner = std::make_shared<StaticMemoryPlanner>(cpu_allocator(), 3);
+  for (int i = 0; i < StaticMemoryPlanner::kNumRecordedSteps; ++i) {
+    RunChainStep(planner.get(), {1000, 2000, 100});
+  }
+  ASSERT_TRUE(planner->HasPlan());
+
+  // Nodes 0 and 2 are planned to share memory. When they allocate at the same
+  // time, exactly one of them gets the planned memory.
+  thread::ThreadPool pool(Env::Default(), "test", 2);
+  for (int i = 0; i < 100; ++i) {
+    StaticMemoryPlanner::Step* step = StartStep(planner.get());
+    void* p0 = nullptr;
+    void* p2 = nullptr;
+    BlockingCounter counter(2);
+    pool.Schedule([&]() {
+      p0 = step->ForNode(0)->AllocateRaw(kAlignment, 1000);
+      counter.DecrementCount();
+    });
+    pool.Schedule([&]() {
+      p2 = step->ForNode(2)->AllocateRaw(kAlignment, 100);
+      counter.DecrementCount();
+    });
+    counter.Wait();
+    EXPECT_NE(p0, p2);
+    EXPECT_EQ(step->GetStats().num_planned_hits, 1);
+    step->ForNode(0)->DeallocateRaw(p0);
+    step->ForNode(2)->DeallocateRaw(p2);
+    step->Release();
+  }
+}
+
+TEST(StaticMemoryPlannerTest, DoesNotPlanInconsistentSteps) {
+  auto planner = std::make_shared<StaticMemoryPlanner>(cpu_allocator(), 3);
+  RunChainStep(planner.get(), {1000, 2000, 100});
+  RunChainStep(planner.get(), {1000, 3000, 100});
+  RunChainStep(planner.get(), {1000, 2000, 100});
+  EXPECT_FALSE(planner->HasPlan());
+  EXPECT_EQ(RunChainStep(planner.get(), {1000, 2000, 100}), 0);
+}
+
+TEST(StaticMemoryPlannerTest, StepOutlivesRelease) {
+  auto planner = std::make_shared<StaticMemoryPlanner>(cpu_allocator(), 1);
+  for (int i = 0; i < StaticMemoryPlanner::kNumRecordedSteps; ++i) {
+    RunChainStep(planner.get(), {64});
+  }
+  ASSERT_TRUE(planner->HasPlan());
+  StaticMemoryPlanner::Step* step = StartStep(planner.get());
+  Allocator* a = step->ForNode(0);
+  void* p = a->AllocateRaw(kAlignment, 64);
+  step->Release();
+  // Dropping the planner while a step is still alive keeps the buffer valid.
+  planner.reset();
+  static_cast<char*>(p)[63] = 1;
+  a->DeallocateRaw(p);
+}
+
+// Runs steps of a chain of nodes with outputs of various sizes, either from a
+// static memory plan or from a step arena alone.
+void BM_ChainSteps(::testing::benchmark::State& state) {
+  const bool use_plan = state.range(0);
+  constexpr int kNumNodes = 64;
+  std::vector<size_t> sizes(kNumNodes);
+  for (int i = 0; i < kNumNodes; ++i) {
+    sizes[i] = 256 * (1 + i % 8);
+  }
+  auto planner =
+      std::make_shared<StaticMemoryPlanner>(cpu_allocator(), kNumNodes);
+  if (use_plan) {
+    for (int i = 0; i < StaticMemoryPlanner::kNumRecordedSteps; ++i) {
+      RunChainStep(planner.get(), sizes);
+    }
+    CHECK(planner->HasPlan());
+  }
+  for (auto s : state) {
+    if (use_plan) {
+      RunChainStep(planner.get(), sizes);
+    } else {
+      auto* arena = new StepArenaAllocator(
+          cpu_allocator(), StepArenaAllocator::kDefaultInitialBlockBytes,
+          StepArenaAllocator::kDefaultMaxBytes);
+      RunChain([arena](int i) { return arena; }, sizes, nullptr);
+      arena->Release();
+    }
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                          kNumNodes);
+}
+BENCHMARK(BM_ChainSteps)->Arg(0)->Arg(1);
+
+}  // namespace
+}  // namespace tensorflow
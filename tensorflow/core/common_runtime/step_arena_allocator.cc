@@ -0,0 +1,153 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/step_arena_allocator.h"
+
+#include <algorithm>
+
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/util/env_var.h"
+
+namespace tensorflow {
+
+bool StepArenaAllocatorEnabled() {
+  static const bool enabled = [] {
+    bool enabled = false;
+    Status s = ReadBoolFromEnvVar("TF_EXECUTOR_USE_STEP_ARENA",
+                                  /*default_val=*/false, &enabled);
+    if (!s.ok()) {
+      LOG(ERROR) << "Invalid TF_EXECUTOR_USE_STEP_ARENA: " << s;
+      return false;
+    }
+    return enabled;
+  }();
+  return enabled;
+}
+
+constexpr size_t StepArenaAllocator::kDefaultInitialBlockBytes;
+constexpr size_t StepArenaAllocator::kDefaultMaxBytes;
+
+StepArenaAllocator::StepArenaAllocator(Allocator* base,
+                                       size_t initial_block_bytes,
+                                       size_t max_bytes)
+    : base_(base),
+      max_bytes_(max_bytes),
+      next_block_bytes_(std::min(initial_block_bytes, max_bytes)) {}
+
+StepArenaAllocator::~StepArenaAllocator() {
+  for (const Block& block : blocks_) {
+    base_->DeallocateRaw(block.base);
+  }
+}
+
+void* StepArenaAllocator::AllocateRaw(
+    size_t alignment, size_t num_bytes,
+    const AllocationAttributes& allocation_attr) {
+  {
+    mutex_lock l(mu_);
+    DCHECK(!released_);
+    // Large requests gain little from the arena and would quickly exhaust its
+    // budget, so only small and moderately sized ones are served from it.
+    if (alignment <= Allocator::kAllocatorAlignment && num_bytes > 0 &&
+        num_bytes <= max_bytes_ / 4) {
+      char* ptr = reinterpret_cast<char*>(
+          (reinterpret_cast<uintptr_t>(free_start_) + alignment - 1) &
+          ~(alignment - 1));
+      if (free_start_ == nullptr || ptr + num_bytes > free_end_) {
+        ptr = AddBlock(num_bytes) ? free_start_ : nullptr;
+      }
+      if (ptr != nullptr) {
+        free_start_ = ptr + num_bytes;
+        ++live_allocations_;
+        ++stats_.num_hits;
+        stats_.bytes_allocated += num_bytes;
+        return ptr;
+      }
+    }
+    ++stats_.num_fallbacks;
+  }
+  void* ptr = base_->AllocateRaw(alignment, num_bytes, allocation_attr);
+  if (ptr != nullptr) {
+    mutex_lock l(mu_);
+    ++live_allocations_;
+  }
+  return ptr;
+}
+
+void StepArenaAllocator::DeallocateRaw(void* ptr) {
+  bool delete_self = false;
+  {
+    mutex_lock l(mu_);
+    if (!InBlocks(ptr)) {
+      base_->DeallocateRaw(ptr);
+    }
+    --live_allocations_;
+    DCHECK_GE(live_allocations_, 0);
+    delete_self = released_ && live_allocations_ == 0;
+  }
+  if (delete_self) {
+    delete this;
+  }
+}
+
+StepArenaAllocator::Stats StepArenaAllocator::GetArenaStats() {
+  mutex_lock l(mu_);
+  return stats_;
+}
+
+void StepArenaAllocator::Release() {
+  bool delete_self = false;
+  {
+    mutex_lock l(mu_);
+    DCHECK(!released_);
+    released_ = true;
+    delete_self = live_allocations_ == 0;
+    if (!delete_self) {
+      VLOG(2) << "Step arena released with " << live_allocations_
+              << " live allocations";
+    }
+  }
+  if (delete_self) {
+    delete this;
+  }
+}
+
+bool StepArenaAllocator::InBlocks(const void* ptr) const {
+  const char* p = static_cast<const char*>(ptr);
+  // Blocks grow geometrically, so there are only a handful of them and the
+  // most recent ones are the largest.
+  for (auto it = blocks_.rbegin(); it != blocks_.rend(); ++it) {
+    if (p >= it->base && p < it->base + it->size) return true;
+  }
+  return false;
+}
+
+bool StepArenaAllocator::AddBlock(size_t num_bytes) {
+  const size_t block_bytes = std::max(next_block_bytes_, num_bytes);
+  if (stats_.bytes_reserved + block_bytes > max_bytes_) return false;
+  char* block = static_cast<char*>(base_->AllocateRaw(
+      Allocator::kAllocatorAlignment, block_bytes,
+      AllocationAttributes(/*retry_on_failure=*/false,
+                           /*allocation_will_be_logged=*/false, nullptr)));
+  if (block == nullptr) return false;
+  blocks_.push_back({block, block_bytes});
+  free_start_ = block;
+  free_end_ = block + block_bytes;
+  next_block_bytes_ = block_bytes * 2;
+  stats_.bytes_reserved += block_bytes;
+  return true;
+}
+
+}  // namespace tensorflow
@@ -0,0 +1,126 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_STEP_ARENA_ALLOCATOR_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_STEP_ARENA_ALLOCATOR_H_
+
+#include <string>
+
+#include "absl/container/inlined_vector.h"
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+// Returns true if executors should serve tensors that do not escape a step
+// from a StepArenaAllocator. Controlled by the TF_EXECUTOR_USE_STEP_ARENA
+// environment variable, and false by default.
+bool StepArenaAllocatorEnabled();
+
+// A step-scoped bump allocator in the spirit of core::Arena.
+//
+// An executor creates one StepArenaAllocator per step and uses it for the
+// tensors that it has proven do not outlive the step. Allocations are carved
+// from a few large blocks obtained from the `base` allocator and are never
+// freed individually. Requests that the arena cannot serve (because they are
+// too large, over-aligned, or would exceed `max_bytes`) fall back to `base`.
+//
+// At the end of the step the executor calls `Release()`. All blocks are
+// returned to `base` as soon as the last outstanding allocation has been
+// deallocated, so a tensor that escapes the step by mistake keeps the arena
+// alive instead of dangling. As with TrackingAllocator, the object deletes
+// itself at that point.
+class StepArenaAllocator : public Allocator {
+ public:
+  // Counters describing how the arena was used during a step.
+  struct Stats {
+    // Number of allocations served from the arena blocks.
+    int64 num_hits = 0;
+    // Number of allocations that were forwarded to the base allocator.
+    int64 num_fallbacks = 0;
+    // Total number of bytes served from the arena blocks.
+    int64 bytes_allocated = 0;
+    // Total size of the blocks obtained from the base allocator.
+    int64 bytes_reserved = 0;
+  };
+
+  // Does not take ownership of `base`, which must outlive this object. The
+  // first block has `initial_block_bytes` bytes and each further block doubles
+  // in size, up to a total of `max_bytes`.
+  StepArenaAllocator(Allocator* base, size_t initial_block_bytes,
+                     size_t max_bytes);
+
+  std::string Name() override { return "step_arena"; }
+  void* AllocateRaw(size_t alignment, size_t num_bytes) override {
+    return AllocateRaw(alignment, num_bytes, AllocationAttributes());
+  }
+  void* AllocateRaw(size_t alignment, size_t num_bytes,
+                    const AllocationAttributes& allocation_attr) override;
+  void DeallocateRaw(void* ptr) override;
+
+  // Returns the usage counters accumulated so far.
+  Stats GetArenaStats();
+
+  // Called by the owner once no further allocations will be made. Afterwards
+  // the object must not be used by the caller; it deletes itself once every
+  // outstanding allocation has been deallocated.
+  void Release();
+
+  // Default size of the first block of an arena.
+  static constexpr size_t kDefaultInitialBlockBytes = 256 << 10;
+  // Default upper bound on the total size of the blocks of an arena.
+  static constexpr size_t kDefaultMaxBytes = 64 << 20;
+
+ protected:
+  ~StepArenaAllocator() override;
+
+ private:
+  struct Block {
+    char* base;
+    size_t size;
+  };
+
+  // Returns true if `ptr` points into one of the arena blocks.
+  bool InBlocks(const void* ptr) const TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Allocates a new block that can hold at least `num_bytes` and makes it the
+  // current block. Returns false if the arena budget does not allow it or the
+  // base allocator fails.
+  bool AddBlock(size_t num_bytes) TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  Allocator* const base_;  // Not owned.
+  const size_t max_bytes_;
+
+  mutex mu_;
+  // The blocks obtained from `base_`, the last one being the current block.
+  absl::InlinedVector<Block, 4> blocks_ TF_GUARDED_BY(mu_);
+  char* free_start_ TF_GUARDED_BY(mu_) = nullptr;
+  char* free_end_ TF_GUARDED_BY(mu_) = nullptr;
+  size_t next_block_bytes_ TF_GUARDED_BY(mu_);
+  // Number of allocations, served from the blocks or by `base_`, that have
+  // not been deallocated yet.
+  int64 live_allocations_ TF_GUARDED_BY(mu_) = 0;
+  bool released_ TF_GUARDED_BY(mu_) = false;
+  Stats stats_ TF_GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(StepArenaAllocator);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_STEP_ARENA_ALLOCATOR_H_
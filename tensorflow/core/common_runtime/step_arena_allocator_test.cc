@@ -0,0 +1,161 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/step_arena_allocator.h"
+
+#include <vector>
+
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+// Forwards to the CPU allocator and counts the outstanding allocations.
+class CountingAllocator : public Allocator {
+ public:
+  std::string Name() override { return "counting"; }
+  void* AllocateRaw(size_t alignment, size_t num_bytes) override {
+    ++num_live_;
+    return cpu_allocator()->AllocateRaw(alignment, num_bytes);
+  }
+  void DeallocateRaw(void* ptr) override {
+    --num_live_;
+    cpu_allocator()->DeallocateRaw(ptr);
+  }
+  int num_live() const { return num_live_; }
+
+ private:
+  int num_live_ = 0;
+};
+
+TEST(StepArenaAllocatorTest, ServesSmallAllocationsFromOneBlock) {
+  CountingAllocator base;
+  auto* arena = new StepArenaAllocator(&base, 1 << 12, 1 << 20);
+  std::vector<void*> ptrs;
+  for (int i = 0; i < 16; ++i) {
+    void* p = arena->AllocateRaw(Allocator::kAllocatorAlignment, 100);
+    ASSERT_NE(p, nullptr);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(p) % Allocator::kAllocatorAlignment,
+              0);
+    ptrs.push_back(p);
+  }
+  EXPECT_EQ(base.num_live(), 1);
+  StepArenaAllocator::Stats stats = arena->GetArenaStats();
+  EXPECT_EQ(stats.num_hits, 16);
+  EXPECT_EQ(stats.num_fallbacks, 0);
+  EXPECT_EQ(stats.bytes_allocated, 1600);
+  EXPECT_EQ(stats.bytes_reserved, 1 << 12);
+  for (void* p : ptrs) {
+    arena->DeallocateRaw(p);
+  }
+  arena->Release();
+  EXPECT_EQ(base.num_live(), 0);
+}
+
+TEST(StepArenaAllocatorTest, GrowsGeometrically) {
+  CountingAllocator base;
+  auto* arena = new StepArenaAllocator(&base, 1 << 10, 1 << 20);
+  std::vector<void*> ptrs;
+  for (int i = 0; i < 7; ++i) {
+    ptrs.push_back(arena->AllocateRaw(Allocator::kAllocatorAlignment, 1 << 10));
+  }
+  // Blocks of 1, 2 and 4 KiB.
+  EXPECT_EQ(base.num_live(), 3);
+  EXPECT_EQ(arena->GetArenaStats().bytes_reserved, 7 << 10);
+  for (void* p : ptrs) {
+    arena->DeallocateRaw(p);
+  }
+  arena->Release();
+  EXPECT_EQ(base.num_live(), 0);
+}
+
+TEST(StepArenaAllocatorTest, FallsBackToBaseAllocator) {
+  CountingAllocator base;
+  auto* arena = new StepArenaAllocator(&base, 1 << 12, 1 << 16);
+  // Too large for the arena.
+  void* large = arena->AllocateRaw(Allocator::kAllocatorAlignment, 1 << 15);
+  // Over-aligned.
+  void* aligned = arena->AllocateRaw(4096, 64);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(aligned) % 4096, 0);
+  EXPECT_EQ(base.num_live(), 2);
+  // Exhausts the budget after a few blocks.
+  std::vector<void*> ptrs;
+  for (int i = 0; i < 8; ++i) {
+    ptrs.push_back(arena->AllocateRaw(Allocator::kAllocatorAlignment, 1 << 13));
+  }
+  StepArenaAllocator::Stats stats = arena->GetArenaStats();
+  EXPECT_EQ(stats.num_hits + stats.num_fallbacks, 10);
+  EXPECT_GT(stats.num_hits, 0);
+  EXPECT_LE(stats.bytes_reserved, 1 << 16);
+
+  arena->DeallocateRaw(large);
+  arena->DeallocateRaw(aligned);
+  for (void* p : ptrs) {
+    arena->DeallocateRaw(p);
+  }
+  arena->Release();
+  EXPECT_EQ(base.num_live(), 0);
+}
+
+TEST(StepArenaAllocatorTest, ReleaseWaitsForLiveAllocations) {
+  CountingAllocator base;
+  auto* arena = new StepArenaAllocator(&base, 1 << 12, 1 << 20);
+  Tensor escaped;
+  {
+    Tensor t(arena, DT_FLOAT, TensorShape({16}));
+    t.flat<float>().setConstant(1.0f);
+    escaped = t;
+  }
+  arena->Release();
+  // The tensor that outlived the step still owns valid memory.
+  EXPECT_EQ(base.num_live(), 1);
+  EXPECT_EQ(escaped.flat<float>()(15), 1.0f);
+  escaped = Tensor();
+  EXPECT_EQ(base.num_live(), 0);
+}
+
+// Allocates and frees a number of small temporaries, as the kernels of a
+// small-batch inference step do.
+void BM_StepAllocations(::testing::benchmark::State& state) {
+  const bool use_arena = state.range(0);
+  constexpr int kAllocationsPerStep = 256;
+  Allocator* base = cpu_allocator();
+  std::vector<void*> ptrs(kAllocationsPerStep);
+  for (auto s : state) {
+    StepArenaAllocator* arena =
+        use_arena ? new StepArenaAllocator(
+                        base, StepArenaAllocator::kDefaultInitialBlockBytes,
+                        StepArenaAllocator::kDefaultMaxBytes)
+                  : nullptr;
+    Allocator* a = use_arena ? arena : base;
+    for (int i = 0; i < kAllocationsPerStep; ++i) {
+      ptrs[i] =
+          a->AllocateRaw(Allocator::kAllocatorAlignment, 64 + (i % 16) * 64);
+    }
+    for (int i = 0; i < kAllocationsPerStep; ++i) {
+      a->DeallocateRaw(ptrs[i]);
+    }
+    if (arena) arena->Release();
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                          kAllocationsPerStep);
+}
+BENCHMARK(BM_StepAllocations)->Arg(0)->Arg(1);
+
+}  // namespace
+}  // namespace tensorflow
@@ -511,6 +511,27 @@ string StepStatsCollector::ReportAllocsOnResourceExhausted(const string& err) {
   return report;
 }
 
+void StepStatsCollector::SaveStepArenaStats(const string& device,
+                                            const StepArenaStats& stats) {
+  mutex_lock l(mu_);
+  if (finalized_) {
+    LOG(WARNING) << "step arena stats saved after finalize will not be "
+                    "collected.";
+  }
+  StepArenaStats& device_stats = step_arena_stats_[device];
+  device_stats.set_num_hits(device_stats.num_hits() + stats.num_hits());
+  device_stats.set_num_fallbacks(device_stats.num_fallbacks() +
+                                 stats.num_fallbacks());
+  device_stats.set_bytes_allocated(device_stats.bytes_allocated() +
+                                   stats.bytes_allocated());
+  device_stats.set_bytes_reserved(device_stats.bytes_reserved() +
+                                  stats.bytes_reserved());
+  device_stats.set_num_planned_hits(device_stats.num_planned_hits() +
+                                    stats.num_planned_hits());
+  device_stats.set_planned_bytes(device_stats.planned_bytes() +
+                                 stats.planned_bytes());
+}
+
 void StepStatsCollector::Finalize() {
   mutex_lock l(mu_);
   FinalizeInternal();
@@ -555,5 +576,14 @@ void StepStatsCollector::FinalizeInternal() {
       (*dss->mutable_thread_names())[thread_name.first] = thread_name.second;
     }
   }
+  for (const auto& device_arena : step_arena_stats_) {
+    if (dev_stats_pb.find(device_arena.first) == dev_stats_pb.end()) {
+      DeviceStepStats* ndev_stat = step_stats_->add_dev_stats();
+      ndev_stat->set_device(device_arena.first);
+      dev_stats_pb[device_arena.first] = ndev_stat;
+    }
+    *dev_stats_pb.at(device_arena.first)->mutable_step_arena_stats() =
+        device_arena.second;
+  }
 }
 }  // namespace tensorflow
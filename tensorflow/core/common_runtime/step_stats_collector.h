@@ -148,6 +148,12 @@ class StepStatsCollectorInterface {
   // "ResourceExhaustedError: OOM when allocating tensor ...
   // on /job:localhost/replica:0/task:0/device:GPU:0 by allocator GPU_0_bfc"
   virtual string ReportAllocsOnResourceExhausted(const string& err) = 0;
+
+  // Records the usage of the step arena of an executor running on `device`.
+  // Usage reported by several executors of the same device is summed. The
+  // default implementation drops the stats.
+  virtual void SaveStepArenaStats(const string& device,
+                                  const StepArenaStats& stats) {}
 };
 
 // StepStatsCollector manages the collection of a StepStats object.
@@ -176,6 +182,8 @@ class StepStatsCollector : public StepStatsCollectorInterface {
 
   NodeExecStatsInterface* CreateNodeExecStats(const NodeDef* node) override;
   string ReportAllocsOnResourceExhausted(const string& err) override;
+  void SaveStepArenaStats(const string& device,
+                          const StepArenaStats& stats) override;
 
   // The following 2 Finalize methods populate the StepStats passed
   // from the constructor. Calling it more than once won't have any effect.
@@ -198,6 +206,8 @@ class StepStatsCollector : public StepStatsCollectorInterface {
   bool finalized_ TF_GUARDED_BY(mu_);
   std::unordered_map<string, NodeStatsVector> dev_stats_ TF_GUARDED_BY(mu_);
   std::unordered_map<string, ThreadNamesMap> thread_names_ TF_GUARDED_BY(mu_);
+  std::unordered_map<string, StepArenaStats> step_arena_stats_
+      TF_GUARDED_BY(mu_);
   StepStats* step_stats_ TF_GUARDED_BY(mu_);
   uint64 collected_nodes_ TF_GUARDED_BY(mu_) = 0;
 };
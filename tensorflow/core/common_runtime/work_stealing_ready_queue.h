@@ -0,0 +1,146 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_WORK_STEALING_READY_QUEUE_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_WORK_STEALING_READY_QUEUE_H_
+
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "third_party/eigen3/unsupported/Eigen/CXX11/ThreadPool"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/macros.h"
+
+namespace tensorflow {
+
+// The ready nodes of an executor step, kept in one deque per worker.
+//
+// A worker is a loop that runs on a thread of the executor's runner and
+// executes ready nodes until there are none left. Up to `num_workers` workers
+// are active at a time, each owning the deque with its index: it pushes and
+// pops its own nodes at the front of that deque without taking a lock, and
+// steals from the back of the other deques when its own is empty. Threads that
+// are not workers push at the back of the deques. Scheduling a node therefore
+// costs a deque operation, and a closure is only needed to start a worker.
+//
+// The deques are Eigen::RunQueues of fixed capacity, so pushes can fail; the
+// caller is expected to schedule such nodes some other way.
+template <typename Item>
+class WorkStealingReadyQueue {
+ public:
+  static constexpr unsigned kCapacity = 256;
+
+  explicit WorkStealingReadyQueue(int num_workers) {
+    DCHECK_GT(num_workers, 0);
+    workers_.reserve(num_workers);
+    for (int i = 0; i < num_workers; ++i) {
+      workers_.emplace_back(new Worker);
+    }
+  }
+
+  int num_workers() const { return workers_.size(); }
+
+  // Claims an inactive worker slot. Returns its index, or -1 if all the
+  // workers are already active. Called after pushing nodes, to start a worker
+  // that runs them.
+  int StartWorker() {
+    // Pairs with the fence in `StopWorker()`: either a stopping worker sees
+    // the pushed nodes, or this thread sees its slot inactive.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    for (int i = 0; i < workers_.size(); ++i) {
+      std::atomic<bool>& active = workers_[i]->active;
+      if (!active.load(std::memory_order_relaxed) &&
+          !active.exchange(true, std::memory_order_acq_rel)) {
+        return i;
+      }
+    }
+    return -1;
+  }
+
+  // Gives up worker slot `worker`, unless nodes were pushed concurrently that
+  // no other worker may run. Returns the slot that the caller must keep
+  // running as, or -1 if it can stop.
+  int StopWorker(int worker) {
+    workers_[worker]->active.store(false, std::memory_order_release);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (Empty()) return -1;
+    return StartWorker();
+  }
+
+  // Pushes `item` at the front of the deque of `worker`, which must be the
+  // slot of the calling worker, or at the back of a deque if `worker` is -1.
+  // Returns false if the deques are full.
+  bool Push(int worker, Item item) {
+    if (worker >= 0) {
+      return IsEmptySlot(workers_[worker]->queue.PushFront(Slot(item)));
+    }
+    const unsigned start =
+        next_remote_.fetch_add(1, std::memory_order_relaxed) % workers_.size();
+    for (unsigned i = 0; i < workers_.size(); ++i) {
+      Worker& w = *workers_[(start + i) % workers_.size()];
+      if (IsEmptySlot(w.queue.PushBack(Slot(item)))) return true;
+    }
+    return false;
+  }
+
+  // Pops a node for the worker in slot `worker`, first from its own deque,
+  // then from the others. Returns false if all the deques are empty.
+  bool Pop(int worker, Item* item) {
+    Slot slot = workers_[worker]->queue.PopFront();
+    for (int i = 1; !slot.valid && i < workers_.size(); ++i) {
+      slot = workers_[(worker + i) % workers_.size()]->queue.PopBack();
+    }
+    if (!slot.valid) return false;
+    *item = std::move(slot.item);
+    return true;
+  }
+
+  bool Empty() const {
+    for (const auto& w : workers_) {
+      if (!w->queue.Empty()) return false;
+    }
+    return true;
+  }
+
+ private:
+  // RunQueue signals failure by returning a default-constructed element.
+  struct Slot {
+    Slot() = default;
+    explicit Slot(Item item) : item(std::move(item)), valid(true) {}
+    Item item;
+    bool valid = false;
+  };
+
+  struct Worker {
+    Eigen::RunQueue<Slot, kCapacity> queue;
+    std::atomic<bool> active{false};
+  };
+
+  static bool IsEmptySlot(const Slot& slot) { return !slot.valid; }
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::atomic<unsigned> next_remote_{0};
+
+  TF_DISALLOW_COPY_AND_ASSIGN(WorkStealingReadyQueue);
+};
+
+template <typename Item>
+constexpr unsigned WorkStealingReadyQueue<Item>::kCapacity;
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_WORK_STEALING_READY_QUEUE_H_
@@ -0,0 +1,140 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/work_stealing_ready_queue.h"
+
+#include <atomic>
+#include <functional>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "tensorflow/core/lib/core/notification.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+TEST(WorkStealingReadyQueueTest, OwnerIsLifoAndThiefIsFifo) {
+  WorkStealingReadyQueue<int> queue(2);
+  const int w0 = queue.StartWorker();
+  const int w1 = queue.StartWorker();
+  ASSERT_EQ(w0, 0);
+  ASSERT_EQ(w1, 1);
+  EXPECT_EQ(queue.StartWorker(), -1);
+  for (int i = 0; i < 3; ++i) {
+    ASSERT_TRUE(queue.Push(w0, i));
+  }
+  int item;
+  ASSERT_TRUE(queue.Pop(w0, &item));
+  EXPECT_EQ(item, 2);
+  // Worker 1 has nothing of its own, so it steals the oldest node.
+  ASSERT_TRUE(queue.Pop(w1, &item));
+  EXPECT_EQ(item, 0);
+  ASSERT_TRUE(queue.Pop(w1, &item));
+  EXPECT_EQ(item, 1);
+  EXPECT_FALSE(queue.Pop(w0, &item));
+  EXPECT_TRUE(queue.Empty());
+  EXPECT_EQ(queue.StopWorker(w0), -1);
+  EXPECT_EQ(queue.StopWorker(w1), -1);
+}
+
+TEST(WorkStealingReadyQueueTest, StopWorkerKeepsRunningIfNotEmpty) {
+  WorkStealingReadyQueue<int> queue(1);
+  const int worker = queue.StartWorker();
+  ASSERT_EQ(worker, 0);
+  // A node pushed by another thread after the worker found the deques empty.
+  ASSERT_TRUE(queue.Push(-1, 7));
+  EXPECT_EQ(queue.StopWorker(worker), 0);
+  int item;
+  ASSERT_TRUE(queue.Pop(worker, &item));
+  EXPECT_EQ(item, 7);
+  EXPECT_EQ(queue.StopWorker(worker), -1);
+}
+
+TEST(WorkStealingReadyQueueTest, PushFailsWhenFull) {
+  using Queue = WorkStealingReadyQueue<int>;
+  Queue queue(1);
+  const int worker = queue.StartWorker();
+  int num_pushed = 0;
+  while (queue.Push(worker, num_pushed)) ++num_pushed;
+  EXPECT_EQ(num_pushed, Queue::kCapacity);
+  int item;
+  while (queue.Pop(worker, &item)) --num_pushed;
+  EXPECT_EQ(num_pushed, 0);
+}
+
+// Runs a tree of items in which item i spawns items 2i + 1 and 2i + 2, with
+// workers started on demand as the executor does, and checks that every item
+// runs exactly once.
+TEST(WorkStealingReadyQueueTest, RunsEveryItemOnce) {
+  constexpr int kNumWorkers = 4;
+  constexpr int kNumItems = 1 << 16;
+  WorkStealingReadyQueue<int> queue(kNumWorkers);
+  std::vector<std::atomic<int>> runs(kNumItems);
+  std::atomic<int> num_outstanding{1};
+  Notification done;
+  auto pool = absl::make_unique<thread::ThreadPool>(Env::Default(), "test",
+                                                    kNumWorkers);
+
+  std::function<void(int)> start_worker;
+  std::function<void(int, int)> push = [&](int worker, int item) {
+    if (!queue.Push(worker, item)) {
+      // Runs the item on a thread that is not a worker.
+      pool->Schedule([&, item]() {
+        ++runs[item];
+        for (int child : {2 * item + 1, 2 * item + 2}) {
+          if (child < kNumItems) {
+            ++num_outstanding;
+            push(-1, child);
+          }
+        }
+        if (--num_outstanding == 0) done.Notify();
+      });
+      return;
+    }
+    const int new_worker = queue.StartWorker();
+    if (new_worker >= 0) start_worker(new_worker);
+  };
+  start_worker = [&](int worker) {
+    pool->Schedule([&, worker]() mutable {
+      int item;
+      while (worker >= 0) {
+        while (queue.Pop(worker, &item)) {
+          ++runs[item];
+          for (int child : {2 * item + 1, 2 * item + 2}) {
+            if (child < kNumItems) {
+              ++num_outstanding;
+              push(worker, child);
+            }
+          }
+          if (--num_outstanding == 0) done.Notify();
+        }
+        worker = queue.StopWorker(worker);
+      }
+    });
+  };
+  push(-1, 0);
+  done.WaitForNotification();
+  // Waits for the workers to stop.
+  pool.reset();
+  for (int i = 0; i < kNumItems; ++i) {
+    EXPECT_EQ(runs[i], 1) << i;
+  }
+}
+
+}  // namespace
+}  // namespace tensorflow
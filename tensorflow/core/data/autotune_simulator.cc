@@ -0,0 +1,201 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/data/autotune_simulator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "absl/strings/str_cat.h"
+#include "tensorflow/core/framework/cancellation.h"
+#include "tensorflow/core/platform/logging.h"
+
+namespace tensorflow {
+namespace data {
+namespace {
+
+using Kind = SyntheticStage::Kind;
+
+bool IsAsync(const SyntheticStage& stage) {
+  return stage.kind == Kind::kParallelMap || stage.kind == Kind::kPrefetch;
+}
+
+const char* ParameterName(const SyntheticStage& stage) {
+  return stage.kind == Kind::kParallelMap ? model::kParallelism
+                                          : model::kBufferSize;
+}
+
+int64_t ParameterMin(const SyntheticStage& stage) {
+  return stage.kind == Kind::kParallelMap ? 1 : 0;
+}
+
+// The share of time that a group of stages filling a buffer of
+// `buffer_size` elements spends producing elements.
+double BufferEfficiency(int64_t buffer_size) {
+  return 1.0 - 0.5 / (buffer_size + 1);
+}
+
+}  // namespace
+
+AutotuneSimulator::AutotuneSimulator(std::vector<SyntheticStage> stages,
+                                     int64_t consumer_time_nsec)
+    : stages_(std::move(stages)),
+      consumer_time_nsec_(consumer_time_nsec),
+      nodes_(stages_.size()),
+      buffered_elements_(stages_.size(), 0),
+      buffered_bytes_(stages_.size(), 0) {
+  DCHECK(!stages_.empty());
+  DCHECK(stages_[0].kind == Kind::kSource);
+  std::shared_ptr<model::Node> parent;
+  for (int i = stages_.size() - 1; i >= 0; --i) {
+    const SyntheticStage& stage = stages_[i];
+    model::Node::Factory factory;
+    switch (stage.kind) {
+      case Kind::kSource:
+        factory = model::MakeSourceNode;
+        break;
+      case Kind::kMap:
+        factory = [&stage](model::Node::Args args) {
+          return model::MakeKnownRatioNode(std::move(args), stage.ratio);
+        };
+        break;
+      case Kind::kParallelMap:
+      case Kind::kPrefetch:
+        factory = [&stage](model::Node::Args args) {
+          auto state = std::make_shared<model::SharedState>(
+              model::kAutotune, std::make_shared<mutex>(),
+              std::make_shared<condition_variable>());
+          return model::MakeAsyncKnownRatioNode(
+              std::move(args), /*ratio=*/1,
+              {model::MakeParameter(ParameterName(stage), std::move(state),
+                                    ParameterMin(stage), stage.max_value)});
+        };
+        break;
+    }
+    model_.AddNode(std::move(factory), absl::StrCat("Stage", i), parent,
+                   &nodes_[i]);
+    parent = nodes_[i];
+  }
+}
+
+double AutotuneSimulator::ElementsPerOutputElement(int index) const {
+  double result = 1;
+  for (int i = index + 1; i < stages_.size(); ++i) {
+    if (stages_[i].kind == Kind::kMap) {
+      result *= stages_[i].ratio;
+    }
+  }
+  return result;
+}
+
+void AutotuneSimulator::Run(int64_t num_elements) {
+  for (int i = 0; i < stages_.size(); ++i) {
+    const SyntheticStage& stage = stages_[i];
+    model::Node* node = nodes_[i].get();
+    const int64_t n = std::llround(num_elements * ElementsPerOutputElement(i));
+    for (int64_t j = 0; j < n; ++j) {
+      node->record_element();
+    }
+    node->add_processing_time(n * stage.processing_time_nsec);
+    node->record_bytes_produced(n * stage.element_bytes);
+    if (IsAsync(stage)) {
+      const int64_t elements = ParameterValue(i);
+      const int64_t bytes = elements * stage.element_bytes;
+      node->record_buffer_event(bytes - buffered_bytes_[i],
+                                elements - buffered_elements_[i]);
+      buffered_elements_[i] = elements;
+      buffered_bytes_[i] = bytes;
+    }
+  }
+}
+
+void AutotuneSimulator::SetElementBytes(int index, int64_t element_bytes) {
+  stages_[index].element_bytes = element_bytes;
+}
+
+void AutotuneSimulator::Optimize(model::AutotuneAlgorithm algorithm,
+                                 int64_t cpu_budget, int64_t ram_budget) {
+  CancellationManager cancellation_manager;
+  model_.Optimize(algorithm, cpu_budget, ram_budget,
+                  /*model_input_time=*/consumer_time_nsec_,
+                  &cancellation_manager);
+}
+
+int64_t AutotuneSimulator::ParameterValue(int index) const {
+  const SyntheticStage& stage = stages_[index];
+  if (!IsAsync(stage)) {
+    return 0;
+  }
+  // Before the first optimization, the value is `kAutotune`.
+  return std::max<int64_t>(nodes_[index]->parameter_value(ParameterName(stage)),
+                           ParameterMin(stage));
+}
+
+AutotuneSimulator::Result AutotuneSimulator::Evaluate(int64_t num_cores) const {
+  Result result;
+  // The elements per nanosecond that the pipeline can produce.
+  double throughput = std::numeric_limits<double>::infinity();
+  double total_time = 0;
+  // The group of stages that runs on the same threads, starting with the
+  // consumer of the pipeline, which does not fill a buffer.
+  int64_t group_threads = 1;
+  double group_time = consumer_time_nsec_;
+  double group_efficiency = 1;
+  auto end_group = [&]() {
+    if (group_time > 0) {
+      throughput = std::min(
+          throughput, group_threads * group_efficiency / group_time);
+    }
+  };
+  for (int i = stages_.size() - 1; i >= 0; --i) {
+    const SyntheticStage& stage = stages_[i];
+    const double time =
+        ElementsPerOutputElement(i) * stage.processing_time_nsec;
+    total_time += time;
+    const int64_t value = ParameterValue(i);
+    if (stage.kind == Kind::kParallelMap) {
+      // The calls run on `value` threads and their results are buffered until
+      // consumed. The input is produced by one call at a time.
+      end_group();
+      group_threads = value;
+      group_time = time;
+      group_efficiency = BufferEfficiency(value);
+      end_group();
+      group_threads = 1;
+      group_time = 0;
+      group_efficiency = 1;
+      result.parallelism += value;
+      result.buffered_bytes += value * stage.element_bytes;
+    } else if (stage.kind == Kind::kPrefetch && value > 0) {
+      // The input is produced by a background thread.
+      end_group();
+      group_threads = 1;
+      group_time = time;
+      group_efficiency = BufferEfficiency(value);
+      result.buffered_bytes += value * stage.element_bytes;
+    } else {
+      group_time += time;
+    }
+  }
+  end_group();
+  if (total_time > 0) {
+    throughput = std::min(throughput, num_cores / total_time);
+  }
+  result.throughput = throughput * EnvTime::kSecondsToNanos;
+  return result;
+}
+
+}  // namespace data
+}  // namespace tensorflow
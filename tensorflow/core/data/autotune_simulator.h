@@ -0,0 +1,121 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_DATA_AUTOTUNE_SIMULATOR_H_
+#define TENSORFLOW_CORE_DATA_AUTOTUNE_SIMULATOR_H_
+
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/framework/model.h"
+
+namespace tensorflow {
+namespace data {
+
+// A stage of a synthetic input pipeline.
+struct SyntheticStage {
+  enum class Kind {
+    // Produces elements without input, like reading records from files.
+    kSource,
+    // Synchronously transforms `ratio` input elements into an element, like
+    // `map` or `batch`.
+    kMap,
+    // Transforms input elements with up to `max_value` parallel calls, like
+    // `map` with `num_parallel_calls=AUTOTUNE`.
+    kParallelMap,
+    // Buffers up to `max_value` elements produced by a background thread,
+    // like `prefetch(AUTOTUNE)`.
+    kPrefetch,
+  };
+
+  Kind kind = Kind::kSource;
+  // The CPU time spent by the stage to produce an element, excluding the time
+  // spent by its input.
+  int64_t processing_time_nsec = 0;
+  // The size of the elements produced by the stage.
+  int64_t element_bytes = 0;
+  // The number of input elements per element of a `kMap` stage.
+  double ratio = 1;
+  // The maximum value of the tunable parameter of a `kParallelMap` or
+  // `kPrefetch` stage.
+  int64_t max_value = 1;
+};
+
+// Drives a `model::Model` with the statistics that a synthetic input pipeline
+// would record, so that autotuning algorithms can be compared offline on
+// pipelines with given processing times and element sizes.
+//
+// The tuned parameters are evaluated with a steady-state estimate of the
+// throughput of the pipeline that is independent of the model: each group of
+// stages that runs on the same threads is bounded by its threads divided by its
+// time per element, the pipeline is bounded by the cores divided by its total
+// CPU time per element, and a group that fills a buffer of `b` elements is
+// assumed to stall `1 / (2 * (b + 1))` of the time because of the variance of
+// processing times. The consumer of the pipeline, e.g. a training step, runs
+// on the same thread as the stages that follow the last buffer.
+class AutotuneSimulator {
+ public:
+  struct Result {
+    // The number of elements produced by the pipeline per second.
+    double throughput = 0;
+    // The number of bytes buffered when all the buffers are full.
+    double buffered_bytes = 0;
+    // The total parallelism of the `kParallelMap` stages.
+    int64_t parallelism = 0;
+  };
+
+  // `stages` are ordered from the source to the output of the pipeline. The
+  // first stage must be the only `kSource` stage. The consumer of the pipeline
+  // spends `consumer_time_nsec` per element, without using the CPU budget.
+  AutotuneSimulator(std::vector<SyntheticStage> stages,
+                    int64_t consumer_time_nsec);
+
+  // Records the statistics of producing `num_elements` elements at the output
+  // of the pipeline, assuming that all the buffers are full.
+  void Run(int64_t num_elements);
+
+  // Changes the size of the elements produced by the stage `index` from the
+  // next call to `Run`.
+  void SetElementBytes(int index, int64_t element_bytes);
+
+  // Runs one autotuning optimization with the given budgets.
+  void Optimize(model::AutotuneAlgorithm algorithm, int64_t cpu_budget,
+                int64_t ram_budget);
+
+  // Returns the value of the tunable parameter of the stage `index`, or 0 if
+  // it has none.
+  int64_t ParameterValue(int index) const;
+
+  // Estimates the throughput and memory usage of the pipeline on `num_cores`
+  // cores with the current parameter values and element sizes.
+  Result Evaluate(int64_t num_cores) const;
+
+ private:
+  // Returns the number of elements produced by the stage `index` per element
+  // produced by the pipeline.
+  double ElementsPerOutputElement(int index) const;
+
+  std::vector<SyntheticStage> stages_;
+  const int64_t consumer_time_nsec_;
+  model::Model model_;
+  std::vector<std::shared_ptr<model::Node>> nodes_;
+  // The elements recorded in the buffer of each stage.
+  std::vector<int64_t> buffered_elements_;
+  std::vector<int64_t> buffered_bytes_;
+};
+
+}  // namespace data
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_DATA_AUTOTUNE_SIMULATOR_H_
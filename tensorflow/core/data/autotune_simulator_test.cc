@@ -0,0 +1,130 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/data/autotune_simulator.h"
+
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace data {
+namespace {
+
+using Kind = SyntheticStage::Kind;
+
+constexpr int64_t kMicros = 1000;
+constexpr int64_t kMegabytes = 1 << 20;
+constexpr int64_t kNumCores = 16;
+// The time of a training step on a batch.
+constexpr int64_t kStepTimeNsec = 20000 * kMicros;
+
+// Reads records, decodes them into large images in parallel, batches them and
+// prefetches the batches.
+std::vector<SyntheticStage> ImagePipeline(int64_t image_bytes) {
+  return {
+      {Kind::kSource, /*processing_time_nsec=*/20 * kMicros,
+       /*element_bytes=*/100 * 1024},
+      {Kind::kParallelMap, /*processing_time_nsec=*/2000 * kMicros,
+       /*element_bytes=*/image_bytes, /*ratio=*/1, /*max_value=*/kNumCores},
+      {Kind::kMap, /*processing_time_nsec=*/500 * kMicros,
+       /*element_bytes=*/32 * image_bytes, /*ratio=*/32},
+      {Kind::kPrefetch, /*processing_time_nsec=*/0,
+       /*element_bytes=*/32 * image_bytes, /*ratio=*/1, /*max_value=*/64},
+  };
+}
+
+std::string AlgorithmName(model::AutotuneAlgorithm algorithm) {
+  return model::AutotuneAlgorithm_Name(algorithm);
+}
+
+AutotuneSimulator::Result Simulate(std::vector<SyntheticStage> pipeline,
+                                   model::AutotuneAlgorithm algorithm,
+                                   int64_t ram_budget) {
+  AutotuneSimulator simulator(std::move(pipeline), kStepTimeNsec);
+  simulator.Run(/*num_elements=*/100);
+  simulator.Optimize(algorithm, kNumCores, ram_budget);
+  AutotuneSimulator::Result result = simulator.Evaluate(kNumCores);
+  LOG(INFO) << AlgorithmName(algorithm) << ": " << result.throughput
+            << " elements/s, " << result.buffered_bytes / kMegabytes
+            << " MB buffered, parallelism " << result.parallelism;
+  return result;
+}
+
+TEST(AutotuneSimulatorTest, Evaluate) {
+  AutotuneSimulator simulator(ImagePipeline(kMegabytes), kStepTimeNsec);
+  AutotuneSimulator::Result result = simulator.Evaluate(kNumCores);
+  // Before tuning, the decoding runs on a single thread that stalls a quarter
+  // of the time: 32 images take 64ms of CPU time.
+  EXPECT_NEAR(result.throughput, 0.75 / 0.064, 1e-6);
+  EXPECT_EQ(result.buffered_bytes, kMegabytes);
+  EXPECT_EQ(result.parallelism, 1);
+}
+
+class AutotuneAlgorithmTest
+    : public ::testing::TestWithParam<model::AutotuneAlgorithm> {};
+
+TEST_P(AutotuneAlgorithmTest, ImprovesThroughput) {
+  const model::AutotuneAlgorithm algorithm = GetParam();
+  AutotuneSimulator::Result untuned =
+      AutotuneSimulator(ImagePipeline(kMegabytes), kStepTimeNsec)
+          .Evaluate(kNumCores);
+  AutotuneSimulator::Result tuned = Simulate(
+      ImagePipeline(kMegabytes), algorithm, /*ram_budget=*/16LL << 30);
+  EXPECT_GT(tuned.throughput, 3 * untuned.throughput);
+}
+
+INSTANTIATE_TEST_SUITE_P(Test, AutotuneAlgorithmTest,
+                         ::testing::Values(model::HILL_CLIMB,
+                                           model::GRADIENT_DESCENT,
+                                           model::RESOURCE_AWARE));
+
+TEST(AutotuneSimulatorTest, ResourceAwareStaysWithinRamBudget) {
+  const int64_t ram_budget = 512 * kMegabytes;
+  AutotuneSimulator::Result hill_climb =
+      Simulate(ImagePipeline(2 * kMegabytes), model::HILL_CLIMB, ram_budget);
+  AutotuneSimulator::Result resource_aware = Simulate(
+      ImagePipeline(2 * kMegabytes), model::RESOURCE_AWARE, ram_budget);
+  EXPECT_LE(resource_aware.buffered_bytes, ram_budget);
+  EXPECT_GE(resource_aware.throughput, 0.9 * hill_climb.throughput);
+}
+
+TEST(AutotuneSimulatorTest, ResourceAwareStaysWithinCpuBudget) {
+  AutotuneSimulator::Result result =
+      Simulate(ImagePipeline(kMegabytes), model::RESOURCE_AWARE,
+               /*ram_budget=*/16LL << 30);
+  EXPECT_LE(result.parallelism, kNumCores);
+}
+
+TEST(AutotuneSimulatorTest, ResourceAwareAdaptsToElementSizeDrift) {
+  const int64_t ram_budget = 256 * kMegabytes;
+  AutotuneSimulator simulator(ImagePipeline(kMegabytes), kStepTimeNsec);
+  simulator.Run(/*num_elements=*/100);
+  simulator.Optimize(model::RESOURCE_AWARE, kNumCores, ram_budget);
+  EXPECT_LE(simulator.Evaluate(kNumCores).buffered_bytes, ram_budget);
+  const int64_t buffer_size = simulator.ParameterValue(3);
+
+  // The images become four times larger.
+  simulator.SetElementBytes(1, 4 * kMegabytes);
+  simulator.SetElementBytes(2, 128 * kMegabytes);
+  simulator.SetElementBytes(3, 128 * kMegabytes);
+  simulator.Run(/*num_elements=*/1000);
+  EXPECT_GT(simulator.Evaluate(kNumCores).buffered_bytes, ram_budget);
+  simulator.Optimize(model::RESOURCE_AWARE, kNumCores, ram_budget);
+  EXPECT_LE(simulator.Evaluate(kNumCores).buffered_bytes, ram_budget);
+  EXPECT_LT(simulator.ParameterValue(3), buffer_size);
+}
+
+}  // namespace
+}  // namespace data
+}  // namespace tensorflow
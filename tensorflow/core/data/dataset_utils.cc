@@ -23,6 +23,7 @@ limitations under the License.
 
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
+#include "absl/types/span.h"
 #include "tensorflow/core/common_runtime/function.h"
 #include "tensorflow/core/framework/attr_value.pb.h"
 #include "tensorflow/core/framework/dataset.h"
@@ -41,6 +42,7 @@ limitations under the License.
 #include "tensorflow/core/lib/strings/proto_serialization.h"
 #include "tensorflow/core/platform/host_info.h"
 #include "tensorflow/core/platform/regexp.h"
+#include "tensorflow/core/util/batch_util.h"
 #include "tensorflow/core/util/determinism.h"
 #include "tensorflow/core/util/work_sharder.h"
 
@@ -734,7 +736,7 @@ Status ProcessBatch(int64_t batch_size, int64_t num_elements,
 }
 
 Status CopyBatch(CopyBatchParams params,
-                 const std::vector<std::vector<Tensor>>& batch_elements,
+                 std::vector<std::vector<Tensor>>&& batch_elements,
                  bool parallel_copy,
                  std::function<Status()> allocation_callback,
                  std::vector<Tensor>* out_tensors) {
@@ -760,35 +762,39 @@ Status CopyBatch(CopyBatchParams params,
   if (allocation_callback) {
     TF_RETURN_IF_ERROR(allocation_callback());
   }
+  // The elements of a component, in the order of the batch.
+  std::vector<Tensor*> component_elements(num_batch_elements);
   for (size_t component_index = 0; component_index < num_tuple_components;
        ++component_index) {
     Tensor& batch_component = out_tensors->at(component_index);
     const Tensor& first_element = batch_elements.at(0)[component_index];
     TensorShape first_element_shape(first_element.shape());
-    // Build the output tuple component by copying one slice from each input
-    // element in the batch.
-    auto copy_element_fn = [component_index, &batch_elements, &batch_component,
-                            &first_element_shape](int index) {
-      if (batch_elements.at(index)[component_index].shape() !=
-          first_element_shape) {
+    for (int64_t i = 0; i < num_batch_elements; ++i) {
+      Tensor& element = batch_elements[i][component_index];
+      if (element.shape() != first_element_shape) {
         return errors::InvalidArgument(
             "Cannot batch tensors with different shapes in component ",
             component_index, ". First element had shape ",
-            first_element_shape.DebugString(), " and element ", index,
-            " had shape ",
-            batch_elements.at(index)[component_index].shape().DebugString(),
-            ".");
+            first_element_shape.DebugString(), " and element ", i,
+            " had shape ", element.shape().DebugString(), ".");
       }
-      return batch_util::CopyElementToSlice(
-          std::move(batch_elements.at(index)[component_index]),
-          &batch_component, index);
+      component_elements[i] = &element;
+    }
+    // Build the output tuple component by copying the slices of the input
+    // elements in [offset, offset + length) in one pass, so that the data
+    // type is dispatched on once per component rather than once per element.
+    auto copy_elements_fn = [&component_elements, &batch_component](
+                                int64_t offset, int64_t length) {
+      return batch_util::CopyElementsToSlices(
+          absl::MakeConstSpan(component_elements).subspan(offset, length),
+          &batch_component, offset);
     };
     if (parallel_copy ||
         (in_experiment && first_element.AllocatedBytes() > (1 << 15))) {
       Status status;
       mutex status_mu;
-      BlockingCounter counter(num_batch_elements);
       const auto num_threads = params.runner_threadpool_size;
+      BlockingCounter counter(num_threads);
       const auto slice_size = num_batch_elements / num_threads;
       int64_t offset = 0;
       for (size_t i = 0; i < num_threads; ++i) {
@@ -798,24 +804,20 @@ Status CopyBatch(CopyBatchParams params,
         // sizes add up to the total number of elements.
         if (i < num_batch_elements % num_threads) ++length;
         (*params.runner)([offset, length, &status, &status_mu, &counter,
-                          &copy_element_fn]() {
-          for (size_t j = offset; j < offset + length; ++j) {
-            {
-              Status s = copy_element_fn(j);
-              mutex_lock l(status_mu);
-              status.Update(s);
-            }
-            counter.DecrementCount();
+                          &copy_elements_fn]() {
+          Status s = copy_elements_fn(offset, length);
+          {
+            mutex_lock l(status_mu);
+            status.Update(s);
           }
+          counter.DecrementCount();
         });
         offset += length;
       }
       counter.Wait();
       TF_RETURN_IF_ERROR(status);
     } else {
-      for (size_t i = 0; i < num_batch_elements; ++i) {
-        TF_RETURN_IF_ERROR(copy_element_fn(i));
-      }
+      TF_RETURN_IF_ERROR(copy_elements_fn(0, num_batch_elements));
     }
   }
   return Status::OK();
@@ -902,6 +904,8 @@ REGISTER_DATASET_EXPERIMENT("parallelize_batch_copy", 100);
 REGISTER_DATASET_EXPERIMENT("max_parallelism", 100);
 REGISTER_DATASET_EXPERIMENT("min_outer_interleave_parallelism", 50);
 REGISTER_DATASET_EXPERIMENT("inject_prefetch", 50);
+REGISTER_DATASET_EXPERIMENT("resource_aware_autotune", 0);
+REGISTER_DATASET_EXPERIMENT("map_vectorization", 0);
 }  // namespace
 }  // namespace data
 }  // namespace tensorflow
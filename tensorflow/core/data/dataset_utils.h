@@ -280,6 +280,13 @@ struct CopyBatchParams {
   std::function<void(std::function<void()>)>* runner;
   int64 runner_threadpool_size;
 
+  CopyBatchParams(Allocator* allocator,
+                  std::function<void(std::function<void()>)>* runner,
+                  int64 runner_threadpool_size)
+      : allocator(allocator),
+        runner(runner),
+        runner_threadpool_size(runner_threadpool_size) {}
+
   explicit CopyBatchParams(IteratorContext* ctx) {
     allocator = ctx->allocator({});
     runner = ctx->runner();
@@ -296,13 +303,15 @@ struct CopyBatchParams {
 // Copies the input elements to a batch.
 //
 // The `batch_elements` argument contains the individual elements to copy into a
-// batch. The `parallel_copy` argument indicates whether to parallelize the
-// copy. The `allocation_callback` argument can be used to pass a callback to
-// invoke upon successful allocation of the memory for the batch. The
+// batch. It is taken as an rvalue so that string and variant values can be
+// moved, rather than copied, into the batch. The `parallel_copy` argument
+// indicates whether to parallelize the copy. The `allocation_callback`
+// argument can be used to pass a callback to invoke upon successful allocation
+// of the memory for the batch. The
 // `out_tensors` argument will be used to store the resulting batch (one for
 // each component of the input).
 Status CopyBatch(CopyBatchParams params,
-                 const std::vector<std::vector<Tensor>>& batch_elements,
+                 std::vector<std::vector<Tensor>>&& batch_elements,
                  bool parallel_copy,
                  std::function<Status()> allocation_callback,
                  std::vector<Tensor>* out_tensors);
@@ -360,6 +369,14 @@ inline int GetCpuBudget() {
   return (in_experiment ? 1.2 : 1.0) * port::NumSchedulableCPUs();
 }
 
+// Returns the default autotuning algorithm.
+inline model::AutotuneAlgorithm GetAutotuneAlgorithm() {
+  static bool in_experiment =
+      GetExperiments().contains("resource_aware_autotune");
+  return in_experiment ? model::AutotuneAlgorithm::RESOURCE_AWARE
+                       : model::AutotuneAlgorithm::HILL_CLIMB;
+}
+
 // Registry of tf.data experiments.
 class DatasetExperimentRegistry {
  public:
@@ -17,6 +17,8 @@ limitations under the License.
 
 #include <functional>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "absl/container/flat_hash_set.h"
 #include "tensorflow/core/data/dataset_test_base.h"
@@ -25,11 +27,13 @@ limitations under the License.
 #include "tensorflow/core/framework/function.pb.h"
 #include "tensorflow/core/framework/node_def_builder.h"
 #include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/framework/types.pb.h"
 #include "tensorflow/core/framework/variant.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/platform/str_util.h"
 #include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
 #include "tensorflow/core/protobuf/error_codes.pb.h"
 #include "tensorflow/core/util/determinism_test_util.h"
 #include "tensorflow/core/util/work_sharder.h"
@@ -616,6 +620,112 @@ TEST(DatasetUtilsTest, DatasetExperimentRegistry) {
   EXPECT_TRUE(experiments.find("non_existing_experiment") == experiments.end());
 }
 
+std::vector<std::vector<Tensor>> CopyBatchElements(int64_t batch_size) {
+  std::vector<std::vector<Tensor>> batch_elements;
+  for (int64_t i = 0; i < batch_size; ++i) {
+    batch_elements.push_back(
+        {Tensor(i), test::AsTensor<tstring>({absl::StrCat(i), "x"})});
+  }
+  return batch_elements;
+}
+
+TEST(DatasetUtilsTest, CopyBatch) {
+  std::function<void(std::function<void()>)> runner =
+      [](std::function<void()> fn) { fn(); };
+  for (bool parallel_copy : {false, true}) {
+    std::vector<Tensor> out_tensors;
+    TF_ASSERT_OK(CopyBatch(CopyBatchParams(cpu_allocator(), &runner, 3),
+                           CopyBatchElements(4), parallel_copy,
+                           /*allocation_callback=*/nullptr, &out_tensors));
+    ASSERT_EQ(out_tensors.size(), 2);
+    test::ExpectEqual(out_tensors[0], test::AsTensor<int64_t>({0, 1, 2, 3}));
+    test::ExpectEqual(
+        out_tensors[1],
+        test::AsTensor<tstring>({"0", "x", "1", "x", "2", "x", "3", "x"},
+                                TensorShape({4, 2})));
+  }
+}
+
+TEST(DatasetUtilsTest, CopyBatchCopiesSharedStrings) {
+  std::function<void(std::function<void()>)> runner =
+      [](std::function<void()> fn) { fn(); };
+  Tensor shared = test::AsTensor<tstring>({"a", "b"});
+  std::vector<Tensor> out_tensors;
+  TF_ASSERT_OK(CopyBatch(CopyBatchParams(cpu_allocator(), &runner, 1),
+                         {{shared}, {shared}}, /*parallel_copy=*/false,
+                         /*allocation_callback=*/nullptr, &out_tensors));
+  test::ExpectEqual(out_tensors[0],
+                    test::AsTensor<tstring>({"a", "b", "a", "b"},
+                                            TensorShape({2, 2})));
+  test::ExpectEqual(shared, test::AsTensor<tstring>({"a", "b"}));
+}
+
+TEST(DatasetUtilsTest, CopyBatchDifferentShapes) {
+  std::function<void(std::function<void()>)> runner =
+      [](std::function<void()> fn) { fn(); };
+  std::vector<Tensor> out_tensors;
+  Status s = CopyBatch(CopyBatchParams(cpu_allocator(), &runner, 1),
+                       {{test::AsTensor<int64_t>({1})},
+                        {test::AsTensor<int64_t>({1, 2})}},
+                       /*parallel_copy=*/false,
+                       /*allocation_callback=*/nullptr, &out_tensors);
+  EXPECT_EQ(s.code(), error::INVALID_ARGUMENT);
+}
+
+// Batches elements of `num_features` scalar components of type `dtype`. The
+// argument is the batch size.
+void CopyBatchBenchmark(::testing::benchmark::State& state, DataType dtype,
+                        int64_t num_features) {
+  const int64_t batch_size = state.range(0);
+  std::function<void(std::function<void()>)> runner =
+      [](std::function<void()> fn) { fn(); };
+  for (auto s : state) {
+    state.PauseTiming();
+    std::vector<std::vector<Tensor>> batch_elements(batch_size);
+    for (auto& element : batch_elements) {
+      element.reserve(num_features);
+      for (int64_t i = 0; i < num_features; ++i) {
+        if (dtype == DT_STRING) {
+          element.push_back(Tensor(tstring("a string longer than the SSO")));
+        } else {
+          element.push_back(Tensor(i));
+        }
+      }
+    }
+    std::vector<Tensor> out_tensors;
+    state.ResumeTiming();
+    TF_CHECK_OK(CopyBatch(CopyBatchParams(cpu_allocator(), &runner, 1),
+                          std::move(batch_elements), /*parallel_copy=*/false,
+                          /*allocation_callback=*/nullptr, &out_tensors));
+    state.PauseTiming();
+    out_tensors.clear();
+    batch_elements.clear();
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(state.iterations() * batch_size * num_features);
+}
+
+void BM_CopyBatchInt64Scalars(::testing::benchmark::State& state) {
+  CopyBatchBenchmark(state, DT_INT64, /*num_features=*/1000);
+}
+
+void BM_CopyBatchStringScalars(::testing::benchmark::State& state) {
+  CopyBatchBenchmark(state, DT_STRING, /*num_features=*/1000);
+}
+
+BENCHMARK(BM_CopyBatchInt64Scalars)
+    ->Arg(32)
+    ->Arg(128)
+    ->Arg(512)
+    ->Arg(1024)
+    ->Arg(4096);
+BENCHMARK(BM_CopyBatchStringScalars)
+    ->Arg(32)
+    ->Arg(128)
+    ->Arg(512)
+    ->Arg(1024)
+    ->Arg(4096);
+
 }  // namespace
 }  // namespace data
 }  // namespace tensorflow
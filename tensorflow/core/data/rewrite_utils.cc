@@ -33,6 +33,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/graph_constructor.h"
 #include "tensorflow/core/common_runtime/graph_runner.h"
 #include "tensorflow/core/common_runtime/process_function_library_runtime.h"
+#include "tensorflow/core/data/dataset.pb.h"
 #include "tensorflow/core/data/dataset_utils.h"
 #include "tensorflow/core/data/hash_utils.h"
 #include "tensorflow/core/data/serialization_utils.h"
@@ -58,7 +59,10 @@ limitations under the License.
 #include "tensorflow/core/grappler/optimizers/meta_optimizer.h"
 #include "tensorflow/core/lib/hash/hash.h"
 #include "tensorflow/core/lib/strings/proto_serialization.h"
+#include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/path.h"
 #include "tensorflow/core/platform/status.h"
 #include "tensorflow/core/platform/statusor.h"
 #include "tensorflow/core/platform/tstring.h"
@@ -66,6 +70,8 @@ limitations under the License.
 #include "tensorflow/core/protobuf/device_properties.pb.h"
 #include "tensorflow/core/protobuf/meta_graph.pb.h"
 #include "tensorflow/core/protobuf/rewriter_config.pb.h"
+#include "tensorflow/core/public/version.h"
+#include "tensorflow/core/util/env_var.h"
 
 namespace tensorflow {
 namespace data {
@@ -132,6 +138,36 @@ Status ApplyRewrites(OpKernelContext* ctx,
 
   return Status::OK();
 }
+
+// Instantiates the optimized input pipeline by running the optimized graph
+// using the optimized function library. Sets `lib_def` to that library.
+Status InstantiateRewrittenDataset(
+    OpKernelContext* ctx, const GraphDef& graph_def,
+    const std::vector<std::pair<string, Tensor>>& input_list,
+    const string& output_node,
+    std::unique_ptr<FunctionLibraryDefinition>* lib_def,
+    DatasetBase** rewritten_input) {
+  FunctionLibraryRuntime* flr = nullptr;
+  std::unique_ptr<ProcessFunctionLibraryRuntime> pflr = nullptr;
+  TF_RETURN_IF_ERROR(
+      ctx->function_library()->Clone(lib_def, &pflr, &flr, true));
+
+  // Some functions may have been modified without having their names changed
+  // (for example, nested dataset graphs from FlatMap or Interleave).
+  TF_RETURN_IF_ERROR(
+      AddToFunctionLibrary(lib_def->get(), graph_def.library()));
+
+  Graph graph(OpRegistry::Global());
+  TF_RETURN_IF_ERROR(ImportGraphDef({}, graph_def, &graph, nullptr));
+  std::vector<Tensor> outputs;
+  GraphRunner graph_runner(flr->device());
+
+  TF_RETURN_IF_ERROR(
+      graph_runner.Run(&graph, flr, input_list, {output_node}, &outputs));
+  TF_RETURN_IF_ERROR(GetDatasetFromVariantTensor(outputs[0], rewritten_input));
+  (*rewritten_input)->Ref();
+  return Status::OK();
+}
 }  // anonymous namespace
 
 RewriterConfig CreateRewriterConfig(
@@ -174,32 +210,49 @@ Status RewriteDataset(OpKernelContext* ctx, const DatasetBase* input,
   TF_RETURN_IF_ERROR(
       AsGraphDefForRewrite(ctx, input, &input_list, &graph_def, &output_node));
 
-  VLOG(3) << "Before graph rewrites: " << graph_def.DebugString();
-  TF_RETURN_IF_ERROR(
-      ApplyRewrites(ctx, config_factory, &graph_def, &output_node));
-  VLOG(3) << "After graph rewrites: " << graph_def.DebugString();
-
-  // Instantiate the optimized input pipeline by running the optimized graph
-  // using the optimized function library.
-  FunctionLibraryRuntime* flr = nullptr;
-  std::unique_ptr<ProcessFunctionLibraryRuntime> pflr = nullptr;
-  std::unique_ptr<FunctionLibraryDefinition> lib_def = nullptr;
-  TF_RETURN_IF_ERROR(
-      ctx->function_library()->Clone(&lib_def, &pflr, &flr, true));
-
-  // Some functions may have been modified without having their names changed
-  // (for example, nested dataset graphs from FlatMap or Interleave).
-  TF_RETURN_IF_ERROR(AddToFunctionLibrary(lib_def.get(), graph_def.library()));
-
-  Graph graph(OpRegistry::Global());
-  TF_RETURN_IF_ERROR(ImportGraphDef({}, graph_def, &graph, nullptr));
-  std::vector<Tensor> outputs;
-  GraphRunner graph_runner(flr->device());
+  RewriteCache* cache = RewriteCache::Global();
+  const RewriterConfig config = config_factory();
+  RewriteCache::Key key = {};
+  bool cache_hit = false;
+  std::unique_ptr<FunctionLibraryDefinition> lib_def;
+  if (cache->enabled()) {
+    key = RewriteCache::Fingerprint(
+        graph_def, output_node, input_list, config,
+        ctx->function_library()->device()->device_type());
+    GraphDef cached_graph_def;
+    string cached_node;
+    if (cache->Lookup(key, &cached_graph_def, &cached_node)) {
+      Status s = InstantiateRewrittenDataset(
+          ctx, cached_graph_def, input_list, cached_node, &lib_def,
+          rewritten_input);
+      if (s.ok()) {
+        VLOG(2) << "Reused the cached rewrite of dataset graph "
+                << strings::StrCat(strings::Hex(key.hash, strings::kZeroPad16));
+        graph_def = std::move(cached_graph_def);
+        output_node = std::move(cached_node);
+        cache_hit = true;
+      } else {
+        LOG(WARNING) << "Failed to instantiate the cached rewrite of dataset "
+                     << "graph "
+                     << strings::StrCat(
+                            strings::Hex(key.hash, strings::kZeroPad16))
+                     << ", rewriting it again: " << s.ToString();
+        cache->Erase(key);
+      }
+    }
+  }
 
-  TF_RETURN_IF_ERROR(
-      graph_runner.Run(&graph, flr, input_list, {output_node}, &outputs));
-  TF_RETURN_IF_ERROR(GetDatasetFromVariantTensor(outputs[0], rewritten_input));
-  (*rewritten_input)->Ref();
+  if (!cache_hit) {
+    VLOG(3) << "Before graph rewrites: " << graph_def.DebugString();
+    TF_RETURN_IF_ERROR(ApplyRewrites(
+        ctx, [&config]() { return config; }, &graph_def, &output_node));
+    VLOG(3) << "After graph rewrites: " << graph_def.DebugString();
+    TF_RETURN_IF_ERROR(InstantiateRewrittenDataset(
+        ctx, graph_def, input_list, output_node, &lib_def, rewritten_input));
+    if (cache->enabled()) {
+      cache->Insert(key, graph_def, output_node);
+    }
+  }
 
   if (record_fingerprint) {
     (*ctx->runner())([graph_def = std::move(graph_def),
@@ -302,6 +355,179 @@ StatusOr<std::string> GetDatasetNode(const GraphDef& graph_def) {
                        graph_def.ShortDebugString()));
 }
 
+RewriteCache::RewriteCache(int64_t capacity, const std::string& cache_dir)
+    : capacity_(capacity), cache_dir_(cache_dir) {}
+
+RewriteCache* RewriteCache::Global() {
+  static RewriteCache* cache = [] {
+    int64_t capacity;
+    Status s = ReadInt64FromEnvVar("TF_DATA_REWRITE_CACHE_CAPACITY",
+                                   /*default_val=*/0, &capacity);
+    if (!s.ok()) {
+      LOG(ERROR) << "Invalid TF_DATA_REWRITE_CACHE_CAPACITY: " << s;
+      capacity = 0;
+    }
+    std::string cache_dir;
+    s = ReadStringFromEnvVar("TF_DATA_REWRITE_CACHE_DIR",
+                             /*default_val=*/"", &cache_dir);
+    if (!s.ok()) {
+      LOG(ERROR) << "Invalid TF_DATA_REWRITE_CACHE_DIR: " << s;
+      cache_dir.clear();
+    }
+    return new RewriteCache(capacity, cache_dir);
+  }();
+  return cache;
+}
+
+RewriteCache::Key RewriteCache::Fingerprint(
+    const GraphDef& graph_def, const std::string& dataset_node,
+    const std::vector<std::pair<std::string, Tensor>>& input_list,
+    const RewriterConfig& config, const std::string& device_type) {
+  // Each part is prefixed with its length, so that different inputs cannot
+  // concatenate to the same string.
+  std::string serialized;
+  auto append = [&serialized](absl::string_view part) {
+    strings::StrAppend(&serialized, part.size(), ":", part);
+  };
+  std::string serialized_proto;
+  SerializeToStringDeterministic(graph_def, &serialized_proto);
+  append(serialized_proto);
+  append(dataset_node);
+  for (const auto& pair : input_list) {
+    append(pair.first);
+    append(DataTypeString(pair.second.dtype()));
+  }
+  SerializeToStringDeterministic(config, &serialized_proto);
+  append(serialized_proto);
+  append(device_type);
+  append(tf_git_version());
+  return {Hash64(serialized), ::tensorflow::Fingerprint128(serialized)};
+}
+
+bool RewriteCache::Lookup(const Key& key, GraphDef* graph_def,
+                          std::string* dataset_node) {
+  {
+    mutex_lock l(mu_);
+    auto it = entries_.find(key.hash);
+    if (it != entries_.end()) {
+      if (!(it->second.input_fingerprint == key.input_fingerprint)) {
+        LOG(WARNING) << "Dataset graph rewrite cache key collision for "
+                     << strings::StrCat(
+                            strings::Hex(key.hash, strings::kZeroPad16))
+                     << "; rewriting the graph.";
+        return false;
+      }
+      lru_.splice(lru_.begin(), lru_, it->second.lru_position);
+      *graph_def = it->second.graph_def;
+      *dataset_node = it->second.dataset_node;
+      return true;
+    }
+  }
+  if (cache_dir_.empty()) {
+    return false;
+  }
+  const std::string path = FilePath(key.hash);
+  if (!Env::Default()->FileExists(path).ok()) {
+    return false;
+  }
+  RewrittenDatasetGraph proto;
+  Status s = ReadBinaryProto(Env::Default(), path, &proto);
+  if (!s.ok()) {
+    LOG(WARNING) << "Failed to read the cached dataset graph " << path << ": "
+                 << s.ToString();
+    return false;
+  }
+  if (proto.input_fingerprint_low64() != key.input_fingerprint.low64 ||
+      proto.input_fingerprint_high64() != key.input_fingerprint.high64) {
+    LOG(WARNING) << "The cached dataset graph " << path << " was rewritten "
+                 << "from a different graph with the same key; rewriting the "
+                 << "graph.";
+    return false;
+  }
+  *graph_def = proto.graph_def();
+  *dataset_node = proto.dataset_node();
+  mutex_lock l(mu_);
+  InsertLocked(key, std::move(*proto.mutable_graph_def()),
+               proto.dataset_node());
+  return true;
+}
+
+void RewriteCache::Insert(const Key& key, const GraphDef& graph_def,
+                          const std::string& dataset_node) {
+  {
+    mutex_lock l(mu_);
+    InsertLocked(key, graph_def, dataset_node);
+  }
+  if (cache_dir_.empty()) {
+    return;
+  }
+  const std::string path = FilePath(key.hash);
+  if (Env::Default()->FileExists(path).ok()) {
+    return;
+  }
+  RewrittenDatasetGraph proto;
+  *proto.mutable_graph_def() = graph_def;
+  proto.set_dataset_node(dataset_node);
+  proto.set_input_fingerprint_low64(key.input_fingerprint.low64);
+  proto.set_input_fingerprint_high64(key.input_fingerprint.high64);
+  // Write to a temporary file first, so that processes sharing the directory
+  // never read a partially written entry.
+  const std::string tmp_path =
+      strings::StrCat(path, ".tmp", Env::Default()->NowMicros());
+  Status s = Env::Default()->RecursivelyCreateDir(cache_dir_);
+  if (s.ok()) {
+    s = WriteBinaryProto(Env::Default(), tmp_path, proto);
+  }
+  if (s.ok()) {
+    s = Env::Default()->RenameFile(tmp_path, path);
+  }
+  if (!s.ok()) {
+    LOG(WARNING) << "Failed to write the cached dataset graph " << path << ": "
+                 << s.ToString();
+    Env::Default()->DeleteFile(tmp_path).IgnoreError();
+  }
+}
+
+void RewriteCache::Erase(const Key& key) {
+  {
+    mutex_lock l(mu_);
+    auto it = entries_.find(key.hash);
+    if (it != entries_.end() &&
+        it->second.input_fingerprint == key.input_fingerprint) {
+      lru_.erase(it->second.lru_position);
+      entries_.erase(it);
+    }
+  }
+  if (!cache_dir_.empty()) {
+    Env::Default()->DeleteFile(FilePath(key.hash)).IgnoreError();
+  }
+}
+
+int64_t RewriteCache::size() const {
+  mutex_lock l(mu_);
+  return entries_.size();
+}
+
+std::string RewriteCache::FilePath(uint64 key) const {
+  return io::JoinPath(cache_dir_,
+                      strings::StrCat(strings::Hex(key, strings::kZeroPad16),
+                                      ".pb"));
+}
+
+void RewriteCache::InsertLocked(const Key& key, GraphDef graph_def,
+                                const std::string& dataset_node) {
+  if (capacity_ <= 0 || entries_.contains(key.hash)) {
+    return;
+  }
+  if (static_cast<int64_t>(entries_.size()) >= capacity_) {
+    entries_.erase(lru_.back());
+    lru_.pop_back();
+  }
+  lru_.push_front(key.hash);
+  entries_[key.hash] = {std::move(graph_def), dataset_node,
+                        key.input_fingerprint, lru_.begin()};
+}
+
 }  // namespace data
 }  // namespace tensorflow
 #endif  // !IS_MOBILE_PLATFORM
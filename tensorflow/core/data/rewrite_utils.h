@@ -21,10 +21,15 @@ limitations under the License.
 // dependencies are available there.
 #if !defined(IS_MOBILE_PLATFORM)
 
+#include <cstdint>
 #include <functional>
+#include <list>
 #include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
+#include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "tensorflow/core/common_runtime/function.h"
 #include "tensorflow/core/framework/dataset.h"
@@ -34,8 +39,11 @@ limitations under the License.
 #include "tensorflow/core/framework/resource_mgr.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/platform/fingerprint.h"
+#include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/platform/status.h"
 #include "tensorflow/core/platform/statusor.h"
+#include "tensorflow/core/platform/thread_annotations.h"
 #include "tensorflow/core/platform/tstring.h"
 #include "tensorflow/core/platform/types.h"
 #include "tensorflow/core/protobuf/rewriter_config.pb.h"
@@ -48,6 +56,10 @@ RewriterConfig CreateRewriterConfig(
     const absl::flat_hash_set<tstring>& optimizations_configs);
 
 // Rewrites the input dataset using the given config.
+//
+// If `RewriteCache::Global()` is enabled, the rewritten graph is looked up in
+// it first, so that constructing the same input pipeline again skips the graph
+// rewrites.
 Status RewriteDataset(OpKernelContext* ctx, const DatasetBase* input,
                       std::function<RewriterConfig(void)> config_factory,
                       bool record_fingerprint, DatasetBase** rewritten_input);
@@ -66,6 +78,92 @@ std::unique_ptr<tensorflow::grappler::GrapplerItem> GetGrapplerItem(
 // the symbolic `_Retval` node.
 StatusOr<std::string> GetDatasetNode(const GraphDef& graph_def);
 
+// Caches the results of dataset graph rewrites, keyed by `Fingerprint`.
+//
+// Entries are kept in memory, up to `capacity` of them, and evicted in least
+// recently used order. If `cache_dir` is not empty, entries are also written
+// to it, so that they outlive the process and can be shared between the
+// processes of a job. RewriteCache is thread-safe.
+class RewriteCache {
+ public:
+  RewriteCache(int64_t capacity, const std::string& cache_dir);
+
+  RewriteCache(const RewriteCache&) = delete;
+  RewriteCache& operator=(const RewriteCache&) = delete;
+
+  // Identifies the rewrite of a dataset graph. `hash` keys the entries, and
+  // `input_fingerprint`, which is computed with an independent hash function,
+  // is stored with each entry and compared on lookup, so that a collision of
+  // `hash` is a miss rather than the rewrite of another graph.
+  struct Key {
+    uint64 hash;
+    Fprint128 input_fingerprint;
+  };
+
+  // Returns the process-wide cache. It is disabled by default, since entries
+  // hold whole graphs, which may embed large constants. It holds up to
+  // TF_DATA_REWRITE_CACHE_CAPACITY (default 0) entries in memory and writes
+  // entries to TF_DATA_REWRITE_CACHE_DIR if set.
+  static RewriteCache* Global();
+
+  // Returns whether the cache holds any entries, in memory or on disk.
+  bool enabled() const { return capacity_ > 0 || !cache_dir_.empty(); }
+
+  // Returns the key of the rewrite of `graph_def`, fetching `dataset_node`
+  // fed with the tensors named in `input_list`, with `config` on a device of
+  // type `device_type`. The key covers the exact serialization of the graph,
+  // since the rewritten graph refers to the names of its nodes and functions.
+  // The values of `input_list` are not part of the key, since the rewrites do
+  // not see them. The key also covers the TensorFlow build, whose rewrites
+  // may differ.
+  static Key Fingerprint(
+      const GraphDef& graph_def, const std::string& dataset_node,
+      const std::vector<std::pair<std::string, Tensor>>& input_list,
+      const RewriterConfig& config, const std::string& device_type);
+
+  // Returns whether the cache holds an entry for `key`, and if so, sets
+  // `graph_def` and `dataset_node` to the rewritten graph and the node to
+  // fetch from it.
+  bool Lookup(const Key& key, GraphDef* graph_def, std::string* dataset_node)
+      TF_LOCKS_EXCLUDED(mu_);
+
+  // Records the rewrite of the graph with the given key.
+  void Insert(const Key& key, const GraphDef& graph_def,
+              const std::string& dataset_node) TF_LOCKS_EXCLUDED(mu_);
+
+  // Removes the entry for `key`, e.g. because it could not be instantiated.
+  void Erase(const Key& key) TF_LOCKS_EXCLUDED(mu_);
+
+  // Returns the number of entries held in memory.
+  int64_t size() const TF_LOCKS_EXCLUDED(mu_);
+
+ private:
+  struct Entry {
+    GraphDef graph_def;
+    std::string dataset_node;
+    Fprint128 input_fingerprint;
+    // Position of the key in `lru_`.
+    std::list<uint64>::iterator lru_position;
+  };
+
+  // Returns the path of the file holding the entry for `key`.
+  std::string FilePath(uint64 key) const;
+
+  // Adds an entry to the in-memory cache, evicting the least recently used
+  // entry if the cache is full.
+  void InsertLocked(const Key& key, GraphDef graph_def,
+                    const std::string& dataset_node)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  const int64_t capacity_;
+  const std::string cache_dir_;
+
+  mutable mutex mu_;
+  absl::flat_hash_map<uint64, Entry> entries_ TF_GUARDED_BY(mu_);
+  // Keys of `entries_`, most recently used first.
+  std::list<uint64> lru_ TF_GUARDED_BY(mu_);
+};
+
 }  // namespace data
 }  // namespace tensorflow
 #endif  // !IS_MOBILE_PLATFORM
@@ -16,7 +16,11 @@ limitations under the License.
 
 #include <memory>
 #include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
+#include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
 #include "tensorflow/core/framework/function.h"
 #include "tensorflow/core/framework/function.pb.h"
@@ -26,11 +30,20 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/framework/types.pb.h"
+#include "tensorflow/core/grappler/clusters/virtual_cluster.h"
 #include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/optimizers/meta_optimizer.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/gtl/array_slice.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/path.h"
 #include "tensorflow/core/platform/statusor.h"
 #include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
 #include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/protobuf/config.pb.h"
+#include "tensorflow/core/protobuf/device_properties.pb.h"
+#include "tensorflow/core/protobuf/rewriter_config.pb.h"
 
 namespace tensorflow {
 namespace data {
@@ -86,6 +99,185 @@ TEST(GraphUtilTest, GetFetchNode) {
   EXPECT_THAT(grappler_item->fetch, ElementsAre("Sink"));
 }
 
+// Returns the rewrite cache key of `graph` with the given rewrite config.
+uint64 Fingerprint(const GraphDef& graph,
+                   const std::vector<std::pair<string, Tensor>>& input_list,
+                   const RewriterConfig& config) {
+  return RewriteCache::Fingerprint(graph, "map", input_list, config, "CPU")
+      .hash;
+}
+
+RewriterConfig MapFusionConfig() {
+  return CreateRewriterConfig({"map_fusion"}, {});
+}
+
+TEST(RewriteCacheTest, FingerprintCoversGraphAndConfig) {
+  const uint64 key = Fingerprint(GetRangeSquareDatasetDef(10), {},
+                                 MapFusionConfig());
+  EXPECT_EQ(Fingerprint(GetRangeSquareDatasetDef(10), {}, MapFusionConfig()),
+            key);
+  EXPECT_NE(Fingerprint(GetRangeSquareDatasetDef(20), {}, MapFusionConfig()),
+            key);
+  EXPECT_NE(Fingerprint(GetRangeSquareDatasetDef(10), {},
+                        CreateRewriterConfig({"map_fusion"},
+                                             {"map_fusion:autotune:false"})),
+            key);
+  EXPECT_NE(RewriteCache::Fingerprint(GetRangeSquareDatasetDef(10), "map", {},
+                                      MapFusionConfig(), "GPU")
+                .hash,
+            key);
+}
+
+TEST(RewriteCacheTest, FingerprintIgnoresFedValues) {
+  GraphDef graph = GetRangeSquareDatasetDef(10);
+  const uint64 key =
+      Fingerprint(graph, {{"stop", AsScalar<int64_t>(10)}}, MapFusionConfig());
+  EXPECT_EQ(
+      Fingerprint(graph, {{"stop", AsScalar<int64_t>(20)}}, MapFusionConfig()),
+      key);
+  EXPECT_NE(
+      Fingerprint(graph, {{"start", AsScalar<int64_t>(10)}}, MapFusionConfig()),
+      key);
+}
+
+// Returns a cache key whose hash and input fingerprint are derived from `i`.
+RewriteCache::Key TestKey(uint64 i) { return {i, {i, i}}; }
+
+TEST(RewriteCacheTest, LookupAfterInsert) {
+  RewriteCache cache(/*capacity=*/2, /*cache_dir=*/"");
+  GraphDef graph_def;
+  std::string dataset_node;
+  EXPECT_FALSE(cache.Lookup(TestKey(1), &graph_def, &dataset_node));
+  cache.Insert(TestKey(1), GetRangeSquareDatasetDef(10), "Sink");
+  ASSERT_TRUE(cache.Lookup(TestKey(1), &graph_def, &dataset_node));
+  EXPECT_EQ(graph_def.DebugString(),
+            GetRangeSquareDatasetDef(10).DebugString());
+  EXPECT_EQ(dataset_node, "Sink");
+  cache.Erase(TestKey(1));
+  EXPECT_FALSE(cache.Lookup(TestKey(1), &graph_def, &dataset_node));
+  EXPECT_EQ(cache.size(), 0);
+}
+
+TEST(RewriteCacheTest, EvictsLeastRecentlyUsed) {
+  RewriteCache cache(/*capacity=*/2, /*cache_dir=*/"");
+  GraphDef graph_def;
+  std::string dataset_node;
+  cache.Insert(TestKey(1), GetRangeSquareDatasetDef(1), "Sink");
+  cache.Insert(TestKey(2), GetRangeSquareDatasetDef(2), "Sink");
+  EXPECT_TRUE(cache.Lookup(TestKey(1), &graph_def, &dataset_node));
+  cache.Insert(TestKey(3), GetRangeSquareDatasetDef(3), "Sink");
+  EXPECT_EQ(cache.size(), 2);
+  EXPECT_TRUE(cache.Lookup(TestKey(1), &graph_def, &dataset_node));
+  EXPECT_FALSE(cache.Lookup(TestKey(2), &graph_def, &dataset_node));
+  EXPECT_TRUE(cache.Lookup(TestKey(3), &graph_def, &dataset_node));
+}
+
+TEST(RewriteCacheTest, KeyCollisionIsAMiss) {
+  const std::string cache_dir =
+      io::JoinPath(testing::TmpDir(), "rewrite_cache_collision");
+  const RewriteCache::Key key = {1, {1, 1}};
+  const RewriteCache::Key colliding_key = {1, {2, 2}};
+  GraphDef graph_def;
+  std::string dataset_node;
+  {
+    RewriteCache cache(/*capacity=*/1, cache_dir);
+    cache.Insert(key, GetRangeSquareDatasetDef(10), "Sink");
+    EXPECT_FALSE(cache.Lookup(colliding_key, &graph_def, &dataset_node));
+    EXPECT_TRUE(cache.Lookup(key, &graph_def, &dataset_node));
+  }
+  RewriteCache cache(/*capacity=*/0, cache_dir);
+  EXPECT_FALSE(cache.Lookup(colliding_key, &graph_def, &dataset_node));
+  EXPECT_TRUE(cache.Lookup(key, &graph_def, &dataset_node));
+  cache.Erase(key);
+}
+
+TEST(RewriteCacheTest, Disabled) {
+  RewriteCache cache(/*capacity=*/0, /*cache_dir=*/"");
+  EXPECT_FALSE(cache.enabled());
+  GraphDef graph_def;
+  std::string dataset_node;
+  cache.Insert(TestKey(1), GetRangeSquareDatasetDef(10), "Sink");
+  EXPECT_FALSE(cache.Lookup(TestKey(1), &graph_def, &dataset_node));
+}
+
+TEST(RewriteCacheTest, EntriesOutliveTheCache) {
+  const std::string cache_dir =
+      io::JoinPath(testing::TmpDir(), "rewrite_cache");
+  GraphDef graph_def;
+  std::string dataset_node;
+  {
+    RewriteCache cache(/*capacity=*/1, cache_dir);
+    cache.Insert(TestKey(1), GetRangeSquareDatasetDef(10), "Sink");
+  }
+  {
+    RewriteCache cache(/*capacity=*/0, cache_dir);
+    EXPECT_TRUE(cache.enabled());
+    ASSERT_TRUE(cache.Lookup(TestKey(1), &graph_def, &dataset_node));
+    EXPECT_EQ(graph_def.DebugString(),
+              GetRangeSquareDatasetDef(10).DebugString());
+    EXPECT_EQ(dataset_node, "Sink");
+    cache.Erase(TestKey(1));
+  }
+  RewriteCache cache(/*capacity=*/1, cache_dir);
+  EXPECT_FALSE(cache.Lookup(TestKey(1), &graph_def, &dataset_node));
+}
+
+// Returns a pipeline of `num_maps` chained map datasets.
+GraphDef GetMapChainDatasetDef(int num_maps) {
+  GraphDef graph = GetRangeSquareDatasetDef(10);
+  graph.mutable_node()->RemoveLast();
+  std::string input = "map";
+  for (int i = 0; i < num_maps; ++i) {
+    std::string name = absl::StrCat("map_", i);
+    *graph.add_node() = GetMapNode(name, input, "XTimesX");
+    input = name;
+  }
+  *graph.add_node() = NDef("dataset", "_Retval", /*inputs=*/{input},
+                           {{"T", DT_VARIANT}, {"index", 0}});
+  return graph;
+}
+
+// Measures the time spent rewriting the graph of a pipeline before it can be
+// instantiated, with and without the rewrite cache.
+void BM_RewriteDatasetGraph(::testing::benchmark::State& state) {
+  const bool cached = state.range(0);
+  const GraphDef graph = GetMapChainDatasetDef(state.range(1));
+  ConfigProto config;
+  *config.mutable_graph_options()->mutable_rewrite_options() =
+      CreateRewriterConfig({"map_fusion", "map_parallelization",
+                            "noop_elimination", "shuffle_and_repeat_fusion"},
+                           {});
+  const RewriterConfig& rewriter_config =
+      config.graph_options().rewrite_options();
+  RewriteCache cache(/*capacity=*/1, /*cache_dir=*/"");
+  for (auto s : state) {
+    GraphDef graph_def = graph;
+    TF_ASSERT_OK_AND_ASSIGN(std::string dataset_node,
+                            GetDatasetNode(graph_def));
+    const RewriteCache::Key key = RewriteCache::Fingerprint(
+        graph_def, dataset_node, {}, rewriter_config, "CPU");
+    if (cached && cache.Lookup(key, &graph_def, &dataset_node)) {
+      continue;
+    }
+    std::unique_ptr<grappler::GrapplerItem> item =
+        GetGrapplerItem(&graph_def, &dataset_node, /*add_fake_sinks=*/true);
+    std::unordered_map<std::string, DeviceProperties> device_map;
+    grappler::VirtualCluster cluster(device_map);
+    TF_ASSERT_OK(grappler::RunMetaOptimizer(std::move(*item), config,
+                                            /*cpu_device=*/nullptr, &cluster,
+                                            &graph_def));
+    if (cached) {
+      cache.Insert(key, graph_def, dataset_node);
+    }
+  }
+}
+
+BENCHMARK(BM_RewriteDatasetGraph)
+    ->ArgPair(0, 1)
+    ->ArgPair(1, 1)
+    ->ArgPair(0, 16)
+    ->ArgPair(1, 16);
+
 }  // namespace
 }  // namespace data
 }  // namespace tensorflow
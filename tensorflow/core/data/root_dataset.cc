@@ -31,6 +31,7 @@ constexpr char kCpuBudget[] = "cpu_budget";
 constexpr char kRamBudget[] = "ram_budget_bytes";
 constexpr char kHillClimb[] = "hill_climb";
 constexpr char kGradientDescent[] = "gradient_descent";
+constexpr char kResourceAware[] = "resource_aware";
 constexpr char kIntraOpParallelism[] = "intra_op_parallelism";
 constexpr char kPrivateThreadpoolSize[] = "threadpool_size";
 
@@ -58,7 +59,7 @@ Status RootDataset::FromOptions(DatasetBase* input, DatasetBase** output) {
   }
   params.autotune = ShouldUseAutotuning(options);
   if (params.autotune) {
-    params.autotune_algorithm = model::AutotuneAlgorithm::HILL_CLIMB;
+    params.autotune_algorithm = GetAutotuneAlgorithm();
     params.autotune_cpu_budget = value_or_default(
         options.autotune_options().cpu_budget(), 0, GetCpuBudget());
     params.autotune_ram_budget =
@@ -187,11 +188,15 @@ RootDataset::RootDataset(const DatasetBase* input, Params params)
       input_(input),
       params_(std::move(params)) {
   if (params_.autotune) {
-    traceme_metadata_.push_back(std::make_pair(
-        kAlgorithm,
-        params_.autotune_algorithm == model::AutotuneAlgorithm::HILL_CLIMB
-            ? kHillClimb
-            : kGradientDescent));
+    const char* algorithm = kHillClimb;
+    if (params_.autotune_algorithm ==
+        model::AutotuneAlgorithm::GRADIENT_DESCENT) {
+      algorithm = kGradientDescent;
+    } else if (params_.autotune_algorithm ==
+               model::AutotuneAlgorithm::RESOURCE_AWARE) {
+      algorithm = kResourceAware;
+    }
+    traceme_metadata_.push_back(std::make_pair(kAlgorithm, algorithm));
     traceme_metadata_.push_back(std::make_pair(
         kCpuBudget, strings::Printf("%lld", static_cast<long long>(
                                                 params_.autotune_cpu_budget))));
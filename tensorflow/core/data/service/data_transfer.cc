@@ -16,8 +16,15 @@ limitations under the License.
 #include "tensorflow/core/data/service/data_transfer.h"
 
 #include <functional>
+#include <utility>
+#include <vector>
 
 #include "absl/strings/str_join.h"
+#include "tensorflow/core/data/dataset.pb.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/types.pb.h"
+#include "tensorflow/core/framework/variant.h"
 #include "tensorflow/core/platform/errors.h"
 #include "tensorflow/core/platform/mutex.h"
 
@@ -31,9 +38,7 @@ mutex* get_lock() {
 }
 
 using DataTransferServerFactories =
-    std::unordered_map<std::string,
-                       std::function<std::shared_ptr<DataTransferServer>(
-                           DataTransferServer::GetElementT)>>;
+    std::unordered_map<std::string, DataTransferServer::FactoryT>;
 DataTransferServerFactories& transfer_server_factories() {
   static auto& factories = *new DataTransferServerFactories();
   return factories;
@@ -47,9 +52,32 @@ DataTransferClientFactories& transfer_client_factories() {
 }
 }  // namespace
 
-void DataTransferServer::Register(
-    std::string name,
-    std::function<std::shared_ptr<DataTransferServer>(GetElementT)> factory) {
+int64_t GetElementResultBytes(const GetElementResult& result) {
+  const std::vector<Tensor>& components = result.components;
+  if (components.size() == 1 && components[0].dtype() == DT_VARIANT &&
+      TensorShapeUtils::IsScalar(components[0].shape())) {
+    const CompressedElement* compressed =
+        components[0].scalar<Variant>()().get<CompressedElement>();
+    if (compressed != nullptr) {
+      return compressed->data().size();
+    }
+  }
+  int64_t bytes = 0;
+  for (const Tensor& component : components) {
+    bytes += component.TotalBytes();
+  }
+  return bytes;
+}
+
+Status DataTransferClient::GetElements(const GetElementsRequest& req,
+                                       std::vector<GetElementResult>& results) {
+  GetElementResult result;
+  TF_RETURN_IF_ERROR(GetElement(req.request(), result));
+  results.push_back(std::move(result));
+  return Status::OK();
+}
+
+void DataTransferServer::Register(std::string name, FactoryT factory) {
   mutex_lock l(*get_lock());
   if (!transfer_server_factories().insert({name, factory}).second) {
     LOG(ERROR)
@@ -59,11 +87,12 @@ void DataTransferServer::Register(
 }
 
 Status DataTransferServer::Build(std::string name, GetElementT get_element,
+                                 GetElementsT get_elements,
                                  std::shared_ptr<DataTransferServer>* out) {
   mutex_lock l(*get_lock());
   auto it = transfer_server_factories().find(name);
   if (it != transfer_server_factories().end()) {
-    *out = it->second(get_element);
+    *out = it->second(get_element, get_elements);
     return Status::OK();
   }
 
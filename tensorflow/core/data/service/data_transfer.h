@@ -17,6 +17,7 @@ limitations under the License.
 #define TENSORFLOW_CORE_DATA_SERVICE_DATA_TRANSFER_H_
 
 #include <functional>
+#include <vector>
 
 #include "absl/strings/string_view.h"
 #include "absl/types/optional.h"
@@ -51,6 +52,10 @@ struct GetElementResult {
   TF_DISALLOW_COPY_AND_ASSIGN(GetElementResult);
 };
 
+// Returns the number of bytes of the components of `result`. For a compressed
+// element, returns the size of the compressed data.
+int64_t GetElementResultBytes(const GetElementResult& result);
+
 // Client for communicating with the tf.data service transfer server.
 class DataTransferClient {
  public:
@@ -66,6 +71,12 @@ class DataTransferClient {
   virtual Status GetElement(const GetElementRequest& req,
                             GetElementResult& result) = 0;
 
+  // Fetches up to `req.max_elements()` next elements, appending them to
+  // `results`. See worker.proto for the semantics of the request. The default
+  // implementation fetches a single element.
+  virtual Status GetElements(const GetElementsRequest& req,
+                             std::vector<GetElementResult>& results);
+
   // Makes a best effort to cancel all outstanding calls in progress for the
   // client, and causes further calls to return Cancelled status.
   virtual void TryCancel() = 0;
@@ -83,6 +94,11 @@ class DataTransferServer {
  public:
   using GetElementT =
       std::function<Status(const GetElementRequest*, GetElementResult*)>;
+  // Serves a GetElements request, appending the results. See worker.proto.
+  using GetElementsT = std::function<Status(const GetElementsRequest*,
+                                            std::vector<GetElementResult>*)>;
+  using FactoryT = std::function<std::shared_ptr<DataTransferServer>(
+      GetElementT, GetElementsT)>;
   virtual ~DataTransferServer() = default;
 
   // Starts DataTransferServer, it should be available for requests afterwards.
@@ -92,12 +108,12 @@ class DataTransferServer {
   virtual int get_port() = 0;
 
   // Register a DataTransferServer factory under `name`.
-  static void Register(
-      std::string name,
-      std::function<std::shared_ptr<DataTransferServer>(GetElementT)> factory);
+  static void Register(std::string name, FactoryT factory);
 
   // Builds a DataTransferServer from the factory registered with `name`.
+  // Servers that do not support batched requests may ignore `get_elements`.
   static Status Build(std::string name, GetElementT get_element,
+                      GetElementsT get_elements,
                       std::shared_ptr<DataTransferServer>* out);
 };
 
@@ -37,12 +37,12 @@ class TestDataTransferServer : public DataTransferServer {
 
 TEST(DataTransferTest, RegisterDataTransferServerBuilder) {
   bool called = false;
-  DataTransferServer::Register("test", [&called](auto _) {
+  DataTransferServer::Register("test", [&called](auto, auto) {
     return std::make_shared<TestDataTransferServer>(&called);
   });
 
   std::shared_ptr<DataTransferServer> server;
-  TF_ASSERT_OK(DataTransferServer::Build("test", {}, &server));
+  TF_ASSERT_OK(DataTransferServer::Build("test", {}, {}, &server));
   EXPECT_FALSE(called);
 
   TF_ASSERT_OK(server->Start());
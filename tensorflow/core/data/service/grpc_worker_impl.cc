@@ -60,6 +60,7 @@ void GrpcWorkerImpl::Stop() {
   }
 HANDLER(ProcessTask);
 HANDLER(GetElement);
+HANDLER(GetElements);
 HANDLER(GetWorkerTasks);
 #undef HANDLER
 
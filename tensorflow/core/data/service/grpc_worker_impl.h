@@ -18,6 +18,7 @@ limitations under the License.
 
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "grpcpp/server_builder.h"
 #include "tensorflow/core/data/service/worker.grpc.pb.h"
@@ -49,12 +50,22 @@ class GrpcWorkerImpl : public WorkerService::Service {
     };
   }
 
+  std::function<Status(const GetElementsRequest*,
+                       std::vector<GetElementResult>*)>
+  get_elements_getter() {
+    return [this](const GetElementsRequest* request,
+                  std::vector<GetElementResult>* results) {
+      return impl_->GetElementResults(request, results);
+    };
+  }
+
 #define HANDLER(method)                                 \
   ::grpc::Status method(::grpc::ServerContext* context, \
                         const method##Request* request, \
                         method##Response* response) override;
   HANDLER(ProcessTask);
   HANDLER(GetElement);
+  HANDLER(GetElements);
   HANDLER(GetWorkerTasks);
 #undef HANDLER
 
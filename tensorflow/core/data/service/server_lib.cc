@@ -145,7 +145,8 @@ Status WorkerGrpcDataServer::StartServiceInternal() {
   std::string transfer_protocol = config_.data_transfer_protocol();
   if (!transfer_protocol.empty() && transfer_protocol != "grpc") {
     TF_RETURN_IF_ERROR(DataTransferServer::Build(
-        transfer_protocol, service_->get_element_getter(), &transfer_server_));
+        transfer_protocol, service_->get_element_getter(),
+        service_->get_elements_getter(), &transfer_server_));
     TF_RETURN_IF_ERROR(transfer_server_->Start());
     LOG(INFO) << "Data transfer server started at 0.0.0.0:"
               << transfer_server_->get_port();
@@ -0,0 +1,900 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/data/service/shm_data_transfer.h"
+
+#if !defined(PLATFORM_WINDOWS)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include <atomic>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "tensorflow/core/data/dataset.pb.h"
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/framework/variant.h"
+#include "tensorflow/core/platform/coding.h"
+#include "tensorflow/core/platform/error.h"
+#include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/random.h"
+#include "tensorflow/core/util/env_var.h"
+
+namespace tensorflow {
+namespace data {
+
+#if !defined(PLATFORM_WINDOWS)
+
+namespace {
+
+constexpr uint64 kShmRegionMagic = 0x7466646174617368;  // "tfdatash"
+// The header of a region is followed by the states of its slots, and then by
+// the slots, all aligned so that the components stored in the slots can be
+// used by kernels.
+constexpr int64_t kAlignment = Allocator::kAllocatorAlignment;
+constexpr int64_t kHeaderBytes = kAlignment;
+// The maximum size of the messages exchanged over the socket.
+constexpr uint64 kMaxMessageBytes = std::numeric_limits<int32>::max();
+// The number of socket ids tried by a server before giving up.
+constexpr int kMaxBindAttempts = 10;
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2,
+              "Slot states must be lock free to be shared across processes.");
+
+int64_t RoundUp(int64_t n) {
+  return (n + kAlignment - 1) / kAlignment * kAlignment;
+}
+
+// Returns the value of the environment variable `name`, or `default_value` if
+// it is unset or is not a positive integer.
+int64_t ReadPositiveOption(const char* name, int64_t default_value) {
+  int64_t value = default_value;
+  Status s = ReadInt64FromEnvVar(name, default_value, &value);
+  if (!s.ok()) {
+    LOG(ERROR) << "Invalid " << name << ": " << s
+               << ". Using the default of " << default_value << ".";
+    return default_value;
+  }
+  if (value <= 0) {
+    LOG(ERROR) << "Invalid " << name << ": " << value
+               << ". It must be positive. Using the default of "
+               << default_value << ".";
+    return default_value;
+  }
+  return value;
+}
+
+ShmTransferOptions GetShmTransferOptions() {
+  ShmTransferOptions options;
+  options.num_slots =
+      ReadPositiveOption("TF_DATA_SHM_TRANSFER_NUM_SLOTS", options.num_slots);
+  options.slot_bytes =
+      ReadPositiveOption("TF_DATA_SHM_TRANSFER_SLOT_BYTES", options.slot_bytes);
+  return options;
+}
+
+// The sockets of the servers run by a user are created in a directory that
+// only this user can access.
+std::string SocketDirectory() {
+  return absl::StrCat("/tmp/tf_data_shm_transfer_", getuid());
+}
+
+std::string SocketPath(int id) {
+  return absl::StrCat(SocketDirectory(), "/", id, ".sock");
+}
+
+// Checks that `dir` is a directory owned by the current user and inaccessible
+// to other users, so that no other user can create or connect to the sockets
+// in it.
+Status CheckSocketDirectory(const std::string& dir) {
+  struct stat st;
+  if (lstat(dir.c_str(), &st) != 0) {
+    return IOError(absl::StrCat("Failed to stat ", dir), errno);
+  }
+  if (!S_ISDIR(st.st_mode) || st.st_uid != getuid() ||
+      (st.st_mode & (S_IRWXG | S_IRWXO)) != 0) {
+    return errors::PermissionDenied(
+        dir,
+        " must be a directory owned by the current user and inaccessible to "
+        "other users to hold shared memory transfer sockets.");
+  }
+  return Status::OK();
+}
+
+Status CreateSocketDirectory(const std::string& dir) {
+  if (mkdir(dir.c_str(), 0700) != 0 && errno != EEXIST) {
+    return IOError(absl::StrCat("Failed to create ", dir), errno);
+  }
+  return CheckSocketDirectory(dir);
+}
+
+Status SocketAddress(const std::string& path, struct sockaddr_un* addr) {
+  memset(addr, 0, sizeof(*addr));
+  addr->sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr->sun_path)) {
+    return errors::InvalidArgument("Socket path ", path, " is too long.");
+  }
+  memcpy(addr->sun_path, path.data(), path.size());
+  return Status::OK();
+}
+
+// Messages are sent over the socket as a fixed64 length followed by the
+// serialized message.
+Status WriteFully(int fd, const char* data, size_t size) {
+  while (size > 0) {
+    ssize_t n = send(fd, data, size, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return IOError("Failed to send to shared memory transfer socket", errno);
+    }
+    data += n;
+    size -= n;
+  }
+  return Status::OK();
+}
+
+Status ReadFully(int fd, char* data, size_t size) {
+  while (size > 0) {
+    ssize_t n = recv(fd, data, size, 0);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return IOError("Failed to receive from shared memory transfer socket",
+                     errno);
+    }
+    if (n == 0) {
+      return errors::Unavailable("Shared memory transfer socket was closed.");
+    }
+    data += n;
+    size -= n;
+  }
+  return Status::OK();
+}
+
+Status SendMessage(int fd, const std::string& message) {
+  char length[sizeof(uint64)];
+  core::EncodeFixed64(length, message.size());
+  TF_RETURN_IF_ERROR(WriteFully(fd, length, sizeof(length)));
+  return WriteFully(fd, message.data(), message.size());
+}
+
+Status ReceiveMessage(int fd, std::string* message) {
+  char length[sizeof(uint64)];
+  TF_RETURN_IF_ERROR(ReadFully(fd, length, sizeof(length)));
+  // The length comes from the peer, so it is checked before allocating. No
+  // valid message is larger than the protos that can be parsed.
+  const uint64 size = core::DecodeFixed64(length);
+  if (size > kMaxMessageBytes) {
+    return errors::DataLoss("Received a shared memory transfer message of ",
+                            size, " bytes, more than the maximum of ",
+                            kMaxMessageBytes, " bytes.");
+  }
+  message->resize(size);
+  return ReadFully(fd, &(*message)[0], message->size());
+}
+
+template <typename T>
+Status ReceiveProto(int fd, T* proto) {
+  std::string message;
+  TF_RETURN_IF_ERROR(ReceiveMessage(fd, &message));
+  if (!proto->ParseFromString(message)) {
+    return errors::DataLoss("Failed to parse ", proto->GetTypeName(),
+                            " received from shared memory transfer socket.");
+  }
+  return Status::OK();
+}
+
+// Returns whether `element` can be stored in a slot of `slot_bytes` bytes.
+bool FitsInSlot(const std::vector<Tensor>& element, int64_t slot_bytes) {
+  int64_t bytes = 0;
+  for (const Tensor& component : element) {
+    if (!DataTypeCanUseMemcpy(component.dtype())) {
+      return false;
+    }
+    bytes = RoundUp(bytes) + component.TotalBytes();
+  }
+  return bytes <= slot_bytes;
+}
+
+bool IsCompressedElement(const std::vector<Tensor>& element) {
+  return element.size() == 1 && element[0].dtype() == DT_VARIANT &&
+         TensorShapeUtils::IsScalar(element[0].shape());
+}
+
+}  // namespace
+
+// A shared memory region divided into slots that each hold an element. A slot
+// is acquired by the server before it stores an element, and released by the
+// client once the element is no longer used.
+class ShmRegion {
+ public:
+  ~ShmRegion() { munmap(base_, size_); }
+
+  // Creates the region `name`, which can be opened until it is unlinked.
+  static Status Create(const std::string& name,
+                       const ShmTransferOptions& options,
+                       std::shared_ptr<ShmRegion>* out) {
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+      return IOError(absl::StrCat("Failed to create shared memory ", name),
+                     errno);
+    }
+    const int64_t slot_bytes = RoundUp(options.slot_bytes);
+    const int64_t data_offset =
+        RoundUp(kHeaderBytes + options.num_slots * sizeof(std::atomic<uint32>));
+    const size_t size = data_offset + options.num_slots * slot_bytes;
+    // The pages are only backed by memory once they are written to, and
+    // start zeroed, so all the slots are initially free.
+    if (ftruncate(fd, size) != 0) {
+      Status s = IOError(absl::StrCat("Failed to resize shared memory ", name),
+                         errno);
+      close(fd);
+      shm_unlink(name.c_str());
+      return s;
+    }
+    std::shared_ptr<ShmRegion> region;
+    Status s = Map(name, fd, size, &region);
+    close(fd);
+    if (!s.ok()) {
+      shm_unlink(name.c_str());
+      return s;
+    }
+    Header* header = region->header();
+    header->num_slots = options.num_slots;
+    header->slot_bytes = slot_bytes;
+    header->data_offset = data_offset;
+    header->magic = kShmRegionMagic;
+    *out = std::move(region);
+    return Status::OK();
+  }
+
+  // Opens the region `name` created by the server.
+  static Status Open(const std::string& name,
+                     std::shared_ptr<ShmRegion>* out) {
+    int fd = shm_open(name.c_str(), O_RDWR, 0600);
+    if (fd < 0) {
+      return IOError(
+          absl::StrCat("Failed to open shared memory ", name,
+                       ". The shared memory data transfer protocol requires "
+                       "the worker to run on the same host as the client"),
+          errno);
+    }
+    struct stat st;
+    std::shared_ptr<ShmRegion> region;
+    Status s;
+    if (fstat(fd, &st) != 0) {
+      s = IOError(absl::StrCat("Failed to stat shared memory ", name), errno);
+    } else if (st.st_size < kHeaderBytes) {
+      s = errors::DataLoss("Shared memory ", name, " is too small.");
+    } else {
+      s = Map(name, fd, st.st_size, &region);
+    }
+    close(fd);
+    TF_RETURN_IF_ERROR(s);
+    const Header* header = region->header();
+    if (header->magic != kShmRegionMagic || header->num_slots < 0 ||
+        header->slot_bytes < 0 ||
+        header->data_offset + header->num_slots * header->slot_bytes >
+            st.st_size) {
+      return errors::DataLoss("Shared memory ", name,
+                              " has an invalid header.");
+    }
+    *out = std::move(region);
+    return Status::OK();
+  }
+
+  int64_t num_slots() const { return header()->num_slots; }
+  int64_t slot_bytes() const { return header()->slot_bytes; }
+
+  char* slot_data(int64_t slot) {
+    return base_ + header()->data_offset + slot * header()->slot_bytes;
+  }
+
+  // Acquires a free slot, returning -1 if every slot is held.
+  int64_t AcquireSlot() {
+    const int64_t n = num_slots();
+    for (int64_t i = 0; i < n; ++i) {
+      const int64_t slot = (next_slot_ + i) % n;
+      uint32 expected = 0;
+      if (states()[slot].compare_exchange_strong(expected, 1,
+                                                 std::memory_order_acquire)) {
+        next_slot_ = slot + 1;
+        return slot;
+      }
+    }
+    return -1;
+  }
+
+  void ReleaseSlot(int64_t slot) {
+    states()[slot].store(0, std::memory_order_release);
+  }
+
+ private:
+  struct Header {
+    uint64 magic;
+    int64_t num_slots;
+    int64_t slot_bytes;
+    int64_t data_offset;
+  };
+  static_assert(sizeof(Header) <= kHeaderBytes, "Header is too large.");
+
+  ShmRegion(char* base, size_t size) : base_(base), size_(size) {}
+
+  static Status Map(const std::string& name, int fd, size_t size,
+                    std::shared_ptr<ShmRegion>* out) {
+    void* base =
+        mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+      return IOError(absl::StrCat("Failed to map shared memory ", name),
+                     errno);
+    }
+    out->reset(new ShmRegion(static_cast<char*>(base), size));
+    return Status::OK();
+  }
+
+  Header* header() const { return reinterpret_cast<Header*>(base_); }
+  std::atomic<uint32>* states() {
+    return reinterpret_cast<std::atomic<uint32>*>(base_ + kHeaderBytes);
+  }
+
+  char* const base_;
+  const size_t size_;
+  // Only used by the server, which acquires the slots round robin.
+  int64_t next_slot_ = 0;
+};
+
+namespace {
+
+// Releases a slot once the last tensor aliasing it is destroyed.
+class SlotReference {
+ public:
+  SlotReference(std::shared_ptr<ShmRegion> region, int64_t slot)
+      : region_(std::move(region)), slot_(slot) {}
+  ~SlotReference() { region_->ReleaseSlot(slot_); }
+
+  ShmRegion& region() const { return *region_; }
+  int64_t slot() const { return slot_; }
+
+ private:
+  const std::shared_ptr<ShmRegion> region_;
+  const int64_t slot_;
+};
+
+// A TensorBuffer that aliases part of a slot. Since the slot is reused once it
+// is released, the buffer does not own its memory, which prevents kernels from
+// forwarding it to their outputs.
+class SlotTensorBuffer : public TensorBuffer {
+ public:
+  SlotTensorBuffer(std::shared_ptr<SlotReference> slot, int64_t offset,
+                   size_t size)
+      : TensorBuffer(slot->region().slot_data(slot->slot()) + offset),
+        slot_(std::move(slot)),
+        size_(size) {}
+
+  size_t size() const override { return size_; }
+  TensorBuffer* root_buffer() override { return this; }
+  void FillAllocationDescription(AllocationDescription* proto) const override {
+    proto->set_requested_bytes(size_);
+    proto->set_allocator_name("ShmDataTransfer");
+  }
+  bool OwnsMemory() const override { return false; }
+
+ private:
+  const std::shared_ptr<SlotReference> slot_;
+  const size_t size_;
+};
+
+// Builds `result` from `response`, with the components stored in shared memory
+// aliasing `slot`.
+Status ParseElement(ShmGetElementResponse& response,
+                    const std::shared_ptr<SlotReference>& slot,
+                    GetElementResult& result) {
+  GetElementResponse& resp = *response.mutable_response();
+  result.element_index = resp.element_index();
+  result.end_of_sequence = resp.end_of_sequence();
+  result.skip = resp.skip_task();
+  switch (resp.element_case()) {
+    case GetElementResponse::kCompressed: {
+      Tensor tensor(DT_VARIANT, TensorShape{});
+      tensor.scalar<Variant>()() = std::move(*resp.mutable_compressed());
+      result.components.push_back(tensor);
+      break;
+    }
+    case GetElementResponse::kUncompressed: {
+      const auto& components = resp.uncompressed().components();
+      if (response.offsets_size() != components.size()) {
+        return errors::DataLoss("Expected ", components.size(),
+                                " component offsets, but got ",
+                                response.offsets_size());
+      }
+      for (int i = 0; i < components.size(); ++i) {
+        const TensorProto& component = components[i];
+        const int64_t offset = response.offsets(i);
+        if (offset < 0) {
+          result.components.emplace_back();
+          if (!result.components.back().FromProto(component)) {
+            return errors::Internal("Failed to parse tensor.");
+          }
+          continue;
+        }
+        const DataType dtype = component.dtype();
+        if (!slot || !DataTypeCanUseMemcpy(dtype) ||
+            !TensorShape::IsValid(component.tensor_shape())) {
+          return errors::Internal("Failed to parse tensor.");
+        }
+        const TensorShape shape(component.tensor_shape());
+        const size_t size = shape.num_elements() * DataTypeSize(dtype);
+        if (offset + size > slot->region().slot_bytes()) {
+          return errors::DataLoss("Component of ", size, " bytes at offset ",
+                                  offset, " exceeds the shared memory slot.");
+        }
+        auto* buffer = new SlotTensorBuffer(slot, offset, size);
+        result.components.emplace_back(dtype, shape, buffer);
+        buffer->Unref();
+      }
+      break;
+    }
+    case GetElementResponse::ELEMENT_NOT_SET:
+      break;
+  }
+  return Status::OK();
+}
+
+}  // namespace
+
+ShmDataTransferServer::ShmDataTransferServer(GetElementT get_element,
+                                             const ShmTransferOptions& options,
+                                             GetElementsT get_elements)
+    : get_element_(std::move(get_element)),
+      get_elements_(std::move(get_elements)),
+      options_(options) {}
+
+ShmDataTransferServer::~ShmDataTransferServer() {
+  std::vector<std::unique_ptr<Connection>> connections;
+  {
+    mutex_lock l(mu_);
+    cancelled_ = true;
+    if (listen_fd_ >= 0) {
+      shutdown(listen_fd_, SHUT_RDWR);
+    }
+    for (const auto& connection : connections_) {
+      shutdown(connection->fd, SHUT_RDWR);
+    }
+  }
+  accept_thread_.reset();
+  {
+    mutex_lock l(mu_);
+    connections = std::move(connections_);
+  }
+  for (const auto& connection : connections) {
+    connection->thread.reset();
+    close(connection->fd);
+  }
+  if (listen_fd_ >= 0) {
+    close(listen_fd_);
+  }
+  if (!socket_path_.empty()) {
+    unlink(socket_path_.c_str());
+  }
+}
+
+Status ShmDataTransferServer::Start() {
+  TF_RETURN_IF_ERROR(CreateSocketDirectory(SocketDirectory()));
+  listen_fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listen_fd_ < 0) {
+    return IOError("Failed to create shared memory transfer socket", errno);
+  }
+  // The socket is named by a random id, which is advertised as the port of the
+  // server. Ids left behind by servers that crashed are skipped.
+  for (int attempt = 1;; ++attempt) {
+    const int id = 1 + random::New64() % std::numeric_limits<int32>::max();
+    const std::string path = SocketPath(id);
+    struct sockaddr_un addr;
+    TF_RETURN_IF_ERROR(SocketAddress(path, &addr));
+    if (bind(listen_fd_, reinterpret_cast<struct sockaddr*>(&addr),
+             sizeof(addr)) == 0) {
+      port_ = id;
+      socket_path_ = path;
+      break;
+    }
+    if (errno != EADDRINUSE || attempt == kMaxBindAttempts) {
+      return IOError(
+          absl::StrCat("Failed to bind shared memory transfer socket ", path),
+          errno);
+    }
+  }
+  if (chmod(socket_path_.c_str(), 0600) != 0) {
+    return IOError("Failed to restrict shared memory transfer socket", errno);
+  }
+  if (listen(listen_fd_, SOMAXCONN) != 0) {
+    return IOError("Failed to listen on shared memory transfer socket", errno);
+  }
+  accept_thread_ = absl::WrapUnique(Env::Default()->StartThread(
+      {}, "tf_data_shm_transfer_accept", [this]() { AcceptLoop(); }));
+  return Status::OK();
+}
+
+int ShmDataTransferServer::get_port() { return port_; }
+
+void ShmDataTransferServer::AcceptLoop() {
+  while (true) {
+    int fd = accept(listen_fd_, nullptr, nullptr);
+    mutex_lock l(mu_);
+    if (cancelled_) {
+      if (fd >= 0) close(fd);
+      return;
+    }
+    if (fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) continue;
+      LOG(ERROR) << IOError("Failed to accept shared memory transfer connection",
+                            errno);
+      return;
+    }
+    // Cleans up the connections that were closed by their clients.
+    for (auto it = connections_.begin(); it != connections_.end();) {
+      if ((*it)->done) {
+        (*it)->thread.reset();
+        close((*it)->fd);
+        it = connections_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+#if defined(SO_PEERCRED)
+    // The socket directory already keeps other users out. This also rejects
+    // the clients that inherited a socket from a process of this user.
+    struct ucred cred;
+    socklen_t cred_len = sizeof(cred);
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &cred_len) != 0 ||
+        cred.uid != getuid()) {
+      LOG(WARNING) << "Rejected a shared memory transfer connection from "
+                      "another user.";
+      close(fd);
+      continue;
+    }
+#endif  // defined(SO_PEERCRED)
+    auto connection = absl::make_unique<Connection>();
+    connection->fd = fd;
+    Connection* c = connection.get();
+    connection->thread = absl::WrapUnique(Env::Default()->StartThread(
+        {}, "tf_data_shm_transfer", [this, c]() { ServeConnection(c); }));
+    connections_.push_back(std::move(connection));
+  }
+}
+
+void ShmDataTransferServer::ServeConnection(Connection* connection) {
+  Status s = ServeRequests(connection->fd);
+  VLOG(2) << "Shared memory transfer connection closed: " << s;
+  // Unblocks the client if the connection failed on the server side.
+  shutdown(connection->fd, SHUT_RDWR);
+  mutex_lock l(mu_);
+  connection->done = true;
+}
+
+Status ShmDataTransferServer::ServeRequests(int fd) {
+  // Each connection gets its own region, which is unlinked as soon as the
+  // client mapped it, so that it is freed even if either process crashes.
+  const std::string name = absl::StrCat(
+      "/tf_data_", getpid(), "_", absl::Hex(random::New64(), absl::kZeroPad16));
+  std::shared_ptr<ShmRegion> region;
+  TF_RETURN_IF_ERROR(ShmRegion::Create(name, options_, &region));
+  Status s = SendMessage(fd, name);
+  std::string ack;
+  if (s.ok()) {
+    s = ReceiveMessage(fd, &ack);
+  }
+  shm_unlink(name.c_str());
+  TF_RETURN_IF_ERROR(s);
+
+  while (true) {
+    GetElementsRequest request;
+    TF_RETURN_IF_ERROR(ReceiveProto(fd, &request));
+    std::vector<GetElementResult> results;
+    Status status;
+    if (get_elements_ && request.max_elements() > 1) {
+      status = get_elements_(&request, &results);
+    } else {
+      results.emplace_back();
+      status = get_element_(&request.request(), &results.back());
+    }
+    ShmGetElementsResponse response;
+    for (int64_t i = 0; status.ok() && i < results.size(); ++i) {
+      ShmGetElementResponse* element = response.add_elements();
+      element->set_slot(-1);
+      status = MoveElementToResponse(std::move(results[i]), *region, *element);
+    }
+    if (!status.ok()) {
+      for (const ShmGetElementResponse& element : response.elements()) {
+        if (element.slot() >= 0) {
+          region->ReleaseSlot(element.slot());
+        }
+      }
+      response.Clear();
+      response.set_error_code(status.code());
+      response.set_error_message(status.error_message());
+    }
+    TF_RETURN_IF_ERROR(SendMessage(fd, response.SerializeAsString()));
+  }
+}
+
+Status ShmDataTransferServer::MoveElementToResponse(
+    GetElementResult&& result, ShmRegion& region,
+    ShmGetElementResponse& response) {
+  GetElementResponse* resp = response.mutable_response();
+  resp->set_element_index(result.element_index);
+  resp->set_end_of_sequence(result.end_of_sequence);
+  resp->set_skip_task(result.skip);
+  std::vector<Tensor>& element = result.components;
+  if (element.empty()) {
+    return Status::OK();
+  }
+  if (IsCompressedElement(element)) {
+    Variant& variant = element[0].scalar<Variant>()();
+    CompressedElement* compressed = variant.get<CompressedElement>();
+    if (compressed == nullptr) {
+      return errors::FailedPrecondition(
+          "Expected dataset to produce a CompressedElement variant tensor, but "
+          "it produced ",
+          variant.TypeName());
+    }
+    *resp->mutable_compressed() = std::move(*compressed);
+    return Status::OK();
+  }
+  UncompressedElement* uncompressed = resp->mutable_uncompressed();
+  const int64_t slot = FitsInSlot(element, region.slot_bytes())
+                           ? region.AcquireSlot()
+                           : int64_t{-1};
+  if (slot < 0) {
+    for (const Tensor& component : element) {
+      component.AsProtoTensorContent(uncompressed->add_components());
+      response.add_offsets(-1);
+    }
+    return Status::OK();
+  }
+  response.set_slot(slot);
+  char* data = region.slot_data(slot);
+  int64_t offset = 0;
+  for (const Tensor& component : element) {
+    offset = RoundUp(offset);
+    TensorProto* proto = uncompressed->add_components();
+    proto->set_dtype(component.dtype());
+    component.shape().AsProto(proto->mutable_tensor_shape());
+    const StringPiece bytes = component.tensor_data();
+    memcpy(data + offset, bytes.data(), bytes.size());
+    response.add_offsets(offset);
+    offset += bytes.size();
+  }
+  return Status::OK();
+}
+
+ShmDataTransferClient::ShmDataTransferClient(const std::string& address,
+                                             int fd,
+                                             std::shared_ptr<ShmRegion> region)
+    : address_(address), fd_(fd), region_(std::move(region)) {
+  VLOG(2) << "Create ShmDataTransferClient for worker " << address_ << ".";
+}
+
+ShmDataTransferClient::~ShmDataTransferClient() { close(fd_); }
+
+Status ShmDataTransferClient::Create(const std::string& address,
+                                     std::unique_ptr<DataTransferClient>* out) {
+  const size_t colon = address.rfind(':');
+  if (colon == std::string::npos) {
+    return errors::InvalidArgument(
+        "Expected a shared memory transfer address of the form host:port, but "
+        "got ",
+        address);
+  }
+  // The port names the socket of the server, which runs on the same host.
+  int id;
+  if (!absl::SimpleAtoi(address.substr(colon + 1), &id) || id <= 0) {
+    return errors::InvalidArgument("Invalid shared memory transfer port in ",
+                                   address);
+  }
+  TF_RETURN_IF_ERROR(CheckSocketDirectory(SocketDirectory()));
+  struct sockaddr_un addr;
+  TF_RETURN_IF_ERROR(SocketAddress(SocketPath(id), &addr));
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return IOError("Failed to create shared memory transfer socket", errno);
+  }
+  if (connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) !=
+      0) {
+    Status s = IOError(
+        absl::StrCat("Failed to connect to ", address,
+                     ". The shared memory data transfer protocol requires the "
+                     "worker to run on the same host and as the same user as "
+                     "the client"),
+        errno);
+    close(fd);
+    return s;
+  }
+
+  std::string name;
+  std::shared_ptr<ShmRegion> region;
+  Status s = ReceiveMessage(fd, &name);
+  if (s.ok()) {
+    s = ShmRegion::Open(name, &region);
+  }
+  if (s.ok()) {
+    s = SendMessage(fd, "");
+  }
+  if (!s.ok()) {
+    close(fd);
+    return s;
+  }
+  out->reset(new ShmDataTransferClient(address, fd, std::move(region)));
+  return Status::OK();
+}
+
+Status ShmDataTransferClient::GetElement(const GetElementRequest& req,
+                                         GetElementResult& result) {
+  VLOG(3) << "GetElement for task " << req.task_id()
+          << " from shared memory worker server " << address_ << ".";
+  GetElementsRequest request;
+  *request.mutable_request() = req;
+  request.set_max_elements(1);
+  std::vector<GetElementResult> results;
+  TF_RETURN_IF_ERROR(Fetch(request, results));
+  if (results.size() != 1) {
+    return errors::DataLoss("Expected a single element, but got ",
+                            results.size());
+  }
+  result = std::move(results[0]);
+  return Status::OK();
+}
+
+Status ShmDataTransferClient::GetElements(
+    const GetElementsRequest& req, std::vector<GetElementResult>& results) {
+  VLOG(3) << "GetElements for task " << req.request().task_id()
+          << " from shared memory worker server " << address_ << ".";
+  return Fetch(req, results);
+}
+
+Status ShmDataTransferClient::Fetch(const GetElementsRequest& req,
+                                    std::vector<GetElementResult>& results) {
+  {
+    mutex_lock l(mu_);
+    if (cancelled_) {
+      return errors::Cancelled("Client was cancelled.");
+    }
+  }
+  ShmGetElementsResponse response;
+  {
+    mutex_lock l(request_mu_);
+    TF_RETURN_IF_ERROR(SendMessage(fd_, req.SerializeAsString()));
+    TF_RETURN_IF_ERROR(ReceiveProto(fd_, &response));
+  }
+  // Each slot is released if no component ends up aliasing it, including when
+  // another element of the response is invalid.
+  std::vector<std::shared_ptr<SlotReference>> slots;
+  for (const ShmGetElementResponse& element : response.elements()) {
+    if (element.slot() >= region_->num_slots()) {
+      return errors::DataLoss("Invalid shared memory slot ", element.slot());
+    }
+    slots.push_back(element.slot() >= 0 ? std::make_shared<SlotReference>(
+                                              region_, element.slot())
+                                        : nullptr);
+  }
+  if (response.error_code() != error::OK) {
+    return Status(static_cast<error::Code>(response.error_code()),
+                  response.error_message());
+  }
+  if (response.elements().empty()) {
+    return errors::DataLoss("Received no element from shared memory worker ",
+                            address_);
+  }
+  std::vector<GetElementResult> parsed(response.elements_size());
+  for (int i = 0; i < response.elements_size(); ++i) {
+    TF_RETURN_IF_ERROR(
+        ParseElement(*response.mutable_elements(i), slots[i], parsed[i]));
+  }
+  for (GetElementResult& result : parsed) {
+    results.push_back(std::move(result));
+  }
+  return Status::OK();
+}
+
+void ShmDataTransferClient::TryCancel() {
+  VLOG(2) << "Cancel ShmDataTransferClient.";
+  mutex_lock l(mu_);
+  cancelled_ = true;
+  // Unblocks the outstanding request.
+  shutdown(fd_, SHUT_RDWR);
+}
+
+class ShmTransferServerRegistrar {
+ public:
+  ShmTransferServerRegistrar() {
+    DataTransferServer::Register(
+        kShmTransferProtocol,
+        [](DataTransferServer::GetElementT get_element,
+           DataTransferServer::GetElementsT get_elements) {
+          return std::make_shared<ShmDataTransferServer>(
+              std::move(get_element), GetShmTransferOptions(),
+              std::move(get_elements));
+        });
+  }
+};
+static ShmTransferServerRegistrar shm_server_registrar;
+
+class ShmTransferClientRegistrar {
+ public:
+  ShmTransferClientRegistrar() {
+    DataTransferClient::Register(
+        kShmTransferProtocol, [](DataTransferClient::Config config,
+                                 std::unique_ptr<DataTransferClient>* out) {
+          return ShmDataTransferClient::Create(config.address, out);
+        });
+  }
+};
+static ShmTransferClientRegistrar shm_client_registrar;
+
+#else  // defined(PLATFORM_WINDOWS)
+
+namespace {
+
+Status ShmTransferUnimplemented() {
+  return errors::Unimplemented(
+      "The shared memory data transfer protocol is not supported on Windows.");
+}
+
+class UnimplementedShmDataTransferServer : public DataTransferServer {
+ public:
+  Status Start() override { return ShmTransferUnimplemented(); }
+  int get_port() override { return -1; }
+};
+
+}  // namespace
+
+class ShmTransferServerRegistrar {
+ public:
+  ShmTransferServerRegistrar() {
+    DataTransferServer::Register(
+        kShmTransferProtocol, [](DataTransferServer::GetElementT get_element,
+                                 DataTransferServer::GetElementsT get_elements) {
+          return std::make_shared<UnimplementedShmDataTransferServer>();
+        });
+  }
+};
+static ShmTransferServerRegistrar shm_server_registrar;
+
+class ShmTransferClientRegistrar {
+ public:
+  ShmTransferClientRegistrar() {
+    DataTransferClient::Register(
+        kShmTransferProtocol, [](DataTransferClient::Config config,
+                                 std::unique_ptr<DataTransferClient>* out) {
+          return ShmTransferUnimplemented();
+        });
+  }
+};
+static ShmTransferClientRegistrar shm_client_registrar;
+
+#endif  // !defined(PLATFORM_WINDOWS)
+
+}  // namespace data
+}  // namespace tensorflow
@@ -0,0 +1,141 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_DATA_SERVICE_SHM_DATA_TRANSFER_H_
+#define TENSORFLOW_CORE_DATA_SERVICE_SHM_DATA_TRANSFER_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/data/service/data_transfer.h"
+#include "tensorflow/core/data/service/worker.pb.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/status.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+
+namespace tensorflow {
+namespace data {
+
+constexpr const char kShmTransferProtocol[] = "shm";
+
+// Options of the shared memory region that a `ShmDataTransferServer` shares
+// with each of its clients. The defaults can be overridden with the
+// `TF_DATA_SHM_TRANSFER_NUM_SLOTS` and `TF_DATA_SHM_TRANSFER_SLOT_BYTES`
+// environment variables of the worker.
+struct ShmTransferOptions {
+  // The maximum number of elements held by a client at once.
+  int64_t num_slots = 16;
+  // The maximum size of the components of an element stored in a slot.
+  int64_t slot_bytes = 16 << 20;
+};
+
+class ShmRegion;
+
+// Transfers elements to clients running on the same host through shared
+// memory.
+//
+// The server listens on a Unix domain socket, which carries the requests and
+// the metadata of the responses. The socket is created in a directory that only
+// the user running the server can access, and only accepts clients running as
+// this user. Each connection gets its own shared memory
+// region, divided into slots. The server copies the components of an element
+// into a free slot, and the client builds tensors that alias the slot, which
+// is released once the last of these tensors is destroyed. Compressed
+// elements, elements that do not fit in a slot, and elements with components
+// that cannot be copied with `memcpy` are sent over the socket instead, as are
+// all the elements while every slot is held by the client.
+class ShmDataTransferServer : public DataTransferServer {
+ public:
+  // `get_elements` serves the requests for more than one element. If it is
+  // null, a single element is returned for each request.
+  ShmDataTransferServer(GetElementT get_element,
+                        const ShmTransferOptions& options,
+                        GetElementsT get_elements = nullptr);
+  ~ShmDataTransferServer() override;
+
+  Status Start() override;
+  // Returns the id of the socket of the server, which clients use as the port
+  // of its address.
+  int get_port() override;
+
+ private:
+  struct Connection {
+    int fd = -1;
+    // Whether the connection is no longer served, so that its thread can be
+    // joined and its socket closed.
+    bool done = false;
+    std::unique_ptr<Thread> thread;
+  };
+
+  void AcceptLoop();
+  void ServeConnection(Connection* connection);
+  Status ServeRequests(int fd);
+  // Moves the components of `result` into `response`, storing them in a slot
+  // of `region` if possible.
+  Status MoveElementToResponse(GetElementResult&& result, ShmRegion& region,
+                               ShmGetElementResponse& response);
+
+  const GetElementT get_element_;
+  const GetElementsT get_elements_;
+  const ShmTransferOptions options_;
+  int listen_fd_ = -1;
+  int port_ = 0;
+  std::string socket_path_;
+  std::unique_ptr<Thread> accept_thread_;
+
+  mutex mu_;
+  bool cancelled_ TF_GUARDED_BY(mu_) = false;
+  std::vector<std::unique_ptr<Connection>> connections_ TF_GUARDED_BY(mu_);
+};
+
+// Client of a `ShmDataTransferServer` running on the same host.
+class ShmDataTransferClient : public DataTransferClient {
+ public:
+  ~ShmDataTransferClient() override;
+
+  // Connects to the server listening on `address`, of the form "host:port",
+  // where the port is the one returned by `ShmDataTransferServer::get_port`.
+  static Status Create(const std::string& address,
+                       std::unique_ptr<DataTransferClient>* out);
+
+  Status GetElement(const GetElementRequest& req,
+                    GetElementResult& result) override;
+  Status GetElements(const GetElementsRequest& req,
+                     std::vector<GetElementResult>& results) override;
+  void TryCancel() override;
+
+ private:
+  ShmDataTransferClient(const std::string& address, int fd,
+                        std::shared_ptr<ShmRegion> region);
+
+  // Sends `req` and appends the elements of the response to `results`.
+  Status Fetch(const GetElementsRequest& req,
+               std::vector<GetElementResult>& results);
+
+  const std::string address_;
+  const int fd_;
+  const std::shared_ptr<ShmRegion> region_;
+
+  // Serializes the requests, since they share the socket.
+  mutex request_mu_;
+  mutex mu_;
+  bool cancelled_ TF_GUARDED_BY(mu_) = false;
+};
+
+}  // namespace data
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_DATA_SERVICE_SHM_DATA_TRANSFER_H_
@@ -0,0 +1,562 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/data/service/shm_data_transfer.h"
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "tensorflow/core/data/compression_utils.h"
+#include "tensorflow/core/data/service/common.pb.h"
+#include "tensorflow/core/data/service/dispatcher.pb.h"
+#include "tensorflow/core/data/service/dispatcher_client.h"
+#include "tensorflow/core/data/service/test_cluster.h"
+#include "tensorflow/core/data/service/worker_client.h"
+#include "tensorflow/core/framework/function.h"
+#include "tensorflow/core/framework/function_testlib.h"
+#include "tensorflow/core/framework/tensor_description.pb.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/coding.h"
+#include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/status_matchers.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace data {
+namespace {
+
+using ::tensorflow::test::function::GDef;
+using ::tensorflow::test::function::NDef;
+using ::tensorflow::testing::StatusIs;
+using ::testing::HasSubstr;
+
+std::vector<Tensor> MakeElement(int64_t i) {
+  return {test::AsTensor<int64_t>({i, i + 1}),
+          test::AsTensor<float>({0.5f * i}, TensorShape({1, 1}))};
+}
+
+void ExpectElement(const GetElementResult& result, int64_t i) {
+  std::vector<Tensor> expected = MakeElement(i);
+  ASSERT_EQ(result.components.size(), expected.size());
+  test::ExpectEqual(result.components[0], expected[0]);
+  test::ExpectEqual(result.components[1], expected[1]);
+  EXPECT_EQ(result.element_index, i);
+  EXPECT_FALSE(result.end_of_sequence);
+}
+
+bool InSharedMemory(const Tensor& tensor) {
+  TensorDescription description;
+  tensor.FillDescription(&description);
+  return description.allocation_description().allocator_name() ==
+         "ShmDataTransfer";
+}
+
+// Serves `num_elements` elements produced by `make_element`, followed by the
+// end of the sequence.
+DataTransferServer::GetElementT ElementGetter(
+    int64_t num_elements,
+    std::function<std::vector<Tensor>(int64_t)> make_element = MakeElement) {
+  auto next = std::make_shared<int64_t>(0);
+  return [num_elements, make_element, next](const GetElementRequest* request,
+                                            GetElementResult* result) {
+    result->element_index = (*next)++;
+    result->skip = false;
+    result->end_of_sequence = result->element_index >= num_elements;
+    if (!result->end_of_sequence) {
+      result->components = make_element(result->element_index);
+    }
+    return Status::OK();
+  };
+}
+
+// Serves GetElements requests with up to `max_elements` elements produced by
+// `get_element`.
+DataTransferServer::GetElementsT ElementsGetter(
+    DataTransferServer::GetElementT get_element) {
+  return [get_element](const GetElementsRequest* request,
+                       std::vector<GetElementResult>* results) {
+    for (int64_t i = 0; i < request->max_elements(); ++i) {
+      results->emplace_back();
+      TF_RETURN_IF_ERROR(get_element(&request->request(), &results->back()));
+      if (results->back().end_of_sequence) break;
+    }
+    return Status::OK();
+  };
+}
+
+// Returns the path of the socket of the server listening on `port`.
+std::string SocketPath(int port) {
+  return absl::StrCat("/tmp/tf_data_shm_transfer_", getuid(), "/", port,
+                      ".sock");
+}
+
+StatusOr<std::unique_ptr<DataTransferClient>> Connect(
+    DataTransferServer& server) {
+  std::unique_ptr<DataTransferClient> client;
+  TF_RETURN_IF_ERROR(ShmDataTransferClient::Create(
+      absl::StrCat("localhost:", server.get_port()), &client));
+  return client;
+}
+
+StatusOr<GetElementResult> GetElement(DataTransferClient& client) {
+  GetElementRequest request;
+  GetElementResult result;
+  TF_RETURN_IF_ERROR(client.GetElement(request, result));
+  return result;
+}
+
+TEST(ShmDataTransferTest, ReadElements) {
+  ShmDataTransferServer server(ElementGetter(/*num_elements=*/10),
+                               ShmTransferOptions());
+  TF_ASSERT_OK(server.Start());
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<DataTransferClient> client,
+                          Connect(server));
+  for (int64_t i = 0; i < 10; ++i) {
+    TF_ASSERT_OK_AND_ASSIGN(GetElementResult result, GetElement(*client));
+    ExpectElement(result, i);
+    EXPECT_TRUE(InSharedMemory(result.components[0]));
+    EXPECT_TRUE(InSharedMemory(result.components[1]));
+  }
+  TF_ASSERT_OK_AND_ASSIGN(GetElementResult result, GetElement(*client));
+  EXPECT_TRUE(result.end_of_sequence);
+  EXPECT_TRUE(result.components.empty());
+}
+
+TEST(ShmDataTransferTest, GetElements) {
+  DataTransferServer::GetElementT get_element =
+      ElementGetter(/*num_elements=*/5);
+  ShmDataTransferServer server(get_element, ShmTransferOptions(),
+                               ElementsGetter(get_element));
+  TF_ASSERT_OK(server.Start());
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<DataTransferClient> client,
+                          Connect(server));
+  GetElementsRequest request;
+  request.set_max_elements(3);
+  std::vector<GetElementResult> results;
+  TF_ASSERT_OK(client->GetElements(request, results));
+  ASSERT_EQ(results.size(), 3);
+  for (int64_t i = 0; i < 3; ++i) {
+    ExpectElement(results[i], i);
+    EXPECT_TRUE(InSharedMemory(results[i].components[0]));
+  }
+  // The results are appended, up to the end of the sequence.
+  TF_ASSERT_OK(client->GetElements(request, results));
+  ASSERT_EQ(results.size(), 6);
+  ExpectElement(results[3], 3);
+  ExpectElement(results[4], 4);
+  EXPECT_TRUE(results[5].end_of_sequence);
+}
+
+TEST(ShmDataTransferTest, GetElementsWithoutBatching) {
+  ShmDataTransferServer server(ElementGetter(/*num_elements=*/5),
+                               ShmTransferOptions());
+  TF_ASSERT_OK(server.Start());
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<DataTransferClient> client,
+                          Connect(server));
+  GetElementsRequest request;
+  request.set_max_elements(3);
+  std::vector<GetElementResult> results;
+  TF_ASSERT_OK(client->GetElements(request, results));
+  ASSERT_EQ(results.size(), 1);
+  ExpectElement(results[0], 0);
+}
+
+TEST(ShmDataTransferTest, GetElementsErrors) {
+  ShmTransferOptions options;
+  options.num_slots = 2;
+  DataTransferServer::GetElementT get_element =
+      ElementGetter(/*num_elements=*/5);
+  ShmDataTransferServer server(
+      get_element, options,
+      [get_element](const GetElementsRequest* request,
+                    std::vector<GetElementResult>* results) {
+        for (int64_t i = 0; i < 2; ++i) {
+          results->emplace_back();
+          TF_RETURN_IF_ERROR(
+              get_element(&request->request(), &results->back()));
+        }
+        return errors::Aborted("Failed after 2 elements");
+      });
+  TF_ASSERT_OK(server.Start());
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<DataTransferClient> client,
+                          Connect(server));
+  GetElementsRequest request;
+  request.set_max_elements(3);
+  std::vector<GetElementResult> results;
+  EXPECT_THAT(client->GetElements(request, results),
+              StatusIs(error::ABORTED, HasSubstr("Failed after 2 elements")));
+  EXPECT_TRUE(results.empty());
+  // The slots of the failed response were released.
+  TF_ASSERT_OK_AND_ASSIGN(GetElementResult result1, GetElement(*client));
+  TF_ASSERT_OK_AND_ASSIGN(GetElementResult result2, GetElement(*client));
+  EXPECT_TRUE(InSharedMemory(result1.components[0]));
+  EXPECT_TRUE(InSharedMemory(result2.components[0]));
+}
+
+TEST(ShmDataTransferTest, MultipleClients) {
+  ShmDataTransferServer server(ElementGetter(/*num_elements=*/10),
+                               ShmTransferOptions());
+  TF_ASSERT_OK(server.Start());
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<DataTransferClient> client1,
+                          Connect(server));
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<DataTransferClient> client2,
+                          Connect(server));
+  for (int64_t i = 0; i < 10; i += 2) {
+    TF_ASSERT_OK_AND_ASSIGN(GetElementResult result1, GetElement(*client1));
+    ExpectElement(result1, i);
+    TF_ASSERT_OK_AND_ASSIGN(GetElementResult result2, GetElement(*client2));
+    ExpectElement(result2, i + 1);
+  }
+}
+
+TEST(ShmDataTransferTest, SlotsAreReleasedWithTheirTensors) {
+  ShmTransferOptions options;
+  options.num_slots = 2;
+  ShmDataTransferServer server(ElementGetter(/*num_elements=*/10), options);
+  TF_ASSERT_OK(server.Start());
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<DataTransferClient> client,
+                          Connect(server));
+  std::vector<GetElementResult> results;
+  for (int64_t i = 0; i < 4; ++i) {
+    TF_ASSERT_OK_AND_ASSIGN(GetElementResult result, GetElement(*client));
+    results.push_back(std::move(result));
+  }
+  // Once both slots are held, the elements are sent over the socket.
+  for (int64_t i = 0; i < 4; ++i) {
+    ExpectElement(results[i], i);
+    EXPECT_EQ(InSharedMemory(results[i].components[0]), i < 2);
+  }
+
+  // A slot is released once all the tensors aliasing it are destroyed.
+  Tensor component = results[0].components[1];
+  results.clear();
+  TF_ASSERT_OK_AND_ASSIGN(GetElementResult result, GetElement(*client));
+  ExpectElement(result, 4);
+  EXPECT_TRUE(InSharedMemory(result.components[0]));
+  TF_ASSERT_OK_AND_ASSIGN(result, GetElement(*client));
+  ExpectElement(result, 5);
+  EXPECT_FALSE(InSharedMemory(result.components[0]));
+  test::ExpectEqual(component, MakeElement(0)[1]);
+}
+
+TEST(ShmDataTransferTest, ElementsThatDoNotFitInSlots) {
+  ShmTransferOptions options;
+  options.slot_bytes = 8 * sizeof(int64_t);
+  auto make_element = [](int64_t i) -> std::vector<Tensor> {
+    switch (i) {
+      case 0:
+        return {test::AsTensor<int64_t>(std::vector<int64_t>(8, i))};
+      case 1:
+        return {test::AsTensor<int64_t>(std::vector<int64_t>(9, i))};
+      default:
+        return {test::AsTensor<tstring>({"a", "b"})};
+    }
+  };
+  ShmDataTransferServer server(ElementGetter(/*num_elements=*/3, make_element),
+                               options);
+  TF_ASSERT_OK(server.Start());
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<DataTransferClient> client,
+                          Connect(server));
+  for (int64_t i = 0; i < 3; ++i) {
+    TF_ASSERT_OK_AND_ASSIGN(GetElementResult result, GetElement(*client));
+    ASSERT_EQ(result.components.size(), 1);
+    test::ExpectEqual(result.components[0], make_element(i)[0]);
+    // Only the first element fits in a slot.
+    EXPECT_EQ(InSharedMemory(result.components[0]), i == 0);
+  }
+}
+
+TEST(ShmDataTransferTest, CompressedElements) {
+  ShmDataTransferServer server(
+      ElementGetter(/*num_elements=*/1,
+                    [](int64_t i) {
+                      CompressedElement compressed;
+                      TF_CHECK_OK(CompressElement(MakeElement(i), &compressed));
+                      Tensor tensor(DT_VARIANT, TensorShape{});
+                      tensor.scalar<Variant>()() = std::move(compressed);
+                      return std::vector<Tensor>{tensor};
+                    }),
+      ShmTransferOptions());
+  TF_ASSERT_OK(server.Start());
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<DataTransferClient> client,
+                          Connect(server));
+  TF_ASSERT_OK_AND_ASSIGN(GetElementResult result, GetElement(*client));
+  ASSERT_EQ(result.components.size(), 1);
+  const CompressedElement* compressed =
+      result.components[0].scalar<Variant>()().get<CompressedElement>();
+  ASSERT_NE(compressed, nullptr);
+  std::vector<Tensor> element;
+  TF_ASSERT_OK(UncompressElement(*compressed, &element));
+  test::ExpectEqual(element[0], MakeElement(0)[0]);
+}
+
+TEST(ShmDataTransferTest, Errors) {
+  ShmDataTransferServer server(
+      [](const GetElementRequest* request, GetElementResult* result) {
+        return errors::NotFound("Task ", request->task_id(), " not found");
+      },
+      ShmTransferOptions());
+  TF_ASSERT_OK(server.Start());
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<DataTransferClient> client,
+                          Connect(server));
+  GetElementRequest request;
+  request.set_task_id(3);
+  GetElementResult result;
+  EXPECT_THAT(client->GetElement(request, result),
+              StatusIs(error::NOT_FOUND, HasSubstr("Task 3 not found")));
+}
+
+TEST(ShmDataTransferTest, CancelClient) {
+  ShmDataTransferServer server(ElementGetter(/*num_elements=*/10),
+                               ShmTransferOptions());
+  TF_ASSERT_OK(server.Start());
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<DataTransferClient> client,
+                          Connect(server));
+  client->TryCancel();
+  EXPECT_THAT(GetElement(*client), StatusIs(error::CANCELLED));
+}
+
+TEST(ShmDataTransferTest, ServerShutsDown) {
+  auto server = std::make_unique<ShmDataTransferServer>(
+      ElementGetter(/*num_elements=*/10), ShmTransferOptions());
+  TF_ASSERT_OK(server->Start());
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<DataTransferClient> client,
+                          Connect(*server));
+  TF_ASSERT_OK_AND_ASSIGN(GetElementResult result, GetElement(*client));
+  server.reset();
+  EXPECT_FALSE(GetElement(*client).ok());
+  // The tensors received before the shutdown remain valid.
+  ExpectElement(result, 0);
+}
+
+TEST(ShmDataTransferTest, ConnectionRefused) {
+  int port;
+  {
+    ShmDataTransferServer server(ElementGetter(/*num_elements=*/0),
+                                 ShmTransferOptions());
+    TF_ASSERT_OK(server.Start());
+    port = server.get_port();
+  }
+  std::unique_ptr<DataTransferClient> client;
+  EXPECT_FALSE(ShmDataTransferClient::Create(absl::StrCat("localhost:", port),
+                                             &client)
+                   .ok());
+}
+
+TEST(ShmDataTransferTest, SocketIsPrivate) {
+  ShmDataTransferServer server(ElementGetter(/*num_elements=*/0),
+                               ShmTransferOptions());
+  TF_ASSERT_OK(server.Start());
+  const std::string path = SocketPath(server.get_port());
+  struct stat st;
+  ASSERT_EQ(stat(path.c_str(), &st), 0);
+  EXPECT_TRUE(S_ISSOCK(st.st_mode));
+  EXPECT_EQ(st.st_mode & (S_IRWXG | S_IRWXO), 0);
+  const std::string dir = path.substr(0, path.rfind('/'));
+  ASSERT_EQ(stat(dir.c_str(), &st), 0);
+  EXPECT_EQ(st.st_uid, getuid());
+  EXPECT_EQ(st.st_mode & (S_IRWXG | S_IRWXO), 0);
+}
+
+TEST(ShmDataTransferTest, InvalidAddress) {
+  std::unique_ptr<DataTransferClient> client;
+  EXPECT_THAT(ShmDataTransferClient::Create("localhost", &client),
+              StatusIs(error::INVALID_ARGUMENT));
+  EXPECT_THAT(ShmDataTransferClient::Create("localhost:port", &client),
+              StatusIs(error::INVALID_ARGUMENT));
+}
+
+TEST(ShmDataTransferTest, OversizedMessage) {
+  ShmDataTransferServer server(ElementGetter(/*num_elements=*/10),
+                               ShmTransferOptions());
+  TF_ASSERT_OK(server.Start());
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  ASSERT_GE(fd, 0);
+  struct sockaddr_un addr = {};
+  addr.sun_family = AF_UNIX;
+  const std::string path = SocketPath(server.get_port());
+  ASSERT_LT(path.size(), sizeof(addr.sun_path));
+  memcpy(addr.sun_path, path.data(), path.size());
+  ASSERT_EQ(
+      connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)), 0);
+  // Acknowledges the region with a message claiming to be 1TB long. The server
+  // closes the connection rather than allocating it.
+  char length[sizeof(uint64)];
+  core::EncodeFixed64(length, uint64{1} << 40);
+  ASSERT_EQ(send(fd, length, sizeof(length), 0), sizeof(length));
+  char buffer[256];
+  ssize_t n;
+  while ((n = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+  }
+  EXPECT_EQ(n, 0);
+  close(fd);
+}
+
+// Returns a dataset representing
+// tf.data.Dataset.range(range).map(lambda x: tf.fill([size], x)).
+DatasetDef RangeFillDataset(int64_t range, int64_t size) {
+  FunctionDef fill = FunctionDefHelper::Create(
+      /*function_name=*/"FillX",
+      /*in_def=*/{"x: int64"},
+      /*out_def=*/{"y: int64"},
+      /*attr_def=*/{},
+      /*node_def=*/
+      {FunctionDefHelper::Const<int64_t>("dims", {size}),
+       {{"y"},
+        "Fill",
+        {"dims:output:0", "x"},
+        {{"T", DT_INT64}, {"index_type", DT_INT64}}}},
+      /*ret_def=*/{{"y", "y:output:0"}});
+  DatasetDef dataset_def;
+  *dataset_def.mutable_graph() = GDef(
+      {NDef("start", "Const", /*inputs=*/{},
+            {{"value", test::AsScalar<int64_t>(0)}, {"dtype", DT_INT64}}),
+       NDef("stop", "Const", /*inputs=*/{},
+            {{"value", test::AsScalar<int64_t>(range)}, {"dtype", DT_INT64}}),
+       NDef("step", "Const", /*inputs=*/{},
+            {{"value", test::AsScalar<int64_t>(1)}, {"dtype", DT_INT64}}),
+       NDef("range", "RangeDataset", /*inputs=*/{"start", "stop", "step"},
+            {{"output_shapes", gtl::ArraySlice<TensorShape>{TensorShape()}},
+             {"output_types", gtl::ArraySlice<DataType>{DT_INT64}}}),
+       NDef("map", "MapDataset", /*inputs=*/{"range"},
+            {{"f", FunctionDefHelper::FunctionRef("FillX")},
+             {"Targuments", {}},
+             {"output_shapes",
+              gtl::ArraySlice<TensorShape>{TensorShape({size})}},
+             {"output_types", gtl::ArraySlice<DataType>{DT_INT64}}}),
+       NDef("dataset", "_Retval", /*inputs=*/{"map"},
+            {{"T", DT_VARIANT}, {"index", 0}})},
+      {fill});
+  return dataset_def;
+}
+
+// Reads a dataset from the single worker of a `TestCluster`, bypassing the
+// local protocol that clients use for workers running in the same process.
+class ClusterReader {
+ public:
+  static StatusOr<std::unique_ptr<ClusterReader>> Create(
+      const std::string& data_transfer_protocol, const DatasetDef& dataset) {
+    TestCluster::Config config;
+    config.num_workers = 1;
+    config.data_transfer_protocol = data_transfer_protocol;
+    auto reader = absl::WrapUnique(new ClusterReader(config));
+    TF_RETURN_IF_ERROR(reader->cluster_.Initialize());
+    DataServiceDispatcherClient dispatcher(reader->cluster_.DispatcherAddress(),
+                                           "grpc");
+    int64_t dataset_id = 0;
+    TF_RETURN_IF_ERROR(dispatcher.RegisterDataset(
+        dataset, /*element_spec=*/absl::nullopt, dataset_id));
+    ProcessingModeDef processing_mode;
+    processing_mode.set_sharding_policy(ProcessingModeDef::OFF);
+    int64_t job_client_id = 0;
+    TF_RETURN_IF_ERROR(dispatcher.GetOrCreateJob(
+        dataset_id, processing_mode, /*job_key=*/absl::nullopt,
+        /*num_consumers=*/absl::nullopt, TARGET_WORKERS_AUTO, job_client_id));
+    ClientHeartbeatRequest request;
+    ClientHeartbeatResponse response;
+    request.set_job_client_id(job_client_id);
+    TF_RETURN_IF_ERROR(dispatcher.ClientHeartbeat(request, response));
+    if (response.task_info().empty()) {
+      return errors::NotFound("No task found for job ", job_client_id);
+    }
+    const TaskInfo& task = response.task_info(0);
+    reader->task_id_ = task.task_id();
+    TF_RETURN_IF_ERROR(DataTransferClient::Build(
+        data_transfer_protocol.empty() ? kGrpcTransferProtocol
+                                       : data_transfer_protocol,
+        {"grpc", task.transfer_address()}, &reader->client_));
+    return reader;
+  }
+
+  StatusOr<GetElementResult> GetNext() {
+    GetElementRequest request;
+    request.set_task_id(task_id_);
+    GetElementResult result;
+    do {
+      result = GetElementResult();
+      Status s = client_->GetElement(request, result);
+      // The worker may not have received the task yet.
+      if (errors::IsUnavailable(s)) continue;
+      TF_RETURN_IF_ERROR(s);
+    } while (result.skip);
+    return result;
+  }
+
+ private:
+  explicit ClusterReader(const TestCluster::Config& config)
+      : cluster_(config) {}
+
+  TestCluster cluster_;
+  int64_t task_id_ = 0;
+  std::unique_ptr<DataTransferClient> client_;
+};
+
+TEST(ShmDataTransferTest, ReadFromWorker) {
+  TF_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<ClusterReader> reader,
+      ClusterReader::Create(kShmTransferProtocol,
+                            RangeFillDataset(/*range=*/5, /*size=*/1000)));
+  for (int64_t i = 0; i < 5; ++i) {
+    TF_ASSERT_OK_AND_ASSIGN(GetElementResult result, reader->GetNext());
+    ASSERT_FALSE(result.end_of_sequence);
+    ASSERT_EQ(result.components.size(), 1);
+    EXPECT_TRUE(InSharedMemory(result.components[0]));
+    test::ExpectEqual(result.components[0],
+                      test::AsTensor<int64_t>(std::vector<int64_t>(1000, i)));
+  }
+  TF_ASSERT_OK_AND_ASSIGN(GetElementResult result, reader->GetNext());
+  EXPECT_TRUE(result.end_of_sequence);
+}
+
+// Reads elements of `state.range(0)` int64 values from a worker on the same
+// host.
+void BM_Transfer(::testing::benchmark::State& state,
+                 const std::string& data_transfer_protocol) {
+  const int64_t size = state.range(0);
+  auto reader =
+      ClusterReader::Create(data_transfer_protocol,
+                            RangeFillDataset(std::numeric_limits<int64_t>::max(), size))
+          .ValueOrDie();
+  for (auto s : state) {
+    GetElementResult result = reader->GetNext().ValueOrDie();
+    CHECK(!result.end_of_sequence);
+  }
+  state.SetBytesProcessed(state.iterations() * size * sizeof(int64_t));
+}
+
+void BM_GrpcTransfer(::testing::benchmark::State& state) {
+  BM_Transfer(state, kGrpcTransferProtocol);
+}
+
+void BM_ShmTransfer(::testing::benchmark::State& state) {
+  BM_Transfer(state, kShmTransferProtocol);
+}
+
+BENCHMARK(BM_GrpcTransfer)->Arg(1 << 10)->Arg(1 << 17)->Arg(1 << 20);
+BENCHMARK(BM_ShmTransfer)->Arg(1 << 10)->Arg(1 << 17)->Arg(1 << 20);
+
+}  // namespace
+}  // namespace data
+}  // namespace tensorflow
@@ -17,6 +17,8 @@ limitations under the License.
 #include <memory>
 #include <vector>
 
+#include "absl/types/optional.h"
+#include "tensorflow/core/data/service/data_transfer.h"
 #include "tensorflow/core/data/service/thread_safe_buffer.h"
 #include "tensorflow/core/data/standalone.h"
 #include "tensorflow/core/framework/cancellation.h"
@@ -37,6 +39,12 @@ namespace {
 // Time to wait before skipping a round if data still isn't available.
 const int64_t kWaitBeforeSkipUs = 100 * 1000;  // 100ms.
 
+// Default number of elements prefetched by a first-come first-served task.
+// Workers opt into batched `GetElements` responses by setting
+// `WorkerConfig.element_buffer_size`, since each task may then hold that many
+// elements in memory.
+const int64_t kDefaultElementBufferSize = 1;
+
 }  // namespace
 
 StandaloneTaskIterator::StandaloneTaskIterator(
@@ -71,15 +79,27 @@ Status TaskRunner::Create(const experimental::WorkerConfig& worker_config,
                                                   task_def.num_consumers(),
                                                   task_def.worker_address());
   } else {
-    out =
-        absl::make_unique<FirstComeFirstServedTaskRunner>(std::move(iterator));
+    const int64_t buffer_size = worker_config.element_buffer_size() > 0
+                                    ? worker_config.element_buffer_size()
+                                    : kDefaultElementBufferSize;
+    out = absl::make_unique<FirstComeFirstServedTaskRunner>(std::move(iterator),
+                                                            buffer_size);
   }
   return Status::OK();
 }
 
+Status TaskRunner::GetNextElements(const GetElementRequest& req,
+                                   int64_t max_elements, int64_t max_bytes,
+                                   std::vector<GetElementResult>& results) {
+  GetElementResult result;
+  TF_RETURN_IF_ERROR(GetNext(req, result));
+  results.push_back(std::move(result));
+  return Status::OK();
+}
+
 FirstComeFirstServedTaskRunner::FirstComeFirstServedTaskRunner(
-    std::unique_ptr<TaskIterator> iterator)
-    : iterator_(std::move(iterator)), buffer_(/*buffer_size=*/1) {
+    std::unique_ptr<TaskIterator> iterator, int64_t buffer_size)
+    : iterator_(std::move(iterator)), buffer_(buffer_size) {
   RunPrefetchThread();
 }
 
@@ -91,6 +111,27 @@ Status FirstComeFirstServedTaskRunner::GetNext(const GetElementRequest& req,
   return Status::OK();
 }
 
+Status FirstComeFirstServedTaskRunner::GetNextElements(
+    const GetElementRequest& req, int64_t max_elements, int64_t max_bytes,
+    std::vector<GetElementResult>& results) {
+  TF_ASSIGN_OR_RETURN(GetElementResult result, buffer_.Pop());
+  int64_t bytes = GetElementResultBytes(result);
+  results.push_back(std::move(result));
+  for (int64_t i = 1; i < max_elements; ++i) {
+    if (results.back().end_of_sequence ||
+        (max_bytes > 0 && bytes >= max_bytes)) {
+      break;
+    }
+    absl::optional<GetElementResult> next = buffer_.TryPop();
+    if (!next.has_value()) {
+      break;
+    }
+    bytes += GetElementResultBytes(*next);
+    results.push_back(std::move(*next));
+  }
+  return Status::OK();
+}
+
 Status FirstComeFirstServedTaskRunner::PrefetchFn() {
   while (true) {
     TF_RETURN_IF_ERROR(buffer_.Push(GetNextFromInputIterator()));
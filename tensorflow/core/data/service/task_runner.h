@@ -74,6 +74,14 @@ class TaskRunner {
   // Gets the next element for the given request.
   virtual Status GetNext(const GetElementRequest& req,
                          GetElementResult& result) = 0;
+  // Gets up to `max_elements` next elements for the given request, appending
+  // them to `results`. Blocks until the first element is available, then adds
+  // the elements that are ready without blocking until the elements reach
+  // `max_bytes` bytes, if `max_bytes` is positive. The default implementation
+  // gets a single element.
+  virtual Status GetNextElements(const GetElementRequest& req,
+                                 int64_t max_elements, int64_t max_bytes,
+                                 std::vector<GetElementResult>& results);
   // Cancels in-progress `GetNext` requests.
   virtual void Cancel() = 0;
 };
@@ -82,12 +90,16 @@ class TaskRunner {
 // It does not consider which consumer is making the request.
 class FirstComeFirstServedTaskRunner : public TaskRunner {
  public:
+  // Prefetches up to `buffer_size` elements from `iterator`.
   explicit FirstComeFirstServedTaskRunner(
-      std::unique_ptr<TaskIterator> iterator);
+      std::unique_ptr<TaskIterator> iterator, int64_t buffer_size = 1);
   ~FirstComeFirstServedTaskRunner() override;
 
   Status GetNext(const GetElementRequest& req,
                  GetElementResult& result) override;
+  Status GetNextElements(const GetElementRequest& req, int64_t max_elements,
+                         int64_t max_bytes,
+                         std::vector<GetElementResult>& results) override;
   void Cancel() override;
 
  private:
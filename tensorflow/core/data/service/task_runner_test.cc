@@ -180,6 +180,57 @@ TEST(FirstComeFirstServedTaskRunnerTest, Error) {
               testing::StatusIs(error::ABORTED));
 }
 
+TEST(FirstComeFirstServedTaskRunnerTest, GetNextElements) {
+  std::vector<std::vector<Tensor>> elements = GetRangeDataset(10);
+  FirstComeFirstServedTaskRunner runner(
+      absl::make_unique<TestTaskIterator>(elements, /*repeat=*/false),
+      /*buffer_size=*/4);
+  std::vector<GetElementResult> results;
+  while (results.empty() || !results.back().end_of_sequence) {
+    const size_t num_results = results.size();
+    TF_ASSERT_OK(runner.GetNextElements(GetElementRequest(),
+                                        /*max_elements=*/3, /*max_bytes=*/0,
+                                        results));
+    EXPECT_GE(results.size(), num_results + 1);
+    EXPECT_LE(results.size(), num_results + 3);
+  }
+
+  ASSERT_EQ(results.size(), elements.size() + 1);
+  for (int i = 0; i < elements.size(); ++i) {
+    EXPECT_FALSE(results[i].end_of_sequence);
+    EXPECT_EQ(results[i].element_index, i);
+    ASSERT_EQ(results[i].components.size(), 1);
+    test::ExpectEqual(results[i].components[0], elements[i][0]);
+  }
+}
+
+TEST(FirstComeFirstServedTaskRunnerTest, GetNextElementsMaxBytes) {
+  std::vector<std::vector<Tensor>> elements = GetRangeDataset(10);
+  FirstComeFirstServedTaskRunner runner(
+      absl::make_unique<TestTaskIterator>(elements, /*repeat=*/false),
+      /*buffer_size=*/4);
+  for (auto& expected_element : elements) {
+    std::vector<GetElementResult> results;
+    TF_ASSERT_OK(runner.GetNextElements(
+        GetElementRequest(), /*max_elements=*/4,
+        /*max_bytes=*/expected_element[0].TotalBytes(), results));
+    ASSERT_EQ(results.size(), 1);
+    ASSERT_FALSE(results[0].end_of_sequence);
+    test::ExpectEqual(results[0].components[0], expected_element[0]);
+  }
+}
+
+TEST(FirstComeFirstServedTaskRunnerTest, GetNextElementsError) {
+  FirstComeFirstServedTaskRunner runner(
+      absl::make_unique<TestErrorIterator>(errors::Aborted("Aborted")),
+      /*buffer_size=*/4);
+  std::vector<GetElementResult> results;
+  EXPECT_THAT(runner.GetNextElements(GetElementRequest(), /*max_elements=*/4,
+                                     /*max_bytes=*/0, results),
+              testing::StatusIs(error::ABORTED));
+  EXPECT_TRUE(results.empty());
+}
+
 class ConsumeParallelTest
     : public ::testing::Test,
       public ::testing::WithParamInterface<std::tuple<int64_t, int64_t>> {};
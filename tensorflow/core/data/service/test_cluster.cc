@@ -71,6 +71,10 @@ Status TestCluster::AddWorker() {
   config.set_protocol(kProtocol);
   config.set_dispatcher_address(dispatcher_address_);
   config.set_worker_address("localhost:%port%");
+  if (!config_.data_transfer_protocol.empty()) {
+    config.set_data_transfer_protocol(config_.data_transfer_protocol);
+    config.set_data_transfer_address("localhost:%port%");
+  }
   TF_RETURN_IF_ERROR(NewWorkerServer(config, worker));
   TF_RETURN_IF_ERROR(worker->Start());
   worker_addresses_.push_back(absl::StrCat("localhost:", worker->BoundPort()));
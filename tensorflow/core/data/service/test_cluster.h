@@ -49,6 +49,9 @@ class TestCluster {
     int64_t client_timeout_ms = 0;
     int64_t job_gc_check_interval_ms = 0;
     int64_t job_gc_timeout_ms = 0;
+    // The protocol for the workers to use when transferring data to clients.
+    // If empty, the data is transferred with gRPC.
+    std::string data_transfer_protocol;
   };
 
   // Creates a new test cluster with a dispatcher and `num_workers` workers.
@@ -17,6 +17,7 @@ limitations under the License.
 
 #include <deque>
 
+#include "absl/types/optional.h"
 #include "tensorflow/core/platform/macros.h"
 #include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/platform/status.h"
@@ -37,6 +38,11 @@ class ThreadSafeBuffer final {
   // a non-OK status was pushed or the buffer has been cancelled.
   StatusOr<T> Pop();
 
+  // Gets the next element without blocking. Returns `absl::nullopt` if the
+  // buffer is empty, if it has been cancelled, or if the next element is a
+  // non-OK status, which is left for `Pop` to return.
+  absl::optional<T> TryPop();
+
   // Writes the next element. Blocks if the buffer is full. Returns an error if
   // the buffer has been cancelled.
   Status Push(StatusOr<T> value);
@@ -81,6 +87,18 @@ StatusOr<T> ThreadSafeBuffer<T>::Pop() {
   return result;
 }
 
+template <class T>
+absl::optional<T> ThreadSafeBuffer<T>::TryPop() {
+  mutex_lock l(mu_);
+  if (!status_.ok() || results_.empty() || !results_.front().ok()) {
+    return absl::nullopt;
+  }
+  T result = std::move(results_.front()).ValueOrDie();
+  results_.pop_front();
+  ready_to_push_.notify_one();
+  return result;
+}
+
 template <class T>
 Status ThreadSafeBuffer<T>::Push(StatusOr<T> value) {
   mutex_lock l(mu_);
@@ -19,6 +19,7 @@ limitations under the License.
 #include <vector>
 
 #include "absl/strings/str_cat.h"
+#include "absl/types/optional.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
@@ -224,6 +225,32 @@ TEST_P(ThreadSafeBufferTest, CancelMultipleTimes) {
               StatusIs(error::RESOURCE_EXHAUSTED));
 }
 
+TEST_P(ThreadSafeBufferTest, TryPop) {
+  ThreadSafeBuffer<int> buffer(GetBufferSize());
+  EXPECT_EQ(buffer.TryPop(), absl::nullopt);
+  for (int i = 0; i < GetBufferSize(); ++i) {
+    ASSERT_THAT(buffer.Push(i), IsOk());
+  }
+  for (int i = 0; i < GetBufferSize(); ++i) {
+    EXPECT_EQ(buffer.TryPop(), i);
+  }
+  EXPECT_EQ(buffer.TryPop(), absl::nullopt);
+}
+
+TEST_P(ThreadSafeBufferTest, TryPopLeavesErrorsToPop) {
+  ThreadSafeBuffer<int> buffer(GetBufferSize());
+  ASSERT_THAT(buffer.Push(errors::Internal("Internal")), IsOk());
+  EXPECT_EQ(buffer.TryPop(), absl::nullopt);
+  EXPECT_THAT(buffer.Pop(), StatusIs(error::INTERNAL));
+}
+
+TEST_P(ThreadSafeBufferTest, TryPopAfterCancel) {
+  ThreadSafeBuffer<int> buffer(GetBufferSize());
+  ASSERT_THAT(buffer.Push(1), IsOk());
+  buffer.Cancel(errors::Cancelled("Cancelled"));
+  EXPECT_EQ(buffer.TryPop(), absl::nullopt);
+}
+
 }  // namespace
 }  // namespace data
 }  // namespace tensorflow
@@ -14,6 +14,7 @@ limitations under the License.
 ==============================================================================*/
 #include "tensorflow/core/data/service/worker_client.h"
 
+#include <functional>
 #include <memory>
 #include <string>
 #include <utility>
@@ -66,6 +67,12 @@ Status DataServiceWorkerClient::GetElement(const GetElementRequest& req,
   return client_->GetElement(req, result);
 }
 
+Status DataServiceWorkerClient::GetElements(
+    const GetElementsRequest& req, std::vector<GetElementResult>& results) {
+  TF_RETURN_IF_ERROR(EnsureInitialized());
+  return client_->GetElements(req, results);
+}
+
 Status DataServiceWorkerClient::EnsureInitialized() {
   mutex_lock l(mu_);
   if (client_) {
@@ -101,6 +108,45 @@ class GrpcDataTransferClient : public DataTransferClient {
                     GetElementResult& result) override {
     VLOG(3) << "GetElement for task " << req.task_id() << " from gRPC worker "
             << "server.";
+    GetElementResponse resp;
+    TF_RETURN_IF_ERROR(Call(
+        [&](grpc::ClientContext* ctx) {
+          return stub_->GetElement(ctx, req, &resp);
+        },
+        "Failed to get element"));
+    return ParseElement(resp, result);
+  }
+
+  Status GetElements(const GetElementsRequest& req,
+                     std::vector<GetElementResult>& results) override {
+    VLOG(3) << "GetElements for task " << req.request().task_id()
+            << " from gRPC worker server.";
+    GetElementsResponse resp;
+    TF_RETURN_IF_ERROR(Call(
+        [&](grpc::ClientContext* ctx) {
+          return stub_->GetElements(ctx, req, &resp);
+        },
+        "Failed to get elements"));
+    for (GetElementResponse& element : *resp.mutable_elements()) {
+      results.emplace_back();
+      TF_RETURN_IF_ERROR(ParseElement(element, results.back()));
+    }
+    return Status::OK();
+  }
+
+  void TryCancel() override {
+    VLOG(2) << "Cancel GrpcDataTransferClient.";
+    mutex_lock l(mu_);
+    cancelled_ = true;
+    for (const auto& ctx : active_contexts_) {
+      ctx->TryCancel();
+    }
+  }
+
+ private:
+  // Runs `call` with a context that is cancelled by `TryCancel`.
+  Status Call(const std::function<grpc::Status(grpc::ClientContext*)>& call,
+              absl::string_view error_message) {
     {
       mutex_lock l(mu_);
       if (cancelled_) {
@@ -112,14 +158,27 @@ class GrpcDataTransferClient : public DataTransferClient {
       mutex_lock l(mu_);
       active_contexts_.insert(&ctx);
     }
-    GetElementResponse resp;
-    grpc::Status s = stub_->GetElement(&ctx, req, &resp);
+    grpc::Status s = call(&ctx);
+    {
+      mutex_lock l(mu_);
+      active_contexts_.erase(&ctx);
+    }
+    if (!s.ok()) {
+      return grpc_util::WrapError(std::string(error_message), s);
+    }
+    return Status::OK();
+  }
+
+  // Moves the element of `resp` into `result`.
+  static Status ParseElement(GetElementResponse& resp,
+                             GetElementResult& result) {
     result.end_of_sequence = resp.end_of_sequence();
     result.skip = resp.skip_task();
+    result.element_index = resp.element_index();
     switch (resp.element_case()) {
       case GetElementResponse::kCompressed: {
         Tensor tensor(DT_VARIANT, TensorShape{});
-        tensor.scalar<Variant>()() = std::move(resp.compressed());
+        tensor.scalar<Variant>()() = std::move(*resp.mutable_compressed());
         result.components.push_back(tensor);
         break;
       }
@@ -134,26 +193,9 @@ class GrpcDataTransferClient : public DataTransferClient {
       case GetElementResponse::ELEMENT_NOT_SET:
         break;
     }
-    {
-      mutex_lock l(mu_);
-      active_contexts_.erase(&ctx);
-    }
-    if (!s.ok()) {
-      return grpc_util::WrapError("Failed to get element", s);
-    }
     return Status::OK();
   }
 
-  void TryCancel() override {
-    VLOG(2) << "Cancel GrpcDataTransferClient.";
-    mutex_lock l(mu_);
-    cancelled_ = true;
-    for (const auto& ctx : active_contexts_) {
-      ctx->TryCancel();
-    }
-  }
-
- private:
   mutex mu_;
   std::unique_ptr<WorkerService::Stub> stub_;
   // Set of all currently active clients contexts. Used to support
@@ -199,6 +241,16 @@ class LocalDataTransferClient : public DataTransferClient {
     return worker->GetElementResult(&req, &result);
   }
 
+  Status GetElements(const GetElementsRequest& req,
+                     std::vector<GetElementResult>& results) override {
+    VLOG(3) << "GetElements for task " << req.request().task_id()
+            << " from local worker.";
+    TF_RETURN_IF_ERROR(VerifyClientIsNotCancelled());
+    TF_ASSIGN_OR_RETURN(std::shared_ptr<DataServiceWorkerImpl> worker,
+                        GetWorker(req.request()));
+    return worker->GetElementResults(&req, &results);
+  }
+
   void TryCancel() override {
     VLOG(2) << "Cancel LocalDataTransferClient for worker " << worker_address_
             << ".";
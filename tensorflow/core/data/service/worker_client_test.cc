@@ -17,6 +17,7 @@ limitations under the License.
 #include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "absl/memory/memory.h"
 #include "absl/strings/substitute.h"
@@ -186,6 +187,29 @@ TEST_F(WorkerClientTest, GrpcRead) {
                        MatchesRegex("Local worker.*is no longer available.*")));
 }
 
+TEST_F(WorkerClientTest, GetElements) {
+  const int64_t range = 10;
+  TF_ASSERT_OK_AND_ASSIGN(const int64_t dataset_id, RegisterDataset(range));
+  TF_ASSERT_OK_AND_ASSIGN(const int64_t job_client_id, CreateJob(dataset_id));
+  TF_ASSERT_OK_AND_ASSIGN(const int64_t task_id, GetTaskToRead(job_client_id));
+  for (const std::string& protocol :
+       {std::string(kLocalTransferProtocol),
+        std::string(kGrpcTransferProtocol)}) {
+    TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<DataServiceWorkerClient> client,
+                            GetWorkerClient(protocol));
+    GetElementsRequest request;
+    request.mutable_request()->set_task_id(task_id);
+    request.set_max_elements(4);
+    std::vector<GetElementResult> results;
+    TF_ASSERT_OK(client->GetElements(request, results));
+    ASSERT_FALSE(results.empty());
+    EXPECT_LE(results.size(), 4);
+    for (const GetElementResult& result : results) {
+      EXPECT_FALSE(result.end_of_sequence);
+    }
+  }
+}
+
 TEST_F(WorkerClientTest, LocalServerShutsDown) {
   TF_ASSERT_OK_AND_ASSIGN(const int64_t dataset_id,
                           RegisterDataset(/*range=*/5));
@@ -15,9 +15,11 @@ limitations under the License.
 
 #include "tensorflow/core/data/service/worker_impl.h"
 
+#include <algorithm>
 #include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "grpcpp/create_channel.h"
 #include "absl/algorithm/container.h"
@@ -194,6 +196,29 @@ Status DataServiceWorkerImpl::ValidateWorkerConfig() const {
 
 Status DataServiceWorkerImpl::GetElementResult(
     const GetElementRequest* request, struct GetElementResult* result) {
+  std::vector<struct GetElementResult> results;
+  TF_RETURN_IF_ERROR(GetElementResultsInternal(
+      *request, /*max_elements=*/1, /*max_bytes=*/0, results));
+  *result = std::move(results.front());
+  return Status::OK();
+}
+
+Status DataServiceWorkerImpl::GetElementResults(
+    const GetElementsRequest* request,
+    std::vector<struct GetElementResult>* results) {
+  int64_t max_elements = std::max<int64_t>(request->max_elements(), 1);
+  if (request->request().optional_consumer_index_case() ==
+      GetElementRequest::kConsumerIndex) {
+    // Round-robin reads hand out one element per consumer and round.
+    max_elements = 1;
+  }
+  return GetElementResultsInternal(request->request(), max_elements,
+                                   request->max_bytes(), *results);
+}
+
+Status DataServiceWorkerImpl::GetElementResultsInternal(
+    const GetElementRequest& request, int64_t max_elements, int64_t max_bytes,
+    std::vector<struct GetElementResult>& results) {
   Task* task = nullptr;
   {
     mutex_lock l(mu_);
@@ -207,25 +232,26 @@ Status DataServiceWorkerImpl::GetElementResult(
       return errors::Unavailable(
           "Worker has not yet registered with dispatcher.");
     }
-    auto it = tasks_.find(request->task_id());
+    auto it = tasks_.find(request.task_id());
     if (it == tasks_.end()) {
-      if (deleted_tasks_.contains(request->task_id())) {
+      if (deleted_tasks_.contains(request.task_id())) {
         return errors::FailedPrecondition(
-            "Got request for local task ", request->task_id(), " of worker ",
+            "Got request for local task ", request.task_id(), " of worker ",
             worker_address_, ", which has been deleted. You may be creating ",
             "a duplicate job which has already finished. To fix this, make "
             "sure to create your dataset only once, as opposed to re-creating "
             "it repeatedly inside a loop.");
       }
-      if (finished_tasks_.contains(request->task_id())) {
+      if (finished_tasks_.contains(request.task_id())) {
         VLOG(3) << "Task is already finished";
-        result->end_of_sequence = true;
-        result->skip = false;
+        results.emplace_back();
+        results.back().end_of_sequence = true;
+        results.back().skip = false;
         return Status::OK();
       }
       // Perhaps the worker hasn't gotten the task from the dispatcher yet.
       // Return Unavailable so that the client knows to continue retrying.
-      return errors::Unavailable("Task ", request->task_id(), " not found");
+      return errors::Unavailable("Task ", request.task_id(), " not found");
     }
     task = it->second.get();
     TF_RETURN_IF_ERROR(EnsureTaskInitialized(*task));
@@ -236,12 +262,24 @@ Status DataServiceWorkerImpl::GetElementResult(
     task->outstanding_requests--;
     cv_.notify_all();
   });
-  TF_RETURN_IF_ERROR(task->task_runner->GetNext(*request, *result));
+  const size_t first_result = results.size();
+  TF_RETURN_IF_ERROR(task->task_runner->GetNextElements(
+      request, max_elements, max_bytes, results));
+
+  int64_t num_elements = 0;
+  int64_t num_bytes = 0;
+  for (size_t i = first_result; i < results.size(); ++i) {
+    if (!results[i].end_of_sequence && !results[i].skip) {
+      ++num_elements;
+      num_bytes += GetElementResultBytes(results[i]);
+    }
+  }
+  metrics::RecordTFDataServiceElementsProduced(num_elements, num_bytes);
 
-  if (result->end_of_sequence) {
+  if (results.back().end_of_sequence) {
     mutex_lock l(mu_);
-    VLOG(3) << "Reached end_of_sequence for task " << request->task_id();
-    pending_completed_tasks_.insert(request->task_id());
+    VLOG(3) << "Reached end_of_sequence for task " << request.task_id();
+    pending_completed_tasks_.insert(request.task_id());
     task_completion_cv_.notify_one();
   }
   return Status::OK();
@@ -390,6 +428,27 @@ Status DataServiceWorkerImpl::GetElement(const GetElementRequest* request,
   return Status::OK();
 }
 
+Status DataServiceWorkerImpl::GetElements(const GetElementsRequest* request,
+                                          GetElementsResponse* response) {
+  VLOG(3) << "Received GetElements request for task "
+          << request->request().task_id();
+  std::vector<struct GetElementResult> results;
+  TF_RETURN_IF_ERROR(GetElementResults(request, &results));
+  for (struct GetElementResult& result : results) {
+    GetElementResponse* element = response->add_elements();
+    element->set_end_of_sequence(result.end_of_sequence);
+    element->set_skip_task(result.skip);
+    if (!result.end_of_sequence && !result.skip) {
+      element->set_element_index(result.element_index);
+      TF_RETURN_IF_ERROR(
+          MoveElementToResponse(std::move(result.components), *element));
+    }
+  }
+  VLOG(3) << "Producing " << results.size() << " elements for task "
+          << request->request().task_id();
+  return Status::OK();
+}
+
 Status DataServiceWorkerImpl::GetWorkerTasks(
     const GetWorkerTasksRequest* request, GetWorkerTasksResponse* response) {
   mutex_lock l(mu_);
@@ -18,6 +18,7 @@ limitations under the License.
 #include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
@@ -63,6 +64,10 @@ class DataServiceWorkerImpl {
   // worker.proto for GetElement API documentation.
   Status GetElementResult(const GetElementRequest* request,
                           GetElementResult* result);
+  // Serves a GetElements request, appending the results to `*results`. See
+  // worker.proto for GetElements API documentation.
+  Status GetElementResults(const GetElementsRequest* request,
+                           std::vector<struct GetElementResult>* results);
 
   // Deletes the local task and iterator. Only called by local clients to delete
   // unused task iterators assuming the task is not read by remote clients. This
@@ -78,6 +83,8 @@ class DataServiceWorkerImpl {
   /// Client-facing API.
   Status GetElement(const GetElementRequest* request,
                     GetElementResponse* response);
+  Status GetElements(const GetElementsRequest* request,
+                     GetElementsResponse* response);
   Status GetWorkerTasks(const GetWorkerTasksRequest* request,
                         GetWorkerTasksResponse* response);
 
@@ -100,6 +107,11 @@ class DataServiceWorkerImpl {
   Status ProcessTaskInternal(const TaskDef& task)
       TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
   Status EnsureTaskInitialized(Task& task);
+  // Gets up to `max_elements` elements for `request`, stopping once they reach
+  // `max_bytes` bytes if `max_bytes` is positive.
+  Status GetElementResultsInternal(
+      const GetElementRequest& request, int64_t max_elements,
+      int64_t max_bytes, std::vector<struct GetElementResult>& results);
   // Stops a task, cancelling the task's outstanding requests and waiting for
   // them to finish.
   void StopTask(Task& task) TF_LOCKS_EXCLUDED(mu_);
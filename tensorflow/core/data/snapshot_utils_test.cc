@@ -15,9 +15,12 @@ limitations under the License.
 
 #include "tensorflow/core/data/snapshot_utils.h"
 
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
 #include "tensorflow/core/framework/tensor.pb.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/io/compression.h"
+#include "tensorflow/core/lib/io/path.h"
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/test.h"
@@ -199,6 +202,69 @@ BENCHMARK(SnapshotTFRecordWriterNoneBenchmark);
 BENCHMARK(SnapshotTFRecordWriterGzipBenchmark);
 BENCHMARK(SnapshotTFRecordWriterSnappyBenchmark);
 
+// Writes elements round-robin to `state.range(0)` AsyncWriters, the way
+// SnapshotDatasetV2 writes its shards, so that each writer thread compresses
+// its own file.
+void SnapshotAsyncWriterBenchmarkLoop(::testing::benchmark::State& state,
+                                      std::string compression_type) {
+  const int64_t num_writers = state.range(0);
+  constexpr int64_t kElementsPerIteration = 256;
+  tensorflow::DataTypeVector dtypes;
+  std::vector<Tensor> tensors;
+  GenerateTensorVector(dtypes, tensors);
+  int64_t bytes_per_element = 0;
+  for (const Tensor& tensor : tensors) {
+    bytes_per_element += tensor.TotalBytes();
+  }
+
+  std::string directory;
+  EXPECT_TRUE(Env::Default()->LocalTempFilename(&directory));
+  TF_ASSERT_OK(Env::Default()->RecursivelyCreateDir(directory));
+
+  for (auto s : state) {
+    std::vector<std::unique_ptr<AsyncWriter>> writers;
+    for (int64_t i = 0; i < num_writers; ++i) {
+      writers.push_back(absl::make_unique<AsyncWriter>(
+          Env::Default(), /*file_index=*/i, io::JoinPath(directory, absl::StrCat(i)),
+          /*checkpoint_id=*/0, compression_type, /*version=*/2, dtypes,
+          [](Status s) { TF_CHECK_OK(s); }));
+    }
+    for (int64_t i = 0; i < kElementsPerIteration; ++i) {
+      writers[i % num_writers]->Write(tensors);
+    }
+    for (auto& writer : writers) {
+      writer->SignalEOF();
+    }
+    // Blocks until every writer has flushed its file.
+    writers.clear();
+  }
+  state.SetBytesProcessed(state.iterations() * kElementsPerIteration *
+                          bytes_per_element);
+
+  int64_t undeleted_files, undeleted_dirs;
+  TF_ASSERT_OK(Env::Default()->DeleteRecursively(directory, &undeleted_files,
+                                                 &undeleted_dirs));
+}
+
+void SnapshotAsyncWriterGzipBenchmark(::testing::benchmark::State& state) {
+  SnapshotAsyncWriterBenchmarkLoop(state, io::compression::kGzip);
+}
+
+void SnapshotAsyncWriterSnappyBenchmark(::testing::benchmark::State& state) {
+  SnapshotAsyncWriterBenchmarkLoop(state, io::compression::kSnappy);
+}
+
+// The work happens on the writer threads, so throughput is measured in real
+// time.
+BENCHMARK(SnapshotAsyncWriterGzipBenchmark)
+    ->RangeMultiplier(2)
+    ->Range(1, 32)
+    ->UseRealTime();
+BENCHMARK(SnapshotAsyncWriterSnappyBenchmark)
+    ->RangeMultiplier(2)
+    ->Range(1, 32)
+    ->UseRealTime();
+
 }  // namespace
 }  // namespace snapshot_util
 }  // namespace data
@@ -0,0 +1,399 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/data/spilling_buffer.h"
+
+#include <utility>
+
+#include "absl/strings/str_cat.h"
+#include "tensorflow/core/data/compression_utils.h"
+#include "tensorflow/core/data/dataset.pb.h"
+#include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/path.h"
+#include "tensorflow/core/platform/random.h"
+#include "tensorflow/core/platform/threadpool.h"
+
+namespace tensorflow {
+namespace data {
+namespace {
+
+constexpr char kSlotStates[] = "slot_states";
+constexpr char kNumComponents[] = "num_components";
+constexpr char kComponent[] = "component";
+constexpr char kSpillFiles[] = "spill_files";
+constexpr char kFile[] = "file";
+constexpr char kOffset[] = "offset";
+constexpr char kLength[] = "length";
+
+// The states of the slots in checkpoints.
+constexpr int64_t kEmptySlot = 0;
+constexpr int64_t kInMemorySlot = 1;
+constexpr int64_t kSpilledSlot = 2;
+
+// Spilled elements are appended to a file until it reaches this size, and a
+// file is deleted once all its elements have been taken, so the disk space
+// held by elements that already left the buffer is bounded.
+constexpr int64_t kMaxSpillFileBytes = 256 << 20;
+
+// The reads are mostly waiting on the disk, so the shared pool has more
+// threads than there are cores.
+constexpr int kNumReadThreads = 16;
+
+void ReadInBackground(std::function<void()> fn) {
+  static thread::ThreadPool* pool = new thread::ThreadPool(
+      Env::Default(), "spilling_buffer", kNumReadThreads);
+  pool->Schedule(std::move(fn));
+}
+
+}  // namespace
+
+struct SpillingBuffer::SpillFile {
+  std::string filename;
+  std::unique_ptr<RandomAccessFile> reader;
+  // The number of elements of the buffer stored in the file.
+  int64_t num_elements = 0;
+  // Whether the buffer deletes the file once it no longer needs it. Files
+  // restored from a checkpoint belong to the checkpoint.
+  bool owned = true;
+  // A copy of the file made by an earlier checkpoint, which later checkpoints
+  // can refer to as well once the file is no longer written to.
+  std::string checkpoint_filename;
+};
+
+namespace {
+
+// Reads back the element stored at `offset` in the spill file `filename`.
+Status ReadSpilled(RandomAccessFile* file, const std::string& filename,
+                   int64_t offset, int64_t length,
+                   std::vector<Tensor>* tensors) {
+  std::string buffer;
+  buffer.resize(length);
+  StringPiece data;
+  TF_RETURN_IF_ERROR(file->Read(offset, length, &data, &buffer[0]));
+  CompressedElement compressed;
+  if (data.size() != length ||
+      !compressed.ParseFromArray(data.data(), data.size())) {
+    return errors::DataLoss("Failed to read spilled element at offset ",
+                            offset, " of ", filename);
+  }
+  return UncompressElement(compressed, tensors);
+}
+
+}  // namespace
+
+SpillingBuffer::Element::Element(std::vector<Tensor> tensors)
+    : done_(true), tensors_(std::move(tensors)) {}
+
+Status SpillingBuffer::Element::Wait() {
+  mutex_lock l(mu_);
+  while (!done_) {
+    cond_var_.wait(l);
+  }
+  return status_;
+}
+
+SpillingBuffer::SpillingBuffer(Env* env, const std::string& spill_directory,
+                               int64_t size, int64_t max_elements_in_memory)
+    : env_(env),
+      spill_directory_(spill_directory),
+      max_elements_in_memory_(max_elements_in_memory),
+      id_(random::New64()),
+      slots_(size) {}
+
+SpillingBuffer::~SpillingBuffer() {
+  if (writer_ != nullptr) {
+    writer_->Close().IgnoreError();
+  }
+  for (const std::shared_ptr<SpillFile>& file : files_) {
+    if (file == nullptr || !file->owned) continue;
+    Status s = env_->DeleteFile(file->filename);
+    if (!s.ok()) {
+      LOG(WARNING) << "Failed to delete spill file " << file->filename << ": "
+                   << s;
+    }
+  }
+}
+
+Status SpillingBuffer::Put(int64_t index, std::vector<Tensor> element) {
+  Slot& slot = slots_[index];
+  DCHECK(slot.empty);
+  slot.tensors = std::move(element);
+  if (num_elements_in_memory_ < max_elements_in_memory_) {
+    slot.empty = false;
+    slot.in_memory = true;
+    ++num_elements_in_memory_;
+    return Status::OK();
+  }
+  Status s = Spill(&slot);
+  slot.tensors.clear();
+  slot.empty = !s.ok();
+  return s;
+}
+
+std::shared_ptr<SpillingBuffer::Element> SpillingBuffer::Take(int64_t index) {
+  Slot& slot = slots_[index];
+  DCHECK(!slot.empty);
+  std::shared_ptr<Element> element;
+  if (slot.in_memory) {
+    element = std::make_shared<Element>(std::move(slot.tensors));
+    --num_elements_in_memory_;
+  } else {
+    element = std::make_shared<Element>();
+    Status s;
+    if (writer_ != nullptr && slot.file == files_.size() - 1 &&
+        slot.offset + slot.length > flushed_offset_) {
+      s = writer_->Flush();
+      if (s.ok()) flushed_offset_ = write_offset_;
+    }
+    if (s.ok()) {
+      std::shared_ptr<SpillFile> file = files_[slot.file];
+      const int64_t offset = slot.offset;
+      const int64_t length = slot.length;
+      ReadInBackground([file, offset, length, element]() {
+        Status s = ReadSpilled(file->reader.get(), file->filename, offset,
+                               length, &element->tensors_);
+        mutex_lock l(element->mu_);
+        element->status_ = s;
+        element->done_ = true;
+        element->cond_var_.notify_all();
+      });
+    } else {
+      mutex_lock l(element->mu_);
+      element->status_ = s;
+      element->done_ = true;
+    }
+  }
+  ReleaseSpilled(&slot);
+  slot = Slot();
+  return element;
+}
+
+void SpillingBuffer::Swap(int64_t i, int64_t j) {
+  std::swap(slots_[i], slots_[j]);
+}
+
+Status SpillingBuffer::Save(IteratorStateWriter* writer,
+                            const std::string& prefix) {
+  if (writer_ != nullptr && flushed_offset_ < write_offset_) {
+    TF_RETURN_IF_ERROR(writer_->Flush());
+    flushed_offset_ = write_offset_;
+  }
+  // The spill files that hold elements are copied to a directory of the
+  // checkpoint, since the buffer deletes its own files once their elements
+  // have been taken.
+  std::string checkpoint_directory;
+  Tensor filenames(DT_STRING,
+                   TensorShape({static_cast<int64_t>(files_.size())}));
+  auto filenames_t = filenames.vec<tstring>();
+  for (int32 i = 0; i < files_.size(); ++i) {
+    SpillFile* file = files_[i].get();
+    if (file == nullptr || file->num_elements == 0) continue;
+    const bool is_open = writer_ != nullptr && i == files_.size() - 1;
+    if (!file->checkpoint_filename.empty() && !is_open) {
+      filenames_t(i) = file->checkpoint_filename;
+      continue;
+    }
+    if (checkpoint_directory.empty()) {
+      checkpoint_directory = io::JoinPath(
+          spill_directory_,
+          absl::StrCat("checkpoint_",
+                       absl::Hex(random::New64(), absl::kZeroPad16)));
+      TF_RETURN_IF_ERROR(env_->RecursivelyCreateDir(checkpoint_directory));
+    }
+    const std::string checkpoint_filename = io::JoinPath(
+        checkpoint_directory, std::string(io::Basename(file->filename)));
+    TF_RETURN_IF_ERROR(env_->CopyFile(file->filename, checkpoint_filename));
+    if (!is_open) file->checkpoint_filename = checkpoint_filename;
+    filenames_t(i) = checkpoint_filename;
+  }
+  TF_RETURN_IF_ERROR(writer->WriteTensor(prefix, kSpillFiles, filenames));
+
+  Tensor states(DT_INT64, TensorShape({size()}));
+  auto states_t = states.vec<int64_t>();
+  for (int64_t i = 0; i < size(); ++i) {
+    const Slot& slot = slots_[i];
+    const std::string slot_prefix = absl::StrCat(prefix, "::", i);
+    if (slot.empty) {
+      states_t(i) = kEmptySlot;
+    } else if (slot.in_memory) {
+      states_t(i) = kInMemorySlot;
+      TF_RETURN_IF_ERROR(writer->WriteScalar(
+          slot_prefix, kNumComponents,
+          static_cast<int64_t>(slot.tensors.size())));
+      for (int j = 0; j < slot.tensors.size(); ++j) {
+        TF_RETURN_IF_ERROR(writer->WriteTensor(
+            slot_prefix, absl::StrCat(kComponent, "[", j, "]"),
+            slot.tensors[j]));
+      }
+    } else {
+      // Spilled elements are saved as their location in the spill files.
+      states_t(i) = kSpilledSlot;
+      TF_RETURN_IF_ERROR(writer->WriteScalar(
+          slot_prefix, kFile, static_cast<int64_t>(slot.file)));
+      TF_RETURN_IF_ERROR(writer->WriteScalar(slot_prefix, kOffset, slot.offset));
+      TF_RETURN_IF_ERROR(writer->WriteScalar(slot_prefix, kLength, slot.length));
+    }
+  }
+  return writer->WriteTensor(prefix, kSlotStates, states);
+}
+
+Status SpillingBuffer::Restore(FunctionLibraryRuntime* flr,
+                               IteratorStateReader* reader,
+                               const std::string& prefix) {
+  DCHECK(files_.empty());
+  DCHECK_EQ(num_elements_in_memory_, 0);
+  Tensor filenames;
+  TF_RETURN_IF_ERROR(reader->ReadTensor(prefix, kSpillFiles, &filenames));
+  if (filenames.dtype() != DT_STRING || filenames.dims() != 1) {
+    return errors::DataLoss("Expected a vector of spill files, but got ",
+                            filenames.DebugString());
+  }
+  auto filenames_t = filenames.vec<tstring>();
+  files_.resize(filenames_t.size());
+  for (int64_t i = 0; i < filenames_t.size(); ++i) {
+    if (filenames_t(i).empty()) continue;
+    auto file = std::make_shared<SpillFile>();
+    file->filename = filenames_t(i);
+    file->owned = false;
+    file->checkpoint_filename = file->filename;
+    TF_RETURN_IF_ERROR(
+        env_->NewRandomAccessFile(file->filename, &file->reader));
+    files_[i] = std::move(file);
+  }
+
+  Tensor states;
+  TF_RETURN_IF_ERROR(reader->ReadTensor(prefix, kSlotStates, &states));
+  if (states.dtype() != DT_INT64 || states.shape() != TensorShape({size()})) {
+    return errors::DataLoss("Expected slot states of shape [", size(),
+                            "], but got ", states.DebugString());
+  }
+  auto states_t = states.vec<int64_t>();
+  for (int64_t i = 0; i < size(); ++i) {
+    slots_[i] = Slot();
+    const std::string slot_prefix = absl::StrCat(prefix, "::", i);
+    if (states_t(i) == kInMemorySlot) {
+      int64_t num_components;
+      TF_RETURN_IF_ERROR(
+          reader->ReadScalar(slot_prefix, kNumComponents, &num_components));
+      std::vector<Tensor> element(num_components);
+      for (int j = 0; j < num_components; ++j) {
+        TF_RETURN_IF_ERROR(reader->ReadTensor(
+            flr, slot_prefix, absl::StrCat(kComponent, "[", j, "]"),
+            &element[j]));
+      }
+      TF_RETURN_IF_ERROR(Put(i, std::move(element)));
+    } else if (states_t(i) == kSpilledSlot) {
+      int64_t file_index;
+      Slot& slot = slots_[i];
+      TF_RETURN_IF_ERROR(reader->ReadScalar(slot_prefix, kFile, &file_index));
+      TF_RETURN_IF_ERROR(reader->ReadScalar(slot_prefix, kOffset, &slot.offset));
+      TF_RETURN_IF_ERROR(reader->ReadScalar(slot_prefix, kLength, &slot.length));
+      if (file_index < 0 || file_index >= files_.size() ||
+          files_[file_index] == nullptr) {
+        return errors::DataLoss("Invalid spill file ", file_index,
+                                " of slot ", i, " in checkpoint.");
+      }
+      if (num_elements_in_memory_ < max_elements_in_memory_) {
+        const SpillFile& file = *files_[file_index];
+        TF_RETURN_IF_ERROR(ReadSpilled(file.reader.get(), file.filename,
+                                       slot.offset, slot.length,
+                                       &slot.tensors));
+        slot.in_memory = true;
+        ++num_elements_in_memory_;
+      } else {
+        slot.file = file_index;
+        ++files_[file_index]->num_elements;
+      }
+      slot.empty = false;
+    } else if (states_t(i) != kEmptySlot) {
+      return errors::DataLoss("Invalid state ", states_t(i), " of slot ", i,
+                              " in checkpoint.");
+    }
+  }
+  // Drops the checkpoint files whose elements are all held in memory.
+  for (int32 i = 0; i < files_.size(); ++i) {
+    MaybeDeleteFile(i);
+  }
+  return Status::OK();
+}
+
+Status SpillingBuffer::Spill(Slot* slot) {
+  CompressedElement compressed;
+  TF_RETURN_IF_ERROR(CompressElement(slot->tensors, &compressed));
+  std::string serialized;
+  if (!compressed.SerializeToString(&serialized)) {
+    return errors::Internal("Failed to serialize compressed element.");
+  }
+  return Append(serialized, slot);
+}
+
+Status SpillingBuffer::Append(StringPiece serialized, Slot* slot) {
+  if (writer_ == nullptr || write_offset_ >= kMaxSpillFileBytes) {
+    TF_RETURN_IF_ERROR(StartSpillFile());
+  }
+  TF_RETURN_IF_ERROR(writer_->Append(serialized));
+  slot->file = files_.size() - 1;
+  slot->offset = write_offset_;
+  slot->length = serialized.size();
+  write_offset_ += serialized.size();
+  ++files_.back()->num_elements;
+  return Status::OK();
+}
+
+Status SpillingBuffer::StartSpillFile() {
+  if (writer_ != nullptr) {
+    TF_RETURN_IF_ERROR(writer_->Close());
+    writer_.reset();
+    MaybeDeleteFile(files_.size() - 1);
+  }
+  auto file = std::make_shared<SpillFile>();
+  file->filename = io::JoinPath(
+      spill_directory_,
+      absl::StrCat("spill_", absl::Hex(id_, absl::kZeroPad16), "_",
+                   files_.size()));
+  TF_RETURN_IF_ERROR(env_->RecursivelyCreateDir(spill_directory_));
+  TF_RETURN_IF_ERROR(env_->NewWritableFile(file->filename, &writer_));
+  TF_RETURN_IF_ERROR(env_->NewRandomAccessFile(file->filename, &file->reader));
+  files_.push_back(std::move(file));
+  write_offset_ = 0;
+  flushed_offset_ = 0;
+  return Status::OK();
+}
+
+void SpillingBuffer::ReleaseSpilled(Slot* slot) {
+  if (slot->file < 0) return;
+  --files_[slot->file]->num_elements;
+  MaybeDeleteFile(slot->file);
+}
+
+void SpillingBuffer::MaybeDeleteFile(int32 i) {
+  const std::shared_ptr<SpillFile>& file = files_[i];
+  if (file == nullptr || file->num_elements > 0) return;
+  // The file that is being written to is deleted when it is closed.
+  if (writer_ != nullptr && i == files_.size() - 1) return;
+  // Reads of taken elements that are still in flight own the file descriptor,
+  // so they are not affected.
+  if (file->owned) {
+    Status s = env_->DeleteFile(file->filename);
+    if (!s.ok()) {
+      LOG(WARNING) << "Failed to delete spill file " << file->filename << ": "
+                   << s;
+    }
+  }
+  files_[i] = nullptr;
+}
+
+}  // namespace data
+}  // namespace tensorflow
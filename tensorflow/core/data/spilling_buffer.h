@@ -0,0 +1,167 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_DATA_SPILLING_BUFFER_H_
+#define TENSORFLOW_CORE_DATA_SPILLING_BUFFER_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/framework/dataset.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/status.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+
+namespace tensorflow {
+namespace data {
+
+// A fixed-size array of dataset elements that keeps at most
+// `max_elements_in_memory` of them in memory. The other elements are
+// compressed with `CompressElement` and spilled to files in
+// `spill_directory`, so that the memory used by a large buffer is bounded by
+// the in-memory elements plus a few dozen bytes of bookkeeping per slot.
+//
+// Elements taken out of the buffer are read back from the spill files on a
+// background thread, so that the reads of several taken elements overlap.
+//
+// Checkpoints save in-memory elements as tensors, and spilled elements as
+// their location in the spill files, which are copied to a `checkpoint_*`
+// subdirectory of `spill_directory`. Spilled elements are thus never read
+// back to be saved. The copies belong to the checkpoint and are never deleted
+// by the buffer; a closed spill file is copied at most once and shared by
+// later checkpoints. The buffer's own spill files are deleted once they no
+// longer hold any element of the buffer, and when the buffer is destroyed.
+//
+// A given instance of SpillingBuffer is NOT safe for concurrent use by
+// multiple threads, but the elements it returns can be waited on from any
+// thread.
+class SpillingBuffer {
+ public:
+  // An element taken out of the buffer, which may still be being read back
+  // from a spill file.
+  class Element {
+   public:
+    Element() = default;
+
+    // Creates an element that is ready, e.g. one restored from a checkpoint.
+    explicit Element(std::vector<Tensor> tensors);
+
+    // Waits for the element to be read back. Returns the error of the read,
+    // if any.
+    Status Wait();
+
+    // Returns the tensors of the element.
+    // REQUIRES: Wait() returned OK.
+    std::vector<Tensor>* tensors() { return &tensors_; }
+
+   private:
+    friend class SpillingBuffer;
+
+    mutex mu_;
+    condition_variable cond_var_;
+    bool done_ TF_GUARDED_BY(mu_) = false;
+    Status status_ TF_GUARDED_BY(mu_);
+    std::vector<Tensor> tensors_;
+  };
+
+  SpillingBuffer(Env* env, const std::string& spill_directory, int64_t size,
+                 int64_t max_elements_in_memory);
+
+  // Deletes the spill files.
+  ~SpillingBuffer();
+
+  int64_t size() const { return slots_.size(); }
+
+  // The number of elements that are held in memory.
+  int64_t num_elements_in_memory() const { return num_elements_in_memory_; }
+
+  // Stores `element` in the empty slot `index`, spilling it if the buffer
+  // already holds `max_elements_in_memory` elements in memory.
+  Status Put(int64_t index, std::vector<Tensor> element);
+
+  // Takes the element out of the slot `index`, which becomes empty.
+  std::shared_ptr<Element> Take(int64_t index);
+
+  // Swaps the contents of the slots `i` and `j`.
+  void Swap(int64_t i, int64_t j);
+
+  // Saves the elements of the buffer under `prefix`, copying the spill files
+  // that hold elements to the checkpoint directory.
+  Status Save(IteratorStateWriter* writer, const std::string& prefix);
+
+  // Restores the buffer saved under `prefix`, keeping the first
+  // `max_elements_in_memory` elements in memory and reading the others from
+  // the spill files of the checkpoint when they are taken.
+  // `flr` is used to restore the dataset components of the elements. The
+  // buffer must be empty.
+  Status Restore(FunctionLibraryRuntime* flr, IteratorStateReader* reader,
+                 const std::string& prefix);
+
+ private:
+  struct SpillFile;
+
+  struct Slot {
+    bool empty = true;
+    // Whether `tensors` holds the element, rather than the spill files.
+    bool in_memory = false;
+    std::vector<Tensor> tensors;
+    // The location of the element in the spill files, with `file` -1 if the
+    // element has not been spilled.
+    int32 file = -1;
+    int64_t offset = 0;
+    int64_t length = 0;
+  };
+
+  // Compresses the tensors of `slot` and appends them to the current spill
+  // file.
+  Status Spill(Slot* slot);
+
+  // Appends the serialized `CompressedElement` of `slot` to the current spill
+  // file, and records its location in `slot`.
+  Status Append(StringPiece serialized, Slot* slot);
+
+  // Opens a new spill file for writing.
+  Status StartSpillFile();
+
+  // Drops the reference of a slot to its spill file, and deletes the file if
+  // it is no longer needed.
+  void ReleaseSpilled(Slot* slot);
+  void MaybeDeleteFile(int32 file);
+
+  Env* const env_;
+  const std::string spill_directory_;
+  const int64_t max_elements_in_memory_;
+  // Used to name the spill files of this buffer.
+  const uint64 id_;
+
+  std::vector<Slot> slots_;
+  int64_t num_elements_in_memory_ = 0;
+  // Indexed by `Slot::file`. Deleted files are null.
+  std::vector<std::shared_ptr<SpillFile>> files_;
+  // The file that elements are spilled to, which is the last one of `files_`.
+  std::unique_ptr<WritableFile> writer_;
+  int64_t write_offset_ = 0;
+  // The spilled bytes of the current file that can be read back.
+  int64_t flushed_offset_ = 0;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(SpillingBuffer);
+};
+
+}  // namespace data
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_DATA_SPILLING_BUFFER_H_
@@ -0,0 +1,220 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/data/spilling_buffer.h"
+
+#include <algorithm>
+
+#include "absl/strings/match.h"
+#include "tensorflow/core/data/serialization_utils.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/path.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace data {
+namespace {
+
+constexpr char kPrefix[] = "Iterator:Shuffle";
+
+std::vector<Tensor> MakeElement(int64_t i) {
+  return {test::AsTensor<int64_t>({i, i + 1}),
+          test::AsTensor<tstring>({absl::StrCat("element_", i)})};
+}
+
+void ExpectElement(SpillingBuffer::Element* element, int64_t i) {
+  TF_ASSERT_OK(element->Wait());
+  std::vector<Tensor> expected = MakeElement(i);
+  ASSERT_EQ(element->tensors()->size(), expected.size());
+  test::ExpectTensorEqual<int64_t>((*element->tensors())[0], expected[0]);
+  test::ExpectTensorEqual<tstring>((*element->tensors())[1], expected[1]);
+}
+
+std::string SpillDirectory(const std::string& name) {
+  return io::JoinPath(testing::TmpDir(), name);
+}
+
+// Returns the number of spill files of the buffers in `directory`, leaving out
+// the checkpoint directories.
+int64_t NumSpillFiles(const std::string& directory) {
+  std::vector<string> children;
+  if (!Env::Default()->GetChildren(directory, &children).ok()) return 0;
+  return std::count_if(children.begin(), children.end(),
+                       [](const string& child) {
+                         return absl::StartsWith(child, "spill_");
+                       });
+}
+
+TEST(SpillingBufferTest, InMemory) {
+  const std::string directory = SpillDirectory("in_memory");
+  SpillingBuffer buffer(Env::Default(), directory, /*size=*/4,
+                        /*max_elements_in_memory=*/4);
+  for (int64_t i = 0; i < 4; ++i) {
+    TF_ASSERT_OK(buffer.Put(i, MakeElement(i)));
+  }
+  EXPECT_EQ(buffer.num_elements_in_memory(), 4);
+  EXPECT_EQ(NumSpillFiles(directory), 0);
+  buffer.Swap(0, 3);
+  ExpectElement(buffer.Take(0).get(), 3);
+  ExpectElement(buffer.Take(3).get(), 0);
+  EXPECT_EQ(buffer.num_elements_in_memory(), 2);
+  TF_ASSERT_OK(buffer.Put(0, MakeElement(10)));
+  ExpectElement(buffer.Take(0).get(), 10);
+}
+
+TEST(SpillingBufferTest, Spill) {
+  const std::string directory = SpillDirectory("spill");
+  {
+    SpillingBuffer buffer(Env::Default(), directory, /*size=*/10,
+                          /*max_elements_in_memory=*/3);
+    for (int64_t i = 0; i < 10; ++i) {
+      TF_ASSERT_OK(buffer.Put(i, MakeElement(i)));
+    }
+    EXPECT_EQ(buffer.num_elements_in_memory(), 3);
+    EXPECT_EQ(NumSpillFiles(directory), 1);
+    // Takes several elements before waiting for them.
+    std::vector<std::shared_ptr<SpillingBuffer::Element>> elements;
+    for (int64_t i = 9; i >= 0; --i) {
+      elements.push_back(buffer.Take(i));
+    }
+    for (int64_t i = 0; i < 10; ++i) {
+      ExpectElement(elements[i].get(), 9 - i);
+    }
+    EXPECT_EQ(buffer.num_elements_in_memory(), 0);
+    // Slots that were emptied can be refilled.
+    TF_ASSERT_OK(buffer.Put(5, MakeElement(20)));
+    ExpectElement(buffer.Take(5).get(), 20);
+  }
+  EXPECT_EQ(NumSpillFiles(directory), 0);
+}
+
+TEST(SpillingBufferTest, SaveAndRestore) {
+  const std::string directory = SpillDirectory("save_and_restore");
+  VariantTensorDataWriter writer;
+  {
+    SpillingBuffer buffer(Env::Default(), directory, /*size=*/6,
+                          /*max_elements_in_memory=*/2);
+    for (int64_t i = 0; i < 5; ++i) {
+      TF_ASSERT_OK(buffer.Put(i, MakeElement(i)));
+    }
+    ExpectElement(buffer.Take(1).get(), 1);
+    buffer.Swap(1, 4);
+    TF_ASSERT_OK(buffer.Save(&writer, kPrefix));
+    // The buffer still holds its elements after saving them.
+    ExpectElement(buffer.Take(0).get(), 0);
+  }
+  // The checkpoint has its own copy of the spill files.
+  EXPECT_EQ(NumSpillFiles(directory), 0);
+
+  std::vector<const VariantTensorData*> data;
+  writer.GetData(&data);
+  VariantTensorDataReader reader(data);
+  {
+    SpillingBuffer buffer(Env::Default(), directory, /*size=*/6,
+                          /*max_elements_in_memory=*/2);
+    TF_ASSERT_OK(buffer.Restore(/*flr=*/nullptr, &reader, kPrefix));
+    // The first two elements are restored in memory, and the others are read
+    // from the copies of the checkpoint.
+    EXPECT_EQ(buffer.num_elements_in_memory(), 2);
+    EXPECT_EQ(NumSpillFiles(directory), 0);
+    ExpectElement(buffer.Take(0).get(), 0);
+    ExpectElement(buffer.Take(1).get(), 4);
+    ExpectElement(buffer.Take(2).get(), 2);
+    ExpectElement(buffer.Take(3).get(), 3);
+    TF_ASSERT_OK(buffer.Put(5, MakeElement(5)));
+    ExpectElement(buffer.Take(5).get(), 5);
+  }
+  EXPECT_EQ(NumSpillFiles(directory), 0);
+}
+
+TEST(SpillingBufferTest, RestoreInMemory) {
+  const std::string directory = SpillDirectory("restore_in_memory");
+  VariantTensorDataWriter writer;
+  {
+    SpillingBuffer buffer(Env::Default(), directory, /*size=*/4,
+                          /*max_elements_in_memory=*/1);
+    for (int64_t i = 0; i < 4; ++i) {
+      TF_ASSERT_OK(buffer.Put(i, MakeElement(i)));
+    }
+    TF_ASSERT_OK(buffer.Save(&writer, kPrefix));
+  }
+
+  std::vector<const VariantTensorData*> data;
+  writer.GetData(&data);
+  VariantTensorDataReader reader(data);
+  SpillingBuffer buffer(Env::Default(), directory, /*size=*/4,
+                        /*max_elements_in_memory=*/4);
+  TF_ASSERT_OK(buffer.Restore(/*flr=*/nullptr, &reader, kPrefix));
+  EXPECT_EQ(buffer.num_elements_in_memory(), 4);
+  EXPECT_EQ(NumSpillFiles(directory), 0);
+  for (int64_t i = 0; i < 4; ++i) {
+    ExpectElement(buffer.Take(i).get(), i);
+  }
+}
+
+TEST(SpillingBufferTest, RestoreWithSmallerMemoryBudget) {
+  const std::string directory = SpillDirectory("smaller_memory_budget");
+  VariantTensorDataWriter writer;
+  {
+    SpillingBuffer buffer(Env::Default(), directory, /*size=*/4,
+                          /*max_elements_in_memory=*/4);
+    for (int64_t i = 0; i < 4; ++i) {
+      TF_ASSERT_OK(buffer.Put(i, MakeElement(i)));
+    }
+    TF_ASSERT_OK(buffer.Save(&writer, kPrefix));
+  }
+
+  std::vector<const VariantTensorData*> data;
+  writer.GetData(&data);
+  VariantTensorDataReader reader(data);
+  SpillingBuffer buffer(Env::Default(), directory, /*size=*/4,
+                        /*max_elements_in_memory=*/1);
+  TF_ASSERT_OK(buffer.Restore(/*flr=*/nullptr, &reader, kPrefix));
+  EXPECT_EQ(buffer.num_elements_in_memory(), 1);
+  for (int64_t i = 0; i < 4; ++i) {
+    ExpectElement(buffer.Take(i).get(), i);
+  }
+}
+
+TEST(SpillingBufferTest, RestoreTwice) {
+  const std::string directory = SpillDirectory("restore_twice");
+  VariantTensorDataWriter writer;
+  {
+    SpillingBuffer buffer(Env::Default(), directory, /*size=*/4,
+                          /*max_elements_in_memory=*/1);
+    for (int64_t i = 0; i < 4; ++i) {
+      TF_ASSERT_OK(buffer.Put(i, MakeElement(i)));
+    }
+    TF_ASSERT_OK(buffer.Save(&writer, kPrefix));
+  }
+
+  std::vector<const VariantTensorData*> data;
+  writer.GetData(&data);
+  // Taking the elements of a restored buffer leaves the checkpoint intact.
+  for (int restore = 0; restore < 2; ++restore) {
+    VariantTensorDataReader reader(data);
+    SpillingBuffer buffer(Env::Default(), directory, /*size=*/4,
+                          /*max_elements_in_memory=*/1);
+    TF_ASSERT_OK(buffer.Restore(/*flr=*/nullptr, &reader, kPrefix));
+    EXPECT_EQ(buffer.num_elements_in_memory(), 1);
+    for (int64_t i = 3; i >= 0; --i) {
+      ExpectElement(buffer.Take(i).get(), i);
+    }
+  }
+}
+
+}  // namespace
+}  // namespace data
+}  // namespace tensorflow
@@ -0,0 +1,248 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/data/staging_pool.h"
+
+#if !defined(PLATFORM_WINDOWS)
+#include <sys/mman.h>
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "tensorflow/core/framework/allocation_description.pb.h"
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/mem.h"
+#include "tensorflow/core/util/env_var.h"
+
+namespace tensorflow {
+namespace data {
+namespace {
+
+// Buffers are page aligned and their sizes are rounded up to a multiple of
+// the page size, since pages are the unit of locking.
+constexpr size_t kPageSize = 4096;
+
+size_t RoundUp(size_t num_bytes, size_t multiple) {
+  return (num_bytes + multiple - 1) / multiple * multiple;
+}
+
+// Allocates a page-locked buffer, falling back to an unlocked buffer if the
+// pages cannot be locked.
+void* AllocatePinned(size_t num_bytes) {
+  void* ptr = port::AlignedMalloc(num_bytes, kPageSize);
+  if (ptr == nullptr) {
+    return nullptr;
+  }
+#if !defined(PLATFORM_WINDOWS)
+  if (mlock(ptr, num_bytes) != 0) {
+    LOG_FIRST_N(WARNING, 1)
+        << "Failed to lock a " << num_bytes << " byte staging buffer in "
+        << "memory: " << strerror(errno) << ". Staging buffers that cannot "
+        << "be locked are used unlocked; consider raising RLIMIT_MEMLOCK.";
+  }
+#endif
+  return ptr;
+}
+
+void FreePinned(void* ptr, size_t num_bytes) {
+#if !defined(PLATFORM_WINDOWS)
+  // Fails harmlessly if the buffer was not locked.
+  munlock(ptr, num_bytes);
+#endif
+  port::AlignedFree(ptr);
+}
+
+// Returns a buffer to its pool once the last tensor aliasing it is destroyed.
+class BufferReference {
+ public:
+  BufferReference(void* data, std::function<void(void*)> release)
+      : data_(data), release_(std::move(release)) {}
+  ~BufferReference() { release_(data_); }
+
+  char* data() const { return static_cast<char*>(data_); }
+
+ private:
+  void* const data_;
+  const std::function<void(void*)> release_;
+};
+
+// A TensorBuffer that aliases part of an assembled element buffer.
+class AssembledTensorBuffer : public TensorBuffer {
+ public:
+  AssembledTensorBuffer(std::shared_ptr<BufferReference> buffer,
+                        size_t offset, size_t size)
+      : TensorBuffer(buffer->data() + offset),
+        buffer_(std::move(buffer)),
+        size_(size) {}
+
+  size_t size() const override { return size_; }
+  TensorBuffer* root_buffer() override { return this; }
+  void FillAllocationDescription(AllocationDescription* proto) const override {
+    proto->set_requested_bytes(size_);
+    proto->set_allocator_name("staging_pool");
+  }
+  // The buffer is shared with the other components of the element, so it
+  // must not be forwarded to a kernel output.
+  bool OwnsMemory() const override { return false; }
+
+ private:
+  const std::shared_ptr<BufferReference> buffer_;
+  const size_t size_;
+};
+
+}  // namespace
+
+StagingPool::StagingPool(int64_t max_cached_bytes)
+    : max_cached_bytes_(max_cached_bytes) {}
+
+StagingPool::~StagingPool() {
+  mutex_lock l(mu_);
+  DCHECK(allocated_.empty())
+      << "StagingPool destroyed while " << allocated_.size()
+      << " of its buffers are in use";
+  for (auto& cached : cached_) {
+    for (void* ptr : cached.second) {
+      FreePinned(ptr, cached.first);
+    }
+  }
+}
+
+StagingPool* StagingPool::Global() {
+  static StagingPool* pool = [] {
+    constexpr int64_t kDefaultMaxCachedBytes = int64_t{1} << 30;
+    int64_t max_cached_bytes;
+    Status s = ReadInt64FromEnvVar("TF_DATA_STAGING_POOL_MAX_CACHED_BYTES",
+                                   kDefaultMaxCachedBytes, &max_cached_bytes);
+    if (!s.ok()) {
+      LOG(ERROR) << "Invalid TF_DATA_STAGING_POOL_MAX_CACHED_BYTES: " << s;
+      max_cached_bytes = kDefaultMaxCachedBytes;
+    }
+    return new StagingPool(max_cached_bytes);
+  }();
+  return pool;
+}
+
+void* StagingPool::Allocate(size_t num_bytes) {
+  const size_t size = RoundUp(std::max<size_t>(num_bytes, 1), kPageSize);
+  void* ptr = nullptr;
+  {
+    mutex_lock l(mu_);
+    auto it = cached_.find(size);
+    if (it != cached_.end() && !it->second.empty()) {
+      ptr = it->second.back();
+      it->second.pop_back();
+      cached_bytes_ -= size;
+    }
+  }
+  if (ptr == nullptr) {
+    ptr = AllocatePinned(size);
+    if (ptr == nullptr) {
+      return nullptr;
+    }
+  }
+  mutex_lock l(mu_);
+  allocated_.emplace(static_cast<const char*>(ptr), size);
+  allocated_bytes_ += size;
+  return ptr;
+}
+
+void StagingPool::Deallocate(void* ptr) {
+  size_t size;
+  {
+    mutex_lock l(mu_);
+    auto it = allocated_.find(static_cast<const char*>(ptr));
+    DCHECK(it != allocated_.end());
+    size = it->second;
+    allocated_.erase(it);
+    allocated_bytes_ -= size;
+    if (cached_bytes_ + size <= max_cached_bytes_) {
+      cached_[size].push_back(ptr);
+      cached_bytes_ += size;
+      return;
+    }
+  }
+  FreePinned(ptr, size);
+}
+
+Status StagingPool::Assemble(std::vector<Tensor>* element) {
+  std::vector<size_t> offsets(element->size());
+  std::vector<size_t> components;
+  size_t total_bytes = 0;
+  for (size_t i = 0; i < element->size(); ++i) {
+    const Tensor& component = (*element)[i];
+    if (!DataTypeCanUseMemcpy(component.dtype()) ||
+        component.TotalBytes() == 0) {
+      continue;
+    }
+    total_bytes = RoundUp(total_bytes, Allocator::kAllocatorAlignment);
+    offsets[i] = total_bytes;
+    total_bytes += component.TotalBytes();
+    components.push_back(i);
+  }
+  if (components.empty()) {
+    return Status::OK();
+  }
+  void* data = Allocate(total_bytes);
+  if (data == nullptr) {
+    return errors::ResourceExhausted("Failed to allocate a ", total_bytes,
+                                     " byte staging buffer.");
+  }
+  auto buffer = std::make_shared<BufferReference>(
+      data, [this](void* ptr) { Deallocate(ptr); });
+  for (size_t i : components) {
+    Tensor& component = (*element)[i];
+    const size_t num_bytes = component.TotalBytes();
+    auto* tensor_buffer =
+        new AssembledTensorBuffer(buffer, offsets[i], num_bytes);
+    memcpy(tensor_buffer->data(), component.tensor_data().data(), num_bytes);
+    Tensor staged(component.dtype(), component.shape(), tensor_buffer);
+    tensor_buffer->Unref();
+    component = std::move(staged);
+  }
+  return Status::OK();
+}
+
+bool StagingPool::Contains(const Tensor& tensor) const {
+  const char* data = tensor.tensor_data().data();
+  mutex_lock l(mu_);
+  auto it = allocated_.upper_bound(data);
+  if (it == allocated_.begin()) {
+    return false;
+  }
+  --it;
+  return data + tensor.TotalBytes() <= it->first + it->second;
+}
+
+int64_t StagingPool::allocated_bytes() const {
+  mutex_lock l(mu_);
+  return allocated_bytes_;
+}
+
+int64_t StagingPool::cached_bytes() const {
+  mutex_lock l(mu_);
+  return cached_bytes_;
+}
+
+}  // namespace data
+}  // namespace tensorflow
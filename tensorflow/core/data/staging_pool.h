@@ -0,0 +1,91 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_DATA_STAGING_POOL_H_
+#define TENSORFLOW_CORE_DATA_STAGING_POOL_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/status.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+
+namespace tensorflow {
+namespace data {
+
+// A pool of page-locked host buffers for staging dataset elements before they
+// are copied to an accelerator. Buffers are locked with `mlock`, so that a
+// transfer out of them does not go through an intermediate pinned buffer. If
+// locking fails (e.g. because of RLIMIT_MEMLOCK), the buffer is used unlocked.
+//
+// `Assemble` copies the components of an element into a single buffer, so
+// that the element can be transferred with one bulk copy.
+//
+// Released buffers are kept for reuse by allocations of the same size, up to
+// `max_cached_bytes` in total.
+//
+// The pool must outlive all tensors assembled in it. Use `Global()` unless
+// the lifetime of the tensors is known. StagingPool is thread-safe.
+class StagingPool {
+ public:
+  explicit StagingPool(int64_t max_cached_bytes);
+  ~StagingPool();
+
+  StagingPool(const StagingPool&) = delete;
+  StagingPool& operator=(const StagingPool&) = delete;
+
+  // Returns the process-wide pool. It caches up to
+  // TF_DATA_STAGING_POOL_MAX_CACHED_BYTES (default 1GB) of released buffers.
+  static StagingPool* Global();
+
+  // Copies the components of `element` that can be copied with memcpy into a
+  // single buffer from the pool, and replaces them with tensors that alias it. Each component starts at a
+  // multiple of `Allocator::kAllocatorAlignment`. The buffer returns to the
+  // pool once all of these tensors are destroyed.
+  Status Assemble(std::vector<Tensor>* element);
+
+  // Returns whether the data of `tensor` resides in a buffer from the pool.
+  bool Contains(const Tensor& tensor) const;
+
+  // Returns the total size of the buffers in use.
+  int64_t allocated_bytes() const;
+
+  // Returns the total size of the released buffers kept for reuse.
+  int64_t cached_bytes() const;
+
+ private:
+  // Returns a buffer of at least `num_bytes` bytes.
+  void* Allocate(size_t num_bytes) TF_LOCKS_EXCLUDED(mu_);
+  // Returns a buffer obtained from `Allocate` to the pool.
+  void Deallocate(void* ptr) TF_LOCKS_EXCLUDED(mu_);
+
+  const int64_t max_cached_bytes_;
+
+  mutable mutex mu_;
+  // The buffers in use, keyed by address, with their sizes.
+  std::map<const char*, size_t> allocated_ TF_GUARDED_BY(mu_);
+  // Released buffers, keyed by size.
+  absl::flat_hash_map<size_t, std::vector<void*>> cached_ TF_GUARDED_BY(mu_);
+  int64_t allocated_bytes_ TF_GUARDED_BY(mu_) = 0;
+  int64_t cached_bytes_ TF_GUARDED_BY(mu_) = 0;
+};
+
+}  // namespace data
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_DATA_STAGING_POOL_H_
@@ -0,0 +1,135 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/data/staging_pool.h"
+
+#include <vector>
+
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace data {
+namespace {
+
+constexpr int64_t kMaxCachedBytes = 1 << 20;
+
+std::vector<Tensor> MakeElement() {
+  return {test::AsTensor<int64_t>({1, 2, 3}),
+          test::AsTensor<float>({1.0, 2.0, 3.0, 4.0}, {2, 2}),
+          test::AsTensor<tstring>({"a", "b"})};
+}
+
+TEST(StagingPoolTest, AssembleIsContiguous) {
+  StagingPool pool(kMaxCachedBytes);
+  {
+    std::vector<Tensor> element = MakeElement();
+    TF_ASSERT_OK(pool.Assemble(&element));
+    std::vector<Tensor> expected = MakeElement();
+    test::ExpectTensorEqual<int64_t>(element[0], expected[0]);
+    test::ExpectTensorEqual<float>(element[1], expected[1]);
+    test::ExpectTensorEqual<tstring>(element[2], expected[2]);
+    EXPECT_TRUE(pool.Contains(element[0]));
+    EXPECT_TRUE(pool.Contains(element[1]));
+    EXPECT_FALSE(pool.Contains(element[2]));
+    EXPECT_EQ(element[1].tensor_data().data() - element[0].tensor_data().data(),
+              Allocator::kAllocatorAlignment);
+    EXPECT_EQ(pool.allocated_bytes(), 4096);
+    EXPECT_EQ(pool.cached_bytes(), 0);
+    // The buffer stays in use while any of its components is alive.
+    element.erase(element.begin());
+    EXPECT_EQ(pool.allocated_bytes(), 4096);
+  }
+  EXPECT_EQ(pool.allocated_bytes(), 0);
+  EXPECT_EQ(pool.cached_bytes(), 4096);
+}
+
+TEST(StagingPoolTest, BuffersAreReused) {
+  StagingPool pool(kMaxCachedBytes);
+  const void* data;
+  {
+    std::vector<Tensor> element = MakeElement();
+    TF_ASSERT_OK(pool.Assemble(&element));
+    data = element[0].tensor_data().data();
+  }
+  std::vector<Tensor> element = MakeElement();
+  TF_ASSERT_OK(pool.Assemble(&element));
+  EXPECT_EQ(element[0].tensor_data().data(), data);
+  EXPECT_EQ(pool.cached_bytes(), 0);
+}
+
+TEST(StagingPoolTest, CachedBytesAreBounded) {
+  StagingPool pool(/*max_cached_bytes=*/0);
+  {
+    std::vector<Tensor> element = MakeElement();
+    TF_ASSERT_OK(pool.Assemble(&element));
+  }
+  EXPECT_EQ(pool.allocated_bytes(), 0);
+  EXPECT_EQ(pool.cached_bytes(), 0);
+}
+
+TEST(StagingPoolTest, BatchedElementIsContiguous) {
+  StagingPool pool(kMaxCachedBytes);
+  std::vector<Tensor> element;
+  for (int64_t i = 0; i < 3; ++i) {
+    Tensor component(DT_FLOAT, TensorShape({5, 7}));
+    test::FillIota<float>(&component, 0.0);
+    element.push_back(component);
+  }
+  TF_ASSERT_OK(pool.Assemble(&element));
+  // Each 140 byte component starts at a multiple of the allocator alignment.
+  const int64_t stride = (140 + Allocator::kAllocatorAlignment - 1) /
+                         Allocator::kAllocatorAlignment *
+                         Allocator::kAllocatorAlignment;
+  for (int64_t i = 0; i < 3; ++i) {
+    EXPECT_EQ(element[i].tensor_data().data() - element[0].tensor_data().data(),
+              i * stride);
+    EXPECT_TRUE(pool.Contains(element[i]));
+  }
+  // A single page-sized buffer holds the whole element.
+  EXPECT_EQ(pool.allocated_bytes(), 4096);
+}
+
+TEST(StagingPoolTest, NothingToAssemble) {
+  StagingPool pool(kMaxCachedBytes);
+  std::vector<Tensor> element = {test::AsTensor<tstring>({"a"}),
+                                 Tensor(DT_INT64, TensorShape({0}))};
+  TF_ASSERT_OK(pool.Assemble(&element));
+  EXPECT_EQ(pool.allocated_bytes(), 0);
+}
+
+void BM_Assemble(::testing::benchmark::State& state) {
+  const int64_t num_components = state.range(0);
+  StagingPool pool(kMaxCachedBytes << 6);
+  std::vector<Tensor> element;
+  for (int64_t i = 0; i < num_components; ++i) {
+    Tensor component(DT_FLOAT, TensorShape({32, 1024}));
+    test::FillIota<float>(&component, 0.0);
+    element.push_back(component);
+  }
+  for (auto s : state) {
+    std::vector<Tensor> staged = element;
+    TF_CHECK_OK(pool.Assemble(&staged));
+  }
+  state.SetBytesProcessed(state.iterations() * num_components * 32 * 1024 *
+                          sizeof(float));
+}
+
+BENCHMARK(BM_Assemble)->Arg(1)->Arg(4)->Arg(16);
+
+}  // namespace
+}  // namespace data
+}  // namespace tensorflow
@@ -72,6 +72,13 @@ BaseRemoteRendezvous* BaseRendezvousMgr::FindOrCreate(int64_t step_id) {
 void BaseRendezvousMgr::RecvLocalAsync(int64_t step_id,
                                        const Rendezvous::ParsedKey& parsed,
                                        Rendezvous::DoneCallback done) {
+  RecvLocalAsync(step_id, parsed, Rendezvous::Args(), std::move(done));
+}
+
+void BaseRendezvousMgr::RecvLocalAsync(int64_t step_id,
+                                       const Rendezvous::ParsedKey& parsed,
+                                       const Rendezvous::Args& recv_args,
+                                       Rendezvous::DoneCallback done) {
   auto rendez = FindOrCreate(step_id);
   auto done_cb = [rendez, done = std::move(done)](
                      const Status& s, const Rendezvous::Args& send_args,
@@ -80,7 +87,7 @@ void BaseRendezvousMgr::RecvLocalAsync(int64_t step_id,
     rendez->Unref();
     done(s, send_args, recv_args, v, dead);
   };
-  rendez->RecvLocalAsync(parsed, std::move(done_cb));
+  rendez->RecvLocalAsync(parsed, recv_args, std::move(done_cb));
 }
 
 Status BaseRendezvousMgr::RecvLocal(int64_t step_id,
@@ -157,7 +164,7 @@ Status BaseRemoteRendezvous::Initialize(WorkerSession* session) {
     std::swap(deferred_calls, deferred_calls_);
   }
   for (auto& call : deferred_calls) {
-    RecvLocalAsyncInternal(call.parsed, std::move(call.done));
+    RecvLocalAsyncInternal(call.parsed, call.recv_args, std::move(call.done));
   }
   return Status::OK();
 }
@@ -344,6 +351,7 @@ void BaseRemoteRendezvous::RecvAsync(const ParsedKey& parsed,
 }
 
 void BaseRemoteRendezvous::RecvLocalAsync(const ParsedKey& parsed,
+                                          const Args& recv_args,
                                           DoneCallback done) {
   // Test whether the rendezvous is initialized using a shared lock, to avoid
   // the need for exclusive access in the common case.
@@ -357,22 +365,23 @@ void BaseRemoteRendezvous::RecvLocalAsync(const ParsedKey& parsed,
       // rendezvous logic. At some point after Initialize() is called, a Tensor
       // is produced locally that will then be sent in response to the incoming
       // RPC.
-      DeferredCall call(parsed, std::move(done));
+      DeferredCall call(parsed, recv_args, std::move(done));
       deferred_calls_.push_back(call);
       return;
     }
   }
-  RecvLocalAsyncInternal(parsed, std::move(done));
+  RecvLocalAsyncInternal(parsed, recv_args, std::move(done));
 }
 
 void BaseRemoteRendezvous::RecvLocalAsyncInternal(const ParsedKey& parsed,
+                                                  const Args& recv_args,
                                                   DoneCallback done) {
   Status s = ValidateDevices(parsed, true /* is_src */);
   if (!s.ok()) {
     done(s, Args(), Args(), Tensor(), false);
     return;
   }
-  local_->RecvAsync(parsed, Args(), std::move(done));
+  local_->RecvAsync(parsed, recv_args, std::move(done));
 }
 
 void BaseRemoteRendezvous::StartAbort(const Status& s) {
@@ -443,7 +452,8 @@ void BaseRemoteRendezvous::DeregisterCall(BaseRecvTensorCall* call) {
 }
 
 BaseRemoteRendezvous::DeferredCall::DeferredCall(const ParsedKey& parsed,
+                                                 const Args& recv_args,
                                                  DoneCallback done)
-    : parsed(parsed), done(std::move(done)) {}
+    : parsed(parsed), recv_args(recv_args), done(std::move(done)) {}
 
 }  // end namespace tensorflow
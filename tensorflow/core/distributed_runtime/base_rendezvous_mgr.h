@@ -78,6 +78,10 @@ class BaseRendezvousMgr : public RendezvousMgrInterface {
   void RecvLocalAsync(int64_t step_id, const Rendezvous::ParsedKey& parsed,
                       Rendezvous::DoneCallback done) override;
 
+  void RecvLocalAsync(int64_t step_id, const Rendezvous::ParsedKey& parsed,
+                      const Rendezvous::Args& recv_args,
+                      Rendezvous::DoneCallback done) override;
+
   // Synchronous wrapper for RecvLocalAsync.
   Status RecvLocal(int64_t step_id, const Rendezvous::ParsedKey& parsed,
                    Tensor* val, bool* is_dead) override;
@@ -144,7 +148,8 @@ class BaseRemoteRendezvous : public RemoteRendezvous {
   // is detected.
   //
   // REQUIRES: "parsed" is one that will be Saved into the local rendezvous.
-  void RecvLocalAsync(const ParsedKey& parsed, DoneCallback done);
+  void RecvLocalAsync(const ParsedKey& parsed, const Args& recv_args,
+                      DoneCallback done);
 
  protected:
   virtual void RecvFromRemoteAsync(const Rendezvous::ParsedKey& parsed,
@@ -184,9 +189,11 @@ class BaseRemoteRendezvous : public RemoteRendezvous {
   // Data structures to handle calls when partially initialized.
   struct DeferredCall {
     const ParsedKey parsed;
+    const Args recv_args;
     DoneCallback done;
 
-    DeferredCall(const ParsedKey& parsed, DoneCallback done);
+    DeferredCall(const ParsedKey& parsed, const Args& recv_args,
+                 DoneCallback done);
   };
   std::vector<DeferredCall> deferred_calls_ TF_GUARDED_BY(mu_);
 
@@ -214,7 +221,8 @@ class BaseRemoteRendezvous : public RemoteRendezvous {
                           Tensor* out, StatusCallback done);
 
   // Must be called only if fully initialized.
-  void RecvLocalAsyncInternal(const ParsedKey& parsed, DoneCallback done);
+  void RecvLocalAsyncInternal(const ParsedKey& parsed, const Args& recv_args,
+                              DoneCallback done);
 
   TF_DISALLOW_COPY_AND_ASSIGN(BaseRemoteRendezvous);
 };
@@ -195,6 +195,11 @@ void CollectiveParamResolverDistributed::CompleteInstanceAsync(
             if (ir->status.ok()) {
               response->set_instance_key(cp->instance.instance_key);
               response->set_source_rank(ir->source_rank);
+              response->set_pipeline_segments(
+                  cp->instance.impl_details.pipeline_segments);
+              response->set_wire_dtype(cp->instance.impl_details.wire_dtype);
+              response->set_collective_name(
+                  cp->instance.impl_details.collective_name);
             }
           }
         }
@@ -343,6 +348,12 @@ Status CollectiveParamResolverDistributed::UpdateInstanceCache(
     }
     ir->source_rank = source_rank;
   }
+  // Use the implementation settings of the group leader, so that all members
+  // exchange values the same way.
+  CollImplDetails& impl_details = ir->shared->instance.impl_details;
+  impl_details.pipeline_segments = resp.pipeline_segments();
+  impl_details.wire_dtype = resp.wire_dtype();
+  impl_details.collective_name = resp.collective_name();
   if (ir->known_count < cp->group.group_size) {
     ir->known_count = cp->group.group_size;
     const int ir_known_size = ir->known.size();
@@ -381,5 +381,30 @@ TEST_F(DeviceResDistTest, Workers4Devices3) {
   ValidateCollectiveParams(num_workers, num_devices);
 }
 
+TEST_F(DeviceResDistTest, MembersAgreeOnCollectiveName) {
+  const int num_workers = 2;
+  const int num_devices = 1;
+  DefineWorkers(num_workers, num_devices, "CPU", /*nccl*/ false);
+  DefineCollectiveParams(num_workers, num_devices, "CPU");
+  // Stands in for environments in which the members would choose different
+  // implementations on their own.
+  cp_["/job:worker/replica:0/task:0/device:CPU:0"]
+      ->instance.impl_details.communication_hint = "halving_doubling";
+  cp_["/job:worker/replica:0/task:1/device:CPU:0"]
+      ->instance.impl_details.communication_hint = "ring";
+  IssueRequests(num_workers, num_devices);
+  ValidateCollectiveParams(num_workers, num_devices);
+  // Which hint wins depends on which member is resolved first, but all
+  // members must agree.
+  const string& collective_name =
+      cp_["/job:worker/replica:0/task:0/device:CPU:0"]
+          ->instance.impl_details.collective_name;
+  EXPECT_THAT(collective_name,
+              ::testing::AnyOf("RecursiveHalvingDoublingReduce", "RingReduce"));
+  EXPECT_EQ(cp_["/job:worker/replica:0/task:1/device:CPU:0"]
+                ->instance.impl_details.collective_name,
+            collective_name);
+}
+
 }  // namespace
 }  // namespace tensorflow
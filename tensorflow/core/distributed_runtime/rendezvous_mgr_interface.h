@@ -84,6 +84,16 @@ class RendezvousMgrInterface {
                               const Rendezvous::ParsedKey& parsed,
                               Rendezvous::DoneCallback done) = 0;
 
+  // Like the above, but passes "recv_args" to the local rendezvous. In
+  // particular, the receive is cancelled through
+  // "recv_args.cancellation_manager" if it has not completed yet.
+  //
+  // This method is used by the rpc handler of RecvTensorBatch.
+  virtual void RecvLocalAsync(int64_t step_id,
+                              const Rendezvous::ParsedKey& parsed,
+                              const Rendezvous::Args& recv_args,
+                              Rendezvous::DoneCallback done) = 0;
+
   // Synchronous wrapper for RecvLocalAsync.
   virtual Status RecvLocal(int64_t step_id, const Rendezvous::ParsedKey& parsed,
                            Tensor* val, bool* is_dead) = 0;
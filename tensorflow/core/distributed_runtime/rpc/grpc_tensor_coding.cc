@@ -15,6 +15,8 @@ limitations under the License.
 
 #include "tensorflow/core/distributed_runtime/rpc/grpc_tensor_coding.h"
 
+#include <vector>
+
 #include "grpcpp/support/byte_buffer.h"
 #include "grpcpp/support/slice.h"
 #include "tensorflow/core/common_runtime/dma_helper.h"
@@ -22,6 +24,7 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor.pb.h"
 #include "tensorflow/core/framework/tensor_reference.h"
 #include "tensorflow/core/framework/tensor_shape.pb.h"
+#include "tensorflow/core/lib/core/coding.h"
 #include "tensorflow/core/lib/gtl/inlined_vector.h"
 #include "tensorflow/core/lib/io/proto_encode_helper.h"
 #include "tensorflow/core/platform/env.h"
@@ -134,9 +137,122 @@ static void EncodeSkeleton(const Tensor& val, io::ProtoEncodeHelper* e) {
 #endif
 }
 
+// Tensor data larger than this is shared with the ByteBuffer rather than
+// copied into it.
+static const int kLargeTensorBytes = 1024;
+
+// Encodes A through D2 for "val", whose tensor content (E) takes
+// "content_bytes" bytes, into "*space", and returns the size of the whole
+// encoding of "response" holding "val".
+static size_t EncodeHeader(const RecvTensorResponse& response,
+                           const Tensor& val, size_t content_bytes,
+                           gtl::InlinedVector<char, 1024>* space) {
+  // skeleton is the encoded TensorProto contents (dtype and shape), but
+  // not the actual data
+  gtl::InlinedVector<char, 128> skeleton(SkeletonEncodingSizeUpperBound(val));
+  io::ProtoEncodeHelper e_skeleton(skeleton.data(), skeleton.size());
+  EncodeSkeleton(val, &e_skeleton);
+
+  uint32 overall_tensor_proto_bytesize =
+      (e_skeleton.size() +
+       VarLengthEncodingSize(TensorProto::kTensorContentFieldNumber,
+                             content_bytes));
+  string header;  // All of RecvTensorResponse except the tensor() field
+  response.AppendToString(&header);
+
+  size_t expected_size =
+      (header.size() +
+       VarLengthEncodingSize(RecvTensorResponse::kTensorFieldNumber,
+                             overall_tensor_proto_bytesize));
+  size_t encoder_size = expected_size - content_bytes;
+
+  // Encode all but the actual content, but including the tag and
+  // varlength header for the content
+  space->resize(encoder_size);
+  io::ProtoEncodeHelper e(space->data(), space->size());
+  // (A)
+  e.WriteRawBytes(header);
+
+  // (B1) & (B2)
+  e.WriteVarlengthBeginning(RecvTensorResponse::kTensorFieldNumber,
+                            overall_tensor_proto_bytesize);
+  // (C)
+  e.WriteRawBytes(StringPiece(e_skeleton.data(), e_skeleton.size()));
+  // (D1) & (D2)
+  e.WriteVarlengthBeginning(TensorProto::kTensorContentFieldNumber,
+                            content_bytes);
+  DCHECK_EQ(e.size(), encoder_size);
+  return expected_size;
+}
+
+// Encodes a DT_STRING "val" like EncodeTensorToByteBuffer() does for
+// memcpy-able types. E is a frame holding the size of every string,
+// followed by the bytes of all strings, as port::EncodeStringList() lays
+// them out. Strings larger than "kLargeTensorBytes" whose bytes are owned by
+// the tensor get a grpc::Slice that shares these bytes, and runs of the
+// other strings are batched into copied slices.
+static void EncodeStringTensorToByteBuffer(const RecvTensorResponse& response,
+                                           const Tensor& val,
+                                           ::grpc::ByteBuffer* result) {
+  const int64_t n = val.NumElements();
+  const tstring* strings = val.flat<tstring>().data();
+  string sizes;
+  size_t content_bytes = 0;
+  for (int64_t i = 0; i < n; ++i) {
+    core::PutVarint32(&sizes, strings[i].size());
+    content_bytes += strings[i].size();
+  }
+  content_bytes += sizes.size();
+
+  gtl::InlinedVector<char, 1024> space;
+  const size_t expected_size =
+      EncodeHeader(response, val, content_bytes, &space);
+
+  std::vector<::grpc::Slice> slices;
+  std::vector<StringPiece> pending = {StringPiece(space.data(), space.size()),
+                                      sizes};
+  size_t pending_bytes = space.size() + sizes.size();
+  auto flush_pending = [&slices, &pending, &pending_bytes]() {
+    if (pending_bytes == 0) return;
+    ::grpc::Slice slice(pending_bytes);
+    char* dst = const_cast<char*>(reinterpret_cast<const char*>(slice.begin()));
+    for (StringPiece piece : pending) {
+      memcpy(dst, piece.data(), piece.size());
+      dst += piece.size();
+    }
+    slices.push_back(std::move(slice));
+    pending.clear();
+    pending_bytes = 0;
+  };
+  const TensorBuffer* buf = DMAHelper::buffer(&val);
+  for (int64_t i = 0; i < n; ++i) {
+    const tstring& str = strings[i];
+    if (str.size() > kLargeTensorBytes && str.type() == tstring::LARGE) {
+      flush_pending();
+      buf->Ref();
+      slices.emplace_back(
+          const_cast<char*>(str.data()), str.size(),
+          [](void* backing) { static_cast<TensorBuffer*>(backing)->Unref(); },
+          const_cast<TensorBuffer*>(buf));
+    } else if (!str.empty()) {
+      pending.emplace_back(str.data(), str.size());
+      pending_bytes += str.size();
+    }
+  }
+  flush_pending();
+
+  size_t total_bytes = 0;
+  for (const ::grpc::Slice& slice : slices) {
+    total_bytes += slice.size();
+  }
+  CHECK_EQ(total_bytes, expected_size);
+
+  ::grpc::ByteBuffer tmp(slices.data(), slices.size());
+  result->Swap(&tmp);
+}
+
 void EncodeTensorToByteBuffer(bool is_dead, const Tensor& val, bool require_ack,
                               ::grpc::ByteBuffer* result) {
-  const int kLargeTensorBytes = 1024;
   const int64_t kProtoBufLimitBytes = 1LL << 31;
 
   if (val.TotalBytes() > kProtoBufLimitBytes) {
@@ -152,7 +268,9 @@ void EncodeTensorToByteBuffer(bool is_dead, const Tensor& val, bool require_ack,
   }
   response.set_require_ack(require_ack);
   response.set_send_start_micros(Env::Default()->NowMicros());
-  if (!DataTypeCanUseMemcpy(val.dtype())) {
+  if (val.dtype() == DT_STRING) {
+    EncodeStringTensorToByteBuffer(response, val, result);
+  } else if (!DataTypeCanUseMemcpy(val.dtype())) {
     // Straightforward but slow path for complicated kinds of tensor data
     // TODO(jeff,sanjay): If this becomes an issue, we could
     // go directly from val -> ByteBuffer, with some effort.
@@ -161,24 +279,10 @@ void EncodeTensorToByteBuffer(bool is_dead, const Tensor& val, bool require_ack,
     // Encode full protocol buffer to a ByteBuffer
     EncodeRecvTensorResponseToByteBuffer(response, result);
   } else {
-    // skeleton is the encoded TensorProto contents (dtype and shape), but
-    // not the actual data
-    gtl::InlinedVector<char, 128> skeleton(SkeletonEncodingSizeUpperBound(val));
-    io::ProtoEncodeHelper e_skeleton(skeleton.data(), skeleton.size());
-    EncodeSkeleton(val, &e_skeleton);
-
     StringPiece tdata = val.tensor_data();
-    uint32 overall_tensor_proto_bytesize =
-        (e_skeleton.size() +
-         VarLengthEncodingSize(TensorProto::kTensorContentFieldNumber,
-                               tdata.size()));
-    string header;  // All of RecvTensorResponse except the tensor() field
-    response.AppendToString(&header);
-
-    size_t expected_size =
-        (header.size() +
-         VarLengthEncodingSize(RecvTensorResponse::kTensorFieldNumber,
-                               overall_tensor_proto_bytesize));
+    gtl::InlinedVector<char, 1024> space;
+    const size_t expected_size =
+        EncodeHeader(response, val, tdata.size(), &space);
     // If "share_tensor_slice_memory == false", we copy the tensor data to
     // the end of the buffer we are preparing that holds the rest of the
     // RecvTensorResponse protocol buffer.
@@ -191,24 +295,6 @@ void EncodeTensorToByteBuffer(bool is_dead, const Tensor& val, bool require_ack,
     // We enable this behavior if the tensor is large.
     bool share_tensor_slice_memory = (tdata.size() > kLargeTensorBytes);
 
-    size_t encoder_size = expected_size - tdata.size();
-
-    // Encode all but the actual "tdata", but including the tag and
-    // varlength header for the "tdata"
-    gtl::InlinedVector<char, 1024> space(encoder_size);
-    io::ProtoEncodeHelper e(space.data(), space.size());
-    // (A)
-    e.WriteRawBytes(header);
-
-    // (B1) & (B2)
-    e.WriteVarlengthBeginning(RecvTensorResponse::kTensorFieldNumber,
-                              overall_tensor_proto_bytesize);
-    // (C)
-    e.WriteRawBytes(StringPiece(e_skeleton.data(), e_skeleton.size()));
-    // (D1) & (D2)
-    e.WriteVarlengthBeginning(TensorProto::kTensorContentFieldNumber,
-                              tdata.size());
-
     // All but the tensor backing store are serialized now
 
     // Now allocate memory and put into the ByteBuffer
@@ -216,13 +302,14 @@ void EncodeTensorToByteBuffer(bool is_dead, const Tensor& val, bool require_ack,
     int num_slices = 0;
     {
       size_t slice_len =
-          e.size() + (share_tensor_slice_memory ? 0 : tdata.size());
+          space.size() + (share_tensor_slice_memory ? 0 : tdata.size());
       slices[0] = ::grpc::Slice(slice_len);
-      memcpy(const_cast<uint8_t*>(slices[0].begin()), e.data(), e.size());
+      memcpy(const_cast<uint8_t*>(slices[0].begin()), space.data(),
+             space.size());
       if (!share_tensor_slice_memory) {
         // (E)
-        memcpy(const_cast<uint8_t*>(slices[0].begin()) + e.size(), tdata.data(),
-               tdata.size());
+        memcpy(const_cast<uint8_t*>(slices[0].begin()) + space.size(),
+               tdata.data(), tdata.size());
       }
       num_slices += 1;
     }
@@ -17,17 +17,51 @@ limitations under the License.
 
 #include "grpcpp/support/byte_buffer.h"
 #include "grpcpp/support/slice.h"
+#include "tensorflow/core/distributed_runtime/rpc/grpc_util.h"
+#include "tensorflow/core/distributed_runtime/tensor_coding.h"
+#include "tensorflow/core/framework/device_attributes.pb.h"
+#include "tensorflow/core/framework/device_base.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/gtl/inlined_vector.h"
 #include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/protobuf/worker.pb.h"
 
 namespace tensorflow {
 
+class DummyDevice : public DeviceBase {
+ public:
+  explicit DummyDevice(Env* env) : DeviceBase(env) {
+    attr_.set_device_type("CPU");
+  }
+
+  const DeviceAttributes& attributes() const override { return attr_; }
+
+  Allocator* GetAllocator(AllocatorAttributes attr) override {
+    return cpu_allocator();
+  }
+
+ private:
+  DeviceAttributes attr_;
+};
+
 class GrpcTensorCodingTest : public ::testing::Test {
  public:
+  // Decodes "buf" like the receiver of a RecvTensor RPC does.
+  Tensor Decode(::grpc::ByteBuffer* buf, bool is_dead,
+                const AllocatorAttributes& alloc_attrs) {
+    DummyDevice cpu_device(Env::Default());
+    TensorResponse response;
+    response.InitAlloc(&cpu_device, alloc_attrs);
+    GrpcByteSource source(buf);
+    TF_EXPECT_OK(response.ParseFrom(&source));
+    EXPECT_EQ(response.metadata().is_dead(), is_dead);
+    return response.tensor();
+  }
+
   void Validate(const Tensor& t, bool is_dead) {
     // Check by encoding to a ByteBuffer
     ::grpc::ByteBuffer buf;
@@ -50,6 +84,11 @@ class GrpcTensorCodingTest : public ::testing::Test {
     EXPECT_EQ(t.dtype(), result_tensor.dtype());
     EXPECT_EQ(t.shape().DebugString(), result_tensor.shape().DebugString());
     EXPECT_EQ(t.DebugString(), result_tensor.DebugString());
+
+    Tensor decoded = Decode(&buf, is_dead, AllocatorAttributes());
+    EXPECT_EQ(t.dtype(), decoded.dtype());
+    EXPECT_EQ(t.shape().DebugString(), decoded.shape().DebugString());
+    EXPECT_EQ(t.DebugString(), decoded.DebugString());
   }
 
   template <typename T>
@@ -100,4 +139,41 @@ TEST_F(GrpcTensorCodingTest, Simple) {
 
 TEST_F(GrpcTensorCodingTest, StringTensor) { DoTestForStrings(DT_STRING); }
 
+TEST_F(GrpcTensorCodingTest, LargeStrings) {
+  // Interleave strings that are shared with the ByteBuffer and strings that
+  // are copied into it.
+  Tensor t(DT_STRING, TensorShape({6}));
+  auto strings = t.flat<tstring>();
+  strings(0) = string(5000, 'a');
+  strings(1) = "b";
+  strings(2) = "";
+  strings(3) = string(2000, 'c');
+  strings(4) = string(3000, 'd');
+  strings(5) = "e";
+  ::grpc::ByteBuffer buf;
+  grpc::EncodeTensorToByteBuffer(false, t, false, &buf);
+  std::vector<::grpc::Slice> slices;
+  TF_ASSERT_OK(FromGrpcStatus(buf.Dump(&slices)));
+  EXPECT_EQ(slices.size(), 6);
+  EXPECT_EQ(slices[1].begin(),
+            reinterpret_cast<const uint8*>(strings(0).data()));
+
+  Tensor decoded = Decode(&buf, false, AllocatorAttributes());
+  test::ExpectTensorEqual<tstring>(t, decoded);
+}
+
+TEST_F(GrpcTensorCodingTest, CopiesTensorContent) {
+  Tensor t(DT_FLOAT, TensorShape({1024}));
+  test::FillIota<float>(&t, 0.0f);
+  ::grpc::ByteBuffer buf;
+  grpc::EncodeTensorToByteBuffer(false, t, false, &buf);
+
+  // The tensor data gets its own slice in the encoded buffer, but the
+  // receiver still copies it into memory of its own allocator.
+  Tensor decoded = Decode(&buf, false, AllocatorAttributes());
+  test::ExpectTensorEqual<float>(t, decoded);
+  EXPECT_NE(decoded.tensor_data().data(), t.tensor_data().data());
+  EXPECT_TRUE(decoded.RefCountIsOne());
+}
+
 }  // namespace tensorflow
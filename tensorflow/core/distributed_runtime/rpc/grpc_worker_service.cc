@@ -56,6 +56,7 @@ limitations under the License.
 #include "tensorflow/core/profiler/lib/scoped_memory_debug_annotation.h"
 #include "tensorflow/core/protobuf/transport_options.pb.h"
 #include "tensorflow/core/protobuf/worker.pb.h"
+#include "tensorflow/core/util/env_var.h"
 
 namespace tensorflow {
 
@@ -148,6 +149,7 @@ class GrpcWorkerServiceThread {
     SETUP_FOR_REQUEST(RunGraph, 100, true);
     SETUP_FOR_REQUEST(CleanupGraph, 100, false);
     SETUP_FOR_REQUEST(MarkRecvFinished, 10, false);
+    SETUP_FOR_REQUEST(RecvTensorBatch, 100, true);
 
     // TODO(ncteisen): Determine a better policy for enqueuing the
     // appropriate number of each request type.
@@ -301,6 +303,25 @@ class GrpcWorkerServiceThread {
     ENQUEUE_REQUEST(RecvBuf, true);
   }
 
+  void RecvTensorBatchHandler(
+      WorkerCall<RecvTensorBatchRequest, RecvTensorBatchResponse>* call) {
+    Schedule([this, call]() {
+      CallOptions* call_opts = new CallOptions;
+      call->SetCancelCallback([call_opts]() { call_opts->StartCancel(); });
+      worker_->RecvTensorBatchAsync(
+          call_opts, &call->request, &call->response,
+          [call, call_opts](const Status& s) {
+            call->ClearCancelCallback();
+            delete call_opts;
+            if (!s.ok()) {
+              VLOG(3) << "Bad response from RecvTensorBatch:" << s;
+            }
+            call->SendResponse(ToGrpcStatus(s));
+          });
+    });
+    ENQUEUE_REQUEST(RecvTensorBatch, true);
+  }
+
   void CompleteGroupHandler(
       WorkerCall<CompleteGroupRequest, CompleteGroupResponse>* call) {
     Schedule([this, call]() {
@@ -417,6 +438,22 @@ class GrpcWorkerService : public AsyncServiceInterface {
   TF_DISALLOW_COPY_AND_ASSIGN(GrpcWorkerService);
 };
 
+// Returns how long a RecvTensorBatch call waits for more of its tensors once
+// the first one is available, before it responds.
+int64_t RecvTensorBatchWindowMicros() {
+  constexpr int64_t kDefaultWindowMicros = 100;
+  int64_t window_micros;
+  Status s =
+      ReadInt64FromEnvVar("TF_RPC_RECV_TENSOR_BATCH_SERVER_WINDOW_MICROS",
+                          kDefaultWindowMicros, &window_micros);
+  if (!s.ok()) {
+    LOG(ERROR) << "Invalid TF_RPC_RECV_TENSOR_BATCH_SERVER_WINDOW_MICROS: "
+               << s;
+    return kDefaultWindowMicros;
+  }
+  return window_micros;
+}
+
 }  // namespace
 
 GrpcWorker::GrpcWorker(WorkerEnv* worker_env, const ConfigProto& config)
@@ -424,7 +461,8 @@ GrpcWorker::GrpcWorker(WorkerEnv* worker_env, const ConfigProto& config)
       recv_buf_max_chunk_(
           config.experimental().recv_buf_max_chunk() > 0
               ? config.experimental().recv_buf_max_chunk()
-              : (config.experimental().recv_buf_max_chunk() < 0 ? 0 : 4096)) {
+              : (config.experimental().recv_buf_max_chunk() < 0 ? 0 : 4096)),
+      recv_tensor_batch_window_micros_(RecvTensorBatchWindowMicros()) {
   if (config.rpc_options().cache_rpc_response()) {
     EnableResponseCache();
   }
@@ -556,6 +594,137 @@ void GrpcWorker::GrpcRecvTensorAsync(CallOptions* opts,
       });
 }
 
+// RecvTensorBatchAsync: receives the tensors of all the keys in the request,
+// and responds once they are all available, or a short window after the first
+// one is. The receives that have not completed by then are cancelled, which
+// leaves their tensors in the rendezvous, and are reported as not ready so
+// that the client requests them again. Waiting for all of the tensors instead
+// could deadlock, if the graph producing one of them depends on another one.
+void GrpcWorker::RecvTensorBatchAsync(CallOptions* opts,
+                                      const RecvTensorBatchRequest* request,
+                                      RecvTensorBatchResponse* response,
+                                      StatusCallback done) {
+  VLOG(3) << "RecvTensorBatchAsync req: " << request->DebugString();
+  const int64_t step_id = request->step_id();
+  Status s = recent_request_ids_.TrackUnique(
+      request->request_id(), "RecvTensorBatch (GrpcWorker)", *request);
+  if (!s.ok()) {
+    done(s);
+    return;
+  }
+  const int num_keys = request->rendezvous_key_size();
+  if (num_keys == 0) {
+    done(Status::OK());
+    return;
+  }
+  for (int i = 0; i < num_keys; ++i) {
+    response->add_item();
+  }
+
+  struct BatchState {
+    CancellationManager cancellation_manager;
+    mutex mu;
+    int num_pending TF_GUARDED_BY(mu);
+    // Whether a receive has completed, which starts the window.
+    bool window_started TF_GUARDED_BY(mu) = false;
+  };
+  auto state = std::make_shared<BatchState>();
+  {
+    mutex_lock l(state->mu);
+    state->num_pending = num_keys;
+  }
+  // The cancel callback runs with the lock of `opts` held, so the receives
+  // must not be cancelled inline: the last one to complete clears the
+  // callback.
+  opts->SetCancelCallback([this, state]() {
+    env_->env->SchedClosure(
+        [state]() { state->cancellation_manager.StartCancel(); });
+  });
+
+  auto item_done = [this, opts, state, response, done](
+                       int index, const Tensor& val, bool is_dead,
+                       const Status& status) {
+    RecvTensorBatchResponse::Item* item = response->mutable_item(index);
+    if (errors::IsCancelled(status) &&
+        (state->cancellation_manager.IsCancelling() ||
+         state->cancellation_manager.IsCancelled())) {
+      item->set_not_ready(true);
+    } else if (!status.ok()) {
+      item->set_status_code(status.code());
+      item->set_status_error_message(status.error_message());
+    } else {
+      RecvTensorResponse* tensor_response = item->mutable_response();
+      val.AsProtoTensorContent(tensor_response->mutable_tensor());
+      tensor_response->set_is_dead(is_dead);
+      tensor_response->set_send_start_micros(env_->env->NowMicros());
+    }
+    bool last;
+    bool start_window;
+    {
+      mutex_lock l(state->mu);
+      last = --state->num_pending == 0;
+      start_window = !last && !state->window_started;
+      state->window_started = true;
+    }
+    if (last) {
+      opts->ClearCancelCallback();
+      done(Status::OK());
+    } else if (start_window) {
+      if (recv_tensor_batch_window_micros_ > 0) {
+        env_->env->SchedClosureAfter(
+            recv_tensor_batch_window_micros_,
+            [state]() { state->cancellation_manager.StartCancel(); });
+      } else {
+        state->cancellation_manager.StartCancel();
+      }
+    }
+  };
+
+  Rendezvous::Args recv_args;
+  recv_args.cancellation_manager = &state->cancellation_manager;
+  for (int i = 0; i < num_keys; ++i) {
+    const string& key = request->rendezvous_key(i);
+    TRACEPRINTF("RecvTensorBatch: %lld %s", step_id, key.c_str());
+    Rendezvous::ParsedKey parsed;
+    s = Rendezvous::ParseKey(key, &parsed);
+    Device* src_dev = nullptr;
+    if (s.ok()) {
+      s = PrepareRecvTensor(parsed, &src_dev);
+    }
+    if (!s.ok()) {
+      item_done(i, Tensor(), false, s);
+      continue;
+    }
+    env_->rendezvous_mgr->RecvLocalAsync(
+        step_id, parsed, recv_args,
+        [i, item_done, src_dev, key](const Status& status,
+                                     const Rendezvous::Args& send_args,
+                                     const Rendezvous::Args& recv_args,
+                                     const Tensor& val, const bool is_dead) {
+          if (status.ok() && src_dev->tensorflow_gpu_device_info() &&
+              !send_args.alloc_attrs.on_host()) {
+            // "val" is on an accelerator device. Uses the device_context to
+            // fill a copy on host.
+            AllocatorAttributes alloc_attrs;
+            alloc_attrs.set_gpu_compatible(true);
+            alloc_attrs.set_on_host(true);
+            Allocator* alloc = src_dev->GetAllocator(alloc_attrs);
+            Tensor* copy = new Tensor(alloc, val.dtype(), val.shape());
+            CHECK(send_args.device_context)
+                << "send dev name: " << src_dev->name();
+            CopyDeviceToHost(&val, alloc, alloc, key, src_dev, copy,
+                             send_args.device_context,
+                             [i, item_done, copy, is_dead](const Status& s) {
+                               item_done(i, *copy, is_dead, s);
+                               delete copy;
+                             });
+            return;
+          }
+          item_done(i, val, is_dead, status);
+        });
+  }
+}
+
 namespace {
 // If RecvBufRespExtra.tensor_content is a single large string, then gRPC
 // can stall on the recv side when the string buffer needs to be enlarged,
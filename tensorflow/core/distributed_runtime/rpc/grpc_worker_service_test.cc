@@ -0,0 +1,263 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/distributed_runtime/rpc/grpc_worker_service.h"
+
+#include <stdlib.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/device_mgr.h"
+#include "tensorflow/core/distributed_runtime/call_options.h"
+#include "tensorflow/core/distributed_runtime/request_id.h"
+#include "tensorflow/core/distributed_runtime/rpc/rpc_rendezvous_mgr.h"
+#include "tensorflow/core/distributed_runtime/test_utils.h"
+#include "tensorflow/core/distributed_runtime/worker_env.h"
+#include "tensorflow/core/distributed_runtime/worker_session.h"
+#include "tensorflow/core/framework/control_flow.h"
+#include "tensorflow/core/framework/rendezvous.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/notification.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/protobuf/config.pb.h"
+#include "tensorflow/core/protobuf/worker.pb.h"
+
+namespace tensorflow {
+namespace {
+
+constexpr int64_t kStepId = 123;
+constexpr uint64 kIncarnation = 7890;
+
+Tensor V(const string& content) {
+  Tensor tensor(DT_STRING, TensorShape({}));
+  tensor.scalar<tstring>()() = content;
+  return tensor;
+}
+
+string V(const TensorProto& proto) {
+  Tensor tensor;
+  CHECK(tensor.FromProto(proto));
+  return tensor.scalar<tstring>()();
+}
+
+string Key(const string& name) {
+  return Rendezvous::CreateKey("/job:worker/replica:0/task:0/device:CPU:0",
+                               kIncarnation,
+                               "/job:worker/replica:0/task:1/device:CPU:0",
+                               name, FrameAndIter(0, 0));
+}
+
+Rendezvous::ParsedKey ParsedKey(const string& name) {
+  Rendezvous::ParsedKey parsed;
+  TF_CHECK_OK(Rendezvous::ParseKey(Key(name), &parsed));
+  return parsed;
+}
+
+std::unique_ptr<DeviceMgr> CreateDeviceMgr() {
+  class FakeDevice : public Device {
+   public:
+    explicit FakeDevice(const DeviceAttributes& attr) : Device(nullptr, attr) {}
+    Status Sync() override { return Status::OK(); }
+    Allocator* GetAllocator(AllocatorAttributes) override {
+      return cpu_allocator();
+    }
+  };
+  DeviceAttributes attr;
+  attr.set_name("/job:worker/replica:0/task:0/device:CPU:0");
+  attr.set_device_type("CPU");
+  attr.set_incarnation(kIncarnation);
+  std::vector<std::unique_ptr<Device>> devices;
+  devices.emplace_back(new FakeDevice(attr));
+  return std::make_unique<StaticDeviceMgr>(std::move(devices));
+}
+
+// A RecvTensorBatch call in flight.
+struct BatchCall {
+  CallOptions opts;
+  RecvTensorBatchRequest request;
+  RecvTensorBatchResponse response;
+  Status status;
+  Notification done;
+};
+
+class GrpcWorkerRecvTensorBatchTest : public ::testing::Test {
+ protected:
+  GrpcWorkerRecvTensorBatchTest()
+      : worker_session_("worker_session", "/job:worker/replica:0/task:0",
+                        std::make_unique<TestWorkerCache>(), CreateDeviceMgr(),
+                        std::unique_ptr<GraphMgr>(), nullptr),
+        rmgr_(&env_) {
+    env_.env = Env::Default();
+    env_.device_mgr = worker_session_.device_mgr();
+    env_.rendezvous_mgr = &rmgr_;
+    worker_ = NewGrpcWorker(&env_, ConfigProto());
+    rendez_ = rmgr_.Find(kStepId);
+    TF_CHECK_OK(rendez_->Initialize(&worker_session_));
+  }
+
+  ~GrpcWorkerRecvTensorBatchTest() override {
+    rendez_->Unref();
+    rmgr_.Cleanup(kStepId);
+  }
+
+  // Replaces the worker with one that waits "window_micros" for more tensors
+  // after the first one is available.
+  void ResetWorker(int64_t window_micros) {
+    setenv("TF_RPC_RECV_TENSOR_BATCH_SERVER_WINDOW_MICROS",
+           std::to_string(window_micros).c_str(), 1);
+    worker_ = NewGrpcWorker(&env_, ConfigProto());
+    unsetenv("TF_RPC_RECV_TENSOR_BATCH_SERVER_WINDOW_MICROS");
+  }
+
+  void Send(const string& name, const Tensor& val, bool is_dead) {
+    TF_ASSERT_OK(
+        rendez_->Send(ParsedKey(name), Rendezvous::Args(), val, is_dead));
+  }
+
+  // Receives the tensor "name" on this worker, as a later RecvTensor call
+  // would.
+  string RecvLocal(const string& name) {
+    Tensor val;
+    bool is_dead;
+    TF_CHECK_OK(rmgr_.RecvLocal(kStepId, ParsedKey(name), &val, &is_dead));
+    return val.scalar<tstring>()();
+  }
+
+  // Starts a RecvTensorBatch call for the tensors "names".
+  void StartRecvTensorBatch(const std::vector<string>& names,
+                            BatchCall* call) {
+    call->request.set_step_id(kStepId);
+    call->request.set_request_id(GetUniqueRequestId());
+    for (const string& name : names) {
+      call->request.add_rendezvous_key(Key(name));
+    }
+    worker_->RecvTensorBatchAsync(&call->opts, &call->request, &call->response,
+                                  [call](const Status& s) {
+                                    call->status = s;
+                                    call->done.Notify();
+                                  });
+  }
+
+  WorkerEnv env_;
+  WorkerSession worker_session_;
+  RpcRendezvousMgr rmgr_;
+  std::unique_ptr<GrpcWorker> worker_;
+  RemoteRendezvous* rendez_;
+};
+
+TEST_F(GrpcWorkerRecvTensorBatchTest, RespondsWithoutWaitingForAll) {
+  BatchCall call;
+  StartRecvTensorBatch({"a", "b", "c"}, &call);
+  Env::Default()->SleepForMicroseconds(10 * 1000);
+  EXPECT_FALSE(call.done.HasBeenNotified());
+
+  Send("b", V("banana"), false);
+  call.done.WaitForNotification();
+  TF_ASSERT_OK(call.status);
+  ASSERT_EQ(call.response.item_size(), 3);
+  EXPECT_TRUE(call.response.item(0).not_ready());
+  EXPECT_FALSE(call.response.item(1).not_ready());
+  EXPECT_EQ(V(call.response.item(1).response().tensor()), "banana");
+  EXPECT_TRUE(call.response.item(2).not_ready());
+
+  // The receives that were cancelled leave their tensors in the rendezvous.
+  Send("a", V("apple"), false);
+  Send("c", V("cherry"), false);
+  EXPECT_EQ(RecvLocal("a"), "apple");
+  EXPECT_EQ(RecvLocal("c"), "cherry");
+}
+
+TEST_F(GrpcWorkerRecvTensorBatchTest, WaitsForMoreTensorsAfterFirstReady) {
+  ResetWorker(/*window_micros=*/1000 * 1000);
+  BatchCall call;
+  StartRecvTensorBatch({"a", "b", "c"}, &call);
+  Send("b", V("banana"), false);
+  Env::Default()->SleepForMicroseconds(10 * 1000);
+  EXPECT_FALSE(call.done.HasBeenNotified());
+
+  Send("c", V("cherry"), false);
+  call.done.WaitForNotification();
+  TF_ASSERT_OK(call.status);
+  ASSERT_EQ(call.response.item_size(), 3);
+  EXPECT_TRUE(call.response.item(0).not_ready());
+  EXPECT_EQ(V(call.response.item(1).response().tensor()), "banana");
+  EXPECT_EQ(V(call.response.item(2).response().tensor()), "cherry");
+
+  Send("a", V("apple"), false);
+  EXPECT_EQ(RecvLocal("a"), "apple");
+}
+
+TEST_F(GrpcWorkerRecvTensorBatchTest, RespondsOnceAllAreReady) {
+  ResetWorker(/*window_micros=*/60 * 1000 * 1000);
+  BatchCall call;
+  StartRecvTensorBatch({"a", "b"}, &call);
+  Send("a", V("apple"), false);
+  Send("b", V("banana"), false);
+  // The call does not wait for the window to end.
+  ASSERT_TRUE(WaitForNotificationWithTimeout(&call.done, 10 * 1000 * 1000));
+  TF_ASSERT_OK(call.status);
+  ASSERT_EQ(call.response.item_size(), 2);
+  EXPECT_EQ(V(call.response.item(0).response().tensor()), "apple");
+  EXPECT_EQ(V(call.response.item(1).response().tensor()), "banana");
+}
+
+TEST_F(GrpcWorkerRecvTensorBatchTest, RespondsWithAllReadyTensors) {
+  Send("a", V("apple"), false);
+  Send("b", V("banana"), true);
+  BatchCall call;
+  StartRecvTensorBatch({"a", "b"}, &call);
+  call.done.WaitForNotification();
+  TF_ASSERT_OK(call.status);
+  ASSERT_EQ(call.response.item_size(), 2);
+  EXPECT_EQ(V(call.response.item(0).response().tensor()), "apple");
+  EXPECT_FALSE(call.response.item(0).response().is_dead());
+  EXPECT_TRUE(call.response.item(1).response().is_dead());
+}
+
+TEST_F(GrpcWorkerRecvTensorBatchTest, ReportsErrorsPerItem) {
+  BatchCall call;
+  call.request.add_rendezvous_key("not a rendezvous key");
+  StartRecvTensorBatch({"a"}, &call);
+  call.done.WaitForNotification();
+  TF_ASSERT_OK(call.status);
+  ASSERT_EQ(call.response.item_size(), 2);
+  EXPECT_EQ(call.response.item(0).status_code(), error::INVALID_ARGUMENT);
+  // The error completes the call, so the other receive is not ready.
+  EXPECT_TRUE(call.response.item(1).not_ready());
+
+  Send("a", V("apple"), false);
+  EXPECT_EQ(RecvLocal("a"), "apple");
+}
+
+TEST_F(GrpcWorkerRecvTensorBatchTest, CancelReportsNotReady) {
+  BatchCall call;
+  StartRecvTensorBatch({"a", "b"}, &call);
+  call.opts.StartCancel();
+  call.done.WaitForNotification();
+  TF_ASSERT_OK(call.status);
+  ASSERT_EQ(call.response.item_size(), 2);
+  EXPECT_TRUE(call.response.item(0).not_ready());
+  EXPECT_TRUE(call.response.item(1).not_ready());
+
+  Send("a", V("apple"), false);
+  EXPECT_EQ(RecvLocal("a"), "apple");
+}
+
+}  // namespace
+}  // namespace tensorflow
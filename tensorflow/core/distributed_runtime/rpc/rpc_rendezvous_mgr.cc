@@ -15,7 +15,13 @@ limitations under the License.
 
 #include "tensorflow/core/distributed_runtime/rpc/rpc_rendezvous_mgr.h"
 
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <memory>
+#include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include "tensorflow/core/common_runtime/device.h"
 #include "tensorflow/core/common_runtime/device_mgr.h"
@@ -33,15 +39,73 @@ limitations under the License.
 #include "tensorflow/core/platform/macros.h"
 #include "tensorflow/core/platform/notification.h"
 #include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/util/env_var.h"
 
 namespace tensorflow {
 
+// The source workers that do not implement RecvTensorBatch, whose tensors are
+// fetched with RecvTensor calls instead.
+class RpcUnbatchedWorkers {
+ public:
+  bool Contains(const string& worker) {
+    tf_shared_lock l(mu_);
+    return workers_.count(worker) > 0;
+  }
+
+  // Adds "worker", and returns false if it was already known.
+  bool Insert(const string& worker) {
+    mutex_lock l(mu_);
+    return workers_.insert(worker).second;
+  }
+
+ private:
+  mutex mu_;
+  std::unordered_set<string> workers_ TF_GUARDED_BY(mu_);
+};
+
 namespace {
 
+// Returns the maximum number of receives from one worker that are fetched by
+// a single RecvTensorBatch call. With a value below 2, every receive issues
+// its own RecvTensor call.
+int64_t RecvTensorBatchMaxKeys() {
+  constexpr int64_t kDefaultMaxKeys = 0;
+  int64_t max_keys;
+  Status s = ReadInt64FromEnvVar("TF_RPC_RECV_TENSOR_BATCH_MAX_KEYS",
+                                 kDefaultMaxKeys, &max_keys);
+  if (!s.ok()) {
+    LOG(ERROR) << "Invalid TF_RPC_RECV_TENSOR_BATCH_MAX_KEYS: " << s;
+    return kDefaultMaxKeys;
+  }
+  return max_keys;
+}
+
+// Returns how long a receive waits for other receives from the same worker
+// before they are fetched, if fewer than RecvTensorBatchMaxKeys() are queued.
+int64_t RecvTensorBatchWindowMicros() {
+  constexpr int64_t kDefaultWindowMicros = 100;
+  int64_t window_micros;
+  Status s = ReadInt64FromEnvVar("TF_RPC_RECV_TENSOR_BATCH_WINDOW_MICROS",
+                                 kDefaultWindowMicros, &window_micros);
+  if (!s.ok()) {
+    LOG(ERROR) << "Invalid TF_RPC_RECV_TENSOR_BATCH_WINDOW_MICROS: " << s;
+    return kDefaultWindowMicros;
+  }
+  return window_micros;
+}
+
+class RpcBatchedRecvCall;
+struct RpcRecvTensorBatchCall;
+
 class RpcRemoteRendezvous : public BaseRemoteRendezvous {
  public:
-  RpcRemoteRendezvous(const WorkerEnv* env, int64_t step_id)
-      : BaseRemoteRendezvous(env, step_id) {}
+  RpcRemoteRendezvous(const WorkerEnv* env, int64_t step_id,
+                      int64_t batch_max_keys, int64_t batch_window_micros,
+                      std::shared_ptr<RpcUnbatchedWorkers> unbatched_workers)
+      : BaseRemoteRendezvous(env, step_id),
+        batch_max_keys_(batch_max_keys),
+        batch_window_micros_(batch_window_micros),
+        unbatched_workers_(std::move(unbatched_workers)) {}
 
  protected:
   void RecvFromRemoteAsync(const Rendezvous::ParsedKey& parsed,
@@ -49,8 +113,55 @@ class RpcRemoteRendezvous : public BaseRemoteRendezvous {
                            DoneCallback done) override;
 
  private:
+  friend class RpcBatchedRecvCall;
+
   ~RpcRemoteRendezvous() override {}
 
+  // Fetches the tensor with a RecvTensor call of its own.
+  void RecvFromRemoteUnbatchedAsync(const Rendezvous::ParsedKey& parsed,
+                                    const Rendezvous::Args& recv_args,
+                                    DoneCallback done);
+
+  // Like RecvFromRemoteAsync, but fetches the tensor with a RecvTensorBatch
+  // call shared with other receives from the same worker.
+  void RecvFromRemoteBatchedAsync(const Rendezvous::ParsedKey& parsed,
+                                  const Rendezvous::Args& recv_args,
+                                  DoneCallback done);
+
+  // Queues "call" until it is fetched by a RecvTensorBatch call.
+  void EnqueueBatchedRecv(std::shared_ptr<RpcBatchedRecvCall> call);
+
+  // Issues RecvTensorBatch calls for the receives queued for "src_worker",
+  // with at most batch_max_keys_ receives each.
+  void FlushBatchedRecvs(const string& src_worker);
+
+  // Issues a RecvTensorBatch call to "src_worker" for the receives of "recvs"
+  // that have not been aborted.
+  void StartRecvTensorBatch(
+      const string& src_worker,
+      std::vector<std::shared_ptr<RpcBatchedRecvCall>> recvs);
+
+  // Completes the receives of "batch", and queues again the ones whose
+  // tensors were not ready.
+  void RecvTensorBatchDone(const std::shared_ptr<RpcRecvTensorBatchCall>& batch,
+                           const Status& s);
+
+  // Fetches the receives of "batch" that have not completed with a RecvTensor
+  // call each, because its worker does not implement RecvTensorBatch.
+  // Later receives from that worker are not batched either.
+  void FallBackToRecvTensor(
+      const std::shared_ptr<RpcRecvTensorBatchCall>& batch);
+
+  const int64_t batch_max_keys_;
+  const int64_t batch_window_micros_;
+  // Shared with the rendezvous of the other steps.
+  const std::shared_ptr<RpcUnbatchedWorkers> unbatched_workers_;
+
+  mutex batch_mu_;
+  // The receives waiting for a RecvTensorBatch call, by source worker.
+  std::unordered_map<string, std::vector<std::shared_ptr<RpcBatchedRecvCall>>>
+      pending_recvs_ TF_GUARDED_BY(batch_mu_);
+
   TF_DISALLOW_COPY_AND_ASSIGN(RpcRemoteRendezvous);
 };
 
@@ -234,6 +345,16 @@ void RpcRemoteRendezvous::RecvFromRemoteAsync(
     const Rendezvous::ParsedKey& parsed, const Rendezvous::Args& recv_args,
     DoneCallback done) {
   CHECK(is_initialized());
+  if (batch_max_keys_ > 1) {
+    RecvFromRemoteBatchedAsync(parsed, recv_args, std::move(done));
+    return;
+  }
+  RecvFromRemoteUnbatchedAsync(parsed, recv_args, std::move(done));
+}
+
+void RpcRemoteRendezvous::RecvFromRemoteUnbatchedAsync(
+    const Rendezvous::ParsedKey& parsed, const Rendezvous::Args& recv_args,
+    DoneCallback done) {
   Status s;
 
   // Prepare a RecvTensor call that can handle being aborted.
@@ -305,14 +426,342 @@ void RpcRemoteRendezvous::RecvFromRemoteAsync(
   });
 }
 
+// A receive that is fetched by a RecvTensorBatch call, together with other
+// receives from the same worker.
+class RpcBatchedRecvCall
+    : public BaseRecvTensorCall,
+      public std::enable_shared_from_this<RpcBatchedRecvCall> {
+ public:
+  RpcBatchedRecvCall(RpcRemoteRendezvous* rendezvous, string src_worker,
+                     const Rendezvous::ParsedKey& parsed, Device* dst_device,
+                     const Rendezvous::Args& recv_args)
+      : rendezvous_(rendezvous),
+        src_worker_(std::move(src_worker)),
+        parsed_(parsed),
+        dst_device_(dst_device),
+        recv_args_(recv_args) {}
+
+  void Start(std::function<void()> recv_done) override {
+    bool aborted;
+    {
+      mutex_lock l(mu_);
+      aborted = finished_;
+      if (!aborted) {
+        recv_done_ = std::move(recv_done);
+      }
+    }
+    if (aborted) {
+      recv_done();
+      return;
+    }
+    rendezvous_->EnqueueBatchedRecv(shared_from_this());
+  }
+
+  // Completes the receive on another thread, because this may be called
+  // with the lock of the rendezvous held.
+  void StartAbort(const Status& s) override {
+    {
+      mutex_lock l(mu_);
+      if (finished_) return;
+      status_.Update(s);
+    }
+    rendezvous_->Ref();
+    SchedClosure([self = shared_from_this()]() {
+      self->Finish(Status::OK(), Tensor(), false);
+      self->rendezvous_->Unref();
+    });
+  }
+
+  Status status() const override {
+    mutex_lock l(mu_);
+    return status_;
+  }
+
+  // Completes the receive with "s", "val" and "is_dead", unless it has
+  // already been completed. A status set by StartAbort() takes precedence.
+  void Finish(const Status& s, const Tensor& val, bool is_dead);
+
+  const Tensor& tensor() const { return tensor_; }
+  bool is_dead() const { return is_dead_; }
+  const Rendezvous::Args& recv_args() const { return recv_args_; }
+
+ private:
+  friend class RpcRemoteRendezvous;
+
+  RpcRemoteRendezvous* const rendezvous_;  // Not owned.
+  const string src_worker_;
+  const Rendezvous::ParsedKey parsed_;
+  Device* const dst_device_;
+  const Rendezvous::Args recv_args_;
+  Tensor tensor_;
+  bool is_dead_ = false;
+
+  mutable mutex mu_;
+  Status status_ TF_GUARDED_BY(mu_);
+  bool finished_ TF_GUARDED_BY(mu_) = false;
+  std::function<void()> recv_done_ TF_GUARDED_BY(mu_);
+  // The call fetching this receive, if any.
+  std::shared_ptr<RpcRecvTensorBatchCall> batch_ TF_GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(RpcBatchedRecvCall);
+};
+
+// A RecvTensorBatch call, and the receives it fetches.
+struct RpcRecvTensorBatchCall {
+  string src_worker;
+  CallOptions opts;
+  RecvTensorBatchRequest req;
+  RecvTensorBatchResponse resp;
+  std::vector<std::shared_ptr<RpcBatchedRecvCall>> recvs;
+  // The number of receives that have not been completed yet. The call is
+  // cancelled when all of them are aborted.
+  std::atomic<int64_t> num_live{0};
+};
+
+void RpcBatchedRecvCall::Finish(const Status& s, const Tensor& val,
+                                bool is_dead) {
+  std::shared_ptr<RpcRecvTensorBatchCall> batch;
+  std::function<void()> recv_done;
+  {
+    mutex_lock l(mu_);
+    if (finished_) return;
+    finished_ = true;
+    status_.Update(s);
+    if (status_.ok()) {
+      tensor_ = val;
+      is_dead_ = is_dead;
+    }
+    batch = std::move(batch_);
+    recv_done = std::move(recv_done_);
+  }
+  if (batch != nullptr && --batch->num_live == 0) {
+    batch->opts.StartCancel();
+  }
+  if (recv_done != nullptr) {
+    recv_done();
+  }
+}
+
+void RpcRemoteRendezvous::RecvFromRemoteBatchedAsync(
+    const Rendezvous::ParsedKey& parsed, const Rendezvous::Args& recv_args,
+    DoneCallback done) {
+  Status s;
+  string src_worker;
+  string src_rel_device;
+  if (!DeviceNameUtils::SplitDeviceName(parsed.src_device, &src_worker,
+                                        &src_rel_device)) {
+    s = errors::Internal(parsed.src_device,
+                         " is invalid remote source device.");
+  }
+  Device* dst_device;
+  if (s.ok()) {
+    s = session()->device_mgr()->LookupDevice(parsed.dst_device, &dst_device);
+  }
+  if (!s.ok()) {
+    done(s, Args(), recv_args, Tensor{}, false);
+    return;
+  }
+  if (unbatched_workers_->Contains(src_worker)) {
+    RecvFromRemoteUnbatchedAsync(parsed, recv_args, std::move(done));
+    return;
+  }
+
+  auto call = std::make_shared<RpcBatchedRecvCall>(
+      this, std::move(src_worker), parsed, dst_device, recv_args);
+  // Record "call" in active_ so that it can be aborted cleanly. If the
+  // rendezvous is already aborted, this completes "call" with the abort
+  // status once it is started.
+  RegisterCall(call.get(), recv_args);
+
+  Ref();
+  RpcBatchedRecvCall* c = call.get();
+  c->Start([this, call = std::move(call), done = std::move(done)]() {
+    DeregisterCall(call.get());
+    done(call->status(), Args(), call->recv_args(), call->tensor(),
+         call->is_dead());
+    Unref();
+  });
+}
+
+void RpcRemoteRendezvous::EnqueueBatchedRecv(
+    std::shared_ptr<RpcBatchedRecvCall> call) {
+  const string src_worker = call->src_worker_;
+  bool flush;
+  bool start_window;
+  {
+    mutex_lock l(batch_mu_);
+    auto& pending = pending_recvs_[src_worker];
+    pending.push_back(std::move(call));
+    flush = static_cast<int64_t>(pending.size()) >= batch_max_keys_;
+    start_window = pending.size() == 1;
+  }
+  if (flush) {
+    FlushBatchedRecvs(src_worker);
+  } else if (start_window) {
+    Ref();
+    env_->env->SchedClosureAfter(batch_window_micros_,
+                                 [this, src_worker]() {
+                                   FlushBatchedRecvs(src_worker);
+                                   Unref();
+                                 });
+  }
+}
+
+void RpcRemoteRendezvous::FlushBatchedRecvs(const string& src_worker) {
+  // Each call fetches at most batch_max_keys_ receives, so the receives that
+  // are queued again after a call are split over several calls if needed.
+  while (true) {
+    std::vector<std::shared_ptr<RpcBatchedRecvCall>> recvs;
+    {
+      mutex_lock l(batch_mu_);
+      auto it = pending_recvs_.find(src_worker);
+      if (it == pending_recvs_.end()) return;
+      std::vector<std::shared_ptr<RpcBatchedRecvCall>>& pending = it->second;
+      const int64_t num_recvs =
+          std::min(static_cast<int64_t>(pending.size()), batch_max_keys_);
+      recvs.assign(std::make_move_iterator(pending.begin()),
+                   std::make_move_iterator(pending.begin() + num_recvs));
+      pending.erase(pending.begin(), pending.begin() + num_recvs);
+      if (pending.empty()) {
+        pending_recvs_.erase(it);
+      }
+    }
+    StartRecvTensorBatch(src_worker, std::move(recvs));
+  }
+}
+
+void RpcRemoteRendezvous::StartRecvTensorBatch(
+    const string& src_worker,
+    std::vector<std::shared_ptr<RpcBatchedRecvCall>> recvs) {
+  auto batch = std::make_shared<RpcRecvTensorBatchCall>();
+  batch->src_worker = src_worker;
+  // Receives that are aborted from now on cancel the call once none is left.
+  batch->num_live = recvs.size();
+  for (auto& recv : recvs) {
+    {
+      mutex_lock l(recv->mu_);
+      if (!recv->finished_) {
+        recv->batch_ = batch;
+        StringPiece key = recv->parsed_.FullKey();
+        batch->req.add_rendezvous_key(key.data(), key.size());
+        batch->recvs.push_back(std::move(recv));
+        continue;
+      }
+    }
+    --batch->num_live;
+  }
+  if (batch->recvs.empty()) return;
+
+  std::shared_ptr<WorkerCacheInterface> worker_cache =
+      session()->GetSharedWorkerCache();
+  WorkerInterface* rwi = worker_cache->GetOrCreateWorker(src_worker);
+  if (rwi == nullptr) {
+    RecvTensorBatchDone(batch,
+                        errors::Internal("No worker known as ", src_worker));
+    return;
+  }
+  batch->req.set_step_id(step_id_);
+  batch->req.set_request_id(GetUniqueRequestId());
+  Ref();
+  rwi->RecvTensorBatchAsync(
+      &batch->opts, &batch->req, &batch->resp,
+      [this, batch, rwi, worker_cache, src_worker](const Status& s) {
+        // NOTE: `*session()` can potentially be deleted before the receives
+        // complete, so we must release the worker first.
+        worker_cache->ReleaseWorker(src_worker, rwi);
+        RecvTensorBatchDone(batch, s);
+        Unref();
+      });
+  // NOTE: All the receives may have been aborted before the RPC registered
+  // its cancellation to `opts`.
+  if (batch->num_live == 0) {
+    batch->opts.StartCancel();
+  }
+}
+
+void RpcRemoteRendezvous::RecvTensorBatchDone(
+    const std::shared_ptr<RpcRecvTensorBatchCall>& batch, const Status& s) {
+  if (errors::IsUnimplemented(s)) {
+    FallBackToRecvTensor(batch);
+    return;
+  }
+  Status status = s;
+  const int num_recvs = batch->recvs.size();
+  if (status.ok() && batch->resp.item_size() != num_recvs) {
+    status = errors::Internal("RecvTensorBatch returned ",
+                              batch->resp.item_size(), " items for ",
+                              num_recvs, " keys");
+  }
+  bool requeued = false;
+  for (int i = 0; i < num_recvs; ++i) {
+    std::shared_ptr<RpcBatchedRecvCall>& recv = batch->recvs[i];
+    if (!status.ok()) {
+      recv->Finish(status, Tensor(), false);
+      continue;
+    }
+    RecvTensorBatchResponse::Item* item = batch->resp.mutable_item(i);
+    if (item->not_ready()) {
+      {
+        mutex_lock l(recv->mu_);
+        if (recv->finished_) continue;
+        recv->batch_.reset();
+      }
+      mutex_lock l(batch_mu_);
+      pending_recvs_[batch->src_worker].push_back(std::move(recv));
+      requeued = true;
+    } else if (item->status_code() != error::OK) {
+      recv->Finish(Status(item->status_code(), item->status_error_message()),
+                   Tensor(), false);
+    } else {
+      TensorResponse response;
+      response.InitAlloc(recv->dst_device_, recv->recv_args_.alloc_attrs);
+      Status decode_status = response.InitFrom(item->mutable_response());
+      recv->Finish(decode_status, response.tensor(),
+                   response.metadata().is_dead());
+    }
+  }
+  // The worker only responds once one of the tensors is available, so the
+  // receives that were not ready are requested again right away.
+  if (requeued) {
+    FlushBatchedRecvs(batch->src_worker);
+  }
+}
+
+void RpcRemoteRendezvous::FallBackToRecvTensor(
+    const std::shared_ptr<RpcRecvTensorBatchCall>& batch) {
+  if (unbatched_workers_->Insert(batch->src_worker)) {
+    LOG(WARNING) << batch->src_worker
+                 << " does not implement RecvTensorBatch, falling back to "
+                    "RecvTensor for its tensors.";
+  }
+  for (const std::shared_ptr<RpcBatchedRecvCall>& recv : batch->recvs) {
+    {
+      mutex_lock l(recv->mu_);
+      if (recv->finished_) continue;
+      recv->batch_.reset();
+    }
+    RecvFromRemoteUnbatchedAsync(
+        recv->parsed_, recv->recv_args_,
+        [recv](const Status& s, const Rendezvous::Args& send_args,
+               const Rendezvous::Args& recv_args, const Tensor& val,
+               bool is_dead) { recv->Finish(s, val, is_dead); });
+  }
+}
+
 }  // namespace
 
 RpcRendezvousMgr::RpcRendezvousMgr(const WorkerEnv* env)
-    : BaseRendezvousMgr(env) {}
+    : BaseRendezvousMgr(env),
+      recv_tensor_batch_max_keys_(RecvTensorBatchMaxKeys()),
+      recv_tensor_batch_window_micros_(RecvTensorBatchWindowMicros()),
+      unbatched_workers_(std::make_shared<RpcUnbatchedWorkers>()) {}
 
 BaseRemoteRendezvous* RpcRendezvousMgr::Create(int64_t step_id,
                                                const WorkerEnv* worker_env) {
-  return new RpcRemoteRendezvous(worker_env, step_id);
+  return new RpcRemoteRendezvous(worker_env, step_id,
+                                 recv_tensor_batch_max_keys_,
+                                 recv_tensor_batch_window_micros_,
+                                 unbatched_workers_);
 }
 
 }  // end namespace tensorflow
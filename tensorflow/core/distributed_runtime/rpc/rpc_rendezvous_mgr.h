@@ -16,6 +16,8 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RPC_RPC_RENDEZVOUS_MGR_H_
 #define TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RPC_RPC_RENDEZVOUS_MGR_H_
 
+#include <memory>
+
 #include "tensorflow/core/distributed_runtime/base_rendezvous_mgr.h"
 #include "tensorflow/core/distributed_runtime/worker_env.h"
 #include "tensorflow/core/platform/macros.h"
@@ -23,6 +25,7 @@ limitations under the License.
 namespace tensorflow {
 
 class DeviceMgr;
+class RpcUnbatchedWorkers;
 
 // RendezvousMgr keeps track of a set of local rendezvous instances.
 // All tensors sent by this worker are buffered in a RendezvousMgr
@@ -50,6 +53,15 @@ class RpcRendezvousMgr : public BaseRendezvousMgr {
   BaseRemoteRendezvous* Create(int64_t step_id, const WorkerEnv* worker_env);
 
  private:
+  // The maximum number of receives from one worker that are fetched by a
+  // single RecvTensorBatch call, and how long a receive waits for others
+  // before they are fetched. Read from the environment at construction.
+  const int64_t recv_tensor_batch_max_keys_;
+  const int64_t recv_tensor_batch_window_micros_;
+  // The source workers that do not implement RecvTensorBatch, as learned by
+  // the rendezvous of earlier steps.
+  const std::shared_ptr<RpcUnbatchedWorkers> unbatched_workers_;
+
   TF_DISALLOW_COPY_AND_ASSIGN(RpcRendezvousMgr);
 };
 
@@ -15,7 +15,16 @@ limitations under the License.
 
 #include "tensorflow/core/distributed_runtime/rpc/rpc_rendezvous_mgr.h"
 
+#include <stdlib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <string>
+#include <vector>
+
 #include "tensorflow/core/common_runtime/process_util.h"
+#include "tensorflow/core/distributed_runtime/tensor_coding.h"
 #include "tensorflow/core/distributed_runtime/test_utils.h"
 #include "tensorflow/core/framework/cancellation.h"
 #include "tensorflow/core/framework/control_flow.h"
@@ -104,7 +113,9 @@ static Device* CreateDevice(const char* type, const char* name) {
    public:
     explicit FakeDevice(const DeviceAttributes& attr) : Device(nullptr, attr) {}
     Status Sync() override { return Status::OK(); }
-    Allocator* GetAllocator(AllocatorAttributes) override { return nullptr; }
+    Allocator* GetAllocator(AllocatorAttributes) override {
+      return cpu_allocator();
+    }
   };
   DeviceAttributes attr;
   attr.set_name(name);
@@ -245,6 +256,37 @@ TEST_F(RpcRendezvousMgrTest, CancelAfterReceived) {
   delete cm;
 }
 
+TEST_F(RpcRendezvousMgrTest, CancelRecvLocal) {
+  const int64_t step_id = 123;
+  const Rendezvous::ParsedKey key = MakeKey(Rendezvous::CreateKey(
+      "/job:mnist/replica:1/task:2/cpu:0", 7890,
+      "/job:mnist/replica:1/task:2/cpu:1", "foo", FrameAndIter(0, 0)));
+  RemoteRendezvous* rendez = rmgr_.Find(step_id);
+  core::ScopedUnref unref(rendez);
+  TF_ASSERT_OK(rendez->Initialize(&worker_session_));
+  CancellationManager cm;
+  Rendezvous::Args recv_args;
+  recv_args.cancellation_manager = &cm;
+  Notification n;
+  rmgr_.RecvLocalAsync(
+      step_id, key, recv_args,
+      [&n](const Status& s, const Rendezvous::Args& send_args,
+           const Rendezvous::Args& recv_args, const Tensor& v, bool dead) {
+        EXPECT_TRUE(errors::IsCancelled(s));
+        n.Notify();
+      });
+  cm.StartCancel();
+  n.WaitForNotification();
+
+  // The cancelled receive does not consume the tensor.
+  TF_ASSERT_OK(rendez->Send(key, Rendezvous::Args(), V("peach"), false));
+  Tensor val(DT_STRING);
+  bool val_dead = false;
+  TF_ASSERT_OK(rmgr_.RecvLocal(step_id, key, &val, &val_dead));
+  EXPECT_EQ(V(val), "peach");
+  rmgr_.Cleanup(step_id);
+}
+
 namespace {
 class DummyDeviceContext : public DeviceContext {
  public:
@@ -348,4 +390,430 @@ TEST_F(RpcRendezvousMgrTest, RemoteRecvAsyncMany) {
   rmgr_.Cleanup(step_id);
 }
 
+namespace {
+// A worker that serves RecvTensorBatch calls like GrpcWorker: it responds to
+// a call once one of the requested tensors is available, and reports the
+// other ones as not ready.
+class BatchWorker : public TestWorkerInterface {
+ public:
+  // Makes the tensor of the rendezvous key "name" available, or the error
+  // "s" if it is not OK.
+  void Provide(const string& name, const Tensor& val, bool is_dead,
+               const Status& s = Status::OK()) {
+    mutex_lock l(mu_);
+    results_[name] = {val, is_dead, s};
+    for (auto it = pending_.begin(); it != pending_.end();) {
+      if (FillResponseLocked(it->get())) {
+        (*it)->opts->ClearCancelCallback();
+        Done((*it)->done, Status::OK());
+        it = pending_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  void set_implements_batch(bool implements_batch) {
+    mutex_lock l(mu_);
+    implements_batch_ = implements_batch;
+  }
+
+  int num_batch_calls() {
+    mutex_lock l(mu_);
+    return num_batch_calls_;
+  }
+
+  // Returns the largest number of keys requested by one batch call.
+  int max_keys_per_call() {
+    mutex_lock l(mu_);
+    return max_keys_per_call_;
+  }
+
+  int num_recv_tensor_calls() {
+    mutex_lock l(mu_);
+    return num_recv_tensor_calls_;
+  }
+
+  int num_pending() {
+    mutex_lock l(mu_);
+    return pending_.size();
+  }
+
+  // Waits until every call has been responded to.
+  void WaitUntilIdle() {
+    mutex_lock l(mu_);
+    while (num_outstanding_ > 0 || num_cancelling_ > 0) cv_.wait(l);
+  }
+
+  void RecvTensorBatchAsync(CallOptions* opts,
+                            const RecvTensorBatchRequest* request,
+                            RecvTensorBatchResponse* response,
+                            StatusCallback done) override {
+    auto call = std::make_shared<Call>();
+    call->opts = opts;
+    call->request = request;
+    call->response = response;
+    call->done = std::move(done);
+    mutex_lock l(mu_);
+    ++num_batch_calls_;
+    max_keys_per_call_ =
+        std::max(max_keys_per_call_, request->rendezvous_key_size());
+    ++num_outstanding_;
+    if (!implements_batch_) {
+      Done(call->done, errors::Unimplemented("RecvTensorBatchAsync()"));
+      return;
+    }
+    if (FillResponseLocked(call.get())) {
+      Done(call->done, Status::OK());
+      return;
+    }
+    pending_.push_back(call);
+    // The cancel callback runs with the lock of `opts` held, so the call is
+    // cancelled on another thread.
+    opts->SetCancelCallback([this, call]() {
+      ++num_cancelling_;
+      SchedClosure([this, call]() {
+        mutex_lock l(mu_);
+        auto it = std::find(pending_.begin(), pending_.end(), call);
+        if (it != pending_.end()) {
+          pending_.erase(it);
+          Done(call->done, errors::Cancelled("RecvTensorBatchAsync()"));
+        }
+        --num_cancelling_;
+        cv_.notify_all();
+      });
+    });
+  }
+
+  void RecvTensorAsync(CallOptions* opts, const RecvTensorRequest* request,
+                       TensorResponse* response, StatusCallback done) override {
+    Status s;
+    {
+      mutex_lock l(mu_);
+      ++num_recv_tensor_calls_;
+      ++num_outstanding_;
+      auto it = results_.find(KeyName(request->rendezvous_key()));
+      if (it == results_.end()) {
+        s = errors::Internal("No tensor for ", request->rendezvous_key());
+      } else if (!it->second.status.ok()) {
+        s = it->second.status;
+      } else {
+        RecvTensorResponse proto;
+        it->second.val.AsProtoTensorContent(proto.mutable_tensor());
+        proto.set_is_dead(it->second.is_dead);
+        s = response->InitFrom(&proto);
+      }
+    }
+    Done(done, s);
+  }
+
+ private:
+  struct Call {
+    CallOptions* opts;
+    const RecvTensorBatchRequest* request;
+    RecvTensorBatchResponse* response;
+    StatusCallback done;
+  };
+
+  struct Result {
+    Tensor val;
+    bool is_dead;
+    Status status;
+  };
+
+  static string KeyName(const string& key) {
+    Rendezvous::ParsedKey parsed;
+    CHECK(Rendezvous::ParseKey(key, &parsed).ok());
+    return string(parsed.edge_name);
+  }
+
+  // Fills the response of "call" and consumes its tensors, if one of them is
+  // available.
+  bool FillResponseLocked(Call* call) TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    const int num_keys = call->request->rendezvous_key_size();
+    bool any_ready = false;
+    for (int i = 0; i < num_keys; ++i) {
+      if (results_.count(KeyName(call->request->rendezvous_key(i))) > 0) {
+        any_ready = true;
+      }
+    }
+    if (!any_ready) return false;
+    for (int i = 0; i < num_keys; ++i) {
+      RecvTensorBatchResponse::Item* item = call->response->add_item();
+      auto it = results_.find(KeyName(call->request->rendezvous_key(i)));
+      if (it == results_.end()) {
+        item->set_not_ready(true);
+      } else if (!it->second.status.ok()) {
+        item->set_status_code(it->second.status.code());
+        item->set_status_error_message(it->second.status.error_message());
+        results_.erase(it);
+      } else {
+        it->second.val.AsProtoTensorContent(
+            item->mutable_response()->mutable_tensor());
+        item->mutable_response()->set_is_dead(it->second.is_dead);
+        results_.erase(it);
+      }
+    }
+    return true;
+  }
+
+  // Runs "done" on another thread, like a response to an RPC.
+  void Done(StatusCallback done, const Status& s) {
+    SchedClosure([this, done = std::move(done), s]() {
+      done(s);
+      mutex_lock l(mu_);
+      --num_outstanding_;
+      cv_.notify_all();
+    });
+  }
+
+  mutex mu_;
+  condition_variable cv_;
+  bool implements_batch_ TF_GUARDED_BY(mu_) = true;
+  int num_batch_calls_ TF_GUARDED_BY(mu_) = 0;
+  int max_keys_per_call_ TF_GUARDED_BY(mu_) = 0;
+  int num_recv_tensor_calls_ TF_GUARDED_BY(mu_) = 0;
+  int num_outstanding_ TF_GUARDED_BY(mu_) = 0;
+  std::atomic<int> num_cancelling_{0};
+  std::map<string, Result> results_ TF_GUARDED_BY(mu_);
+  std::vector<std::shared_ptr<Call>> pending_ TF_GUARDED_BY(mu_);
+};
+
+std::unique_ptr<WorkerCacheInterface> CreateWorkerCache(BatchWorker* worker) {
+  auto cache = std::make_unique<TestWorkerCache>();
+  cache->AddWorker("/job:worker/replica:1/task:2", worker);
+  return cache;
+}
+}  // namespace
+
+class RpcRendezvousMgrBatchTest : public ::testing::Test {
+ protected:
+  struct RecvResult {
+    Notification done;
+    Status status;
+    Tensor val;
+    bool is_dead = false;
+  };
+
+  RpcRendezvousMgrBatchTest()
+      : worker_session_("rpc_session", "/job:mnist/replica:1/task:2",
+                        CreateWorkerCache(&worker_),
+                        std::unique_ptr<DeviceMgr>(CreateDeviceMgr()),
+                        std::unique_ptr<GraphMgr>(), nullptr) {
+    env_.env = Env::Default();
+    ResetRendezvousMgr(/*max_keys=*/8, /*window_micros=*/1000);
+  }
+
+  ~RpcRendezvousMgrBatchTest() override { worker_.WaitUntilIdle(); }
+
+  // Replaces the rendezvous manager with one that batches up to "max_keys"
+  // receives, waiting at most "window_micros" to fill a batch.
+  void ResetRendezvousMgr(int max_keys, int64_t window_micros) {
+    setenv("TF_RPC_RECV_TENSOR_BATCH_MAX_KEYS",
+           std::to_string(max_keys).c_str(), 1);
+    setenv("TF_RPC_RECV_TENSOR_BATCH_WINDOW_MICROS",
+           std::to_string(window_micros).c_str(), 1);
+    rmgr_.reset(new RpcRendezvousMgr(&env_));
+    unsetenv("TF_RPC_RECV_TENSOR_BATCH_MAX_KEYS");
+    unsetenv("TF_RPC_RECV_TENSOR_BATCH_WINDOW_MICROS");
+  }
+
+  // Receives the tensor "name" from the remote worker into "result".
+  void StartRecv(RemoteRendezvous* rendez, const string& name,
+                 CancellationManager* cm, RecvResult* result) {
+    Rendezvous::Args args;
+    args.cancellation_manager = cm;
+    rendez->RecvAsync(
+        MakeKey(Rendezvous::CreateKey("/job:worker/replica:1/task:2/cpu:0",
+                                      7890, "/job:mnist/replica:1/task:2/cpu:1",
+                                      name, FrameAndIter(0, 0))),
+        args,
+        [result](const Status& s, const Rendezvous::Args&,
+                 const Rendezvous::Args&, const Tensor& val, bool is_dead) {
+          result->status = s;
+          result->val = val;
+          result->is_dead = is_dead;
+          result->done.Notify();
+        });
+  }
+
+  BatchWorker worker_;
+  WorkerEnv env_;
+  WorkerSession worker_session_;
+  std::unique_ptr<RpcRendezvousMgr> rmgr_;
+};
+
+TEST_F(RpcRendezvousMgrBatchTest, RequeuesNotReadyRecvs) {
+  const int64_t step_id = 123;
+  RemoteRendezvous* rendez = rmgr_->Find(step_id);
+  core::ScopedUnref unref(rendez);
+  TF_ASSERT_OK(rendez->Initialize(&worker_session_));
+  RecvResult a, b, c;
+  StartRecv(rendez, "a", nullptr, &a);
+  StartRecv(rendez, "b", nullptr, &b);
+  StartRecv(rendez, "c", nullptr, &c);
+
+  // The worker responds with "b" alone, so "a" and "c" are requested again.
+  worker_.Provide("b", V("banana"), false);
+  b.done.WaitForNotification();
+  TF_ASSERT_OK(b.status);
+  EXPECT_EQ(V(b.val), "banana");
+  EXPECT_FALSE(a.done.HasBeenNotified());
+  EXPECT_FALSE(c.done.HasBeenNotified());
+
+  worker_.Provide("a", V("apple"), false);
+  worker_.Provide("c", V("cherry"), false);
+  a.done.WaitForNotification();
+  c.done.WaitForNotification();
+  TF_ASSERT_OK(a.status);
+  TF_ASSERT_OK(c.status);
+  EXPECT_EQ(V(a.val), "apple");
+  EXPECT_EQ(V(c.val), "cherry");
+  EXPECT_GE(worker_.num_batch_calls(), 2);
+  EXPECT_EQ(worker_.num_recv_tensor_calls(), 0);
+  rmgr_->Cleanup(step_id);
+}
+
+TEST_F(RpcRendezvousMgrBatchTest, RequeuedRecvsRespectMaxKeys) {
+  const int64_t window_micros = 500 * 1000;
+  ResetRendezvousMgr(/*max_keys=*/4, window_micros);
+  const int64_t step_id = 123;
+  RemoteRendezvous* rendez = rmgr_->Find(step_id);
+  core::ScopedUnref unref(rendez);
+  TF_ASSERT_OK(rendez->Initialize(&worker_session_));
+  const std::vector<string> names = {"a", "b", "c", "d", "e", "f"};
+  std::vector<RecvResult> results(names.size());
+  // "a" to "d" fill the first batch; "e" and "f" wait for the next one.
+  for (int i = 0; i < names.size(); ++i) {
+    StartRecv(rendez, names[i], nullptr, &results[i]);
+  }
+  EXPECT_EQ(worker_.num_batch_calls(), 1);
+
+  // Requeuing "b" to "d" next to "e" and "f" makes five pending receives,
+  // which are requested in two batches.
+  worker_.Provide("a", V("a"), false);
+  results[0].done.WaitForNotification();
+  for (int i = 1; i < names.size(); ++i) {
+    worker_.Provide(names[i], V(names[i]), false);
+  }
+  for (int i = 0; i < names.size(); ++i) {
+    results[i].done.WaitForNotification();
+    TF_ASSERT_OK(results[i].status);
+    EXPECT_EQ(V(results[i].val), names[i]);
+  }
+  EXPECT_LE(worker_.max_keys_per_call(), 4);
+  rmgr_->Cleanup(step_id);
+  // Lets the window of "e" and "f" end while the worker session is alive.
+  Env::Default()->SleepForMicroseconds(window_micros);
+}
+
+TEST_F(RpcRendezvousMgrBatchTest, DeadTensorsAndErrorsPerItem) {
+  const int64_t step_id = 123;
+  RemoteRendezvous* rendez = rmgr_->Find(step_id);
+  core::ScopedUnref unref(rendez);
+  TF_ASSERT_OK(rendez->Initialize(&worker_session_));
+  worker_.Provide("a", V("apple"), true);
+  worker_.Provide("b", Tensor(), false, errors::FailedPrecondition("boom"));
+  worker_.Provide("c", V("cherry"), false);
+  RecvResult a, b, c;
+  StartRecv(rendez, "a", nullptr, &a);
+  StartRecv(rendez, "b", nullptr, &b);
+  StartRecv(rendez, "c", nullptr, &c);
+  a.done.WaitForNotification();
+  b.done.WaitForNotification();
+  c.done.WaitForNotification();
+
+  TF_ASSERT_OK(a.status);
+  EXPECT_TRUE(a.is_dead);
+  EXPECT_TRUE(errors::IsFailedPrecondition(b.status));
+  EXPECT_EQ(b.status.error_message(), "boom");
+  TF_ASSERT_OK(c.status);
+  EXPECT_FALSE(c.is_dead);
+  EXPECT_EQ(V(c.val), "cherry");
+  rmgr_->Cleanup(step_id);
+}
+
+TEST_F(RpcRendezvousMgrBatchTest, PartialAbort) {
+  const int64_t step_id = 123;
+  RemoteRendezvous* rendez = rmgr_->Find(step_id);
+  core::ScopedUnref unref(rendez);
+  TF_ASSERT_OK(rendez->Initialize(&worker_session_));
+  CancellationManager cm_a, cm_b;
+  RecvResult a, b;
+  StartRecv(rendez, "a", &cm_a, &a);
+  StartRecv(rendez, "b", &cm_b, &b);
+
+  // Cancelling one receive completes it, but not the call fetching both.
+  cm_a.StartCancel();
+  a.done.WaitForNotification();
+  EXPECT_TRUE(errors::IsCancelled(a.status));
+  EXPECT_FALSE(b.done.HasBeenNotified());
+
+  worker_.Provide("b", V("banana"), false);
+  b.done.WaitForNotification();
+  TF_ASSERT_OK(b.status);
+  EXPECT_EQ(V(b.val), "banana");
+  rmgr_->Cleanup(step_id);
+}
+
+TEST_F(RpcRendezvousMgrBatchTest, Abort) {
+  const int64_t step_id = 123;
+  RemoteRendezvous* rendez = rmgr_->Find(step_id);
+  core::ScopedUnref unref(rendez);
+  TF_ASSERT_OK(rendez->Initialize(&worker_session_));
+  RecvResult a, b;
+  StartRecv(rendez, "a", nullptr, &a);
+  StartRecv(rendez, "b", nullptr, &b);
+  // Wait for the call to reach the worker.
+  while (worker_.num_pending() == 0) {
+    Env::Default()->SleepForMicroseconds(1000);
+  }
+
+  rendez->StartAbort(errors::Aborted("abort"));
+  a.done.WaitForNotification();
+  b.done.WaitForNotification();
+  EXPECT_TRUE(errors::IsAborted(a.status));
+  EXPECT_TRUE(errors::IsAborted(b.status));
+  // Aborting every receive cancels the call.
+  worker_.WaitUntilIdle();
+  EXPECT_EQ(worker_.num_pending(), 0);
+  rmgr_->Cleanup(step_id);
+}
+
+TEST_F(RpcRendezvousMgrBatchTest, FallsBackToRecvTensor) {
+  const int64_t step_id = 123;
+  RemoteRendezvous* rendez = rmgr_->Find(step_id);
+  core::ScopedUnref unref(rendez);
+  TF_ASSERT_OK(rendez->Initialize(&worker_session_));
+  worker_.set_implements_batch(false);
+  worker_.Provide("a", V("apple"), false);
+  worker_.Provide("b", V("banana"), false);
+  worker_.Provide("c", V("cherry"), false);
+  RecvResult a, b;
+  StartRecv(rendez, "a", nullptr, &a);
+  StartRecv(rendez, "b", nullptr, &b);
+  a.done.WaitForNotification();
+  b.done.WaitForNotification();
+  TF_ASSERT_OK(a.status);
+  TF_ASSERT_OK(b.status);
+  EXPECT_EQ(V(a.val), "apple");
+  EXPECT_EQ(V(b.val), "banana");
+  EXPECT_EQ(worker_.num_recv_tensor_calls(), 2);
+
+  // Later receives from the same worker, in later steps too, are not batched.
+  const int num_batch_calls = worker_.num_batch_calls();
+  RemoteRendezvous* next_rendez = rmgr_->Find(step_id + 1);
+  core::ScopedUnref next_unref(next_rendez);
+  TF_ASSERT_OK(next_rendez->Initialize(&worker_session_));
+  RecvResult c;
+  StartRecv(next_rendez, "c", nullptr, &c);
+  c.done.WaitForNotification();
+  TF_ASSERT_OK(c.status);
+  EXPECT_EQ(V(c.val), "cherry");
+  EXPECT_EQ(worker_.num_batch_calls(), num_batch_calls);
+  EXPECT_EQ(worker_.num_recv_tensor_calls(), 3);
+  rmgr_->Cleanup(step_id);
+  rmgr_->Cleanup(step_id + 1);
+}
+
 }  // namespace tensorflow
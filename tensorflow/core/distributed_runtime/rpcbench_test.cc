@@ -14,6 +14,7 @@ limitations under the License.
 ==============================================================================*/
 
 #include <cstdio>
+#include <ctime>
 #include <functional>
 #include <string>
 #include <vector>
@@ -28,6 +29,7 @@ limitations under the License.
 #include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/lib/strings/stringprintf.h"
+#include "tensorflow/core/platform/cpu_info.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/platform/test_benchmark.h"
@@ -255,4 +257,86 @@ BENCHMARK(BM_SingleDevice)
     ->ArgPair(4, 10000)
     ->ArgPair(1, 1000000);
 
+// Measures the throughput of RecvTensor RPCs that move a tensor of the given
+// number of bytes from one worker to another, and the CPU cycles they take
+// per byte. All workers run in this process, so the cycles cover both the
+// sender and the receiver.
+static void BM_RecvTensor(::testing::benchmark::State& state) {
+  const int64_t num_bytes = state.range(0);
+  const Cluster* cluster = GetCluster();
+  std::unique_ptr<Session> session(NewSession(cluster->options));
+
+  using namespace ::tensorflow::ops;  // NOLINT(build/namespaces)
+
+  // x lives on the second worker, and every step copies it to the first one.
+  Scope root = Scope::NewRootScope();
+  Scope sender = root.WithDevice(cluster->devices[1].name());
+  const int64_t num_elements = num_bytes / sizeof(float);
+  Output x = Variable(sender.WithOpName("x"), {num_elements}, DT_FLOAT);
+  Assign(sender.WithOpName("init"), x, Fill(sender, {num_elements}, 1.0f));
+  Identity(root.WithOpName("y").WithDevice(cluster->devices[0].name()), x);
+
+  GraphDef def;
+  TF_CHECK_OK(root.ToGraphDef(&def));
+  TF_CHECK_OK(session->Create(def));
+  TF_CHECK_OK(session->Run({}, {}, {"init"}, nullptr));
+  // Warm up.
+  TF_CHECK_OK(session->Run({}, {}, {"y"}, nullptr));
+
+  const std::clock_t start = std::clock();
+  for (auto s : state) {
+    TF_CHECK_OK(session->Run({}, {}, {"y"}, nullptr));
+  }
+  const double cpu_seconds =
+      static_cast<double>(std::clock() - start) / CLOCKS_PER_SEC;
+  const int64_t total_bytes = state.iterations() * num_bytes;
+  state.SetBytesProcessed(total_bytes);
+  state.counters["cycles/byte"] =
+      cpu_seconds * port::NominalCPUFrequency() / total_bytes;
+  TF_CHECK_OK(session->Close());
+}
+BENCHMARK(BM_RecvTensor)
+    ->UseRealTime()
+    ->RangeMultiplier(32)
+    ->Range(1 << 10, 1 << 30);
+
+// Measures the step time of a graph with the given number of small tensors
+// sent from one worker to another. Run it with and without
+// TF_RPC_RECV_TENSOR_BATCH_MAX_KEYS set to compare fetching the tensors with
+// one RecvTensor call each and with shared RecvTensorBatch calls.
+static void BM_ManyEdges(::testing::benchmark::State& state) {
+  const int num_edges = state.range(0);
+  const Cluster* cluster = GetCluster();
+  std::unique_ptr<Session> session(NewSession(cluster->options));
+
+  using namespace ::tensorflow::ops;  // NOLINT(build/namespaces)
+
+  // Every x_i lives on the second worker and is summed on the first one.
+  Scope root = Scope::NewRootScope();
+  Scope sender = root.WithDevice(cluster->devices[1].name());
+  std::vector<Output> xs;
+  std::vector<Output> inits;
+  for (int i = 0; i < num_edges; ++i) {
+    Output x =
+        Variable(sender.WithOpName(strings::StrCat("x", i)), {2}, DT_FLOAT);
+    inits.push_back(Assign(sender, x, Fill(sender, {2}, 1.0f)));
+    xs.push_back(x);
+  }
+  NoOp(sender.WithOpName("init").WithControlDependencies(inits));
+  AddN(root.WithOpName("y").WithDevice(cluster->devices[0].name()), xs);
+
+  GraphDef def;
+  TF_CHECK_OK(root.ToGraphDef(&def));
+  TF_CHECK_OK(session->Create(def));
+  TF_CHECK_OK(session->Run({}, {}, {"init"}, nullptr));
+  // Warm up.
+  TF_CHECK_OK(session->Run({}, {}, {"y"}, nullptr));
+
+  for (auto s : state) {
+    TF_CHECK_OK(session->Run({}, {}, {"y"}, nullptr));
+  }
+  TF_CHECK_OK(session->Close());
+}
+BENCHMARK(BM_ManyEdges)->UseRealTime()->Arg(1)->Arg(16)->Arg(256)->Arg(1024);
+
 }  // namespace tensorflow
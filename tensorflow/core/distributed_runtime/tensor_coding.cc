@@ -15,6 +15,8 @@ limitations under the License.
 
 #include "tensorflow/core/distributed_runtime/tensor_coding.h"
 
+#include <vector>
+
 #include "google/protobuf/any.pb.h"
 
 #include "tensorflow/core/common_runtime/device.h"
@@ -141,8 +143,55 @@ bool ReadNestedMessage(protobuf::io::CodedInputStream* input,
   return input->DecrementRecursionDepthAndPopLimit(p.first);
 }
 
+// Reads "n" strings encoded as by port::EncodeStringList, which must take
+// exactly "num_bytes" bytes, from "input" directly into "strings".
+bool ReadStringList(protobuf::io::CodedInputStream* input, int num_bytes,
+                    tstring* strings, int64_t n) {
+  // Every size takes at least one byte.
+  if (n > num_bytes) return false;
+  const int begin = input->CurrentPosition();
+  std::vector<uint32> sizes(n);
+  int64_t total_size = 0;
+  for (uint32& size : sizes) {
+    if (!input->ReadVarint32(&size)) return false;
+    total_size += size;
+  }
+  if (input->CurrentPosition() - begin + total_size != num_bytes) {
+    return false;
+  }
+  for (int64_t i = 0; i < n; ++i) {
+    strings[i].resize_uninitialized(sizes[i]);
+    if (!input->ReadRaw(strings[i].data(), sizes[i])) return false;
+  }
+  return true;
+}
+
 }  // namespace
 
+bool TensorResponse::ParseTensorContent(protobuf::io::CodedInputStream* input,
+                                        const TensorProto& tensor_meta,
+                                        int num_bytes) {
+  const DataType dtype = tensor_meta.dtype();
+  TensorShape shape(tensor_meta.tensor_shape());
+  if (dtype == DT_STRING) {
+    Tensor t(allocator_, dtype, shape);
+    if (!ReadStringList(input, num_bytes, t.flat<tstring>().data(),
+                        t.NumElements())) {
+      return false;
+    }
+    tensor_ = std::move(t);
+    return true;
+  }
+  if (num_bytes != shape.num_elements() * DataTypeSize(dtype)) return false;
+  // The content arrives in many transport-sized chunks that are not aligned
+  // like our allocations, so copy it straight from them into the tensor.
+  Tensor t(allocator_, dtype, shape);
+  StringPiece buf = t.tensor_data();
+  if (!input->ReadRaw(const_cast<char*>(buf.data()), num_bytes)) return false;
+  tensor_ = std::move(t);
+  return true;
+}
+
 bool TensorResponse::ParseTensorSubmessage(
     protobuf::io::CodedInputStream* input, TensorProto* tensor_meta) {
   bool seen_tensor_content = false;
@@ -166,7 +215,10 @@ bool TensorResponse::ParseTensorSubmessage(
         if ((wt != WIRETYPE_VARINT) || !input->ReadVarint32(&v)) return false;
         if (seen_tensor_content) return false;
         tensor_meta->set_dtype(static_cast<DataType>(static_cast<int>(v)));
-        if (!DataTypeCanUseMemcpy(tensor_meta->dtype())) return false;
+        if (!DataTypeCanUseMemcpy(tensor_meta->dtype()) &&
+            tensor_meta->dtype() != DT_STRING) {
+          return false;
+        }
         break;
       }
       case TensorProto::kTensorShapeFieldNumber: {
@@ -194,16 +246,9 @@ bool TensorResponse::ParseTensorSubmessage(
         int num_bytes;
         if (!ReadVarintSizeAsInt(input, &num_bytes)) return false;
         seen_tensor_content = true;
-        TensorShape shape(tensor_meta->tensor_shape());
-        Tensor t(allocator_, tensor_meta->dtype(), shape);
-        StringPiece buf = t.tensor_data();
-        if (static_cast<size_t>(num_bytes) != buf.size()) return false;
-        // TODO(jeff,sanjay): Figure out a way to avoid this copy if
-        // the underlying ZeroCopyInputStream data is properly aligned
-        // and compatible with what allocator_ wants.
-        if (!input->ReadRaw(const_cast<char*>(buf.data()), num_bytes))
+        if (!ParseTensorContent(input, *tensor_meta, num_bytes)) {
           return false;
-        tensor_ = std::move(t);
+        }
         break;
       }
       default: {
@@ -94,6 +94,8 @@ class TensorResponse {
  private:
   bool ParseTensorSubmessage(protobuf::io::CodedInputStream* input,
                              TensorProto* tensor_meta);
+  bool ParseTensorContent(protobuf::io::CodedInputStream* input,
+                          const TensorProto& tensor_meta, int num_bytes);
   bool ParseFast(Source* source);
   bool ParseSlow(Source* source);
 
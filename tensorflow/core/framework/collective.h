@@ -103,6 +103,16 @@ struct CollImplDetails {
   int max_subdivs_per_device = -1;  // Upper bound on subdivisions per device.
   std::vector<int> subdiv_offsets;
   std::vector<int> subdiv_source_rank;  // rank of source in each subdiv
+  // Number of segments each subdivision of a ring is split into. Segments
+  // travel around the same ring independently, so that sending one segment
+  // overlaps with receiving and reducing the next. 0 means the default of
+  // the implementation.
+  int pipeline_segments = 0;
+  // Data type in which a ring reduction exchanges values, if it differs from
+  // the data type of the reduced tensor. DT_INVALID means the default of the
+  // implementation. Both settings are resolved by the group leader, whose
+  // values the members on other tasks use.
+  DataType wire_dtype = DT_INVALID;
   std::vector<int32>
       dependencies;           // collective instances on which this node depends
   string communication_hint;  // user-supplied hint for implementation choice,
@@ -1169,6 +1169,14 @@ class DatasetBaseIterator : public IteratorBase {
     }
   }
 
+  // When modeling is enabled, this method records the latency of a `GetNext`
+  // call that this iterator made on the given input iterator.
+  void RecordInputLatency(IteratorBase* iterator, int64_t latency_usec) {
+    if (iterator->node_) {
+      iterator->node_->record_get_next_latency(latency_usec);
+    }
+  }
+
   // When modeling is enabled, this method records the fact that this iterator
   // has dequeued an element from an internal buffer.
   void RecordBufferDequeue(IteratorContext* ctx,
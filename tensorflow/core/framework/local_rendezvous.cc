@@ -15,11 +15,13 @@ limitations under the License.
 
 #include "tensorflow/core/framework/local_rendezvous.h"
 
+#include <utility>
+
+#include "absl/types/optional.h"
 #include "tensorflow/core/framework/allocator.h"
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/notification.h"
-#include "tensorflow/core/lib/gtl/manual_constructor.h"
 #include "tensorflow/core/lib/monitoring/counter.h"
 #include "tensorflow/core/lib/strings/numbers.h"
 #include "tensorflow/core/lib/strings/str_util.h"
@@ -29,79 +31,95 @@ limitations under the License.
 
 namespace tensorflow {
 
-// Represents a blocked Send() or Recv() call in the rendezvous.
-struct LocalRendezvous::Item {
-  enum Type { kSend = 0, kRecv = 1 };
-
-  Item(Rendezvous::Args send_args, const Tensor& value, bool is_dead)
-      : Item(send_args, kSend) {
-    send_state.value.Init(value);
-    send_state.is_dead = is_dead;
+LocalRendezvous::Item::Item(const Rendezvous::Args& send_args,
+                            const Tensor& value, bool is_dead)
+    : args(send_args), type(kSend), value(value), is_dead(is_dead) {
+  if (args.device_context) {
+    args.device_context->Ref();
   }
+}
 
-  Item(Rendezvous::Args recv_args, Rendezvous::DoneCallback waiter,
-       CancellationToken cancellation_token)
-      : Item(recv_args, kRecv) {
-    recv_state.waiter.Init(std::move(waiter));
-    recv_state.cancellation_token = cancellation_token;
+LocalRendezvous::Item::Item(const Rendezvous::Args& recv_args,
+                            Rendezvous::DoneCallback waiter,
+                            CancellationToken cancellation_token)
+    : args(recv_args),
+      type(kRecv),
+      waiter(std::move(waiter)),
+      cancellation_token(cancellation_token) {
+  if (args.device_context) {
+    args.device_context->Ref();
   }
+}
+
+LocalRendezvous::Item::Item(Item&& other)
+    : args(other.args),
+      type(other.type),
+      value(std::move(other.value)),
+      is_dead(other.is_dead),
+      waiter(std::move(other.waiter)),
+      cancellation_token(other.cancellation_token) {
+  other.args.device_context = nullptr;
+}
 
-  ~Item() {
+LocalRendezvous::Item& LocalRendezvous::Item::operator=(Item&& other) {
+  if (this != &other) {
     if (args.device_context) {
       args.device_context->Unref();
     }
-    if (type == kSend) {
-      send_state.value.Destroy();
-    } else {
-      recv_state.waiter.Destroy();
-    }
+    args = other.args;
+    other.args.device_context = nullptr;
+    type = other.type;
+    value = std::move(other.value);
+    is_dead = other.is_dead;
+    waiter = std::move(other.waiter);
+    cancellation_token = other.cancellation_token;
   }
+  return *this;
+}
 
-  const Rendezvous::Args args;
-  const Type type;
-
-  // Link to next item in an ItemQueue.
-  Item* next = nullptr;
-
-  // The validity of `send_state` or `recv_state` is determined by `type ==
-  // kSend` or `type == kRecv` respectively.
-  union {
-    struct {
-      ManualConstructor<Tensor> value;
-      bool is_dead;
-    } send_state;
-    struct {
-      ManualConstructor<Rendezvous::DoneCallback> waiter;
-      CancellationToken cancellation_token;
-    } recv_state;
-  };
-
- private:
-  Item(Rendezvous::Args args, Type type) : args(args), type(type) {
-    if (args.device_context) {
-      args.device_context->Ref();
-    }
+LocalRendezvous::Item::~Item() {
+  if (args.device_context) {
+    args.device_context->Unref();
   }
-};
-
-void LocalRendezvous::ItemQueue::push_back(Item* item) {
-  if (TF_PREDICT_TRUE(head == nullptr)) {
-    // The queue is empty.
-    head = item;
-    tail = item;
-  } else {
-    DCHECK_EQ(tail->type, item->type);
-    tail->next = item;
-    tail = item;
+}
+
+void LocalRendezvous::ItemQueue::push_back(Item item) {
+  DCHECK(empty() || front().type == item.type);
+  items.push_back(std::move(item));
+}
+
+LocalRendezvous::Item LocalRendezvous::ItemQueue::pop_front() {
+  DCHECK(!empty());
+  Item item = std::move(items[head]);
+  ++head;
+  if (head == items.size()) {
+    items.clear();
+    head = 0;
+  } else if (2 * head >= items.size()) {
+    // Drop the consumed items, so that a queue that never drains does not
+    // grow without bound.
+    items.erase(items.begin(), items.begin() + head);
+    head = 0;
   }
+  return item;
 }
 
 LocalRendezvous::~LocalRendezvous() {
-  if (!table_.empty()) {
+  bool empty = true;
+  for (TableShard& shard : shards_) {
+    mutex_lock l(shard.mu);
+    empty = empty && shard.table.empty();
+  }
+  if (!empty) {
     StartAbort(errors::Cancelled("LocalRendezvous deleted"));
   }
 }
 
+Status LocalRendezvous::GetAbortStatus() {
+  mutex_lock l(status_mu_);
+  return status_;
+}
+
 namespace {
 uint64 KeyHash(const StringPiece& k) { return Hash64(k.data(), k.size()); }
 }  // namespace
@@ -122,45 +140,40 @@ Status LocalRendezvous::Send(const Rendezvous::ParsedKey& key,
         ->IncrementBy(1);
   }
 
-  mu_.lock();
-  if (!status_.ok()) {
+  TableShard* shard = GetShard(key_hash);
+  shard->mu.lock();
+  if (aborted_.load(std::memory_order_acquire)) {
     // Rendezvous has been aborted.
-    Status s = status_;
-    mu_.unlock();
-    return s;
+    shard->mu.unlock();
+    return GetAbortStatus();
   }
 
-  ItemQueue* queue = &table_[key_hash];
-  if (queue->head == nullptr || queue->head->type == Item::kSend) {
+  ItemQueue* queue = &shard->table[key_hash];
+  if (queue->empty() || queue->front().type == Item::kSend) {
     // There is no waiter for this message. Append the message
     // into the queue. The waiter will pick it up when arrives.
     // Only send-related fields need to be filled.
-    // TODO(b/143786186): Investigate moving the allocation of `Item` outside
-    // the lock.
     DVLOG(2) << "Enqueue Send Item (key:" << key.FullKey() << "). ";
-    queue->push_back(new Item(send_args, val, is_dead));
-    mu_.unlock();
+    queue->push_back(Item(send_args, val, is_dead));
+    shard->mu.unlock();
     return Status::OK();
   }
 
   DVLOG(2) << "Consume Recv Item (key:" << key.FullKey() << "). ";
   // There is an earliest waiter to consume this message.
-  Item* item = queue->head;
+  Item item = queue->pop_front();
 
   // Delete the queue when the last element has been consumed.
-  if (item->next == nullptr) {
+  if (queue->empty()) {
     DVLOG(2) << "Clean up Send/Recv queue (key:" << key.FullKey() << "). ";
-    table_.erase(key_hash);
-  } else {
-    queue->head = item->next;
+    shard->table.erase(key_hash);
   }
-  mu_.unlock();
+  shard->mu.unlock();
 
   // Notify the waiter by invoking its done closure, outside the
   // lock.
-  DCHECK_EQ(item->type, Item::kRecv);
-  (*item->recv_state.waiter)(Status::OK(), send_args, item->args, val, is_dead);
-  delete item;
+  DCHECK_EQ(item.type, Item::kRecv);
+  item.waiter(Status::OK(), send_args, item.args, val, is_dead);
   return Status::OK();
 }
 
@@ -170,17 +183,17 @@ void LocalRendezvous::RecvAsync(const Rendezvous::ParsedKey& key,
   uint64 key_hash = KeyHash(key.FullKey());
   DVLOG(2) << "Recv " << this << " " << key_hash << " " << key.FullKey();
 
-  mu_.lock();
-  if (!status_.ok()) {
+  TableShard* shard = GetShard(key_hash);
+  shard->mu.lock();
+  if (aborted_.load(std::memory_order_acquire)) {
     // Rendezvous has been aborted.
-    Status s = status_;
-    mu_.unlock();
-    done(s, Rendezvous::Args(), recv_args, Tensor(), false);
+    shard->mu.unlock();
+    done(GetAbortStatus(), Rendezvous::Args(), recv_args, Tensor(), false);
     return;
   }
 
-  ItemQueue* queue = &table_[key_hash];
-  if (queue->head == nullptr || queue->head->type == Item::kRecv) {
+  ItemQueue* queue = &shard->table[key_hash];
+  if (queue->empty() || queue->front().type == Item::kRecv) {
     // There is no message to pick up.
     // Only recv-related fields need to be filled.
     CancellationManager* cm = recv_args.cancellation_manager;
@@ -202,34 +215,23 @@ void LocalRendezvous::RecvAsync(const Rendezvous::ParsedKey& key,
       //     unref in the cancellation callback.
       if (rc_owner_) rc_owner_->Ref();
       token = cm->get_cancellation_token();
-      already_cancelled = !cm->RegisterCallback(token, [this, token, key_hash] {
-        Item* item = nullptr;
+      already_cancelled = !cm->RegisterCallback(token, [this, token, key_hash,
+                                                        shard] {
+        absl::optional<Item> item;
         {
-          mutex_lock l(mu_);
-          ItemQueue* queue = &table_[key_hash];
+          mutex_lock l(shard->mu);
+          auto it = shard->table.find(key_hash);
+          ItemQueue* queue = it == shard->table.end() ? nullptr : &it->second;
           // Find an item in the queue with a cancellation token that matches
           // `token`, and remove it.
-          if (queue->head != nullptr && queue->head->type == Item::kRecv) {
-            for (Item *prev = nullptr, *curr = queue->head; curr != nullptr;
-                 prev = curr, curr = curr->next) {
-              if (curr->recv_state.cancellation_token == token) {
-                item = curr;
-                if (queue->head->next == nullptr) {
-                  // We have a single-element queue, so we can erase it from
-                  // the table.
-                  table_.erase(key_hash);
-                } else {
-                  // Remove the current item from the queue.
-                  if (curr == queue->head) {
-                    DCHECK_EQ(prev, nullptr);
-                    queue->head = curr->next;
-                  } else {
-                    DCHECK_NE(prev, nullptr);
-                    prev->next = curr->next;
-                  }
-                  if (queue->tail == curr) {
-                    queue->tail = prev;
-                  }
+          if (queue != nullptr && !queue->empty() &&
+              queue->front().type == Item::kRecv) {
+            for (size_t i = queue->head; i < queue->items.size(); ++i) {
+              if (queue->items[i].cancellation_token == token) {
+                item.emplace(std::move(queue->items[i]));
+                queue->items.erase(queue->items.begin() + i);
+                if (queue->empty()) {
+                  shard->table.erase(it);
                 }
                 break;
               }
@@ -237,19 +239,18 @@ void LocalRendezvous::RecvAsync(const Rendezvous::ParsedKey& key,
           }
         }
 
-        if (item != nullptr) {
-          (*item->recv_state.waiter)(
-              StatusGroup::MakeDerived(
-                  errors::Cancelled("RecvAsync is cancelled.")),
-              Rendezvous::Args(), item->args, Tensor(), /*is_dead=*/false);
-          delete item;
+        if (item.has_value()) {
+          item->waiter(StatusGroup::MakeDerived(
+                           errors::Cancelled("RecvAsync is cancelled.")),
+                       Rendezvous::Args(), item->args, Tensor(),
+                       /*is_dead=*/false);
         }
         // Unref case (1) and (4)
         if (rc_owner_) rc_owner_->Unref();
       });
     }
     if (already_cancelled) {
-      mu_.unlock();
+      shard->mu.unlock();
       // Unref case (2)
       if (rc_owner_) rc_owner_->Unref();
       done(StatusGroup::MakeDerived(
@@ -260,13 +261,11 @@ void LocalRendezvous::RecvAsync(const Rendezvous::ParsedKey& key,
 
     DVLOG(2) << "Enqueue Recv Item (key:" << key.FullKey() << "). ";
 
-    // TODO(b/143786186): Investigate moving the allocation of `Item` outside
-    // the lock.
     if (cm != nullptr) {
       // NOTE(mrry): We must wrap `done` with code that deregisters the
       // cancellation callback before calling the `done` callback, because the
       // cancellation manager may no longer be live after `done` is called.
-      queue->push_back(new Item(
+      queue->push_back(Item(
           recv_args,
           [this, cm, token, done = std::move(done)](
               const Status& s, const Rendezvous::Args& send_args,
@@ -283,52 +282,52 @@ void LocalRendezvous::RecvAsync(const Rendezvous::ParsedKey& key,
           },
           token));
     } else {
-      queue->push_back(new Item(recv_args, std::move(done), token));
+      queue->push_back(Item(recv_args, std::move(done), token));
     }
 
-    mu_.unlock();
+    shard->mu.unlock();
     return;
   }
 
   DVLOG(2) << "Consume Send Item (key:" << key.FullKey() << "). ";
   // A message has already arrived and is queued in the table under
   // this key.  Consumes the message and invokes the done closure.
-  Item* item = queue->head;
+  Item item = queue->pop_front();
 
   // Delete the queue when the last element has been consumed.
-  if (item->next == nullptr) {
+  if (queue->empty()) {
     DVLOG(2) << "Clean up Send/Recv queue (key:" << key.FullKey() << "). ";
-    table_.erase(key_hash);
-  } else {
-    queue->head = item->next;
+    shard->table.erase(key_hash);
   }
-  mu_.unlock();
+  shard->mu.unlock();
 
   // Invoke done() without holding the table lock.
-  DCHECK_EQ(item->type, Item::kSend);
-  done(Status::OK(), item->args, recv_args, *item->send_state.value,
-       item->send_state.is_dead);
-  delete item;
+  DCHECK_EQ(item.type, Item::kSend);
+  done(Status::OK(), item.args, recv_args, item.value, item.is_dead);
 }
 
 void LocalRendezvous::StartAbort(const Status& status) {
   CHECK(!status.ok());
-  Table table;
   {
-    mutex_lock l(mu_);
+    mutex_lock l(status_mu_);
     status_.Update(status);
-    table_.swap(table);
   }
-  for (auto& p : table) {
-    Item* item = p.second.head;
-    while (item != nullptr) {
-      if (item->type == Item::kRecv) {
-        (*item->recv_state.waiter)(status, Rendezvous::Args(),
-                                   Rendezvous::Args(), Tensor(), false);
+  aborted_.store(true, std::memory_order_release);
+  for (TableShard& shard : shards_) {
+    Table table;
+    {
+      mutex_lock l(shard.mu);
+      shard.table.swap(table);
+    }
+    for (auto& p : table) {
+      ItemQueue& queue = p.second;
+      for (size_t i = queue.head; i < queue.items.size(); ++i) {
+        Item& item = queue.items[i];
+        if (item.type == Item::kRecv) {
+          item.waiter(status, Rendezvous::Args(), Rendezvous::Args(), Tensor(),
+                      false);
+        }
       }
-      Item* to_delete = item;
-      item = item->next;
-      delete to_delete;
     }
   }
 }
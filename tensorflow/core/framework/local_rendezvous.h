@@ -16,10 +16,14 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_FRAMEWORK_LOCAL_RENDEZVOUS_H_
 #define TENSORFLOW_CORE_FRAMEWORK_LOCAL_RENDEZVOUS_H_
 
+#include <atomic>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/inlined_vector.h"
+#include "tensorflow/core/framework/cancellation.h"
 #include "tensorflow/core/framework/rendezvous.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/lib/core/status.h"
-#include "tensorflow/core/lib/gtl/flatmap.h"
 #include "tensorflow/core/platform/macros.h"
 #include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/platform/types.h"
@@ -51,28 +55,82 @@ class LocalRendezvous {
   void StartAbort(const Status& status);
 
  private:
-  struct Item;
+  // Represents a blocked Send() or Recv() call in the rendezvous.
+  struct Item {
+    enum Type { kSend = 0, kRecv = 1 };
+
+    Item(const Rendezvous::Args& send_args, const Tensor& value, bool is_dead);
+    Item(const Rendezvous::Args& recv_args, Rendezvous::DoneCallback waiter,
+         CancellationToken cancellation_token);
+    // Items are moved within and out of their queue. The reference on
+    // `args.device_context` moves with them.
+    Item(Item&& other);
+    Item& operator=(Item&& other);
+    ~Item();
+
+    Rendezvous::Args args;
+    Type type;
+
+    // Valid if `type == kSend`.
+    Tensor value;
+    bool is_dead = false;
+
+    // Valid if `type == kRecv`.
+    Rendezvous::DoneCallback waiter;
+    CancellationToken cancellation_token = CancellationManager::kInvalidToken;
+  };
 
   // By invariant, the item queue under each key is of the form
   //   [item.type == kSend]* meaning each item is a sent message.
   // or
   //   [item.type == kRecv]* meaning each item is a waiter.
+  //
+  // Items are stored inline, and a key usually has a single pending item, so
+  // matching a Send with a Recv does not allocate. Queues are removed from the
+  // table once they are empty.
   struct ItemQueue {
-    void push_back(Item* item);
+    bool empty() const { return head == items.size(); }
+    Item& front() { return items[head]; }
+    const Item& front() const { return items[head]; }
+
+    void push_back(Item item);
+    // Removes and returns the first item.
+    Item pop_front();
+
+    absl::InlinedVector<Item, 1> items;
+    // Index of the first item in `items`. The items before it have been
+    // consumed.
+    size_t head = 0;
+  };
 
-    Item* head = nullptr;
-    Item* tail = nullptr;
+  typedef absl::flat_hash_map<uint64, ItemQueue> Table;
+
+  // The table is sharded by key hash, so that Send and Recv calls for
+  // different keys rarely contend on the same lock.
+  static constexpr int kNumShards = 16;
+  struct alignas(64) TableShard {
+    mutex mu;
+    Table table TF_GUARDED_BY(mu);
   };
 
-  typedef gtl::FlatMap<uint64, ItemQueue> Table;
+  TableShard* GetShard(uint64 key_hash) {
+    return &shards_[key_hash % kNumShards];
+  }
+
+  // Returns the status passed to StartAbort.
+  Status GetAbortStatus() TF_LOCKS_EXCLUDED(status_mu_);
 
   // Pointer to the owner class of this LocalRendezvous if it is refcounted.
   const Rendezvous* rc_owner_;
 
-  // TODO(zhifengc): shard table_.
-  mutex mu_;
-  Table table_ TF_GUARDED_BY(mu_);
-  Status status_ TF_GUARDED_BY(mu_);
+  TableShard shards_[kNumShards];
+
+  // Set by StartAbort before it drains the shards. Send and Recv check it
+  // while holding the lock of their shard, so they either see it or enqueue
+  // their item before the shard is drained.
+  std::atomic<bool> aborted_{false};
+  mutex status_mu_;
+  Status status_ TF_GUARDED_BY(status_mu_);
 
   TF_DISALLOW_COPY_AND_ASSIGN(LocalRendezvous);
 };
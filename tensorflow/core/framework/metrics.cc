@@ -122,6 +122,15 @@ auto* tf_data_service_workers_created_counter =
     monitoring::Counter<0>::New("/tensorflow/data/service/workers_created",
                                 "Number of tf.data service workers created");
 
+auto* tf_data_service_elements_produced_counter = monitoring::Counter<0>::New(
+    "/tensorflow/data/service/elements_produced",
+    "The number of elements produced by tf.data service workers.");
+
+auto* tf_data_service_bytes_produced_counter = monitoring::Counter<0>::New(
+    "/tensorflow/data/service/bytes_produced",
+    "The number of bytes of the elements produced by tf.data service workers. "
+    "Compressed elements count their compressed size.");
+
 auto* tf_data_filename_counter = monitoring::Counter<2>::New(
     "/tensorflow/data/filename", "The file name read by a tf.data Dataset.",
     "name", "filename");
@@ -266,6 +275,13 @@ void RecordTFDataServiceWorkerCreated() {
   tf_data_service_workers_created_counter->GetCell()->IncrementBy(1);
 }
 
+void RecordTFDataServiceElementsProduced(int64_t num_elements,
+                                         int64_t num_bytes) {
+  tf_data_service_elements_produced_counter->GetCell()->IncrementBy(
+      num_elements);
+  tf_data_service_bytes_produced_counter->GetCell()->IncrementBy(num_bytes);
+}
+
 void RecordTFDataFilename(const string& name, const string& filename) {
   tf_data_filename_counter->GetCell(name, filename)->IncrementBy(1);
 }
@@ -97,6 +97,12 @@ void RecordTFDataOptimization(const string& name, int64_t num_changes);
 // Records that a tf.data service worker has been created.
 void RecordTFDataServiceWorkerCreated();
 
+// Records that a tf.data service worker has produced `num_elements` elements
+// of `num_bytes` bytes. The rates of these counters are the throughput of the
+// workers.
+void RecordTFDataServiceElementsProduced(int64_t num_elements,
+                                         int64_t num_bytes);
+
 // Records the file name read by a tf.data Dataset.
 //
 // The `name` argument identifies the Dataset type (e.g. "TFRecordDataset").
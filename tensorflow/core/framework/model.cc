@@ -1505,6 +1505,13 @@ Status Node::ToProto(ModelProto::Node* node_proto) const {
   node_proto->set_num_elements(num_elements_);
   node_proto->set_processing_time(processing_time_);
   node_proto->set_record_metrics(record_metrics_);
+  {
+    tf_shared_lock l(get_next_latency_mu_);
+    if (get_next_latency_) {
+      get_next_latency_->EncodeToProto(node_proto->mutable_get_next_latency(),
+                                       /*preserve_zero_buckets=*/false);
+    }
+  }
 
   // Produce protos for all parameters.
   for (auto const& parameter : parameters_) {
@@ -1535,6 +1542,11 @@ Status Node::FromProtoHelper(ModelProto::Node node_proto,
   node->num_elements_.store(node_proto.num_elements());
   node->processing_time_.store(node_proto.processing_time());
   node->record_metrics_.store(node_proto.record_metrics());
+  if (node_proto.has_get_next_latency()) {
+    mutex_lock l(node->get_next_latency_mu_);
+    node->get_next_latency_ = std::make_unique<histogram::Histogram>();
+    node->get_next_latency_->DecodeFromProto(node_proto.get_next_latency());
+  }
 
   // Restore parameters.
   int64_t num_parameters = node_proto.parameters_size();
@@ -1663,6 +1675,10 @@ void Model::Optimize(AutotuneAlgorithm algorithm, int64_t cpu_budget,
       OptimizeGradientDescent(snapshot, optimization_params,
                               cancellation_manager);
       break;
+    case AutotuneAlgorithm::RESOURCE_AWARE:
+      OptimizeResourceAware(snapshot, optimization_params,
+                            cancellation_manager);
+      break;
     default:
       VLOG(2) << "Autotuning algorithm was not recognized. Aborting "
                  "optimization.";
@@ -1731,6 +1747,8 @@ Status Model::OptimizeLoop(AutotuneAlgorithm algorithm, int64_t cpu_budget,
 
   int64_t last_optimization_ms = 0;
   int64_t current_time_ms = EnvTime::NowMicros() / EnvTime::kMillisToMicros;
+  // The maximum number of buffered bytes after the last optimization.
+  double optimized_buffered_bytes = 0;
   while (true) {
     {
       mutex_lock l(mu_);
@@ -1738,9 +1756,20 @@ Status Model::OptimizeLoop(AutotuneAlgorithm algorithm, int64_t cpu_budget,
              last_optimization_ms + optimization_period_ms_ > current_time_ms) {
         auto wait_ms =
             last_optimization_ms + optimization_period_ms_ - current_time_ms;
+        if (algorithm == AutotuneAlgorithm::RESOURCE_AWARE) {
+          wait_ms = std::min(wait_ms, kElementSizeCheckPeriodMs);
+        }
         VLOG(2) << "Waiting for " << wait_ms << " ms.";
         optimize_cond_var_.wait_for(l, std::chrono::milliseconds(wait_ms));
         current_time_ms = EnvTime::NowMicros() / EnvTime::kMillisToMicros;
+        if (algorithm == AutotuneAlgorithm::RESOURCE_AWARE &&
+            ElementSizesDrifted(optimized_buffered_bytes, ram_budget)) {
+          // Re-tune right away, and then as often as after the first
+          // optimization, to adapt to the new element sizes.
+          VLOG(2) << "Element sizes drifted, re-tuning.";
+          optimization_period_ms_ = kOptimizationPeriodMinMs;
+          break;
+        }
       }
       if (cancellation_manager->IsCancelled()) {
         return Status::OK();
@@ -1759,6 +1788,9 @@ Status Model::OptimizeLoop(AutotuneAlgorithm algorithm, int64_t cpu_budget,
       mutex_lock l(mu_);
       optimization_period_ms_ =
           std::min(optimization_period_ms_ << 1, kOptimizationPeriodMaxMs);
+      if (output_) {
+        optimized_buffered_bytes = output_->TotalMaximumBufferedBytes();
+      }
     }
     current_time_ms = EnvTime::NowMicros() / EnvTime::kMillisToMicros;
     last_optimization_ms = current_time_ms;
@@ -1766,6 +1798,23 @@ Status Model::OptimizeLoop(AutotuneAlgorithm algorithm, int64_t cpu_budget,
   }
 }
 
+bool Model::ElementSizesDrifted(double optimized_buffered_bytes,
+                                int64_t ram_budget) {
+  // The maximum number of buffered bytes is recomputed from the current
+  // average element sizes. Small changes are ignored since they are expected
+  // from the variance of the element sizes.
+  constexpr double kMaxRelativeDrift = 0.5;
+  if (!output_) {
+    return false;
+  }
+  const double buffered_bytes = output_->TotalMaximumBufferedBytes();
+  if (buffered_bytes > ram_budget && optimized_buffered_bytes <= ram_budget) {
+    return true;
+  }
+  return std::abs(buffered_bytes - optimized_buffered_bytes) >
+         kMaxRelativeDrift * optimized_buffered_bytes;
+}
+
 void Model::OptimizeGradientDescent(
     std::shared_ptr<Node> snapshot,
     const OptimizationParams& optimization_params,
@@ -1901,6 +1950,94 @@ void Model::OptimizeHillClimb(std::shared_ptr<Node> snapshot,
   UpdateStateValues(&parameters);
 }
 
+void Model::OptimizeResourceAware(
+    std::shared_ptr<Node> snapshot,
+    const OptimizationParams& optimization_params,
+    CancellationManager* cancellation_manager) {
+  VLOG(2) << "Starting optimization of tunable parameters with Resource "
+             "Aware.";
+  const double processing_time = TotalProcessingTime(snapshot);
+  auto parameters = CollectTunableParameters(snapshot);
+  if (parameters.empty()) {
+    VLOG(2) << "The Resource Aware optimization is terminated since no node "
+               "with tunable parameters has recorded elements.";
+    return;
+  }
+  VLOG(2) << "Number of tunable parameters: " << parameters.size();
+
+  // Buffer size parameter will only be incremented if the output latency
+  // improvement is greater than this constant.
+  constexpr double kBufferSizeMinDelta = 1.0L;
+  // Lower bound of the share of the budgets consumed by an increment, so that
+  // increments that consume no resources are not infinitely preferred.
+  constexpr double kMinBudgetShare = 1e-6;
+
+  const double cpu_budget = optimization_params.cpu_budget();
+  const double ram_budget = optimization_params.ram_budget();
+
+  // Initialize the parameter values to minimal before tuning.
+  double parallelism = 0;
+  for (auto& pair : parameters) {
+    pair.second->value = pair.second->min;
+    if (pair.second->name == kParallelism) {
+      parallelism += pair.second->value;
+    }
+  }
+  double buffered_bytes = TotalMaximumBufferedBytes(snapshot);
+  while (!cancellation_manager->IsCancelled()) {
+    const double output_time =
+        OutputTime(snapshot, optimization_params.model_input_time(),
+                   /*gradients=*/nullptr);
+    if (output_time < processing_time / cpu_budget) {
+      break;
+    }
+    double best_score = 0;
+    double best_buffered_bytes = buffered_bytes;
+    Parameter* best_parameter = nullptr;
+    for (auto& pair : parameters) {
+      Parameter* parameter = pair.second.get();
+      const bool is_parallelism = parameter->name == kParallelism;
+      if (parameter->value >= parameter->max ||
+          (is_parallelism && parallelism + 1 > cpu_budget)) {
+        continue;
+      }
+      parameter->value++;
+      const double new_buffered_bytes = TotalMaximumBufferedBytes(snapshot);
+      const double delta =
+          output_time - OutputTime(snapshot,
+                                   optimization_params.model_input_time(),
+                                   /*gradients=*/nullptr);
+      parameter->value--;
+      if (new_buffered_bytes > ram_budget ||
+          delta <= (is_parallelism ? 0 : kBufferSizeMinDelta)) {
+        continue;
+      }
+      double budget_share = is_parallelism ? 1.0 / cpu_budget : 0;
+      if (ram_budget > 0) {
+        budget_share += (new_buffered_bytes - buffered_bytes) / ram_budget;
+      }
+      const double score = delta / std::max(budget_share, kMinBudgetShare);
+      if (score > best_score) {
+        best_score = score;
+        best_buffered_bytes = new_buffered_bytes;
+        best_parameter = parameter;
+      }
+    }
+    if (!best_parameter) {
+      VLOG(2) << "Failed to find a tunable parameter that would further "
+                 "decrease the output time within the CPU and RAM budgets. "
+                 "The optimization attempt will terminate early.";
+      break;
+    }
+    best_parameter->value++;
+    buffered_bytes = best_buffered_bytes;
+    if (best_parameter->name == kParallelism) {
+      parallelism++;
+    }
+  }
+  UpdateStateValues(&parameters);
+}
+
 double Model::OutputTime(std::shared_ptr<Node> node, double model_input_time,
                          Model::ParameterGradients* gradients) {
   // To store the input time for each node.
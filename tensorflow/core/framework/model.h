@@ -284,6 +284,26 @@ class Node {
   // Records that the node produced an element.
   void record_element() TF_LOCKS_EXCLUDED(mu_) { num_elements_++; }
 
+  // Records the latency of a `GetNext` call made on this node's iterator by
+  // its consumer. The histogram is allocated by the first call, since most
+  // nodes never record a latency.
+  void record_get_next_latency(int64_t latency_usec)
+      TF_LOCKS_EXCLUDED(get_next_latency_mu_) {
+    mutex_lock l(get_next_latency_mu_);
+    if (!get_next_latency_) {
+      get_next_latency_ = std::make_unique<histogram::Histogram>();
+    }
+    get_next_latency_->Add(latency_usec);
+  }
+
+  // Returns the given percentile of the recorded `GetNext` latencies, or 0 if
+  // none was recorded.
+  double get_next_latency_percentile(double p) const
+      TF_LOCKS_EXCLUDED(get_next_latency_mu_) {
+    tf_shared_lock l(get_next_latency_mu_);
+    return get_next_latency_ ? get_next_latency_->Percentile(p) : 0.0;
+  }
+
   // Records that a node thread has started executing.
   void record_start(int64_t time_nanos) TF_LOCKS_EXCLUDED(mu_) {
     DCHECK_EQ(work_start_, 0);
@@ -570,6 +590,9 @@ class Node {
   std::atomic<int64_t> num_elements_;
   std::atomic<int64_t> processing_time_;
   std::atomic<bool> record_metrics_;
+  mutable mutex get_next_latency_mu_;
+  std::unique_ptr<histogram::Histogram> get_next_latency_
+      TF_GUARDED_BY(get_next_latency_mu_);
   Metrics metrics_;
   absl::flat_hash_map<string, std::shared_ptr<Parameter>> parameters_
       TF_GUARDED_BY(mu_);
@@ -705,6 +728,10 @@ class Model {
   static constexpr int64_t kOptimizationPeriodMinMs = 10;
   static constexpr int64_t kOptimizationPeriodMaxMs =
       60 * EnvTime::kSecondsToMillis;
+  // How often the optimization loop of the resource aware algorithm checks
+  // whether the element sizes drifted while waiting for the next optimization.
+  static constexpr int64_t kElementSizeCheckPeriodMs =
+      1 * EnvTime::kSecondsToMillis;
 
   // Collects tunable parameters in the tree rooted in the given node, returning
   // a vector which contains pairs of node names and tunable parameters.
@@ -734,6 +761,27 @@ class Model {
                                const OptimizationParams& optimization_params,
                                CancellationManager* cancellation_manager);
 
+  // This optimization algorithm treats the CPU budget and the RAM budget as
+  // constraints. It starts by setting all tunable parameters to the minimum
+  // value. It then repeatedly increments the parameter with the largest
+  // decrease of the output time per share of the budgets that the increment
+  // consumes, where a parallelism increment consumes one CPU and a buffer
+  // increment consumes the memory of the elements it buffers. Increments that
+  // would exceed either budget are not considered. This process is repeated
+  // until no increment decreases the output time or the output time is less
+  // than the processing time needed to produce an element divided by CPU
+  // budget.
+  void OptimizeResourceAware(std::shared_ptr<Node> snapshot,
+                             const OptimizationParams& optimization_params,
+                             CancellationManager* cancellation_manager);
+
+  // Determines whether the size of the buffered elements changed enough since
+  // the last optimization for the parameters found by the resource aware
+  // algorithm to no longer fit the RAM budget. `optimized_buffered_bytes` is
+  // the maximum number of buffered bytes after the last optimization.
+  bool ElementSizesDrifted(double optimized_buffered_bytes, int64_t ram_budget)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
   // Determines if we should stop the gradient descent optimization iterations
   // based on number of increasable parameters, CPU budget, RAM budget and
   // current resource usage.
@@ -1176,6 +1176,28 @@ TEST(RecordTimeTest, RecordTimeTest) {
   EXPECT_FALSE(source->is_recording());
 }
 
+TEST(GetNextLatencyTest, RecordAndSerialize) {
+  std::shared_ptr<Node> source = model::MakeSourceNode({0, "source", nullptr});
+  ModelProto::Node node_proto;
+  TF_ASSERT_OK(source->ToProto(&node_proto));
+  EXPECT_FALSE(node_proto.has_get_next_latency());
+
+  for (int64_t latency_usec = 1; latency_usec <= 100; ++latency_usec) {
+    source->record_get_next_latency(latency_usec);
+  }
+  EXPECT_NEAR(source->get_next_latency_percentile(50.0), 50.0, 5.0);
+  EXPECT_GE(source->get_next_latency_percentile(99.0), 90.0);
+  TF_ASSERT_OK(source->ToProto(&node_proto));
+  EXPECT_EQ(node_proto.get_next_latency().num(), 100);
+  EXPECT_EQ(node_proto.get_next_latency().min(), 1);
+  EXPECT_EQ(node_proto.get_next_latency().max(), 100);
+
+  std::shared_ptr<Node> restored;
+  TF_ASSERT_OK(Node::FromProto(node_proto, /*output=*/nullptr, &restored));
+  EXPECT_EQ(restored->get_next_latency_percentile(50.0),
+            source->get_next_latency_percentile(50.0));
+}
+
 }  // namespace
 }  // namespace model
 }  // namespace data
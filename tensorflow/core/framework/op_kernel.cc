@@ -349,6 +349,23 @@ Allocator* OpKernelContext::get_allocator(AllocatorAttributes attr) {
   } else {
     allocator = params_->device->GetAllocator(attr);
   }
+  return maybe_wrap_allocator_for_tracking(allocator);
+}
+
+Allocator* OpKernelContext::get_allocator(AllocatorAttributes attr,
+                                          DataType type, bool step_local) {
+  // Only plain host buffers of types that need no construction are placed in
+  // the arena.
+  if (step_local && params_->step_arena_allocator != nullptr &&
+      attr.scope_id == 0 && !attr.gpu_compatible() &&
+      !attr.nic_compatible() && DataTypeCanUseMemcpy(type)) {
+    return maybe_wrap_allocator_for_tracking(params_->step_arena_allocator);
+  }
+  return get_allocator(attr);
+}
+
+Allocator* OpKernelContext::maybe_wrap_allocator_for_tracking(
+    Allocator* allocator) {
   if (TF_PREDICT_FALSE(track_allocations())) {
     DCHECK(tracking_state_);
     mutex_lock lock(tracking_state_->mu);
@@ -687,7 +704,13 @@ Status OpKernelContext::allocate_output(StringPiece name,
 Status OpKernelContext::allocate_tensor(
     DataType type, const TensorShape& shape, Tensor* out_tensor,
     AllocatorAttributes attr, const AllocationAttributes& allocation_attr) {
-  Allocator* a = get_allocator(attr);
+  return allocate_tensor(get_allocator(attr), type, shape, out_tensor,
+                         allocation_attr);
+}
+
+Status OpKernelContext::allocate_tensor(
+    Allocator* a, DataType type, const TensorShape& shape, Tensor* out_tensor,
+    const AllocationAttributes& allocation_attr) {
   Tensor new_tensor(
       a, type, shape,
       AllocationAttributes(
@@ -745,8 +768,11 @@ Status OpKernelContext::allocate_output(int index, const TensorShape& shape,
   profiler::ScopedMemoryDebugAnnotation op_annotation(
       op_kernel().name_view().data(), step_id(), "output", type,
       [&shape]() { return shape.DebugString(); });
+  const bool step_local = params_->outputs_step_local_array != nullptr &&
+                          params_->outputs_step_local_array[index];
   auto output_tensor = MakeUnique<Tensor>();
-  Status s = allocate_tensor(type, shape, output_tensor.get(), attr);
+  Status s = allocate_tensor(get_allocator(attr, type, step_local), type, shape,
+                             output_tensor.get(), AllocationAttributes());
   if (s.ok()) {
     outputs_[index] = TensorValue(output_tensor.release());
     *output = outputs_[index].tensor;
@@ -776,10 +802,10 @@ Status OpKernelContext::allocate_temp(
   profiler::ScopedMemoryDebugAnnotation op_annotation(
       op_kernel().name_view().data(), step_id(), "temp", type,
       [&shape]() { return shape.DebugString(); });
-  Status s =
-      allocate_tensor(type, shape, out_temp, allocator_attr, allocation_attr);
+  Allocator* a =
+      get_allocator(allocator_attr, type, params_->temps_step_local);
+  Status s = allocate_tensor(a, type, shape, out_temp, allocation_attr);
   if (track_allocations() && s.ok() && out_temp->TotalBytes() > 0) {
-    Allocator* a = get_allocator(allocator_attr);
     if (a->TracksAllocationSizes()) {
       int64_t alloc_size = a->AllocatedSize(out_temp->tensor_data().data());
       record_temp_memory_allocation(alloc_size, *out_temp);
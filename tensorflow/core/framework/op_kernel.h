@@ -680,6 +680,14 @@ class OpKernelContext {
     // outputs are required.
     bool* outputs_required_array = nullptr;
 
+    // If non-null, a step-scoped allocator for tensors that are known not to
+    // outlive the current step. Outputs may be allocated from it if they are
+    // marked in `outputs_step_local_array`, and temporaries if
+    // `temps_step_local` is true.
+    Allocator* step_arena_allocator = nullptr;
+    const bool* outputs_step_local_array = nullptr;
+    bool temps_step_local = false;
+
     // For access to distributed coordination service.
     CoordinationServiceAgent* coordination_service_agent = nullptr;
   };
@@ -1249,6 +1257,19 @@ class OpKernelContext {
   Status allocate_tensor(DataType type, const TensorShape& shape,
                          Tensor* out_tensor, AllocatorAttributes allocator_attr,
                          const AllocationAttributes& allocation_attr);
+  Status allocate_tensor(Allocator* a, DataType type, const TensorShape& shape,
+                         Tensor* out_tensor,
+                         const AllocationAttributes& allocation_attr);
+
+  // Returns the allocator for a tensor of `type` allocated with `attr`. This
+  // is the step arena allocator if `step_local` is true and the arena can hold
+  // the tensor, and `get_allocator(attr)` otherwise.
+  Allocator* get_allocator(AllocatorAttributes attr, DataType type,
+                           bool step_local);
+
+  // Returns `allocator`, wrapped in a TrackingAllocator if allocations are
+  // being tracked.
+  Allocator* maybe_wrap_allocator_for_tracking(Allocator* allocator);
 
   // Helpers for `set_output()`.
 
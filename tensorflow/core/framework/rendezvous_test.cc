@@ -15,12 +15,15 @@ limitations under the License.
 
 #include "tensorflow/core/framework/rendezvous.h"
 
+#include <vector>
+
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
 #include "tensorflow/core/framework/cancellation.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/framework/tensor_types.h"
 #include "tensorflow/core/framework/types.pb.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/notification.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
@@ -410,6 +413,26 @@ class DummyDeviceContext : public DeviceContext {
   const int stream_id_;
 };
 
+TEST_F(LocalRendezvousTest, AbortWakesRecvsForAllKeys) {
+  // Waiters for different keys are spread over the shards of the table.
+  constexpr int kNumKeys = 100;
+  BlockingCounter counter(kNumKeys);
+  for (int i = 0; i < kNumKeys; ++i) {
+    rendez_->RecvAsync(
+        MakeKey(strings::StrCat("key", i)), Rendezvous::Args(),
+        [&counter](const Status& s, const Rendezvous::Args& send_args,
+                   const Rendezvous::Args& recv_args, const Tensor& val,
+                   bool is_dead) {
+          EXPECT_TRUE(errors::IsAborted(s));
+          counter.DecrementCount();
+        });
+  }
+  rendez_->StartAbort(errors::Aborted(""));
+  counter.Wait();
+  EXPECT_TRUE(errors::IsAborted(
+      rendez_->Send(KeyFoo(), Rendezvous::Args(), V("foo"), false)));
+}
+
 TEST_F(LocalRendezvousTest, TransferDummyDeviceContext) {
   Rendezvous::Args args;
   args.device_context = new DummyDeviceContext(123);
@@ -518,5 +541,47 @@ void BM_PingPong(::testing::benchmark::State& state) {
 }
 BENCHMARK(BM_PingPong)->Arg(100)->Arg(200)->Arg(300);
 
+// Runs `num_pairs` producer threads that each send `kNumMessages` messages
+// under their own key, and as many consumer threads that receive them, all
+// through the same rendezvous.
+void BM_Contention(::testing::benchmark::State& state) {
+  const int num_pairs = state.range(0);
+  constexpr int kNumMessages = 100;
+  std::vector<Rendezvous::ParsedKey> keys;
+  for (int i = 0; i < num_pairs; ++i) {
+    keys.push_back(MakeKey(strings::StrCat("key", i)));
+  }
+  thread::ThreadPool* pool =
+      new thread::ThreadPool(Env::Default(), "test", 2 * num_pairs);
+  for (auto s : state) {
+    Rendezvous* rendez = NewLocalRendezvous();
+    BlockingCounter counter(2 * num_pairs);
+    for (int i = 0; i < num_pairs; ++i) {
+      pool->Schedule([rendez, &key = keys[i], &counter]() {
+        Tensor val = V("val");
+        Rendezvous::Args args;
+        for (int j = 0; j < kNumMessages; ++j) {
+          TF_CHECK_OK(rendez->Send(key, args, val, /*is_dead=*/false));
+        }
+        counter.DecrementCount();
+      });
+      pool->Schedule([rendez, &key = keys[i], &counter]() {
+        Tensor val(DT_STRING, TensorShape({}));
+        bool is_dead = false;
+        Rendezvous::Args args;
+        for (int j = 0; j < kNumMessages; ++j) {
+          TF_CHECK_OK(rendez->Recv(key, args, &val, &is_dead));
+        }
+        counter.DecrementCount();
+      });
+    }
+    counter.Wait();
+    rendez->Unref();
+  }
+  state.SetItemsProcessed(state.iterations() * num_pairs * kNumMessages);
+  delete pool;
+}
+BENCHMARK(BM_Contention)->RangeMultiplier(2)->Range(1, 64)->UseRealTime();
+
 }  // namespace
 }  // namespace tensorflow
@@ -132,6 +132,7 @@ void CostModel::Ensure(int id, int num_outputs) {
     time_.resize(id + 1);
     max_mem_usage_.resize(id + 1);
     max_exec_time_.resize(id + 1);
+    measured_time_.resize(id + 1);
     output_port_alloc_ids_.resize(id + 1);
   }
   if (num_outputs > 0) {
@@ -349,6 +350,21 @@ Microseconds CostModel::MaxExecutionTime(const Node* node) const {
   return max_exec_time_[id];
 }
 
+void CostModel::RecordMeasuredTime(const Node* node, Microseconds time) {
+  const int id = Id(node);
+  if (id < 0) return;
+  Ensure(id, node->num_outputs());
+  measured_time_[id] = time;
+}
+
+Microseconds CostModel::MeasuredTime(const Node* node) const {
+  const int id = Id(node);
+  if (id < 0 || static_cast<size_t>(id) >= measured_time_.size()) {
+    return Microseconds(0);
+  }
+  return measured_time_[id];
+}
+
 void CostModel::RecordAllocationId(const Node* node, int output_slot,
                                    int64_t alloc_id) {
   const int id = Id(node);
@@ -470,6 +486,7 @@ void CostModel::InitFromGraph(const Graph& g) {
   time_.reserve(num_node_ids);
   max_mem_usage_.reserve(num_node_ids);
   max_exec_time_.reserve(num_node_ids);
+  measured_time_.reserve(num_node_ids);
   output_port_alloc_ids_.reserve(num_node_ids);
 
   AddNodesToCostModel(g, this);
@@ -538,7 +555,11 @@ void CostModel::AddToCostGraphDef(const Graph* graph,
     cnode->set_temporary_memory_size(TempMemorySize(n).value());
     cnode->set_persistent_memory_size(PersistentMemorySize(n).value());
 
-    cnode->set_compute_cost(MaxExecutionTime(n).value());
+    // Falls back to the executor's measurement when no step stats were
+    // collected for the node.
+    Microseconds compute_cost = MaxExecutionTime(n);
+    if (compute_cost == Microseconds(0)) compute_cost = MeasuredTime(n);
+    cnode->set_compute_cost(compute_cost.value());
 
     // For now we treat all send nodes as final.
     // TODO(yuanbyu): Send nodes for fetches shouldn't be treated as final.
@@ -153,6 +153,14 @@ class CostModel {
   // Returns the maximum execution time (in microseconds) of "node".
   Microseconds MaxExecutionTime(const Node* node) const;
 
+  // Records the execution time (in microseconds) of "node" as measured by the
+  // executor that runs it, replacing any previously recorded measurement.
+  void RecordMeasuredTime(const Node* node, Microseconds time);
+
+  // Returns the execution time (in microseconds) of "node" as measured by
+  // its executor, or 0 if none was recorded.
+  Microseconds MeasuredTime(const Node* node) const;
+
   // Record the unique id of the tensor generated by "output_slot" of "node".
   // Any other tensor sharing the same id will be an alias, i.e. it will share
   // the same underlying memory storage area.
@@ -211,6 +219,9 @@ class CostModel {
   // Maximum execution time
   std::vector<Microseconds> max_exec_time_;
 
+  // Execution time measured by the executor
+  std::vector<Microseconds> measured_time_;
+
   // Maximum memory usage
   struct MemUsage {
     MemUsage() : temp_memory_size(0), persistent_memory_size(0) {}
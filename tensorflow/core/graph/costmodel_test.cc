@@ -100,5 +100,39 @@ TEST(CostModelTest, GlobalId) {
   }
 }
 
+TEST(CostModelTest, MeasuredTimeWithoutStepStats) {
+  Graph graph(OpRegistry::Global());
+  InitGraph(
+      "node { name: 'A' op: 'Input'}"
+      "node { name: 'B' op: 'Input'}"
+      "node { name: 'C' op: 'Mul' attr { key: 'T' value { type: DT_FLOAT } }"
+      " input: ['A', 'B'] }",
+      &graph);
+  CostModelManager cost_model_manager;
+  CostModel* cost_model = cost_model_manager.FindOrCreateCostModel(&graph);
+  const Node* a = nullptr;
+  const Node* c = nullptr;
+  for (const Node* n : graph.op_nodes()) {
+    if (n->name() == "A") a = n;
+    if (n->name() == "C") c = n;
+  }
+  ASSERT_NE(a, nullptr);
+  ASSERT_NE(c, nullptr);
+  cost_model->RecordMeasuredTime(a, Microseconds(3));
+  cost_model->RecordMeasuredTime(c, Microseconds(5));
+  cost_model->RecordMeasuredTime(c, Microseconds(7));
+  EXPECT_EQ(cost_model->MeasuredTime(c), Microseconds(7));
+  // Step stats take precedence over the measured time.
+  cost_model->RecordMaxExecutionTime(a, Microseconds(11));
+
+  CostGraphDef cost_graph_def;
+  TF_ASSERT_OK(cost_model_manager.AddToCostGraphDef(&graph, &cost_graph_def));
+  for (const auto& node : cost_graph_def.node()) {
+    if (node.name() == "A") EXPECT_EQ(node.compute_cost(), 11);
+    if (node.name() == "B") EXPECT_EQ(node.compute_cost(), 0);
+    if (node.name() == "C") EXPECT_EQ(node.compute_cost(), 7);
+  }
+}
+
 }  // namespace
 }  // namespace tensorflow
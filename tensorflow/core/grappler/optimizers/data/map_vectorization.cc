@@ -0,0 +1,589 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/optimizers/data/map_vectorization.h"
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/str_cat.h"
+#include "tensorflow/core/framework/attr_value.pb.h"
+#include "tensorflow/core/framework/attr_value_util.h"
+#include "tensorflow/core/framework/function.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/grappler/clusters/cluster.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/mutable_graph_view.h"
+#include "tensorflow/core/grappler/optimizers/custom_graph_optimizer_registry.h"
+#include "tensorflow/core/grappler/optimizers/data/function_utils.h"
+#include "tensorflow/core/grappler/optimizers/data/graph_utils.h"
+#include "tensorflow/core/grappler/utils.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace {
+
+constexpr char kBatchDataset[] = "BatchDataset";
+constexpr char kBatchDatasetV2[] = "BatchDatasetV2";
+constexpr char kChooseFastestBranchDataset[] = "ChooseFastestBranchDataset";
+constexpr char kMapDataset[] = "MapDataset";
+constexpr char kMapDefun[] = "MapDefun";
+constexpr char kParallelMapDataset[] = "ParallelMapDataset";
+constexpr char kParallelMapDatasetV2[] = "ParallelMapDatasetV2";
+constexpr char kParseExampleV2[] = "ParseExampleV2";
+
+// The number of output elements `ChooseFastestBranchDataset` takes from each
+// branch before picking the fastest one.
+constexpr int64_t kNumElementsPerBranch = 10;
+
+// The per-element rank of a tensor whose rank is not known statically.
+constexpr int kUnknownRank = -1;
+
+// Describes how an op can be applied to a batch of elements.
+struct VectorizationRule {
+  // The op is elementwise, with numpy-style broadcasting, in this many of its
+  // leading inputs, or in all of its inputs if -1. Only these inputs may
+  // depend on the input element.
+  int num_elementwise_inputs;
+  // Whether the other inputs must be scalars.
+  bool other_inputs_are_scalars;
+};
+
+// Returns the ops that can be applied to a batch of elements by applying them
+// to the batched tensors.
+const absl::flat_hash_map<string, VectorizationRule>& VectorizationRules() {
+  static const auto* rules = [] {
+    auto* rules = new absl::flat_hash_map<string, VectorizationRule>();
+    for (const char* op :
+         {// Unary math.
+          "Abs", "Acos", "Acosh", "Angle", "Asin", "Asinh", "Atan", "Atanh",
+          "Cast", "Ceil", "ComplexAbs", "Conj", "Cos", "Cosh", "Digamma",
+          "Elu", "Erf", "Erfc", "Exp", "Expm1", "Floor", "Identity", "Imag",
+          "Inv", "Invert", "IsFinite", "IsInf", "IsNan", "Lgamma", "Log",
+          "Log1p", "LogicalNot", "Neg", "Real", "Reciprocal", "Relu", "Relu6",
+          "Rint", "Round", "Rsqrt", "Selu", "Sigmoid", "Sign", "Sin", "Sinh",
+          "Softplus", "Softsign", "Sqrt", "Square", "StopGradient", "Tan",
+          "Tanh",
+          // Binary math.
+          "Add", "AddV2", "Atan2", "BitwiseAnd", "BitwiseOr", "BitwiseXor",
+          "Div", "DivNoNan", "Equal", "FloorDiv", "FloorMod", "Greater",
+          "GreaterEqual", "LeftShift", "Less", "LessEqual", "LogicalAnd",
+          "LogicalOr", "Maximum", "Minimum", "Mod", "Mul", "MulNoNan",
+          "NotEqual", "Pow", "RealDiv", "RightShift", "SquaredDifference",
+          "Sub", "TruncateDiv", "TruncateMod", "Xdivy", "Xlogy",
+          // Strings.
+          "AsString", "DecodeBase64", "EncodeBase64", "StaticRegexFullMatch",
+          "StaticRegexReplace", "StringLength", "StringLower", "StringStrip",
+          "StringToHashBucket", "StringToHashBucketFast",
+          "StringToHashBucketStrong", "StringToNumber", "StringUpper",
+          "UnicodeScript"}) {
+      (*rules)[op] = {/*num_elementwise_inputs=*/-1,
+                      /*other_inputs_are_scalars=*/true};
+    }
+    for (const char* op : {"RegexFullMatch", "RegexReplace", "Substr"}) {
+      (*rules)[op] = {/*num_elementwise_inputs=*/1,
+                      /*other_inputs_are_scalars=*/true};
+    }
+    // Each output of `DecodeCSV` has the shape of `records`.
+    (*rules)["DecodeCSV"] = {/*num_elementwise_inputs=*/1,
+                             /*other_inputs_are_scalars=*/false};
+    return rules;
+  }();
+  return *rules;
+}
+
+// What is known about a tensor of a function applied to a batch of elements.
+struct TensorInfo {
+  // Whether the tensor depends on the input element, in which case it has an
+  // extra leading batch dimension.
+  bool batched = false;
+  // The rank of the tensor for a single element.
+  int rank = kUnknownRank;
+};
+
+bool IsParallelMap(const NodeDef& node) {
+  return node.op() == kParallelMapDataset || node.op() == kParallelMapDatasetV2;
+}
+
+bool IsMap(const NodeDef& node) {
+  return node.op() == kMapDataset || IsParallelMap(node);
+}
+
+// Returns whether an elementwise op can be applied to the batched tensors,
+// and if so, sets `output` to what is known about its output.
+//
+// Applying an elementwise op to batched inputs broadcasts them the same way as
+// applying it to each element only if the batched inputs all have the same
+// rank and the other inputs do not have a higher rank.
+bool VectorizeElementwise(const std::vector<TensorInfo>& inputs,
+                          const VectorizationRule& rule, TensorInfo* output) {
+  const int num_elementwise_inputs =
+      rule.num_elementwise_inputs < 0
+          ? inputs.size()
+          : std::min<int>(rule.num_elementwise_inputs, inputs.size());
+  int num_batched = 0;
+  int rank = kUnknownRank;
+  for (int i = 0; i < num_elementwise_inputs; ++i) {
+    if (!inputs[i].batched) continue;
+    if (num_batched > 0 &&
+        (rank == kUnknownRank || inputs[i].rank != rank)) {
+      return false;
+    }
+    rank = inputs[i].rank;
+    ++num_batched;
+  }
+  for (int i = 0; i < num_elementwise_inputs; ++i) {
+    if (inputs[i].batched) continue;
+    if (inputs[i].rank == kUnknownRank) return false;
+    if (rank == kUnknownRank ? inputs[i].rank != 0 : inputs[i].rank > rank) {
+      return false;
+    }
+  }
+  for (int i = num_elementwise_inputs; i < inputs.size(); ++i) {
+    if (inputs[i].batched) return false;
+    if (rule.other_inputs_are_scalars && inputs[i].rank != 0) return false;
+  }
+  output->batched = true;
+  output->rank = rank;
+  return true;
+}
+
+// Returns whether `ParseExampleV2` can parse a batch of serialized examples
+// at once. This is the case if each element is a single example and the
+// op produces only dense outputs of a fixed shape.
+bool VectorizeParseExample(const NodeDef& node,
+                           const std::vector<TensorInfo>& inputs) {
+  if (inputs.size() < 2 || !inputs[0].batched || inputs[0].rank != 0) {
+    return false;
+  }
+  for (int i = 1; i < inputs.size(); ++i) {
+    if (inputs[i].batched) return false;
+  }
+  // `names` must be empty, since its shape must otherwise match the shape of
+  // `serialized`.
+  if (inputs[1].rank != 1) return false;
+  int64_t num_sparse;
+  std::vector<DataType> ragged_value_types;
+  std::vector<PartialTensorShape> dense_shapes;
+  if (!GetNodeAttr(node, "num_sparse", &num_sparse).ok() || num_sparse != 0 ||
+      !GetNodeAttr(node, "ragged_value_types", &ragged_value_types).ok() ||
+      !ragged_value_types.empty() ||
+      !GetNodeAttr(node, "dense_shapes", &dense_shapes).ok()) {
+    return false;
+  }
+  for (const auto& shape : dense_shapes) {
+    if (!shape.IsFullyDefined()) return false;
+  }
+  return true;
+}
+
+// Returns the per-element rank of the output of a node that does not depend
+// on the input element.
+int UnbatchedRank(const NodeDef& node, const std::vector<TensorInfo>& inputs) {
+  if (node.op() == "Const") {
+    const auto& shape = node.attr().at("value").tensor().tensor_shape();
+    return shape.unknown_rank() ? kUnknownRank : shape.dim_size();
+  }
+  if (VectorizationRules().contains(node.op()) &&
+      node.op() != "DecodeCSV") {
+    int rank = 0;
+    for (const auto& input : inputs) {
+      if (input.rank == kUnknownRank) return kUnknownRank;
+      rank = std::max(rank, input.rank);
+    }
+    return rank;
+  }
+  return kUnknownRank;
+}
+
+// Returns whether applying the ops of `function` to the batched tensors is
+// equivalent to applying `function` to each element of the batch.
+// `element_ranks` holds the ranks of the components of the input element,
+// which are the leading arguments of the function. The remaining arguments
+// are captured inputs.
+bool CanVectorize(const FunctionDef& function,
+                  const std::vector<int>& element_ranks) {
+  absl::flat_hash_map<string, TensorInfo> infos;
+  const auto& args = function.signature().input_arg();
+  for (int i = 0; i < args.size(); ++i) {
+    TensorInfo& info = infos[args[i].name()];
+    if (i < element_ranks.size()) {
+      info.batched = true;
+      info.rank = element_ranks[i];
+    }
+  }
+
+  // The nodes of a function are not necessarily sorted topologically, so
+  // visit them until every node has been visited.
+  std::vector<const NodeDef*> pending;
+  for (const NodeDef& node : function.node_def()) {
+    pending.push_back(&node);
+  }
+  while (!pending.empty()) {
+    std::vector<const NodeDef*> blocked;
+    for (const NodeDef* node : pending) {
+      std::vector<TensorInfo> inputs;
+      bool ready = true;
+      for (const string& input : node->input()) {
+        if (IsControlInput(input)) continue;
+        auto it =
+            infos.find(function_utils::FunctionDefTensorDesc(input).node_name);
+        if (it == infos.end()) {
+          ready = false;
+          break;
+        }
+        inputs.push_back(it->second);
+      }
+      if (!ready) {
+        blocked.push_back(node);
+        continue;
+      }
+      TensorInfo output;
+      if (std::none_of(inputs.begin(), inputs.end(),
+                       [](const TensorInfo& info) { return info.batched; })) {
+        // The node computes the same value for every element, so it can
+        // compute it once for the whole batch.
+        output.rank = UnbatchedRank(*node, inputs);
+      } else if (node->op() == kParseExampleV2) {
+        if (!VectorizeParseExample(*node, inputs)) return false;
+        output.batched = true;
+      } else {
+        auto it = VectorizationRules().find(node->op());
+        if (it == VectorizationRules().end() ||
+            !VectorizeElementwise(inputs, it->second, &output)) {
+          VLOG(2) << "Cannot vectorize node " << node->name() << " of function "
+                  << function.signature().name();
+          return false;
+        }
+      }
+      infos[node->name()] = output;
+    }
+    if (blocked.size() == pending.size()) {
+      // The remaining nodes have inputs that are not defined in the function.
+      return false;
+    }
+    pending = std::move(blocked);
+  }
+
+  // Every output must have a batch dimension.
+  for (const auto& ret : function.ret()) {
+    auto it =
+        infos.find(function_utils::FunctionDefTensorDesc(ret.second).node_name);
+    if (it == infos.end() || !it->second.batched) return false;
+  }
+  return true;
+}
+
+// Returns a function that applies the map function of `map_node` to each
+// element of a batch in a `MapDefun` loop.
+FunctionDef MakeMapDefunFunction(const NodeDef& map_node,
+                                 const DataTypeVector& element_types,
+                                 const DataTypeVector& captured_types) {
+  FunctionDef function;
+  std::vector<string> inputs;
+  for (int i = 0; i < element_types.size(); ++i) {
+    inputs.push_back(absl::StrCat("args_", i));
+    function_utils::AddFunctionInput(inputs.back(), &function,
+                                     element_types[i]);
+  }
+  for (int i = 0; i < captured_types.size(); ++i) {
+    inputs.push_back(absl::StrCat("captured_args_", i));
+    function_utils::AddFunctionInput(inputs.back(), &function,
+                                     captured_types[i]);
+  }
+  std::vector<std::pair<string, AttrValue>> attrs(6);
+  attrs[0].first = "Targuments";
+  SetAttrValue(element_types, &attrs[0].second);
+  attrs[1].first = "Tcaptured";
+  SetAttrValue(captured_types, &attrs[1].second);
+  attrs[2] = {"output_types", map_node.attr().at("output_types")};
+  attrs[3] = {"output_shapes", map_node.attr().at("output_shapes")};
+  attrs[4] = {"f", map_node.attr().at("f")};
+  attrs[5].first = "max_intra_op_parallelism";
+  SetAttrValue(1, &attrs[5].second);
+  NodeDef* map_defun =
+      function_utils::AddNode("map_defun", kMapDefun, inputs, attrs, &function);
+  const auto& output_types = map_node.attr().at("output_types").list().type();
+  for (int i = 0; i < output_types.size(); ++i) {
+    function_utils::AddFunctionOutputWithUniqueName(
+        "output", absl::StrCat(map_defun->name(), ":output:", i), &function,
+        static_cast<DataType>(output_types[i]));
+  }
+  return function;
+}
+
+// An argument of the branches of the `ChooseFastestBranchDataset`.
+struct BranchArgument {
+  // The name of the argument in the branch functions.
+  string name;
+  DataType type;
+  // The input of the `ChooseFastestBranchDataset` node that feeds it.
+  string input;
+};
+
+// Returns the arguments of the map and batch datasets, other than their input
+// datasets.
+std::vector<BranchArgument> GetBranchArguments(const NodeDef& map_node,
+                                               const NodeDef& batch_node) {
+  std::vector<BranchArgument> arguments;
+  const auto& captured_types = map_node.attr().at("Targuments").list().type();
+  for (int i = 0; i < captured_types.size(); ++i) {
+    arguments.push_back({absl::StrCat("captured_args_", i),
+                         static_cast<DataType>(captured_types[i]),
+                         map_node.input(i + 1)});
+  }
+  if (IsParallelMap(map_node)) {
+    arguments.push_back(
+        {"num_parallel_calls",
+         map_node.op() == kParallelMapDataset ? DT_INT32 : DT_INT64,
+         map_node.input(captured_types.size() + 1)});
+  }
+  arguments.push_back({"batch_size", DT_INT64, batch_node.input(1)});
+  if (batch_node.op() == kBatchDatasetV2) {
+    arguments.push_back({"drop_remainder", DT_BOOL, batch_node.input(2)});
+  }
+  return arguments;
+}
+
+// Returns a branch function that applies `map_node` and `batch_node` to its
+// input dataset, batching first if `batch_first` is true.
+FunctionDef MakeBranchFunction(const NodeDef& map_node,
+                               const NodeDef& batch_node, bool batch_first,
+                               const std::vector<BranchArgument>& arguments) {
+  FunctionDef function;
+  function_utils::AddFunctionInput("input_dataset", &function, DT_VARIANT);
+  for (const auto& argument : arguments) {
+    function_utils::AddFunctionInput(argument.name, &function, argument.type);
+  }
+  auto add_map = [&](const string& input) {
+    std::vector<string> inputs = {input};
+    for (const auto& argument : arguments) {
+      if (argument.name != "batch_size" && argument.name != "drop_remainder") {
+        inputs.push_back(argument.name);
+      }
+    }
+    std::vector<std::pair<string, AttrValue>> attrs(map_node.attr().begin(),
+                                                    map_node.attr().end());
+    return function_utils::AddNode("map", map_node.op(), inputs, attrs,
+                                   &function);
+  };
+  auto add_batch = [&](const string& input) {
+    std::vector<string> inputs = {input, "batch_size"};
+    if (batch_node.op() == kBatchDatasetV2) {
+      inputs.push_back("drop_remainder");
+    }
+    std::vector<std::pair<string, AttrValue>> attrs(batch_node.attr().begin(),
+                                                    batch_node.attr().end());
+    return function_utils::AddNode("batch", batch_node.op(), inputs, attrs,
+                                   &function);
+  };
+  NodeDef* output;
+  if (batch_first) {
+    NodeDef* batch = add_batch("input_dataset");
+    output = add_map(absl::StrCat(batch->name(), ":handle:0"));
+  } else {
+    NodeDef* map = add_map("input_dataset");
+    output = add_batch(absl::StrCat(map->name(), ":handle:0"));
+  }
+  function_utils::AddFunctionOutputWithUniqueName(
+      "handle", absl::StrCat(output->name(), ":handle:0"), &function,
+      DT_VARIANT);
+  return function;
+}
+
+// Rewrites `batch(map(input, f))` into a `ChooseFastestBranchDataset` that
+// picks between the original pipeline and `map(batch(input), g)`, where `g`
+// applies `f` to a batch. Returns false if the rewrite does not apply.
+bool Vectorize(const NodeDef& map_node, const NodeDef& batch_node,
+               const FunctionLibraryDefinition& function_library,
+               MutableGraphView* graph, NodeDef* choose_fastest_node) {
+  const FunctionDef* function =
+      function_library.Find(map_node.attr().at("f").func().name());
+  if (function == nullptr ||
+      function_utils::IsFunctionStateful(function_library, *function)) {
+    return false;
+  }
+
+  // Batching the input elements requires them to have the same shape.
+  const NodeDef* input_node = graph_utils::GetInputNode(map_node, *graph);
+  DataTypeVector element_types;
+  std::vector<PartialTensorShape> element_shapes;
+  if (input_node == nullptr ||
+      !GetNodeAttr(*input_node, "output_types", &element_types).ok() ||
+      !GetNodeAttr(*input_node, "output_shapes", &element_shapes).ok() ||
+      element_types.size() != element_shapes.size()) {
+    return false;
+  }
+  std::vector<int> element_ranks;
+  for (int i = 0; i < element_types.size(); ++i) {
+    if (!DataTypeCanUseMemcpy(element_types[i]) &&
+        element_types[i] != DT_STRING) {
+      return false;
+    }
+    if (!element_shapes[i].IsFullyDefined()) return false;
+    element_ranks.push_back(element_shapes[i].dims());
+  }
+
+  DataTypeVector captured_types;
+  if (!GetNodeAttr(map_node, "Targuments", &captured_types).ok() ||
+      function->signature().input_arg_size() !=
+          element_types.size() + captured_types.size()) {
+    return false;
+  }
+
+  FunctionDefLibrary* library = graph->graph()->mutable_library();
+  FunctionDef vectorized_function;
+  if (CanVectorize(*function, element_ranks)) {
+    vectorized_function = *function;
+    graph_utils::SetUniqueGraphFunctionName(
+        absl::StrCat(function->signature().name(), "_vectorized"), library,
+        &vectorized_function);
+  } else {
+    vectorized_function =
+        MakeMapDefunFunction(map_node, element_types, captured_types);
+    graph_utils::SetUniqueGraphFunctionName(
+        absl::StrCat(function->signature().name(), "_map_defun"), library,
+        &vectorized_function);
+  }
+  *library->add_function() = vectorized_function;
+
+  // The map in the vectorized branch consumes batches and produces the output
+  // of the batch dataset.
+  NodeDef vectorized_map_node = map_node;
+  auto* f = (*vectorized_map_node.mutable_attr())["f"].mutable_func();
+  f->set_name(vectorized_function.signature().name());
+  graph_utils::CopyShapesAndTypesAttrs(batch_node, &vectorized_map_node);
+
+  NodeDef input_batch_node = batch_node;
+  std::vector<PartialTensorShape> output_shapes;
+  int64_t batch_dim = -1;
+  if (GetNodeAttr(batch_node, "output_shapes", &output_shapes).ok() &&
+      !output_shapes.empty() && output_shapes[0].dims() > 0) {
+    batch_dim = output_shapes[0].dim_size(0);
+  }
+  std::vector<PartialTensorShape> batched_shapes;
+  for (const auto& shape : element_shapes) {
+    batched_shapes.push_back(
+        PartialTensorShape({batch_dim}).Concatenate(shape));
+  }
+  SetAttrValue(element_types,
+               &(*input_batch_node.mutable_attr())["output_types"]);
+  SetAttrValue(batched_shapes,
+               &(*input_batch_node.mutable_attr())["output_shapes"]);
+
+  const std::vector<BranchArgument> arguments =
+      GetBranchArguments(map_node, batch_node);
+  std::vector<NameAttrList> branches(2);
+  FunctionDef original_branch =
+      MakeBranchFunction(map_node, batch_node, /*batch_first=*/false,
+                         arguments);
+  graph_utils::SetUniqueGraphFunctionName("map_vectorization_original_branch",
+                                          library, &original_branch);
+  branches[0].set_name(original_branch.signature().name());
+  *library->add_function() = std::move(original_branch);
+  FunctionDef vectorized_branch =
+      MakeBranchFunction(vectorized_map_node, input_batch_node,
+                         /*batch_first=*/true, arguments);
+  graph_utils::SetUniqueGraphFunctionName(
+      "map_vectorization_vectorized_branch", library, &vectorized_branch);
+  branches[1].set_name(vectorized_branch.signature().name());
+  *library->add_function() = std::move(vectorized_branch);
+
+  // Both branches consume `batch_size` input elements per output element.
+  choose_fastest_node->set_op(kChooseFastestBranchDataset);
+  graph_utils::SetUniqueGraphNodeName(kChooseFastestBranchDataset,
+                                      graph->graph(), choose_fastest_node);
+  choose_fastest_node->add_input(map_node.input(0));
+  choose_fastest_node->add_input(batch_node.input(1));
+  choose_fastest_node->add_input(
+      graph_utils::AddScalarConstNode<int64_t>(1, graph)->name());
+  DataTypeVector argument_types;
+  for (int i = 0; i < branches.size(); ++i) {
+    for (const auto& argument : arguments) {
+      choose_fastest_node->add_input(argument.input);
+      argument_types.push_back(argument.type);
+    }
+  }
+  auto* attrs = choose_fastest_node->mutable_attr();
+  SetAttrValue(argument_types, &(*attrs)["Targuments"]);
+  SetAttrValue(kNumElementsPerBranch, &(*attrs)["num_elements_per_branch"]);
+  SetAttrValue(branches, &(*attrs)["branches"]);
+  SetAttrValue(std::vector<int64_t>(branches.size(), arguments.size()),
+               &(*attrs)["other_arguments_lengths"]);
+  graph_utils::CopyShapesAndTypesAttrs(batch_node, choose_fastest_node);
+  graph_utils::MaybeSetFusedMetadata(map_node, batch_node,
+                                     choose_fastest_node);
+  return true;
+}
+
+}  // namespace
+
+Status MapVectorization::OptimizeAndCollectStats(Cluster* cluster,
+                                                 const GrapplerItem& item,
+                                                 GraphDef* output,
+                                                 OptimizationStats* stats) {
+  *output = item.graph;
+  MutableGraphView graph(output);
+
+  // The branches of the rewritten pipelines contain the original map and
+  // batch, so functions are not optimized.
+  if (graph_utils::IsItemDerivedFromFunctionDef(item, graph)) {
+    return Status::OK();
+  }
+
+  absl::flat_hash_set<string> nodes_to_delete;
+  FunctionLibraryDefinition function_library(OpRegistry::Global(),
+                                             item.graph.library());
+  for (const NodeDef& node : item.graph.node()) {
+    if (node.op() != kBatchDataset && node.op() != kBatchDatasetV2) {
+      continue;
+    }
+    const NodeDef& batch_node = node;
+    NodeDef* map_node = graph_utils::GetInputNode(batch_node, graph);
+    if (map_node == nullptr || !IsMap(*map_node) ||
+        graph.GetFanouts(*map_node, /*include_controlled_nodes=*/true)
+                .size() != 1) {
+      continue;
+    }
+
+    NodeDef choose_fastest_node;
+    if (!Vectorize(*map_node, batch_node, function_library, &graph,
+                   &choose_fastest_node)) {
+      continue;
+    }
+    NodeDef* new_node = graph.AddNode(std::move(choose_fastest_node));
+    TF_RETURN_IF_ERROR(
+        graph.UpdateFanouts(batch_node.name(), new_node->name()));
+    nodes_to_delete.insert(map_node->name());
+    nodes_to_delete.insert(batch_node.name());
+    stats->num_changes++;
+  }
+
+  TF_RETURN_IF_ERROR(graph.DeleteNodes(nodes_to_delete));
+  return Status::OK();
+}
+
+REGISTER_GRAPH_OPTIMIZER_AS(MapVectorization, "map_vectorization");
+
+}  // namespace grappler
+}  // namespace tensorflow
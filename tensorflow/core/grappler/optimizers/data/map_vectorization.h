@@ -0,0 +1,61 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_DATA_MAP_VECTORIZATION_H_
+#define TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_DATA_MAP_VECTORIZATION_H_
+
+#include "tensorflow/core/grappler/optimizers/data/optimizer_base.h"
+
+namespace tensorflow {
+namespace grappler {
+
+// This optimization reorders `map(f) -> batch` into `batch -> map(g)`, where
+// `g` applies `f` to a whole batch at once. If every op of `f` that consumes
+// the input element is elementwise (e.g. cwise math, string and decode ops) or
+// batches naturally (e.g. `ParseExampleV2`), `g` runs the ops of `f` on the
+// batched tensors directly. Otherwise (e.g. for image decoding), `g` runs `f`
+// on each element of the batch in a `MapDefun` loop.
+//
+// Whether `g` is faster than `f` depends on the function and on the size of
+// the elements, so both orderings are kept as branches of a
+// `ChooseFastestBranchDataset`, which measures them at runtime and falls back
+// to the per-element map when vectorization does not pay off.
+//
+// The optimization applies only to stateless functions whose input element
+// has a fully defined shape, so that the elements can be batched before the
+// function is applied.
+class MapVectorization : public TFDataOptimizerBase {
+ public:
+  MapVectorization() = default;
+  ~MapVectorization() override = default;
+
+  string name() const override { return "map_vectorization"; };
+
+  bool UsesFunctionLibrary() const override { return false; }
+
+  Status Init(
+      const tensorflow::RewriterConfig_CustomGraphOptimizer* config) override {
+    return Status::OK();
+  }
+
+  Status OptimizeAndCollectStats(Cluster* cluster, const GrapplerItem& item,
+                                 GraphDef* output,
+                                 OptimizationStats* stats) override;
+};
+
+}  // namespace grappler
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_DATA_MAP_VECTORIZATION_H_
@@ -0,0 +1,216 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/optimizers/data/map_vectorization.h"
+
+#include <vector>
+
+#include "tensorflow/core/framework/attr_value_util.h"
+#include "tensorflow/core/framework/function_testlib.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/optimizers/data/function_utils.h"
+#include "tensorflow/core/grappler/optimizers/data/graph_utils.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace {
+
+using test::function::NDef;
+
+// Returns `range -> map(function_name) -> batch(5)`, where the elements of
+// the range have the given shape.
+GrapplerItem MakeMapBatchItem(const string& function_name,
+                              const PartialTensorShape& element_shape,
+                              const FunctionDef& function) {
+  std::vector<FunctionDef> library = {function};
+  if (function_name != "XTimesTwo") {
+    library.push_back(test::function::XTimesTwo());
+  }
+  GrapplerItem item;
+  item.graph = test::function::GDef(
+      {NDef("start", "Const", {}, {{"value", 0}, {"dtype", DT_INT64}}),
+       NDef("stop", "Const", {}, {{"value", 10}, {"dtype", DT_INT64}}),
+       NDef("step", "Const", {}, {{"value", 1}, {"dtype", DT_INT64}}),
+       NDef("range", "RangeDataset", {"start", "stop", "step"},
+            {{"output_shapes", gtl::ArraySlice<PartialTensorShape>{
+                                   element_shape}},
+             {"output_types", gtl::ArraySlice<DataType>{DT_INT64}}}),
+       NDef("map", "MapDataset", {"range"},
+            {{"f", FunctionDefHelper::FunctionRef(function_name,
+                                                  {{"T", DT_INT64}})},
+             {"Targuments", gtl::ArraySlice<DataType>{}},
+             {"output_shapes", gtl::ArraySlice<PartialTensorShape>{
+                                   PartialTensorShape({})}},
+             {"output_types", gtl::ArraySlice<DataType>{DT_INT64}}}),
+       NDef("batch_size", "Const", {},
+            {{"value", int64_t{5}}, {"dtype", DT_INT64}}),
+       NDef("drop_remainder", "Const", {},
+            {{"value", false}, {"dtype", DT_BOOL}}),
+       NDef("batch", "BatchDatasetV2", {"map", "batch_size", "drop_remainder"},
+            {{"parallel_copy", false},
+             {"output_shapes", gtl::ArraySlice<PartialTensorShape>{
+                                   PartialTensorShape({-1})}},
+             {"output_types", gtl::ArraySlice<DataType>{DT_INT64}}}),
+       NDef("Sink", "Identity", {"batch"}, {})},
+      library);
+  item.fetch.push_back("Sink");
+  return item;
+}
+
+// Returns the function that the map in the vectorized branch applies.
+const FunctionDef* GetVectorizedFunction(const GraphDef& graph) {
+  const NodeDef& node = graph.node(
+      graph_utils::FindGraphNodeWithOp("ChooseFastestBranchDataset", graph));
+  const string& branch_name =
+      node.attr().at("branches").list().func(1).name();
+  const FunctionDef& branch = graph.library().function(
+      graph_utils::FindGraphFunctionWithName(branch_name, graph.library()));
+  const NodeDef& map = branch.node_def(
+      function_utils::FindFunctionNodeWithOp("MapDataset", branch));
+  int index = graph_utils::FindGraphFunctionWithName(
+      map.attr().at("f").func().name(), graph.library());
+  return index == -1 ? nullptr : &graph.library().function(index);
+}
+
+TEST(MapVectorizationTest, VectorizeElementwiseFunction) {
+  GrapplerItem item = MakeMapBatchItem("XTimesTwo", PartialTensorShape({}),
+                                       test::function::XTimesTwo());
+  MapVectorization optimizer;
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  EXPECT_FALSE(graph_utils::ContainsGraphNodeWithName("map", output));
+  EXPECT_FALSE(graph_utils::ContainsGraphNodeWithName("batch", output));
+  ASSERT_TRUE(
+      graph_utils::ContainsNodeWithOp("ChooseFastestBranchDataset", output));
+  const NodeDef& choose_fastest = output.node(graph_utils::FindGraphNodeWithOp(
+      "ChooseFastestBranchDataset", output));
+  EXPECT_EQ(choose_fastest.input(0), "range");
+  EXPECT_EQ(choose_fastest.input(1), "batch_size");
+  EXPECT_EQ(choose_fastest.attr().at("branches").list().func_size(), 2);
+  EXPECT_EQ(choose_fastest.attr().at("other_arguments_lengths").list().i(0),
+            2);
+  EXPECT_TRUE(AreAttrValuesEqual(
+      choose_fastest.attr().at("output_shapes"),
+      item.graph.node(graph_utils::FindGraphNodeWithName("batch", item.graph))
+          .attr()
+          .at("output_shapes")));
+
+  const FunctionDef* vectorized = GetVectorizedFunction(output);
+  ASSERT_NE(vectorized, nullptr);
+  EXPECT_EQ(vectorized->signature().name(), "XTimesTwo_vectorized");
+  EXPECT_FALSE(function_utils::ContainsFunctionNodeWithOp("MapDefun",
+                                                          *vectorized));
+}
+
+TEST(MapVectorizationTest, FallBackToMapDefun) {
+  // Reducing each element is not elementwise, so it is applied to each
+  // element of the batch in a loop.
+  FunctionDef function = FunctionDefHelper::Create(
+      "SumElement", {"x: int64"}, {"y: int64"}, {},
+      {{{"axis"}, "Const", {}, {{"value", 0}, {"dtype", DT_INT32}}},
+       {{"y"},
+        "Sum",
+        {"x", "axis:output:0"},
+        {{"T", DT_INT64}, {"Tidx", DT_INT32}, {"keep_dims", false}}}},
+      {{"y", "y:output:0"}});
+  GrapplerItem item =
+      MakeMapBatchItem("SumElement", PartialTensorShape({3}), function);
+  MapVectorization optimizer;
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  ASSERT_TRUE(
+      graph_utils::ContainsNodeWithOp("ChooseFastestBranchDataset", output));
+  const FunctionDef* vectorized = GetVectorizedFunction(output);
+  ASSERT_NE(vectorized, nullptr);
+  EXPECT_TRUE(
+      function_utils::ContainsFunctionNodeWithOp("MapDefun", *vectorized));
+}
+
+TEST(MapVectorizationTest, FallBackToMapDefunOnIncompatibleBroadcast) {
+  // Adding a vector to each scalar element produces a vector per element,
+  // but adding it to a batch of scalars does not broadcast the same way.
+  FunctionDef function = FunctionDefHelper::Create(
+      "AddVector", {"x: int64"}, {"y: int64"}, {},
+      {{{"c"},
+        "Const",
+        {},
+        {{"value", test::AsTensor<int64_t>({1, 2, 3})}, {"dtype", DT_INT64}}},
+       {{"y"}, "AddV2", {"x", "c:output:0"}, {{"T", DT_INT64}}}},
+      {{"y", "y:z:0"}});
+  GrapplerItem item =
+      MakeMapBatchItem("AddVector", PartialTensorShape({}), function);
+  MapVectorization optimizer;
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  const FunctionDef* vectorized = GetVectorizedFunction(output);
+  ASSERT_NE(vectorized, nullptr);
+  EXPECT_TRUE(
+      function_utils::ContainsFunctionNodeWithOp("MapDefun", *vectorized));
+}
+
+TEST(MapVectorizationTest, VectorizeBroadcastAgainstLowerRank) {
+  FunctionDef function = FunctionDefHelper::Create(
+      "AddVector", {"x: int64"}, {"y: int64"}, {},
+      {{{"c"},
+        "Const",
+        {},
+        {{"value", test::AsTensor<int64_t>({1, 2, 3})}, {"dtype", DT_INT64}}},
+       {{"y"}, "AddV2", {"x", "c:output:0"}, {{"T", DT_INT64}}}},
+      {{"y", "y:z:0"}});
+  GrapplerItem item =
+      MakeMapBatchItem("AddVector", PartialTensorShape({3}), function);
+  MapVectorization optimizer;
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  const FunctionDef* vectorized = GetVectorizedFunction(output);
+  ASSERT_NE(vectorized, nullptr);
+  EXPECT_FALSE(
+      function_utils::ContainsFunctionNodeWithOp("MapDefun", *vectorized));
+}
+
+TEST(MapVectorizationTest, StatefulFunctionIsNotVectorized) {
+  GrapplerItem item =
+      MakeMapBatchItem("RandomUniformFn", PartialTensorShape({}),
+                       test::function::RandomUniform());
+  MapVectorization optimizer;
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+  EXPECT_TRUE(graph_utils::ContainsGraphNodeWithName("map", output));
+  EXPECT_TRUE(graph_utils::ContainsGraphNodeWithName("batch", output));
+  EXPECT_FALSE(
+      graph_utils::ContainsNodeWithOp("ChooseFastestBranchDataset", output));
+}
+
+TEST(MapVectorizationTest, UnknownElementShapeIsNotVectorized) {
+  GrapplerItem item = MakeMapBatchItem(
+      "XTimesTwo", PartialTensorShape({-1}), test::function::XTimesTwo());
+  MapVectorization optimizer;
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+  EXPECT_TRUE(graph_utils::ContainsGraphNodeWithName("map", output));
+  EXPECT_FALSE(
+      graph_utils::ContainsNodeWithOp("ChooseFastestBranchDataset", output));
+}
+
+}  // namespace
+}  // namespace grappler
+}  // namespace tensorflow
@@ -36,7 +36,7 @@ using ConfigMap =
     std::map<string, tensorflow::RewriterConfig_CustomGraphOptimizer>;
 
 // tf.data optimizations, in the order we want to perform them.
-constexpr std::array<const char*, 18> kTFDataOptimizations = {
+constexpr std::array<const char*, 19> kTFDataOptimizations = {
     "noop_elimination",
     "disable_intra_op_parallelism",
     "use_private_thread_pool",
@@ -45,6 +45,7 @@ constexpr std::array<const char*, 18> kTFDataOptimizations = {
     "filter_fusion",
     "map_and_filter_fusion",
     "map_parallelization",
+    "map_vectorization",
     "map_and_batch_fusion",
     "batch_parallelization",
     "make_sloppy",
@@ -20,6 +20,7 @@ limitations under the License.
 #include "tensorflow/core/data/dataset_utils.h"
 #include "tensorflow/core/data/name_utils.h"
 #include "tensorflow/core/data/serialization_utils.h"
+#include "tensorflow/core/framework/allocator.h"
 #include "tensorflow/core/framework/partial_tensor_shape.h"
 #include "tensorflow/core/framework/resource_mgr.h"
 #include "tensorflow/core/framework/tensor.h"
@@ -28,6 +29,7 @@ limitations under the License.
 #include "tensorflow/core/lib/strings/stringprintf.h"
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/util/env_var.h"
 #include "tensorflow/core/util/tensor_bundle/tensor_bundle.h"
 
 namespace tensorflow {
@@ -66,6 +68,33 @@ constexpr char kIncompleteCacheErrorMessage[] =
     "an input pipeline similar to `dataset.cache().take(k).repeat()`. You "
     "should use `dataset.take(k).cache().repeat()` instead.";
 
+// Returns true if file caches should be read from memory-mapped cache files,
+// so that the cached tensors alias the OS page cache instead of being copied.
+// The pages are shared by all processes reading the same cache file.
+bool MemoryMapFileCache() {
+  static bool memory_map = [] {
+    bool value = false;
+    Status s = ReadBoolFromEnvVar("TF_DATA_MEMORY_MAP_FILE_CACHE",
+                                  /*default_val=*/false, &value);
+    if (!s.ok()) {
+      LOG(ERROR) << "Invalid TF_DATA_MEMORY_MAP_FILE_CACHE: " << s;
+      return false;
+    }
+    return value;
+  }();
+  return memory_map;
+}
+
+// Returns the options of the writers of file caches. Tensors are aligned in
+// memory-mapped cache files so that they can be read without copying.
+BundleWriter::Options FileCacheWriterOptions() {
+  BundleWriter::Options options;
+  if (MemoryMapFileCache()) {
+    options.data_alignment = Allocator::kAllocatorAlignment;
+  }
+  return options;
+}
+
 }  // namespace
 
 class CacheDatasetOp::FileDatasetBase : public DatasetBase {
@@ -375,7 +404,8 @@ class CacheDatasetOp::FileDatasetBase : public DatasetBase {
         }
         filename_ = strings::StrCat(dataset()->filename_, "_", shard_id_);
         lockfile_ = strings::StrCat(filename_, kLockFileSuffix);
-        writer_ = absl::make_unique<BundleWriter>(dataset()->env_, filename_);
+        writer_ = absl::make_unique<BundleWriter>(
+            dataset()->env_, filename_, FileCacheWriterOptions());
         return Status::OK();
       }
 
@@ -437,7 +467,8 @@ class CacheDatasetOp::FileDatasetBase : public DatasetBase {
         // conditions are not met since BundleWriter's constructor creates
         // new temp files which can delete the temp files created by a
         // BundleWriter in another Session.
-        writer_ = absl::make_unique<BundleWriter>(dataset()->env_, filename_);
+        writer_ = absl::make_unique<BundleWriter>(
+            dataset()->env_, filename_, FileCacheWriterOptions());
         lockfile_created_ = true;
         return Status::OK();
       }
@@ -523,7 +554,11 @@ class CacheDatasetOp::FileDatasetBase : public DatasetBase {
           }
           StringPiece key = reader_.key();
           DCHECK_EQ(key, dataset()->FormatName(cur_index_, i));
-          TF_RETURN_IF_ERROR(reader_.ReadCurrent(&(*out_tensors)[i]));
+          if (MemoryMapFileCache()) {
+            TF_RETURN_IF_ERROR(reader_.ReadCurrentMapped(&(*out_tensors)[i]));
+          } else {
+            TF_RETURN_IF_ERROR(reader_.ReadCurrent(&(*out_tensors)[i]));
+          }
           TF_RETURN_IF_ERROR(reader_.status());
         }
         cur_index_++;
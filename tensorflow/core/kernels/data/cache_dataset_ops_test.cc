@@ -17,6 +17,8 @@ limitations under the License.
 #include "tensorflow/core/data/dataset_test_base.h"
 #include "tensorflow/core/data/dataset_utils.h"
 #include "tensorflow/core/data/serialization_utils.h"
+#include "tensorflow/core/framework/tensor_description.pb.h"
+#include "tensorflow/core/kernels/data/cache_ops.h"
 #include "tensorflow/core/platform/path.h"
 
 namespace tensorflow {
@@ -370,6 +372,37 @@ INSTANTIATE_TEST_CASE_P(CacheDatasetOpTest,
                         ParameterizedIteratorSaveAndRestoreTest,
                         ::testing::ValuesIn(IteratorSaveAndRestoreTestCases()));
 
+TEST(MemoryCacheTest, MapCompletedCache) {
+  const string map_directory =
+      io::JoinPath(testing::TmpDir(), "mapped_memory_cache");
+  MemoryCache cache(map_directory);
+  std::vector<std::vector<Tensor>> elements;
+  for (int64_t i = 0; i < 3; ++i) {
+    elements.push_back(
+        {CreateTensor<int64_t>(TensorShape({2}), {i, i + 1}),
+         CreateTensor<tstring>(TensorShape({}), {strings::StrCat("s", i)})});
+  }
+  std::vector<std::vector<Tensor>> expected = elements;
+  cache.Complete(std::move(elements));
+  ASSERT_TRUE(cache.IsCompleted());
+  ASSERT_EQ(cache.size(), expected.size());
+  for (size_t i = 0; i < expected.size(); ++i) {
+    const std::vector<Tensor>& element = cache.at(i);
+    ASSERT_EQ(element.size(), 2);
+    test::ExpectTensorEqual<int64_t>(element[0], expected[i][0]);
+    test::ExpectTensorEqual<tstring>(element[1], expected[i][1]);
+    // Numeric tensors alias the mapped bundle; strings are copied.
+    TensorDescription description;
+    element[0].FillDescription(&description);
+    EXPECT_EQ(description.allocation_description().allocator_name(),
+              "MappedTensorBundle");
+  }
+  // The bundle files are deleted once they have been mapped.
+  std::vector<string> children;
+  TF_ASSERT_OK(Env::Default()->GetChildren(map_directory, &children));
+  EXPECT_TRUE(children.empty());
+}
+
 }  // namespace
 }  // namespace data
 }  // namespace tensorflow
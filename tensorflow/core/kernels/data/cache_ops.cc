@@ -15,27 +15,112 @@ limitations under the License.
 #include "tensorflow/core/kernels/data/cache_ops.h"
 
 #include "tensorflow/core/data/dataset_utils.h"
+#include "tensorflow/core/framework/allocator.h"
 #include "tensorflow/core/framework/dataset.h"
 #include "tensorflow/core/framework/partial_tensor_shape.h"
 #include "tensorflow/core/framework/resource_mgr.h"
 #include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/gtl/cleanup.h"
 #include "tensorflow/core/lib/random/philox_random.h"
 #include "tensorflow/core/lib/random/random.h"
 #include "tensorflow/core/lib/random/random_distributions.h"
+#include "tensorflow/core/lib/strings/stringprintf.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/path.h"
+#include "tensorflow/core/util/env_var.h"
+#include "tensorflow/core/util/tensor_bundle/tensor_bundle.h"
 
 namespace tensorflow {
 namespace data {
 namespace {
 
 constexpr char kMemoryCache[] = "MemoryCache";
+constexpr char kMappedBundlePrefix[] = "memory_cache_";
+
+string MappedTensorKey(size_t element_index, size_t tensor_index) {
+  return strings::Printf("%020zu_%010zu", element_index, tensor_index);
+}
+
+// Writes `elements` to a tensor bundle with aligned tensors in `directory` and
+// replaces them with tensors that alias a read-only memory mapping of the
+// bundle. The bundle files are deleted once they are mapped; the mapping stays
+// alive as long as any of the tensors aliasing it.
+Status MapElements(const string& directory,
+                   std::vector<std::vector<Tensor>>* elements) {
+  Env* env = Env::Default();
+  TF_RETURN_IF_ERROR(env->RecursivelyCreateDir(directory));
+  string prefix = io::JoinPath(directory, kMappedBundlePrefix);
+  if (!env->CreateUniqueFileName(&prefix, "")) {
+    return errors::Internal("Failed to create a unique file name in ",
+                            directory);
+  }
+  auto delete_bundle = gtl::MakeCleanup([env, &prefix] {
+    std::vector<string> files;
+    Status s = env->GetMatchingPaths(strings::StrCat(prefix, "*"), &files);
+    for (const string& file : files) {
+      if (s.ok()) s = env->DeleteFile(file);
+    }
+    if (!s.ok()) {
+      LOG(WARNING) << "Failed to delete memory cache bundle " << prefix << ": "
+                   << s;
+    }
+  });
+
+  BundleWriter::Options options;
+  options.data_alignment = Allocator::kAllocatorAlignment;
+  BundleWriter writer(env, prefix, options);
+  for (size_t i = 0; i < elements->size(); ++i) {
+    for (size_t j = 0; j < (*elements)[i].size(); ++j) {
+      TF_RETURN_IF_ERROR(writer.Add(MappedTensorKey(i, j), (*elements)[i][j]));
+    }
+  }
+  TF_RETURN_IF_ERROR(writer.Finish());
+
+  BundleReader reader(env, prefix);
+  TF_RETURN_IF_ERROR(reader.status());
+  std::vector<std::vector<Tensor>> mapped(elements->size());
+  for (size_t i = 0; i < elements->size(); ++i) {
+    mapped[i].resize((*elements)[i].size());
+    for (size_t j = 0; j < mapped[i].size(); ++j) {
+      const string key = MappedTensorKey(i, j);
+      reader.Seek(key);
+      TF_RETURN_IF_ERROR(reader.status());
+      if (!reader.Valid() || reader.key() != key) {
+        return errors::DataLoss("Missing tensor ", key,
+                                " in memory cache bundle ", prefix);
+      }
+      TF_RETURN_IF_ERROR(reader.ReadCurrentMapped(&mapped[i][j]));
+    }
+  }
+  *elements = std::move(mapped);
+  return Status::OK();
+}
 
 }  // namespace
 
+MemoryCacheManager::MemoryCacheManager() {
+  string map_directory;
+  Status s = ReadStringFromEnvVar("TF_DATA_MEMORY_CACHE_MAP_DIRECTORY",
+                                  /*default_val=*/"", &map_directory);
+  if (!s.ok()) {
+    LOG(ERROR) << "Invalid TF_DATA_MEMORY_CACHE_MAP_DIRECTORY: " << s;
+    map_directory.clear();
+  }
+  cache_ = std::make_shared<MemoryCache>(map_directory);
+}
+
 string MemoryCacheManager::DebugString() const { return kMemoryCache; }
 
 void MemoryCache::Complete(std::vector<std::vector<Tensor>>&& cache) {
   mutex_lock l(mu_);
   if (!completed_) {
+    if (!map_directory_.empty()) {
+      Status s = MapElements(map_directory_, &cache);
+      if (!s.ok()) {
+        LOG(WARNING) << "Keeping the memory cache on the heap, since it "
+                     << "could not be memory-mapped: " << s;
+      }
+    }
     cache_ = std::move(cache);
     completed_ = true;
   }
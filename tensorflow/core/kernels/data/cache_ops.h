@@ -27,9 +27,18 @@ namespace data {
 // The expected use is that a single `MemoryWriterIterator` populates the
 // cache with dataset elements. Once all elements are cached, the cache can
 // be used by one or more `MemoryReaderIterator`s.
+//
+// If the cache is given a `map_directory`, completed caches are written to a
+// tensor bundle in that directory, with tensors aligned to
+// `Allocator::kAllocatorAlignment`, and served from a read-only memory mapping
+// of the bundle, so that the cached tensors alias the OS page cache rather
+// than the heap. Elements that cannot be mapped (e.g. strings) are copied, and
+// the cache stays on the heap if writing fails.
 class MemoryCache {
  public:
   MemoryCache() = default;
+  explicit MemoryCache(const string& map_directory)
+      : map_directory_(map_directory) {}
 
   // Marks the cache as completed.
   void Complete(std::vector<std::vector<Tensor>>&& cache);
@@ -51,6 +60,8 @@ class MemoryCache {
   const std::vector<std::vector<Tensor>>& data();
 
  private:
+  // Directory of the memory-mapped bundles; empty if the cache is not mapped.
+  const string map_directory_;
   mutex mu_;
   // Determines whether all elements of the dataset have been cached.
   bool completed_ TF_GUARDED_BY(mu_) = false;
@@ -60,7 +71,9 @@ class MemoryCache {
 // A resource wrapping a shared instance of a memory cache.
 class MemoryCacheManager : public ResourceBase {
  public:
-  MemoryCacheManager() : cache_(std::make_shared<MemoryCache>()) {}
+  // Memory-maps completed caches under the directory named by the
+  // `TF_DATA_MEMORY_CACHE_MAP_DIRECTORY` environment variable, if set.
+  MemoryCacheManager();
 
   string DebugString() const override;
 
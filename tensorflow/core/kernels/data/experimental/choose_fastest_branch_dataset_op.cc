@@ -244,9 +244,14 @@ class ChooseFastestBranchDatasetOp : public UnaryDatasetOpKernel {
       if (n == kInfiniteCardinality || n == kUnknownCardinality) {
         return n;
       }
-      // TODO(rachelim): this might be wrong if the ratio is not fixed, for
-      // example, from a BatchDataset with drop_remainder = False
-      return static_cast<double>(n) * ratio_numerator_ / ratio_denominator_;
+      // The branches consume `ratio_numerator` input elements for every
+      // `ratio_denominator` output elements. If the input does not divide
+      // evenly, the number of outputs depends on how the branches handle the
+      // remainder (e.g. a BatchDataset with drop_remainder = False).
+      if ((n * ratio_denominator_) % ratio_numerator_ != 0) {
+        return kUnknownCardinality;
+      }
+      return n * ratio_denominator_ / ratio_numerator_;
     }
 
     Status InputDatasets(
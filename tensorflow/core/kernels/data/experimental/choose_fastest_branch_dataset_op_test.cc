@@ -0,0 +1,145 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include <numeric>
+
+#include "tensorflow/core/data/dataset_test_base.h"
+#include "tensorflow/core/framework/function_testlib.h"
+
+namespace tensorflow {
+namespace data {
+namespace experimental {
+namespace {
+
+constexpr char kNodeName[] = "choose_fastest_branch_dataset";
+
+class ChooseFastestBranchDatasetParams : public DatasetParams {
+ public:
+  template <typename T>
+  ChooseFastestBranchDatasetParams(T input_dataset_params,
+                                   int64_t ratio_numerator,
+                                   int64_t ratio_denominator,
+                                   std::vector<Tensor> other_arguments,
+                                   FunctionDefHelper::AttrValueWrapper branch,
+                                   std::vector<FunctionDef> func_lib,
+                                   DataTypeVector type_arguments,
+                                   int64_t num_elements_per_branch,
+                                   DataTypeVector output_dtypes,
+                                   std::vector<PartialTensorShape> output_shapes)
+      : DatasetParams(std::move(output_dtypes), std::move(output_shapes),
+                      kNodeName),
+        ratio_numerator_(ratio_numerator),
+        ratio_denominator_(ratio_denominator),
+        other_arguments_(std::move(other_arguments)),
+        branch_(std::move(branch)),
+        func_lib_(std::move(func_lib)),
+        type_arguments_(std::move(type_arguments)),
+        num_elements_per_branch_(num_elements_per_branch) {
+    input_dataset_params_.push_back(absl::make_unique<T>(input_dataset_params));
+    iterator_prefix_ =
+        name_utils::IteratorPrefix(input_dataset_params.dataset_type(),
+                                   input_dataset_params.iterator_prefix());
+  }
+
+  std::vector<Tensor> GetInputTensors() const override {
+    std::vector<Tensor> input_tensors = {
+        CreateTensor<int64_t>(TensorShape({}), {ratio_numerator_}),
+        CreateTensor<int64_t>(TensorShape({}), {ratio_denominator_})};
+    input_tensors.insert(input_tensors.end(), other_arguments_.begin(),
+                         other_arguments_.end());
+    return input_tensors;
+  }
+
+  Status GetInputNames(std::vector<string>* input_names) const override {
+    *input_names = {"input_dataset", "ratio_numerator", "ratio_denominator"};
+    for (int i = 0; i < other_arguments_.size(); ++i) {
+      input_names->emplace_back(absl::StrCat("other_arguments_", i));
+    }
+    return Status::OK();
+  }
+
+  Status GetAttributes(AttributeVector* attr_vector) const override {
+    *attr_vector = {
+        {"Targuments", type_arguments_},
+        {"num_elements_per_branch", num_elements_per_branch_},
+        {"branches", std::vector<NameAttrList>{branch_.proto.func()}},
+        {"other_arguments_lengths",
+         std::vector<int64_t>{static_cast<int64_t>(other_arguments_.size())}},
+        {"output_types", output_dtypes_},
+        {"output_shapes", output_shapes_}};
+    return Status::OK();
+  }
+
+  string dataset_type() const override { return "ChooseFastestBranch"; }
+
+  std::vector<FunctionDef> func_lib() const override { return func_lib_; }
+
+ private:
+  int64_t ratio_numerator_;
+  int64_t ratio_denominator_;
+  std::vector<Tensor> other_arguments_;
+  FunctionDefHelper::AttrValueWrapper branch_;
+  std::vector<FunctionDef> func_lib_;
+  DataTypeVector type_arguments_;
+  int64_t num_elements_per_branch_;
+};
+
+class ChooseFastestBranchDatasetOpTest : public DatasetOpsTestBase {};
+
+// Batches a dataset of `num_elements` scalars into batches of
+// `ratio_numerator` elements.
+ChooseFastestBranchDatasetParams BatchBranchParams(int64_t num_elements,
+                                                   int64_t ratio_numerator) {
+  std::vector<int64_t> values(num_elements);
+  std::iota(values.begin(), values.end(), 0);
+  auto tensor_slice_dataset_params = TensorSliceDatasetParams(
+      /*components=*/{CreateTensor<int64_t>(TensorShape{num_elements},
+                                            values)},
+      /*node_name=*/"tensor_slice");
+  auto branch = FunctionDefHelper::FunctionRef(
+      /*name=*/"MakeBatchDataset",
+      /*attrs=*/{{"output_types", DataTypeVector({DT_INT64})},
+                 {"output_shapes", std::vector<PartialTensorShape>(
+                                       {PartialTensorShape({-1})})}});
+  return ChooseFastestBranchDatasetParams(
+      std::move(tensor_slice_dataset_params),
+      /*ratio_numerator=*/ratio_numerator,
+      /*ratio_denominator=*/1,
+      /*other_arguments=*/
+      {CreateTensor<int64_t>(TensorShape({}), {ratio_numerator}),
+       CreateTensor<bool>(TensorShape({}), {false})},
+      /*branch=*/branch,
+      /*func_lib=*/{test::function::MakeBatchDataset()},
+      /*type_arguments=*/{DT_INT64, DT_BOOL},
+      /*num_elements_per_branch=*/1,
+      /*output_dtypes=*/{DT_INT64},
+      /*output_shapes=*/{PartialTensorShape({-1})});
+}
+
+std::vector<CardinalityTestCase<ChooseFastestBranchDatasetParams>>
+CardinalityTestCases() {
+  return {// 12 elements in batches of 3 yield 4 outputs.
+          {/*dataset_params=*/BatchBranchParams(12, 3),
+           /*expected_cardinality=*/4},
+          // With 10 elements, whether the partial batch is produced is up to
+          // the branches.
+          {/*dataset_params=*/BatchBranchParams(10, 3),
+           /*expected_cardinality=*/kUnknownCardinality}};
+}
+
+DATASET_CARDINALITY_TEST_P(ChooseFastestBranchDatasetOpTest,
+                           ChooseFastestBranchDatasetParams,
+                           CardinalityTestCases())
+
+}  // namespace
+}  // namespace experimental
+}  // namespace data
+}  // namespace tensorflow
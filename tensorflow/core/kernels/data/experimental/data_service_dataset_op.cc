@@ -15,6 +15,7 @@ limitations under the License.
 #include "tensorflow/core/kernels/data/experimental/data_service_dataset_op.h"
 
 #include <algorithm>
+#include <functional>
 #include <limits>
 #include <map>
 #include <memory>
@@ -60,6 +61,7 @@ limitations under the License.
 #include "tensorflow/core/profiler/lib/traceme_encode.h"
 #include "tensorflow/core/protobuf/data_service.pb.h"
 #include "tensorflow/core/protobuf/error_codes.pb.h"
+#include "tensorflow/core/util/env_var.h"
 
 namespace tensorflow {
 namespace data {
@@ -96,6 +98,42 @@ constexpr const char kDistributedEpoch[] = "distributed_epoch";
 
 constexpr int64_t kLocalTaskBufferSize = 2;
 
+// Reads an int64 from the environment variable `name`, or returns
+// `default_value` if it is unset or invalid.
+int64_t Int64FromEnvVar(StringPiece name, int64_t default_value) {
+  int64_t value;
+  Status s = ReadInt64FromEnvVar(name, default_value, &value);
+  if (!s.ok()) {
+    LOG(ERROR) << "Invalid " << name << ": " << s;
+    return default_value;
+  }
+  return value;
+}
+
+// Returns the maximum number of elements to fetch with one request to a task,
+// for reads that are not round-robin.
+int64_t MaxElementsPerRequest() {
+  static const int64_t max_elements = std::max<int64_t>(
+      Int64FromEnvVar("TF_DATA_SERVICE_MAX_ELEMENTS_PER_REQUEST", 16), 1);
+  return max_elements;
+}
+
+// Returns the size in bytes after which a request stops adding elements, or 0
+// if requests are only limited by `MaxElementsPerRequest()`.
+int64_t MaxBytesPerRequest() {
+  static const int64_t max_bytes = std::max<int64_t>(
+      Int64FromEnvVar("TF_DATA_SERVICE_MAX_BYTES_PER_REQUEST", 8 << 20), 0);
+  return max_bytes;
+}
+
+// Returns the maximum number of requests in flight to a remote task, for reads
+// that are not round-robin.
+int64_t MaxRequestsPerTask() {
+  static const int64_t max_requests = std::max<int64_t>(
+      Int64FromEnvVar("TF_DATA_SERVICE_MAX_REQUESTS_PER_TASK", 2), 1);
+  return max_requests;
+}
+
 bool IsColocatedTask(const TaskInfo& task) {
   return absl::c_any_of(task.worker_tags(), [](absl::string_view worker_tag) {
     return absl::AsciiStrToUpper(worker_tag) == kColocatedWorkerTag;
@@ -417,8 +455,8 @@ class DataServiceDatasetOp::Dataset : public DatasetBase {
       // deleted from `tasks_` on the next dispatcher heartbeat.
       bool removed = false;
       bool skipped_previous_round = false;
-      // Indicates whether a worker thread is currently processing the task.
-      bool in_use TF_GUARDED_BY(&Iterator::mu_) = false;
+      // The number of worker threads currently processing the task.
+      int64_t num_outstanding_requests TF_GUARDED_BY(&Iterator::mu_) = 0;
       // Indicates whether the worker has returned end_of_sequence for the task.
       bool end_of_sequence TF_GUARDED_BY(&Iterator::mu_) = false;
     };
@@ -772,7 +810,7 @@ class DataServiceDatasetOp::Dataset : public DatasetBase {
         // configured local task buffer size.
         mutex_lock l(mu_);
         int64_t max_outstanding_requests =
-            tasks_.size() +
+            tasks_.size() * MaxElementsPerTask() +
             (GetLocalTaskBufferSize() - 1) * local_tasks_.size();
         if (max_outstanding_requests > max_outstanding_requests_) {
           worker_thread_cv_.notify_all();
@@ -783,8 +821,8 @@ class DataServiceDatasetOp::Dataset : public DatasetBase {
 
     void UpdateWorkerThreads(IteratorContext* ctx) TF_LOCKS_EXCLUDED(mu_) {
       mutex_lock l(mu_);
-      const int64_t max_num_threads =
-          std::min<int64_t>(tasks_.size(), max_outstanding_requests_);
+      const int64_t max_num_threads = std::min<int64_t>(
+          tasks_.size() * MaxRequestsPerRemoteTask(), max_outstanding_requests_);
       while (num_running_worker_threads_ < max_num_threads && !cancelled_ &&
              status_.ok()) {
         num_running_worker_threads_++;
@@ -807,13 +845,14 @@ class DataServiceDatasetOp::Dataset : public DatasetBase {
       });
       VLOG(1) << "Starting worker thread";
       std::shared_ptr<Task> task_to_process;
+      int64_t num_elements = 0;
       while (true) {
         Result* result;
         {
           mutex_lock l(mu_);
           if (task_to_process) {
-            task_to_process->in_use = false;
-            RemoveOutstandingRequest(*task_to_process);
+            task_to_process->num_outstanding_requests--;
+            RemoveOutstandingRequest(*task_to_process, num_elements);
             task_to_process = nullptr;
             worker_thread_cv_.notify_one();
           }
@@ -828,8 +867,9 @@ class DataServiceDatasetOp::Dataset : public DatasetBase {
             worker_thread_cv_.wait(l);
           }
           DCHECK(task_to_process != nullptr);
-          task_to_process->in_use = true;
-          AddOutstandingRequest(*task_to_process);
+          task_to_process->num_outstanding_requests++;
+          num_elements = NumElementsToRequest();
+          AddOutstandingRequest(*task_to_process, num_elements);
           if (StrictRoundRobin()) {
             // Reserve a spot in the results_ queue.
             results_.emplace();
@@ -841,18 +881,17 @@ class DataServiceDatasetOp::Dataset : public DatasetBase {
         Status s;
         if (StrictRoundRobin()) {
           s = GetElementTraced(task_to_process.get(), deadline_micros,
-                               /*enqueue_result=*/false, *result);
+                               *result);
         } else {
-          Result r;
-          s = GetElementTraced(task_to_process.get(), deadline_micros,
-                               /*enqueue_result=*/true, r);
+          s = GetElementsTraced(task_to_process.get(), deadline_micros,
+                                num_elements);
         }
         if (!s.ok()) {
           mutex_lock l(mu_);
           VLOG(1) << "Failed to get element from worker "
                   << task_to_process->info.worker_address() << ": " << s;
-          task_to_process->in_use = false;
-          RemoveOutstandingRequest(*task_to_process);
+          task_to_process->num_outstanding_requests--;
+          RemoveOutstandingRequest(*task_to_process, num_elements);
           status_ = errors::CreateWithUpdatedMessage(
               s, absl::StrCat("Failed to get element from worker ",
                               task_to_process->info.worker_address(), ": ",
@@ -934,7 +973,8 @@ class DataServiceDatasetOp::Dataset : public DatasetBase {
         TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
       for (const auto& address_task : local_tasks_) {
         const auto& task = address_task.second;
-        if (!task->in_use && !task->end_of_sequence && !task->removed) {
+        if (task->num_outstanding_requests == 0 && !task->end_of_sequence &&
+            !task->removed) {
           return task;
         }
       }
@@ -948,21 +988,24 @@ class DataServiceDatasetOp::Dataset : public DatasetBase {
       for (int i = 0; i < tasks_.size(); ++i) {
         std::shared_ptr<Task>& task = tasks_[next_task_index_];
         if (StrictRoundRobin() &&
-            (task->in_use ||
+            (task->num_outstanding_requests > 0 ||
              current_round_ >= round_robin_round_limit_.value_or(
                                    std::numeric_limits<int64_t>::max()))) {
-          VLOG(4) << "No round robin task found. in_use: " << task->in_use
+          VLOG(4) << "No round robin task found. num_outstanding_requests: "
+                  << task->num_outstanding_requests
                   << ". current_round: " << current_round_
                   << ". round_robin_round_limit: "
                   << round_robin_round_limit_.value_or(-1);
           return nullptr;
         }
-        if (current_round_ < task->info.starting_round() || task->in_use ||
+        if (current_round_ < task->info.starting_round() ||
+            task->num_outstanding_requests >= MaxRequestsPerRemoteTask() ||
             task->end_of_sequence || task->removed) {
           VLOG(3) << "Skipping task " << next_task_index_
                   << ". starting round: " << task->info.starting_round()
                   << ". current round: " << current_round_
-                  << ". task->in_use: " << task->in_use
+                  << ". task->num_outstanding_requests: "
+                  << task->num_outstanding_requests
                   << ". end_of_sequence: " << task->end_of_sequence
                   << ". task->removed: " << task->removed;
           AdvanceTaskIndex();
@@ -984,6 +1027,34 @@ class DataServiceDatasetOp::Dataset : public DatasetBase {
       return 1;
     }
 
+    // Returns the maximum number of requests in flight to a task that is not
+    // read through `GetLocalTaskToProcess`.
+    int64_t MaxRequestsPerRemoteTask() const {
+      return StrictRoundRobin() ? 1 : MaxRequestsPerTask();
+    }
+
+    // Returns the maximum number of elements requested from a task at once.
+    int64_t MaxElementsPerTask() const {
+      return StrictRoundRobin()
+                 ? 1
+                 : MaxElementsPerRequest() * MaxRequestsPerRemoteTask();
+    }
+
+    // Returns the number of elements to request next. The elements count
+    // against `max_outstanding_requests_` until the request completes.
+    int64_t NumElementsToRequest() const TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+      if (StrictRoundRobin()) {
+        return 1;
+      }
+      const int64_t num_buffered =
+          local_results_buffer_.size() + outstanding_local_requests_ +
+          results_.size() + outstanding_requests_;
+      return std::max<int64_t>(
+          std::min(MaxElementsPerRequest(),
+                   max_outstanding_requests_ - num_buffered),
+          1);
+    }
+
     // Increments the next task index, starting over if all tasks have been
     // processed.
     void AdvanceTaskIndex() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
@@ -994,21 +1065,21 @@ class DataServiceDatasetOp::Dataset : public DatasetBase {
       }
     }
 
-    void AddOutstandingRequest(const Task& task)
+    void AddOutstandingRequest(const Task& task, int64_t num_elements)
         TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
       if (local_tasks_.contains(task.info.worker_address())) {
-        outstanding_local_requests_++;
+        outstanding_local_requests_ += num_elements;
       } else {
-        outstanding_requests_++;
+        outstanding_requests_ += num_elements;
       }
     }
 
-    void RemoveOutstandingRequest(const Task& task)
+    void RemoveOutstandingRequest(const Task& task, int64_t num_elements)
         TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
       if (local_tasks_.contains(task.info.worker_address())) {
-        outstanding_local_requests_--;
+        outstanding_local_requests_ -= num_elements;
       } else {
-        outstanding_requests_--;
+        outstanding_requests_ -= num_elements;
       }
     }
 
@@ -1040,7 +1111,9 @@ class DataServiceDatasetOp::Dataset : public DatasetBase {
         result.task_id = task.info.task_id();
       } else if (get_element_result.skip) {
         task.skipped_previous_round = true;
-      } else {
+      } else if (!task.end_of_sequence) {
+        // With several requests in flight, more than one of them may reach the
+        // end of the task.
         task.end_of_sequence = true;
         finished_tasks_++;
       }
@@ -1055,8 +1128,7 @@ class DataServiceDatasetOp::Dataset : public DatasetBase {
     }
 
     Status GetElementTraced(Task* task, int64_t deadline_micros,
-                            bool enqueue_result, Result& result)
-        TF_LOCKS_EXCLUDED(mu_) {
+                            Result& result) TF_LOCKS_EXCLUDED(mu_) {
       VLOG(3) << "Getting an element for task id " << task->info.task_id();
       tensorflow::profiler::TraceMe activity(
           "GetDataServiceElement", tensorflow::profiler::TraceMeLevel::kInfo);
@@ -1074,12 +1146,26 @@ class DataServiceDatasetOp::Dataset : public DatasetBase {
                {"round_index", task->round}});
         });
       }
-      Status s = GetElement(task, deadline_micros, enqueue_result, result);
+      Status s = GetElement(task, deadline_micros, result);
       mutex_lock l(mu_);
       VLOG(3) << "Got an element for task id " << task->info.task_id();
       return s;
     }
 
+    Status GetElementsTraced(Task* task, int64_t deadline_micros,
+                             int64_t max_elements) TF_LOCKS_EXCLUDED(mu_) {
+      VLOG(3) << "Getting up to " << max_elements << " elements for task id "
+              << task->info.task_id();
+      tensorflow::profiler::TraceMe activity(
+          "GetDataServiceElements", tensorflow::profiler::TraceMeLevel::kInfo);
+      activity.AppendMetadata([&]() {
+        return profiler::TraceMeEncode(
+            {{"address", task->info.worker_address()},
+             {"max_elements", max_elements}});
+      });
+      return GetElements(task, deadline_micros, max_elements);
+    }
+
     Status MaybeRemoveTask(Task& task, int64_t deadline_micros,
                            Result& result) {
       bool removed;
@@ -1110,12 +1196,16 @@ class DataServiceDatasetOp::Dataset : public DatasetBase {
       return Status::OK();
     }
 
-    Status GetElement(Task* task, int64_t deadline_micros, bool enqueue_result,
-                      Result& result) TF_LOCKS_EXCLUDED(mu_) {
-      GetElementResult get_element_result;
+    // Calls `try_get_element` until it succeeds, retrying the errors that could
+    // indicate preemption until `deadline_micros`. When doing round-robin
+    // reads, the task may be removed instead, in which case `result` is
+    // marked as skipped.
+    Status RetryGetElement(Task* task, int64_t deadline_micros, Result& result,
+                           const std::function<Status()>& try_get_element)
+        TF_LOCKS_EXCLUDED(mu_) {
       for (int num_retries = 0;; ++num_retries) {
-        Status s = TryGetElement(*task, get_element_result);
-        if (s.ok()) break;
+        Status s = try_get_element();
+        if (s.ok()) return Status::OK();
         // Retry all errors that could indicate preemption.
         if (!errors::IsUnavailable(s) && !errors::IsCancelled(s) &&
             !errors::IsAborted(s)) {
@@ -1147,8 +1237,47 @@ class DataServiceDatasetOp::Dataset : public DatasetBase {
                 << " microseconds";
         Env::Default()->SleepForMicroseconds(backoff_until - now_micros);
       }
-      ProcessGetElementResponse(enqueue_result, get_element_result, result,
-                                *task);
+    }
+
+    Status GetElement(Task* task, int64_t deadline_micros, Result& result)
+        TF_LOCKS_EXCLUDED(mu_) {
+      GetElementResult get_element_result;
+      TF_RETURN_IF_ERROR(RetryGetElement(task, deadline_micros, result, [&]() {
+        return TryGetElement(*task, get_element_result);
+      }));
+      {
+        mutex_lock l(mu_);
+        if (result.skip) {
+          // The task has been removed.
+          return Status::OK();
+        }
+      }
+      ProcessGetElementResponse(/*enqueue_result=*/false, get_element_result,
+                                result, *task);
+      return Status::OK();
+    }
+
+    // Gets up to `max_elements` elements from `task` with a single request,
+    // adding them to the results.
+    Status GetElements(Task* task, int64_t deadline_micros,
+                       int64_t max_elements) TF_LOCKS_EXCLUDED(mu_) {
+      GetElementsRequest req;
+      req.mutable_request()->set_task_id(task->info.task_id());
+      req.set_max_elements(max_elements);
+      req.set_max_bytes(MaxBytesPerRequest());
+      std::vector<GetElementResult> get_element_results;
+      // Tasks are only removed when doing round-robin reads.
+      Result unused_result;
+      TF_RETURN_IF_ERROR(
+          RetryGetElement(task, deadline_micros, unused_result, [&]() {
+            get_element_results.clear();
+            return task->worker->GetElements(req, get_element_results);
+          }));
+      for (GetElementResult& get_element_result : get_element_results) {
+        Result result;
+        ProcessGetElementResponse(/*enqueue_result=*/true, get_element_result,
+                                  result, *task);
+      }
       return Status::OK();
     }
 
@@ -1196,6 +1325,7 @@ class DataServiceDatasetOp::Dataset : public DatasetBase {
     // Method for deregistering the cancellation callback.
     std::function<void()> deregister_fn_;
 
+    // The number of elements requested by in-progress requests.
     int64_t outstanding_requests_ TF_GUARDED_BY(mu_) = 0;
     int64_t outstanding_local_requests_ TF_GUARDED_BY(mu_) = 0;
 
@@ -38,7 +38,7 @@ namespace {
 void GetModelDatasetParams(const Options& options,
                            model::AutotuneAlgorithm* algorithm,
                            bool* cpu_budget, bool* ram_budget) {
-  *algorithm = model::AutotuneAlgorithm::HILL_CLIMB;
+  *algorithm = GetAutotuneAlgorithm();
   *cpu_budget = options.autotune_options().cpu_budget();
   *ram_budget = options.autotune_options().ram_budget();
 }
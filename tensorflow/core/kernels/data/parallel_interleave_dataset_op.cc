@@ -16,10 +16,12 @@ limitations under the License.
 
 #include <sys/types.h>
 
+#include <algorithm>
 #include <atomic>
 #include <deque>
 #include <memory>
 #include <utility>
+#include <vector>
 
 #include "absl/strings/str_format.h"
 #include "tensorflow/core/common_runtime/function.h"
@@ -43,10 +45,12 @@ limitations under the License.
 #include "tensorflow/core/lib/strings/stringprintf.h"
 #include "tensorflow/core/platform/blocking_counter.h"
 #include "tensorflow/core/platform/cpu_info.h"
+#include "tensorflow/core/platform/env_time.h"
 #include "tensorflow/core/platform/errors.h"
 #include "tensorflow/core/platform/stringprintf.h"
 #include "tensorflow/core/profiler/lib/traceme.h"
 #include "tensorflow/core/profiler/lib/traceme_encode.h"
+#include "tensorflow/core/util/env_var.h"
 
 namespace tensorflow {
 namespace data {
@@ -80,6 +84,8 @@ namespace data {
 /* static */ constexpr const char* const
     ParallelInterleaveDatasetOp::kDeterministic;
 /* static */ constexpr const char* const ParallelInterleaveDatasetOp::kSloppy;
+/* static */ constexpr const char* const
+    ParallelInterleaveDatasetOp::kMaxOutOfOrder;
 
 namespace {
 
@@ -96,6 +102,8 @@ constexpr char kResultsSuffix[] = ".results";
 constexpr char kCodeSuffix[] = ".code";
 constexpr char kErrorMessageSuffix[] = ".error_message";
 constexpr char kIdSuffix[] = ".id";
+constexpr char kNumResultsSuffix[] = ".num_results";
+constexpr char kResultsTakenEarly[] = "results_taken_early";
 constexpr char kSizeSuffix[] = ".size";
 constexpr char kInputsSuffix[] = ".inputs";
 constexpr char kIsReadySuffix[] = ".is_ready";
@@ -118,6 +126,21 @@ constexpr double kDefaultPerIteratorPrefetchFactor = 2.0L;
 // Period between reporting dataset statistics.
 constexpr int kStatsReportingPeriodMillis = 1000;
 
+// Returns how long a deterministic iterator waits for the next result in order
+// before it hedges the element producing it, or 0 to never hedge. The
+// environment is read when iterators are created. Elements are only hedged if
+// the interleaved function is stateless.
+int64_t StragglerTimeoutMicros() {
+  int64_t value;
+  Status s = ReadInt64FromEnvVar("TF_DATA_INTERLEAVE_STRAGGLER_TIMEOUT_MS",
+                                 /*default_val=*/0, &value);
+  if (!s.ok()) {
+    LOG(ERROR) << "Invalid TF_DATA_INTERLEAVE_STRAGGLER_TIMEOUT_MS: " << s;
+    return 0;
+  }
+  return std::max<int64_t>(value, 0) * 1000;
+}
+
 inline int64_t CeilDiv(int64_t numerator, int64_t denominator) {
   return (numerator + denominator - 1) / denominator;
 }
@@ -162,7 +185,8 @@ class ParallelInterleaveDatasetOp::Dataset : public DatasetBase {
           std::unique_ptr<CapturedFunction> captured_func, int64_t cycle_length,
           int64_t block_length, int64_t buffer_output_elements,
           int64_t prefetch_input_elements, int64_t num_parallel_calls,
-          DeterminismPolicy deterministic, const DataTypeVector& output_types,
+          DeterminismPolicy deterministic, int64_t max_out_of_order,
+          const DataTypeVector& output_types,
           const std::vector<PartialTensorShape>& output_shapes, int op_version)
       : DatasetBase(DatasetContext(ctx)),
         input_(input),
@@ -175,6 +199,7 @@ class ParallelInterleaveDatasetOp::Dataset : public DatasetBase {
             prefetch_input_elements, cycle_length)),
         num_parallel_calls_(num_parallel_calls),
         deterministic_(deterministic),
+        max_out_of_order_(max_out_of_order),
         output_types_(output_types),
         output_shapes_(output_shapes),
         op_version_(op_version),
@@ -299,6 +324,11 @@ class ParallelInterleaveDatasetOp::Dataset : public DatasetBase {
       b->BuildAttrValue(deterministic_.String(), &deterministic_attr);
       attrs.emplace_back(kDeterministic, deterministic_attr);
     }
+    if (op_version_ >= 4) {
+      AttrValue max_out_of_order_attr;
+      b->BuildAttrValue(max_out_of_order_, &max_out_of_order_attr);
+      attrs.emplace_back(kMaxOutOfOrder, max_out_of_order_attr);
+    }
 
     TF_RETURN_IF_ERROR(b->AddDataset(this, inputs, list_inputs, attrs, output));
     return Status::OK();
@@ -315,7 +345,17 @@ class ParallelInterleaveDatasetOp::Dataset : public DatasetBase {
               params.dataset->num_parallel_calls_, mu_,
               num_parallel_calls_cond_var_)),
           deterministic_(deterministic),
-          current_elements_(params.dataset->cycle_length_) {}
+          max_out_of_order_(deterministic ? params.dataset->max_out_of_order_
+                                          : 0),
+          // A hedged iterator repeats the calls of the function made by the
+          // iterator it replaces, which is only safe for stateless functions.
+          straggler_timeout_us_(
+              deterministic &&
+                      params.dataset->captured_func_->CheckExternalState().ok()
+                  ? StragglerTimeoutMicros()
+                  : 0),
+          current_elements_(params.dataset->cycle_length_),
+          results_taken_early_(params.dataset->cycle_length_, 0) {}
 
     ~ParallelInterleaveIterator() override { CancelThreads(/*wait=*/true); }
 
@@ -338,6 +378,10 @@ class ParallelInterleaveDatasetOp::Dataset : public DatasetBase {
       if (ctx->stats_aggregator()) {
         num_threads++;
       }
+      if (straggler_timeout_us_ > 0) {
+        // One thread for running a hedged iterator.
+        num_threads++;
+      }
       thread_pool_ = ctx->CreateThreadPool(
           "data_parallel_interleave_worker_pool", num_threads);
       if (num_parallel_calls_->value == model::kAutotune) {
@@ -367,7 +411,7 @@ class ParallelInterleaveDatasetOp::Dataset : public DatasetBase {
           if (deterministic_) {
             VLOG(3) << "Blocked waiting for element "
                     << current_elements_[cycle_index_]->id;
-            current_elements_[cycle_index_]->cond_var.wait(l);
+            WaitForElement(current_elements_[cycle_index_], &l);
           } else {
             any_element_available_cond_var_.wait(l);
           }
@@ -449,6 +493,13 @@ class ParallelInterleaveDatasetOp::Dataset : public DatasetBase {
       }
       TF_RETURN_IF_ERROR(writer->WriteScalar(prefix(), kElementIdCounter,
                                              element_id_counter_));
+      for (int i = 0; i < results_taken_early_.size(); ++i) {
+        if (results_taken_early_[i] > 0) {
+          TF_RETURN_IF_ERROR(writer->WriteScalar(
+              prefix(), absl::StrCat(kResultsTakenEarly, "[", i, "]"),
+              results_taken_early_[i]));
+        }
+      }
       TF_RETURN_IF_ERROR(WriteCurrentElements(ctx, writer));
       TF_RETURN_IF_ERROR(WriteFutureElements(ctx, writer));
       // Wake workers back up.
@@ -471,6 +522,16 @@ class ParallelInterleaveDatasetOp::Dataset : public DatasetBase {
         TF_RETURN_IF_ERROR(reader->ReadScalar(prefix(), kElementIdCounter,
                                               &element_id_counter_));
         end_of_input_ = reader->Contains(prefix(), kEndOfInput);
+        num_results_taken_early_ = 0;
+        for (int i = 0; i < results_taken_early_.size(); ++i) {
+          const std::string key = absl::StrCat(kResultsTakenEarly, "[", i, "]");
+          results_taken_early_[i] = 0;
+          if (reader->Contains(prefix(), key)) {
+            TF_RETURN_IF_ERROR(
+                reader->ReadScalar(prefix(), key, &results_taken_early_[i]));
+            num_results_taken_early_ += results_taken_early_[i];
+          }
+        }
       }
       TF_RETURN_IF_ERROR(ReadCurrentElements(ctx, reader));
       TF_RETURN_IF_ERROR(ReadFutureElements(ctx, reader));
@@ -566,6 +627,13 @@ class ParallelInterleaveDatasetOp::Dataset : public DatasetBase {
       // Buffer for storing the outputs of `iterator`.
       std::deque<std::shared_ptr<Result>> TF_GUARDED_BY(
           &ParallelInterleaveIterator::mu_) results;
+      // The number of results produced from `inputs` so far. A hedged
+      // iterator skips this many results to catch up with `iterator`.
+      int64_t num_results TF_GUARDED_BY(&ParallelInterleaveIterator::mu_) = 0;
+      // The iterator the worker thread processing the element last started
+      // calling `GetNext` on.
+      IteratorBase* iterator_in_use
+          TF_GUARDED_BY(&ParallelInterleaveIterator::mu_) = nullptr;
       // The element's index in the cycle, if it is in the current cycle.
       // -1 if the element is not in the current cycle.
       int64_t cycle_index TF_GUARDED_BY(&ParallelInterleaveIterator::mu_) = -1;
@@ -586,9 +654,10 @@ class ParallelInterleaveDatasetOp::Dataset : public DatasetBase {
           TF_EXCLUSIVE_LOCKS_REQUIRED(&ParallelInterleaveIterator::mu_) {
         return absl::StrFormat(
             "Element(id: %d, iterator_null: %d, results_size: %d, "
-            "cycle_index: %d, active: %d, initialized: %d, no_input: %d)",
-            id, iterator == nullptr, results.size(), cycle_index, active,
-            initialized, no_input);
+            "num_results: %d, cycle_index: %d, active: %d, initialized: %d, "
+            "no_input: %d)",
+            id, iterator == nullptr, results.size(), num_results, cycle_index,
+            active, initialized, no_input);
       }
     };
 
@@ -666,7 +735,7 @@ class ParallelInterleaveDatasetOp::Dataset : public DatasetBase {
     bool Consume(std::shared_ptr<Result>* result)
         TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
       if (deterministic_) {
-        return ConsumeHelper(result);
+        return ConsumeHelper(result) || ConsumeOutOfOrder(result);
       }
       // If we are allowed to be nondeterministic (i.e. return results out of
       // order), try to find an element in the cycle that has a result
@@ -703,6 +772,14 @@ class ParallelInterleaveDatasetOp::Dataset : public DatasetBase {
         }
         DCHECK(current_elements_[cycle_index_]);
         std::shared_ptr<Element> element = current_elements_[cycle_index_];
+        if (results_taken_early_[cycle_index_] > 0) {
+          // The result for this position has already been consumed by
+          // `ConsumeOutOfOrder`.
+          --results_taken_early_[cycle_index_];
+          --num_results_taken_early_;
+          AdvancePosition();
+          continue;
+        }
         if (!element->results.empty()) {
           // We found a result.
           std::swap(*result, element->results.front());
@@ -758,6 +835,206 @@ class ParallelInterleaveDatasetOp::Dataset : public DatasetBase {
       }
     }
 
+    // Consumes the next result of the first element after the current position
+    // in the cycle that has a result available, as long as that result is at
+    // most `max_out_of_order_` places after the current position in the
+    // deterministic order. Only results of the current round of the cycle are
+    // considered, and their positions are skipped when the cycle reaches them,
+    // so the output is a permutation of the deterministic order in which no
+    // result moves more than `max_out_of_order_` places.
+    bool ConsumeOutOfOrder(std::shared_ptr<Result>* result)
+        TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+      if (num_results_taken_early_ >= max_out_of_order_ ||
+          last_valid_current_element_ == -1) {
+        return false;
+      }
+      const int64_t block_length = dataset()->block_length_;
+      // The number of places between the current position and the first
+      // position of the block of the element at offset `i` in this round.
+      int64_t block_offset = block_length - block_index_;
+      for (int64_t i = 1; i <= last_valid_current_element_; ++i) {
+        int64_t index = (cycle_index_ + i) % (last_valid_current_element_ + 1);
+        std::shared_ptr<Element> element = current_elements_[index];
+        if (!element) {
+          continue;
+        }
+        if (block_offset > max_out_of_order_) {
+          return false;
+        }
+        if (element->results.empty() ||
+            results_taken_early_[index] >= block_length ||
+            block_offset + results_taken_early_[index] > max_out_of_order_) {
+          block_offset += block_length;
+          continue;
+        }
+        std::swap(*result, element->results.front());
+        element->results.pop_front();
+        if (!element->active) {
+          elements_to_process_.push_back(index);
+          current_workers_cond_var_.notify_one();
+        }
+        ++results_taken_early_[index];
+        ++num_results_taken_early_;
+        return true;
+      }
+      return false;
+    }
+
+    // Waits for an update of `element`, the element holding the next result in
+    // order, or of any element if results may be consumed out of order. If
+    // `element` produces no result within the straggler timeout, it is hedged.
+    void WaitForElement(const std::shared_ptr<Element>& element, mutex_lock* l)
+        TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+      condition_variable* cond_var = max_out_of_order_ > 0
+                                         ? &any_element_available_cond_var_
+                                         : &element->cond_var;
+      if (straggler_timeout_us_ == 0) {
+        cond_var->wait(*l);
+        return;
+      }
+      const int64_t now_us = EnvTime::NowMicros();
+      if (element->id != stalled_element_id_ ||
+          element->num_results != stalled_element_num_results_) {
+        stalled_element_id_ = element->id;
+        stalled_element_num_results_ = element->num_results;
+        stalled_since_us_ = now_us;
+        stalled_element_hedged_ = false;
+      }
+      const int64_t deadline_us = stalled_since_us_ + straggler_timeout_us_;
+      if (now_us < deadline_us) {
+        cond_var->wait_for(*l, std::chrono::microseconds(deadline_us - now_us));
+        return;
+      }
+      MaybeStartHedge(element);
+      cond_var->wait(*l);
+    }
+
+    // Starts a hedged iterator for `element` unless one is already running or
+    // `element` is not blocked in a call to `GetNext` on its iterator.
+    void MaybeStartHedge(const std::shared_ptr<Element>& element)
+        TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+      if (stalled_element_hedged_ || hedge_in_flight_ || cancelled_ ||
+          wait_for_checkpoint_ || !element->active || !element->iterator ||
+          element->iterator_in_use != element->iterator.get() ||
+          !element->inputs || !element->results.empty() ||
+          element->num_results < 0 || element->cycle_index == -1) {
+        return;
+      }
+      VLOG(2) << "Hedging element " << element->id << " after it produced no "
+              << "result for " << straggler_timeout_us_ << "us";
+      stalled_element_hedged_ = true;
+      hedge_in_flight_ = true;
+      IncrementOutstandingThreads();
+      IncrementActiveWorkers();
+      thread_pool_->Schedule([this, element,
+                              original = element->iterator.get(),
+                              num_results = element->num_results]() {
+        HedgeThread(element, original, num_results);
+      });
+    }
+
+    // Returns whether a hedged iterator started when `element` had produced
+    // `num_results` results from `original` may still take over the element.
+    bool HedgeIsUseful(const std::shared_ptr<Element>& element,
+                       IteratorBase* original, int64_t num_results)
+        TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+      return !cancelled_ && !wait_for_checkpoint_ && element->active &&
+             element->iterator.get() == original &&
+             element->iterator_in_use == original &&
+             element->num_results == num_results && element->cycle_index != -1;
+    }
+
+    // Runs a second iterator over the inputs of `element`, whose iterator
+    // `original` has not produced a result within the straggler timeout. The
+    // hedged iterator skips the `num_results` results `original` already
+    // produced. If it produces the next one before `original` does, it
+    // replaces `original` as the element's iterator. This relies on the
+    // datasets returned by the interleave function being deterministic.
+    void HedgeThread(std::shared_ptr<Element> element, IteratorBase* original,
+                     int64_t num_results) TF_LOCKS_EXCLUDED(mu_) {
+      RecordStart(ctx_.get());
+      auto done = gtl::MakeCleanup([this]() {
+        RecordStop(ctx_.get());
+        mutex_lock l(*mu_);
+        hedge_in_flight_ = false;
+        DecrementActiveWorkers();
+        DecrementOutstandingThreads();
+      });
+      std::vector<Tensor> inputs;
+      int64_t element_id;
+      {
+        mutex_lock l(*mu_);
+        if (!HedgeIsUseful(element, original, num_results)) {
+          return;
+        }
+        inputs = *element->inputs;
+        element_id = element->id;
+      }
+      std::unique_ptr<IteratorBase> iterator;
+      IteratorContext::Params params(ctx_.get());
+      params.interleave_depth += 1;
+      IteratorContext ctx(params);
+      Status status = MakeIteratorFromInputElement(
+          &ctx, this, inputs, element_id, *instantiated_captured_func_,
+          prefix(), &iterator, model_node());
+      if (!status.ok()) {
+        VLOG(2) << "Failed to hedge element " << element_id << ": " << status;
+        return;
+      }
+      for (int64_t i = 0;; ++i) {
+        auto result = std::make_shared<Result>();
+        bool end_of_input = false;
+        const int64_t start_us = EnvTime::NowMicros();
+        result->status = iterator->GetNext(ctx_.get(), &result->return_values,
+                                           &end_of_input);
+        RecordInputLatency(iterator.get(), EnvTime::NowMicros() - start_us);
+        mutex_lock l(*mu_);
+        if (!HedgeIsUseful(element, original, num_results)) {
+          return;
+        }
+        if (i < num_results) {
+          if (end_of_input || !result->status.ok()) {
+            VLOG(2) << "Hedged iterator for element " << element_id
+                    << " diverged from the original iterator";
+            return;
+          }
+          continue;
+        }
+        VLOG(2) << "Hedged iterator took over element " << element_id;
+        superseded_iterators_.push_back(std::move(element->iterator));
+        if (end_of_input) {
+          element->inputs.reset();
+        } else {
+          element->iterator = std::move(iterator);
+          RecordBufferEnqueue(ctx_.get(), result->return_values);
+          element->results.push_back(std::move(result));
+          ++element->num_results;
+        }
+        // The worker blocked on `original` gives up the element once its call
+        // returns, so hand the element to the other current workers.
+        element->active = false;
+        elements_to_process_.push_back(element->cycle_index);
+        current_workers_cond_var_.notify_one();
+        NotifyElementUpdate(element);
+        return;
+      }
+    }
+
+    // Removes `iterator` from `superseded_iterators_` and returns it.
+    std::unique_ptr<IteratorBase> TakeSupersededIterator(IteratorBase* iterator)
+        TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+      std::unique_ptr<IteratorBase> result;
+      for (auto it = superseded_iterators_.begin();
+           it != superseded_iterators_.end(); ++it) {
+        if (it->get() == iterator) {
+          result = std::move(*it);
+          superseded_iterators_.erase(it);
+          break;
+        }
+      }
+      return result;
+    }
+
     // Creates a new element.
     std::shared_ptr<Element> MakeElement() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
       if (end_of_input_) {
@@ -891,7 +1168,9 @@ class ParallelInterleaveDatasetOp::Dataset : public DatasetBase {
         // Loop on the element until we fill its results buffer or reach end of
         // input for the element.
         while (true) {
-          ProcessElement(element);
+          if (!ProcessElement(element)) {
+            break;
+          }
           {
             mutex_lock l(*mu_);
             // Check whether we have produced enough results for the current
@@ -923,7 +1202,7 @@ class ParallelInterleaveDatasetOp::Dataset : public DatasetBase {
           if (element) {
             element->active = false;
             if (element->cycle_index != -1) {
-              element->cond_var.notify_one();
+              NotifyElementUpdate(element);
               // A current worker may need to process the element further.
               elements_to_process_.push_back(element->cycle_index);
               current_workers_cond_var_.notify_one();
@@ -947,13 +1226,17 @@ class ParallelInterleaveDatasetOp::Dataset : public DatasetBase {
           element->active = true;
           future_elements_.push_back(element);
         }
-        ProcessElement(element);
+        if (!ProcessElement(element)) {
+          element.reset();
+        }
       }
     }
 
     // Generates results for the given element until the element's results
-    // buffer is full or the element is done producing results.
-    void ProcessElement(std::shared_ptr<Element> element)
+    // buffer is full or the element is done producing results. Returns false if
+    // a hedged iterator took over the element in the meantime, in which case
+    // the caller no longer owns the element.
+    bool ProcessElement(std::shared_ptr<Element> element)
         TF_LOCKS_EXCLUDED(mu_) {
       DCHECK(element != nullptr);
       IteratorBase* iterator;
@@ -966,13 +1249,14 @@ class ParallelInterleaveDatasetOp::Dataset : public DatasetBase {
         if (!element->iterator) {
           InitializeInputs(input_element_id);
           if (!element->iterator) {
-            return;
+            return true;
           }
         }
         // `iterator` will remain valid after releasing the lock because we have
         // marked the element as active, so no other thread will modify its
         // iterator.
         iterator = element->iterator.get();
+        element->iterator_in_use = iterator;
       }
       DCHECK(iterator != nullptr);
       // Process until the results queue is full or we reach end of input.
@@ -986,23 +1270,35 @@ class ParallelInterleaveDatasetOp::Dataset : public DatasetBase {
                {"element_id", result->id}});
         });
         bool end_of_input = false;
+        const int64_t start_us = EnvTime::NowMicros();
         result->status = iterator->GetNext(ctx_.get(), &result->return_values,
                                            &end_of_input);
+        RecordInputLatency(iterator, EnvTime::NowMicros() - start_us);
+        // Declared before `l` so that a superseded iterator is destroyed after
+        // the lock is released.
+        std::unique_ptr<IteratorBase> superseded_iterator;
+        mutex_lock l(*mu_);
+        if (element->iterator.get() != iterator) {
+          superseded_iterator = TakeSupersededIterator(iterator);
+          return false;
+        }
         if (end_of_input) {
-          mutex_lock l(*mu_);
           element->iterator.reset();
           element->inputs.reset();
           NotifyElementUpdate(element);
           break;
         }
         RecordBufferEnqueue(ctx_.get(), result->return_values);
-        mutex_lock l(*mu_);
         element->results.push_back(std::move(result));
+        if (element->num_results >= 0) {
+          ++element->num_results;
+        }
         NotifyElementUpdate(element);
         if (element->results.size() == dataset()->buffer_output_elements_) {
           break;
         }
       }
+      return true;
     }
 
     // Initialize inputs and create an iterator for all elements up to
@@ -1087,7 +1383,8 @@ class ParallelInterleaveDatasetOp::Dataset : public DatasetBase {
         TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
       if (deterministic_) {
         element->cond_var.notify_one();
-      } else {
+      }
+      if (!deterministic_ || max_out_of_order_ > 0) {
         any_element_available_cond_var_.notify_one();
       }
     }
@@ -1223,6 +1520,8 @@ class ParallelInterleaveDatasetOp::Dataset : public DatasetBase {
         TF_RETURN_IF_ERROR(SaveInput(ctx, writer, element->iterator));
         TF_RETURN_IF_ERROR(
             writer->WriteScalar(iterator_name, kIdSuffix, element->id));
+        TF_RETURN_IF_ERROR(writer->WriteScalar(iterator_name, kNumResultsSuffix,
+                                               element->num_results));
         TF_RETURN_IF_ERROR(writer->WriteScalar(
             iterator_name, absl::StrCat(kInputsSuffix, kSizeSuffix),
             element->inputs->size()));
@@ -1340,6 +1639,13 @@ class ParallelInterleaveDatasetOp::Dataset : public DatasetBase {
         }
         TF_RETURN_IF_ERROR(
             reader->ReadScalar(iterator_name, kIdSuffix, &element->id));
+        // Checkpoints written before `num_results` was tracked leave it
+        // unknown, which prevents the element from being hedged.
+        element->num_results = -1;
+        if (reader->Contains(iterator_name, kNumResultsSuffix)) {
+          TF_RETURN_IF_ERROR(reader->ReadScalar(
+              iterator_name, kNumResultsSuffix, &element->num_results));
+        }
         IteratorContext::Params params(ctx);
         params.interleave_depth += 1;
         IteratorContext ctx_copy(params);
@@ -1538,12 +1844,21 @@ class ParallelInterleaveDatasetOp::Dataset : public DatasetBase {
     int num_current_workers_ TF_GUARDED_BY(mu_) = 0;
 
     // Condition variable to signal that a result has been produced by some
-    // element thread. Only used when `deterministic` is false.
+    // element thread. Only used when `deterministic` is false or
+    // `max_out_of_order_` is positive.
     condition_variable any_element_available_cond_var_;
 
     // Determines whether outputs can be produced in deterministic order.
     const bool deterministic_;
 
+    // The maximum number of results that may be consumed ahead of their turn
+    // in the deterministic order.
+    const int64_t max_out_of_order_;
+
+    // How long to wait for the next result in order before hedging the element
+    // producing it, or 0 to never hedge.
+    const int64_t straggler_timeout_us_;
+
     // Controls cancellation of `input_impl_`. Must be ordered before
     // `input_impl_` so that `input_impl_` is destroyed first.
     std::unique_ptr<CancellationManager> cancellation_manager_;
@@ -1560,6 +1875,25 @@ class ParallelInterleaveDatasetOp::Dataset : public DatasetBase {
     // Elements of the current interleave cycle.
     std::vector<std::shared_ptr<Element>> current_elements_ TF_GUARDED_BY(mu_);
 
+    // The number of results consumed ahead of their turn from each element of
+    // the current cycle, and their sum.
+    std::vector<int64_t> results_taken_early_ TF_GUARDED_BY(mu_);
+    int64_t num_results_taken_early_ TF_GUARDED_BY(mu_) = 0;
+
+    // The element `GetNext` is blocked on, the number of results it had
+    // produced, and when `GetNext` started waiting for its next result.
+    int64_t stalled_element_id_ TF_GUARDED_BY(mu_) = -1;
+    int64_t stalled_element_num_results_ TF_GUARDED_BY(mu_) = -1;
+    int64_t stalled_since_us_ TF_GUARDED_BY(mu_) = 0;
+    // Whether the stalled element has been hedged.
+    bool stalled_element_hedged_ TF_GUARDED_BY(mu_) = false;
+    // Whether a hedged iterator is running. At most one runs at a time.
+    bool hedge_in_flight_ TF_GUARDED_BY(mu_) = false;
+    // Iterators replaced by hedged iterators while a worker thread was still
+    // blocked on them. The worker destroys the iterator once its call returns.
+    std::vector<std::unique_ptr<IteratorBase>> superseded_iterators_
+        TF_GUARDED_BY(mu_);
+
     // Elements which still need their inputs and iterators to be initialized.
     // Elements at the front need to be initialized first.
     std::deque<std::shared_ptr<Element>> uninitialized_elements_
@@ -1605,6 +1939,10 @@ class ParallelInterleaveDatasetOp::Dataset : public DatasetBase {
   const int64_t prefetch_input_elements_;
   const int64_t num_parallel_calls_;
   const DeterminismPolicy deterministic_;
+  // The number of results a deterministic iterator may return ahead of their
+  // turn when the next result in order is not ready, or 0 to always wait for
+  // it.
+  const int64_t max_out_of_order_;
   const DataTypeVector output_types_;
   const std::vector<PartialTensorShape> output_shapes_;
   const int op_version_;
@@ -1635,6 +1973,17 @@ ParallelInterleaveDatasetOp::ParallelInterleaveDatasetOp(
     OP_REQUIRES_OK(
         ctx, DeterminismPolicy::FromString(deterministic, &deterministic_));
   }
+  if (op_version_ >= 4 && ctx->HasAttr(kMaxOutOfOrder)) {
+    OP_REQUIRES_OK(ctx, ctx->GetAttr(kMaxOutOfOrder, &max_out_of_order_));
+    OP_REQUIRES(ctx, max_out_of_order_ >= 0,
+                errors::InvalidArgument("`max_out_of_order` must be >= 0 but is ",
+                                        max_out_of_order_));
+    OP_REQUIRES(
+        ctx, max_out_of_order_ == 0 || !deterministic_.IsDeterministic(),
+        errors::InvalidArgument(
+            "`max_out_of_order` must be 0 when `deterministic` is \"true\", "
+            "since it lets results be returned out of order."));
+  }
 }
 
 void ParallelInterleaveDatasetOp::MakeDataset(OpKernelContext* ctx,
@@ -1708,7 +2057,8 @@ void ParallelInterleaveDatasetOp::MakeDataset(OpKernelContext* ctx,
   *output = new Dataset(
       ctx, input, std::move(captured_func), cycle_length, block_length,
       buffer_output_elements, prefetch_input_elements, num_parallel_calls,
-      deterministic_, output_types_, output_shapes_, op_version_);
+      deterministic_, max_out_of_order_, output_types_, output_shapes_,
+      op_version_);
 }
 
 namespace {
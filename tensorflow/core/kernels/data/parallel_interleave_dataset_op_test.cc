@@ -11,7 +11,18 @@ limitations under the License.
 ==============================================================================*/
 #include "tensorflow/core/kernels/data/parallel_interleave_dataset_op.h"
 
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
 #include "tensorflow/core/data/dataset_test_base.h"
+#include "tensorflow/core/data/serialization_utils.h"
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/mutex.h"
 
 namespace tensorflow {
 namespace data {
@@ -20,6 +31,225 @@ namespace {
 constexpr char kNodeName[] = "parallel_interleave_dataset";
 constexpr int kOpVersion = 4;
 
+// The state shared by the iterators of `StragglerRangeDataset`.
+struct StragglerState {
+  mutex mu;
+  condition_variable cond_var;
+  // The number of iterators created for each `start`.
+  absl::flat_hash_map<int64_t, int64_t> num_iterators TF_GUARDED_BY(mu);
+  // The first `num_stalling_iterators` iterators created for a `start` stall.
+  int64_t num_stalling_iterators TF_GUARDED_BY(mu) = 0;
+  // The number of iterators currently stalled.
+  int64_t num_stalled TF_GUARDED_BY(mu) = 0;
+  // The first `num_released` iterators created for a `start` no longer stall.
+  int64_t num_released TF_GUARDED_BY(mu) = 0;
+};
+
+StragglerState& GetStragglerState() {
+  static StragglerState* state = new StragglerState;
+  return *state;
+}
+
+void ResetStragglerState(int64_t num_stalling_iterators) {
+  StragglerState& state = GetStragglerState();
+  mutex_lock l(state.mu);
+  state.num_iterators.clear();
+  state.num_stalling_iterators = num_stalling_iterators;
+  state.num_stalled = 0;
+  state.num_released = 0;
+}
+
+void ReleaseStragglers(int64_t num_released) {
+  StragglerState& state = GetStragglerState();
+  mutex_lock l(state.mu);
+  state.num_released = num_released;
+  state.cond_var.notify_all();
+}
+
+void WaitForStragglers(int64_t num_stalled) {
+  StragglerState& state = GetStragglerState();
+  mutex_lock l(state.mu);
+  while (state.num_stalled < num_stalled) {
+    state.cond_var.wait(l);
+  }
+}
+
+int64_t NumIterators(int64_t start) {
+  StragglerState& state = GetStragglerState();
+  mutex_lock l(state.mu);
+  return state.num_iterators[start];
+}
+
+// Produces the range [start, stop). The first iterators created for a given
+// `start` block before producing the element at index `stall_at` until they
+// are released, while the later ones do not, like an input whose first reader
+// hits a slow server.
+REGISTER_OP("StragglerRangeDataset")
+    .Input("start: int64")
+    .Input("stop: int64")
+    .Input("stall_at: int64")
+    .Output("handle: variant")
+    .SetShapeFn(shape_inference::ScalarShape);
+
+class StragglerRangeDatasetOp : public DatasetOpKernel {
+ public:
+  using DatasetOpKernel::DatasetOpKernel;
+
+  void MakeDataset(OpKernelContext* ctx, DatasetBase** output) override {
+    int64_t start, stop, stall_at;
+    OP_REQUIRES_OK(ctx, ParseScalarArgument<int64_t>(ctx, "start", &start));
+    OP_REQUIRES_OK(ctx, ParseScalarArgument<int64_t>(ctx, "stop", &stop));
+    OP_REQUIRES_OK(ctx,
+                   ParseScalarArgument<int64_t>(ctx, "stall_at", &stall_at));
+    *output = new Dataset(ctx, start, stop, stall_at);
+  }
+
+ private:
+  class Dataset : public DatasetBase {
+   public:
+    Dataset(OpKernelContext* ctx, int64_t start, int64_t stop,
+            int64_t stall_at)
+        : DatasetBase(DatasetContext(ctx)),
+          start_(start),
+          stop_(stop),
+          stall_at_(stall_at) {}
+
+    std::unique_ptr<IteratorBase> MakeIteratorInternal(
+        const string& prefix) const override {
+      return absl::make_unique<Iterator>(
+          Iterator::Params{this, strings::StrCat(prefix, "::StragglerRange")});
+    }
+
+    const DataTypeVector& output_dtypes() const override {
+      static DataTypeVector* dtypes = new DataTypeVector({DT_INT64});
+      return *dtypes;
+    }
+
+    const std::vector<PartialTensorShape>& output_shapes() const override {
+      static std::vector<PartialTensorShape>* shapes =
+          new std::vector<PartialTensorShape>({PartialTensorShape({})});
+      return *shapes;
+    }
+
+    string DebugString() const override {
+      return "StragglerRangeDatasetOp::Dataset";
+    }
+
+    Status InputDatasets(
+        std::vector<const DatasetBase*>* inputs) const override {
+      return Status::OK();
+    }
+
+    Status CheckExternalState() const override { return Status::OK(); }
+
+   protected:
+    Status AsGraphDefInternal(SerializationContext* ctx,
+                              DatasetGraphDefBuilder* b,
+                              Node** output) const override {
+      Node* start = nullptr;
+      Node* stop = nullptr;
+      Node* stall_at = nullptr;
+      TF_RETURN_IF_ERROR(b->AddScalar(start_, &start));
+      TF_RETURN_IF_ERROR(b->AddScalar(stop_, &stop));
+      TF_RETURN_IF_ERROR(b->AddScalar(stall_at_, &stall_at));
+      return b->AddDataset(this, {start, stop, stall_at}, output);
+    }
+
+   private:
+    class Iterator : public DatasetIterator<Dataset> {
+     public:
+      explicit Iterator(const Params& params)
+          : DatasetIterator<Dataset>(params), next_(dataset()->start_) {}
+
+      Status Initialize(IteratorContext* ctx) override {
+        StragglerState& state = GetStragglerState();
+        mutex_lock l(state.mu);
+        ordinal_ = state.num_iterators[dataset()->start_]++;
+        return Status::OK();
+      }
+
+      Status GetNextInternal(IteratorContext* ctx,
+                             std::vector<Tensor>* out_tensors,
+                             bool* end_of_sequence) override {
+        mutex_lock l(mu_);
+        if (next_ - dataset()->start_ == dataset()->stall_at_) {
+          Stall();
+        }
+        if (next_ >= dataset()->stop_) {
+          *end_of_sequence = true;
+          return Status::OK();
+        }
+        out_tensors->emplace_back(next_++);
+        *end_of_sequence = false;
+        return Status::OK();
+      }
+
+     protected:
+      std::shared_ptr<model::Node> CreateNode(
+          IteratorContext* ctx, model::Node::Args args) const override {
+        return model::MakeSourceNode(std::move(args));
+      }
+
+      Status SaveInternal(SerializationContext* ctx,
+                          IteratorStateWriter* writer) override {
+        mutex_lock l(mu_);
+        return writer->WriteScalar(full_name("next"), next_);
+      }
+
+      Status RestoreInternal(IteratorContext* ctx,
+                             IteratorStateReader* reader) override {
+        mutex_lock l(mu_);
+        return reader->ReadScalar(full_name("next"), &next_);
+      }
+
+     private:
+      void Stall() {
+        StragglerState& state = GetStragglerState();
+        mutex_lock l(state.mu);
+        if (ordinal_ >= state.num_stalling_iterators) {
+          return;
+        }
+        ++state.num_stalled;
+        state.cond_var.notify_all();
+        while (state.num_released <= ordinal_) {
+          state.cond_var.wait(l);
+        }
+        --state.num_stalled;
+      }
+
+      int64_t ordinal_ = 0;
+      mutex mu_;
+      int64_t next_ TF_GUARDED_BY(mu_);
+    };
+
+    const int64_t start_;
+    const int64_t stop_;
+    const int64_t stall_at_;
+  };
+};
+
+REGISTER_KERNEL_BUILDER(Name("StragglerRangeDataset").Device(DEVICE_CPU),
+                        StragglerRangeDatasetOp);
+
+// Forwards its input. The op is stateful, and so are the functions calling it.
+REGISTER_OP("StatefulInt64Identity")
+    .Input("x: int64")
+    .Output("y: int64")
+    .SetIsStateful()
+    .SetShapeFn(shape_inference::UnchangedShape);
+
+class StatefulInt64IdentityOp : public OpKernel {
+ public:
+  using OpKernel::OpKernel;
+
+  void Compute(OpKernelContext* ctx) override {
+    ctx->set_output(0, ctx->input(0));
+  }
+};
+
+REGISTER_KERNEL_BUILDER(Name("StatefulInt64Identity").Device(DEVICE_CPU),
+                        StatefulInt64IdentityOp);
+
 class ParallelInterleaveDatasetParams : public DatasetParams {
  public:
   template <typename T>
@@ -31,7 +261,8 @@ class ParallelInterleaveDatasetParams : public DatasetParams {
       std::vector<FunctionDef> func_lib, DataTypeVector type_arguments,
       const DataTypeVector& output_dtypes,
       const std::vector<PartialTensorShape>& output_shapes,
-      const std::string& deterministic, const std::string& node_name)
+      const std::string& deterministic, const std::string& node_name,
+      int64_t max_out_of_order = 0)
       : DatasetParams(std::move(output_dtypes), std::move(output_shapes),
                       std::move(node_name)),
         other_arguments_(std::move(other_arguments)),
@@ -43,7 +274,8 @@ class ParallelInterleaveDatasetParams : public DatasetParams {
         func_(std::move(func)),
         func_lib_(std::move(func_lib)),
         type_arguments_(std::move(type_arguments)),
-        deterministic_(deterministic) {
+        deterministic_(deterministic),
+        max_out_of_order_(max_out_of_order) {
     input_dataset_params_.push_back(absl::make_unique<T>(input_dataset_params));
     op_version_ = kOpVersion;
     name_utils::IteratorPrefixParams params;
@@ -90,7 +322,8 @@ class ParallelInterleaveDatasetParams : public DatasetParams {
                     {"Targuments", type_arguments_},
                     {"output_shapes", output_shapes_},
                     {"output_types", output_dtypes_},
-                    {"metadata", ""}};
+                    {"metadata", ""},
+                    {"max_out_of_order", max_out_of_order_}};
     return Status::OK();
   }
 
@@ -111,6 +344,7 @@ class ParallelInterleaveDatasetParams : public DatasetParams {
   std::vector<FunctionDef> func_lib_;
   DataTypeVector type_arguments_;
   std::string deterministic_;
+  int64_t max_out_of_order_;
 };
 
 class ParallelInterleaveDatasetOpTest : public DatasetOpsTestBase {};
@@ -529,6 +763,34 @@ ParallelInterleaveDatasetParamsWithInvalidPrefetchInputElements() {
       /*node_name=*/kNodeName);
 }
 
+// Results may not be returned out of order by a deterministic interleave.
+ParallelInterleaveDatasetParams
+ParallelInterleaveDatasetParamsWithDeterministicOutOfOrder() {
+  auto tensor_slice_dataset_params = TensorSliceDatasetParams(
+      /*components=*/{CreateTensor<int64_t>(TensorShape{3, 3, 1},
+                                            {0, 1, 2, 3, 4, 5, 6, 7, 8})},
+      /*node_name=*/"tensor_slice");
+  return ParallelInterleaveDatasetParams(
+      tensor_slice_dataset_params,
+      /*other_arguments=*/{},
+      /*cycle_length=*/3,
+      /*block_length=*/1,
+      /*buffer_output_elements=*/model::kAutotune,
+      /*prefetch_input_elements=*/model::kAutotune,
+      /*num_parallel_calls=*/3,
+      /*func=*/
+      MakeTensorSliceDatasetFunc(
+          DataTypeVector({DT_INT64}),
+          std::vector<PartialTensorShape>({PartialTensorShape({1})})),
+      /*func_lib=*/{test::function::MakeTensorSliceDataset()},
+      /*type_arguments=*/{},
+      /*output_dtypes=*/{DT_INT64},
+      /*output_shapes=*/{PartialTensorShape({1})},
+      /*deterministic=*/DeterminismPolicy::kDeterministic,
+      /*node_name=*/kNodeName,
+      /*max_out_of_order=*/2);
+}
+
 std::vector<GetNextTestCase<ParallelInterleaveDatasetParams>>
 GetNextTestCases() {
   return {{/*dataset_params=*/ParallelInterleaveDatasetParams1(),
@@ -760,6 +1022,208 @@ ITERATOR_SAVE_AND_RESTORE_TEST_P(ParallelInterleaveDatasetOpTest,
                                  ParallelInterleaveDatasetParams,
                                  IteratorSaveAndRestoreTestCases())
 
+FunctionDef MakeStragglerRangeDataset() {
+  return FunctionDefHelper::Define(
+      /*name=*/"MakeStragglerRangeDataset",
+      /*arg_def=*/{"start: int64", "stop: int64", "stall_at: int64"},
+      /*ret_def=*/{"y: variant"},
+      /*attr_def=*/{},
+      /*node_def=*/
+      {{/*ret=*/{"y"},
+        /*op=*/"StragglerRangeDataset",
+        /*arg=*/{"start", "stop", "stall_at"}}});
+}
+
+FunctionDef MakeStatefulStragglerRangeDataset() {
+  return FunctionDefHelper::Define(
+      /*name=*/"MakeStatefulStragglerRangeDataset",
+      /*arg_def=*/{"start: int64", "stop: int64", "stall_at: int64"},
+      /*ret_def=*/{"y: variant"},
+      /*attr_def=*/{},
+      /*node_def=*/
+      {{/*ret=*/{"stall"},
+        /*op=*/"StatefulInt64Identity",
+        /*arg=*/{"stall_at"}},
+       {/*ret=*/{"y"},
+        /*op=*/"StragglerRangeDataset",
+        /*arg=*/{"start", "stop", "stall"}}});
+}
+
+// Interleaves the ranges [0, 3), [10, 13) and [20, 23), the second of which
+// stalls before producing its element at index `stall_at`.
+ParallelInterleaveDatasetParams StragglerDatasetParams(
+    int64_t stall_at,
+    const std::string& deterministic = DeterminismPolicy::kDeterministic,
+    int64_t max_out_of_order = 0, bool stateful = false) {
+  auto tensor_slice_dataset_params = TensorSliceDatasetParams(
+      /*components=*/{CreateTensor<int64_t>(TensorShape{3}, {0, 10, 20}),
+                      CreateTensor<int64_t>(TensorShape{3}, {3, 13, 23}),
+                      CreateTensor<int64_t>(TensorShape{3}, {-1, stall_at, -1})},
+      /*node_name=*/"tensor_slice");
+  return ParallelInterleaveDatasetParams(
+      tensor_slice_dataset_params,
+      /*other_arguments=*/{},
+      /*cycle_length=*/3,
+      /*block_length=*/1,
+      /*buffer_output_elements=*/1,
+      /*prefetch_input_elements=*/0,
+      /*num_parallel_calls=*/3,
+      /*func=*/
+      FunctionDefHelper::FunctionRef(
+          /*name=*/stateful ? "MakeStatefulStragglerRangeDataset"
+                            : "MakeStragglerRangeDataset"),
+      /*func_lib=*/
+      {MakeStragglerRangeDataset(), MakeStatefulStragglerRangeDataset()},
+      /*type_arguments=*/{},
+      /*output_dtypes=*/{DT_INT64},
+      /*output_shapes=*/{PartialTensorShape({})},
+      /*deterministic=*/deterministic,
+      /*node_name=*/kNodeName, max_out_of_order);
+}
+
+class ParallelInterleaveStragglerTest : public ParallelInterleaveDatasetOpTest {
+ protected:
+  void TearDown() override {
+    // Unblocks the stalled iterators so that the interleave iterator can be
+    // destroyed.
+    ReleaseStragglers(std::numeric_limits<int64_t>::max());
+    unsetenv("TF_DATA_INTERLEAVE_STRAGGLER_TIMEOUT_MS");
+  }
+
+  Status GetNext(std::vector<int64_t>* outputs, bool* end_of_sequence) {
+    std::vector<Tensor> next;
+    TF_RETURN_IF_ERROR(
+        iterator_->GetNext(iterator_ctx_.get(), &next, end_of_sequence));
+    if (!*end_of_sequence) {
+      outputs->push_back(next[0].scalar<int64_t>()());
+    }
+    return Status::OK();
+  }
+
+  Status GetRemaining(std::vector<int64_t>* outputs) {
+    bool end_of_sequence = false;
+    while (!end_of_sequence) {
+      TF_RETURN_IF_ERROR(GetNext(outputs, &end_of_sequence));
+    }
+    return Status::OK();
+  }
+
+  const std::vector<int64_t> expected_outputs_ = {0, 10, 20, 1, 11,
+                                                  21, 2, 12, 22};
+};
+
+TEST_F(ParallelInterleaveStragglerTest, OutOfOrderResults) {
+  ResetStragglerState(/*num_stalling_iterators=*/1);
+  TF_ASSERT_OK(Initialize(StragglerDatasetParams(
+      /*stall_at=*/0, DeterminismPolicy::kDefault, /*max_out_of_order=*/2)));
+
+  // 10 is stalled, so the iterator returns up to two later results in its
+  // place rather than waiting for it.
+  std::vector<int64_t> outputs;
+  bool end_of_sequence = false;
+  for (int i = 0; i < 3; ++i) {
+    TF_ASSERT_OK(GetNext(&outputs, &end_of_sequence));
+    ASSERT_FALSE(end_of_sequence);
+  }
+  EXPECT_THAT(outputs, ::testing::Not(::testing::Contains(10)));
+
+  ReleaseStragglers(/*num_released=*/1);
+  TF_ASSERT_OK(GetRemaining(&outputs));
+  EXPECT_THAT(outputs, ::testing::UnorderedElementsAreArray(expected_outputs_));
+  // No result moves more than two places from its deterministic position.
+  for (int i = 0; i < outputs.size(); ++i) {
+    int position = std::find(expected_outputs_.begin(), expected_outputs_.end(),
+                             outputs[i]) -
+                   expected_outputs_.begin();
+    EXPECT_LE(std::abs(position - i), 2) << "for result " << outputs[i];
+  }
+}
+
+TEST_F(ParallelInterleaveStragglerTest, HedgeSupersedesStraggler) {
+  setenv("TF_DATA_INTERLEAVE_STRAGGLER_TIMEOUT_MS", "10", /*overwrite=*/1);
+  ResetStragglerState(/*num_stalling_iterators=*/1);
+  TF_ASSERT_OK(Initialize(StragglerDatasetParams(/*stall_at=*/1)));
+
+  // The iterator over [10, 13) stalls after producing 10. It is never
+  // released, so the results come from the hedged iterator that takes over.
+  std::vector<int64_t> outputs;
+  TF_ASSERT_OK(GetRemaining(&outputs));
+  EXPECT_EQ(outputs, expected_outputs_);
+  EXPECT_EQ(NumIterators(10), 2);
+}
+
+TEST_F(ParallelInterleaveStragglerTest, NoHedgeForStatefulFunction) {
+  setenv("TF_DATA_INTERLEAVE_STRAGGLER_TIMEOUT_MS", "10", /*overwrite=*/1);
+  ResetStragglerState(/*num_stalling_iterators=*/1);
+  TF_ASSERT_OK(Initialize(StragglerDatasetParams(
+      /*stall_at=*/1, DeterminismPolicy::kDeterministic,
+      /*max_out_of_order=*/0, /*stateful=*/true)));
+
+  std::vector<int64_t> outputs;
+  bool end_of_sequence = false;
+  for (int i = 0; i < 4; ++i) {
+    TF_ASSERT_OK(GetNext(&outputs, &end_of_sequence));
+  }
+  // The iterator over [10, 13) stalls before producing 11. Hedging would
+  // call the stateful function again, so the iterator waits for 11 instead.
+  {
+    std::unique_ptr<Thread> get_next(Env::Default()->StartThread(
+        ThreadOptions(), "get_next",
+        [&]() { TF_EXPECT_OK(GetNext(&outputs, &end_of_sequence)); }));
+    WaitForStragglers(/*num_stalled=*/1);
+    Env::Default()->SleepForMicroseconds(100 * 1000);
+    EXPECT_EQ(NumIterators(10), 1);
+    ReleaseStragglers(/*num_released=*/1);
+  }
+  TF_ASSERT_OK(GetRemaining(&outputs));
+  EXPECT_EQ(outputs, expected_outputs_);
+  EXPECT_EQ(NumIterators(10), 1);
+}
+
+TEST_F(ParallelInterleaveStragglerTest, SaveAndRestoreWithHedgeInFlight) {
+  setenv("TF_DATA_INTERLEAVE_STRAGGLER_TIMEOUT_MS", "10", /*overwrite=*/1);
+  ResetStragglerState(/*num_stalling_iterators=*/2);
+  auto dataset_params = StragglerDatasetParams(/*stall_at=*/1);
+  TF_ASSERT_OK(Initialize(dataset_params));
+
+  std::vector<int64_t> outputs;
+  bool end_of_sequence = false;
+  for (int i = 0; i < 4; ++i) {
+    TF_ASSERT_OK(GetNext(&outputs, &end_of_sequence));
+  }
+  // Both the iterator over [10, 13) and its hedge stall before producing 11.
+  // Releasing the original lets 11 through, with the hedge still in flight.
+  {
+    std::unique_ptr<Thread> get_next(Env::Default()->StartThread(
+        ThreadOptions(), "get_next",
+        [&]() { TF_EXPECT_OK(GetNext(&outputs, &end_of_sequence)); }));
+    WaitForStragglers(/*num_stalled=*/2);
+    ReleaseStragglers(/*num_released=*/1);
+  }
+  EXPECT_EQ(NumIterators(10), 2);
+
+  // Saving waits for the hedge, which is released shortly after.
+  std::unique_ptr<SerializationContext> serialization_ctx;
+  TF_ASSERT_OK(CreateSerializationContext(&serialization_ctx));
+  VariantTensorDataWriter writer;
+  {
+    std::unique_ptr<Thread> release(Env::Default()->StartThread(
+        ThreadOptions(), "release", []() {
+          Env::Default()->SleepForMicroseconds(50 * 1000);
+          ReleaseStragglers(/*num_released=*/2);
+        }));
+    TF_ASSERT_OK(iterator_->Save(serialization_ctx.get(), &writer));
+  }
+  std::vector<const VariantTensorData*> data;
+  writer.GetData(&data);
+  VariantTensorDataReader reader(data);
+  TF_ASSERT_OK(RestoreIterator(iterator_ctx_.get(), &reader,
+                               dataset_params.iterator_prefix(), *dataset_,
+                               &iterator_));
+  TF_ASSERT_OK(GetRemaining(&outputs));
+  EXPECT_EQ(outputs, expected_outputs_);
+}
+
 TEST_F(ParallelInterleaveDatasetOpTest, InvalidArguments) {
   std::vector<ParallelInterleaveDatasetParams> invalid_params = {
       ParallelInterleaveDatasetParamsWithInvalidCycleLength(),
@@ -767,6 +1231,7 @@ TEST_F(ParallelInterleaveDatasetOpTest, InvalidArguments) {
       ParallelInterleaveDatasetParamsWithInvalidNumParallelCalls(),
       ParallelInterleaveDatasetParamsWithInvalidBufferOutputElements(),
       ParallelInterleaveDatasetParamsWithInvalidPrefetchInputElements(),
+      ParallelInterleaveDatasetParamsWithDeterministicOutOfOrder(),
   };
   for (auto& dataset_params : invalid_params) {
     EXPECT_EQ(Initialize(dataset_params).code(),
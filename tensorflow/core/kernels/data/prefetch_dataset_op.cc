@@ -18,6 +18,7 @@ limitations under the License.
 
 #include "tensorflow/core/data/dataset_utils.h"
 #include "tensorflow/core/data/name_utils.h"
+#include "tensorflow/core/data/staging_pool.h"
 #include "tensorflow/core/data/stats_utils.h"
 #include "tensorflow/core/framework/dataset.h"
 #include "tensorflow/core/framework/metrics.h"
@@ -32,6 +33,7 @@ limitations under the License.
 #include "tensorflow/core/profiler/lib/traceme.h"
 #include "tensorflow/core/profiler/lib/traceme_encode.h"
 #include "tensorflow/core/protobuf/error_codes.pb.h"
+#include "tensorflow/core/util/env_var.h"
 
 namespace tensorflow {
 namespace data {
@@ -58,6 +60,20 @@ constexpr char kSizeSuffix[] = ".size";
 constexpr char kCodeSuffix[] = ".code";
 constexpr char kErrorMessageSuffix[] = ".error_message";
 
+// Returns whether prefetched elements are staged in page-locked host memory
+// from `StagingPool::Global()`. The environment is read when iterators are
+// created.
+bool StagingEnabled() {
+  bool enabled;
+  Status s = ReadBoolFromEnvVar("TF_DATA_PREFETCH_STAGING",
+                                /*default_val=*/false, &enabled);
+  if (!s.ok()) {
+    LOG(ERROR) << "Invalid TF_DATA_PREFETCH_STAGING: " << s;
+    return false;
+  }
+  return enabled;
+}
+
 }  // namespace
 
 class PrefetchDatasetOp::Dataset : public DatasetBase {
@@ -143,7 +159,8 @@ class PrefetchDatasetOp::Dataset : public DatasetBase {
           // autotuning optimization.
           buffer_size_(std::make_shared<model::SharedState>(
               legacy_autotune_ ? 0 : params.dataset->buffer_size_, mu_,
-              cond_var_)) {
+              cond_var_)),
+          staging_pool_(StagingEnabled() ? StagingPool::Global() : nullptr) {
       slack_us_ = 0;
     }
 
@@ -496,6 +513,11 @@ class PrefetchDatasetOp::Dataset : public DatasetBase {
               profiler::kInfo);
           buffer_element.status = input_impl_->GetNext(
               ctx.get(), &buffer_element.value, &end_of_sequence);
+          if (staging_pool_ && buffer_element.status.ok() &&
+              !end_of_sequence) {
+            buffer_element.status =
+                staging_pool_->Assemble(&buffer_element.value);
+          }
         }
         if (buffer_element.status.ok() && end_of_sequence) {
           mutex_lock l(*mu_);
@@ -581,6 +603,10 @@ class PrefetchDatasetOp::Dataset : public DatasetBase {
     // If legacy_autotune_ is false, identifies the maximum size of the buffer.
     const std::shared_ptr<model::SharedState> buffer_size_;
 
+    // If non-null, prefetched elements are assembled in buffers from this
+    // pool.
+    StagingPool* const staging_pool_;
+
     // Method for deregistering the cancellation callback.
     std::function<void()> deregister_fn_;
   };
@@ -12,7 +12,10 @@ limitations under the License.
 
 #include "tensorflow/core/kernels/data/prefetch_dataset_op.h"
 
+#include <stdlib.h>
+
 #include "tensorflow/core/data/dataset_test_base.h"
+#include "tensorflow/core/data/staging_pool.h"
 
 namespace tensorflow {
 namespace data {
@@ -331,6 +334,51 @@ TEST_F(PrefetchDatasetOpTest, InvalidBufferSize) {
   EXPECT_EQ(Initialize(dataset_params).code(), error::INVALID_ARGUMENT);
 }
 
+TEST_F(PrefetchDatasetOpTest, StagedBatchIsContiguous) {
+  setenv("TF_DATA_PREFETCH_STAGING", "true", /*overwrite=*/1);
+  auto tensor_slice_dataset_params = TensorSliceDatasetParams(
+      /*components=*/{CreateTensor<int64_t>(TensorShape{6, 2},
+                                            {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10,
+                                             11}),
+                      CreateTensor<float>(TensorShape{6}, {0, 1, 2, 3, 4, 5})},
+      /*node_name=*/"tensor_slice");
+  auto batch_dataset_params = BatchDatasetParams(
+      std::move(tensor_slice_dataset_params),
+      /*batch_size=*/3,
+      /*drop_remainder=*/true,
+      /*parallel_copy=*/false,
+      /*output_dtypes=*/{DT_INT64, DT_FLOAT},
+      /*output_shapes=*/{PartialTensorShape({3, 2}), PartialTensorShape({3})},
+      /*node_name=*/"batch");
+  auto dataset_params = PrefetchDatasetParams(
+      std::move(batch_dataset_params),
+      /*buffer_size=*/2,
+      /*output_dtypes=*/{DT_INT64, DT_FLOAT},
+      /*output_shapes=*/{PartialTensorShape({3, 2}), PartialTensorShape({3})},
+      /*slack_period=*/0,
+      /*legacy_autotune=*/true,
+      /*buffer_size_min=*/0,
+      /*node_name=*/kNodeName);
+  TF_ASSERT_OK(Initialize(dataset_params));
+  unsetenv("TF_DATA_PREFETCH_STAGING");
+  std::vector<Tensor> out_tensors;
+  bool end_of_sequence;
+  TF_ASSERT_OK(
+      iterator_->GetNext(iterator_ctx_.get(), &out_tensors, &end_of_sequence));
+  ASSERT_FALSE(end_of_sequence);
+  test::ExpectTensorEqual<int64_t>(
+      out_tensors[0],
+      CreateTensor<int64_t>(TensorShape{3, 2}, {0, 1, 2, 3, 4, 5}));
+  test::ExpectTensorEqual<float>(out_tensors[1],
+                                 CreateTensor<float>(TensorShape{3}, {0, 1, 2}));
+  // Both components of the batch are copied into one staging buffer.
+  EXPECT_TRUE(StagingPool::Global()->Contains(out_tensors[0]));
+  EXPECT_TRUE(StagingPool::Global()->Contains(out_tensors[1]));
+  EXPECT_EQ(out_tensors[1].tensor_data().data() -
+                out_tensors[0].tensor_data().data(),
+            Allocator::kAllocatorAlignment);
+}
+
 }  // namespace
 }  // namespace data
 }  // namespace tensorflow
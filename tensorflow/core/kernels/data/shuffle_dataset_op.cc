@@ -24,6 +24,7 @@ limitations under the License.
 #include "tensorflow/core/data/dataset_utils.h"
 #include "tensorflow/core/data/name_utils.h"
 #include "tensorflow/core/data/serialization_utils.h"
+#include "tensorflow/core/data/spilling_buffer.h"
 #include "tensorflow/core/framework/dataset.h"
 #include "tensorflow/core/framework/partial_tensor_shape.h"
 #include "tensorflow/core/framework/resource_mgr.h"
@@ -35,6 +36,7 @@ limitations under the License.
 #include "tensorflow/core/lib/random/random_distributions.h"
 #include "tensorflow/core/platform/errors.h"
 #include "tensorflow/core/platform/stringprintf.h"
+#include "tensorflow/core/util/env_var.h"
 
 namespace tensorflow {
 namespace data {
@@ -59,6 +61,9 @@ namespace data {
 
 const int64_t kLogIntervalMicros = 10 * 1000000;  // 10 seconds.
 const int64_t kMaxEpochsInBuffer = 3;
+// The number of elements that a spilling shuffle buffer draws ahead of
+// GetNext, so that the reads of the spilled elements overlap.
+const int64_t kNumSpilledElementsDrawnAhead = 8;
 
 constexpr char kNumRandomSamples[] = "num_random_samples";
 constexpr char kDataProduced[] = "data_produced";
@@ -70,12 +75,45 @@ constexpr char kSlicesStart[] = "slices_start";
 constexpr char kSlicesEnd[] = "slices_end";
 constexpr char kSeedGenerator[] = "SeedGenerator";
 constexpr char kEpochNumRandomSamples[] = "epoch_num_random_samples";
+constexpr char kSpilled[] = "spilled";
+constexpr char kDrawnElements[] = "drawn_elements";
 constexpr char kShuffleDatasetV1[] = "ShuffleDataset";
 constexpr char kShuffleDatasetV2[] = "ShuffleDatasetV2";
 constexpr char kShuffleDatasetV3[] = "ShuffleDatasetV3";
 constexpr char kShuffleAndRepeatDatasetV1[] = "ShuffleAndRepeatDataset";
 constexpr char kShuffleAndRepeatDatasetV2[] = "ShuffleAndRepeatDatasetV2";
 
+namespace {
+
+// Returns the local directory that shuffle buffers spill their elements to
+// when they hold more than `ShuffleMaxElementsInMemory()` elements, or an
+// empty string if shuffle buffers are kept in memory. The environment is read
+// when iterators are created, not cached for the process.
+std::string ShuffleSpillDirectory() {
+  std::string value;
+  Status s = ReadStringFromEnvVar("TF_DATA_SHUFFLE_SPILL_DIRECTORY",
+                                  /*default_val=*/"", &value);
+  if (!s.ok()) {
+    LOG(ERROR) << "Invalid TF_DATA_SHUFFLE_SPILL_DIRECTORY: " << s;
+    return "";
+  }
+  return value;
+}
+
+int64_t ShuffleMaxElementsInMemory() {
+  constexpr int64_t kDefaultMaxElementsInMemory = 10000;
+  int64_t value = kDefaultMaxElementsInMemory;
+  Status s = ReadInt64FromEnvVar("TF_DATA_SHUFFLE_MAX_ELEMENTS_IN_MEMORY",
+                                 kDefaultMaxElementsInMemory, &value);
+  if (!s.ok()) {
+    LOG(ERROR) << "Invalid TF_DATA_SHUFFLE_MAX_ELEMENTS_IN_MEMORY: " << s;
+    return kDefaultMaxElementsInMemory;
+  }
+  return value;
+}
+
+}  // namespace
+
 ShuffleDatasetOpBase::ShuffleDatasetOpBase(OpKernelConstruction* ctx)
     : UnaryDatasetOpKernel(ctx) {}
 
@@ -185,9 +223,15 @@ class ShuffleDatasetOpBase::ShuffleDatasetBase : public DatasetBase {
         : DatasetIterator<ShuffleDatasetBase>(params),
           seed_generator_(seed_generator),
           parent_generator_(seed_generator->seed(), seed_generator->seed2()),
-          generator_(&parent_generator_) {
-      buffer_ = absl::make_unique<std::vector<std::vector<Tensor>>>(
-          params.dataset->buffer_size_);
+          generator_(&parent_generator_),
+          spill_directory_(ShuffleSpillDirectory()),
+          max_elements_in_memory_(ShuffleMaxElementsInMemory()) {
+      if (ShouldSpill()) {
+        spilling_buffer_ = MakeSpillingBuffer();
+      } else {
+        buffer_ = absl::make_unique<std::vector<std::vector<Tensor>>>(
+            params.dataset->buffer_size_);
+      }
     }
 
     Status Initialize(IteratorContext* ctx) override {
@@ -201,6 +245,9 @@ class ShuffleDatasetOpBase::ShuffleDatasetBase : public DatasetBase {
                            std::vector<Tensor>* out_tensors,
                            bool* end_of_sequence) override {
       mutex_lock l(mu_);
+      if (spilling_buffer_) {
+        return GetNextFromSpillingBuffer(ctx, out_tensors, end_of_sequence);
+      }
       TF_RETURN_IF_ERROR(FillBuffer(ctx));
       if (num_elements_ == 0) {
         DCHECK(input_impl_ == nullptr);
@@ -265,7 +312,20 @@ class ShuffleDatasetOpBase::ShuffleDatasetBase : public DatasetBase {
       TF_RETURN_IF_ERROR(writer->WriteScalar(this->full_name(kEpoch), epoch_));
       TF_RETURN_IF_ERROR(
           writer->WriteScalar(this->full_name(kNumElements), num_elements_));
-      TF_RETURN_IF_ERROR(WriteElementsToCheckpoint(writer, prefix(), *buffer_));
+      if (spilling_buffer_) {
+        TF_RETURN_IF_ERROR(writer->WriteScalar(this->full_name(kSpilled), ""));
+        TF_RETURN_IF_ERROR(spilling_buffer_->Save(writer, prefix()));
+        std::vector<std::vector<Tensor>> drawn_elements;
+        for (const auto& element : drawn_) {
+          TF_RETURN_IF_ERROR(element->Wait());
+          drawn_elements.push_back(*element->tensors());
+        }
+        TF_RETURN_IF_ERROR(WriteElementsToCheckpoint(
+            writer, this->full_name(kDrawnElements), drawn_elements));
+      } else {
+        TF_RETURN_IF_ERROR(
+            WriteElementsToCheckpoint(writer, prefix(), *buffer_));
+      }
       TF_RETURN_IF_ERROR(
           writer->WriteScalar(this->full_name(kSlicesSize), slices_.size()));
       for (size_t i = 0; i < slices_.size(); ++i) {
@@ -320,13 +380,39 @@ class ShuffleDatasetOpBase::ShuffleDatasetBase : public DatasetBase {
             reader->ReadScalar(this->full_name(kSlicesSize), &temp));
         slices_size = static_cast<size_t>(temp);
       }
-      buffer_ = absl::make_unique<std::vector<std::vector<Tensor>>>();
-      TF_RETURN_IF_ERROR(
-          ReadElementsFromCheckpoint(ctx, reader, prefix(), buffer_.get()));
-      for (const auto& element : *buffer_) {
-        RecordBufferEnqueue(ctx, element);
+      if (reader->Contains(this->full_name(kSpilled)) != ShouldSpill()) {
+        return errors::FailedPrecondition(
+            ShouldSpill() ? "The shuffle buffer of the checkpoint was kept in "
+                            "memory, but this buffer is configured to spill "
+                            "to disk."
+                          : "The shuffle buffer of the checkpoint was spilled "
+                            "to disk, but this buffer is configured to be "
+                            "kept in memory.",
+            " Set TF_DATA_SHUFFLE_SPILL_DIRECTORY and "
+            "TF_DATA_SHUFFLE_MAX_ELEMENTS_IN_MEMORY as when the checkpoint "
+            "was saved.");
+      }
+      if (ShouldSpill()) {
+        spilling_buffer_ = MakeSpillingBuffer();
+        TF_RETURN_IF_ERROR(
+            spilling_buffer_->Restore(ctx->flr(), reader, prefix()));
+        std::vector<std::vector<Tensor>> drawn_elements;
+        TF_RETURN_IF_ERROR(ReadElementsFromCheckpoint(
+            ctx, reader, this->full_name(kDrawnElements), &drawn_elements));
+        drawn_.clear();
+        for (auto& element : drawn_elements) {
+          drawn_.push_back(
+              std::make_shared<SpillingBuffer::Element>(std::move(element)));
+        }
+      } else {
+        buffer_ = absl::make_unique<std::vector<std::vector<Tensor>>>();
+        TF_RETURN_IF_ERROR(
+            ReadElementsFromCheckpoint(ctx, reader, prefix(), buffer_.get()));
+        for (const auto& element : *buffer_) {
+          RecordBufferEnqueue(ctx, element);
+        }
+        buffer_->resize(dataset()->buffer_size_);
       }
-      buffer_->resize(dataset()->buffer_size_);
       slices_.clear();
       for (size_t i = 0; i < slices_size; ++i) {
         int64_t start;
@@ -369,6 +455,58 @@ class ShuffleDatasetOpBase::ShuffleDatasetBase : public DatasetBase {
       return out;
     }
 
+    // Whether the elements of the buffer are spilled to disk, which is the
+    // case when the buffer can hold more elements than allowed in memory.
+    bool ShouldSpill() const {
+      return !spill_directory_.empty() &&
+             dataset()->buffer_size_ > max_elements_in_memory_;
+    }
+
+    std::unique_ptr<SpillingBuffer> MakeSpillingBuffer() const {
+      return absl::make_unique<SpillingBuffer>(
+          Env::Default(), spill_directory_, dataset()->buffer_size_,
+          max_elements_in_memory_);
+    }
+
+    // Produces the elements of a spilling buffer. The elements are drawn
+    // `kNumSpilledElementsDrawnAhead` calls in advance, filling the buffer
+    // before each draw as GetNextInternal does, so that the spilled elements
+    // are read back in the background while the earlier ones are consumed.
+    Status GetNextFromSpillingBuffer(IteratorContext* ctx,
+                                     std::vector<Tensor>* out_tensors,
+                                     bool* end_of_sequence)
+        TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+      while (drawn_.size() < kNumSpilledElementsDrawnAhead) {
+        TF_RETURN_IF_ERROR(FillBuffer(ctx));
+        if (num_elements_ == 0) {
+          break;
+        }
+        ClearEmptySlices();
+        DCHECK(!slices_.empty());
+        int64_t offset =
+            Random() % (slices_.front()->end - slices_.front()->start);
+        int64_t index =
+            (slices_.front()->start + offset) % dataset()->buffer_size_;
+        drawn_.push_back(spilling_buffer_->Take(index));
+        spilling_buffer_->Swap(
+            index, slices_.front()->start % dataset()->buffer_size_);
+        slices_.front()->start++;
+        num_elements_--;
+      }
+      if (drawn_.empty()) {
+        DCHECK(input_impl_ == nullptr);
+        *end_of_sequence = true;
+        return Status::OK();
+      }
+      *end_of_sequence = false;
+      std::shared_ptr<SpillingBuffer::Element> element =
+          std::move(drawn_.front());
+      drawn_.pop_front();
+      TF_RETURN_IF_ERROR(element->Wait());
+      *out_tensors = std::move(*element->tensors());
+      return Status::OK();
+    }
+
     // Fills the shuffle buffer, preparing the buffer for sampling.
     Status FillBuffer(IteratorContext* ctx) TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
       int64_t start_micros = EnvTime::NowMicros();
@@ -388,7 +526,8 @@ class ShuffleDatasetOpBase::ShuffleDatasetBase : public DatasetBase {
         TF_RETURN_IF_ERROR(
             input_impl_->GetNext(ctx, &input_element, &end_of_input_sequence));
         if (!end_of_input_sequence) {
-          AddToShuffleBuffer(ctx, std::move(input_element));
+          TF_RETURN_IF_ERROR(
+              AddToShuffleBuffer(ctx, std::move(input_element)));
           continue;
         }
         input_impl_.reset();
@@ -420,7 +559,7 @@ class ShuffleDatasetOpBase::ShuffleDatasetBase : public DatasetBase {
         // 1`.
         return false;
       }
-      return num_elements_ < buffer_->size();
+      return num_elements_ < dataset()->buffer_size_;
     }
 
     Status PrepareNextEpoch(IteratorContext* ctx)
@@ -440,18 +579,25 @@ class ShuffleDatasetOpBase::ShuffleDatasetBase : public DatasetBase {
       return Status::OK();
     }
 
-    void AddToShuffleBuffer(IteratorContext* ctx, std::vector<Tensor>&& element)
+    Status AddToShuffleBuffer(IteratorContext* ctx,
+                              std::vector<Tensor>&& element)
         TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
       data_produced_ = true;
       if (num_elements_ == 0) {
         VLOG(1) << "Starting to fill up shuffle buffer of size: "
                 << BufferSizeString();
       }
-      this->RecordBufferEnqueue(ctx, element);
-      size_t index = slices_.back()->end % buffer_->size();
-      buffer_->at(index) = std::move(element);
+      size_t index = slices_.back()->end % dataset()->buffer_size_;
+      if (spilling_buffer_) {
+        // The memory of spilling buffers is bounded, so it is not recorded.
+        TF_RETURN_IF_ERROR(spilling_buffer_->Put(index, std::move(element)));
+      } else {
+        this->RecordBufferEnqueue(ctx, element);
+        buffer_->at(index) = std::move(element);
+      }
       num_elements_++;
       slices_.back()->end++;
+      return Status::OK();
     }
 
     void ClearEmptySlices() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
@@ -473,6 +619,12 @@ class ShuffleDatasetOpBase::ShuffleDatasetBase : public DatasetBase {
     SeedGenerator* const seed_generator_ TF_GUARDED_BY(mu_);  // Not owned.
     std::unique_ptr<std::vector<std::vector<Tensor>>> buffer_
         TF_GUARDED_BY(mu_);
+    // Replaces `buffer_` when the buffer is spilled to disk.
+    std::unique_ptr<SpillingBuffer> spilling_buffer_ TF_GUARDED_BY(mu_);
+    // The elements drawn from `spilling_buffer_` ahead of GetNext, in the
+    // order they are produced.
+    std::deque<std::shared_ptr<SpillingBuffer::Element>> drawn_
+        TF_GUARDED_BY(mu_);
     std::unique_ptr<IteratorBase> input_impl_ TF_GUARDED_BY(mu_) = nullptr;
     int64_t epoch_ TF_GUARDED_BY(mu_) = 0;
     int64_t num_elements_ TF_GUARDED_BY(mu_) = 0;
@@ -486,6 +638,9 @@ class ShuffleDatasetOpBase::ShuffleDatasetBase : public DatasetBase {
     random::PhiloxRandom parent_generator_ TF_GUARDED_BY(mu_);
     random::SingleSampleAdapter<random::PhiloxRandom> generator_
         TF_GUARDED_BY(mu_);
+    // Where and beyond how many elements the buffer spills to disk.
+    const std::string spill_directory_;
+    const int64_t max_elements_in_memory_;
     int64_t num_random_samples_ TF_GUARDED_BY(mu_) = 0;
     bool data_produced_ TF_GUARDED_BY(mu_) = false;
   };
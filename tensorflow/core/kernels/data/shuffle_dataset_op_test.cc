@@ -14,9 +14,11 @@ limitations under the License.
 #include <string>
 #include <utility>
 
+#include "absl/strings/match.h"
 #include "tensorflow/core/data/dataset_test_base.h"
 #include "tensorflow/core/data/dataset_utils.h"
 #include "tensorflow/core/data/serialization_utils.h"
+#include "tensorflow/core/lib/io/path.h"
 
 namespace tensorflow {
 namespace data {
@@ -554,6 +556,108 @@ INSTANTIATE_TEST_CASE_P(ShuffleDatasetOpTest,
                         ParameterizedIteratorSaveAndRestoreTest,
                         ::testing::ValuesIn(IteratorSaveAndRestoreTestCases()));
 
+// Runs the shuffle iterators with a spill directory and a memory budget
+// smaller than the shuffle buffer, so that their buffers spill to disk.
+class ShuffleDatasetOpSpillTest : public ShuffleDatasetOpTest {
+ protected:
+  void SetUp() override {
+    ShuffleDatasetOpTest::SetUp();
+    spill_directory_ = io::JoinPath(testing::TmpDir(), "shuffle_spill");
+    TF_ASSERT_OK(Env::Default()->RecursivelyCreateDir(spill_directory_));
+    setenv("TF_DATA_SHUFFLE_SPILL_DIRECTORY", spill_directory_.c_str(), 1);
+    setenv("TF_DATA_SHUFFLE_MAX_ELEMENTS_IN_MEMORY", "2", 1);
+  }
+
+  void TearDown() override {
+    unsetenv("TF_DATA_SHUFFLE_SPILL_DIRECTORY");
+    unsetenv("TF_DATA_SHUFFLE_MAX_ELEMENTS_IN_MEMORY");
+    ShuffleDatasetOpTest::TearDown();
+  }
+
+  // Reads the remaining elements of `iterator_`.
+  Status GetRemaining(std::vector<Tensor>* out_tensors) {
+    bool end_of_sequence = false;
+    while (!end_of_sequence) {
+      std::vector<Tensor> next;
+      TF_RETURN_IF_ERROR(
+          iterator_->GetNext(iterator_ctx_.get(), &next, &end_of_sequence));
+      out_tensors->insert(out_tensors->end(), next.begin(), next.end());
+    }
+    return Status::OK();
+  }
+
+  std::string spill_directory_;
+};
+
+ShuffleDatasetParams SpillingShuffleDatasetParams() {
+  return ShuffleDatasetParams(RangeDatasetParams(0, 20, 1),
+                              /*buffer_size=*/10,
+                              /*seed=*/1,
+                              /*seed2=*/2,
+                              /*count=*/1,
+                              /*reshuffle_each_iteration=*/false,
+                              /*output_dtypes=*/{DT_INT64},
+                              /*output_shapes=*/{PartialTensorShape({})},
+                              /*node_name=*/kShuffleNodeName);
+}
+
+TEST_F(ShuffleDatasetOpSpillTest, GetNext) {
+  auto dataset_params = SpillingShuffleDatasetParams();
+  TF_ASSERT_OK(Initialize(dataset_params));
+  std::vector<Tensor> out_tensors;
+  TF_ASSERT_OK(GetRemaining(&out_tensors));
+  TF_EXPECT_OK(ExpectEqual(
+      out_tensors,
+      CreateTensors<int64_t>(TensorShape({}),
+                             {{0},  {1},  {2},  {3},  {4},  {5},  {6},
+                              {7},  {8},  {9},  {10}, {11}, {12}, {13},
+                              {14}, {15}, {16}, {17}, {18}, {19}}),
+      /*compare_order=*/false));
+}
+
+TEST_F(ShuffleDatasetOpSpillTest, IteratorSaveAndRestore) {
+  auto dataset_params = SpillingShuffleDatasetParams();
+  TF_ASSERT_OK(Initialize(dataset_params));
+  std::vector<Tensor> expected_outputs;
+  TF_ASSERT_OK(GetRemaining(&expected_outputs));
+
+  std::unique_ptr<SerializationContext> serialization_ctx;
+  TF_ASSERT_OK(CreateSerializationContext(&serialization_ctx));
+  for (int breakpoint : {0, 3, 11}) {
+    TF_ASSERT_OK(dataset_->MakeIterator(iterator_ctx_.get(), /*parent=*/nullptr,
+                                        dataset_params.iterator_prefix(),
+                                        &iterator_));
+    std::vector<Tensor> out_tensors;
+    bool end_of_sequence = false;
+    for (int i = 0; i < breakpoint; ++i) {
+      std::vector<Tensor> next;
+      TF_ASSERT_OK(
+          iterator_->GetNext(iterator_ctx_.get(), &next, &end_of_sequence));
+      out_tensors.insert(out_tensors.end(), next.begin(), next.end());
+    }
+    VariantTensorDataWriter writer;
+    TF_ASSERT_OK(iterator_->Save(serialization_ctx.get(), &writer));
+    std::vector<const VariantTensorData*> data;
+    writer.GetData(&data);
+    // The checkpoint keeps copies of the spill files, so it restores after
+    // the iterator that wrote it, and its own spill files, are gone.
+    iterator_.reset();
+    std::vector<string> children;
+    TF_ASSERT_OK(Env::Default()->GetChildren(spill_directory_, &children));
+    for (const string& child : children) {
+      EXPECT_TRUE(absl::StartsWith(child, "checkpoint_")) << child;
+    }
+
+    VariantTensorDataReader reader(data);
+    TF_ASSERT_OK(RestoreIterator(iterator_ctx_.get(), &reader,
+                                 dataset_params.iterator_prefix(), *dataset_,
+                                 &iterator_));
+    TF_ASSERT_OK(GetRemaining(&out_tensors));
+    TF_EXPECT_OK(ExpectEqual(out_tensors, expected_outputs,
+                             /*compare_order=*/true));
+  }
+}
+
 TEST_F(ShuffleDatasetOpTest, InvalidArguments) {
   std::vector<ShuffleDatasetParams> dataset_params_vec(
       {ShuffleDatasetParamsWithInvalidBufferSize(),
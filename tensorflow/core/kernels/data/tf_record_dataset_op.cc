@@ -14,6 +14,9 @@ limitations under the License.
 ==============================================================================*/
 #include "tensorflow/core/kernels/data/tf_record_dataset_op.h"
 
+#include <algorithm>
+#include <vector>
+
 #include "tensorflow/core/data/name_utils.h"
 #include "tensorflow/core/framework/metrics.h"
 #include "tensorflow/core/framework/partial_tensor_shape.h"
@@ -35,6 +38,7 @@ namespace data {
 /* static */ constexpr const char* const TFRecordDatasetOp::kFileNames;
 /* static */ constexpr const char* const TFRecordDatasetOp::kCompressionType;
 /* static */ constexpr const char* const TFRecordDatasetOp::kBufferSize;
+/* static */ constexpr const char* const TFRecordDatasetOp::kPrefetchQueueDepth;
 
 constexpr char kCurrentFileIndex[] = "current_file_index";
 constexpr char kOffset[] = "offset";
@@ -42,6 +46,9 @@ constexpr char kGcsFsPrefix[] = "gs://";
 constexpr char kS3FsPrefix[] = "s3://";
 constexpr int64_t kCloudTpuBlockSize = 127LL << 20;  // 127MB.
 constexpr int64_t kS3BlockSize = kCloudTpuBlockSize;
+// Bounds on the batches of records whose checksums are verified together.
+constexpr int kMaxReadBatchRecords = 256;
+constexpr size_t kReadBatchBytes = 64 << 10;  // 64KB.
 
 bool is_cloud_tpu_gcs_fs() {
 #if (defined(PLATFORM_CLOUD_TPU) && defined(TPU_GCS_FS)) || \
@@ -54,7 +61,8 @@ bool is_cloud_tpu_gcs_fs() {
 class TFRecordDatasetOp::Dataset : public DatasetBase {
  public:
   explicit Dataset(OpKernelContext* ctx, std::vector<string> filenames,
-                   const string& compression_type, int64_t buffer_size)
+                   const string& compression_type, int64_t buffer_size,
+                   int64_t prefetch_queue_depth)
       : DatasetBase(DatasetContext(ctx)),
         filenames_(std::move(filenames)),
         compression_type_(compression_type),
@@ -62,7 +70,11 @@ class TFRecordDatasetOp::Dataset : public DatasetBase {
             compression_type)) {
     if (buffer_size > 0) {
       options_.buffer_size = buffer_size;
+      options_.prefetch_block_size = buffer_size;
     }
+    // Keeps up to `prefetch_queue_depth` block reads of `buffer_size` bytes
+    // outstanding per file; 0 reads the files synchronously.
+    options_.prefetch_queue_depth = prefetch_queue_depth;
   }
 
   std::unique_ptr<IteratorBase> MakeIteratorInternal(
@@ -102,8 +114,11 @@ class TFRecordDatasetOp::Dataset : public DatasetBase {
     TF_RETURN_IF_ERROR(b->AddScalar(compression_type_, &compression_type));
     Node* buffer_size = nullptr;
     TF_RETURN_IF_ERROR(b->AddScalar(options_.buffer_size, &buffer_size));
+    AttrValue prefetch_queue_depth;
+    b->BuildAttrValue(options_.prefetch_queue_depth, &prefetch_queue_depth);
     TF_RETURN_IF_ERROR(b->AddDataset(
-        this, {filenames, compression_type, buffer_size}, output));
+        this, {filenames, compression_type, buffer_size},
+        {std::make_pair(kPrefetchQueueDepth, prefetch_queue_depth)}, output));
     return Status::OK();
   }
 
@@ -121,19 +136,24 @@ class TFRecordDatasetOp::Dataset : public DatasetBase {
       do {
         // We are currently processing a file, so try to read the next record.
         if (reader_) {
-          out_tensors->emplace_back(ctx->allocator({}), DT_STRING,
-                                    TensorShape({}));
-          Status s =
-              reader_->ReadRecord(&out_tensors->back().scalar<tstring>()());
-          if (s.ok()) {
+          if (next_record_ == records_.size() && read_status_.ok()) {
+            ReadRecordsLocked();
+          }
+          if (next_record_ < records_.size()) {
+            tstring& record = records_[next_record_++];
+            next_offset_ +=
+                io::RecordReader::kHeaderSize + record.size() +
+                io::RecordReader::kFooterSize;
             static monitoring::CounterCell* bytes_counter =
                 metrics::GetTFDataBytesReadCounter(kDatasetType);
-            bytes_counter->IncrementBy(
-                out_tensors->back().scalar<tstring>()().size());
+            bytes_counter->IncrementBy(record.size());
+            out_tensors->emplace_back(ctx->allocator({}), DT_STRING,
+                                      TensorShape({}));
+            out_tensors->back().scalar<tstring>()() = std::move(record);
             *end_of_sequence = false;
             return Status::OK();
           }
-          out_tensors->pop_back();
+          Status s = read_status_;
           if (!errors::IsOutOfRange(s)) {
             // In case of other errors e.g., DataLoss, we still move forward
             // the file index so that it works with ignore_errors.
@@ -167,9 +187,23 @@ class TFRecordDatasetOp::Dataset : public DatasetBase {
         // We are currently processing a file, so try to skip reading
         // the next (num_to_skip - *num_skipped) record.
         if (reader_) {
-          int last_num_skipped;
-          Status s = reader_->SkipRecords(num_to_skip - *num_skipped,
-                                          &last_num_skipped);
+          // Skip the records that have already been read first.
+          while (next_record_ < records_.size() && *num_skipped < num_to_skip) {
+            next_offset_ += io::RecordReader::kHeaderSize +
+                            records_[next_record_++].size() +
+                            io::RecordReader::kFooterSize;
+            ++*num_skipped;
+          }
+          if (*num_skipped == num_to_skip) {
+            *end_of_sequence = false;
+            return Status::OK();
+          }
+          int last_num_skipped = 0;
+          Status s = read_status_;
+          if (s.ok()) {
+            s = reader_->SkipRecords(num_to_skip - *num_skipped,
+                                     &last_num_skipped);
+          }
           *num_skipped += last_num_skipped;
           if (s.ok()) {
             *end_of_sequence = false;
@@ -214,7 +248,7 @@ class TFRecordDatasetOp::Dataset : public DatasetBase {
 
       if (reader_) {
         TF_RETURN_IF_ERROR(
-            writer->WriteScalar(full_name(kOffset), reader_->TellOffset()));
+            writer->WriteScalar(full_name(kOffset), TellOffsetLocked()));
       }
       return Status::OK();
     }
@@ -257,11 +291,51 @@ class TFRecordDatasetOp::Dataset : public DatasetBase {
     void ResetStreamsLocked() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
       reader_.reset();
       file_.reset();
+      records_.clear();
+      next_record_ = 0;
+      read_status_ = Status::OK();
+    }
+
+    // Reads the next batch of records of the current file into `records_`,
+    // so that their checksums are verified together. The batch is sized to
+    // hold about `kReadBatchBytes` of records like the previous one, since
+    // batching only pays off for records that are small enough to stay in
+    // cache. The status of the read is kept in `read_status_` and returned
+    // once the records read before a failure have been consumed.
+    void ReadRecordsLocked() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+      int max_records = kMaxReadBatchRecords;
+      if (!records_.empty()) {
+        size_t batch_bytes = 0;
+        for (const tstring& record : records_) batch_bytes += record.size();
+        const size_t record_bytes =
+            std::max<size_t>(1, batch_bytes / records_.size());
+        max_records = static_cast<int>(std::max<size_t>(
+            1, std::min<size_t>(kMaxReadBatchRecords,
+                                kReadBatchBytes / record_bytes)));
+      }
+      next_offset_ = reader_->TellOffset();
+      next_record_ = 0;
+      read_status_ = reader_->ReadRecords(max_records, &records_);
+    }
+
+    // Returns the offset of the next record to be produced, which precedes
+    // the records that have been read but not produced yet.
+    uint64 TellOffsetLocked() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+      return next_record_ < records_.size() ? next_offset_
+                                            : reader_->TellOffset();
     }
 
     mutex mu_;
     size_t current_file_index_ TF_GUARDED_BY(mu_) = 0;
 
+    // Records of the current file that have been read but not all produced
+    // yet, and the index and offset of the next one to produce.
+    std::vector<tstring> records_ TF_GUARDED_BY(mu_);
+    size_t next_record_ TF_GUARDED_BY(mu_) = 0;
+    uint64 next_offset_ TF_GUARDED_BY(mu_) = 0;
+    // Status of the last read of `records_`.
+    Status read_status_ TF_GUARDED_BY(mu_);
+
     // `reader_` will borrow the object that `file_` points to, so
     // we must destroy `reader_` before `file_`.
     std::unique_ptr<RandomAccessFile> file_ TF_GUARDED_BY(mu_);
@@ -274,7 +348,15 @@ class TFRecordDatasetOp::Dataset : public DatasetBase {
 };
 
 TFRecordDatasetOp::TFRecordDatasetOp(OpKernelConstruction* ctx)
-    : DatasetOpKernel(ctx) {}
+    : DatasetOpKernel(ctx) {
+  if (ctx->HasAttr(kPrefetchQueueDepth)) {
+    OP_REQUIRES_OK(ctx,
+                   ctx->GetAttr(kPrefetchQueueDepth, &prefetch_queue_depth_));
+    OP_REQUIRES(ctx, prefetch_queue_depth_ >= 0,
+                errors::InvalidArgument(
+                    "`prefetch_queue_depth` must be >= 0 (0 == no prefetching)"));
+  }
+}
 
 void TFRecordDatasetOp::MakeDataset(OpKernelContext* ctx,
                                     DatasetBase** output) {
@@ -322,8 +404,8 @@ void TFRecordDatasetOp::MakeDataset(OpKernelContext* ctx,
     buffer_size = kS3BlockSize;
   }
 
-  *output =
-      new Dataset(ctx, std::move(filenames), compression_type, buffer_size);
+  *output = new Dataset(ctx, std::move(filenames), compression_type,
+                       buffer_size, prefetch_queue_depth_);
 }
 
 namespace {
@@ -43,6 +43,12 @@ inline uint32 Value(const char* data, size_t n) { return Extend(0, data, n); }
 inline uint32 Value(const absl::Cord& cord) { return Extend(0, cord); }
 #endif
 
+// Sets crcs[i] to Value(data[i], sizes[i]) for each i in [0, n). The crcs of
+// several buffers are computed at once, which is faster than calling Value()
+// on each of many small buffers.
+extern void Values(int n, const char* const* data, const size_t* sizes,
+                   uint32* crcs);
+
 static const uint32 kMaskDelta = 0xa282ead8ul;
 
 // Return a masked representation of crc.
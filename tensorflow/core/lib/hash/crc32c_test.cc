@@ -14,6 +14,10 @@ limitations under the License.
 ==============================================================================*/
 
 #include "tensorflow/core/lib/hash/crc32c.h"
+
+#include <string>
+#include <vector>
+
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/platform/test_benchmark.h"
@@ -62,6 +66,43 @@ TEST(CRC, Extend) {
   ASSERT_EQ(Value("hello world", 11), Extend(Value("hello ", 6), "world", 5));
 }
 
+TEST(CRC, LargeBuffers) {
+  std::string input(100000, 0);
+  for (int i = 0; i < input.size(); ++i) {
+    input[i] = static_cast<char>(i * 7 + i / 256);
+  }
+  // Extending by small pieces does not interleave streams.
+  for (int size : {767, 768, 1000, 24575, 24576, 50000, 100000}) {
+    for (int offset : {0, 3}) {
+      uint32 expected = 0;
+      for (int i = offset; i < size; i += 100) {
+        expected = Extend(expected, input.data() + i, std::min(100, size - i));
+      }
+      EXPECT_EQ(expected, Value(input.data() + offset, size - offset)) << size;
+    }
+  }
+}
+
+TEST(CRC, BatchedValues) {
+  std::string input(10000, 0);
+  for (int i = 0; i < input.size(); ++i) {
+    input[i] = static_cast<char>(i * 13);
+  }
+  std::vector<const char*> data;
+  std::vector<size_t> sizes;
+  for (int i = 0; i < 20; ++i) {
+    data.push_back(input.data() + i * 7);
+    sizes.push_back((i * 173) % 1000);
+  }
+  for (int n = 0; n <= data.size(); ++n) {
+    std::vector<uint32> crcs(n);
+    Values(n, data.data(), sizes.data(), crcs.data());
+    for (int i = 0; i < n; ++i) {
+      EXPECT_EQ(Value(data[i], sizes[i]), crcs[i]) << i;
+    }
+  }
+}
+
 TEST(CRC, Mask) {
   uint32 crc = Value("foo", 3);
   ASSERT_NE(crc, Mask(crc));
@@ -93,5 +134,32 @@ static void BM_CRC(::testing::benchmark::State& state) {
 }
 BENCHMARK(BM_CRC)->Range(1, 256 * 1024);
 
+// Computes the crcs of 64 buffers of the given size, one at a time if the
+// second argument is 0, or in one batch otherwise.
+static void BM_CRCValues(::testing::benchmark::State& state) {
+  const int len = state.range(0);
+  const bool batched = state.range(1);
+  constexpr int kNumBuffers = 64;
+  std::string input(kNumBuffers * len, 'x');
+  std::vector<const char*> data;
+  std::vector<size_t> sizes(kNumBuffers, len);
+  for (int i = 0; i < kNumBuffers; ++i) {
+    data.push_back(input.data() + i * len);
+  }
+  std::vector<uint32> crcs(kNumBuffers);
+  for (auto s : state) {
+    if (batched) {
+      Values(kNumBuffers, data.data(), sizes.data(), crcs.data());
+    } else {
+      for (int i = 0; i < kNumBuffers; ++i) {
+        crcs[i] = Value(data[i], sizes[i]);
+      }
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * kNumBuffers * len);
+  VLOG(1) << crcs[0];
+}
+BENCHMARK(BM_CRCValues)->RangePair(16, 4096, 0, 1);
+
 }  // namespace crc32c
 }  // namespace tensorflow
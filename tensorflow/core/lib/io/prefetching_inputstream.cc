@@ -0,0 +1,191 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/lib/io/prefetching_inputstream.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/threadpool.h"
+
+namespace tensorflow {
+namespace io {
+
+namespace {
+
+// The reads are mostly waiting on the file system, so the shared pool has more
+// threads than there are cores.
+constexpr int kNumDefaultPrefetchThreads = 32;
+
+void RunOnDefaultThreadPool(std::function<void()> fn) {
+  static thread::ThreadPool* pool = new thread::ThreadPool(
+      Env::Default(), "prefetching_inputstream", kNumDefaultPrefetchThreads);
+  pool->Schedule(std::move(fn));
+}
+
+}  // namespace
+
+struct PrefetchingInputStream::Block {
+  explicit Block(int64_t offset, int64_t size)
+      : offset(offset), buffer(new char[size]) {}
+
+  const int64_t offset;
+  std::unique_ptr<char[]> buffer;
+  // The bytes read, which may not point into `buffer`. Set when `done`.
+  StringPiece data;
+  Status status;
+  // Guarded by the `mu_` of the stream.
+  bool done = false;
+};
+
+PrefetchingInputStream::PrefetchingInputStream(RandomAccessFile* file,
+                                               int64_t block_size,
+                                               int queue_depth, Runner runner)
+    : file_(file),
+      block_size_(block_size),
+      queue_depth_(queue_depth),
+      runner_(runner ? std::move(runner) : RunOnDefaultThreadPool) {
+  DCHECK_GT(block_size_, 0);
+  DCHECK_GT(queue_depth_, 0);
+}
+
+PrefetchingInputStream::~PrefetchingInputStream() {
+  mutex_lock l(mu_);
+  while (num_outstanding_ > 0) {
+    cond_var_.wait(l);
+  }
+}
+
+void PrefetchingInputStream::FillQueue() {
+  if (queue_.empty()) {
+    next_offset_ = pos_;
+  }
+  while (!eof_ && static_cast<int>(queue_.size()) < queue_depth_) {
+    auto block = std::make_shared<Block>(next_offset_, block_size_);
+    next_offset_ += block_size_;
+    queue_.push_back(block);
+    {
+      mutex_lock l(mu_);
+      ++num_outstanding_;
+    }
+    runner_([this, block]() {
+      StringPiece data;
+      Status s = file_->Read(block->offset, block_size_, &data,
+                             block->buffer.get());
+      mutex_lock l(mu_);
+      block->data = data;
+      block->status = s;
+      block->done = true;
+      --num_outstanding_;
+      cond_var_.notify_all();
+    });
+  }
+}
+
+Status PrefetchingInputStream::CurrentBlock(std::shared_ptr<Block>* block) {
+  while (true) {
+    FillQueue();
+    if (queue_.empty()) {
+      return errors::OutOfRange("reached end of file");
+    }
+    const std::shared_ptr<Block>& front = queue_.front();
+    {
+      mutex_lock l(mu_);
+      while (!front->done) {
+        cond_var_.wait(l);
+      }
+    }
+    if (!front->status.ok() && !errors::IsOutOfRange(front->status)) {
+      return front->status;
+    }
+    const bool last =
+        static_cast<int64_t>(front->data.size()) < block_size_;
+    if (last) {
+      // The blocks after this one are past the end of the file.
+      eof_ = true;
+      queue_.resize(1);
+    }
+    if (pos_ < front->offset + static_cast<int64_t>(front->data.size())) {
+      *block = front;
+      return Status::OK();
+    }
+    if (last) {
+      return errors::OutOfRange("reached end of file");
+    }
+    queue_.pop_front();
+  }
+}
+
+Status PrefetchingInputStream::ReadNBytes(int64_t bytes_to_read,
+                                          tstring* result) {
+  if (bytes_to_read < 0) {
+    return errors::InvalidArgument("Cannot read negative number of bytes");
+  }
+  result->clear();
+  result->resize_uninitialized(bytes_to_read);
+  char* dst = &(*result)[0];
+  int64_t bytes_read = 0;
+  while (bytes_read < bytes_to_read) {
+    std::shared_ptr<Block> block;
+    Status s = CurrentBlock(&block);
+    if (!s.ok()) {
+      result->resize(bytes_read);
+      return s;
+    }
+    const int64_t start = pos_ - block->offset;
+    const int64_t n = std::min<int64_t>(bytes_to_read - bytes_read,
+                                        block->data.size() - start);
+    memcpy(dst + bytes_read, block->data.data() + start, n);
+    bytes_read += n;
+    pos_ += n;
+  }
+  return Status::OK();
+}
+
+Status PrefetchingInputStream::SkipNBytes(int64_t bytes_to_skip) {
+  if (bytes_to_skip < 0) {
+    return errors::InvalidArgument("Can't skip a negative number of bytes");
+  }
+  const int64_t target = pos_ + bytes_to_skip;
+  if (!eof_ && target > next_offset_) {
+    // Checks that the target is within the file without reading up to it.
+    char scratch;
+    StringPiece data;
+    Status s = file_->Read(target - 1, 1, &data, &scratch);
+    if ((s.ok() || errors::IsOutOfRange(s)) && data.size() == 1) {
+      queue_.clear();
+      pos_ = target;
+      return Status::OK();
+    }
+  }
+  while (pos_ < target) {
+    std::shared_ptr<Block> block;
+    TF_RETURN_IF_ERROR(CurrentBlock(&block));
+    pos_ = std::min<int64_t>(target, block->offset + block->data.size());
+  }
+  return Status::OK();
+}
+
+Status PrefetchingInputStream::Reset() {
+  queue_.clear();
+  eof_ = false;
+  pos_ = 0;
+  return Status::OK();
+}
+
+}  // namespace io
+}  // namespace tensorflow
@@ -0,0 +1,97 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_LIB_IO_PREFETCHING_INPUTSTREAM_H_
+#define TENSORFLOW_CORE_LIB_IO_PREFETCHING_INPUTSTREAM_H_
+
+#include <deque>
+#include <functional>
+#include <memory>
+
+#include "tensorflow/core/lib/io/inputstream_interface.h"
+#include "tensorflow/core/platform/file_system.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+
+namespace tensorflow {
+namespace io {
+
+// Reads a RandomAccessFile sequentially, keeping up to `queue_depth` reads of
+// `block_size` bytes outstanding ahead of the current position. The reads run
+// concurrently on `runner`, so the stream is bound by the bandwidth of the
+// file system rather than by the latency of each read. At most
+// `queue_depth * block_size` bytes are in flight or buffered at a time.
+//
+// Skipping within the prefetched range consumes the buffered blocks. Skipping
+// beyond it, or calling Reset(), discards them and restarts prefetching at the
+// new position.
+//
+// A given instance of PrefetchingInputStream is NOT safe for concurrent use by
+// multiple threads.
+class PrefetchingInputStream : public InputStreamInterface {
+ public:
+  using Runner = std::function<void(std::function<void()>)>;
+
+  // Does not take ownership of 'file', which must outlive *this. If `runner`
+  // is not set, the reads run on a thread pool shared by all the streams of
+  // the process.
+  PrefetchingInputStream(RandomAccessFile* file, int64_t block_size,
+                         int queue_depth, Runner runner = nullptr);
+
+  // Waits for the outstanding reads to finish.
+  ~PrefetchingInputStream() override;
+
+  Status ReadNBytes(int64_t bytes_to_read, tstring* result) override;
+
+  Status SkipNBytes(int64_t bytes_to_skip) override;
+
+  int64_t Tell() const override { return pos_; }
+
+  Status Reset() override;
+
+ private:
+  struct Block;
+
+  // Schedules reads until `queue_depth_` blocks are queued.
+  void FillQueue();
+
+  // Waits for the block containing `pos_` and returns it in `*block`. Returns
+  // OUT_OF_RANGE if `pos_` is at the end of the file, or the error of the
+  // read of the block.
+  Status CurrentBlock(std::shared_ptr<Block>* block);
+
+  RandomAccessFile* const file_;  // Not owned.
+  const int64_t block_size_;
+  const int queue_depth_;
+  const Runner runner_;
+
+  int64_t pos_ = 0;
+  // The offset of the next block to read.
+  int64_t next_offset_ = 0;
+  // True if the last queued block ends at the end of the file.
+  bool eof_ = false;
+  std::deque<std::shared_ptr<Block>> queue_;
+
+  mutex mu_;
+  condition_variable cond_var_;
+  int num_outstanding_ TF_GUARDED_BY(mu_) = 0;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(PrefetchingInputStream);
+};
+
+}  // namespace io
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_LIB_IO_PREFETCHING_INPUTSTREAM_H_
@@ -0,0 +1,133 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/lib/io/prefetching_inputstream.h"
+
+#include <vector>
+
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace io {
+namespace {
+
+static std::vector<int> BlockSizes() { return {1, 2, 3, 4, 5, 10, 11, 64}; }
+
+TEST(PrefetchingInputStream, ReadNBytes) {
+  Env* env = Env::Default();
+  string fname = testing::TmpDir() + "/prefetching_inputstream_test";
+  TF_ASSERT_OK(WriteStringToFile(env, fname, "0123456789"));
+
+  std::unique_ptr<RandomAccessFile> file;
+  TF_ASSERT_OK(env->NewRandomAccessFile(fname, &file));
+  for (int block_size : BlockSizes()) {
+    for (int queue_depth : {1, 2, 8}) {
+      tstring read;
+      PrefetchingInputStream in(file.get(), block_size, queue_depth);
+      TF_ASSERT_OK(in.ReadNBytes(3, &read));
+      EXPECT_EQ(read, "012");
+      EXPECT_EQ(3, in.Tell());
+      TF_ASSERT_OK(in.ReadNBytes(0, &read));
+      EXPECT_EQ(read, "");
+      EXPECT_EQ(3, in.Tell());
+      TF_ASSERT_OK(in.ReadNBytes(5, &read));
+      EXPECT_EQ(read, "34567");
+      EXPECT_EQ(8, in.Tell());
+      EXPECT_TRUE(errors::IsOutOfRange(in.ReadNBytes(20, &read)));
+      EXPECT_EQ(read, "89");
+      EXPECT_EQ(10, in.Tell());
+      EXPECT_TRUE(errors::IsOutOfRange(in.ReadNBytes(1, &read)));
+      EXPECT_EQ(read, "");
+      EXPECT_EQ(10, in.Tell());
+    }
+  }
+}
+
+TEST(PrefetchingInputStream, SkipNBytes) {
+  Env* env = Env::Default();
+  string fname = testing::TmpDir() + "/prefetching_inputstream_test";
+  TF_ASSERT_OK(WriteStringToFile(env, fname, "0123456789"));
+
+  std::unique_ptr<RandomAccessFile> file;
+  TF_ASSERT_OK(env->NewRandomAccessFile(fname, &file));
+  for (int block_size : BlockSizes()) {
+    for (int queue_depth : {1, 2, 8}) {
+      tstring read;
+      PrefetchingInputStream in(file.get(), block_size, queue_depth);
+      TF_ASSERT_OK(in.SkipNBytes(3));
+      EXPECT_EQ(3, in.Tell());
+      TF_ASSERT_OK(in.ReadNBytes(2, &read));
+      EXPECT_EQ(read, "34");
+      TF_ASSERT_OK(in.SkipNBytes(0));
+      EXPECT_EQ(5, in.Tell());
+      TF_ASSERT_OK(in.SkipNBytes(3));
+      EXPECT_EQ(8, in.Tell());
+      TF_ASSERT_OK(in.ReadNBytes(1, &read));
+      EXPECT_EQ(read, "8");
+      EXPECT_TRUE(errors::IsOutOfRange(in.SkipNBytes(5)));
+      EXPECT_EQ(10, in.Tell());
+
+      TF_ASSERT_OK(in.Reset());
+      EXPECT_EQ(0, in.Tell());
+      TF_ASSERT_OK(in.ReadNBytes(4, &read));
+      EXPECT_EQ(read, "0123");
+      TF_ASSERT_OK(in.SkipNBytes(6));
+      EXPECT_EQ(10, in.Tell());
+      EXPECT_TRUE(errors::IsOutOfRange(in.ReadNBytes(1, &read)));
+    }
+  }
+}
+
+TEST(PrefetchingInputStream, KeepsQueueDepthReadsOutstanding) {
+  Env* env = Env::Default();
+  string fname = testing::TmpDir() + "/prefetching_inputstream_test";
+  TF_ASSERT_OK(WriteStringToFile(env, fname, "0123456789"));
+
+  std::unique_ptr<RandomAccessFile> file;
+  TF_ASSERT_OK(env->NewRandomAccessFile(fname, &file));
+  int num_reads = 0;
+  auto runner = [&num_reads](std::function<void()> fn) {
+    ++num_reads;
+    fn();
+  };
+  tstring read;
+  PrefetchingInputStream in(file.get(), /*block_size=*/2, /*queue_depth=*/3,
+                            runner);
+  EXPECT_EQ(num_reads, 0);
+  TF_ASSERT_OK(in.ReadNBytes(1, &read));
+  EXPECT_EQ(read, "0");
+  EXPECT_EQ(num_reads, 3);
+  // Moving past the first block schedules the read of the fourth one.
+  TF_ASSERT_OK(in.ReadNBytes(2, &read));
+  EXPECT_EQ(read, "12");
+  EXPECT_EQ(num_reads, 4);
+  // Skipping beyond the prefetched blocks restarts prefetching.
+  TF_ASSERT_OK(in.SkipNBytes(6));
+  EXPECT_EQ(9, in.Tell());
+  EXPECT_EQ(num_reads, 4);
+  TF_ASSERT_OK(in.ReadNBytes(1, &read));
+  EXPECT_EQ(read, "9");
+  EXPECT_EQ(num_reads, 7);
+  // No more reads are scheduled after the end of the file.
+  EXPECT_TRUE(errors::IsOutOfRange(in.ReadNBytes(1, &read)));
+  EXPECT_TRUE(errors::IsOutOfRange(in.ReadNBytes(1, &read)));
+  EXPECT_EQ(num_reads, 7);
+}
+
+}  // namespace
+}  // namespace io
+}  // namespace tensorflow
@@ -22,6 +22,7 @@ limitations under the License.
 #include "tensorflow/core/lib/hash/crc32c.h"
 #include "tensorflow/core/lib/io/buffered_inputstream.h"
 #include "tensorflow/core/lib/io/compression.h"
+#include "tensorflow/core/lib/io/prefetching_inputstream.h"
 #include "tensorflow/core/lib/io/random_inputstream.h"
 #include "tensorflow/core/platform/env.h"
 
@@ -59,7 +60,11 @@ RecordReader::RecordReader(RandomAccessFile* file,
     : options_(options),
       input_stream_(new RandomAccessInputStream(file)),
       last_read_failed_(false) {
-  if (options.buffer_size > 0) {
+  if (options.prefetch_queue_depth > 0) {
+    input_stream_.reset(new PrefetchingInputStream(
+        file, options.prefetch_block_size, options.prefetch_queue_depth,
+        options.prefetch_runner));
+  } else if (options.buffer_size > 0) {
     input_stream_.reset(new BufferedInputStream(input_stream_.release(),
                                                 options.buffer_size, true));
   }
@@ -85,12 +90,13 @@ RecordReader::RecordReader(RandomAccessFile* file,
 #endif
 }
 
-// Read n+4 bytes from file, verify that checksum of first n bytes is
-// stored in the last 4 bytes and store the first n bytes in *result.
+// Read n+4 bytes from file, store the first n bytes in *result and the
+// last 4 bytes, the masked checksum of the first n bytes, in *masked_crc.
 //
 // offset corresponds to the user-provided value to ReadRecord()
 // and is used only in error messages.
-Status RecordReader::ReadChecksummed(uint64 offset, size_t n, tstring* result) {
+Status RecordReader::ReadWithChecksum(uint64 offset, size_t n, tstring* result,
+                                      uint32* masked_crc) {
   if (n >= SIZE_MAX - sizeof(uint32)) {
     return errors::DataLoss("record size too large");
   }
@@ -106,11 +112,22 @@ Status RecordReader::ReadChecksummed(uint64 offset, size_t n, tstring* result) {
     }
   }
 
-  const uint32 masked_crc = core::DecodeFixed32(result->data() + n);
+  *masked_crc = core::DecodeFixed32(result->data() + n);
+  result->resize(n);
+  return Status::OK();
+}
+
+// Read n+4 bytes from file, verify that checksum of first n bytes is
+// stored in the last 4 bytes and store the first n bytes in *result.
+//
+// offset corresponds to the user-provided value to ReadRecord()
+// and is used only in error messages.
+Status RecordReader::ReadChecksummed(uint64 offset, size_t n, tstring* result) {
+  uint32 masked_crc;
+  TF_RETURN_IF_ERROR(ReadWithChecksum(offset, n, result, &masked_crc));
   if (crc32c::Unmask(masked_crc) != crc32c::Value(result->data(), n)) {
     return errors::DataLoss("corrupted record at ", offset);
   }
-  result->resize(n);
   return Status::OK();
 }
 
@@ -194,7 +211,12 @@ Status RecordReader::ReadRecord(uint64* offset, tstring* record) {
   const uint64 length = core::DecodeFixed64(record->data());
 
   // Read data
-  s = ReadChecksummed(*offset + kHeaderSize, length, record);
+  if (options_.verify_data_checksums) {
+    s = ReadChecksummed(*offset + kHeaderSize, length, record);
+  } else {
+    uint32 masked_crc;
+    s = ReadWithChecksum(*offset + kHeaderSize, length, record, &masked_crc);
+  }
   if (!s.ok()) {
     last_read_failed_ = true;
     if (errors::IsOutOfRange(s)) {
@@ -209,6 +231,107 @@ Status RecordReader::ReadRecord(uint64* offset, tstring* record) {
   return Status::OK();
 }
 
+// The checksums of the records read by ReadRecords() are verified in groups of
+// at most about this many bytes, so that the records are still in cache.
+static constexpr size_t kMaxChecksumGroupBytes = 64 << 10;
+
+// Verifies the checksums of records[begin, end), and sets *num_verified to the
+// index of the first corrupted record, or to end.
+static Status VerifyChecksums(int begin, int end,
+                              const std::vector<tstring>& records,
+                              const std::vector<uint64>& offsets,
+                              const std::vector<uint32>& masked_crcs,
+                              int* num_verified) {
+  const int n = end - begin;
+  std::vector<const char*> data(n);
+  std::vector<size_t> sizes(n);
+  std::vector<uint32> crcs(n);
+  for (int i = 0; i < n; ++i) {
+    data[i] = records[begin + i].data();
+    sizes[i] = records[begin + i].size();
+  }
+  crc32c::Values(n, data.data(), sizes.data(), crcs.data());
+  for (int i = 0; i < n; ++i) {
+    if (crc32c::Unmask(masked_crcs[begin + i]) != crcs[i]) {
+      *num_verified = begin + i;
+      return errors::DataLoss("corrupted record at ", offsets[begin + i]);
+    }
+  }
+  *num_verified = end;
+  return Status::OK();
+}
+
+Status RecordReader::ReadRecords(uint64* offset, int max_records,
+                                 std::vector<tstring>* records) {
+  // Reuses the buffers of the records of the previous call.
+  records->resize(max_records);
+  Status s = PositionInputStream(*offset);
+  if (!s.ok()) {
+    records->clear();
+    return s;
+  }
+
+  std::vector<uint64> offsets(max_records);
+  std::vector<uint32> masked_crcs(max_records);
+  uint64 next_offset = *offset;
+  tstring header;
+  int num_read = 0;
+  int num_verified = 0;
+  size_t unverified_bytes = 0;
+  while (num_read < max_records) {
+    if (options_.verify_data_checksums &&
+        unverified_bytes >= kMaxChecksumGroupBytes) {
+      Status verified = VerifyChecksums(num_verified, num_read, *records,
+                                        offsets, masked_crcs, &num_verified);
+      if (!verified.ok()) {
+        last_read_failed_ = true;
+        records->resize(num_verified);
+        *offset = offsets[num_verified];
+        return verified;
+      }
+      unverified_bytes = 0;
+    }
+
+    s = ReadChecksummed(next_offset, sizeof(uint64), &header);
+    if (!s.ok()) break;
+    const uint64 length = core::DecodeFixed64(header.data());
+
+    s = ReadWithChecksum(next_offset + kHeaderSize, length,
+                         &(*records)[num_read], &masked_crcs[num_read]);
+    if (!s.ok()) {
+      if (errors::IsOutOfRange(s)) {
+        s = errors::DataLoss("truncated record at ", next_offset,
+                             "' failed with ", s.error_message());
+      }
+      break;
+    }
+    offsets[num_read] = next_offset;
+    next_offset += kHeaderSize + length + kFooterSize;
+    unverified_bytes += length;
+    ++num_read;
+  }
+
+  if (options_.verify_data_checksums) {
+    Status verified = VerifyChecksums(num_verified, num_read, *records,
+                                      offsets, masked_crcs, &num_verified);
+    if (!verified.ok()) {
+      last_read_failed_ = true;
+      records->resize(num_verified);
+      *offset = offsets[num_verified];
+      return verified;
+    }
+  }
+  records->resize(num_read);
+  *offset = next_offset;
+  if (!s.ok()) {
+    last_read_failed_ = true;
+    if (!errors::IsOutOfRange(s) || num_read == 0) {
+      return s;
+    }
+  }
+  return Status::OK();
+}
+
 Status RecordReader::SkipRecords(uint64* offset, int num_to_skip,
                                  int* num_skipped) {
   TF_RETURN_IF_ERROR(PositionInputStream(*offset));
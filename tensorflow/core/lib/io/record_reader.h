@@ -16,6 +16,9 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_LIB_IO_RECORD_READER_H_
 #define TENSORFLOW_CORE_LIB_IO_RECORD_READER_H_
 
+#include <functional>
+#include <vector>
+
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/stringpiece.h"
 #include "tensorflow/core/lib/io/inputstream_interface.h"
@@ -47,6 +50,21 @@ struct RecordReaderOptions {
   // compressed files.) Consider using SequentialRecordReader.
   int64_t buffer_size = 0;
 
+  // If prefetch_queue_depth is positive, the file is read ahead of the reader
+  // in blocks of prefetch_block_size bytes, with up to prefetch_queue_depth
+  // block reads outstanding at a time on prefetch_runner, or on a thread pool
+  // shared by all readers if it is not set. This replaces buffer_size, and
+  // has the same restriction that all reads must be sequential. At most
+  // prefetch_queue_depth * prefetch_block_size bytes are in flight.
+  int prefetch_queue_depth = 0;
+  int64_t prefetch_block_size = 1 << 20;
+  std::function<void(std::function<void()>)> prefetch_runner;
+
+  // If false, only the checksums of the record headers are verified, which
+  // are needed to trust the record lengths, and not those of the record data.
+  // Only disable this for files whose integrity is checked by other means.
+  bool verify_data_checksums = true;
+
   static RecordReaderOptions CreateRecordReaderOptions(
       const string& compression_type);
 
@@ -97,6 +115,17 @@ class RecordReader {
   // OUT_OF_RANGE for end of file, or something else for an error.
   Status ReadRecord(uint64* offset, tstring* record);
 
+  // Read up to max_records records starting at "*offset" into *records and
+  // update *offset to point to the offset of the next record. The checksums
+  // of the records are verified together, which is faster than reading small
+  // records one at a time; records larger than a few kilobytes are better
+  // read with ReadRecord(). Returns OK if at least one record was read,
+  // OUT_OF_RANGE for end of file, or something else for an error, in which
+  // case *records holds the records before the one that failed and *offset
+  // points to it.
+  Status ReadRecords(uint64* offset, int max_records,
+                     std::vector<tstring>* records);
+
   // Skip num_to_skip record starting at "*offset" and update *offset
   // to point to the offset of the next num_to_skip + 1 record.
   // Return OK on success, OUT_OF_RANGE for end of file, or something
@@ -117,6 +146,8 @@ class RecordReader {
 
  private:
   Status ReadChecksummed(uint64 offset, size_t n, tstring* result);
+  Status ReadWithChecksum(uint64 offset, size_t n, tstring* result,
+                          uint32* masked_crc);
   Status PositionInputStream(uint64 offset);
 
   RecordReaderOptions options_;
@@ -147,6 +178,14 @@ class SequentialRecordReader {
     return underlying_.ReadRecord(&offset_, record);
   }
 
+  // Read up to max_records next records in the file into *records. Returns OK
+  // if at least one record was read, OUT_OF_RANGE for end of file, or
+  // something else for an error, in which case *records holds the records
+  // before the one that failed.
+  Status ReadRecords(int max_records, std::vector<tstring>* records) {
+    return underlying_.ReadRecords(&offset_, max_records, records);
+  }
+
   // Skip the next num_to_skip record in the file. Return OK on success,
   // OUT_OF_RANGE for end of file, or something else for an error.
   // "*num_skipped" records the number of records that are actually skipped.
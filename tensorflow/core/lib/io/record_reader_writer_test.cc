@@ -26,6 +26,7 @@ limitations under the License.
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
 
 namespace tensorflow {
 
@@ -305,6 +306,136 @@ TEST(RecordReaderWriterTest, TestZlib) {
   }
 }
 
+TEST(RecordReaderWriterTest, TestPrefetch) {
+  Env* env = Env::Default();
+  string fname = testing::TmpDir() + "/record_reader_writer_prefetch_test";
+  std::vector<string> records;
+  for (int i = 0; i < 20; ++i) {
+    records.push_back(string(i * 7, 'a' + i));
+  }
+
+  for (const char* compression_type : {"", "ZLIB"}) {
+    {
+      std::unique_ptr<WritableFile> file;
+      TF_CHECK_OK(env->NewWritableFile(fname, &file));
+
+      io::RecordWriter writer(
+          file.get(),
+          io::RecordWriterOptions::CreateRecordWriterOptions(compression_type));
+      for (const string& record : records) {
+        TF_EXPECT_OK(writer.WriteRecord(record));
+      }
+      TF_CHECK_OK(writer.Close());
+    }
+
+    for (auto buf_size : BufferSizes()) {
+      for (int queue_depth : {1, 4}) {
+        std::unique_ptr<RandomAccessFile> read_file;
+        TF_CHECK_OK(env->NewRandomAccessFile(fname, &read_file));
+        io::RecordReaderOptions options =
+            io::RecordReaderOptions::CreateRecordReaderOptions(
+                compression_type);
+        options.prefetch_block_size = buf_size;
+        options.prefetch_queue_depth = queue_depth;
+        io::RecordReader reader(read_file.get(), options);
+        uint64 offset = 0;
+        tstring record;
+        for (const string& expected : records) {
+          TF_CHECK_OK(reader.ReadRecord(&offset, &record));
+          EXPECT_EQ(expected, record);
+        }
+        EXPECT_EQ(error::OUT_OF_RANGE,
+                  reader.ReadRecord(&offset, &record).code());
+
+        offset = 0;
+        int num_skipped;
+        TF_CHECK_OK(reader.SkipRecords(&offset, 15, &num_skipped));
+        EXPECT_EQ(15, num_skipped);
+        TF_CHECK_OK(reader.ReadRecord(&offset, &record));
+        EXPECT_EQ(records[15], record);
+
+        io::RecordReader::Metadata md;
+        TF_ASSERT_OK(reader.GetMetadata(&md));
+        EXPECT_EQ(records.size(), md.stats.entries);
+      }
+    }
+  }
+}
+
+TEST(RecordReaderWriterTest, TestReadRecords) {
+  Env* env = Env::Default();
+  string fname = testing::TmpDir() + "/record_reader_writer_read_records_test";
+  std::vector<string> records;
+  for (int i = 0; i < 10; ++i) {
+    records.push_back(string(i * 3, 'a' + i));
+  }
+  {
+    std::unique_ptr<WritableFile> file;
+    TF_CHECK_OK(env->NewWritableFile(fname, &file));
+    io::RecordWriter writer(file.get());
+    for (const string& record : records) {
+      TF_EXPECT_OK(writer.WriteRecord(record));
+    }
+    TF_CHECK_OK(writer.Close());
+  }
+
+  for (int max_records : {1, 3, 4, 10, 20}) {
+    std::unique_ptr<RandomAccessFile> read_file;
+    TF_CHECK_OK(env->NewRandomAccessFile(fname, &read_file));
+    io::SequentialRecordReader reader(read_file.get());
+    std::vector<tstring> read;
+    int num_read = 0;
+    while (num_read < records.size()) {
+      TF_ASSERT_OK(reader.ReadRecords(max_records, &read));
+      ASSERT_EQ(std::min<int>(max_records, records.size() - num_read),
+                read.size());
+      for (const tstring& record : read) {
+        EXPECT_EQ(records[num_read++], record);
+      }
+    }
+    EXPECT_EQ(error::OUT_OF_RANGE,
+              reader.ReadRecords(max_records, &read).code());
+    EXPECT_TRUE(read.empty());
+  }
+
+  // Corrupts the data of the sixth record.
+  string contents;
+  TF_CHECK_OK(ReadFileToString(env, fname, &contents));
+  uint64 corrupted_offset = 0;
+  for (int i = 0; i < 5; ++i) {
+    corrupted_offset += io::RecordReader::kHeaderSize + records[i].size() +
+                        io::RecordReader::kFooterSize;
+  }
+  contents[corrupted_offset + io::RecordReader::kHeaderSize] ^= 1;
+  TF_CHECK_OK(WriteStringToFile(env, fname, contents));
+
+  for (bool verify : {true, false}) {
+    std::unique_ptr<RandomAccessFile> read_file;
+    TF_CHECK_OK(env->NewRandomAccessFile(fname, &read_file));
+    io::RecordReaderOptions options;
+    options.verify_data_checksums = verify;
+    io::RecordReader reader(read_file.get(), options);
+    uint64 offset = 0;
+    std::vector<tstring> read;
+    Status s = reader.ReadRecords(&offset, 10, &read);
+    if (verify) {
+      EXPECT_EQ(error::DATA_LOSS, s.code());
+      ASSERT_EQ(5, read.size());
+      EXPECT_EQ(corrupted_offset, offset);
+      tstring record;
+      EXPECT_EQ(error::DATA_LOSS, reader.ReadRecord(&offset, &record).code());
+    } else {
+      TF_EXPECT_OK(s);
+      ASSERT_EQ(10, read.size());
+      EXPECT_EQ(records[9], read[9]);
+      offset = corrupted_offset;
+      tstring record;
+      TF_EXPECT_OK(reader.ReadRecord(&offset, &record));
+      EXPECT_NE(records[5], string(record));
+    }
+  }
+}
+
 TEST(RecordReaderWriterTest, TestUseAfterClose) {
   Env* env = Env::Default();
   string fname = testing::TmpDir() + "/record_reader_writer_flush_close_test";
@@ -328,4 +459,123 @@ TEST(RecordReaderWriterTest, TestUseAfterClose) {
   }
 }
 
+// Reads a 2GB file of 1MB records with a SequentialRecordReader. The first
+// argument is the size of the reads, and the second is the number of reads to
+// keep outstanding, or 0 to only use the buffering of `buffer_size`. The file
+// is written once to the temporary directory.
+void BM_SequentialRecordReader(::testing::benchmark::State& state) {
+  const int64_t read_size = state.range(0);
+  const int queue_depth = state.range(1);
+  constexpr int64_t kRecordSize = 1 << 20;
+  constexpr int64_t kNumRecords = 2048;
+
+  Env* env = Env::Default();
+  const string fname = testing::TmpDir() + "/record_reader_benchmark";
+  if (!env->FileExists(fname).ok()) {
+    std::unique_ptr<WritableFile> file;
+    TF_CHECK_OK(env->NewWritableFile(fname, &file));
+    io::RecordWriter writer(file.get());
+    const string record(kRecordSize, 'x');
+    for (int64_t i = 0; i < kNumRecords; ++i) {
+      TF_CHECK_OK(writer.WriteRecord(record));
+    }
+    TF_CHECK_OK(writer.Close());
+  }
+
+  io::RecordReaderOptions options;
+  if (queue_depth > 0) {
+    options.prefetch_block_size = read_size;
+    options.prefetch_queue_depth = queue_depth;
+  } else {
+    options.buffer_size = read_size;
+  }
+  int64_t bytes_read = 0;
+  for (auto s : state) {
+    std::unique_ptr<RandomAccessFile> file;
+    TF_CHECK_OK(env->NewRandomAccessFile(fname, &file));
+    io::SequentialRecordReader reader(file.get(), options);
+    tstring record;
+    Status status;
+    while ((status = reader.ReadRecord(&record)).ok()) {
+      bytes_read += record.size();
+    }
+    CHECK(errors::IsOutOfRange(status)) << status;
+  }
+  state.SetBytesProcessed(bytes_read);
+}
+BENCHMARK(BM_SequentialRecordReader)
+    ->ArgPair(256 << 10, 0)
+    ->ArgPair(16 << 20, 0)
+    ->ArgPair(256 << 10, 16)
+    ->ArgPair(1 << 20, 8)
+    ->ArgPair(4 << 20, 4);
+
+// Reads 64MB of records of the given size with a buffered
+// SequentialRecordReader. The second argument selects the read path: 0 reads
+// the records one at a time, 1 reads them in batches of 64 whose checksums are
+// verified together, and 2 reads them one at a time without verifying the
+// checksums of the record data.
+void BM_RecordReaderChecksums(::testing::benchmark::State& state) {
+  const int64_t record_size = state.range(0);
+  const int mode = state.range(1);
+  constexpr int64_t kFileSize = 64 << 20;
+  constexpr int kBatchSize = 64;
+
+  Env* env = Env::Default();
+  const string fname = strings::StrCat(
+      testing::TmpDir(), "/record_reader_checksums_benchmark_", record_size);
+  if (!env->FileExists(fname).ok()) {
+    std::unique_ptr<WritableFile> file;
+    TF_CHECK_OK(env->NewWritableFile(fname, &file));
+    io::RecordWriter writer(file.get());
+    const string record(record_size, 'x');
+    for (int64_t i = 0; i < kFileSize / record_size; ++i) {
+      TF_CHECK_OK(writer.WriteRecord(record));
+    }
+    TF_CHECK_OK(writer.Close());
+  }
+
+  io::RecordReaderOptions options;
+  options.buffer_size = 1 << 20;
+  options.verify_data_checksums = mode != 2;
+  int64_t bytes_read = 0;
+  for (auto s : state) {
+    std::unique_ptr<RandomAccessFile> file;
+    TF_CHECK_OK(env->NewRandomAccessFile(fname, &file));
+    io::SequentialRecordReader reader(file.get(), options);
+    Status status;
+    if (mode == 1) {
+      std::vector<tstring> records;
+      while ((status = reader.ReadRecords(kBatchSize, &records)).ok()) {
+        for (const tstring& record : records) {
+          bytes_read += record.size();
+        }
+      }
+    } else {
+      tstring record;
+      while ((status = reader.ReadRecord(&record)).ok()) {
+        bytes_read += record.size();
+      }
+    }
+    CHECK(errors::IsOutOfRange(status)) << status;
+  }
+  state.SetBytesProcessed(bytes_read);
+}
+BENCHMARK(BM_RecordReaderChecksums)
+    ->ArgPair(100, 0)
+    ->ArgPair(100, 1)
+    ->ArgPair(100, 2)
+    ->ArgPair(1000, 0)
+    ->ArgPair(1000, 1)
+    ->ArgPair(1000, 2)
+    ->ArgPair(10000, 0)
+    ->ArgPair(10000, 1)
+    ->ArgPair(10000, 2)
+    ->ArgPair(100000, 0)
+    ->ArgPair(100000, 1)
+    ->ArgPair(100000, 2)
+    ->ArgPair(1000000, 0)
+    ->ArgPair(1000000, 1)
+    ->ArgPair(1000000, 2);
+
 }  // namespace tensorflow
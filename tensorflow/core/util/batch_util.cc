@@ -93,6 +93,23 @@ Status HandleElementToSlice<Eigen::half>(const Tensor& /* element */,
   return Status::OK();
 }
 
+template <typename T>
+Status HandleElementsToSlices(absl::Span<Tensor* const> elements, T* dest,
+                              int64_t num_values) {
+  if (num_values == 1 && is_simple_type<T>::value) {
+    for (Tensor* element : elements) {
+      *dest++ = *static_cast<T*>(element->data());
+    }
+    return Status::OK();
+  }
+  for (Tensor* element : elements) {
+    TF_RETURN_IF_ERROR(HandleElementToSlice<T>(
+        *element, static_cast<T*>(element->data()), dest, num_values));
+    dest += num_values;
+  }
+  return Status::OK();
+}
+
 template <typename T>
 void HandleSliceToElement(const T* src, T* dest, int64_t num_values) {
   static_assert(is_simple_type<T>::value, "Memcpy requires a simple type.");
@@ -190,6 +207,40 @@ Status CopyElementToSlice(Tensor element, Tensor* parent, int64_t index) {
   }
 }
 
+// Copies elements into consecutive slices of parent, starting at the index^th
+// slice.
+Status CopyElementsToSlices(absl::Span<Tensor* const> elements, Tensor* parent,
+                            int64_t index) {
+  if (elements.empty()) {
+    return Status::OK();
+  }
+  for (const Tensor* element : elements) {
+    if (element->dtype() != parent->dtype()) {
+      return errors::Internal(
+          "CopyElementsToSlices Cannot perform copy: data types do not match. "
+          " Types are: [element]: ",
+          DataTypeString(element->dtype()),
+          ", [parent]: ", DataTypeString(parent->dtype()));
+    }
+    TF_RETURN_IF_ERROR(ValidateInput(*parent, *element, index));
+  }
+  const int64_t num_values = elements[0]->NumElements();
+#define HANDLE_TYPE(T)                                                \
+  case DataTypeToEnum<T>::value: {                                    \
+    T* dest = static_cast<T*>(parent->data()) + (num_values * index); \
+    return HandleElementsToSlices<T>(elements, dest, num_values);     \
+  }
+
+  switch (parent->dtype()) {
+    TF_CALL_ALL_TYPES(HANDLE_TYPE);
+    TF_CALL_QUANTIZED_TYPES(HANDLE_TYPE);
+#undef HANDLE_TYPE
+    default:
+      return errors::Unimplemented(
+          "CopyElementsToSlices Unhandled data type: ", parent->dtype());
+  }
+}
+
 // Copies the index^th slice of parent (in the 0th dimension) into element.
 Status CopySliceToElement(const Tensor& parent, Tensor* element,
                           int64_t index) {
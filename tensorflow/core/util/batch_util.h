@@ -15,6 +15,7 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_UTIL_BATCH_UTIL_H_
 #define TENSORFLOW_CORE_UTIL_BATCH_UTIL_H_
 
+#include "absl/types/span.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/lib/core/status.h"
 
@@ -29,6 +30,17 @@ namespace batch_util {
 // for DT_STRING tensors.
 Status CopyElementToSlice(Tensor element, Tensor* parent, int64_t index);
 
+// Copies `elements` into consecutive slices of parent (in the 0th dimension),
+// starting at the index^th slice. Each element must have as many values as a
+// slice of parent.
+//
+// This is equivalent to calling `CopyElementToSlice` for each element, but
+// dispatches on the data type once for all the elements and copies scalars
+// without a `memcpy` call per value. DT_STRING and DT_VARIANT values are moved
+// out of the elements that hold the only reference to their buffer.
+Status CopyElementsToSlices(absl::Span<Tensor* const> elements, Tensor* parent,
+                            int64_t index);
+
 // Copies the index^th slice of parent (in the 0th dimension) into element.
 Status CopySliceToElement(const Tensor& parent, Tensor* element, int64_t index);
 
@@ -14,6 +14,8 @@ limitations under the License.
 ==============================================================================*/
 #include "tensorflow/core/util/example_proto_fast_parsing.h"
 
+#include <algorithm>
+#include <numeric>
 #include <vector>
 
 #include "absl/base/casts.h"
@@ -25,15 +27,17 @@ limitations under the License.
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/framework/types.pb.h"
+#include "tensorflow/core/lib/core/bits.h"
 #include "tensorflow/core/lib/core/blocking_counter.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/lib/gtl/inlined_vector.h"
+#include "tensorflow/core/lib/hash/hash.h"
 #include "tensorflow/core/lib/monitoring/counter.h"
 #include "tensorflow/core/platform/byte_order.h"
 #include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/prefetch.h"
 #include "tensorflow/core/platform/protobuf.h"
-#include "tensorflow/core/util/presized_cuckoo_map.h"
 #include "tensorflow/core/util/sparse/sparse_tensor.h"
 
 namespace tensorflow {
@@ -113,6 +117,65 @@ constexpr uint8 kVarintTag(uint32 tag) { return (tag << 3) | 0; }
 constexpr uint8 kDelimitedTag(uint32 tag) { return (tag << 3) | 2; }
 constexpr uint8 kFixed32Tag(uint32 tag) { return (tag << 3) | 5; }
 
+// Appends the packed varints in data[0, size) to `int64_list`. Small
+// non-negative values, the common case for ids and counts, take a single byte,
+// so runs of them are decoded eight at a time. The list is resized once up
+// front, to the number of bytes that end a varint.
+template <typename Result>
+bool ParsePackedVarints(const uint8* data, size_t size, Result* int64_list) {
+  constexpr uint64 kContinuationBits = 0x8080808080808080ULL;
+  size_t num_values = 0;
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64 word;
+    memcpy(&word, data + i, sizeof(word));
+    // One bit per byte that ends a varint, summed up by the multiplication.
+    const uint64 ends = (~word & kContinuationBits) >> 7;
+    num_values += (ends * 0x0101010101010101ULL) >> 56;
+  }
+  for (; i < size; ++i) {
+    num_values += (data[i] & 0x80) == 0;
+  }
+
+  // The available size can be less than `num_values` in case of a
+  // LimitedArraySlice, which then reports the overflow with EndDistance().
+  const size_t initial_size = int64_list->size();
+  int64_list->resize(initial_size + num_values);
+  const size_t available = int64_list->size() - initial_size;
+  int64_t* out = int64_list->data() + initial_size;
+
+  const uint8* p = data;
+  const uint8* const end = data + size;
+  size_t n = 0;
+  while (p < end) {
+    if (end - p >= 8 && n + 8 <= available) {
+      uint64 word;
+      memcpy(&word, p, sizeof(word));
+      if ((word & kContinuationBits) == 0) {
+        for (int j = 0; j < 8; ++j) {
+          out[n + j] = p[j];
+        }
+        p += 8;
+        n += 8;
+        continue;
+      }
+    }
+    uint64 value = 0;
+    int shift = 0;
+    uint8 byte;
+    do {
+      // Varints are at most 10 bytes long.
+      if (p == end || shift >= 64) return false;
+      byte = *p++;
+      value |= static_cast<uint64>(byte & 0x7f) << shift;
+      shift += 7;
+    } while (byte & 0x80);
+    if (n < available) out[n] = static_cast<int64_t>(value);
+    ++n;
+  }
+  return true;
+}
+
 namespace parsed {
 
 // ParseDataType has to be called first, then appropriate ParseZzzzList.
@@ -299,15 +362,19 @@ class Feature {
         if (!stream.ExpectTag(kDelimitedTag(1))) return false;  // packed tag
         uint32 packed_length;
         if (!stream.ReadVarint32(&packed_length)) return false;
-        auto packed_limit = stream.PushLimit(packed_length);
-
-        while (!stream.ExpectAtEnd()) {
-          protobuf_uint64 n;  // There is no API for int64
-          if (!stream.ReadVarint64(&n)) return false;
-          int64_list->push_back(static_cast<int64_t>(n));
+        if (packed_length > 0) {
+          const void* packed_data;
+          int packed_size;
+          if (!stream.GetDirectBufferPointer(&packed_data, &packed_size)) {
+            return false;
+          }
+          if (static_cast<uint32>(packed_size) < packed_length) return false;
+          if (!ParsePackedVarints(static_cast<const uint8*>(packed_data),
+                                  packed_length, int64_list)) {
+            return false;
+          }
+          stream.Skip(packed_length);
         }
-
-        stream.PopLimit(packed_limit);
       } else {  // non-packed
         while (!stream.ExpectAtEnd()) {
           if (!stream.ExpectTag(kVarintTag(1))) return false;
@@ -539,11 +606,140 @@ struct SparseBuffer {
   std::vector<size_t> example_end_indices;
 };
 
-struct SeededHasher {
-  uint64 operator()(StringPiece s) const {
-    return Hash64(s.data(), s.size(), seed);
+// Maps the feature names of a config to their index and type with a perfect
+// hash: every name has a slot of its own, found by hashing the name once and
+// displacing the hash by a per-bucket offset. Finding a name costs one hash,
+// two table loads and, unless the stored hash rules it out, one comparison of
+// the names, however many features the config has.
+class FeatureIndex {
+ public:
+  using Value = std::pair<size_t, Type>;
+
+  Status Init(const Config& config) {
+    std::vector<std::pair<StringPiece, Value>> entries;
+    entries.reserve(config.dense.size() + config.sparse.size() +
+                    config.ragged.size());
+    for (size_t d = 0; d < config.dense.size(); ++d) {
+      entries.push_back({config.dense[d].feature_name, {d, Type::Dense}});
+    }
+    for (size_t d = 0; d < config.sparse.size(); ++d) {
+      entries.push_back({config.sparse[d].feature_name, {d, Type::Sparse}});
+    }
+    for (size_t d = 0; d < config.ragged.size(); ++d) {
+      entries.push_back({config.ragged[d].feature_name, {d, Type::Ragged}});
+    }
+    // Half of the slots stay empty and buckets hold two to four names on
+    // average, which makes finding the displacements quick.
+    const uint64 num_slots = NextPowerOfTwo64(2 * entries.size() + 1);
+    const uint64 num_buckets = std::max<uint64>(1, num_slots / 8);
+    for (int attempt = 0; attempt < 16; ++attempt) {
+      if (Build(entries, num_buckets, num_slots)) return Status::OK();
+      LOG(WARNING) << "Could not build the perfect hash of a config of "
+                   << entries.size() << " features with seed " << seed_
+                   << ". Retrying with another seed.";
+      ++seed_;
+    }
+    return errors::Internal(
+        "Could not build the feature index. This should not happen.");
+  }
+
+  bool Find(StringPiece name, Value* value) const {
+    const uint64 h = Hash64(name.data(), name.size(), seed_);
+    const Slot& slot = slots_[SlotOf(h, displacements_[h & bucket_mask_])];
+    if (!slot.used || slot.hash != h || slot.name != name) return false;
+    *value = slot.value;
+    return true;
   }
-  uint64 seed{0xDECAFCAFFE};
+
+ private:
+  struct Slot {
+    bool used = false;
+    uint64 hash = 0;
+    StringPiece name;
+    Value value;
+  };
+
+  // The probe sequence of a hash is determined by its upper bits, so that the
+  // names of a bucket, which share their lower bits, spread over the table.
+  size_t SlotOf(uint64 h, uint32 displacement) const {
+    return ((h >> 32) + displacement * ((h >> 16) | 1)) & slot_mask_;
+  }
+
+  bool Build(const std::vector<std::pair<StringPiece, Value>>& entries,
+             uint64 num_buckets, uint64 num_slots) {
+    bucket_mask_ = num_buckets - 1;
+    slot_mask_ = num_slots - 1;
+    displacements_.assign(num_buckets, 0);
+    slots_.assign(num_slots, Slot());
+
+    // Group the entries by bucket with a counting sort.
+    std::vector<uint64> hashes(entries.size());
+    std::vector<size_t> bucket_offsets(num_buckets + 1, 0);
+    for (size_t i = 0; i < entries.size(); ++i) {
+      hashes[i] =
+          Hash64(entries[i].first.data(), entries[i].first.size(), seed_);
+      ++bucket_offsets[(hashes[i] & bucket_mask_) + 1];
+    }
+    std::partial_sum(bucket_offsets.begin(), bucket_offsets.end(),
+                     bucket_offsets.begin());
+    std::vector<size_t> bucket_entries(entries.size());
+    {
+      std::vector<size_t> next(bucket_offsets.begin(),
+                               bucket_offsets.end() - 1);
+      for (size_t i = 0; i < entries.size(); ++i) {
+        bucket_entries[next[hashes[i] & bucket_mask_]++] = i;
+      }
+    }
+    auto bucket_size = [&bucket_offsets](size_t b) {
+      return bucket_offsets[b + 1] - bucket_offsets[b];
+    };
+
+    // Place the largest buckets first, while most slots are free.
+    std::vector<size_t> order(num_buckets);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&bucket_size](size_t a, size_t b) {
+      return bucket_size(a) > bucket_size(b);
+    });
+    std::vector<size_t> bucket_slots;
+    for (size_t b : order) {
+      if (bucket_size(b) == 0) break;
+      const size_t* bucket_begin = &bucket_entries[bucket_offsets[b]];
+      const size_t* bucket_end = bucket_begin + bucket_size(b);
+      bool placed = false;
+      for (uint32 displacement = 0; !placed && displacement < 4 * num_slots;
+           ++displacement) {
+        bucket_slots.clear();
+        placed = true;
+        for (const size_t* i = bucket_begin; i != bucket_end; ++i) {
+          const size_t slot = SlotOf(hashes[*i], displacement);
+          if (slots_[slot].used ||
+              std::find(bucket_slots.begin(), bucket_slots.end(), slot) !=
+                  bucket_slots.end()) {
+            placed = false;
+            break;
+          }
+          bucket_slots.push_back(slot);
+        }
+        if (placed) displacements_[b] = displacement;
+      }
+      if (!placed) return false;
+      for (size_t j = 0; j < bucket_slots.size(); ++j) {
+        const size_t i = bucket_begin[j];
+        Slot& slot = slots_[bucket_slots[j]];
+        slot.used = true;
+        slot.hash = hashes[i];
+        slot.name = entries[i].first;
+        slot.value = entries[i].second;
+      }
+    }
+    return true;
+  }
+
+  uint64 seed_ = 0xDECAFCAFFE;
+  uint64 bucket_mask_ = 0;
+  uint64 slot_mask_ = 0;
+  std::vector<uint32> displacements_;
+  std::vector<Slot> slots_;
 };
 
 void LogDenseFeatureDataLoss(StringPiece feature_name) {
@@ -568,364 +764,364 @@ void LogSparseFeatureDataLoss(StringPiece feature_name) {
   duplicated_sparse_feature->GetCell()->IncrementBy(1);
 }
 
-Status FastParseSerializedExample(
-    const tstring& serialized_example, const tstring& example_name,
-    const size_t example_index, const Config& config,
-    const PresizedCuckooMap<std::pair<size_t, Type>>& config_index,
-    SeededHasher hasher, std::vector<Tensor>* output_dense,
-    std::vector<SparseBuffer>* output_varlen_dense,
-    std::vector<SparseBuffer>* output_sparse,
-    std::vector<SparseBuffer>* output_ragged,
-    PerExampleFeatureStats* output_stats) {
-  DCHECK(output_dense != nullptr);
-  DCHECK(output_sparse != nullptr);
-  DCHECK(output_ragged != nullptr);
-  parsed::Example parsed_example;
-  if (!ParseExample(serialized_example, &parsed_example)) {
-    return errors::InvalidArgument("Could not parse example input, value: '",
-                                   serialized_example, "'");
-  }
-  std::vector<int64_t> sparse_feature_last_example(config.sparse.size(), -1);
-  std::vector<int64_t> dense_feature_last_example(config.dense.size(), -1);
-  std::vector<int64_t> ragged_feature_last_example(config.ragged.size(), -1);
-
-  // Handle features present in the example.
-  const size_t parsed_example_size = parsed_example.size();
-
-  if (output_stats) {
-    // TODO(b/111553342): This may over-count the number of features if there
-    // are duplicate keys in the feature map. Consider deduplicating the keys
-    // before computing the count.
-    output_stats->features_count = parsed_example_size;
-  }
-
-  for (size_t i = 0; i < parsed_example_size; ++i) {
-    // This is a logic that standard protobuf parsing is implementing.
-    // I.e. last entry in the map overwrites all the previous ones.
-    parsed::FeatureMapEntry& name_and_feature =
-        parsed_example[parsed_example_size - i - 1];
-
-    const StringPiece feature_name = name_and_feature.first;
-    parsed::Feature& feature = name_and_feature.second;
-
-    std::pair<size_t, Type> d_and_type;
-    uint64 h = hasher(feature_name);
-    if (!config_index.Find(h, &d_and_type)) continue;
-
-    size_t d = d_and_type.first;
-    bool is_dense = d_and_type.second == Type::Dense;
-    bool is_ragged = d_and_type.second == Type::Ragged;
-
-    {
-      // Testing for PresizedCuckooMap collision.
-      // TODO(lew): Use dense_hash_map and avoid this and hasher creation.
-      const tstring& config_feature_name =
-          is_dense ? config.dense[d].feature_name
-                   : (is_ragged ? config.ragged[d].feature_name
-                                : config.sparse[d].feature_name);
-      if (feature_name != config_feature_name) continue;
-    }
-
-    auto example_error = [&](StringPiece suffix) {
-      return errors::InvalidArgument("Name: ", example_name,
-                                     ", Key: ", feature_name,
-                                     ", Index: ", example_index, ".  ", suffix);
-    };
-
-    auto parse_error = [&] {
-      return example_error("Can't parse serialized Example.");
-    };
-
-    DataType example_dtype;
-    TF_RETURN_IF_ERROR(feature.ParseDataType(&example_dtype));
-
-    if (is_dense) {
-      if (example_dtype == DT_INVALID) continue;
-
-      // If feature was already visited, skip.
-      // Compare comment at the beginning of the loop.
-      if (dense_feature_last_example[d] == example_index) {
-        LogDenseFeatureDataLoss(feature_name);
-        continue;
-      }
-      dense_feature_last_example[d] = example_index;
-
-      if (example_dtype != config.dense[d].dtype) {
-        return example_error(strings::StrCat(
-            "Data types don't match. Data type: ",
-            DataTypeString(example_dtype),
-            " but expected type: ", DataTypeString(config.dense[d].dtype)));
-      }
-      if (!config.dense[d].variable_length) {
-        Tensor& out = (*output_dense)[d];
-
-        const std::size_t num_elements = config.dense[d].elements_per_stride;
-        if (output_stats) {
-          // TODO(b/111553342): If desirable, we could add support for counting
-          // elements in the features that aren't parsed, but this could add
-          // considerable runtime cost.
-          output_stats->feature_values_count += num_elements;
-        }
-
-        const std::size_t offset = example_index * num_elements;
-
-        auto shape_error = [&](size_t size, StringPiece type_str) {
-          return example_error(strings::StrCat(
-              "Number of ", type_str,
-              " values != expected.  "
-              "Values size: ",
-              size,
-              " but output shape: ", config.dense[d].shape.DebugString()));
-        };
-
-        switch (config.dense[d].dtype) {
-          case DT_INT64: {
-            auto out_p = out.flat<int64_t>().data() + offset;
-            LimitedArraySlice<int64_t> slice(out_p, num_elements);
-            if (!feature.ParseInt64List(&slice)) return parse_error();
-            if (slice.EndDistance() != 0) {
-              return shape_error(num_elements - slice.EndDistance(), "int64");
-            }
-            break;
-          }
-          case DT_FLOAT: {
-            auto out_p = out.flat<float>().data() + offset;
-            LimitedArraySlice<float> slice(out_p, num_elements);
-            if (!feature.ParseFloatList(&slice)) return parse_error();
-            if (slice.EndDistance() != 0) {
-              return shape_error(num_elements - slice.EndDistance(), "float");
-            }
-            break;
-          }
-          case DT_STRING: {
-            auto out_p = out.flat<tstring>().data() + offset;
-            LimitedArraySlice<tstring> slice(out_p, num_elements);
-            if (!feature.ParseBytesList(&slice)) return parse_error();
-            if (slice.EndDistance() != 0) {
-              return shape_error(num_elements - slice.EndDistance(), "bytes");
-            }
-            break;
-          }
-          default:
-            LOG(FATAL) << "Should not happen.";
-        }
-      } else {  // if variable length
-        SparseBuffer& out = (*output_varlen_dense)[d];
-
-        const std::size_t num_elements = config.dense[d].elements_per_stride;
+// A feature of an example of a minibatch, filed under its column. The columns
+// are numbered in the order of the config: dense, then sparse, then ragged.
+struct ColumnEntry {
+  size_t column;
+  size_t example_index;
+  DataType example_dtype;
+  parsed::Feature feature;
+};
 
-        if (example_dtype != DT_INVALID &&
-            example_dtype != config.dense[d].dtype) {
-          return example_error(strings::StrCat(
-              "Data types don't match. ",
-              "Expected type: ", DataTypeString(config.dense[d].dtype)));
-        }
+StringPiece ExampleName(gtl::ArraySlice<tstring> example_names,
+                        size_t example_index) {
+  return example_names.empty() ? "<unknown>"
+                               : StringPiece(example_names[example_index]);
+}
 
-        auto shape_error = [&](size_t size, StringPiece type_str) {
-          return example_error(strings::StrCat(
-              "Number of ", type_str,
-              " values is not a multiple of stride length. Saw ", size,
-              " values but output shape is: ",
-              config.dense[d].shape.DebugString()));
-        };
-
-        switch (config.dense[d].dtype) {
-          case DT_INT64: {
-            if (example_dtype != DT_INVALID) {
-              if (!feature.ParseInt64List(&out.int64_list)) {
-                return parse_error();
-              }
-              if (out.int64_list.size() % num_elements != 0) {
-                return shape_error(out.int64_list.size(), "int64");
-              }
-            }
-            out.example_end_indices.push_back(out.int64_list.size());
-            break;
-          }
-          case DT_FLOAT: {
-            if (example_dtype != DT_INVALID) {
-              if (!feature.ParseFloatList(&out.float_list)) {
-                return parse_error();
-              }
-              if (out.float_list.size() % num_elements != 0) {
-                return shape_error(out.float_list.size(), "float");
-              }
-            }
-            out.example_end_indices.push_back(out.float_list.size());
-            break;
-          }
-          case DT_STRING: {
-            if (example_dtype != DT_INVALID) {
-              if (!feature.ParseBytesList(&out.bytes_list)) {
-                return parse_error();
-              }
-              if (out.bytes_list.size() % num_elements != 0) {
-                return shape_error(out.bytes_list.size(), "bytes");
-              }
-            }
-            out.example_end_indices.push_back(out.bytes_list.size());
-            break;
-          }
-          default:
-            LOG(FATAL) << "Should not happen.";
-        }
+Status ExampleError(gtl::ArraySlice<tstring> example_names,
+                    size_t example_index, StringPiece feature_name,
+                    StringPiece suffix) {
+  return errors::InvalidArgument(
+      "Name: ", ExampleName(example_names, example_index),
+      ", Key: ", feature_name, ", Index: ", example_index, ".  ", suffix);
+}
 
-        if (output_stats) {
-          // Use `out.example_end_indices` to determine the feature-value count
-          // for this feature, because the preceding switch statement pushes
-          // the length of the appropriate feature list to that vector.
-          // TODO(b/111553342): If desirable, we could add support for counting
-          // elements in the features that aren't parsed, but this could add
-          // considerable runtime cost.
-          const size_t out_examples_count = out.example_end_indices.size();
-          if (out_examples_count == 1) {
-            output_stats->feature_values_count += out.example_end_indices[0];
-          } else {
-            output_stats->feature_values_count +=
-                out.example_end_indices[out_examples_count - 1] -
-                out.example_end_indices[out_examples_count - 2];
-          }
-        }
-      }
-    } else {
-      // Feature is sparse or ragged.
-      auto& last_example =
-          is_ragged ? ragged_feature_last_example : sparse_feature_last_example;
+StringPiece ValuesTypeString(DataType dtype) {
+  switch (dtype) {
+    case DT_INT64:
+      return "int64";
+    case DT_FLOAT:
+      return "float";
+    case DT_STRING:
+      return "bytes";
+    default:
+      LOG(FATAL) << "Should not happen.";
+  }
+  return "";
+}
 
-      // If feature was already visited, skip.
-      // Compare comment at the beginning of the loop.
-      if (last_example[d] == example_index) {
-        LogSparseFeatureDataLoss(feature_name);
-        continue;
-      }
-      last_example[d] = example_index;
+// Appends the values of `feature` to the list of `out` that holds `dtype`.
+bool ParseFeatureList(DataType dtype, parsed::Feature* feature,
+                      SparseBuffer* out) {
+  switch (dtype) {
+    case DT_INT64:
+      return feature->ParseInt64List(&out->int64_list);
+    case DT_FLOAT:
+      return feature->ParseFloatList(&out->float_list);
+    case DT_STRING:
+      return feature->ParseBytesList(&out->bytes_list);
+    default:
+      LOG(FATAL) << "Should not happen.";
+  }
+  return false;
+}
 
-      // Handle sparse features.
-      SparseBuffer& out = is_ragged ? (*output_ragged)[d] : (*output_sparse)[d];
-      DataType feature_dtype =
-          is_ragged ? config.ragged[d].dtype : config.sparse[d].dtype;
-      if (example_dtype != DT_INVALID && example_dtype != feature_dtype) {
-        return example_error(
-            strings::StrCat("Data types don't match. ",
-                            "Expected type: ", DataTypeString(feature_dtype),
-                            ", Actual type: ", DataTypeString(example_dtype)));
-      }
+size_t FeatureListSize(DataType dtype, const SparseBuffer& out) {
+  switch (dtype) {
+    case DT_INT64:
+      return out.int64_list.size();
+    case DT_FLOAT:
+      return out.float_list.size();
+    case DT_STRING:
+      return out.bytes_list.size();
+    default:
+      LOG(FATAL) << "Should not happen.";
+  }
+  return 0;
+}
 
-      switch (feature_dtype) {
+// Decodes the fixed length dense feature `d` of the examples [start, end) from
+// the entries [entry, entries_end) of its column, and fills in the default
+// value for the examples without the feature.
+Status ParseFixedLenDenseColumn(
+    size_t d, const Config& config, gtl::ArraySlice<tstring> example_names,
+    size_t start, size_t end, ColumnEntry* entry,
+    const ColumnEntry* entries_end, Tensor* out,
+    std::vector<PerExampleFeatureStats>* output_stats) {
+  const Config::Dense& dense = config.dense[d];
+  const std::size_t num_elements = dense.elements_per_stride;
+  for (size_t e = start; e < end; ++e) {
+    if (entry == entries_end || entry->example_index != e) {
+      // Handle missing dense features for fixed strides.
+      if (dense.default_value.NumElements() == 0) {
+        return errors::InvalidArgument(
+            "Name: ", ExampleName(example_names, e),
+            ", Feature: ", dense.feature_name,
+            " (data type: ", DataTypeString(dense.dtype), ")",
+            " is required but could not be found.");
+      }
+      const Tensor& in = dense.default_value;
+      const std::size_t num_default_elements = in.shape().num_elements();
+      const std::size_t offset = e * num_default_elements;
+      switch (dense.dtype) {
         case DT_INT64: {
-          if (example_dtype != DT_INVALID) {
-            if (!feature.ParseInt64List(&out.int64_list)) {
-              return parse_error();
-            }
-          }
-          out.example_end_indices.push_back(out.int64_list.size());
+          std::copy_n(in.flat<int64_t>().data(), num_default_elements,
+                      out->flat<int64_t>().data() + offset);
           break;
         }
         case DT_FLOAT: {
-          if (example_dtype != DT_INVALID) {
-            if (!feature.ParseFloatList(&out.float_list)) {
-              return parse_error();
-            }
-          }
-          out.example_end_indices.push_back(out.float_list.size());
+          std::copy_n(in.flat<float>().data(), num_default_elements,
+                      out->flat<float>().data() + offset);
           break;
         }
         case DT_STRING: {
-          if (example_dtype != DT_INVALID) {
-            if (!feature.ParseBytesList(&out.bytes_list)) {
-              return parse_error();
-            }
-          }
-          out.example_end_indices.push_back(out.bytes_list.size());
+          std::copy_n(in.flat<tstring>().data(), num_default_elements,
+                      out->flat<tstring>().data() + offset);
           break;
         }
         default:
           LOG(FATAL) << "Should not happen.";
       }
-
-      if (output_stats) {
-        // Use `out.example_end_indices` to determine the feature-value count
-        // for this feature, because the preceding switch statement pushes
-        // the length of the appropriate feature list to that vector.
-        // TODO(b/111553342): If desirable, we could add support for counting
-        // elements in the features that aren't parsed, but this could add
-        // considerable runtime cost.
-        const size_t out_examples_count = out.example_end_indices.size();
-        if (out_examples_count == 1) {
-          output_stats->feature_values_count += out.example_end_indices[0];
-        } else {
-          output_stats->feature_values_count +=
-              out.example_end_indices[out_examples_count - 1] -
-              out.example_end_indices[out_examples_count - 2];
-        }
-      }
+      continue;
     }
-  }
 
-  // Handle missing dense features for fixed strides.
-  for (size_t d = 0; d < config.dense.size(); ++d) {
-    if (config.dense[d].variable_length) continue;
-    if (dense_feature_last_example[d] == example_index) continue;
-    if (config.dense[d].default_value.NumElements() == 0) {
-      return errors::InvalidArgument(
-          "Name: ", example_name, ", Feature: ", config.dense[d].feature_name,
-          " (data type: ", DataTypeString(config.dense[d].dtype), ")",
-          " is required but could not be found.");
+    parsed::Feature& feature = entry->feature;
+    ++entry;
+    if (output_stats) {
+      // TODO(b/111553342): If desirable, we could add support for counting
+      // elements in the features that aren't parsed, but this could add
+      // considerable runtime cost.
+      (*output_stats)[e].feature_values_count += num_elements;
     }
-    const Tensor& in = config.dense[d].default_value;
-    Tensor& out = (*output_dense)[d];
-    const std::size_t num_elements = in.shape().num_elements();
-    const std::size_t offset = example_index * num_elements;
 
-    switch (config.dense[d].dtype) {
+    auto parse_error = [&] {
+      return ExampleError(example_names, e, dense.feature_name,
+                          "Can't parse serialized Example.");
+    };
+    auto shape_error = [&](int64_t end_distance) {
+      return ExampleError(
+          example_names, e, dense.feature_name,
+          strings::StrCat("Number of ", ValuesTypeString(dense.dtype),
+                          " values != expected.  "
+                          "Values size: ",
+                          num_elements - end_distance,
+                          " but output shape: ", dense.shape.DebugString()));
+    };
+
+    const std::size_t offset = e * num_elements;
+    switch (dense.dtype) {
       case DT_INT64: {
-        std::copy_n(in.flat<int64_t>().data(), num_elements,
-                    out.flat<int64_t>().data() + offset);
+        LimitedArraySlice<int64_t> slice(out->flat<int64_t>().data() + offset,
+                                         num_elements);
+        if (!feature.ParseInt64List(&slice)) return parse_error();
+        if (slice.EndDistance() != 0) return shape_error(slice.EndDistance());
         break;
       }
       case DT_FLOAT: {
-        std::copy_n(in.flat<float>().data(), num_elements,
-                    out.flat<float>().data() + offset);
+        LimitedArraySlice<float> slice(out->flat<float>().data() + offset,
+                                       num_elements);
+        if (!feature.ParseFloatList(&slice)) return parse_error();
+        if (slice.EndDistance() != 0) return shape_error(slice.EndDistance());
         break;
       }
       case DT_STRING: {
-        std::copy_n(in.flat<tstring>().data(), num_elements,
-                    out.flat<tstring>().data() + offset);
+        LimitedArraySlice<tstring> slice(out->flat<tstring>().data() + offset,
+                                         num_elements);
+        if (!feature.ParseBytesList(&slice)) return parse_error();
+        if (slice.EndDistance() != 0) return shape_error(slice.EndDistance());
         break;
       }
       default:
         LOG(FATAL) << "Should not happen.";
     }
   }
+  return Status::OK();
+}
 
-  // Handle missing varlen dense features.
-  for (size_t d = 0; d < config.dense.size(); ++d) {
-    if (!config.dense[d].variable_length) continue;
-    if (dense_feature_last_example[d] == example_index) continue;
-    SparseBuffer& out = (*output_varlen_dense)[d];
-    size_t prev_example_end_index =
-        out.example_end_indices.empty() ? 0 : out.example_end_indices.back();
-    out.example_end_indices.push_back(prev_example_end_index);
+// Decodes a sparse, ragged or variable length dense feature of the examples
+// [start, end) from the entries [entry, entries_end) of its column into `out`.
+// `varlen_dense` is the config of the feature if it is dense, and nullptr
+// otherwise.
+Status ParseBufferedColumn(StringPiece feature_name, DataType dtype,
+                           const Config::Dense* varlen_dense,
+                           gtl::ArraySlice<tstring> example_names,
+                           size_t start, size_t end, ColumnEntry* entry,
+                           const ColumnEntry* entries_end, SparseBuffer* out,
+                           std::vector<PerExampleFeatureStats>* output_stats) {
+  out->example_end_indices.reserve(out->example_end_indices.size() + end -
+                                   start);
+  size_t size = FeatureListSize(dtype, *out);
+  for (size_t e = start; e < end; ++e) {
+    // Examples without the feature end where the previous one ends.
+    if (entry != entries_end && entry->example_index == e) {
+      const size_t prev_size = size;
+      if (entry->example_dtype != DT_INVALID) {
+        if (!ParseFeatureList(dtype, &entry->feature, out)) {
+          return ExampleError(example_names, e, feature_name,
+                              "Can't parse serialized Example.");
+        }
+        size = FeatureListSize(dtype, *out);
+        if (varlen_dense != nullptr &&
+            size % varlen_dense->elements_per_stride != 0) {
+          return ExampleError(
+              example_names, e, feature_name,
+              strings::StrCat("Number of ", ValuesTypeString(dtype),
+                              " values is not a multiple of stride length. "
+                              "Saw ",
+                              size, " values but output shape is: ",
+                              varlen_dense->shape.DebugString()));
+        }
+      }
+      ++entry;
+      if (output_stats) {
+        // TODO(b/111553342): If desirable, we could add support for counting
+        // elements in the features that aren't parsed, but this could add
+        // considerable runtime cost.
+        (*output_stats)[e].feature_values_count += size - prev_size;
+      }
+    }
+    out->example_end_indices.push_back(size);
   }
+  return Status::OK();
+}
 
-  // Handle missing sparse features.
-  for (size_t d = 0; d < config.sparse.size(); ++d) {
-    if (sparse_feature_last_example[d] == example_index) continue;
-    SparseBuffer& out = (*output_sparse)[d];
-    size_t prev_example_end_index =
-        out.example_end_indices.empty() ? 0 : out.example_end_indices.back();
-    out.example_end_indices.push_back(prev_example_end_index);
+// Parses the examples [start, end) of `serialized` column by column: a first
+// pass splits every example into its features and files the ones in the
+// config under their column, then the columns are decoded one after the other.
+// Decoding a whole column at once keeps its output buffer and the code for its
+// type hot, which matters for wide examples with thousands of features.
+Status FastParseMiniBatch(gtl::ArraySlice<tstring> serialized,
+                          gtl::ArraySlice<tstring> example_names, size_t start,
+                          size_t end, const Config& config,
+                          const FeatureIndex& config_index,
+                          std::vector<Tensor>* output_dense,
+                          std::vector<SparseBuffer>* output_varlen_dense,
+                          std::vector<SparseBuffer>* output_sparse,
+                          std::vector<SparseBuffer>* output_ragged,
+                          std::vector<PerExampleFeatureStats>* output_stats) {
+  DCHECK(output_dense != nullptr);
+  DCHECK(output_sparse != nullptr);
+  DCHECK(output_ragged != nullptr);
+  const size_t sparse_begin = config.dense.size();
+  const size_t ragged_begin = sparse_begin + config.sparse.size();
+  const size_t num_columns = ragged_begin + config.ragged.size();
+
+  std::vector<ColumnEntry> entries;
+  std::vector<int64_t> column_last_example(num_columns, -1);
+  parsed::Example parsed_example;
+  for (size_t e = start; e < end; ++e) {
+    if (e + 1 < end) {
+      port::prefetch<port::PREFETCH_HINT_T0>(serialized[e + 1].data());
+    }
+    parsed_example.clear();
+    if (!ParseExample(serialized[e], &parsed_example)) {
+      return errors::InvalidArgument("Could not parse example input, value: '",
+                                     serialized[e], "'");
+    }
+    if (output_stats) {
+      // TODO(b/111553342): This may over-count the number of features if there
+      // are duplicate keys in the feature map. Consider deduplicating the keys
+      // before computing the count.
+      (*output_stats)[e].features_count = parsed_example.size();
+    }
+
+    const int64_t example_index = e;
+    for (size_t i = parsed_example.size(); i-- > 0;) {
+      // This is a logic that standard protobuf parsing is implementing.
+      // I.e. last entry in the map overwrites all the previous ones.
+      const StringPiece feature_name = parsed_example[i].first;
+      parsed::Feature& feature = parsed_example[i].second;
+
+      FeatureIndex::Value d_and_type;
+      if (!config_index.Find(feature_name, &d_and_type)) continue;
+      const size_t d = d_and_type.first;
+
+      DataType example_dtype;
+      TF_RETURN_IF_ERROR(feature.ParseDataType(&example_dtype));
+
+      if (d_and_type.second == Type::Dense) {
+        if (example_dtype == DT_INVALID) continue;
+
+        // If feature was already visited, skip.
+        // Compare comment at the beginning of the loop.
+        if (column_last_example[d] == example_index) {
+          LogDenseFeatureDataLoss(feature_name);
+          continue;
+        }
+        column_last_example[d] = example_index;
+
+        if (example_dtype != config.dense[d].dtype) {
+          return ExampleError(
+              example_names, e, feature_name,
+              strings::StrCat("Data types don't match. Data type: ",
+                              DataTypeString(example_dtype),
+                              " but expected type: ",
+                              DataTypeString(config.dense[d].dtype)));
+        }
+        entries.push_back({d, e, example_dtype, feature});
+      } else {
+        // Feature is sparse or ragged.
+        const bool is_ragged = d_and_type.second == Type::Ragged;
+        const size_t column = (is_ragged ? ragged_begin : sparse_begin) + d;
+
+        // If feature was already visited, skip.
+        // Compare comment at the beginning of the loop.
+        if (column_last_example[column] == example_index) {
+          LogSparseFeatureDataLoss(feature_name);
+          continue;
+        }
+        column_last_example[column] = example_index;
+
+        const DataType feature_dtype =
+            is_ragged ? config.ragged[d].dtype : config.sparse[d].dtype;
+        if (example_dtype != DT_INVALID && example_dtype != feature_dtype) {
+          return ExampleError(
+              example_names, e, feature_name,
+              strings::StrCat("Data types don't match. ", "Expected type: ",
+                              DataTypeString(feature_dtype),
+                              ", Actual type: ", DataTypeString(example_dtype)));
+        }
+        entries.push_back({column, e, example_dtype, feature});
+      }
+    }
   }
 
-  // Handle missing ragged features.
-  for (size_t d = 0; d < config.ragged.size(); ++d) {
-    if (ragged_feature_last_example[d] == example_index) continue;
-    SparseBuffer& out = (*output_ragged)[d];
-    size_t prev_example_end_index =
-        out.example_end_indices.empty() ? 0 : out.example_end_indices.back();
-    out.example_end_indices.push_back(prev_example_end_index);
+  // Group the entries by column with a counting sort, which keeps the entries
+  // of each column in example order.
+  std::vector<size_t> column_offsets(num_columns + 1, 0);
+  for (const ColumnEntry& entry : entries) {
+    ++column_offsets[entry.column + 1];
   }
+  std::partial_sum(column_offsets.begin(), column_offsets.end(),
+                   column_offsets.begin());
+  std::vector<ColumnEntry> columns(entries.size());
+  {
+    std::vector<size_t> next(column_offsets.begin(), column_offsets.end() - 1);
+    for (const ColumnEntry& entry : entries) {
+      columns[next[entry.column]++] = entry;
+    }
+  }
+  auto column_begin = [&](size_t column) {
+    return columns.data() + column_offsets[column];
+  };
 
+  for (size_t d = 0; d < config.dense.size(); ++d) {
+    if (!config.dense[d].variable_length) {
+      TF_RETURN_IF_ERROR(ParseFixedLenDenseColumn(
+          d, config, example_names, start, end, column_begin(d),
+          column_begin(d + 1), &(*output_dense)[d], output_stats));
+    } else {
+      TF_RETURN_IF_ERROR(ParseBufferedColumn(
+          config.dense[d].feature_name, config.dense[d].dtype,
+          &config.dense[d], example_names, start, end, column_begin(d),
+          column_begin(d + 1), &(*output_varlen_dense)[d], output_stats));
+    }
+  }
+  for (size_t d = 0; d < config.sparse.size(); ++d) {
+    const size_t column = sparse_begin + d;
+    TF_RETURN_IF_ERROR(ParseBufferedColumn(
+        config.sparse[d].feature_name, config.sparse[d].dtype, nullptr,
+        example_names, start, end, column_begin(column),
+        column_begin(column + 1), &(*output_sparse)[d], output_stats));
+  }
+  for (size_t d = 0; d < config.ragged.size(); ++d) {
+    const size_t column = ragged_begin + d;
+    TF_RETURN_IF_ERROR(ParseBufferedColumn(
+        config.ragged[d].feature_name, config.ragged[d].dtype, nullptr,
+        example_names, start, end, column_begin(column),
+        column_begin(column + 1), &(*output_ragged)[d], output_stats));
+  }
   return Status::OK();
 }
 
@@ -1124,36 +1320,9 @@ Status FastParseExample(const Config& config,
     result->feature_stats.resize(serialized.size());
   }
 
-  size_t config_size =
-      config.dense.size() + config.sparse.size() + config.ragged.size();
-  SeededHasher hasher;
   // Build config index.
-  PresizedCuckooMap<std::pair<size_t, Type>> config_index(config_size);
-  bool ok = true;
-  for (size_t i = 0; i < 1000; ++i) {
-    for (size_t d = 0; d < config.dense.size(); ++d) {
-      ok &= config_index.InsertUnique(hasher(config.dense[d].feature_name),
-                                      {d, Type::Dense});
-    }
-    for (size_t d = 0; d < config.sparse.size(); ++d) {
-      ok &= config_index.InsertUnique(hasher(config.sparse[d].feature_name),
-                                      {d, Type::Sparse});
-    }
-    for (size_t d = 0; d < config.ragged.size(); ++d) {
-      ok &= config_index.InsertUnique(hasher(config.ragged[d].feature_name),
-                                      {d, Type::Ragged});
-    }
-    if (ok) break;
-    LOG(WARNING) << "Collision found. This should happen only if you have "
-                    "around 2^32 entries in your config.";
-    hasher.seed++;
-    config_index.Clear(config_size);
-    ok = true;
-  }
-  if (!ok) {
-    return errors::Internal(
-        "Could not avoid collision. This should not happen.");
-  }
+  FeatureIndex config_index;
+  TF_RETURN_IF_ERROR(config_index.Init(config));
 
   // Allocate dense output for fixed length dense values
   // (variable-length dense and sparse and ragged have to be buffered).
@@ -1216,19 +1385,11 @@ Status FastParseExample(const Config& config,
     ragged_buffers[minibatch].resize(config.ragged.size());
     size_t start = first_example_of_minibatch(minibatch);
     size_t end = first_example_of_minibatch(minibatch + 1);
-    for (size_t e = start; e < end; ++e) {
-      PerExampleFeatureStats* stats = nullptr;
-      if (config.collect_feature_stats) {
-        stats = &result->feature_stats[e];
-      }
-      status_of_minibatch[minibatch] = FastParseSerializedExample(
-          serialized[e],
-          (!example_names.empty() ? example_names[e] : "<unknown>"), e, config,
-          config_index, hasher, &fixed_dense_values,
-          &varlen_dense_buffers[minibatch], &sparse_buffers[minibatch],
-          &ragged_buffers[minibatch], stats);
-      if (!status_of_minibatch[minibatch].ok()) break;
-    }
+    status_of_minibatch[minibatch] = FastParseMiniBatch(
+        serialized, example_names, start, end, config, config_index,
+        &fixed_dense_values, &varlen_dense_buffers[minibatch],
+        &sparse_buffers[minibatch], &ragged_buffers[minibatch],
+        config.collect_feature_stats ? &result->feature_stats : nullptr);
   };
 
   ParallelFor(ProcessMiniBatch, num_minibatches, thread_pool);
@@ -1439,36 +1600,9 @@ Status FastParseSingleExample(const Config& config, StringPiece serialized,
   }
 
   // TODO(mrry): Cache the construction of this map at Op construction time.
-  size_t config_size =
-      config.dense.size() + config.sparse.size() + config.ragged.size();
-  SeededHasher hasher;
   // Build config index.
-  PresizedCuckooMap<std::pair<size_t, Type>> config_index(config_size);
-  bool ok = true;
-  for (size_t i = 0; i < 1000; ++i) {
-    for (size_t d = 0; d < config.dense.size(); ++d) {
-      ok &= config_index.InsertUnique(hasher(config.dense[d].feature_name),
-                                      {d, Type::Dense});
-    }
-    for (size_t d = 0; d < config.sparse.size(); ++d) {
-      ok &= config_index.InsertUnique(hasher(config.sparse[d].feature_name),
-                                      {d, Type::Sparse});
-    }
-    for (size_t d = 0; d < config.ragged.size(); ++d) {
-      ok &= config_index.InsertUnique(hasher(config.ragged[d].feature_name),
-                                      {d, Type::Ragged});
-    }
-    if (ok) break;
-    LOG(WARNING) << "Collision found. This should happen only if you have "
-                    "around 2^32 entries in your config.";
-    hasher.seed++;
-    config_index.Clear(config_size);
-    ok = true;
-  }
-  if (!ok) {
-    return errors::Internal(
-        "Could not avoid collision. This should not happen.");
-  }
+  FeatureIndex config_index;
+  TF_RETURN_IF_ERROR(config_index.Init(config));
 
   result->sparse_indices.reserve(config.sparse.size());
   result->sparse_values.reserve(config.sparse.size());
@@ -1537,24 +1671,13 @@ Status FastParseSingleExample(const Config& config, StringPiece serialized,
     const StringPiece feature_name = name_and_feature.first;
     parsed::Feature& feature = name_and_feature.second;
 
-    std::pair<size_t, Type> d_and_type;
-    uint64 h = hasher(feature_name);
-    if (!config_index.Find(h, &d_and_type)) continue;
+    FeatureIndex::Value d_and_type;
+    if (!config_index.Find(feature_name, &d_and_type)) continue;
 
     size_t d = d_and_type.first;
     bool is_dense = d_and_type.second == Type::Dense;
     bool is_sparse = d_and_type.second == Type::Sparse;
 
-    {
-      // Testing for PresizedCuckooMap collision.
-      // TODO(lew): Use dense_hash_map and avoid this and hasher creation.
-      const tstring& config_feature_name =
-          is_dense ? config.dense[d].feature_name
-                   : (is_sparse ? config.sparse[d].feature_name
-                                : config.ragged[d].feature_name);
-      if (feature_name != config_feature_name) continue;
-    }
-
     auto example_error = [feature_name](StringPiece suffix) {
       return errors::InvalidArgument("Key: ", feature_name, ".  ", suffix);
     };
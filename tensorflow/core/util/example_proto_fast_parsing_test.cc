@@ -13,12 +13,16 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <limits>
 #include <utility>
 
 #include "tensorflow/core/util/example_proto_fast_parsing.h"
 
+#include "absl/strings/match.h"
 #include "tensorflow/core/example/example.pb.h"
 #include "tensorflow/core/example/feature.pb.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/random/philox_random.h"
 #include "tensorflow/core/lib/random/simple_philox.h"
 #include "tensorflow/core/platform/protobuf.h"
@@ -423,6 +427,186 @@ TEST(TestFastParseExample, Empty) {
   EXPECT_TRUE(status.ok()) << status;
 }
 
+// Value of the j-th element of the int64 feature `i` in example `e`. The values
+// cover varints of one to ten bytes, including negative ones.
+int64_t WideInt64Value(int e, int i, int j) {
+  static constexpr int64_t kValues[] = {
+      0,         1,           127,
+      128,       -1,          300,
+      16383,     16384,       int64_t{1} << 35,
+      -(int64_t{1} << 50),    std::numeric_limits<int64_t>::max(),
+      std::numeric_limits<int64_t>::min()};
+  return kValues[(7 * e + 3 * i + j) % (sizeof(kValues) / sizeof(kValues[0]))];
+}
+
+// Number of values of the sparse feature `i` in example `e`.
+int WideSparseSize(int e, int i) { return (e + i) % 4; }
+
+// Whether the example `e` is missing the feature `i`.
+bool WideFeatureMissing(int e, int i) { return (e + i) % 5 == 0; }
+
+// Features "f0" to "f<num_features - 1>" alternate between dense int64 of
+// shape {2}, sparse int64, sparse float and sparse string features.
+FastParseExampleConfig WideConfig(int num_features) {
+  FastParseExampleConfig config;
+  for (int i = 0; i < num_features; ++i) {
+    const string key = strings::StrCat("f", i);
+    switch (i % 4) {
+      case 0:
+        config.dense.emplace_back(key, DT_INT64, PartialTensorShape({2}),
+                                  test::AsTensor<int64_t>({-7, -8}),
+                                  /*variable_length=*/false,
+                                  /*elements_per_stride=*/2);
+        break;
+      case 1:
+        config.sparse.emplace_back(key, DT_INT64);
+        break;
+      case 2:
+        config.sparse.emplace_back(key, DT_FLOAT);
+        break;
+      case 3:
+        config.sparse.emplace_back(key, DT_STRING);
+        break;
+    }
+  }
+  return config;
+}
+
+string WideExample(int e, int num_features) {
+  Example example;
+  auto& features = *example.mutable_features()->mutable_feature();
+  for (int i = 0; i < num_features; ++i) {
+    if (WideFeatureMissing(e, i)) continue;
+    Feature& feature = features[strings::StrCat("f", i)];
+    const int size = i % 4 == 0 ? 2 : WideSparseSize(e, i);
+    for (int j = 0; j < size; ++j) {
+      switch (i % 4) {
+        case 0:
+        case 1:
+          feature.mutable_int64_list()->add_value(WideInt64Value(e, i, j));
+          break;
+        case 2:
+          feature.mutable_float_list()->add_value(e + i + j / 4.0f);
+          break;
+        case 3:
+          feature.mutable_bytes_list()->add_value(strings::StrCat(e, "_", j));
+          break;
+      }
+    }
+  }
+  return Serialize(example);
+}
+
+TEST(TestFastParseExample, WideExamples) {
+  constexpr int kNumFeatures = 1200;
+  constexpr int kBatchSize = 37;
+  const FastParseExampleConfig config = WideConfig(kNumFeatures);
+  std::vector<tstring> serialized;
+  for (int e = 0; e < kBatchSize; ++e) {
+    serialized.emplace_back(WideExample(e, kNumFeatures));
+  }
+  Result result;
+  TF_ASSERT_OK(FastParseExample(config, serialized, {}, nullptr, &result));
+  ASSERT_EQ(result.dense_values.size(), config.dense.size());
+  ASSERT_EQ(result.sparse_values.size(), config.sparse.size());
+
+  int dense_index = 0;
+  int sparse_index = 0;
+  for (int i = 0; i < kNumFeatures; ++i) {
+    if (i % 4 == 0) {
+      auto values = result.dense_values[dense_index++].matrix<int64_t>();
+      for (int e = 0; e < kBatchSize; ++e) {
+        for (int j = 0; j < 2; ++j) {
+          EXPECT_EQ(values(e, j), WideFeatureMissing(e, i)
+                                      ? -7 - j
+                                      : WideInt64Value(e, i, j))
+              << "feature " << i << " example " << e;
+        }
+      }
+      continue;
+    }
+    const Tensor& indices = result.sparse_indices[sparse_index];
+    const Tensor& values = result.sparse_values[sparse_index];
+    ++sparse_index;
+    int64_t n = 0;
+    for (int e = 0; e < kBatchSize; ++e) {
+      if (WideFeatureMissing(e, i)) continue;
+      for (int j = 0; j < WideSparseSize(e, i); ++j, ++n) {
+        ASSERT_LT(n, values.NumElements());
+        EXPECT_EQ(indices.matrix<int64_t>()(n, 0), e);
+        EXPECT_EQ(indices.matrix<int64_t>()(n, 1), j);
+        switch (i % 4) {
+          case 1:
+            EXPECT_EQ(values.vec<int64_t>()(n), WideInt64Value(e, i, j));
+            break;
+          case 2:
+            EXPECT_EQ(values.vec<float>()(n), e + i + j / 4.0f);
+            break;
+          case 3:
+            EXPECT_EQ(values.vec<tstring>()(n), strings::StrCat(e, "_", j));
+            break;
+        }
+      }
+    }
+    EXPECT_EQ(n, values.NumElements()) << "feature " << i;
+  }
+}
+
+TEST(FastParse, PackedInt64Runs) {
+  // Runs of single byte varints, decoded eight at a time, interleaved with
+  // longer ones.
+  Example example;
+  Int64List* int64_list =
+      (*example.mutable_features()->mutable_feature())["ids"]
+          .mutable_int64_list();
+  for (int i = 0; i < 200; ++i) {
+    int64_list->add_value(i % 23 < 17 ? i % 128 : WideInt64Value(0, 0, i));
+  }
+  TestCorrectness(Serialize(example));
+}
+
+TEST(TestFastParseExample, PackedInt64DoesNotFitDense) {
+  Example example;
+  Int64List* int64_list =
+      (*example.mutable_features()->mutable_feature())["ids"]
+          .mutable_int64_list();
+  for (int i = 0; i < 19; ++i) {
+    int64_list->add_value(i);
+  }
+  FastParseExampleConfig config;
+  config.dense.emplace_back("ids", DT_INT64, PartialTensorShape({16}),
+                            Tensor(DT_INT64, TensorShape({0})),
+                            /*variable_length=*/false,
+                            /*elements_per_stride=*/16);
+  std::vector<tstring> serialized = {Serialize(example)};
+  Result result;
+  Status status = FastParseExample(config, serialized, {}, nullptr, &result);
+  EXPECT_TRUE(errors::IsInvalidArgument(status)) << status;
+  EXPECT_TRUE(absl::StrContains(status.error_message(), "Values size: 19"))
+      << status;
+}
+
+void BM_FastParseExampleWide(::testing::benchmark::State& state) {
+  const int num_features = state.range(0);
+  const int batch_size = state.range(1);
+  const FastParseExampleConfig config = WideConfig(num_features);
+  std::vector<tstring> serialized;
+  int64_t bytes = 0;
+  for (int e = 0; e < batch_size; ++e) {
+    serialized.emplace_back(WideExample(e, num_features));
+    bytes += serialized.back().size();
+  }
+  for (auto s : state) {
+    Result result;
+    TF_CHECK_OK(FastParseExample(config, serialized, {}, nullptr, &result));
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * bytes);
+}
+BENCHMARK(BM_FastParseExampleWide)
+    ->ArgPair(1000, 1)
+    ->ArgPair(1000, 128)
+    ->ArgPair(4000, 128);
+
 }  // namespace
 }  // namespace example
 }  // namespace tensorflow
@@ -21,6 +21,8 @@ limitations under the License.
 #include <memory>
 #include <utility>
 
+#include "tensorflow/core/framework/allocation_description.pb.h"
+#include "tensorflow/core/framework/allocator.h"
 #include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/framework/tensor.pb.h"
 #include "tensorflow/core/framework/tensor_shape.pb.h"
@@ -970,6 +972,94 @@ Status BundleReader::ReadCurrent(Tensor* val) {
   }
 }
 
+namespace {
+
+// A TensorBuffer that aliases part of a memory-mapped data file. Since the
+// mapping is read-only, it does not own its memory, which prevents kernels
+// from forwarding it to their outputs.
+class MappedTensorBuffer : public TensorBuffer {
+ public:
+  MappedTensorBuffer(std::shared_ptr<ReadOnlyMemoryRegion> region,
+                     uint64 offset, size_t size)
+      : TensorBuffer(const_cast<char*>(
+                         static_cast<const char*>(region->data()) + offset)),
+        region_(std::move(region)),
+        size_(size) {}
+
+  size_t size() const override { return size_; }
+  TensorBuffer* root_buffer() override { return this; }
+  void FillAllocationDescription(AllocationDescription* proto) const override {
+    proto->set_requested_bytes(size_);
+    proto->set_allocator_name("MappedTensorBundle");
+  }
+  bool OwnsMemory() const override { return false; }
+
+ private:
+  const std::shared_ptr<ReadOnlyMemoryRegion> region_;
+  const size_t size_;
+};
+
+}  // namespace
+
+Status BundleReader::ReadCurrentMapped(Tensor* val) {
+  CHECK(val != nullptr);
+  BundleEntryProto entry;
+  TF_RETURN_IF_ERROR(ParseEntryProto(iter_->key(), iter_->value(), &entry));
+  if (!entry.slices().empty() || !DataTypeCanUseMemcpy(entry.dtype()) ||
+      need_to_swap_bytes_ || !TensorShape::IsValid(entry.shape()) ||
+      entry.offset() % Allocator::kAllocatorAlignment != 0) {
+    return ReadCurrent(val);
+  }
+
+  auto it = mapped_data_.find(entry.shard_id());
+  if (it == mapped_data_.end()) {
+    std::unique_ptr<ReadOnlyMemoryRegion> region;
+    Status s = env_->NewReadOnlyMemoryRegionFromFile(
+        DataFilename(prefix_, entry.shard_id(), num_shards_), &region);
+    if (!s.ok()) {
+      VLOG(1) << "Reading tensors of " << prefix_
+              << " without memory-mapping: " << s;
+    }
+    it = mapped_data_.emplace(entry.shard_id(), std::move(region)).first;
+  }
+  const std::shared_ptr<ReadOnlyMemoryRegion>& region = it->second;
+  if (region == nullptr) return ReadCurrent(val);
+
+  const TensorShape shape(entry.shape());
+  const size_t expected_size =
+      shape.num_elements() * DataTypeSize(entry.dtype());
+  if (entry.size() != expected_size) {
+    return errors::DataLoss("Invalid size in bundle entry: key ", key(),
+                            "; stored size ", entry.size(),
+                            "; expected size ", expected_size);
+  }
+  if (entry.offset() + entry.size() > region->length()) {
+    return errors::DataLoss("Bundle entry ", key(), " at offset ",
+                            entry.offset(), " of size ", entry.size(),
+                            " is past the end of its data file");
+  }
+  // The checksum is validated the first time each entry is mapped, so that
+  // later reads of the entry can skip reading the bytes.
+  const string mapped_key(iter_->key());
+  if (verified_mapped_keys_.count(mapped_key) == 0) {
+    const uint32 actual_crc32c = crc32c::Value(
+        static_cast<const char*>(region->data()) + entry.offset(),
+        entry.size());
+    if (crc32c::Unmask(entry.crc32c()) != actual_crc32c) {
+      return errors::DataLoss(
+          "TensorBundle at ", prefix_, " shard ", entry.shard_id(), " (",
+          entry.size(), " bytes): Checksum does not match: stored ",
+          strings::Printf("%08u", crc32c::Unmask(entry.crc32c())),
+          " vs. calculated on the mapped bytes ", actual_crc32c);
+    }
+    verified_mapped_keys_.insert(mapped_key);
+  }
+  auto* buffer = new MappedTensorBuffer(region, entry.offset(), entry.size());
+  *val = Tensor(entry.dtype(), shape, buffer);
+  buffer->Unref();
+  return Status::OK();
+}
+
 Status BundleReader::LookupTensorSlices(StringPiece key,
                                         std::vector<TensorSlice>* slices) {
   slices->clear();
@@ -62,8 +62,10 @@ limitations under the License.
 #define TENSORFLOW_CORE_UTIL_TENSOR_BUNDLE_TENSOR_BUNDLE_H_
 
 #include <map>
+#include <memory>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_shape.h"
@@ -228,6 +230,20 @@ class BundleReader {
   // REQUIRES: status().ok() && Valid()
   Status ReadCurrent(Tensor* val) TF_MUST_USE_RESULT;
 
+  // Like ReadCurrent(), but returns a tensor that aliases the memory-mapped
+  // data file rather than a copy of the stored bytes, if the current tensor
+  // can be memcpy'ed, is not sliced, is stored at an offset aligned to
+  // Allocator::kAllocatorAlignment, and its data file can be memory-mapped.
+  // Otherwise, falls back to ReadCurrent().
+  //
+  // An aliased tensor keeps the mapping alive, so it may outlive the reader,
+  // and it is never forwarded to kernel outputs.  Its checksum is validated
+  // the first time its entry is mapped by this reader.  Tensors are stored at
+  // aligned offsets if the bundle was written with a "data_alignment" that is
+  // a multiple of the allocator alignment.
+  // REQUIRES: status().ok() && Valid()
+  Status ReadCurrentMapped(Tensor* val) TF_MUST_USE_RESULT;
+
   // Looks up the slices of the tensor keyed by "key".  On OK, "slices"
   // is non-empty if and only if the tensor is a partitioned tensor.
   //
@@ -294,6 +310,12 @@ class BundleReader {
   table::Iterator* iter_;
   // Owned the InputBuffer objects and their underlying RandomAccessFile's.
   std::unordered_map<int32, io::InputBuffer*> data_;
+  // Memory-mapped data files, shared with the tensors that alias them. Holds
+  // null for the shards that could not be mapped.
+  std::unordered_map<int32, std::shared_ptr<ReadOnlyMemoryRegion>>
+      mapped_data_;
+  // Keys of the entries whose mapped bytes matched their stored checksum.
+  std::unordered_set<string> verified_mapped_keys_;
 
   // Maps each partitioned tensor's key to its stored slices (represented in a
   // TensorSliceSet).  Populated on-demand.
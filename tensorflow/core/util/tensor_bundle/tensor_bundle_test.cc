@@ -18,6 +18,7 @@ limitations under the License.
 #include <random>
 #include <vector>
 
+#include "tensorflow/core/framework/allocator.h"
 #include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/framework/tensor_util.h"
 #include "tensorflow/core/framework/types.pb.h"
@@ -1113,6 +1114,62 @@ TEST_F(TensorBundleAlignmentTest, AlignmentTest) {
   }
 }
 
+TEST_F(TensorBundleAlignmentTest, ReadCurrentMapped) {
+  {
+    BundleWriter::Options opts;
+    opts.data_alignment = Allocator::kAllocatorAlignment;
+    BundleWriter writer(Env::Default(), Prefix("mapped"), opts);
+    TF_EXPECT_OK(writer.Add("a_float", Constant_2x3<float>(1.5)));
+    TF_EXPECT_OK(writer.Add("b_string", Constant_2x3<tstring>("foo")));
+    TF_EXPECT_OK(writer.Add("c_int", Constant_2x3<int32>(7)));
+    TF_ASSERT_OK(writer.Finish());
+  }
+  Tensor mapped_float;
+  Tensor string_val;
+  Tensor mapped_int;
+  {
+    BundleReader reader(Env::Default(), Prefix("mapped"));
+    TF_ASSERT_OK(reader.status());
+    reader.Next();  // Skips the header entry.
+    TF_ASSERT_OK(reader.ReadCurrentMapped(&mapped_float));
+    reader.Next();
+    TF_ASSERT_OK(reader.ReadCurrentMapped(&string_val));
+    reader.Next();
+    TF_ASSERT_OK(reader.ReadCurrentMapped(&mapped_int));
+  }
+  // The tensors remain valid after the reader is destroyed.
+  test::ExpectTensorEqual<float>(mapped_float, Constant_2x3<float>(1.5));
+  test::ExpectTensorEqual<tstring>(string_val, Constant_2x3<tstring>("foo"));
+  test::ExpectTensorEqual<int32>(mapped_int, Constant_2x3<int32>(7));
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(mapped_float.tensor_data().data()) %
+                Allocator::kAllocatorAlignment,
+            0);
+}
+
+TEST_F(TensorBundleAlignmentTest, ReadCurrentMappedChecksum) {
+  {
+    BundleWriter::Options opts;
+    opts.data_alignment = Allocator::kAllocatorAlignment;
+    BundleWriter writer(Env::Default(), Prefix("mapped_corrupt"), opts);
+    TF_EXPECT_OK(writer.Add("a_float", Constant_2x3<float>(1.5)));
+    TF_ASSERT_OK(writer.Finish());
+  }
+  // Corrupts the first byte of the tensor, which starts the data file.
+  const string datafile = DataFilename(Prefix("mapped_corrupt"), 0, 1);
+  string data;
+  TF_ASSERT_OK(ReadFileToString(Env::Default(), datafile, &data));
+  data[0] = ~data[0];
+  TF_ASSERT_OK(WriteStringToFile(Env::Default(), datafile, data));
+
+  BundleReader reader(Env::Default(), Prefix("mapped_corrupt"));
+  TF_ASSERT_OK(reader.status());
+  reader.Next();  // Skips the header entry.
+  Tensor val;
+  Status status = reader.ReadCurrentMapped(&val);
+  EXPECT_TRUE(errors::IsDataLoss(status));
+  EXPECT_TRUE(absl::StrContains(status.ToString(), "Checksum does not match"));
+}
+
 static void BM_BundleAlignment(::testing::benchmark::State& state) {
   {
     const int alignment = state.range(0);
@@ -1139,6 +1196,45 @@ BENCHMARK(BM_BundleAlignment)->ArgPair(4096, 512);
 BENCHMARK(BM_BundleAlignment)->ArgPair(4096, 4096);
 BENCHMARK(BM_BundleAlignment)->ArgPair(4096, 1048576);
 
+// Reads a bundle of tensors of the given size, which are either copied from the
+// data file or, if the second argument is 1, alias the memory-mapped file.
+static void BM_BundleReadCurrent(::testing::benchmark::State& state) {
+  const int tensor_size = state.range(0);
+  const bool mapped = state.range(1);
+  constexpr int kNumTensors = 64;
+  {
+    BundleWriter::Options opts;
+    opts.data_alignment = Allocator::kAllocatorAlignment;
+    BundleWriter writer(Env::Default(), Prefix("read_current"), opts);
+    for (int i = 0; i < kNumTensors; ++i) {
+      TF_CHECK_OK(writer.Add(strings::StrCat("t", i),
+                             Constant(1.0f, TensorShape({tensor_size}))));
+    }
+    TF_CHECK_OK(writer.Finish());
+  }
+  BundleReader reader(Env::Default(), Prefix("read_current"));
+  TF_CHECK_OK(reader.status());
+  for (auto s : state) {
+    reader.Seek("t");
+    for (int i = 0; i < kNumTensors; ++i, reader.Next()) {
+      Tensor t;
+      if (mapped) {
+        TF_CHECK_OK(reader.ReadCurrentMapped(&t));
+      } else {
+        TF_CHECK_OK(reader.ReadCurrent(&t));
+      }
+    }
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          kNumTensors * tensor_size * sizeof(float));
+}
+
+BENCHMARK(BM_BundleReadCurrent)
+    ->ArgPair(1024, 0)
+    ->ArgPair(1024, 1)
+    ->ArgPair(1 << 20, 0)
+    ->ArgPair(1 << 20, 1);
+
 static void BM_BundleWriterSmallTensor(::testing::benchmark::State& state) {
   const int64_t bytes = state.range(0);
   Tensor t = Constant(static_cast<int8>('a'), TensorShape{bytes});
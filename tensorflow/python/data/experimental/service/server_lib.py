@@ -248,7 +248,7 @@ class DispatchServer(object):
 class WorkerConfig(
     collections.namedtuple("WorkerConfig", [
         "dispatcher_address", "worker_address", "port", "protocol",
-        "heartbeat_interval_ms", "dispatcher_timeout_ms"
+        "heartbeat_interval_ms", "dispatcher_timeout_ms", "element_buffer_size"
     ])):
   """Configuration class for tf.data service dispatchers.
 
@@ -268,6 +268,10 @@ class WorkerConfig(
       from finished jobs.
     dispatcher_timeout_ms: How long, in milliseconds, to retry requests to the
       dispatcher before giving up and reporting an error. Defaults to 1 hour.
+    element_buffer_size: (Optional.) The number of elements that each task
+      prefetches for clients that read on a first-come first-served basis.
+      Larger buffers let clients fetch more elements per request, at the cost
+      of worker memory. Defaults to 1, which does not buffer extra elements.
   """
 
   def __new__(cls,
@@ -276,18 +280,21 @@ class WorkerConfig(
               port=0,
               protocol=None,
               heartbeat_interval_ms=None,
-              dispatcher_timeout_ms=None):
+              dispatcher_timeout_ms=None,
+              element_buffer_size=None):
     if worker_address is None:
       worker_address = "localhost:%port%"
     if protocol is None:
       protocol = _pywrap_utils.TF_DATA_DefaultProtocol()
     heartbeat_interval_ms = _get_time_or_placeholder(heartbeat_interval_ms)
     dispatcher_timeout_ms = _get_time_or_placeholder(dispatcher_timeout_ms)
+    if element_buffer_size is None:
+      element_buffer_size = 0
 
     return super(WorkerConfig,
                  cls).__new__(cls, dispatcher_address, worker_address, port,
                               protocol, heartbeat_interval_ms,
-                              dispatcher_timeout_ms)
+                              dispatcher_timeout_ms, element_buffer_size)
 
 
 @tf_export("data.experimental.service.WorkerServer", v1=[])
@@ -342,7 +349,8 @@ class WorkerServer(object):
           protocol=config.protocol,
           heartbeat_interval_ms=config.heartbeat_interval_ms,
           dispatcher_timeout_ms=config.dispatcher_timeout_ms,
-          data_transfer_protocol=None)
+          data_transfer_protocol=None,
+          element_buffer_size=config.element_buffer_size)
     self._server = _pywrap_server_lib.TF_DATA_NewWorkerServer(
         config_proto.SerializeToString())
     if start:
@@ -107,6 +107,13 @@ class ServerLibTest(test.TestCase):
         server_lib.WorkerConfig(dispatcher._address, port=port), start=True)
     self.assertEqual(worker._address, "localhost:{}".format(port))
 
+  def testStartWorkerWithElementBufferSizeConfig(self):
+    dispatcher = server_lib.DispatchServer()
+    worker = server_lib.WorkerServer(
+        server_lib.WorkerConfig(dispatcher._address, element_buffer_size=32),
+        start=True)
+    self.assertEqual(worker._num_tasks(), 0)
+
   def testMultipleStartWorker(self):
     dispatcher = server_lib.DispatchServer()
     worker = server_lib.WorkerServer(
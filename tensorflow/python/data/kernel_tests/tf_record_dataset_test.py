@@ -151,6 +151,20 @@ class TFRecordDatasetTest(tf_record_test_base.TFRecordTestBase,
           [self._record(j, i) for i in range(self._num_records)])
     self.assertDatasetProduces(dataset, expected_output=expected_output)
 
+  @combinations.generate(
+      combinations.times(test_base.default_test_combinations(),
+                         combinations.combine(prefetch_queue_depth=[1, 4])))
+  def testReadWithPrefetch(self, prefetch_queue_depth):
+    dataset = readers.TFRecordDataset(
+        self._filenames,
+        buffer_size=16,
+        prefetch_queue_depth=prefetch_queue_depth)
+    expected_output = []
+    for j in range(self._num_files):
+      expected_output.extend(
+          [self._record(j, i) for i in range(self._num_records)])
+    self.assertDatasetProduces(dataset, expected_output=expected_output)
+
   @combinations.generate(test_base.default_test_combinations())
   def testReadFromDatasetOfFiles(self):
     files = dataset_ops.Dataset.from_tensor_slices(self._filenames)
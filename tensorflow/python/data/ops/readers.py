@@ -290,7 +290,8 @@ class _TFRecordDataset(dataset_ops.DatasetSource):
                filenames,
                compression_type=None,
                buffer_size=None,
-               name=None):
+               name=None,
+               prefetch_queue_depth=None):
     """Creates a `TFRecordDataset`.
 
     Args:
@@ -300,6 +301,9 @@ class _TFRecordDataset(dataset_ops.DatasetSource):
       buffer_size: (Optional.) A `tf.int64` scalar representing the number of
         bytes in the read buffer. 0 means no buffering.
       name: (Optional.) A name for the tf.data operation.
+      prefetch_queue_depth: (Optional.) A Python integer representing the
+        number of reads of `buffer_size` bytes to keep outstanding ahead of the
+        reader. 0 or `None` means the file is read synchronously.
     """
     self._filenames = filenames
     self._compression_type = convert.optional_param_to_tensor(
@@ -317,6 +321,8 @@ class _TFRecordDataset(dataset_ops.DatasetSource):
     kwargs = {}
     if name or compat.forward_compatible(2021, 9, 30):
       kwargs["metadata"] = self._metadata.SerializeToString()
+    if prefetch_queue_depth:
+      kwargs["prefetch_queue_depth"] = prefetch_queue_depth
 
     variant_tensor = gen_dataset_ops.tf_record_dataset(self._filenames,
                                                        self._compression_type,
@@ -449,7 +455,8 @@ class TFRecordDatasetV2(dataset_ops.DatasetV2):
                compression_type=None,
                buffer_size=None,
                num_parallel_reads=None,
-               name=None):
+               name=None,
+               prefetch_queue_depth=None):
     """Creates a `TFRecordDataset` to read one or more TFRecord files.
 
     Each element of the dataset will contain a single TFRecord.
@@ -470,6 +477,10 @@ class TFRecordDatasetV2(dataset_ops.DatasetV2):
         value greater than one to parallelize the I/O. If `None`, files will be
         read sequentially.
       name: (Optional.) A name for the tf.data operation.
+      prefetch_queue_depth: (Optional.) A Python integer representing the
+        number of reads of `buffer_size` bytes to keep outstanding ahead of the
+        reader of each file, so that record parsing overlaps with I/O. If
+        `None` or 0, files are read synchronously.
 
     Raises:
       TypeError: If any argument does not have the expected type.
@@ -484,7 +495,11 @@ class TFRecordDatasetV2(dataset_ops.DatasetV2):
 
     def creator_fn(filename):
       return _TFRecordDataset(
-          filename, compression_type, buffer_size, name=name)
+          filename,
+          compression_type,
+          buffer_size,
+          name=name,
+          prefetch_queue_depth=prefetch_queue_depth)
 
     self._impl = _create_dataset_reader(
         creator_fn, filenames, num_parallel_reads, name=name)
@@ -508,9 +523,15 @@ class TFRecordDatasetV1(dataset_ops.DatasetV1Adapter):
                compression_type=None,
                buffer_size=None,
                num_parallel_reads=None,
-               name=None):
+               name=None,
+               prefetch_queue_depth=None):
     wrapped = TFRecordDatasetV2(
-        filenames, compression_type, buffer_size, num_parallel_reads, name=name)
+        filenames,
+        compression_type,
+        buffer_size,
+        num_parallel_reads,
+        name=name,
+        prefetch_queue_depth=prefetch_queue_depth)
     super(TFRecordDatasetV1, self).__init__(wrapped)
 
   __init__.__doc__ = TFRecordDatasetV2.__init__.__doc__